@@ -218,6 +218,9 @@ uint32              cpu_cmd(UNIT * uptr, uint16 cmd, uint16 dev);
 t_stat              cpu_help (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag,
                         const char *cptr);
 const char          *cpu_description (DEVICE *dptr);
+const char          *cpu_opstats_name(uint32 op);
+uint32              cpu_opstats_class(uint32 op);
+extern const char   *opcode_name(uint16 op);
 
 /* Interval timer option */
 t_stat              rtc_srv(UNIT * uptr);
@@ -288,6 +291,16 @@ extern uint32       drum_addr;
 #define INDICATORS      16
 #define PROTECT         32
 #define DUALCORE        64
+
+/* Per-opcode statistics, indexed by the 12 bit opcode field */
+static const char * const cpu_opstats_classes[] = {
+    "Positive", "Negative", "Type A"
+};
+
+SIM_OPSTATS         cpu_opstats = {
+    010000, &cpu_opstats_name, &cpu_opstats_class,
+    cpu_opstats_classes, 3
+};
 
 /* CPU data structures
 
@@ -385,6 +398,11 @@ MTAB                cpu_mod[] = {
 #endif
     {MTAB_XTD | MTAB_VDV | MTAB_NMO | MTAB_SHP, 0, "HISTORY", "HISTORY",
      &cpu_set_hist, &cpu_show_hist},
+    {MTAB_XTD | MTAB_VDV | MTAB_VALO | MTAB_NMO, 1, "OPSTATS",
+     "OPSTATS{=COUNT|TIMING|RESET}", &sim_set_opstats, &sim_show_opstats,
+     (void *)&cpu_opstats, "Enable/Display per-opcode execution statistics"},
+    {MTAB_XTD | MTAB_VDV, 0, NULL, "NOOPSTATS", &sim_set_opstats, NULL,
+     (void *)&cpu_opstats, "Disable per-opcode execution statistics"},
     {0}
 };
 
@@ -1004,6 +1022,7 @@ sim_instr(void)
       next_xec:
         opcode = (uint16)(SR >> 24);
         IR = opcode;
+        SIM_OPSTATS_COUNT(&cpu_opstats, opcode);
         if (hst_lnt) {  /* history enabled? */
             hst[hst_p].op = SR;
         }
@@ -4221,6 +4240,26 @@ rtc_srv(UNIT * uptr)
     return SCPE_OK;
 }
 
+/* Opcode statistics name and class */
+const char *
+cpu_opstats_name(uint32 op)
+{
+    return opcode_name((uint16)op);
+}
+
+uint32
+cpu_opstats_class(uint32 op)
+{
+    switch (07 & (op >> 9)) {
+    case 00:
+        return 0;
+    case 04:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
 /* Memory examine */
 
 t_stat
@@ -720,6 +720,34 @@ t_opcode            neg_760[] = {
 const char *chname[11] = {
     "*", "A", "B", "C", "D", "E", "F", "G", "H"
 };
+
+/* Opcode name for a 12 bit opcode field, or NULL if none matches */
+const char *
+opcode_name(uint16 op)
+{
+    t_opcode           *tab;
+
+    switch (07 & (op >> 9)) {
+    case 00:
+        tab = pos_ops;
+        break;
+    case 04:
+        tab = neg_ops;
+        break;
+    default:
+        for (tab = base_ops; tab->name != NULL; tab++) {
+            if (tab->opbase == (07 & (op >> 9)))
+                return tab->name;
+        }
+        return NULL;
+    }
+    for (; tab->name != NULL; tab++) {
+        if (tab->opbase == op)
+            return (tab->name[0] != '\0') ? tab->name :
+                        ((op & 04000) ? "MSE" : "PSE");
+    }
+    return NULL;
+}
 
 void
 lookup_sopcode(FILE * of, t_value val, t_opcode * tab)
@@ -96,6 +96,13 @@
 
 #include "kx10_defs.h"
 #include "sim_timer.h"
+#if defined (__linux__) || defined (__APPLE__) || defined (__CYGWIN__) || defined (__FreeBSD__) || defined(__NetBSD__) || defined (__OpenBSD__)
+#define MEM_MMAP        1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #define HIST_PC         0x40000000
 #define HIST_PC2        0x80000000
@@ -106,7 +113,13 @@
 #define TMR_QUA         1
 
 
-uint64  M[MAXMEMSIZE];                        /* Memory */
+uint64  *M = NULL;                            /* Memory */
+#define MEM_DEFAULT     0                     /* Anonymous, THP hint */
+#define MEM_HUGE        1                     /* Explicit huge pages */
+#define MEM_FILE        2                     /* Shared file mapping */
+static int     mem_backing = MEM_DEFAULT;     /* Memory backing type */
+static char    mem_file[CBUFSIZE];            /* Backing file name */
+static size_t  mem_len = 0;                   /* Mapped length, 0 if heap */
 #if KL | KS
 uint64  FM[128];                              /* Fast memory register */
 #elif KI
@@ -389,6 +402,9 @@ t_stat cpu_ex (t_value *vptr, t_addr addr, UNIT *uptr, int32 sw);
 t_stat cpu_dep (t_value val, t_addr addr, UNIT *uptr, int32 sw);
 t_stat cpu_reset (DEVICE *dptr);
 t_stat cpu_set_size (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
+static t_stat cpu_mem_alloc (int backing, const char *file);
+t_stat cpu_set_backing (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
+t_stat cpu_show_backing (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
 t_stat cpu_set_hist (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
 t_stat cpu_show_hist (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
 #if KI | KL | KS
@@ -399,6 +415,9 @@ t_stat cpu_help (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag,
                      const char *cptr);
 const char          *cpu_description (DEVICE *dptr);
 void set_ac_display (uint64 *acbase);
+const char *cpu_opstats_name (uint32 op);
+uint32 cpu_opstats_class (uint32 op);
+extern const char *opcode_name (uint64 inst);
 #if KA
 int (*Mem_read)(int flag, int cur_context, int fetch, int mod);
 int (*Mem_write)(int flag, int cur_context);
@@ -409,6 +428,19 @@ int Mem_write(int flag, int cur_context);
 
 t_bool build_dev_tab (void);
 
+/* Per-opcode statistics, indexed by the 9 bit IR and the 4 bit AC so
+   that instructions selected by the AC field are counted separately */
+
+static const char * const cpu_opstats_classes[] = {
+    "UUO", "Float/Byte", "Move/Arith", "Skip/Jump",
+    "Boolean", "Half word", "Test", "I/O"
+    };
+
+SIM_OPSTATS cpu_opstats = {
+    020000, &cpu_opstats_name, &cpu_opstats_class,
+    cpu_opstats_classes, 8
+    };
+
 /* CPU data structures
 
    cpu_dev      CPU device descriptor
@@ -635,6 +667,8 @@ MTAB cpu_mod[] = {
     { UNIT_MSIZE, 128, "2048K", "2048K", &cpu_set_size },
     { UNIT_MSIZE, 256, "4096K", "4096K", &cpu_set_size },
 #endif
+    { MTAB_XTD|MTAB_VDV|MTAB_VALR|MTAB_NC, 0, "BACKING", "BACKING={DEFAULT|HUGEPAGES|FILE=path}",
+      &cpu_set_backing, &cpu_show_backing, NULL, "Select/Display main memory backing" },
 #if KI|KL|KS
     { MTAB_XTD|MTAB_VDV|MTAB_VALR, 0, "SERIAL", "SERIAL",
           &cpu_set_serial, &cpu_show_serial, NULL, "CPU Serial Number" },
@@ -685,6 +719,12 @@ MTAB cpu_mod[] = {
 #endif
     { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP, 0, "HISTORY", "HISTORY",
       &cpu_set_hist, &cpu_show_hist },
+    { MTAB_XTD|MTAB_VDV|MTAB_VALO|MTAB_NMO, 1, "OPSTATS", "OPSTATS{=COUNT|TIMING|RESET}",
+      &sim_set_opstats, &sim_show_opstats, (void *)&cpu_opstats,
+      "Enable/Display per-opcode execution statistics" },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "NOOPSTATS",
+      &sim_set_opstats, NULL, (void *)&cpu_opstats,
+      "Disable per-opcode execution statistics" },
     { 0 }
     };
 
@@ -4923,6 +4963,7 @@ st_pi:
     }
 #endif
     BR = get_reg(AC);
+    SIM_OPSTATS_COUNT (&cpu_opstats, (IR << 4) | AC);
 
     /* Process the instruction */
     switch (IR) {
@@ -13593,6 +13634,11 @@ t_stat cpu_reset (DEVICE *dptr)
          }
 #endif
     }
+    if (M == NULL) {
+         r = cpu_mem_alloc (mem_backing, mem_file);
+         if (r != SCPE_OK)
+             return r;
+    }
     sim_debug(DEBUG_CONO, dptr, "CPU reset\n");
     RUN = BYF5 = uuo_cycle = 0;
 #if KA | PDP6
@@ -13668,6 +13714,18 @@ t_stat cpu_reset (DEVICE *dptr)
     return r;
 }
 
+/* Opcode statistics name and class */
+
+const char *cpu_opstats_name (uint32 op)
+{
+    return opcode_name (((uint64)op) << 23);
+}
+
+uint32 cpu_opstats_class (uint32 op)
+{
+    return (op >> 10) & 7;
+}
+
 /* Memory examine */
 
 t_stat cpu_ex (t_value *vptr, t_addr ea, UNIT *uptr, int32 sw)
@@ -13754,15 +13812,139 @@ t_stat cpu_detach (UNIT *uptr)
     return SCPE_OK;
 }
 
+/* Main memory allocation
+
+   The full MAXMEMSIZE is always reserved so that the CPU and devices can
+   keep indexing M without extra checks, but on hosts with mmap only the
+   pages actually touched are committed, so a 256K KS10 no longer pays for
+   the largest configuration.  The backing can be:
+
+   DEFAULT      anonymous memory, with a transparent huge page hint
+   HUGEPAGES    explicit huge pages (MAP_HUGETLB); fails if none reserved
+   FILE=path    shared mapping of a file, which keeps its contents across
+                runs so a system can be restarted warm
+*/
+
+static void cpu_mem_free (void)
+{
+if (M == NULL)
+    return;
+#if defined (MEM_MMAP)
+if (mem_len != 0)
+    munmap ((void *)M, mem_len);
+else
+#endif
+    free (M);
+M = NULL;
+mem_len = 0;
+}
+
+static t_stat cpu_mem_alloc (int backing, const char *file)
+{
+uint64  *nm = NULL;
+size_t   len = (size_t)MAXMEMSIZE * sizeof (*M);
+uint32   keep = 0;
+
+#if defined (MEM_MMAP)
+void    *p = MAP_FAILED;
+
+len = (len + 0x1FFFFF) & ~((size_t)0x1FFFFF);           /* Round to 2MB */
+switch (backing) {
+
+case MEM_DEFAULT:
+    p = mmap (NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+#if defined (MADV_HUGEPAGE)
+    if (p != MAP_FAILED)
+        madvise (p, len, MADV_HUGEPAGE);
+#endif
+    break;
+
+case MEM_HUGE:
+#if defined (MAP_HUGETLB)
+    p = mmap (NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON|MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED)
+        return sim_messagef (SCPE_MEM, "Can't allocate %d MB of huge pages: %s\n",
+                             (int)(len >> 20), strerror (errno));
+    break;
+#else
+    return sim_messagef (SCPE_NOFNC, "Huge pages not supported on this host\n");
+#endif
+
+case MEM_FILE: {
+    struct stat st;
+    int fd = open (file, O_RDWR|O_CREAT, 0644);
+
+    if (fd < 0)
+        return sim_messagef (SCPE_OPENERR, "Can't open %s: %s\n", file, strerror (errno));
+    if ((fstat (fd, &st) != 0) ||
+        (((size_t)st.st_size < len) && (ftruncate (fd, (off_t)len) != 0))) {
+        close (fd);
+        return sim_messagef (SCPE_IOERR, "Can't size %s: %s\n", file, strerror (errno));
+        }
+    p = mmap (NULL, len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (p == MAP_FAILED)
+        return sim_messagef (SCPE_IOERR, "Can't map %s: %s\n", file, strerror (errno));
+    }
+    break;
+    }
+if (p == MAP_FAILED)
+    return SCPE_MEM;
+nm = (uint64 *)p;
+#else
+if (backing != MEM_DEFAULT)
+    return sim_messagef (SCPE_NOFNC, "Memory backing not supported on this host\n");
+nm = (uint64 *)calloc (MAXMEMSIZE, sizeof (*M));
+if (nm == NULL)
+    return SCPE_MEM;
+len = 0;
+#endif
+/* Carry the current contents over, unless the file supplies them */
+if ((M != NULL) && (backing != MEM_FILE))
+    keep = (uint32)MEMSIZE;
+if (keep != 0)
+    memcpy (nm, M, keep * sizeof (*M));
+cpu_mem_free ();
+M = nm;
+mem_len = len;
+mem_backing = backing;
+return SCPE_OK;
+}
+
+/* Clear memory words [lo, hi), returning whole pages to the host */
+
+static void cpu_mem_clear (uint32 lo, uint32 hi)
+{
+if ((M == NULL) || (lo >= hi) || (mem_backing == MEM_FILE))
+    return;
+#if defined (MEM_MMAP) && defined (MADV_DONTNEED)
+if (mem_len != 0) {
+    uintptr_t pg = (uintptr_t)sysconf (_SC_PAGESIZE);
+    uintptr_t s = ((uintptr_t)&M[lo] + pg - 1) & ~(pg - 1);
+    uintptr_t e = (uintptr_t)&M[hi] & ~(pg - 1);
+
+    if ((s < e) && (madvise ((void *)s, e - s, MADV_DONTNEED) == 0)) {
+        memset (&M[lo], 0, s - (uintptr_t)&M[lo]);
+        memset ((void *)e, 0, (uintptr_t)&M[hi] - e);
+        return;
+        }
+    }
+#endif
+memset (&M[lo], 0, (hi - lo) * sizeof (*M));
+}
+
 /* Memory size change */
 
 t_stat cpu_set_size (UNIT *uptr, int32 sval, CONST char *cptr, void *desc)
 {
 int32 i;
 int32 val = (int32)sval;
+t_stat r;
 
 if ((val <= 0) || ((val * 16 * 1024) > MAXMEMSIZE))
     return SCPE_ARG;
+if ((M == NULL) && ((r = cpu_mem_alloc (mem_backing, mem_file)) != SCPE_OK))
+    return r;
 val = val * 16 * 1024;
 if (val < (int32)MEMSIZE) {
     uint64 mc = 0;
@@ -13770,13 +13952,65 @@ if (val < (int32)MEMSIZE) {
         mc = mc | M[i];
     if ((mc != 0) && (!get_yn ("Really truncate memory [N]?", FALSE)))
         return SCPE_OK;
+    cpu_mem_clear ((uint32)val, (uint32)MEMSIZE);
 }
-for (i = (int32)MEMSIZE; i < val; i++)
-    M[i] = 0;
+cpu_mem_clear ((uint32)MEMSIZE, (uint32)val);
 cpu_unit[0].capac = (uint32)val;
 return SCPE_OK;
 }
 
+/* Set memory backing */
+
+t_stat cpu_set_backing (UNIT *uptr, int32 val, CONST char *cptr, void *desc)
+{
+char gbuf[CBUFSIZE];
+char fbuf[CBUFSIZE];
+
+if ((cptr == NULL) || (*cptr == 0))
+    return SCPE_MISVAL;
+cptr = get_glyph (cptr, gbuf, '=');
+if (MATCH_CMD (gbuf, "DEFAULT") == 0) {
+    if (*cptr != 0)
+        return SCPE_ARG;
+    return cpu_mem_alloc (MEM_DEFAULT, NULL);
+    }
+if (MATCH_CMD (gbuf, "HUGEPAGES") == 0) {
+    if (*cptr != 0)
+        return SCPE_ARG;
+    return cpu_mem_alloc (MEM_HUGE, NULL);
+    }
+if (MATCH_CMD (gbuf, "FILE") == 0) {
+    t_stat r;
+
+    get_glyph_nc (cptr, fbuf, 0);
+    if (fbuf[0] == 0)
+        return SCPE_MISVAL;
+    r = cpu_mem_alloc (MEM_FILE, fbuf);
+    if (r == SCPE_OK)
+        strlcpy (mem_file, fbuf, sizeof (mem_file));
+    return r;
+    }
+return SCPE_ARG;
+}
+
+/* Show memory backing */
+
+t_stat cpu_show_backing (FILE *st, UNIT *uptr, int32 val, CONST void *desc)
+{
+switch (mem_backing) {
+case MEM_HUGE:
+    fprintf (st, "backing=hugepages");
+    break;
+case MEM_FILE:
+    fprintf (st, "backing=file=%s", mem_file);
+    break;
+default:
+    fprintf (st, "backing=default");
+    break;
+    }
+return SCPE_OK;
+}
+
 #if !KS
 /* Build device dispatch table */
 t_bool build_dev_tab (void)
@@ -1171,6 +1171,20 @@ static const char *devnam[NUMDEV] = {
  "APR", "PI", "PAG", "CCA", "TIM", "MTR"
  };
 
+/* Opcode name for an instruction word, or NULL if none matches */
+
+const char *opcode_name (uint64 inst)
+{
+    int32 i, j;
+
+    for (i = 0; opc_val[i] >= 0; i++) {                 /* loop thru ops */
+        j = (int32) ((opc_val[i] >> I_V_FL) & I_M_FL);  /* get class */
+        if (((opc_val[i] & FMASK) == (inst & masks[j])))
+            return opcode[i];
+    }
+    return NULL;
+}
+
 /* Symbolic decode
 
    Inputs:
@@ -277,6 +277,15 @@ typedef struct {
     uint16              inst[HIST_ILNT];
     } InstHistory;
 
+#define RLC_R           1                               /* reloc cache: read ok */
+#define RLC_W           2                               /* write ok */
+typedef struct {
+    int32               acc;                            /* RLC_R, RLC_W */
+    int32               lo;                             /* lowest valid disp */
+    int32               span;                           /* valid disps - 1 */
+    int32               base;                           /* physical base */
+    } RELOCENT;
+
 /* Global state */
 
 uint16 *M = NULL;                                       /* memory */
@@ -302,6 +311,7 @@ int32 FPS = 0;                                          /* fp status */
 int32 FEC = 0;                                          /* fp exception code */
 int32 FEA = 0;                                          /* fp exception addr */
 int32 APRFILE[64] = { 0 };                              /* PARs/PDRs */
+RELOCENT reloc_tab[64];                                 /* relocation cache */
 int32 MMR0 = 0;                                         /* MMR0 - status */
 int32 MMR1 = 0;                                         /* MMR1 - R+/-R */
 int32 MMR2 = 0;                                         /* MMR2 - saved PC */
@@ -343,6 +353,8 @@ t_stat cpu_boot (int32 unitno, DEVICE *dptr);
 t_bool cpu_is_pc_a_subroutine_call (t_addr **ret_addrs);
 t_stat cpu_set_hist (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
 t_stat cpu_show_hist (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
+const char *cpu_opstats_name (uint32 op);
+uint32 cpu_opstats_class (uint32 op);
 t_stat cpu_show_virt (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
 t_stat cpu_help (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, const char *cptr);
 const char *cpu_description (DEVICE *dptr);
@@ -356,6 +368,8 @@ int32 clean_MMR1 (int32 mmr1);
 int32 relocC (int32 va, int32 sw);
 t_bool PLF_test (int32 va, int32 apr);
 void reloc_abort (int32 err, int32 apridx);
+void reloc_build (int32 apridx);
+void reloc_build_all (void);
 int32 ReadE (int32 addr);
 int32 ReadW (int32 addr);
 int32 ReadB (int32 addr);
@@ -384,6 +398,7 @@ extern t_stat iopageR (int32 *data, uint32 addr, int32 access);
 extern t_stat iopageW (int32 data, uint32 addr, int32 access);
 extern int32 calc_ints (int32 nipl, int32 trq);
 extern int32 get_vector (int32 nipl);
+extern const char *opcode_name (int32 inst);
 
 /* Trap data structures */
 
@@ -419,6 +434,18 @@ int32 trap_clear[TRAP_V_MAX] = {                        /* trap clears */
     TRAP_FPE
     };
 
+/* Per-opcode statistics, indexed by instruction word */
+
+static const char * const cpu_opstats_classes[] = {
+    "Double operand", "Single operand", "Branch", "Control",
+    "EIS", "FIS", "CIS", "Floating point"
+    };
+
+SIM_OPSTATS cpu_opstats = {
+    0200000, &cpu_opstats_name, &cpu_opstats_class,
+    cpu_opstats_classes, 8
+    };
+
 /* CPU data structures
 
    cpu_dev      CPU device descriptor
@@ -693,6 +720,10 @@ MTAB cpu_mod[] = {
     { MTAB_XTD|MTAB_VDV, 0, NULL, "NOIDLE", &sim_clr_idle, NULL, NULL, "Disable idle detection" },
     { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP|MTAB_NC, 0, "HISTORY", "HISTORY=n",
       &cpu_set_hist, &cpu_show_hist, NULL, "Enable/Display instruction history" },
+    { MTAB_XTD|MTAB_VDV|MTAB_VALO|MTAB_NMO, 1, "OPSTATS", "OPSTATS{=COUNT|TIMING|RESET}",
+      &sim_set_opstats, &sim_show_opstats, (void *)&cpu_opstats, "Enable/Display per-opcode execution statistics" },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "NOOPSTATS",
+      &sim_set_opstats, NULL, (void *)&cpu_opstats, "Disable per-opcode execution statistics" },
     { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP, 0, "VIRTUAL", NULL,
       NULL, &cpu_show_virt, NULL, "Display address translation" },
     { 0 }
@@ -755,6 +786,7 @@ for (i = 0; i < 6; i++)
 SP = STACKFILE[cm];
 isenable = calc_is (cm);
 dsenable = calc_ds (cm);
+reloc_build_all ();                                     /* APRs may have changed */
 put_PIRQ (PIRQ);                                        /* rewrite PIRQ */
 STKLIM = STKLIM & STKLIM_RW;                            /* clean up STKLIM */
 MMR0 = MMR0 & ~MMR0_IC;                                 /* usually off */
@@ -972,8 +1004,8 @@ while (reason == 0)  {
     saved_sim_interval = sim_interval;
     if (BPT_SUMM_PC) {                                  /* possible breakpoint */
         t_addr pa = relocC (PC, 0);                     /* relocate PC */
-        if (sim_brk_test (PC, BPT_PCVIR) ||             /* Normal PC breakpoint? */
-            sim_brk_test (pa, BPT_PCPHY))               /* Physical Address breakpoint? */
+        if (BPT_TEST (PC, BPT_PCVIR) ||                 /* Normal PC breakpoint? */
+            BPT_TEST (pa, BPT_PCPHY))                   /* Physical Address breakpoint? */
             ABORT (ABRT_BKPT);                          /* stop simulation */
         }
 
@@ -983,6 +1015,7 @@ while (reason == 0)  {
         }
     IR = ReadE (PC | isenable);                         /* fetch instruction */
     sim_interval = sim_interval - 1;
+    SIM_OPSTATS_COUNT (&cpu_opstats, IR);               /* opcode statistics */
     srcspec = (IR >> 6) & 077;                          /* src, dst specs */
     dstspec = IR & 077;
     srcreg = (srcspec <= 07);                           /* src, dst = rmode? */
@@ -1049,6 +1082,7 @@ while (reason == 0)  {
                     STKLIM = 0;                         /* clear STKLIM */
                     MMR0 = 0;                           /* clear MMR0 */
                     MMR3 = 0;                           /* clear MMR3 */
+                    reloc_build_all ();                 /* 18b relocation */
                     cpu_bme = 0;                        /* (also clear bme) */
                     for (i = 0; i < IPL_HLVL; i++)
                         int_req[i] = 0;
@@ -2642,8 +2676,8 @@ if ((va & 1) && CPUT (HAS_ODD)) {                       /* odd address? */
     }
 pa = relocR (va);                                       /* relocate */
 if (BPT_SUMM_RD &&
-    (sim_brk_test (va & 0177777, BPT_RDVIR) ||
-     sim_brk_test (pa, BPT_RDPHY)))                     /* read breakpoint? */
+    (BPT_TEST (va & 0177777, BPT_RDVIR) ||
+     BPT_TEST (pa, BPT_RDPHY)))                         /* read breakpoint? */
     ABORT (ABRT_BKPT);                                  /* stop simulation */
 if (ADDR_IS_MEM (pa))                                   /* memory address? */
     return RdMemW (pa);
@@ -2669,8 +2703,8 @@ if ((va & 1) && CPUT (HAS_ODD)) {                       /* odd address? */
     }
 pa = relocR (va);                                       /* relocate */
 if (BPT_SUMM_RD &&
-    (sim_brk_test (va & 0177777, BPT_RDVIR) ||
-     sim_brk_test (pa, BPT_RDPHY)))                     /* read breakpoint? */
+    (BPT_TEST (va & 0177777, BPT_RDVIR) ||
+     BPT_TEST (pa, BPT_RDPHY)))                         /* read breakpoint? */
     ABORT (ABRT_BKPT);                                  /* stop simulation */
 return PReadW (pa);
 }
@@ -2681,8 +2715,8 @@ int32 pa;
 
 pa = relocR (va);                                       /* relocate */
 if (BPT_SUMM_RD &&
-    (sim_brk_test (va & 0177777, BPT_RDVIR) ||
-     sim_brk_test (pa, BPT_RDPHY)))                     /* read breakpoint? */
+    (BPT_TEST (va & 0177777, BPT_RDVIR) ||
+     BPT_TEST (pa, BPT_RDPHY)))                         /* read breakpoint? */
     ABORT (ABRT_BKPT);                                  /* stop simulation */
 return PReadB (pa);
 }
@@ -2700,8 +2734,8 @@ if ((va & 1) && CPUT (HAS_ODD)) {                       /* odd address? */
     }
 pa = relocR (va);                                       /* relocate */
 if (BPT_SUMM_RD &&
-    (sim_brk_test (va & 0177777, BPT_RDVIR) ||
-     sim_brk_test (pa, BPT_RDPHY)))                     /* read breakpoint? */
+    (BPT_TEST (va & 0177777, BPT_RDVIR) ||
+     BPT_TEST (pa, BPT_RDPHY)))                         /* read breakpoint? */
     reason = STOP_IBKPT;                                /* report that */
 return PReadW (pa);
 }
@@ -2714,8 +2748,8 @@ if ((va & 1) && CPUT (HAS_ODD)) {                       /* odd address? */
     }
 last_pa = relocW (va);                                  /* reloc, wrt chk */
 if (BPT_SUMM_RW &&
-    (sim_brk_test (va & 0177777, BPT_RWVIR) ||
-     sim_brk_test (last_pa, BPT_RWPHY)))                /* read or write breakpoint? */
+    (BPT_TEST (va & 0177777, BPT_RWVIR) ||
+     BPT_TEST (last_pa, BPT_RWPHY)))                    /* read or write breakpoint? */
     ABORT (ABRT_BKPT);                                  /* stop simulation */
 return PReadW (last_pa);
 }
@@ -2724,8 +2758,8 @@ int32 ReadMB (int32 va)
 {
 last_pa = relocW (va);                                  /* reloc, wrt chk */
 if (BPT_SUMM_RW &&
-    (sim_brk_test (va & 0177777, BPT_RWVIR) ||
-     sim_brk_test (last_pa, BPT_RWPHY)))                /* read or write breakpoint? */
+    (BPT_TEST (va & 0177777, BPT_RWVIR) ||
+     BPT_TEST (last_pa, BPT_RWPHY)))                    /* read or write breakpoint? */
     ABORT (ABRT_BKPT);                                  /* stop simulation */
 return PReadB (last_pa);
 }
@@ -2783,8 +2817,8 @@ if ((va & 1) && CPUT (HAS_ODD)) {                       /* odd address? */
     }
 pa = relocW (va);                                       /* relocate */
 if (BPT_SUMM_WR &&
-    (sim_brk_test (va & 0177777, BPT_WRVIR) ||
-     sim_brk_test (pa, BPT_WRPHY)))                     /* write breakpoint? */
+    (BPT_TEST (va & 0177777, BPT_WRVIR) ||
+     BPT_TEST (pa, BPT_WRPHY)))                         /* write breakpoint? */
     ABORT (ABRT_BKPT);                                  /* stop simulation */
 PWriteW (data, pa);
 }
@@ -2795,8 +2829,8 @@ int32 pa;
 
 pa = relocW (va);                                       /* relocate */
 if (BPT_SUMM_WR &&
-    (sim_brk_test (va & 0177777, BPT_WRVIR) ||
-     sim_brk_test (pa, BPT_WRPHY)))                     /* write breakpoint? */
+    (BPT_TEST (va & 0177777, BPT_WRVIR) ||
+     BPT_TEST (pa, BPT_WRPHY)))                         /* write breakpoint? */
     ABORT (ABRT_BKPT);                                  /* stop simulation */
 PWriteB (data, pa);
 }
@@ -2814,8 +2848,8 @@ if ((va & 1) && CPUT (HAS_ODD)) {                       /* odd address? */
     }
 pa = relocW (va);                                       /* relocate */
 if (BPT_SUMM_WR &&
-    (sim_brk_test (va & 0177777, BPT_WRVIR) ||
-     sim_brk_test (pa, BPT_WRPHY)))                     /* write breakpoint? */
+    (BPT_TEST (va & 0177777, BPT_WRVIR) ||
+     BPT_TEST (pa, BPT_WRPHY)))                         /* write breakpoint? */
     reason = STOP_IBKPT;                                /* report that */
 PWriteW (data, pa);
 }
@@ -2864,6 +2898,8 @@ return;
    with an appropriate trap code.
 
    Notes:
+   - References which hit in the relocation cache are done first,
+     with a single range check
    - The 'normal' read codes (010, 110) are done in-line; all
      others in a subroutine
    - APRFILE[UNUSED] is all zeroes, forcing non-resident abort
@@ -2876,6 +2912,9 @@ int32 apridx, apr, pa;
 
 if (MMR0 & MMR0_MME) {                                  /* if mmgt */
     apridx = (va >> VA_V_APF) & 077;                    /* index into APR */
+    if ((reloc_tab[apridx].acc & RLC_R) &&              /* reloc cache hit? */
+        (((uint32) ((va & VA_DF) - reloc_tab[apridx].lo)) <= (uint32) reloc_tab[apridx].span))
+        return (va & VA_DF) + reloc_tab[apridx].base;
     apr = APRFILE[apridx];                              /* with va<18:13> */
     if ((apr & PDR_PRD) != 2)                           /* not 2, 6? */
          relocR_test (va, apridx);                      /* long test */
@@ -2973,6 +3012,9 @@ return;
    with an appropriate trap code.
 
    Notes:
+   - References which hit in the relocation cache are done first,
+     with a single range check; only pages with PDR<W> already set
+     are in the cache
    - The 'normal' write code (110) is done in-line; all others
      in a subroutine
    - APRFILE[UNUSED] is all zeroes, forcing non-resident abort
@@ -2985,12 +3027,18 @@ int32 apridx, apr, pa;
 
 if (MMR0 & MMR0_MME) {                                  /* if mmgt */
     apridx = (va >> VA_V_APF) & 077;                    /* index into APR */
+    if ((reloc_tab[apridx].acc & RLC_W) &&              /* reloc cache hit? */
+        (((uint32) ((va & VA_DF) - reloc_tab[apridx].lo)) <= (uint32) reloc_tab[apridx].span))
+        return (va & VA_DF) + reloc_tab[apridx].base;
     apr = APRFILE[apridx];                              /* with va<18:13> */
     if ((apr & PDR_ACF) != 6)                           /* not writeable? */
         relocW_test (va, apridx);                       /* long test */
     if (PLF_test (va, apr))                             /* pg lnt error? */
         reloc_abort (MMR0_PL, apridx);
-    APRFILE[apridx] |= PDR_W;                           /* set W */
+    if ((apr & PDR_W) == 0) {                           /* first write? */
+        APRFILE[apridx] |= PDR_W;                       /* set W */
+        reloc_build (apridx);
+        }
     pa = ((va & VA_DF) + ((apr >> 10) & 017777700)) & PAMASK;
     if ((MMR3 & MMR3_M22E) == 0) {
         pa = pa & 0777777;
@@ -3058,6 +3106,55 @@ reloc_abort (err, apridx);
 return;
 }
 
+/* Relocation cache
+
+   The relocation cache holds, for each APR, the result of the checks
+   done by relocR and relocW which depend only on the APR and MMR3: the
+   access (readable; read/write with PDR<W> already set), the range of
+   displacements allowed by the page length and expansion direction, and
+   the physical base address.  A page is only cached if every
+   displacement in it relocates with a simple add, i.e. the page does not
+   wrap 22b memory or, with 18b mapping, reach the I/O page.  The cache is
+   rebuilt for an APR whenever the APR is written, and in full when MMR3
+   changes and on every entry to sim_instr (the console can change the
+   APRs and MMR3).  MMR0<MME> is tested in-line, so changes to MMR0 do not
+   affect the cache.
+*/
+
+void reloc_build (int32 apridx)
+{
+RELOCENT *rp = &reloc_tab[apridx];
+int32 apr = APRFILE[apridx];
+int32 plf = (apr & PDR_PLF) >> 2;                       /* extr page length */
+
+rp->base = (apr >> 10) & 017777700;
+rp->acc = 0;
+if ((MMR3 & MMR3_M22E)?                                 /* simple add? */
+    ((rp->base + VA_DF) > PAMASK):
+    ((rp->base + VA_DF) >= 0760000))
+    return;
+if ((apr & PDR_PRD) == 2)                               /* readable? */
+    rp->acc = RLC_R;
+if (((apr & PDR_ACF) == 6) && (apr & PDR_W))            /* written r/w? */
+    rp->acc |= RLC_W;
+if (apr & PDR_ED) {                                     /* expand down? */
+    rp->lo = plf;
+    rp->span = VA_DF - plf;
+    }
+else {
+    rp->lo = 0;
+    rp->span = plf | (VA_DF & ~VA_BN);
+    }
+}
+
+void reloc_build_all (void)
+{
+int32 i;
+
+for (i = 0; i < 64; i++)
+    reloc_build (i);
+}
+
 /* Relocate virtual address, console access
 
    Inputs:
@@ -3170,6 +3267,7 @@ if (pa & 1)
 MMR3 = data & cpu_tab[cpu_model].mm3;
 cpu_bme = (MMR3 & MMR3_BME) && (cpu_opt & OPT_UBM);
 dsenable = calc_ds (cm);
+reloc_build_all ();                                     /* 18b vs 22b */
 return SCPE_OK;
 }
 
@@ -3250,6 +3348,7 @@ if (left)
         (((uint32) (data & cpu_tab[cpu_model].par)) << 16)) & ~(PDR_A|PDR_W);
 else APRFILE[idx] = ((APRFILE[idx] & ~0177777) |
     (data & cpu_tab[cpu_model].pdr)) & ~(PDR_A|PDR_W);
+reloc_build (idx);
 return SCPE_OK;
 }
 
@@ -3465,12 +3564,16 @@ MMR0 = 0;
 MMR1 = 0;
 MMR2 = 0;
 MMR3 = 0;
+reloc_build_all ();
 trap_req = 0;
 wait_state = 0;
 if (M == NULL) {                    /* First time init */
     M = (uint16 *) calloc (MEMSIZE >> 1, sizeof (uint16));
     if (M == NULL)
         return SCPE_MEM;
+#if !defined (UC15)
+    sim_register_memory (&cpu_unit, (void **)&M);   /* direct SAVE/RESTORE */
+#endif
     sim_set_pchar (0, "01000023640"); /* ESC, CR, LF, TAB, BS, BEL, ENQ */
     sim_brk_dflt = SWMASK ('E');
     sim_brk_types = sim_brk_dflt|SWMASK ('P')|
@@ -3553,6 +3656,38 @@ PSW = 000340;
 return;
 }
 
+/* Opcode statistics name and class */
+
+const char *cpu_opstats_name (uint32 op)
+{
+return opcode_name (op);
+}
+
+uint32 cpu_opstats_class (uint32 op)
+{
+if ((op & 0170000) == 0170000)                          /* 17xxxx: FP11 */
+    return 7;
+if ((op & 0170000) == 0070000) {                        /* 07xxxx */
+    if (op < 075000)                                    /* MUL..XOR */
+        return 4;
+    if (op < 076000)
+        return 5;
+    if (op < 077000)
+        return 6;
+    return 3;                                           /* SOB */
+    }
+if (op & 0070000)                                       /* 01-06, 11-16 */
+    return 0;
+if (((op & 0177400) != 0) && ((op & 0077400) < 0004000))/* 0004xx-0037xx, 1000xx-1037xx */
+    return 2;
+if ((op & 0177000) == 0104000)                          /* EMT, TRAP */
+    return 3;
+if ((op < 000300) || ((op & 0177000) == 0004000) ||     /* specials, JMP, RTS, CCs, JSR */
+    ((op & 0177700) == 0006400))                        /* MARK */
+    return 3;
+return 1;
+}
+
 /* Memory examine */
 
 t_stat cpu_ex (t_value *vptr, t_addr addr, UNIT *uptr, int32 sw)
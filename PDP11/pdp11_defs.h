@@ -873,6 +873,7 @@ typedef struct pdp_dib DIB;
 #define BPT_SUMM_RD (sim_brk_summ & (BPT_RDVIR | BPT_RDPHY))
 #define BPT_SUMM_WR (sim_brk_summ & (BPT_WRVIR | BPT_WRPHY))
 #define BPT_SUMM_RW (sim_brk_summ & (BPT_RWVIR | BPT_RWPHY))
+#define BPT_TEST(a,t) (sim_brk_maybe (a) && sim_brk_test ((a), (t)))
 
 /* Function prototypes */
 
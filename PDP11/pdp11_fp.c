@@ -848,10 +848,10 @@ if ((VA & 1) && CPUT (HAS_ODD)) {                       /* odd address? */
 pa = relocW (VA);                                       /* relocate */
 pa2 = relocW ((VA & ~0177777) | ((VA + 2) & 0177777));
 if (BPT_SUMM_WR &&
-    (sim_brk_test (VA & 0177777, BPT_WRVIR) ||
-     sim_brk_test (pa, BPT_WRPHY) ||
-     sim_brk_test ((VA + 2) & 0177777, BPT_WRVIR) ||
-     sim_brk_test (pa2, BPT_WRPHY)))                    /* write breakpoint? */
+    (BPT_TEST (VA & 0177777, BPT_WRVIR) ||
+     BPT_TEST (pa, BPT_WRPHY) ||
+     BPT_TEST ((VA + 2) & 0177777, BPT_WRVIR) ||
+     BPT_TEST (pa2, BPT_WRPHY)))                        /* write breakpoint? */
     ABORT (ABRT_BKPT);                                  /* stop simulation */
 PWriteW ((data >> 16) & 0177777, pa);
 PWriteW (data & 0177777, pa2);
@@ -892,24 +892,24 @@ pa = relocW (VA);                                       /* relocate */
 pa2 = relocW (exta | ((VA + 2) & 0177777));
 if (len == LONG) {
     if (BPT_SUMM_WR &&
-        (sim_brk_test (VA & 0177777, BPT_WRVIR) ||
-         sim_brk_test (pa, BPT_WRPHY) ||
-         sim_brk_test ((VA + 2) & 0177777, BPT_WRVIR) ||
-         sim_brk_test (pa2, BPT_WRPHY)))                /* write breakpoint? */
+        (BPT_TEST (VA & 0177777, BPT_WRVIR) ||
+         BPT_TEST (pa, BPT_WRPHY) ||
+         BPT_TEST ((VA + 2) & 0177777, BPT_WRVIR) ||
+         BPT_TEST (pa2, BPT_WRPHY)))                    /* write breakpoint? */
         ABORT (ABRT_BKPT);                              /* stop simulation */
     }
 else {
     pa3 = relocW (exta | ((VA + 4) & 0177777));
     pa4 = relocW (exta | ((VA + 6) & 0177777));
     if (BPT_SUMM_WR &&
-        (sim_brk_test (VA & 0177777, BPT_WRVIR) ||
-         sim_brk_test (pa, BPT_WRPHY) ||
-         sim_brk_test ((VA + 2) & 0177777, BPT_WRVIR) ||
-         sim_brk_test (pa2, BPT_WRPHY) ||
-         sim_brk_test ((VA + 4) & 0177777, BPT_WRVIR) ||
-         sim_brk_test (pa3, BPT_WRPHY) ||
-         sim_brk_test ((VA + 6) & 0177777, BPT_WRVIR) ||
-         sim_brk_test (pa4, BPT_WRPHY)))                /* write breakpoint? */
+        (BPT_TEST (VA & 0177777, BPT_WRVIR) ||
+         BPT_TEST (pa, BPT_WRPHY) ||
+         BPT_TEST ((VA + 2) & 0177777, BPT_WRVIR) ||
+         BPT_TEST (pa2, BPT_WRPHY) ||
+         BPT_TEST ((VA + 4) & 0177777, BPT_WRVIR) ||
+         BPT_TEST (pa3, BPT_WRPHY) ||
+         BPT_TEST ((VA + 6) & 0177777, BPT_WRVIR) ||
+         BPT_TEST (pa4, BPT_WRPHY)))                    /* write breakpoint? */
         ABORT (ABRT_BKPT);                              /* stop simulation */
     }
 
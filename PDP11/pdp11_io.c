@@ -231,6 +231,57 @@ else uba_last = (IOPAGEBASE + off) & PAMASK;            /* yes, use fixed */
 return uba_last;
 }
 
+/* Block transfers between memory and a buffer
+
+   The caller guarantees that the whole span is in memory.  Memory is an
+   array of host order words, so word spans can always be copied directly;
+   byte spans can only be copied directly on a little-endian host.
+*/
+
+static void Mem_ReadB (uint32 ma, uint32 bc, uint8 *buf)
+{
+#if !defined (UC15)
+if (sim_end) {                                          /* little endian? */
+    memcpy (buf, ((uint8 *) M) + ma, bc);
+    return;
+    }
+#endif
+for ( ; bc; ma++, bc--)                                 /* by bytes */
+    *buf++ = (uint8) RdMemB (ma);
+}
+
+static void Mem_ReadW (uint32 ma, uint32 bc, uint16 *buf)
+{
+#if !defined (UC15)
+memcpy (buf, M + (ma >> 1), bc);
+#else
+for ( ; bc; ma = ma + 2, bc = bc - 2)                   /* by words */
+    *buf++ = (uint16) RdMemW (ma);
+#endif
+}
+
+static void Mem_WriteB (uint32 ma, uint32 bc, const uint8 *buf)
+{
+#if !defined (UC15)
+if (sim_end) {                                          /* little endian? */
+    memcpy (((uint8 *) M) + ma, buf, bc);
+    return;
+    }
+#endif
+for ( ; bc; ma++, bc--)                                 /* by bytes */
+    WrMemB (ma, ((uint16) *buf++));
+}
+
+static void Mem_WriteW (uint32 ma, uint32 bc, const uint16 *buf)
+{
+#if !defined (UC15)
+memcpy (M + (ma >> 1), buf, bc);
+#else
+for ( ; bc; ma = ma + 2, bc = bc - 2)                   /* by words */
+    WrMemW (ma, *buf++);
+#endif
+}
+
 /* I/O buffer routines, aligned access
 
    Map_ReadB    -       fetch byte buffer from memory
@@ -249,11 +300,19 @@ return uba_last;
      trimmed to 18b.
    - In a Qbus configuration, the map is always disabled.
      Device addresses are trimmed to 22b.
+
+   With the map enabled, the transfer is done in runs: each map
+   register is used once for the part of the transfer within its
+   8KB page, and the run is copied as a block.  A run which is not
+   entirely in memory is done a byte or word at a time, so that the
+   transfer stops at the first nonexistent address, as before.
+   The last mapped address is left as if the transfer had been
+   done a byte or word at a time.
 */
 
 int32 Map_ReadB (uint32 ba, int32 bc, uint8 *buf)
 {
-uint32 alim, lim, ma;
+uint32 alim, lim, ma, n;
 
 /* I/O Page DMA only on Unibus systems */
 if (UNIBUS && (ba >= (uint32)(IOPAGEBASE & UNIMASK))) {
@@ -272,11 +331,24 @@ if (UNIBUS && (ba >= (uint32)(IOPAGEBASE & UNIMASK))) {
 ba = ba & BUSMASK;                                      /* trim address */
 lim = ba + bc;
 if (cpu_bme) {                                          /* map enabled? */
-    for ( ; ba < lim; ba++) {                           /* by bytes */
+    while (ba < lim) {                                  /* by map pages */
+        n = UBM_PAGSIZE - UBM_GETOFF (ba);              /* rest of page */
+        if (n > (lim - ba))
+            n = lim - ba;
         ma = Map_Addr (ba);                             /* map addr */
-        if (!ADDR_IS_MEM (ma))                          /* NXM? err */
-            return (lim - ba);
-        *buf++ = (uint8) RdMemB (ma);                   /* get byte */
+        if (!ADDR_IS_MEM (ma) || !ADDR_IS_MEM (ma + n - 1)) {
+            for ( ; n; ba++, n--) {                     /* by bytes */
+                ma = Map_Addr (ba);                     /* map addr */
+                if (!ADDR_IS_MEM (ma))                  /* NXM? err */
+                    return (lim - ba);
+                *buf++ = (uint8) RdMemB (ma);           /* get byte */
+                }
+            continue;
+            }
+        Mem_ReadB (ma, n, buf);                         /* copy run */
+        uba_last = ma + n - 1;
+        ba = ba + n;
+        buf = buf + n;
         }
     return 0;
     }
@@ -286,16 +358,15 @@ else {                                                  /* physical */
     else if (ADDR_IS_MEM (ba))                          /* no, strt ok? */
         alim = MEMSIZE;
     else return bc;                                     /* no, err */
-    for ( ; ba < alim; ba++) {                          /* by bytes */
-        *buf++ = (uint8) RdMemB (ba);                   /* get byte */
-        }
+    if (alim > ba)
+        Mem_ReadB (ba, alim - ba, buf);                 /* copy block */
     return (lim - alim);
     }
 }
 
 int32 Map_ReadW (uint32 ba, int32 bc, uint16 *buf)
 {
-uint32 alim, lim, ma;
+uint32 alim, lim, ma, n;
 
 /* I/O Page DMA only on Unibus systems */
 if (UNIBUS && (ba >= (uint32)(IOPAGEBASE & UNIMASK))) {
@@ -315,11 +386,24 @@ if (UNIBUS && (ba >= (uint32)(IOPAGEBASE & UNIMASK))) {
 ba = (ba & BUSMASK) & ~01;                              /* trim, align addr */
 lim = ba + (bc & ~01);
 if (cpu_bme) {                                          /* map enabled? */
-    for (; ba < lim; ba = ba + 2) {                     /* by words */
+    while (ba < lim) {                                  /* by map pages */
+        n = UBM_PAGSIZE - UBM_GETOFF (ba);              /* rest of page */
+        if (n > (lim - ba))
+            n = lim - ba;
         ma = Map_Addr (ba);                             /* map addr */
-        if (!ADDR_IS_MEM (ma))                          /* NXM? err */
-            return (lim - ba);
-        *buf++ = (uint16) RdMemW (ma);
+        if (!ADDR_IS_MEM (ma) || !ADDR_IS_MEM (ma + n - 2)) {
+            for ( ; n; ba = ba + 2, n = n - 2) {        /* by words */
+                ma = Map_Addr (ba);                     /* map addr */
+                if (!ADDR_IS_MEM (ma))                  /* NXM? err */
+                    return (lim - ba);
+                *buf++ = (uint16) RdMemW (ma);
+                }
+            continue;
+            }
+        Mem_ReadW (ma, n, buf);                         /* copy run */
+        uba_last = ma + n - 2;
+        ba = ba + n;
+        buf = buf + (n >> 1);
         }
     return 0;
     }
@@ -329,16 +413,15 @@ else {                                                  /* physical */
     else if (ADDR_IS_MEM (ba))                          /* no, strt ok? */
         alim = MEMSIZE;
     else return bc;                                     /* no, err */
-    for ( ; ba < alim; ba = ba + 2) {                   /* by words */
-        *buf++ = (uint16) RdMemW (ba);
-        }
+    if (alim > ba)
+        Mem_ReadW (ba, alim - ba, buf);                 /* copy block */
     return (lim - alim);
     }
 }
 
 int32 Map_WriteB (uint32 ba, int32 bc, const uint8 *buf)
 {
-uint32 alim, lim, ma;
+uint32 alim, lim, ma, n;
 
 /* I/O Page DMA only on Unibus systems */
 if (UNIBUS && (ba >= (uint32)(IOPAGEBASE & UNIMASK))) {
@@ -354,11 +437,24 @@ if (UNIBUS && (ba >= (uint32)(IOPAGEBASE & UNIMASK))) {
 ba = ba & BUSMASK;                                      /* trim address */
 lim = ba + bc;
 if (cpu_bme) {                                          /* map enabled? */
-    for ( ; ba < lim; ba++) {                           /* by bytes */
+    while (ba < lim) {                                  /* by map pages */
+        n = UBM_PAGSIZE - UBM_GETOFF (ba);              /* rest of page */
+        if (n > (lim - ba))
+            n = lim - ba;
         ma = Map_Addr (ba);                             /* map addr */
-        if (!ADDR_IS_MEM (ma))                          /* NXM? err */
-            return (lim - ba);
-        WrMemB (ma, ((uint16) *buf++));
+        if (!ADDR_IS_MEM (ma) || !ADDR_IS_MEM (ma + n - 1)) {
+            for ( ; n; ba++, n--) {                     /* by bytes */
+                ma = Map_Addr (ba);                     /* map addr */
+                if (!ADDR_IS_MEM (ma))                  /* NXM? err */
+                    return (lim - ba);
+                WrMemB (ma, ((uint16) *buf++));
+                }
+            continue;
+            }
+        Mem_WriteB (ma, n, buf);                        /* copy run */
+        uba_last = ma + n - 1;
+        ba = ba + n;
+        buf = buf + n;
         }
     return 0;
     }
@@ -368,16 +464,15 @@ else {                                                  /* physical */
     else if (ADDR_IS_MEM (ba))                          /* no, strt ok? */
         alim = MEMSIZE;
     else return bc;                                     /* no, err */
-    for ( ; ba < alim; ba++) {                          /* by bytes */
-        WrMemB (ba, ((uint16) *buf++));
-        }
+    if (alim > ba)
+        Mem_WriteB (ba, alim - ba, buf);                /* copy block */
     return (lim - alim);
     }
 }
 
 int32 Map_WriteW (uint32 ba, int32 bc, const uint16 *buf)
 {
-uint32 alim, lim, ma;
+uint32 alim, lim, ma, n;
 
 /* I/O Page DMA only on Unibus systems */
 if (UNIBUS && (ba >= (uint32)(IOPAGEBASE & UNIMASK))) {
@@ -395,11 +490,24 @@ if (UNIBUS && (ba >= (uint32)(IOPAGEBASE & UNIMASK))) {
 ba = (ba & BUSMASK) & ~01;                              /* trim, align addr */
 lim = ba + (bc & ~01);
 if (cpu_bme) {                                          /* map enabled? */
-    for (; ba < lim; ba = ba + 2) {                     /* by words */
+    while (ba < lim) {                                  /* by map pages */
+        n = UBM_PAGSIZE - UBM_GETOFF (ba);              /* rest of page */
+        if (n > (lim - ba))
+            n = lim - ba;
         ma = Map_Addr (ba);                             /* map addr */
-        if (!ADDR_IS_MEM (ma))                          /* NXM? err */
-            return (lim - ba);
-        WrMemW (ma, *buf++);
+        if (!ADDR_IS_MEM (ma) || !ADDR_IS_MEM (ma + n - 2)) {
+            for ( ; n; ba = ba + 2, n = n - 2) {        /* by words */
+                ma = Map_Addr (ba);                     /* map addr */
+                if (!ADDR_IS_MEM (ma))                  /* NXM? err */
+                    return (lim - ba);
+                WrMemW (ma, *buf++);
+                }
+            continue;
+            }
+        Mem_WriteW (ma, n, buf);                        /* copy run */
+        uba_last = ma + n - 2;
+        ba = ba + n;
+        buf = buf + (n >> 1);
         }
     return 0;
     }
@@ -409,9 +517,8 @@ else {                                                  /* physical */
     else if (ADDR_IS_MEM (ba))                          /* no, strt ok? */
         alim = MEMSIZE;
     else return bc;                                     /* no, err */
-    for ( ; ba < alim; ba = ba + 2) {                   /* by words */
-        WrMemW (ba, *buf++);
-        }
+    if (alim > ba)
+        Mem_WriteW (ba, alim - ba, buf);                /* copy block */
     return (lim - alim);
     }
 }
@@ -2317,9 +2317,9 @@ if ((cmd == OP_ERS) || (cmd == OP_WR)) {                /* write op? */
 if (!uptr->io_complete) { /* Top End (I/O Initiation) Processing */
     if (cmd == OP_ERS) {                                /* erase? */
         wwc = ((tbc + (RQ_NUMBY - 1)) & ~(RQ_NUMBY - 1)) >> 1;
-        memset (uptr->rqxb, 0, wwc * sizeof(uint16));   /* clr buf */
-        sim_disk_data_trace(uptr, (uint8 *)uptr->rqxb, bl, wwc << 1, "sim_disk_wrsect-ERS", DBG_DAT & rq_devmap[cp->cnum]->dctrl, DBG_REQ);
-        err = sim_disk_wrsect_a (uptr, bl, (uint8 *)uptr->rqxb, NULL, (wwc << 1) / RQ_NUMBY, rq_io_complete);
+        sim_debug (DBG_REQ, rq_devmap[cp->cnum], "sim_disk_trim(lbn=%X, sects=%d)\n", bl, (wwc << 1) / RQ_NUMBY);
+        err = sim_disk_trim (uptr, bl, (wwc << 1) / RQ_NUMBY);/* discard, reads as zeros */
+        rq_io_complete (uptr, err);
         }
 
     else if (cmd == OP_WR) {                            /* write? */
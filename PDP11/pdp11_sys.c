@@ -603,6 +603,20 @@ switch (mode) {
 return ((reg == 07)? pcwd[mode]: rgwd[mode]);
 }
 
+/* Opcode name for an instruction word, or NULL if none matches */
+
+const char *opcode_name (int32 inst)
+{
+int32 i, j;
+
+for (i = 0; opc_val[i] >= 0; i++) {                     /* loop thru ops */
+    j = (opc_val[i] >> I_V_CL) & I_M_CL;                /* get class */
+    if ((opc_val[i] & 0777777) == (inst & masks[j]))    /* match? */
+        return opcode[i];
+    }
+return NULL;
+}
+
 /* Symbolic decode
 
    Inputs:
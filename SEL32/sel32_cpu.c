@@ -180,6 +180,8 @@ t_stat cpu_set_hist(UNIT * uptr, int32 val, CONST char *cptr, void *desc);
 uint32 cpu_cmd(UNIT * uptr, uint16 cmd, uint16 dev);
 t_stat cpu_help (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, const char *cptr);
 const char *cpu_description (DEVICE *dptr);
+const char *cpu_opstats_name(uint32 op);
+uint32 cpu_opstats_class(uint32 op);
 t_stat RealAddr(uint32 addr, uint32 *realaddr, uint32 *prot, uint32 access);
 t_stat load_maps(uint32 thepsd[2], uint32 lmap);
 t_stat read_instruction(uint32 thepsd[2], uint32 *instr);
@@ -198,6 +200,7 @@ extern t_stat rsctlxio(uint16 addr, uint32 *status);    /* reset controller XIO
 extern t_stat chan_set_devs();                          /* set up the defined devices on the simulator */
 extern uint32 scan_chan(uint32 *ilev);                  /* go scan for I/O int pending */
 extern uint32 cont_chan(uint16 chsa);                   /* continue channel program */
+extern const char *opcode_name(uint16 inst, int base, int *halfword); /* opcode name in sys.c */
 extern uint16 loading;                                  /* set when doing IPL */
 extern int fprint_inst(FILE *of, uint32 val, int32 sw); /* instruction print function */
 extern int irq_pend;                                    /* go scan for pending interrupt */
@@ -291,6 +294,17 @@ REG cpu_reg[] = {
     {NULL}
 };
 
+/* Per-opcode statistics, indexed by the upper instruction halfword */
+/* with bit 16 set for instructions executed in base register mode */
+static const char * const cpu_opstats_classes[] = {
+    "Fullword", "Halfword"
+};
+
+SIM_OPSTATS cpu_opstats = {
+    0x20000, &cpu_opstats_name, &cpu_opstats_class,
+    cpu_opstats_classes, 2
+};
+
 /* Modifier table layout (MTAB) - only extended entries have disp, reg, or flags */
 MTAB cpu_mod[] = {
     {
@@ -338,6 +352,11 @@ MTAB cpu_mod[] = {
     {MTAB_XTD|MTAB_VDV, 0, NULL, "NOIDLE", &sim_clr_idle, NULL},
     {MTAB_XTD | MTAB_VDV | MTAB_NMO | MTAB_SHP, 0, "HISTORY", "HISTORY",
         &cpu_set_hist, &cpu_show_hist},
+    {MTAB_XTD | MTAB_VDV | MTAB_VALO | MTAB_NMO, 1, "OPSTATS", "OPSTATS{=COUNT|TIMING|RESET}",
+        &sim_set_opstats, &sim_show_opstats, (void *)&cpu_opstats,
+        "Enable/Display per-opcode execution statistics"},
+    {MTAB_XTD | MTAB_VDV, 0, NULL, "NOOPSTATS", &sim_set_opstats, NULL,
+        (void *)&cpu_opstats, "Disable per-opcode execution statistics"},
     {0}
 };
 
@@ -2199,6 +2218,7 @@ exec:
 
         opr = (IR >> 16) & MASK16;                  /* use upper half of instruction */
         OP = (opr >> 8) & 0xFC;                     /* Get opcode (bits 0-5) left justified */
+        SIM_OPSTATS_COUNT(&cpu_opstats, ((PSD1 & BASEBIT) ? 0x10000 : 0) | opr);
         FC =  ((IR & F_BIT) ? 0x4 : 0) | (IR & 3);  /* get F & C bits for addressing */
         reg = (opr >> 7) & 0x7;                     /* dest reg or xr on base mode */
         sreg = (opr >> 4) & 0x7;                    /* src reg for reg-reg instructions or BR instr */
@@ -7444,6 +7464,21 @@ t_stat cpu_reset(DEVICE *dptr)
     return SCPE_OK;
 }
 
+/* Opcode statistics name and class */
+const char *cpu_opstats_name(uint32 op)
+{
+    return opcode_name(op & 0xFFFF, (op & 0x10000) != 0, NULL);
+}
+
+uint32 cpu_opstats_class(uint32 op)
+{
+    int halfword = 0;
+
+    if (opcode_name(op & 0xFFFF, (op & 0x10000) != 0, &halfword) == NULL)
+        return 2;                                   /* unknown opcode */
+    return halfword ? 1 : 0;
+}
+
 /* Memory examine */
 /* examine a 32bit memory location and return a byte */
 t_stat cpu_ex(t_value *vptr, t_addr baddr, UNIT *uptr, int32 sw)
@@ -892,6 +892,27 @@ t_opcode  optab[] = {
     {  0xFC7F,  0xFC7F,   TYPE_C,     "DACI", },    /* Deactivate Channel Interrupt */
 };
 
+/* Opcode name for the upper halfword of an instruction, or NULL if none
+   matches.  base selects base register mode, halfword returns whether
+   the instruction is a halfword instruction. */
+const char *opcode_name(uint16 inst, int base, int *halfword)
+{
+    uint32   i;
+
+    for (i = 0; i < sizeof(optab)/sizeof(optab[0]); i++) {
+        if (optab[i].opbase != (inst & optab[i].mask))
+            continue;
+        if (base && (optab[i].type & (X | N)))
+            continue;                       /* non basemode instruction in base mode, skip */
+        if (!base && (optab[i].type & B))
+            continue;                       /* basemode instruction in nonbase mode, skip */
+        if (halfword)
+            *halfword = (optab[i].type & H) != 0;
+        return optab[i].name;
+    }
+    return NULL;
+}
+
 /* Instruction decode printing routine
    Inputs:
     *of       =       output stream
@@ -79,7 +79,8 @@ int32 i, t, src, src2, dst, sign, oc;
 int32 acc = ACC_MASK (USER);
 
 PC = PC & WMASK;                                        /* PC must be 16b */
-if (sim_brk_summ && sim_brk_test (PC, SWMASK ('E'))) {  /* breakpoint? */
+if (sim_brk_summ && sim_brk_maybe (PC) &&
+    sim_brk_test (PC, SWMASK ('E'))) {                  /* breakpoint? */
     ABORT (STOP_IBKPT);                                 /* stop simulation */
     }
 sim_interval = sim_interval - 1;                        /* count instr */
@@ -188,12 +188,19 @@
 
 #define UNIT_V_CONH     (UNIT_V_UF + 0)                 /* halt to console */
 #define UNIT_V_MSIZE    (UNIT_V_UF + 1)                 /* dummy */
+#define UNIT_V_NODIC    (UNIT_V_UF + 2)                 /* no decoded inst cache */
 #define UNIT_CONH       (1u << UNIT_V_CONH)
 #define UNIT_MSIZE      (1u << UNIT_V_MSIZE)
+#define UNIT_NODIC      (1u << UNIT_V_NODIC)
 #define GET_CUR         acc = ACC_MASK (PSL_GETCUR (PSL))
 
 #define OPND_SIZE       16
 #define INST_SIZE       52
+#define DIC_N_IDX       15                              /* decoded inst cache */
+#define DIC_SIZE        (1u << DIC_N_IDX)
+#define DIC_MASK        (DIC_SIZE - 1)
+#define DIC_MAXTOK      16                              /* max istream items */
+#define DIC_DECAY       65536                           /* invals between decays */
 #define op0             opnd[0]
 #define op1             opnd[1]
 #define op2             opnd[2]
@@ -233,6 +240,12 @@
                         r = arl; \
                         rh = arh
 
+typedef struct {
+    int32       pa;                                     /* physical PC, -1 = inv */
+    uint32      gen;                                    /* page generation */
+    int32       ntok;                                   /* # istream items */
+    int32       tok[DIC_MAXTOK];                        /* istream items */
+    } DICENT;
 
 uint32 *M = NULL;                                       /* memory */
 int32 R[16];                                            /* registers */
@@ -267,6 +280,18 @@ int32 cpu_astop = 0;
 int32 mchk_va, mchk_ref;                                /* mem ref param */
 int32 ibufl, ibufh;                                     /* prefetch buf */
 int32 ibcnt, ppc;                                       /* prefetch ctl */
+int32 *dic_rp = NULL, *dic_rend = NULL;                 /* decoded inst replay */
+int32 *dic_wp = NULL, *dic_wend = NULL;                 /* decoded inst record */
+static int32 dic_enab = 0;                              /* decoded inst cache on */
+static int32 dic_pa;                                    /* physical PC */
+static DICENT *dic_rec = NULL;                          /* entry being recorded */
+static DICENT dic[DIC_SIZE];                            /* decoded inst cache */
+uint32 dic_pgmap[DIC_PGMAP_SIZE];                       /* pages with entries */
+static uint32 dic_pggen[PASIZE >> VA_N_OFF];            /* page generations */
+static uint32 dic_pgwr[DIC_PGMAP_SIZE];                 /* pages invalidated */
+static uint32 dic_pgnc[DIC_PGMAP_SIZE];                 /* pages not cached */
+static uint32 dic_ninval = 0;                           /* invals since decay */
+static uint32 dic_nreplay = 0;                          /* insts replayed */
 uint32 cpu_idle_mask =                                  /* idle mask */
 #if defined (VAX_411) || defined (VAX_412)
                        VAX_IDLE_INFOSERVER;
@@ -317,6 +342,9 @@ extern int32 sys_model;
 
 t_stat cpu_reset (DEVICE *dptr);
 t_bool cpu_is_pc_a_subroutine_call (t_addr **ret_addrs);
+int32 cpu_profile_stack (t_addr *frames, int32 max);
+const char *cpu_opstats_name (uint32 op);
+uint32 cpu_opstats_class (uint32 op);
 t_stat cpu_ex (t_value *vptr, t_addr exta, UNIT *uptr, int32 sw);
 t_stat cpu_dep (t_value val, t_addr exta, UNIT *uptr, int32 sw);
 t_stat cpu_set_size (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
@@ -330,12 +358,26 @@ t_stat cpu_show_instruction_set (FILE *st, UNIT *uptr, int32 val, CONST void *de
 const char *cpu_description (DEVICE *dptr);
 int32 cpu_get_vsw (int32 sw);
 static SIM_INLINE int32 get_istr (int32 lnt, int32 acc);
+static SIM_INLINE void dic_lookup (int32 acc);
+static void dic_flush (void);
 int32 ReadOcta (int32 va, int32 *opnd, int32 j, int32 acc);
 t_bool cpu_show_opnd (FILE *st, InstHistory *h, int32 line);
 t_stat cpu_show_hist_records (FILE *st, t_bool do_header, int32 start, int32 count);
 int32 cpu_emulate_exception (int32 *opnd, int32 cc, int32 opc, int32 acc);
 void cpu_idle (void);
 
+/* Per-opcode statistics, indexed by opcode (0x1xx for FD prefixed opcodes)
+   and classed by instruction group */
+
+static const char * const cpu_opstats_classes[] = {
+    "Reserved", "Base", "G-float", "D-float", "Packed", "Extended", "Emulated", "Vector"
+    };
+
+SIM_OPSTATS cpu_opstats = {
+    NUM_INST, &cpu_opstats_name, &cpu_opstats_class,
+    cpu_opstats_classes, IG_MAX_GRP + 1
+    };
+
 /* CPU data structures
 
    cpu_dev      CPU device descriptor
@@ -424,12 +466,15 @@ REG cpu_reg[] = {
     { HRDATA (BADABO, badabo, 32), REG_HRO },
     { HRDATAD (WRU, sim_int_char, 8, "interrupt character") },
     { HRDATA (MODEL, sys_model, 32), REG_HRO },
+    { DRDATAD (DICREPLAY, dic_nreplay, 32, "decoded instructions replayed") },
     { NULL }
     };
 
 MTAB cpu_mod[] = {
     { UNIT_CONH, 0, "HALT to SIMH", "SIMHALT", NULL, NULL, NULL, "Set HALT to trap to simulator" },
     { UNIT_CONH, UNIT_CONH, "HALT to console", "CONHALT", NULL, NULL, NULL, "Set HALT to trap to console ROM" },
+    { UNIT_NODIC, 0, NULL, "DICACHE", NULL, NULL, NULL, "Enable the decoded instruction cache" },
+    { UNIT_NODIC, UNIT_NODIC, "no decoded instruction cache", "NODICACHE", NULL, NULL, NULL, "Disable the decoded instruction cache" },
     { MTAB_XTD|MTAB_VDV, 0, "IDLE", "IDLE{=VMS|ULTRIX|ULTRIX-1.X|ULTRIXOLD|NETBSD|NETBSDOLD|OPENBSD|OPENBSDOLD|QUASIJARUS|32V|ELN|MDM|INFOSERVER}{:n}", &cpu_set_idle, &cpu_show_idle, NULL, "Display idle detection mode" },
     { MTAB_XTD|MTAB_VDV, 0, NULL, "NOIDLE", &sim_clr_idle, NULL, NULL,  "Disables idle detection" },
     MEM_MODIFIERS,   /* Model specific memory modifiers from vaxXXX_defs.h */
@@ -437,6 +482,10 @@ MTAB cpu_mod[] = {
       &cpu_set_hist, &cpu_show_hist, NULL, "Enable/Display instruction history" },
     { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP, 0, "VIRTUAL", NULL,
       NULL, &cpu_show_virt, NULL, "show translation for address arg in KESU mode" },
+    { MTAB_XTD|MTAB_VDV|MTAB_VALO|MTAB_NMO, 1, "OPSTATS", "OPSTATS{=COUNT|TIMING|RESET}",
+      &sim_set_opstats, &sim_show_opstats, (void *)&cpu_opstats, "Enable/Display per-opcode execution statistics" },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "NOOPSTATS",
+      &sim_set_opstats, NULL, (void *)&cpu_opstats, "Disable per-opcode execution statistics" },
     CPU_MODEL_MODIFIERS  /* Model specific cpu modifiers from vaxXXX_defs.h */
     CPU_INST_MODIFIERS   /* Model specific cpu instruction modifiers from vaxXXX_defs.h */
     { 0 }
@@ -516,6 +565,7 @@ set_map_reg ();                                         /* set map reg */
 GET_CUR;                                                /* set access mask */
 SET_IRQL;                                               /* eval interrupts */
 FLUSH_ISTR;                                             /* clear prefetch */
+dic_flush ();                                           /* clear decoded insts */
 
 abortval = setjmp (save_env);                           /* set abort hdlr */
 if (abortval > 0) {                                     /* sim stop? */
@@ -721,18 +771,22 @@ for ( ;; ) {
             }
         }                                               /* end PSL event */
 
-    if (sim_brk_summ &&
+    if (sim_brk_summ && sim_brk_maybe ((uint32) PC) &&
         sim_brk_test ((uint32) PC, SWMASK ('E'))) {     /* breakpoint? */
         ABORT (STOP_IBKPT);                             /* stop simulation */
         }
 
     sim_interval = sim_interval - (1 + (extra_bytes>>5));/* count instr */
     extra_bytes = 0;                                    /* digest string count */
+    dic_rp = dic_wp = NULL;
+    if (dic_enab)                                       /* decoded inst cache? */
+        dic_lookup (acc);                               /* replay or record */
     GET_ISTR (opc, L_BYTE);                             /* get opcode */
     if (opc == 0xFD) {                                  /* 2 byte op? */
         GET_ISTR (opc, L_BYTE);                         /* get second byte */
         opc = opc | 0x100;                              /* flag */
         }
+    SIM_OPSTATS_COUNT (&cpu_opstats, opc);              /* opcode statistics */
     numspec = drom[opc][0];                             /* get # specs */
 #if !defined(FULL_VAX)
     if (((DR_GETIGRP(numspec) == DR_GETIGRP(IG_BSDFL)) && (!(cpu_instruction_set & VAX_DFLOAT))) ||
@@ -1558,6 +1612,27 @@ for ( ;; ) {
             }                                           /* end for */
         }                                               /* end if not FPD */
 
+/* Retire the decoded instruction cache state.  A replayed instruction left
+   the prefetch buffer untouched, so restart it at the physical address
+   following the instruction.  A recorded instruction is entered in the
+   cache if it lies entirely within one page.
+*/
+
+    if (dic_rp) {                                       /* replayed? */
+        ibcnt = 0;                                      /* resume prefetch */
+        ppc = (dic_pa + (PC - fault_PC)) & ~03;
+        dic_rp = NULL;
+        }
+    else if (dic_wp) {                                  /* recorded? */
+        if ((VA_GETOFF (dic_pa) + (uint32) (PC - fault_PC)) <= VA_PAGSIZE) {
+            dic_rec->ntok = (int32) (dic_wp - dic_rec->tok);
+            dic_rec->pa = dic_pa;
+            dic_rec->gen = dic_pggen[dic_pa >> VA_N_OFF];
+            dic_pgmap[DIC_PGMAP_IDX (dic_pa)] |= DIC_PGMAP_BIT (dic_pa);
+            }
+        dic_wp = NULL;
+        }
+
 /* Optionally record instruction history */
 
     if (hst_lnt) {
@@ -3232,6 +3307,118 @@ if ((bo + lnt) >= 4) {                                  /* retire ibufl? */
 return val;
 }
 
+/* Decoded instruction cache
+
+   The decoded instruction cache holds, for recently executed instructions,
+   the istream items (opcode, specifier bytes, displacements and immediate
+   data) that the decoder fetched with GET_ISTR, keyed by the physical
+   address of the instruction.  Operand evaluation depends on registers and
+   memory, so it is not cached; what is saved is the prefetch buffer work
+   and the translation and memory reads of the instruction stream.
+
+   At the start of each instruction, dic_lookup translates the PC through
+   the fast TLB, loading it from the TLB if necessary, since the istream
+   is fetched through the TLB (see get_istr) and code pages which are
+   never read as data would otherwise never be found there.  On a hit, GET_ISTR replays the saved items, advancing the
+   PC by the length of each; on a miss, GET_ISTR fetches through get_istr as
+   before and records the items, and the entry is made valid at the end of
+   the specifier decode if the whole instruction lies within one page.
+   Instructions are not recorded with PSL<fpd> set, since the specifier
+   decode is then skipped.
+
+   The cache is direct mapped on the low bits of the physical address.
+   Each entry carries the generation of its page at the time it was
+   recorded, and is only valid while the page's generation is unchanged.
+   A bit in dic_pgmap marks each page which may have valid entries; a store
+   to such a page (by the CPU or by DMA, see vax_mmu.h) clears the bit and
+   advances the page's generation, which discards all of the page's entries
+   at once.  Code and data often share a page, so invalidation must be
+   cheap, and a page which is invalidated a second time is no longer
+   recorded; recording it would only be repeated on every pass through the
+   code.  These marks are forgotten every DIC_DECAY invalidations, so that
+   pages which are reused for code are cached again.  The whole cache is
+   discarded on every entry to sim_instr, which covers changes made to
+   memory from the console and by boot and load routines.
+*/
+
+static SIM_INLINE void dic_lookup (int32 acc)
+{
+uint32 pa;
+DICENT *e;
+
+if (mapen) {
+    int32 vpn = VA_GETVPN (PC);
+    FTLBENT *fe = (PC & VA_S0)? &sftlb[VA_GETTBI (vpn)]: &pftlb[VA_GETTBI (vpn)];
+
+    if ((fe->tag != vpn) || ((fe->acc & acc) == 0)) {   /* not in fast tlb? */
+        TLBENT xpte = (PC & VA_S0)? stlb[VA_GETTBI (vpn)]: ptlb[VA_GETTBI (vpn)];
+
+        if ((xpte.tag != vpn) || ((xpte.pte & acc) == 0))/* not in tlb either? */
+            return;
+        fill_ftlb (PC, xpte);                           /* load fast tlb */
+        if ((fe->tag != vpn) || ((fe->acc & acc) == 0)) /* not memory? */
+            return;
+        }
+    pa = ((uint32) (fe->mem - M) << 2) | VA_GETOFF (PC);
+    }
+else {
+    pa = PC & PAMASK;
+    if (!ADDR_IS_MEM (pa))                              /* ROM, I/O space? */
+        return;
+    }
+dic_pa = pa;
+e = &dic[pa & DIC_MASK];
+if ((e->pa == (int32) pa) &&                            /* hit? replay */
+    (e->gen == dic_pggen[pa >> VA_N_OFF])) {
+    dic_rp = e->tok;
+    dic_rend = e->tok + e->ntok;
+    ++dic_nreplay;
+    }
+else if (((PSL & PSL_FPD) == 0) &&                      /* miss, record */
+    ((dic_pgnc[DIC_PGMAP_IDX (pa)] & DIC_PGMAP_BIT (pa)) == 0)) {
+    e->pa = -1;
+    dic_rec = e;
+    dic_wp = e->tok;
+    dic_wend = e->tok + DIC_MAXTOK;
+    }
+}
+
+/* Discard the decoded instructions in the page containing pa */
+
+void dic_inval_page (uint32 pa)
+{
+uint32 idx = DIC_PGMAP_IDX (pa);
+uint32 bit = DIC_PGMAP_BIT (pa);
+
+dic_pgmap[idx] &= ~bit;
+if (dic_pgwr[idx] & bit)                                /* again? stop caching */
+    dic_pgnc[idx] |= bit;
+else dic_pgwr[idx] |= bit;
+if (++dic_ninval >= DIC_DECAY) {                        /* time to decay? */
+    dic_ninval = 0;
+    memset (dic_pgwr, 0, sizeof (dic_pgwr));
+    memset (dic_pgnc, 0, sizeof (dic_pgnc));
+    }
+if (++dic_pggen[pa >> VA_N_OFF] == 0)                   /* generation wrap? */
+    dic_flush ();
+}
+
+/* Discard the entire decoded instruction cache */
+
+static void dic_flush (void)
+{
+uint32 i;
+
+for (i = 0; i < DIC_SIZE; i++)
+    dic[i].pa = -1;
+memset (dic_pgmap, 0, sizeof (dic_pgmap));
+memset (dic_pgwr, 0, sizeof (dic_pgwr));
+memset (dic_pgnc, 0, sizeof (dic_pgnc));
+dic_ninval = 0;
+dic_rp = dic_wp = NULL;
+dic_enab = (cpu_unit.flags & UNIT_NODIC) == 0;
+}
+
 /* Read octaword specifier */
 
 int32 ReadOcta (int32 va, int32 *opnd, int32 j, int32 acc)
@@ -3340,6 +3527,7 @@ if (M == NULL) {                        /* first time init? */
     vax_init();
     sim_brk_types = sim_brk_dflt = SWMASK ('E');
     sim_vm_is_subroutine_call = cpu_is_pc_a_subroutine_call;
+    sim_vm_profile_stack = cpu_profile_stack;
     sim_clock_precalibrate_commands = vax_clock_precalibrate_commands;
     sim_vm_initial_ips = SIM_INITIAL_IPS;
     pcq_r = find_reg ("PCQ", NULL, dptr);
@@ -3349,6 +3537,8 @@ if (M == NULL) {                        /* first time init? */
     M = (uint32 *) calloc (((uint32) MEMSIZE) >> 2, sizeof (uint32));
     if (M == NULL)
         return SCPE_MEM;
+    if (sim_end)                        /* bytes of M in address order? */
+        sim_register_memory (&cpu_unit, (void **)&M);
     auto_config(NULL, 0);               /* do an initial auto configure */
     }
 return build_dib_tab ();
@@ -3400,6 +3590,63 @@ switch (sim_eval[0])
     }
 }
 
+/* Profiler call stack walk
+
+   Returns the return PCs of the active CALLG/CALLS frames, innermost
+   first, following the saved FP chain.  Frames are only read through
+   translations already present in the TB so that walking the stack
+   has no effect on the simulated machine.  The walk stops at the first
+   frame which can't be read this way.
+*/
+
+static t_bool cpu_profile_read (uint32 va, uint32 *val)
+{
+uint32 pa = va & PAMASK;
+
+if (mapen) {
+    int32 vpn = VA_GETVPN (va);
+    TLBENT xpte = (va & VA_S0)? stlb[VA_GETTBI (vpn)]: ptlb[VA_GETTBI (vpn)];
+
+    if (xpte.tag != vpn)                                /* not in TB? */
+        return FALSE;
+    pa = (xpte.pte & TLB_PFN) | VA_GETOFF (va);
+    }
+if (!ADDR_IS_MEM (pa))
+    return FALSE;
+*val = M[pa >> 2];
+return TRUE;
+}
+
+int32 cpu_profile_stack (t_addr *frames, int32 max)
+{
+uint32 fp = (uint32) FP;
+uint32 nfp, pc;
+int32 n = 0;
+
+while ((n < max) && (fp != 0) && ((fp & 3) == 0)) {
+    if (!cpu_profile_read (fp + 16, &pc) ||             /* saved PC */
+        !cpu_profile_read (fp + 12, &nfp))              /* saved FP */
+        break;
+    frames[n++] = pc;
+    if (nfp <= fp)                                      /* frames must ascend the stack */
+        break;
+    fp = nfp;
+    }
+return n;
+}
+
+/* Opcode statistics name and class */
+
+const char *cpu_opstats_name (uint32 op)
+{
+return opcode[op];
+}
+
+uint32 cpu_opstats_class (uint32 op)
+{
+return DR_GETIGRP (drom[op][0]);
+}
+
 /* Memory examine */
 
 t_stat cpu_ex (t_value *vptr, t_addr exta, UNIT *uptr, int32 sw)
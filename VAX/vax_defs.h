@@ -681,7 +681,26 @@ enum opcodes {
 #define PCQ_SIZE        64                              /* must be 2**n */
 #define PCQ_MASK        (PCQ_SIZE - 1)
 #define PCQ_ENTRY       pcq[pcq_p = (pcq_p - 1) & PCQ_MASK] = fault_PC
-#define GET_ISTR(d,l)   d = get_istr (l, acc)
+#define GET_ISTR(d,l)   do {                                                \
+                            int32 _iv;                                      \
+                            if (dic_rp && (dic_rp < dic_rend)) {            /* replay decoded? */ \
+                                _iv = *dic_rp++;                            \
+                                PC = PC + (l);                              \
+                                }                                           \
+                            else {                                          \
+                                if (dic_rp) {                               /* ran off the end? */ \
+                                    dic_rp = NULL;                          \
+                                    FLUSH_ISTR;                             \
+                                    }                                       \
+                                _iv = get_istr (l, acc);                    \
+                                if (dic_wp) {                               /* recording? */ \
+                                    if (dic_wp < dic_wend)                  \
+                                        *dic_wp++ = _iv;                    \
+                                    else dic_wp = NULL;                     /* too long, give up */ \
+                                    }                                       \
+                                }                                           \
+                            d = _iv;                                        \
+                            } while (0)
 #define CHECK_FOR_IDLE_LOOP if (PC == fault_PC) {                           /* to self? */ \
                                 if (PSL_GETIPL (PSL) == 0x1F)               /* int locked out? */ \
                                     ABORT (STOP_LOOP);                      /* infinite loop */ \
@@ -885,6 +904,8 @@ extern int32 pcq[PCQ_SIZE];                             /* PC queue */
 extern int32 pcq_p;                                     /* PC queue ptr */
 extern int32 in_ie;                                     /* in exc, int */
 extern int32 ibcnt, ppc;                                /* prefetch ctl */
+extern int32 *dic_rp, *dic_rend;                        /* decoded inst replay */
+extern int32 *dic_wp, *dic_wend;                        /* decoded inst record */
 extern int32 hlt_pin;                                   /* HLT pin intr */
 extern int32 mxpr_cc_vc;                                /* cc V & C bits from mtpr/mfpr operations */
 extern int32 mem_err;
@@ -581,6 +581,7 @@ void cqmap_wr (int32 pa, int32 val, int32 lnt)
 int32 ma = (pa & CQMAPAMASK) + cq_mbr;                  /* mem addr */
 
 if (ADDR_IS_MEM (ma)) {
+    DIC_WRITE (ma);                                     /* code page? */
     if (lnt < L_LONG) {
         int32 sc = (pa & 3) << 3;
         int32 mask = (lnt == L_WORD)? 0xFFFF: 0xFF;
@@ -636,6 +637,7 @@ uint32 ma;
 
 if (qba_map_addr (qa, &ma)) {                           /* in map? */
     if (ADDR_IS_MEM (ma)) {                             /* real memory? */
+        DIC_WRITE (ma);                                 /* code page? */
         if (md == WRITE) {                              /* word access? */
             int32 sc = (ma & 2) << 3;                   /* aligned only */
             M[ma >> 2] = (M[ma >> 2] & ~(WMASK << sc)) |
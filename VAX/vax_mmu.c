@@ -57,6 +57,7 @@ int32 d_p0br, d_p0lr;                                   /* dynamic copies */
 int32 d_p1br, d_p1lr;                                   /* altered per ucode */
 int32 d_sbr, d_slr;
 TLBENT stlb[VA_TBSIZE], ptlb[VA_TBSIZE];
+FTLBENT sftlb[VA_TBSIZE], pftlb[VA_TBSIZE];
 static const int32 cvtacc[16] = { 0, 0,
     TLB_ACCW (KERN)+TLB_ACCR (KERN),
     TLB_ACCR (KERN),
@@ -179,6 +180,7 @@ else {
         stlb[tbi].tag = vpn;                            /* set stlb tag */
         stlb[tbi].pte = cvtacc[PTE_GETACC (pte)] |
             ((pte << VA_N_OFF) & TLB_PFN);              /* set stlb data */
+        sftlb[tbi].tag = -1;                            /* inval fast tlb */
         }
     ptead = (stlb[tbi].pte & TLB_PFN) | VA_GETOFF (ptead);
 #endif
@@ -200,10 +202,12 @@ tbi = VA_GETTBI (vpn);
 if ((va & VA_S0) == 0) {                                /* process space? */
     ptlb[tbi].tag = vpn;                                /* store tlb ent */
     ptlb[tbi].pte = tlbpte;
+    pftlb[tbi].tag = -1;                                /* inval fast tlb */
     return ptlb[tbi];
     }
 stlb[tbi].tag = vpn;                                    /* system space */
 stlb[tbi].pte = tlbpte;                                 /* store tlb ent */
+sftlb[tbi].tag = -1;                                    /* inval fast tlb */
 return stlb[tbi];
 }
 
@@ -226,9 +230,9 @@ void zap_tb (int stb)
 size_t i;
 
 for (i = 0; i < VA_TBSIZE; i++) {
-    ptlb[i].tag = ptlb[i].pte = -1;
+    ptlb[i].tag = ptlb[i].pte = pftlb[i].tag = -1;
     if (stb)
-        stlb[i].tag = stlb[i].pte = -1;
+        stlb[i].tag = stlb[i].pte = sftlb[i].tag = -1;
     }
 }
 
@@ -239,8 +243,8 @@ void zap_tb_ent (uint32 va)
 int32 tbi = VA_GETTBI (VA_GETVPN (va));
 
 if (va & VA_S0)
-    stlb[tbi].tag = stlb[tbi].pte = -1;
-else ptlb[tbi].tag = ptlb[tbi].pte = -1;
+    stlb[tbi].tag = stlb[tbi].pte = sftlb[tbi].tag = -1;
+else ptlb[tbi].tag = ptlb[tbi].pte = pftlb[tbi].tag = -1;
 }
 
 /* Check for tlb entry corresponding to va */
@@ -281,6 +285,9 @@ uint32 idx = (uint32) addr >> 1;
 
 if (idx >= VA_TBSIZE)
     return SCPE_NXM;
+if (tlbn)                                               /* inval fast tlb */
+    sftlb[idx].tag = -1;
+else pftlb[idx].tag = -1;
 if (addr & 1) {
     if (tlbn) stlb[idx].pte = (int32) val;
     else ptlb[idx].pte = (int32) val;
@@ -300,6 +307,8 @@ size_t i;
 
 for (i = 0; i < VA_TBSIZE; i++)
     stlb[i].tag = ptlb[i].tag = stlb[i].pte = ptlb[i].pte = -1;
+for (i = 0; i < VA_TBSIZE; i++)
+    sftlb[i].tag = pftlb[i].tag = -1;
 return SCPE_OK;
 }
 
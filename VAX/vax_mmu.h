@@ -56,6 +56,12 @@ typedef struct {
     int32       pte;                                    /* pte */
     } TLBENT;
 
+typedef struct {
+    int32       tag;                                    /* tag */
+    int32       acc;                                    /* access, wr only if M */
+    uint32      *mem;                                   /* page in M */
+    } FTLBENT;
+
 extern uint32 *M;
 extern UNIT cpu_unit;
 extern DEVICE cpu_dev;
@@ -63,6 +69,26 @@ extern int32 mapen;                                     /* map enable */
 
 extern int32 mchk_va, mchk_ref;                         /* for mcheck */
 extern TLBENT stlb[VA_TBSIZE], ptlb[VA_TBSIZE];
+extern FTLBENT sftlb[VA_TBSIZE], pftlb[VA_TBSIZE];
+
+/* Decoded instruction cache write tracking
+
+   dic_pgmap has a bit for each page of physical memory which holds the
+   start of a decoded instruction (see vax_cpu.c).  Every store to memory
+   checks the bit and, if it is set, discards the page's decoded
+   instructions before the new contents can be executed.
+*/
+
+#define DIC_PGMAP_SIZE  ((PASIZE >> VA_N_OFF) >> 5)     /* bitmap lw's */
+#define DIC_PGMAP_BIT(pa) (1u << (((uint32) (pa) >> VA_N_OFF) & 0x1F))
+#define DIC_PGMAP_IDX(pa) ((uint32) (pa) >> (VA_N_OFF + 5))
+#define DIC_WRITE(pa)   do {                                                \
+                            if (dic_pgmap[DIC_PGMAP_IDX (pa)] & DIC_PGMAP_BIT (pa)) \
+                                dic_inval_page (pa);                        \
+                            } while (0)
+
+extern uint32 dic_pgmap[DIC_PGMAP_SIZE];
+extern void dic_inval_page (uint32 pa);
 
 static const int32 insert[4] = {
     0x00000000, 0x000000FF, 0x0000FFFF, 0x00FFFFFF
@@ -87,10 +113,39 @@ static SIM_INLINE void WriteB (uint32 pa, int32 val);
 static SIM_INLINE void WriteW (uint32 pa, int32 val);
 static SIM_INLINE void WriteL (uint32 pa, int32 val);
 
+/* Fast TLB
+
+   The fast TLB shadows the TLB with a host pointer to each mapped page
+   of memory, so that an aligned reference to memory which hits in it
+   takes a tag compare, an access check and a load or store.  An entry
+   is only valid while the TLB entry at the same index is unchanged:
+   every change to a TLB entry (fill, zap, reset, deposit) invalidates
+   the corresponding fast TLB entry, and entries are (re)loaded from
+   the TLB on the aligned path of Read and Write.  Pages outside of
+   memory (I/O space, nonexistent memory) are never loaded, so they
+   always take the full path.  The write access bits are only present
+   if the TLB entry has its M bit set.
+*/
+
+static SIM_INLINE void fill_ftlb (uint32 va, TLBENT xpte)
+{
+uint32 pa = xpte.pte & TLB_PFN;
+FTLBENT *fe = (va & VA_S0)? &sftlb[VA_GETTBI (xpte.tag)]: &pftlb[VA_GETTBI (xpte.tag)];
+
+if (ADDR_IS_MEM (pa) && ADDR_IS_MEM (pa + VA_M_OFF)) {
+    fe->tag = xpte.tag;
+    fe->acc = xpte.pte & ((xpte.pte & TLB_M)? (TLB_RACC | TLB_WACC): TLB_RACC);
+    fe->mem = M + (pa >> 2);
+    }
+}
+
 /* Read and write virtual
 
    These routines logically fall into three phases:
 
+   0.   If mapping is on and the reference is aligned, look up the
+        virtual address in the fast TLB, and on a hit with access
+        reference memory directly.
    1.   Look up the virtual address in the translation buffer, calling
         the fill routine on a tag mismatch or access mismatch (invalid
         tlb entries have access = 0 and thus always mismatch).  The
@@ -121,17 +176,30 @@ static SIM_INLINE int32 Read (uint32 va, int32 lnt, int32 acc)
 int32 vpn, off, tbi, pa;
 int32 pa1, bo, sc, wl, wh;
 TLBENT xpte;
+FTLBENT *fe;
 
 mchk_va = va;
 if (mapen) {                                            /* mapping on? */
     vpn = VA_GETVPN (va);                               /* get vpn, offset */
     off = VA_GETOFF (va);
     tbi = VA_GETTBI (vpn);
+    fe = (va & VA_S0)? &sftlb[tbi]: &pftlb[tbi];        /* access fast tlb */
+    if ((fe->tag == vpn) && (fe->acc & acc) && ((off & (lnt - 1)) == 0)) {
+        int32 dat = fe->mem[off >> 2];
+
+        if (lnt >= L_LONG)                              /* long, quad? */
+            return dat;
+        if (lnt == L_WORD)                              /* word? */
+            return (dat >> ((off & 2)? 16: 0)) & WMASK;
+        return (dat >> ((off & 3) << 3)) & BMASK;       /* byte */
+        }
     xpte = (va & VA_S0)? stlb[tbi]: ptlb[tbi];          /* access tlb */
     if (((xpte.pte & acc) == 0) || (xpte.tag != vpn) ||
         ((acc & TLB_WACC) && ((xpte.pte & TLB_M) == 0)))
         xpte = fill (va, lnt, acc, NULL);               /* fill if needed */
     pa = (xpte.pte & TLB_PFN) | off;                    /* get phys addr */
+    if ((pa & (lnt - 1)) == 0)                          /* aligned? */
+        fill_ftlb (va, xpte);                           /* load fast tlb */
     }
 else {
     pa = va & PAMASK;
@@ -187,17 +255,36 @@ static SIM_INLINE void Write (uint32 va, int32 val, int32 lnt, int32 acc)
 int32 vpn, off, tbi, pa;
 int32 pa1, bo, sc;
 TLBENT xpte;
+FTLBENT *fe;
 
 mchk_va = va;
 if (mapen) {
     vpn = VA_GETVPN (va);
     off = VA_GETOFF (va);
     tbi = VA_GETTBI (vpn);
+    fe = (va & VA_S0)? &sftlb[tbi]: &pftlb[tbi];        /* access fast tlb */
+    if ((fe->tag == vpn) && (fe->acc & acc) && ((off & (lnt - 1)) == 0)) {
+        uint32 *mp = &fe->mem[off >> 2];
+
+        DIC_WRITE ((uint32) (fe->mem - M) << 2);        /* code page? */
+        if (lnt >= L_LONG)                              /* long, quad? */
+            *mp = val;
+        else if (lnt == L_WORD)                         /* word? */
+            *mp = (off & 2)? (*mp & 0xFFFF) | (val << 16):
+                (*mp & ~0xFFFF) | val;
+        else {                                          /* byte */
+            int32 sc = (off & 3) << 3;
+            *mp = (*mp & ~(0xFF << sc)) | (val << sc);
+            }
+        return;
+        }
     xpte = (va & VA_S0)? stlb[tbi]: ptlb[tbi];          /* access tlb */
     if (((xpte.pte & acc) == 0) || (xpte.tag != vpn) ||
         ((xpte.pte & TLB_M) == 0))
         xpte = fill (va, lnt, acc, NULL);
     pa = (xpte.pte & TLB_PFN) | off;
+    if ((pa & (lnt - 1)) == 0)                          /* aligned? */
+        fill_ftlb (va, xpte);                           /* load fast tlb */
     }
 else {
     pa = va & PAMASK;
@@ -365,6 +452,7 @@ if (ADDR_IS_MEM (pa)) {
     int32 id = pa >> 2;
     int32 sc = (pa & 3) << 3;
     int32 mask = 0xFF << sc;
+    DIC_WRITE (pa);
     M[id] = (M[id] & ~mask) | (val << sc);
     }
 else {
@@ -381,6 +469,7 @@ static SIM_INLINE void WriteW (uint32 pa, int32 val)
 {
 if (ADDR_IS_MEM (pa)) {
     int32 id = pa >> 2;
+    DIC_WRITE (pa);
     M[id] = (pa & 2)? (M[id] & 0xFFFF) | (val << 16):
         (M[id] & ~0xFFFF) | val;
     }
@@ -396,8 +485,10 @@ return;
 
 static SIM_INLINE void WriteL (uint32 pa, int32 val)
 {
-if (ADDR_IS_MEM (pa))
+if (ADDR_IS_MEM (pa)) {
+    DIC_WRITE (pa);
     M[pa >> 2] = val;
+    }
 else {
     mchk_ref = REF_V;
     if (ADDR_IS_IO (pa))
@@ -410,8 +501,10 @@ return;
 
 static SIM_INLINE void WriteLP (uint32 pa, int32 val)
 {
-if (ADDR_IS_MEM (pa))
+if (ADDR_IS_MEM (pa)) {
+    DIC_WRITE (pa);
     M[pa >> 2] = val;
+    }
 else {
     mchk_va = pa;
     mchk_ref = REF_P;
@@ -438,6 +531,7 @@ static SIM_INLINE void WriteU (uint32 pa, int32 val, int32 lnt)
 if (ADDR_IS_MEM (pa)) {
     int32 bo = pa & 3;
     int32 sc = bo << 3;
+    DIC_WRITE (pa);
     M[pa >> 2] = (M[pa >> 2] & ~(insert[lnt] << sc)) | ((val & insert[lnt]) << sc);
     }
 else {
@@ -265,6 +265,12 @@
 
 #define MAX_DO_NEST_LVL 20                              /* DO cmd nesting level limit */
 #define SRBSIZ          1024                            /* save/restore buffer */
+#define SRPAGE          4096                            /* save/restore memory page (elements) */
+#define SRMAXBASE       64                              /* incremental save chain limit */
+#define SR_PG_ZERO      0                               /* [V4.1] run of all zero pages */
+#define SR_PG_BASE      1                               /* [V4.1] run of pages unchanged from base */
+#define SR_PG_RAW       2                               /* [V4.1] uncompressed page */
+#define SR_PG_LZ        3                               /* [V4.1] compressed page */
 #define SIM_BRK_INILNT  4096                            /* bpt tbl length */
 #define SIM_BRK_ALLTYP  0xFFFFFFFB
 #define UPDATE_SIM_TIME                                         \
@@ -373,43 +379,271 @@ int32 sim_asynch_check;
 int32 sim_asynch_latency = 4000;      /* 4 usec interrupt latency */
 int32 sim_asynch_inst_latency = 20;   /* assume 5 mip simulator */
 
-int sim_aio_update_queue (void)
+/* Asynchronous completion delivery
+
+   Threads which complete I/O push the unit onto sim_asynch_queue
+   (sim_aio_activate).  A unit is on the list at most once: while it is
+   queued (a_next != NULL) further completions only merge their event
+   time into the pending one, so the list can't hold more entries than
+   there are units and never overflows.
+
+   The main thread drains the whole list at once (sim_aio_update_queue).
+   It detaches the list with a single exchange, restores arrival order
+   (the list is pushed LIFO) and then takes units off it in batches of
+   up to SIM_AIO_BATCH, holding sim_asynch_lock once per batch rather
+   than twice per unit.  Each unit's activation parameters are captured
+   while the lock is held, so the activations and completion checks run
+   without it.
+
+   A device can be given a coalescing interval (SET <dev> COALESCE=usecs).
+   Completions for its units are then delivered at most once per
+   interval: a unit whose device delivered within the interval is moved
+   to a held list, where it stays marked as queued so that further
+   completions merge into its pending delivery, until the interval has
+   passed.  A burst of completions thus costs the controller a single
+   service call.  Held completions are delivered at once when the
+   simulator would otherwise idle, and when the unit is canceled.
+ */
+
+#define SIM_AIO_BATCH 64
+
+typedef struct {
+    UNIT                *uptr;
+    ACTIVATE_API        call;
+    int32               event_time;
+    } SIM_AIO_DELIVERY;
+
+typedef struct {
+    DEVICE              *dptr;
+    uint32              usecs;                  /* minimum interval between deliveries */
+    double              last;                   /* time of the most recent delivery */
+    t_uint64            delivered;              /* completion deliveries */
+    t_uint64            held;                   /* completions which had to wait */
+    } SIM_AIO_COALESCE;
+
+static SIM_AIO_COALESCE *sim_aio_coalesce = NULL;
+static uint32 sim_aio_coalesce_count = 0;
+static UNIT *sim_aio_held = QUEUE_LIST_END;     /* completions waiting out an interval (main thread) */
+static UNIT **sim_aio_held_tail = &sim_aio_held;
+static t_uint64 sim_aio_batches = 0;            /* drains which found work */
+static t_uint64 sim_aio_delivered = 0;          /* units migrated by those drains */
+static uint32 sim_aio_batch_max = 0;            /* most units migrated by one drain */
+
+static double _sim_aio_now (void);
+
+static SIM_AIO_COALESCE *_sim_aio_coalesce_find (UNIT *uptr)
 {
-int migrated = 0;
+uint32 i;
 
-AIO_ILOCK;
-if (AIO_QUEUE_VAL != QUEUE_LIST_END) {  /* List !Empty */
-    UNIT *q, *uptr;
-    int32 a_event_time;
-    do {                                /* Grab current queue */
-        q = AIO_QUEUE_VAL;
-        } while (q != AIO_QUEUE_SET(QUEUE_LIST_END, q));
-    while (q != QUEUE_LIST_END) {       /* List !Empty */
-        sim_debug (SIM_DBG_AIO_QUEUE, &sim_scp_dev, "Migrating Asynch event for %s after %d %s\n", sim_uname(q), q->a_event_time, sim_vm_interval_units);
-        ++migrated;
-        uptr = q;
-        q = q->a_next;
-        uptr->a_next = NULL;        /* hygiene */
-        if (uptr->a_activate_call != &sim_activate_notbefore) {
-            a_event_time = uptr->a_event_time-((sim_asynch_inst_latency+1)/2);
-            if (a_event_time < 0)
-                a_event_time = 0;
+for (i = 0; i < sim_aio_coalesce_count; i++) {
+    DEVICE *dptr = sim_aio_coalesce[i].dptr;
+
+    if ((uptr >= dptr->units) && (uptr < dptr->units + dptr->numunits))
+        return &sim_aio_coalesce[i];
+    }
+return NULL;
+}
+
+/* Determine whether a unit's completion may be delivered now.  All of a
+   device's units which are pending when its interval expires are
+   delivered together.  Called with sim_asynch_lock held */
+
+static t_bool _sim_aio_coalesce_due (UNIT *uptr, double now)
+{
+SIM_AIO_COALESCE *co = _sim_aio_coalesce_find (uptr);
+
+if (co == NULL)
+    return TRUE;
+if ((co->last != now) &&
+    ((now - co->last) * 1000000.0 < co->usecs)) {
+    ++co->held;
+    return FALSE;
+    }
+co->last = now;
+++co->delivered;
+return TRUE;
+}
+
+/* Take a unit off the pending lists, capturing its activation.  Called
+   with sim_asynch_lock held */
+
+static void _sim_aio_capture (SIM_AIO_DELIVERY *d, UNIT *uptr)
+{
+d->uptr = uptr;
+d->call = uptr->a_activate_call;
+if (uptr->a_activate_call != &sim_activate_notbefore) {
+    d->event_time = uptr->a_event_time-((sim_asynch_inst_latency+1)/2);
+    if (d->event_time < 0)
+        d->event_time = 0;
+    }
+else
+    d->event_time = uptr->a_event_time;
+uptr->a_next = NULL;
+}
+
+static void _sim_aio_deliver (SIM_AIO_DELIVERY *batch, int count)
+{
+int i;
+
+for (i = 0; i < count; i++) {
+    UNIT *uptr = batch[i].uptr;
+
+    sim_debug (SIM_DBG_AIO_QUEUE, &sim_scp_dev, "Migrating Asynch event for %s after %d %s\n", sim_uname(uptr), batch[i].event_time, sim_vm_interval_units);
+    batch[i].call (uptr, batch[i].event_time);
+    if (uptr->a_check_completion) {
+        sim_debug (SIM_DBG_AIO_QUEUE, &sim_scp_dev, "Calling Completion Check for asynch event on %s\n", sim_uname(uptr));
+        uptr->a_check_completion (uptr);
+        }
+    }
+}
+
+/* Deliver held completions: those whose interval has passed, everything
+   when all is set, or only uptr's when uptr is specified */
+
+static int _sim_aio_release_held (UNIT *uptr, t_bool all)
+{
+SIM_AIO_DELIVERY batch[SIM_AIO_BATCH];
+int released = 0;
+int count;
+
+do {
+    UNIT **link, *hptr;
+    double now = (all || uptr) ? 0.0 : _sim_aio_now ();
+
+    count = 0;
+    AIO_ILOCK;
+    link = &sim_aio_held;
+    while (((hptr = *link) != QUEUE_LIST_END) && (count < SIM_AIO_BATCH)) {
+        if (uptr ? (hptr == uptr) : (all || _sim_aio_coalesce_due (hptr, now))) {
+            *link = hptr->a_next;
+            if (*link == QUEUE_LIST_END)
+                sim_aio_held_tail = link;
+            _sim_aio_capture (&batch[count++], hptr);
             }
         else
-            a_event_time = uptr->a_event_time;
-        AIO_IUNLOCK;
-        uptr->a_activate_call (uptr, a_event_time);
-        if (uptr->a_check_completion) {
-            sim_debug (SIM_DBG_AIO_QUEUE, &sim_scp_dev, "Calling Completion Check for asynch event on %s\n", sim_uname(uptr));
-            uptr->a_check_completion (uptr);
+            link = &hptr->a_next;
+        }
+    AIO_IUNLOCK;
+    _sim_aio_deliver (batch, count);
+    released += count;
+    } while ((count == SIM_AIO_BATCH) && (uptr == NULL));
+return released;
+}
+
+int sim_aio_update_queue (void)
+{
+SIM_AIO_DELIVERY batch[SIM_AIO_BATCH];
+UNIT *q, *list;
+double now = 0.0;
+int migrated = 0;
+int count;
+
+if (sim_aio_held != QUEUE_LIST_END)                     /* coalesced completions waiting? */
+    migrated = _sim_aio_release_held (NULL, FALSE);
+if (AIO_QUEUE_VAL == QUEUE_LIST_END)                    /* List Empty */
+    return migrated;
+if (sim_aio_coalesce_count)
+    now = _sim_aio_now ();
+AIO_ILOCK;
+do {                                                    /* Grab current queue */
+    q = AIO_QUEUE_VAL;
+    } while (q != AIO_QUEUE_SET(QUEUE_LIST_END, q));
+for (list = QUEUE_LIST_END; q != QUEUE_LIST_END; ) {    /* restore arrival order */
+    UNIT *uptr = q;
+
+    q = q->a_next;
+    uptr->a_next = list;
+    list = uptr;
+    }
+do {
+    for (count = 0; (list != QUEUE_LIST_END) && (count < SIM_AIO_BATCH); ) {
+        UNIT *uptr = list;
+
+        list = uptr->a_next;
+        if ((sim_aio_coalesce_count == 0) || _sim_aio_coalesce_due (uptr, now))
+            _sim_aio_capture (&batch[count++], uptr);
+        else {                                          /* hold until its interval passes */
+            sim_debug (SIM_DBG_AIO_QUEUE, &sim_scp_dev, "Holding Asynch event for %s\n", sim_uname(uptr));
+            uptr->a_next = QUEUE_LIST_END;
+            *sim_aio_held_tail = uptr;
+            sim_aio_held_tail = &uptr->a_next;
             }
-        AIO_ILOCK;
         }
+    AIO_IUNLOCK;
+    _sim_aio_deliver (batch, count);
+    migrated += count;
+    if (list != QUEUE_LIST_END)
+        AIO_ILOCK;
+    } while (list != QUEUE_LIST_END);
+if (migrated) {
+    ++sim_aio_batches;
+    sim_aio_delivered += migrated;
+    if ((uint32)migrated > sim_aio_batch_max)
+        sim_aio_batch_max = (uint32)migrated;
     }
-AIO_IUNLOCK;
 return migrated;
 }
 
+/* Deliver held completions immediately.  Returns the number delivered */
+
+int sim_aio_coalesce_flush (UNIT *uptr)
+{
+if (sim_aio_held == QUEUE_LIST_END)
+    return 0;
+return _sim_aio_release_held (uptr, (uptr == NULL));
+}
+
+/* Set a device's coalescing interval (0 disables coalescing) */
+
+t_stat sim_aio_coalesce_set (DEVICE *dptr, uint32 usecs)
+{
+SIM_AIO_COALESCE *co;
+uint32 i;
+
+for (i = 0; i < sim_aio_coalesce_count; i++)
+    if (sim_aio_coalesce[i].dptr == dptr)
+        break;
+if (usecs == 0) {
+    if (i == sim_aio_coalesce_count)
+        return SCPE_OK;
+    sim_aio_coalesce_flush (NULL);                      /* nothing may stay held */
+    AIO_ILOCK;
+    sim_aio_coalesce[i] = sim_aio_coalesce[--sim_aio_coalesce_count];
+    AIO_IUNLOCK;
+    return SCPE_OK;
+    }
+if (i == sim_aio_coalesce_count) {
+    AIO_ILOCK;
+    co = (SIM_AIO_COALESCE *)realloc (sim_aio_coalesce, (sim_aio_coalesce_count + 1) * sizeof (*co));
+    if (co != NULL) {
+        sim_aio_coalesce = co;
+        memset (&co[i], 0, sizeof (co[i]));
+        co[i].dptr = dptr;
+        ++sim_aio_coalesce_count;
+        }
+    AIO_IUNLOCK;
+    if (co == NULL)
+        return SCPE_MEM;
+    }
+sim_aio_coalesce[i].usecs = usecs;
+return SCPE_OK;
+}
+
+static void sim_aio_coalesce_show (FILE *st)
+{
+uint32 i;
+
+fprintf (st, "Asynch event delivery: %" LL_FMT "u units in %" LL_FMT "u batches, at most %u at once\n",
+         sim_aio_delivered, sim_aio_batches, sim_aio_batch_max);
+if (sim_aio_coalesce_count == 0)
+    return;
+fprintf (st, "  %-10s %10s %12s %12s\n", "Device", "Interval", "Delivered", "Held");
+for (i = 0; i < sim_aio_coalesce_count; i++)
+    fprintf (st, "  %-10s %7u us %12" LL_FMT "u %12" LL_FMT "u\n",
+             sim_dname (sim_aio_coalesce[i].dptr), sim_aio_coalesce[i].usecs,
+             sim_aio_coalesce[i].delivered, sim_aio_coalesce[i].held);
+}
+
 void sim_aio_activate (ACTIVATE_API caller, UNIT *uptr, int32 event_time)
 {
 AIO_ILOCK;
@@ -455,6 +689,356 @@ sim_asynch_inst_latency = (int32)((((double)(instpersec))*sim_asynch_latency)/10
 if (sim_asynch_inst_latency == 0)
     sim_asynch_inst_latency = 1;
 }
+
+/* Asynchronous I/O worker pool
+
+   Units which perform their I/O asynchronously (sim_disk and sim_tape)
+   hand requests to a small pool of worker threads shared by all units
+   rather than each unit having a dedicated thread.  Each unit has a
+   request queue.  Requests for a particular unit are performed one at
+   a time in the order they were submitted (stdio has no atomic
+   seek+(read|write) operation), while requests for different units are
+   performed concurrently by as many workers as are available.  Worker
+   threads are started as needed, up to sim_aio_pool_max_workers.
+
+   A performed request is moved to the unit's completion list and the
+   unit is activated (from the worker thread, so the activation goes
+   through sim_asynch_queue).  The unit's a_check_completion routine then
+   collects the completed requests with sim_aio_complete() in the main
+   thread.  Only the first completion which arrives while the completion
+   list is empty activates the unit, so each activation finds at least
+   one completed request.
+ */
+
+struct SIM_AIO_UNITQ {
+    UNIT                *uptr;
+    SIM_AIO_PERFORM     perform;            /* routine which performs a request */
+    int32               latency;            /* instructions to delay completion */
+    SIM_AIO_REQ         *pend_head;         /* requests waiting to be performed */
+    SIM_AIO_REQ         *pend_tail;
+    SIM_AIO_REQ         *done_head;         /* performed requests awaiting dispatch */
+    SIM_AIO_REQ         *done_tail;
+    t_bool              busy;               /* a worker is performing a request */
+    t_bool              ready;              /* on the pool's ready list */
+    SIM_AIO_UNITQ       *next_ready;        /* ready list linkage */
+    SIM_AIO_UNITQ       *next;              /* list of all unit queues */
+    uint32              depth;              /* requests not yet performed */
+    uint32              max_depth;          /* high water mark of depth */
+    t_uint64            requests;           /* requests performed */
+    double              latency_total;      /* seconds from submission to completion */
+    double              latency_max;
+    SIM_PERF            *perf_latency;      /* device's request latency counter */
+    SIM_PERF            *perf_depth;        /* device's request queue depth counter */
+    };
+
+uint32 sim_aio_pool_max_workers = 4;                    /* worker thread limit */
+static pthread_mutex_t sim_aio_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_aio_pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t sim_aio_pool_done = PTHREAD_COND_INITIALIZER;
+static SIM_AIO_UNITQ *sim_aio_pool_ready_head = NULL;   /* queues with requests to perform */
+static SIM_AIO_UNITQ *sim_aio_pool_ready_tail = NULL;
+static SIM_AIO_UNITQ *sim_aio_pool_queues = NULL;       /* all unit queues */
+static uint32 sim_aio_pool_workers = 0;                 /* worker threads running */
+static uint32 sim_aio_pool_idle = 0;                    /* workers waiting for work */
+static uint32 sim_aio_pool_busy_max = 0;                /* most workers ever busy at once */
+static t_bool sim_aio_pool_stopping = FALSE;
+
+/* Host time in seconds for coalescing intervals and request latencies.
+   This is the monotonic clock, so stepping the wall clock doesn't skew
+   or stall held completions. */
+
+static double _sim_aio_now (void)
+{
+return sim_os_hrtime () / 1000000000.0;
+}
+
+/* Make a unit queue ready to be serviced.  Called with sim_aio_pool_lock held */
+
+static void _sim_aio_ready (SIM_AIO_UNITQ *q)
+{
+q->ready = TRUE;
+q->next_ready = NULL;
+if (sim_aio_pool_ready_tail)
+    sim_aio_pool_ready_tail->next_ready = q;
+else
+    sim_aio_pool_ready_head = q;
+sim_aio_pool_ready_tail = q;
+pthread_cond_signal (&sim_aio_pool_work);
+}
+
+/* Move a performed request to its unit's completion list, activating
+   the unit if it isn't already due to collect completions.  Called with
+   sim_aio_pool_lock held, which is released while the unit is activated */
+
+static void _sim_aio_finish (SIM_AIO_UNITQ *q, SIM_AIO_REQ *req)
+{
+double elapsed = _sim_aio_now () - req->queued;
+t_bool activate = (q->done_head == NULL);
+
+q->latency_total += elapsed;
+if (elapsed > q->latency_max)
+    q->latency_max = elapsed;
+SIM_PERF_ADD (q->perf_latency, (t_uint64)(elapsed * 1000000.0));
+++q->requests;
+req->next = NULL;
+if (q->done_tail)
+    q->done_tail->next = req;
+else
+    q->done_head = req;
+q->done_tail = req;
+if (activate) {                                         /* first pending completion? */
+    UNIT *uptr = q->uptr;
+    int32 latency = q->latency;
+
+    pthread_mutex_unlock (&sim_aio_pool_lock);
+    sim_activate (uptr, latency);                       /* queued via sim_asynch_queue */
+    pthread_mutex_lock (&sim_aio_pool_lock);
+    }
+--q->depth;
+pthread_cond_broadcast (&sim_aio_pool_done);
+}
+
+static void *
+_sim_aio_worker (void *arg)
+{
+/* Boost Priority for this I/O thread vs the CPU instruction execution
+   thread which in general won't be readily yielding the processor when
+   this thread needs to run */
+sim_os_set_thread_priority (PRIORITY_ABOVE_NORMAL);
+
+pthread_mutex_lock (&sim_aio_pool_lock);
+while (1) {
+    SIM_AIO_UNITQ *q;
+    SIM_AIO_REQ *req;
+    uint32 busy;
+
+    if (sim_aio_pool_ready_head == NULL) {
+        if (sim_aio_pool_stopping ||
+            (sim_aio_pool_workers > sim_aio_pool_max_workers))
+            break;
+        ++sim_aio_pool_idle;
+        pthread_cond_wait (&sim_aio_pool_work, &sim_aio_pool_lock);
+        --sim_aio_pool_idle;
+        continue;
+        }
+    q = sim_aio_pool_ready_head;                        /* take the next ready unit */
+    sim_aio_pool_ready_head = q->next_ready;
+    if (sim_aio_pool_ready_head == NULL)
+        sim_aio_pool_ready_tail = NULL;
+    q->next_ready = NULL;
+    q->ready = FALSE;
+    q->busy = TRUE;
+    req = q->pend_head;                                 /* and its oldest request */
+    q->pend_head = req->next;
+    if (q->pend_head == NULL)
+        q->pend_tail = NULL;
+    req->next = NULL;
+    busy = sim_aio_pool_workers - sim_aio_pool_idle;
+    if (busy > sim_aio_pool_busy_max)
+        sim_aio_pool_busy_max = busy;
+    pthread_mutex_unlock (&sim_aio_pool_lock);
+    q->perform (q->uptr, req);
+    pthread_mutex_lock (&sim_aio_pool_lock);
+    _sim_aio_finish (q, req);
+    q->busy = FALSE;
+    if (q->pend_head)                                   /* more work for this unit? */
+        _sim_aio_ready (q);
+    }
+--sim_aio_pool_workers;
+pthread_cond_broadcast (&sim_aio_pool_done);
+pthread_mutex_unlock (&sim_aio_pool_lock);
+return NULL;
+}
+
+/* Start another worker thread.  Called with sim_aio_pool_lock held */
+
+static void _sim_aio_start_worker (void)
+{
+pthread_t thread;
+pthread_attr_t attr;
+
+pthread_attr_init (&attr);
+pthread_attr_setscope (&attr, PTHREAD_SCOPE_SYSTEM);
+pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+if (0 == pthread_create (&thread, &attr, _sim_aio_worker, NULL))
+    ++sim_aio_pool_workers;
+pthread_attr_destroy (&attr);
+}
+
+/* Create the request queue for an asynchronous unit.
+   perform is called in a worker thread for each submitted request */
+
+SIM_AIO_UNITQ *sim_aio_unitq_create (UNIT *uptr, SIM_AIO_PERFORM perform)
+{
+SIM_AIO_UNITQ *q = (SIM_AIO_UNITQ *)calloc (1, sizeof (*q));
+DEVICE *dptr = uptr->dptr ? uptr->dptr : find_dev_from_unit (uptr);
+
+if (q == NULL)
+    return NULL;
+q->uptr = uptr;
+q->perform = perform;
+q->perf_latency = sim_perf_counter (dptr, "AIO LATENCY", SIM_PERF_LATENCY, "Asynchronous request submission to completion");
+q->perf_depth = sim_perf_counter (dptr, "AIO DEPTH", SIM_PERF_DEPTH, "Asynchronous requests outstanding at submission");
+pthread_mutex_lock (&sim_aio_pool_lock);
+q->next = sim_aio_pool_queues;
+sim_aio_pool_queues = q;
+pthread_mutex_unlock (&sim_aio_pool_lock);
+return q;
+}
+
+/* Release a unit's request queue.  Waits for any outstanding requests
+   to be performed.  Completed requests which haven't been collected
+   with sim_aio_complete() are the caller's responsibility */
+
+void sim_aio_unitq_free (SIM_AIO_UNITQ *q)
+{
+SIM_AIO_UNITQ **qp;
+
+if (q == NULL)
+    return;
+sim_aio_wait (q);
+pthread_mutex_lock (&sim_aio_pool_lock);
+for (qp = &sim_aio_pool_queues; *qp; qp = &(*qp)->next)
+    if (*qp == q) {
+        *qp = q->next;
+        break;
+        }
+pthread_mutex_unlock (&sim_aio_pool_lock);
+free (q);
+}
+
+/* Queue a request to be performed for a unit.  The unit is activated
+   latency instructions after the request has been performed */
+
+void sim_aio_submit (SIM_AIO_UNITQ *q, SIM_AIO_REQ *req, int32 latency)
+{
+pthread_mutex_lock (&sim_aio_pool_lock);
+req->next = NULL;
+req->queued = _sim_aio_now ();
+q->latency = latency;
+if (q->pend_tail)
+    q->pend_tail->next = req;
+else
+    q->pend_head = req;
+q->pend_tail = req;
+if (++q->depth > q->max_depth)
+    q->max_depth = q->depth;
+SIM_PERF_ADD (q->perf_depth, q->depth);
+if ((!q->busy) && (!q->ready))
+    _sim_aio_ready (q);
+if ((sim_aio_pool_idle == 0) &&
+    (sim_aio_pool_workers < sim_aio_pool_max_workers))
+    _sim_aio_start_worker ();
+pthread_mutex_unlock (&sim_aio_pool_lock);
+}
+
+/* Account for a request which is performed outside of the pool (for
+   example by a host asynchronous I/O facility).  sim_aio_done() must be
+   called once the request has been performed */
+
+void sim_aio_start (SIM_AIO_UNITQ *q, SIM_AIO_REQ *req, int32 latency)
+{
+pthread_mutex_lock (&sim_aio_pool_lock);
+req->next = NULL;
+req->queued = _sim_aio_now ();
+q->latency = latency;
+if (++q->depth > q->max_depth)
+    q->max_depth = q->depth;
+SIM_PERF_ADD (q->perf_depth, q->depth);
+pthread_mutex_unlock (&sim_aio_pool_lock);
+}
+
+/* Deliver a request started with sim_aio_start().  Must not be called
+   from the main thread, since the unit activation has to go through
+   sim_asynch_queue for the completion to be collected */
+
+void sim_aio_done (SIM_AIO_UNITQ *q, SIM_AIO_REQ *req)
+{
+pthread_mutex_lock (&sim_aio_pool_lock);
+_sim_aio_finish (q, req);
+pthread_mutex_unlock (&sim_aio_pool_lock);
+}
+
+/* Collect the oldest performed request for a unit (main thread) */
+
+SIM_AIO_REQ *sim_aio_complete (SIM_AIO_UNITQ *q)
+{
+SIM_AIO_REQ *req;
+
+pthread_mutex_lock (&sim_aio_pool_lock);
+req = q->done_head;
+if (req) {
+    q->done_head = req->next;
+    if (q->done_head == NULL)
+        q->done_tail = NULL;
+    req->next = NULL;
+    }
+pthread_mutex_unlock (&sim_aio_pool_lock);
+return req;
+}
+
+/* Determine if a unit has requests which haven't yet been performed */
+
+t_bool sim_aio_busy (SIM_AIO_UNITQ *q)
+{
+t_bool busy;
+
+pthread_mutex_lock (&sim_aio_pool_lock);
+busy = ((q->depth != 0) || q->busy);
+pthread_mutex_unlock (&sim_aio_pool_lock);
+return busy;
+}
+
+/* Wait until all requests submitted for a unit have been performed */
+
+void sim_aio_wait (SIM_AIO_UNITQ *q)
+{
+pthread_mutex_lock (&sim_aio_pool_lock);
+while ((q->depth != 0) || q->busy)
+    pthread_cond_wait (&sim_aio_pool_done, &sim_aio_pool_lock);
+pthread_mutex_unlock (&sim_aio_pool_lock);
+}
+
+/* Change the worker thread limit.  Surplus idle workers exit */
+
+void sim_aio_pool_set_workers (uint32 workers)
+{
+pthread_mutex_lock (&sim_aio_pool_lock);
+sim_aio_pool_max_workers = workers;
+pthread_cond_broadcast (&sim_aio_pool_work);
+pthread_mutex_unlock (&sim_aio_pool_lock);
+}
+
+/* Stop all worker threads */
+
+void sim_aio_pool_cleanup (void)
+{
+pthread_mutex_lock (&sim_aio_pool_lock);
+sim_aio_pool_stopping = TRUE;
+pthread_cond_broadcast (&sim_aio_pool_work);
+while (sim_aio_pool_workers != 0)
+    pthread_cond_wait (&sim_aio_pool_done, &sim_aio_pool_lock);
+pthread_mutex_unlock (&sim_aio_pool_lock);
+}
+
+static void sim_aio_pool_show (FILE *st)
+{
+SIM_AIO_UNITQ *q;
+
+pthread_mutex_lock (&sim_aio_pool_lock);
+fprintf (st, "I/O worker pool: %u of %u worker thread%s running, %u idle, at most %u busy at once\n",
+         sim_aio_pool_workers, sim_aio_pool_max_workers, (sim_aio_pool_max_workers == 1) ? "" : "s",
+         sim_aio_pool_idle, sim_aio_pool_busy_max);
+if (sim_aio_pool_queues) {
+    fprintf (st, "  %-10s %6s %6s %12s %14s %14s\n", "Unit", "Depth", "Max", "Requests", "Avg Latency", "Max Latency");
+    for (q = sim_aio_pool_queues; q; q = q->next)
+        fprintf (st, "  %-10s %6u %6u %12" LL_FMT "u %11.3f ms %11.3f ms\n",
+                 sim_uname (q->uptr), q->depth, q->max_depth, q->requests,
+                 q->requests ? (1000.0 * q->latency_total) / q->requests : 0.0,
+                 1000.0 * q->latency_max);
+    }
+pthread_mutex_unlock (&sim_aio_pool_lock);
+}
 #else /* !defined (SIM_ASYNCH_IO) */
 t_bool sim_asynch_enabled = FALSE;
 #endif
@@ -478,6 +1062,7 @@ void (*sim_vm_fprint_addr) (FILE *st, DEVICE *dptr, t_addr addr) = NULL;
 t_addr (*sim_vm_parse_addr) (DEVICE *dptr, CONST char *cptr, CONST char **tptr) = NULL;
 t_value (*sim_vm_pc_value) (void) = NULL;
 t_bool (*sim_vm_is_subroutine_call) (t_addr **ret_addrs) = NULL;
+int32 (*sim_vm_profile_stack) (t_addr *frames, int32 max) = NULL;
 void (*sim_vm_reg_update) (REG *rptr, uint32 idx, t_value prev_val, t_value new_val) = NULL;
 t_bool (*sim_vm_fprint_stopped) (FILE *st, t_stat reason) = NULL;
 const char *sim_vm_release = NULL;
@@ -494,6 +1079,7 @@ t_stat set_dev_enbdis (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
 t_stat set_dev_debug (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
 t_stat set_unit_enbdis (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
 t_stat set_unit_append (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
+t_stat set_dev_coalesce (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
 t_stat ssh_break (FILE *st, const char *cptr, int32 flg);
 t_stat show_cmd_fi (FILE *ofile, int32 flag, CONST char *cptr);
 t_stat show_config (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
@@ -596,6 +1182,18 @@ void int_handler (int signal);
 t_stat set_prompt (int32 flag, CONST char *cptr);
 t_stat set_runlimit (int32 flag, CONST char *cptr);
 t_stat sim_set_asynch (int32 flag, CONST char *cptr);
+t_stat sim_set_queue (int32 flag, CONST char *cptr);
+t_stat sim_show_queue_type (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
+t_stat sim_set_perf (int32 flag, CONST char *cptr);
+t_stat sim_show_perf (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
+static void _sim_perf_event (UNIT *uptr);
+static void _sim_perf_sched (void);
+static void _sim_perf_cancel (void);
+extern DEVICE sim_perf_dev;
+extern DEVICE sim_prof_dev;
+static t_stat _sim_eventq_insert (UNIT *uptr, int32 event_time);
+static void _sim_set_time (double new_time);
+static UNIT **_sim_eventq_units (uint32 *count);
 static const char *_get_dbg_verb (uint32 dbits, DEVICE* dptr, UNIT *uptr);
 static t_stat sim_sanity_check_register_declarations (DEVICE **devices);
 static t_stat sim_device_unit_tests (const char *cptr);
@@ -626,6 +1224,7 @@ int32 sim_opt_out = 0;
 volatile t_bool sim_is_running = FALSE;
 t_bool sim_processing_event = FALSE;
 uint32 sim_brk_summ = 0;
+uint32 sim_brk_filter[(1u << SIM_BRK_FILTER_BITS) / 32];
 uint32 sim_brk_types = 0;
 BRKTYPTAB *sim_brk_type_desc = NULL;                /* type descriptions */
 uint32 sim_brk_dflt = 0;
@@ -802,7 +1401,8 @@ const char *sim_savename = sim_name;      /* Simulator Name used in SAVE/RESTORE
 
 /* Tables and strings */
 
-const char save_vercur[] = "V4.0";
+const char save_vercur[] = "V4.1";
+const char save_ver41[] = "V4.1";
 const char save_ver40[] = "V4.0";
 const char save_ver35[] = "V3.5";
 const char save_ver32[] = "V3.2";
@@ -1059,6 +1659,12 @@ static const char simh_help1[] =
       " to a file.  This includes the contents of main memory and all registers,\n"
       " and the I/O connections of devices:\n\n"
       "++SAVE <filename>\n\n"
+      "4Switches\n"
+      " Switches can influence the output and behavior of the SAVE command\n\n"
+      "++-C      Compresses memory contents\n"
+      "++-I      Incremental save, only memory pages changed since the previous\n"
+      "++        SAVE are written.  The previous save file must remain present\n"
+      "++        and unchanged for the incremental save to be restored.\n\n"
 #define HLP_RESTORE     "*Commands Saving_and_Restoring_State RESTORE"
       "3RESTORE\n"
       " The RESTORE command (abbreviation REST, alternately GET) restores a\n"
@@ -1071,7 +1677,12 @@ static const char simh_help1[] =
       "++-F      Overrides the related file timestamp validation check\n"
       "\n"
       "4Notes:\n"
-      " 1) SAVE file format compresses zeroes to minimize file size.\n"
+      " 1) SAVE file format compresses zeroes to minimize file size.  Memory\n"
+      " of simulators which register their memory array is written and read\n"
+      " directly rather than through the examine and deposit routines.\n"
+      " Incremental saves reference the previous save file by the name used\n"
+      " in that SAVE command, restoring one restores the chain of saves it\n"
+      " depends on.\n"
       " 2) The simulator can't restore active incoming telnet sessions to\n"
       " multiplexer devices, but the listening ports will be restored across a\n"
       " save/restore.\n"
@@ -1469,6 +2080,16 @@ static const char simh_help1[] =
       " The buffered data is written to the specified destination file when\n"
       " control returns to the sim> prompt or every 30 seconds while the \n"
       " simulator is executing instructions.\n\n"
+      "5-Z\n"
+      " The -Z switch causes debug messages to be recorded in a compact binary\n"
+      " form without being formatted.  This substantially reduces the cost of\n"
+      " heavy debug output (for example instruction or packet tracing) while\n"
+      " the simulator is running.  The destination must be a file, and the -B\n"
+      " switch can't be combined with -Z.  Duplicate lines are not summarized.\n"
+      " The recorded trace is rendered as text with the DEBUGDECODE command:\n\n"
+      "++SET DEBUG -Z trace.bin\n"
+      "++...\n"
+      "++DEBUGDECODE trace.bin trace.log\n\n"
 #define HLP_SET_BREAK  "*Commands SET Breakpoints"
       "3Breakpoints\n"
       "+SET BREAK <list>            set breakpoints\n"
@@ -1484,7 +2105,13 @@ static const char simh_help1[] =
       "+SET THROTTLE x%%             occupy x percent of the host capacity\n"
       "++++++++executing instructions\n"
       "+SET THROTTLE x/t            sleep for t milliseconds after executing x\n"
-      "++++++++%C\n\n"
+      "++++++++%C\n"
+      "+SET THROTTLE PRECISE=xM     pace execution at x million %C per\n"
+      "++++++++second using sub-millisecond sleeps\n"
+      "+SET THROTTLE PRECISE=xK     pace execution at x thousand %C per\n"
+      "++++++++second using sub-millisecond sleeps\n"
+      "+SET THROTTLE PRECISE=x%%     pace execution at x percent of the host\n"
+      "++++++++capacity using sub-millisecond sleeps\n\n"
       "+SET NOTHROTTLE              set simulation rate to maximum\n\n"
       " Throttling is only available on host systems that implement a precision\n"
       " real-time delay function.\n\n"
@@ -1493,9 +2120,16 @@ static const char simh_help1[] =
       " to wall clock time.  Very short running programs may complete before\n"
       " calibration completes and therefore before the simulated execution rate\n"
       " can match the desired rate.\n\n"
+      " The PRECISE forms measure elapsed time with a high resolution monotonic\n"
+      " host clock and pause execution about every millisecond of simulated time,\n"
+      " rather than once per host clock tick.  The pause is computed by a\n"
+      " proportional-integral controller from the achieved execution rate, and\n"
+      " the final part of each pause is a busy wait, so a PRECISE throttle keeps\n"
+      " a host CPU busier than the other forms in exchange for an execution rate\n"
+      " without bursts.\n\n"
       " The SET NOTHROTTLE command turns off throttling.  The SHOW THROTTLE\n"
-      " command shows the current settings for throttling and the calibration\n"
-      " results\n\n"
+      " command shows the current settings for throttling, the calibration\n"
+      " results and the achieved execution rate relative to the desired rate\n\n"
       " Some simulators implement a different form of host CPU resource management\n"
       " called idling.  Idling suspends simulated execution whenever the program\n"
       " running in the simulator is doing nothing, and runs the simulator at full\n"
@@ -1551,6 +2185,59 @@ static const char simh_help1[] =
       "3Asynch\n"
       "+SET ASYNCH                  enable asynchronous I/O\n"
       "+SET NOASYNCH                disable asynchronous I/O\n"
+      "+SET ASYNCH WORKERS=n        limit the I/O worker pool to n threads\n\n"
+      " Asynchronous disk and tape units share a pool of I/O worker threads.\n"
+      " Each unit has its own request queue, which is serviced in order, while\n"
+      " requests for different units proceed concurrently.  Worker threads are\n"
+      " started as they are needed, up to the limit (default 4).  SHOW ASYNCH\n"
+      " displays the pool and each unit's queue depth and request latency.\n\n"
+      " Completions are delivered to devices in batches.  A device which\n"
+      " completes I/O very frequently (a busy network or disk controller) can\n"
+      " have its completions coalesced with SET <dev> COALESCE=usecs, so that\n"
+      " they are delivered at most once per interval and a burst of them\n"
+      " costs a single service call.  SHOW ASYNCH displays the delivery\n"
+      " statistics.\n"
+#define HLP_SET_QUEUE "*Commands SET Queue"
+      "3Queue\n"
+      "+SET QUEUE LIST              maintain the event queue as a delta list\n"
+      "+SET QUEUE HEAP              maintain the event queue as a binary heap\n\n"
+      " The event queue holds every pending unit activation.  The default LIST\n"
+      " implementation is ordered by the time between successive events, which\n"
+      " makes each activation or cancellation cost proportional to the number\n"
+      " of pending events.  The HEAP implementation orders events by absolute\n"
+      " due time, making activation and cancellation cost proportional to the\n"
+      " logarithm of the number of pending events.  Configurations with many\n"
+      " active devices (multiplexer lines, disk units, timers) may benefit from\n"
+      " the HEAP implementation.  Pending events are preserved when the\n"
+      " implementation is changed.  The SHOW QUEUE command displays the current\n"
+      " implementation.\n"
+#define HLP_SET_PERF "*Commands SET Perf"
+      "3Perf\n"
+      "+SET PERF ENABLED            start or resume collecting counters\n"
+      "+SET PERF DISABLED           suspend collecting counters\n"
+      "+SET PERF RESET              zero all performance counters\n"
+      "+SET PERF DUMP=file          append a snapshot of the counters to file\n"
+      "++++++++                     periodically while the simulator runs\n"
+      "+SET PERF INTERVAL=secs      simulated seconds between snapshots\n"
+      "++++++++                     (default 10)\n"
+      "+SET PERF FORMAT=CSV|JSON    snapshot file format (default CSV)\n"
+      "+SET PERF NODUMP             stop writing snapshots\n"
+      "+SET NOPERF                  stop collecting and writing snapshots\n\n"
+      " Options may be combined, separated by commas, for example:\n\n"
+      "++SET PERF FORMAT=JSON,INTERVAL=5,DUMP=perf.json\n\n"
+      " Performance counters record, for each device, the number of events\n"
+      " serviced and, for devices using the disk, tape, network and multiplexer\n"
+      " libraries, the transfers and bytes moved, the latency of I/O operations\n"
+      " and the depth of I/O queues.  They are intended to identify which device\n"
+      " limits the speed of a simulation without the cost of debug tracing.\n"
+      " Collection adds essentially no cost when disabled.\n\n"
+      " The SHOW PERF command displays the counters of every device.  SHOW PERF\n"
+      " dev displays the counters of one device, including a histogram of each\n"
+      " latency measurement.  CSV snapshots contain one row per counter with\n"
+      " the columns seconds, device, counter, type, count, total and max.  JSON\n"
+      " snapshots are one object per line, and include latency histograms with\n"
+      " buckets of less than 1, 1, 2, 4, 8, ... microseconds.  A final snapshot\n"
+      " is written when the dump file is closed.\n"
 #define HLP_SET_ENVIRON "*Commands SET Environment"
       "3Environment\n"
       "4Explicitily Changing a Variable\n"
@@ -1639,6 +2326,9 @@ static const char simh_help1[] =
       "+SET <dev> DISABLED          disable device\n"
       "+SET <dev> DEBUG{=arg}       set device debug flags\n"
       "+SET <dev> NODEBUG={arg}     clear device debug flags\n"
+      "+SET <dev> COALESCE=usecs    deliver the device's asynchronous I/O\n"
+      "++++++++                     completions at most once per interval\n"
+      "+SET <dev> NOCOALESCE        deliver each completion as it happens\n"
       "+SET <dev> arg{,arg...}      set device parameters (see show modifiers)\n"
       "+SET <unit> ENABLED          enable unit\n"
       "+SET <unit> DISABLED         disable unit\n"
@@ -1683,7 +2373,8 @@ static const char simh_help2[] =
       "+sh{ow} q{ueue}               show event queue\n"
       "+sh{ow} ti{me}                show simulated time\n"
       "+sh{ow} th{rottle}            show simulation rate\n"
-      "+sh{ow} a{synch}              show asynchronous I/O state\n"
+      "+sh{ow} a{synch}              show asynchronous I/O state and statistics\n"
+      "+sh{ow} perf {dev}            show performance counters\n"
       "+sh{ow} ve{rsion}             show simulator version\n"
       "+sh{ow} def{ault}             show current directory\n"
       "+sh{ow} re{mote}              show remote console configuration\n"
@@ -1723,6 +2414,7 @@ static const char simh_help2[] =
 #define HLP_SHOW_DEBUG          "*Commands SHOW"
 #define HLP_SHOW_THROTTLE       "*Commands SHOW"
 #define HLP_SHOW_ASYNCH         "*Commands SHOW"
+#define HLP_SHOW_PERF           "*Commands SHOW"
 #define HLP_SHOW_ETHERNET       "*Commands SHOW"
 #define HLP_SHOW_SERIAL         "*Commands SHOW"
 #define HLP_SHOW_SYNC           "*Commands SHOW"
@@ -2694,7 +3386,54 @@ static const char simh_help2[] =
       "4-z\n"
       " The -z switch will cause all zero containing sectors to be trimmed from the\n"
       " end of the container file, even if they were present when the metadata\n"
-      " was added.\n\n";
+      " was added.\n\n"
+#define HLP_DEBUGDECODE "*Commands Decoding_Binary_Debug_Traces"
+      "2Decoding Binary Debug Traces\n"
+      " Debug output which was recorded in binary form (SET DEBUG -Z) can be\n"
+      " rendered as regular debug text with the DEBUGDECODE command:\n\n"
+      "++DEBUGDECODE trace-file {output-file}\n\n"
+      " If no output file is specified, the decoded text is displayed.  A trace\n"
+      " file can be decoded by any simulator running on a host with the same byte\n"
+      " order as the host where the trace was recorded.\n\n"
+      "3Switches\n"
+      " Switches can be used to influence the behavior of the DEBUGDECODE command\n\n"
+      "4-a\n"
+      " The -a switch causes the decoded text to be appended to an existing\n"
+      " output file.  The default is to replace the output file.\n\n"
+#define HLP_PROFILE     "*Commands Profiling_Guest_Code"
+      "2Profiling Guest Code\n"
+      " The PROFILE command samples the simulated program counter while the\n"
+      " simulator runs to find where guest software spends its time.  Sampling\n"
+      " costs far less than the CPU instruction history and can remain active\n"
+      " while an operating system or application runs normally.\n\n"
+      "++PROFILE START {interval}    sample every interval instructions\n"
+      "+++++++++                     (default 10000)\n"
+      "++PROFILE STOP                stop sampling\n"
+      "++PROFILE RESET               discard the samples collected\n"
+      "++PROFILE SYMBOLS file        load a symbol table\n"
+      "++PROFILE SHOW {count}        display the most sampled addresses\n"
+      "++PROFILE SHOW RANGE=size {count}\n"
+      "+++++++++                     display samples by address range\n"
+      "++PROFILE SHOW SYMBOLS {count}\n"
+      "+++++++++                     display samples by symbol\n"
+      "++PROFILE FOLDED file         write samples in folded stack format\n\n"
+      " PROFILE by itself is the same as PROFILE SHOW.  Counts default to 20.\n"
+      " Sample intervals vary by up to 1/8 so that samples don't stay in step\n"
+      " with periodic guest code.\n\n"
+      "3Symbol Tables\n"
+      " A symbol table file contains one symbol per line, either as\n"
+      " \"address name\" or in the \"address type name\" form produced by nm.\n"
+      " Addresses are in the radix of the PC.  Lines starting with # or ; are\n"
+      " comments.  Each sample is attributed to the symbol with the highest\n"
+      " address at or below the sampled address.\n\n"
+      "3Folded Stacks\n"
+      " PROFILE FOLDED writes one line per distinct call chain, with the frames\n"
+      " (outermost first) separated by semicolons and followed by the number\n"
+      " of samples.  This is the input format of flame graph tools such as\n"
+      " flamegraph.pl.  Simulators which can walk the guest's call stack (for\n"
+      " example the VAX, using CALLS/CALLG frames) record the complete call\n"
+      " chain of each sample.  Other simulators record only the sampled\n"
+      " address.\n\n";
 
 
 static CTAB cmd_table[] = {
@@ -2771,6 +3510,8 @@ static CTAB cmd_table[] = {
     { "TESTLIB",    &test_lib_cmd,  0,          HLP_TESTLIB,    NULL, NULL },
     { "DISKINFO",   &sim_disk_info_cmd,  0,     HLP_DISKINFO,   NULL, NULL },
     { "ZAPTYPE",    &sim_disk_info_cmd,  1,     HLP_ZAPTYPE,    NULL, NULL },
+    { "DEBUGDECODE", &debug_decode_cmd, 0,      HLP_DEBUGDECODE, NULL, NULL },
+    { "PROFILE",    &profile_cmd,   0,          HLP_PROFILE,    NULL, NULL },
     { NULL,         NULL,           0,          NULL,           NULL, NULL }
     };
 
@@ -2791,6 +3532,9 @@ static CTAB set_glob_tab[] = {
     { "CLOCKS",     &sim_set_timers,            1, HLP_SET_CLOCK },
     { "ASYNCH",     &sim_set_asynch,            1, HLP_SET_ASYNCH },
     { "NOASYNCH",   &sim_set_asynch,            0, HLP_SET_ASYNCH },
+    { "QUEUE",      &sim_set_queue,             0, HLP_SET_QUEUE },
+    { "PERF",       &sim_set_perf,              1, HLP_SET_PERF },
+    { "NOPERF",     &sim_set_perf,              0, HLP_SET_PERF },
     { "ENVIRONMENT", &sim_set_environment,      1, HLP_SET_ENVIRON },
     { "ON",         &set_on,                    1, HLP_SET_ON },
     { "NOON",       &set_on,                    0, HLP_SET_ON },
@@ -2823,6 +3567,8 @@ static C1TAB set_dev_tab[] = {
     { "NODEBUG",    &set_dev_debug,     0 },
     { "APPEND",     &set_unit_append,   0 },
     { "EOF",        &set_unit_append,   0 },
+    { "COALESCE",   &set_dev_coalesce,  1 },
+    { "NOCOALESCE", &set_dev_coalesce,  0 },
     { NULL,         NULL,               0 }
     };
 
@@ -2855,6 +3601,7 @@ static SHTAB show_glob_tab[] = {
     { "DEBUG",          &sim_show_debug,            0, HLP_SHOW_DEBUG },
     { "THROTTLE",       &sim_show_throt,            0, HLP_SHOW_THROTTLE },
     { "ASYNCH",         &sim_show_asynch,           0, HLP_SHOW_ASYNCH },
+    { "PERF",           &sim_show_perf,             0, HLP_SHOW_PERF },
     { "ETHERNET",       &eth_show_devices,          0, HLP_SHOW_ETHERNET },
     { "SERIAL",         &sim_show_serial,           0, HLP_SHOW_SERIAL },
     { "SYNCHRONOUS",    &tmxr_show_sync_devices,    0, HLP_SHOW_SYNC },
@@ -3166,6 +3913,8 @@ sim_register_internal_device (&sim_expect_dev);
 sim_register_internal_device (&sim_step_dev);
 sim_register_internal_device (&sim_flush_dev);
 sim_register_internal_device (&sim_runlimit_dev);
+sim_register_internal_device (&sim_perf_dev);
+sim_register_internal_device (&sim_prof_dev);
 
 if ((stat = sim_ttinit ()) != SCPE_OK) {
     fprintf (stderr, "Fatal terminal initialization error\n%s\n",
@@ -3316,6 +4065,7 @@ cleanup_and_exit:
 
 sim_debug (SIM_DBG_SHUTDOWN, &sim_scp_dev, "Shutting Down: Status = %d - %s\n", SCPE_BARE_STATUS (stat), sim_error_text (stat));
 detach_all (0, TRUE);                                   /* close files */
+sim_set_perf (0, NULL);                                 /* final counter dump */
 if (sim_deb) {                                          /* If debugging */
     sim_switches |= SWMASK ('Q');                       /*   close debugging quietly */
     sim_set_deboff (0, NULL);                           /*   and cleanly */
@@ -6152,6 +6902,22 @@ return SCPE_OK;
 
 t_stat sim_set_asynch (int32 flag, CONST char *cptr)
 {
+#ifdef SIM_ASYNCH_IO
+if (flag && cptr && (*cptr != 0)) {                     /* pool parameter? */
+    char gbuf[CBUFSIZE];
+    uint32 workers;
+    t_stat r;
+
+    cptr = get_glyph (cptr, gbuf, '=');
+    if ((strcmp (gbuf, "WORKERS") != 0) || (*cptr == 0))
+        return sim_messagef (SCPE_ARG, "Expected WORKERS=n\n");
+    workers = (uint32)get_uint (cptr, 10, 64, &r);
+    if ((r != SCPE_OK) || (workers == 0))
+        return sim_messagef (SCPE_ARG, "Invalid worker count: %s\n", cptr);
+    sim_aio_pool_set_workers (workers);
+    return SCPE_OK;
+    }
+#endif
 if (cptr && (*cptr != 0))                               /* now eol? */
     return SCPE_2MARG;
 #ifdef SIM_ASYNCH_IO
@@ -6167,6 +6933,8 @@ if (1) {
             return sim_messagef (SCPE_ALATT, "Can't change asynch mode with %s device attached\n", dptr->name);
         }
     }
+if (!flag)                                              /* nothing may stay held */
+    sim_aio_coalesce_flush (NULL);
 sim_asynch_enabled = flag;
 sim_timer_change_asynch ();
 if (1) {
@@ -6198,6 +6966,8 @@ if (cptr && (*cptr != 0))
     return SCPE_2MARG;
 #ifdef SIM_ASYNCH_IO
 fprintf (st, "Asynchronous I/O is %sabled, %s\n", (sim_asynch_enabled) ? "en" : "dis", AIO_QUEUE_MODE);
+sim_aio_pool_show (st);
+sim_aio_coalesce_show (st);
 #if defined(SIM_ASYNCH_CLOCKS)
 fprintf (st, "Asynchronous Clock is %sabled\n", (sim_asynch_timer) ? "en" : "dis");
 #endif
@@ -6207,759 +6977,2076 @@ fprintf (st, "Asynchronous I/O is not available in this simulator\n");
 return SCPE_OK;
 }
 
-/* Set environment routine */
+/* Performance counters
+
+   Devices and the device support libraries register named counters
+   with sim_perf_counter().  A counter belongs to a device and is
+   shared by all of the device's units.  Counter types are:
+
+       SIM_PERF_EVENTS     number of occurrences
+       SIM_PERF_BYTES      number of transfers and the bytes transferred
+       SIM_PERF_LATENCY    number of samples, their total and maximum in
+                           microseconds, and a histogram of the samples
+                           in power of 2 microsecond buckets
+       SIM_PERF_DEPTH      number of samples of a queue depth, their
+                           total and maximum
+
+   Counters are only updated while collection is enabled with SET PERF
+   ENABLED.  Callers update counters through the SIM_PERF_ADD and
+   SIM_PERF_START macros, which reduce to a test of sim_perf_enabled
+   while collection is disabled.  Counters may be updated from I/O
+   worker and network reader threads, so updates are serialized by a
+   lock in asynchronous I/O builds.  A device's counters are never
+   released while the device exists, so pointers to them may be kept for
+   the life of the simulator.
+
+   SHOW PERF displays the counters.  SET PERF DUMP=file appends a
+   snapshot of every counter to a file at an interval of simulated
+   seconds, either as CSV rows or as one JSON object per line.
+ */
 
-t_stat sim_set_environment (int32 flag, CONST char *cptr)
+#define SIM_PERF_BUCKETS    24                  /* latency histogram buckets */
+
+struct SIM_PERF {
+    DEVICE              *dptr;                  /* owning device */
+    char                name[32];               /* counter name */
+    const char          *desc;                  /* description */
+    uint32              type;                   /* SIM_PERF_EVENTS, _BYTES, _LATENCY or _DEPTH */
+    t_uint64            count;                  /* occurrences, transfers or samples */
+    t_uint64            total;                  /* bytes, microseconds or depth sum */
+    t_uint64            max;                    /* largest sample */
+    t_uint64            hist[SIM_PERF_BUCKETS]; /* samples by power of 2 microseconds */
+    SIM_PERF            *next;
+    };
+
+static const char *sim_perf_types[] = {"events", "bytes", "latency", "depth"};
+
+volatile t_bool sim_perf_enabled = FALSE;               /* collecting counter values */
+static SIM_PERF *sim_perf_list = NULL;                  /* registered counters */
+static SIM_PERF **sim_perf_tail = &sim_perf_list;
+static SIM_PERF *sim_perf_queue = NULL;                 /* event queue depth */
+#define SIM_PERF_UNITS      256                 /* units with a cached events counter */
+static struct {                                         /* events counters of recently serviced units */
+    UNIT                *uptr;
+    SIM_PERF            *ctr;
+    } sim_perf_units[SIM_PERF_UNITS];
+static double sim_perf_start_time = 0.0;                /* host time collection started */
+static FILE *sim_perf_dump = NULL;                      /* periodic dump file */
+static char sim_perf_dump_name[CBUFSIZE];
+static uint32 sim_perf_dump_interval = 10;              /* seconds between dumps */
+static t_bool sim_perf_dump_json = FALSE;               /* dump format JSON rather than CSV */
+#if defined (SIM_ASYNCH_IO)
+static pthread_mutex_t sim_perf_lock = PTHREAD_MUTEX_INITIALIZER;
+#define PERF_LOCK   pthread_mutex_lock (&sim_perf_lock)
+#define PERF_UNLOCK pthread_mutex_unlock (&sim_perf_lock)
+#else
+#define PERF_LOCK
+#define PERF_UNLOCK
+#endif
+
+/* Host time in microseconds, for measuring latencies */
+
+double sim_perf_time (void)
 {
-char varname[CBUFSIZE], prompt[CBUFSIZE], cbuf[CBUFSIZE];
-int i;
+return sim_os_hrtime () / 1000.0;
+}
 
-if ((!cptr) || (*cptr == 0))                            /* now eol? */
-    return SCPE_2FARG;
-if (sim_switches & SWMASK ('P')) {
-    CONST char *deflt = NULL;
+/* Find or create a device's counter */
 
-    cptr = get_glyph_quoted (cptr, prompt, 0);          /* get prompt */
-    if (prompt[0] == '\0')
-        return sim_messagef (SCPE_2FARG, "Missing Prompt and Environment Variable Name\n");
-    if ((prompt[0] == '"') || (prompt[0] == '\'')) {
-        if (strlen (prompt) < 3)
-            return sim_messagef (SCPE_ARG, "Invalid Prompt\n");
-        prompt[strlen (prompt) - 1] = '\0';
-        memmove (prompt, prompt + 1, strlen (prompt));
-        }
-    deflt = get_glyph (cptr, varname, '=');             /* get environment variable name */
-    if (varname[0] == '\0')
-        return sim_messagef (SCPE_2FARG, "Missing Environment Variable Name\n");
-    if (deflt == NULL)
-        deflt = "";
-    if (*deflt) {
-        strlcat (prompt, " [", sizeof (prompt));
-        strlcat (prompt, deflt, sizeof (prompt));
-        strlcat (prompt, "] ", sizeof (prompt));
+SIM_PERF *sim_perf_counter (DEVICE *dptr, const char *name, uint32 type, const char *desc)
+{
+SIM_PERF *ctr;
+
+PERF_LOCK;
+for (ctr = sim_perf_list; ctr != NULL; ctr = ctr->next)
+    if ((ctr->dptr == dptr) && (strcmp (ctr->name, name) == 0))
+        break;
+if (ctr == NULL) {
+    ctr = (SIM_PERF *)calloc (1, sizeof (*ctr));
+    if (ctr != NULL) {
+        ctr->dptr = dptr;
+        strlcpy (ctr->name, name, sizeof (ctr->name));
+        ctr->desc = desc;
+        ctr->type = type;
+        *sim_perf_tail = ctr;
+        sim_perf_tail = &ctr->next;
         }
-    else
-        strlcat (prompt, " ", sizeof (prompt));
-    if (sim_rem_cmd_active_line == -1) {
-        cptr = read_line_p (prompt, cbuf, sizeof(cbuf), stdin);
-        if (cptr == NULL)
-            printf ("\n");
-        if ((cptr == NULL) || (*cptr == 0))
-            cptr = deflt;
-        else
-            cptr = cbuf;
+    }
+PERF_UNLOCK;
+return ctr;
+}
+
+/* Release a device's counters (only for devices which no longer exist) */
+
+static void _sim_perf_release (DEVICE *dptr)
+{
+SIM_PERF **pctr = &sim_perf_list;
+int i;
+
+PERF_LOCK;
+for (i = 0; i < SIM_PERF_UNITS; i++)                    /* forget the device's units */
+    if ((sim_perf_units[i].ctr != NULL) && (sim_perf_units[i].ctr->dptr == dptr))
+        sim_perf_units[i].uptr = NULL;
+while (*pctr != NULL) {
+    SIM_PERF *ctr = *pctr;
+
+    if (ctr->dptr == dptr) {
+        *pctr = ctr->next;
+        free (ctr);
         }
     else
-        cptr = deflt;
+        pctr = &ctr->next;
     }
-else {
-    cptr = get_glyph (cptr, varname, '=');              /* get environment variable name */
-    strlcpy (cbuf, cptr, sizeof(cbuf));
-    sim_trim_endspc (cbuf);
-    if (sim_switches & SWMASK ('S')) {                  /* Quote String argument? */
-        uint32 str_size;
+for (sim_perf_tail = &sim_perf_list; *sim_perf_tail != NULL; sim_perf_tail = &(*sim_perf_tail)->next)
+    ;
+PERF_UNLOCK;
+}
 
-        cptr = cbuf;
-        get_glyph_quoted (cptr, cbuf, 0);
-        if (SCPE_OK != sim_decode_quoted_string (cbuf, (uint8 *)cbuf, &str_size))
-            return sim_messagef (SCPE_ARG, "Invalid quoted string: %s\n", cbuf);
-        cbuf[str_size] = '\0';
-        }
-    else {
-        if (sim_switches & SWMASK ('A')) {              /* Arithmetic Expression Evaluation argument? */
-            t_svalue val;
-            t_stat stat;
-            const char *eptr = cptr;
-
-            if ((cptr > sim_sub_instr_buf) && ((size_t)(cptr - sim_sub_instr_buf) < sim_sub_instr_size))
-                eptr = &sim_sub_instr[sim_sub_instr_off[cptr - sim_sub_instr_buf]]; /* get un-substituted string */
-            cptr = sim_eval_expression (eptr, &val, FALSE, &stat);
-            if (stat == SCPE_OK) {
-                sprintf (cbuf, "%ld", (long)val);
-                cptr = cbuf;
-                }
-            else
-                return stat;
-            }
+void sim_perf_add (SIM_PERF *ctr, t_uint64 value)
+{
+int bucket = 0;
+
+if (ctr == NULL)
+    return;
+PERF_LOCK;
+if (ctr->type == SIM_PERF_EVENTS)
+    ctr->count += value;
+else {
+    ++ctr->count;
+    ctr->total += value;
+    if (value > ctr->max)
+        ctr->max = value;
+    if (ctr->type == SIM_PERF_LATENCY) {
+        while ((value != 0) && (bucket < SIM_PERF_BUCKETS - 1)) {
+            value >>= 1;
+            ++bucket;
+            }
+        ++ctr->hist[bucket];
         }
     }
-setenv(varname, cptr, 1);
-/* remove the newly set name from the collection of alias conflicting external names */
-for (i = 0; i < sim_external_env_count; i++) {
-    if (0 == strcmp (varname, sim_external_env[i].name)) {
-        int j;
-
-        free (sim_external_env[i].name);
-        free (sim_external_env[i].value);
-        for (j = 0; (i + j) < sim_external_env_count; j++)
-            sim_external_env[i + j] = sim_external_env[i + j + 1];
-        --sim_external_env_count;
-        }
-    }
-return SCPE_OK;
+PERF_UNLOCK;
 }
 
-/* Set command */
+/* Record the latency of an operation which started at host time start
+   (as returned by SIM_PERF_START, which is 0 when collection was
+   disabled at the time) */
 
-t_stat set_cmd (int32 flag, CONST char *cptr)
+void sim_perf_latency (SIM_PERF *ctr, double start)
 {
-uint32 lvl = 0;
-t_stat r;
-char gbuf[CBUFSIZE], *cvptr;
-CONST char *svptr;
-DEVICE *dptr;
-UNIT *uptr;
-MTAB *mptr;
-CTAB *gcmdp;
-C1TAB *ctbr = NULL, *glbr;
-
-GET_SWITCHES (cptr);                                    /* get switches */
-if (*cptr == 0)                                         /* must be more */
-    return SCPE_2FARG;
-cptr = get_glyph (svptr = cptr, gbuf, 0);               /* get glob/dev/unit */
-
-if ((dptr = find_dev (gbuf))) {                         /* device match? */
-    uptr = dptr->units;                                 /* first unit */
-    ctbr = set_dev_tab;                                 /* global table */
-    lvl = MTAB_VDV;                                     /* device match */
-    GET_SWITCHES (cptr);                                /* get more switches */
-    if (dptr->numunits == 1)                            /* Single unit devices have optional */
-        lvl |= MTAB_VUN;                                /*  unit number */
-    }
-else {
-    if ((dptr = find_unit (gbuf, &uptr))) {             /* unit match? */
-        if (uptr == NULL)                               /* invalid unit */
-            return SCPE_NXUN;
-        ctbr = set_unit_tab;                            /* global table */
-        lvl = MTAB_VUN;                                 /* unit match */
-        GET_SWITCHES (cptr);                            /* get more switches */
-        }
-    else {
-        if ((gcmdp = find_ctab (set_glob_tab, gbuf))) { /* global? */
-            GET_SWITCHES (cptr);                        /* get more switches */
-            return gcmdp->action (gcmdp->arg, cptr);    /* do the rest */
-            }
-        else {
-            if (sim_dflt_dev->modifiers) {
-                if ((cvptr = strchr (gbuf, '=')))       /* = value? */
-                    *cvptr++ = 0;
-                for (mptr = sim_dflt_dev->modifiers; mptr->mask != 0; mptr++) {
-                    if (mptr->mstring && (MATCH_CMD (gbuf, mptr->mstring) == 0)) {
-                        dptr = sim_dflt_dev;
-                        cptr = svptr;
-                        while (sim_isspace(*cptr))
-                            ++cptr;
-                        break;
-                        }
-                    }
-                }
-            if (!dptr)
-                return sim_messagef (SCPE_NXDEV, "Non-existent device: %s\n", gbuf);/* no match */
-            lvl = MTAB_VDV;                             /* device match */
-            uptr = dptr->units;                         /* first unit */
-            }
-        }
-    }
-if ((*cptr == 0) ||                                     /* must be more */
-    (*cptr == ';') ||
-    (*cptr == '#'))
-    return SCPE_2FARG;
-GET_SWITCHES (cptr);                                    /* get more switches */
+double usecs;
 
-while (*cptr != 0) {                                    /* do all mods */
-    cptr = get_glyph (svptr = cptr, gbuf, ',');         /* get modifier */
-    if (0 == strcmp (gbuf, ";"))
-        break;
-    if ((cvptr = strchr (gbuf, '=')))                   /* = value? */
-        *cvptr++ = 0;
-    for (mptr = dptr->modifiers; mptr && (mptr->mask != 0); mptr++) {
-        if ((mptr->mstring) &&                          /* match string */
-            (MATCH_CMD (gbuf, mptr->mstring) == 0)) {   /* matches option? */
-            if (mptr->mask & MTAB_XTD) {                /* extended? */
-                if (((lvl & mptr->mask) & ~MTAB_XTD) == 0)
-                    return SCPE_ARG;
-                if ((lvl == MTAB_VUN) && (uptr->flags & UNIT_DIS))
-                    return sim_messagef (SCPE_UDIS, "Unit disabled: %s\n", sim_uname (uptr));
-                if (mptr->valid) {                      /* validation rtn? */
-                    if (cvptr && MODMASK(mptr,MTAB_QUOTE)) {
-                        svptr = get_glyph_quoted (svptr, gbuf, ',');
-                        if ((cvptr = strchr (gbuf, '='))) {
-                            *cvptr++ = 0;
-                            cptr = svptr;
-                            }
-                        }
-                    else {
-                        if (cvptr && MODMASK(mptr,MTAB_NC)) {
-                            get_glyph_nc (svptr, gbuf, ',');
-                            if ((cvptr = strchr (gbuf, '=')))
-                                *cvptr++ = 0;
-                            }
-                        }
-                    r = mptr->valid (uptr, mptr->match, cvptr, mptr->desc);
-                    if (r != SCPE_OK)
-                        return r;
-                    }
-                else
-                    if (!mptr->desc)                    /* value desc? */
-                        break;
-                    else
-                        if (cvptr)                      /* = value? */
-                            return SCPE_ARG;
-                        else
-                            *((int32 *) mptr->desc) = mptr->match;
-                }                                       /* end if xtd */
-            else {                                      /* old style */
-                if (cvptr)                              /* = value? */
-                    return SCPE_ARG;
-                if (uptr->flags & UNIT_DIS)             /* disabled? */
-                    return sim_messagef (SCPE_UDIS, "Unit disabled: %s\n", sim_uname (uptr));
-                if ((mptr->valid) &&                    /* invalid? */
-                    ((r = mptr->valid (uptr, mptr->match, cvptr, mptr->desc)) != SCPE_OK))
-                    return r;
-                uptr->flags = (uptr->flags & ~(mptr->mask)) |
-                    (mptr->match & mptr->mask);         /* set new value */
-                }                                       /* end else xtd */
-            break;                                      /* terminate for */
-            }                                           /* end if match */
-        }                                               /* end for */
-    if (!mptr || (mptr->mask == 0)) {                   /* no match? */
-        if ((glbr = find_c1tab (ctbr, gbuf))) {         /* global match? */
-            r = glbr->action (dptr, uptr, glbr->arg, cvptr);    /* do global */
-            if (r != SCPE_OK)
-                return r;
-            }
-        else
-            if (!dptr->modifiers)                      /* no modifiers? */
-                return sim_messagef (SCPE_NOPARAM, "%s device has no parameters\n", dptr->name);
-            else
-                return sim_messagef (SCPE_NXPAR, "%s device: Non-existent parameter - %s\n", dptr->name, gbuf);
-        }                                               /* end if no mat */
-    }                                                   /* end while */
-return SCPE_OK;                                         /* done all */
+if (start == 0.0)
+    return;
+usecs = sim_perf_time () - start;
+sim_perf_add (ctr, (usecs > 0.0) ? (t_uint64)usecs : 0);
 }
 
-/* Match CTAB/CTAB1 name */
+/* Count an event dispatched for a unit.  Units map to a slot in a small
+   table by address, so a unit only looks up its device's counter again
+   when another unit has taken its slot. */
 
-CTAB *find_ctab (CTAB *tab, const char *gbuf)
+static void _sim_perf_event (UNIT *uptr)
 {
-if (!tab)
-    return NULL;
-for (; tab->name != NULL; tab++) {
-    if (MATCH_CMD (gbuf, tab->name) == 0)
-        return tab;
+size_t slot = ((size_t)uptr / sizeof (UNIT)) % SIM_PERF_UNITS;
+
+if (sim_perf_units[slot].uptr != uptr) {
+    DEVICE *dptr = uptr->dptr ? uptr->dptr : find_dev_from_unit (uptr);
+
+    if (dptr == NULL)
+        return;
+    sim_perf_units[slot].ctr = sim_perf_counter (dptr, "EVENTS", SIM_PERF_EVENTS, "Events serviced");
+    sim_perf_units[slot].uptr = uptr;
     }
-return NULL;
+sim_perf_add (sim_perf_units[slot].ctr, 1);
+sim_perf_add (sim_perf_queue, (t_uint64)sim_qcount ());
 }
 
-C1TAB *find_c1tab (C1TAB *tab, const char *gbuf)
+static void _sim_perf_reset (void)
 {
-if (!tab)
-    return NULL;
-for (; tab->name != NULL; tab++) {
-    if (MATCH_CMD (gbuf, tab->name) == 0)
-        return tab;
+SIM_PERF *ctr;
+
+PERF_LOCK;
+for (ctr = sim_perf_list; ctr != NULL; ctr = ctr->next) {
+    ctr->count = ctr->total = ctr->max = 0;
+    memset (ctr->hist, 0, sizeof (ctr->hist));
     }
-return NULL;
+PERF_UNLOCK;
+sim_perf_start_time = sim_perf_time ();
 }
 
-/* Set device data radix routine */
+/* Format a counter value with thousands separators.  Several values may
+   be formatted for a single output line. */
 
-t_stat set_dev_radix (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+static const char *_sim_perf_fmt (t_uint64 value)
 {
-if (cptr)
-    return SCPE_ARG;
-dptr->dradix = flag & 037;
-return SCPE_OK;
+static char buf[4][32];
+static int next = 0;
+char tmp[32];
+char *p;
+size_t len, c;
+
+next = (next + 1) & 3;
+p = buf[next];
+sprintf (tmp, "%" LL_FMT "u", value);
+len = strlen (tmp);
+for (c = 0; c < len; c++) {
+    if ((c > 0) && (0 == ((len - c) % 3)))
+        *(p++) = ',';
+    *(p++) = tmp[c];
+    }
+*p = '\0';
+return buf[next];
 }
 
-/* Set device enabled/disabled routine */
+static const char *_sim_perf_dname (SIM_PERF *ctr)
+{
+return (ctr->dptr != NULL) ? sim_dname (ctr->dptr) : "";
+}
 
-t_stat set_dev_enbdis (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+static void _sim_perf_show_ctr (FILE *st, SIM_PERF *ctr, t_bool histogram)
 {
-UNIT *up;
-uint32 i;
+int b, last;
 
-if (cptr)
-    return SCPE_ARG;
-if ((dptr->flags & DEV_DISABLE) == 0)                   /* allowed? */
-    return SCPE_NOFNC;
-if (flag) {                                             /* enable? */
-    if ((dptr->flags & DEV_DIS) == 0)                   /* already enb? ok */
-        return SCPE_OK;
-    dptr->flags = dptr->flags & ~DEV_DIS;               /* no, enable */
-    }
-else {
-    if (dptr->flags & DEV_DIS)                          /* already dsb? ok */
-        return SCPE_OK;
-    for (i = 0; i < dptr->numunits; i++) {              /* check units */
-        up = (dptr->units) + i;                         /* att or active? */
-        if ((up->flags & UNIT_ATT) || sim_is_active (up))
-            return sim_messagef (SCPE_NOFNC, "%s has attached or busy units\n", sim_dname (dptr));                          /* can't do it */
-        }
-    dptr->flags = dptr->flags | DEV_DIS;                /* disable */
+fprintf (st, "  %-20s", ctr->name);
+switch (ctr->type) {
+    case SIM_PERF_EVENTS:
+        fprintf (st, " %s\n", _sim_perf_fmt (ctr->count));
+        break;
+    case SIM_PERF_BYTES:
+        fprintf (st, " %s transfer%s", _sim_perf_fmt (ctr->count), (ctr->count == 1) ? "" : "s");
+        fprintf (st, ", %s bytes", _sim_perf_fmt (ctr->total));
+        if (ctr->count)
+            fprintf (st, ", largest %s", _sim_perf_fmt (ctr->max));
+        fprintf (st, "\n");
+        break;
+    case SIM_PERF_LATENCY:
+        fprintf (st, " %s sample%s", _sim_perf_fmt (ctr->count), (ctr->count == 1) ? "" : "s");
+        if (ctr->count) {
+            fprintf (st, ", average %.1f usecs", (double)ctr->total / (double)ctr->count);
+            fprintf (st, ", maximum %s usecs", _sim_perf_fmt (ctr->max));
+            }
+        fprintf (st, "\n");
+        if (histogram && ctr->count) {
+            for (last = SIM_PERF_BUCKETS - 1; (last > 0) && (ctr->hist[last] == 0); last--)
+                ;
+            for (b = 0; b <= last; b++) {
+                if (b == 0)
+                    fprintf (st, "    %10s usecs", "< 1");
+                else
+                    fprintf (st, "    %10s usecs", _sim_perf_fmt ((t_uint64)1 << (b - 1)));
+                fprintf (st, " %s\n", _sim_perf_fmt (ctr->hist[b]));
+                }
+            }
+        break;
+    case SIM_PERF_DEPTH:
+        fprintf (st, " %s sample%s", _sim_perf_fmt (ctr->count), (ctr->count == 1) ? "" : "s");
+        if (ctr->count) {
+            fprintf (st, ", average %.1f", (double)ctr->total / (double)ctr->count);
+            fprintf (st, ", maximum %s", _sim_perf_fmt (ctr->max));
+            }
+        fprintf (st, "\n");
+        break;
     }
-if (dptr->reset)                                        /* reset device */
-    return dptr->reset (dptr);
-else return SCPE_OK;
 }
 
-/* Set unit enabled/disabled routine */
+/* Write a snapshot of every counter to the dump file */
 
-t_stat set_unit_enbdis (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+static void _sim_perf_write_dump (FILE *f)
 {
-if (cptr)
-    return SCPE_ARG;
-if (!(uptr->flags & UNIT_DISABLE))                      /* allowed? */
-    return SCPE_NOFNC;
-if (flag)                                               /* enb? enable */
-    uptr->flags = uptr->flags & ~UNIT_DIS;
-else {
-    if ((uptr->flags & UNIT_ATT) ||                     /* dsb */
-        sim_is_active (uptr))                           /* more tests */
-        return sim_messagef (SCPE_NOFNC, "%s is attached or busy\n", sim_uname (uptr));
-    uptr->flags = uptr->flags | UNIT_DIS;               /* disable */
+SIM_PERF *ctr;
+double secs = (sim_perf_time () - sim_perf_start_time) / 1000000.0;
+const char *sep = "";
+int b, last;
+
+PERF_LOCK;
+if (sim_perf_dump_json)
+    fprintf (f, "{\"seconds\":%.3f,\"counters\":[", secs);
+for (ctr = sim_perf_list; ctr != NULL; ctr = ctr->next) {
+    if (!sim_perf_dump_json) {
+        fprintf (f, "%.3f,%s,%s,%s,%" LL_FMT "u,%" LL_FMT "u,%" LL_FMT "u\n", secs, _sim_perf_dname (ctr), ctr->name,
+                    sim_perf_types[ctr->type], ctr->count, ctr->total, ctr->max);
+        continue;
+        }
+    fprintf (f, "%s{\"device\":\"%s\",\"counter\":\"%s\",\"type\":\"%s\",", sep, _sim_perf_dname (ctr), ctr->name, sim_perf_types[ctr->type]);
+    fprintf (f, "\"count\":%" LL_FMT "u,\"total\":%" LL_FMT "u,\"max\":%" LL_FMT "u", ctr->count, ctr->total, ctr->max);
+    if (ctr->type == SIM_PERF_LATENCY) {
+        for (last = SIM_PERF_BUCKETS - 1; (last > 0) && (ctr->hist[last] == 0); last--)
+            ;
+        fprintf (f, ",\"histogram\":[");
+        for (b = 0; b <= last; b++)
+            fprintf (f, "%s%" LL_FMT "u", b ? "," : "", ctr->hist[b]);
+        fprintf (f, "]");
+        }
+    fprintf (f, "}");
+    sep = ",";
     }
-return SCPE_OK;
+if (sim_perf_dump_json)
+    fprintf (f, "]}\n");
+PERF_UNLOCK;
+fflush (f);
 }
 
-/* Set device/unit debug enabled/disabled routine */
+static t_stat sim_perf_svc (UNIT *uptr)
+{
+if (sim_perf_dump == NULL)
+    return SCPE_OK;
+_sim_perf_write_dump (sim_perf_dump);
+return sim_activate_after (uptr, sim_perf_dump_interval * 1000000);
+}
 
-t_stat set_dev_debug (DEVICE *dptr, UNIT *uptr, int32 flags, CONST char *cptr)
+static const char *sim_int_perf_description (DEVICE *dptr)
 {
-int32 flag = flags & 1;
-t_bool uflag = ((flags & 2) != 0);
-char gbuf[CBUFSIZE];
-DEBTAB *dep;
-t_stat r = SCPE_OK;
-
-if ((dptr->flags & DEV_DEBUG) == 0)
-    return SCPE_NOFNC;
-if (cptr == NULL) {                                     /* no arguments? */
-    if (uflag)
-        uptr->dctrl = flag ? (dptr->debflags ? flag : 0xFFFFFFFF) : 0;/* disable/enable w/o table */
-    else
-        dptr->dctrl = flag ? (dptr->debflags ? flag : 0xFFFFFFFF) : 0;/* disable/enable w/o table */
-    if (flag && dptr->debflags) {                       /* enable with table? */
-        for (dep = dptr->debflags; dep->name != NULL; dep++)
-            if (uflag)
-                uptr->dctrl = uptr->dctrl | dep->mask;      /* set all */
-            else
-                dptr->dctrl = dptr->dctrl | dep->mask;      /* set all */
-        }
-    return SCPE_OK;
-    }
-if (dptr->debflags == NULL)                             /* must have table */
-    return sim_messagef (SCPE_ARG, "The %s device doesn't have DEBUG options.\n", dptr->name);
-while (*cptr) {
-    cptr = get_glyph (cptr, gbuf, ';');                 /* get debug flag */
-    for (dep = dptr->debflags; dep->name != NULL; dep++) {
-        if (strcmp (dep->name, gbuf) == 0) {            /* match? */
-            if (flag)
-                if (uflag)
-                    uptr->dctrl = uptr->dctrl | dep->mask;
-                else
-                    dptr->dctrl = dptr->dctrl | dep->mask;
-            else
-                if (uflag)
-                    uptr->dctrl = uptr->dctrl & ~dep->mask;
-                else
-                    dptr->dctrl = dptr->dctrl & ~dep->mask;
-            break;
-            }
-        }                                               /* end for */
-    if (dep->mask == 0)                                 /* no match? */
-        r = sim_messagef (SCPE_ARG, "Invalid DEBUG option '%s' for %s device\n", gbuf, dptr->name);
-    }                                                   /* end while */
-return r;
+return "Performance counter dump facility";
 }
 
-/* Set sequential unit position to EOF */
+static REG sim_perf_reg[] = {
+    { DRDATAD(DUMP_INTERVAL, sim_perf_dump_interval, 32, "Seconds between performance counter dumps") },
+    { NULL}
+    };
 
-t_stat set_unit_append (DEVICE *dptr, UNIT *uptr, int32 flags, CONST char *cptr)
+static UNIT sim_perf_unit = { UDATA (&sim_perf_svc, UNIT_IDLE, 0) };
+DEVICE sim_perf_dev = {
+    "INT-PERF", &sim_perf_unit, sim_perf_reg, NULL,
+    1, 0, 0, 0, 0, 0,
+    NULL, NULL, NULL, NULL, NULL, NULL,
+    NULL, DEV_NOSAVE, 0,
+    NULL, NULL, NULL, NULL, NULL, NULL,
+    sim_int_perf_description};
+
+static void _sim_perf_sched (void)
 {
-if (!(uptr->flags & UNIT_SEQ))
-    return sim_messagef (SCPE_NOFNC, "%s is not a sequential device.\n", sim_uname (uptr));
-if (uptr->flags & UNIT_BUF)
-    return sim_messagef (SCPE_NOFNC, "Can't append to a buffered device %s.\n", sim_uname (uptr));
-if (!(uptr->flags & UNIT_ATT))
-    return SCPE_UNATT;
+if (sim_perf_dump != NULL)
+    sim_activate_after (&sim_perf_unit, sim_perf_dump_interval * 1000000);
+}
 
-if (0 == sim_fseek (uptr->fileref, 0, SEEK_END)) {
-    uptr->pos = (t_addr)sim_ftell (uptr->fileref);      /* Position at end of file */
-    return SCPE_OK;
-    }
+static void _sim_perf_cancel (void)
+{
+sim_cancel (&sim_perf_unit);
+}
 
-return sim_messagef (SCPE_IERR, "%s Can't seek to end of file: %s - %s\n", sim_uname (uptr), sim_attach_name (uptr), strerror (errno));
+static void _sim_perf_close_dump (void)
+{
+if (sim_perf_dump == NULL)
+    return;
+_sim_perf_cancel ();
+_sim_perf_write_dump (sim_perf_dump);                   /* final snapshot */
+fclose (sim_perf_dump);
+sim_perf_dump = NULL;
 }
 
-/* Show command */
+/* SET PERF ENABLED|DISABLED|RESET|DUMP=file|NODUMP|INTERVAL=secs|FORMAT=CSV|JSON
+   and SET NOPERF */
 
-t_stat show_cmd (int32 flag, CONST char *cptr)
+t_stat sim_set_perf (int32 flag, CONST char *cptr)
 {
+char gbuf[CBUFSIZE];
+char *vptr;
 t_stat r;
 
-cptr = get_sim_opt (CMD_OPT_SW|CMD_OPT_OF, cptr, &r);
-                                                        /* get sw, ofile */
-if (!cptr)                                              /* error? */
-    return r;
-if (sim_ofile) {                                        /* output file? */
-    r = show_cmd_fi (sim_ofile, flag, cptr);            /* do show */
-    fclose (sim_ofile);
+if (flag == 0) {                                        /* NOPERF */
+    if (cptr && (*cptr != 0))
+        return SCPE_2MARG;
+    _sim_perf_close_dump ();
+    sim_perf_enabled = FALSE;
+    return SCPE_OK;
     }
-else {
-    r = show_cmd_fi (stdout, flag, cptr);               /* no, stdout, log */
-    if ((!sim_oline) && (sim_log && (sim_log != stdout)))
-        show_cmd_fi (sim_log, flag, cptr);
-    if ((!sim_oline) && (sim_deb && (sim_deb != stdout) && (sim_deb != sim_log)))
-        show_cmd_fi (sim_deb, flag, cptr);
+if ((cptr == NULL) || (*cptr == 0))
+    return SCPE_2FARG;
+while (*cptr != 0) {
+    cptr = get_glyph_nc (cptr, gbuf, ',');
+    vptr = strchr (gbuf, '=');
+    if (vptr != NULL)
+        *vptr++ = '\0';
+    if ((sim_strcasecmp (gbuf, "ENABLED") == 0) ||
+        (sim_strcasecmp (gbuf, "ENABLE") == 0)) {
+        if (!sim_perf_enabled) {
+            if (sim_perf_queue == NULL)
+                sim_perf_queue = sim_perf_counter (&sim_scp_dev, "EVENT QUEUE", SIM_PERF_DEPTH, "Event queue depth when events are serviced");
+            if (sim_perf_start_time == 0.0)             /* first collection? */
+                sim_perf_start_time = sim_perf_time ();
+            sim_perf_enabled = TRUE;
+            }
+        }
+    else if ((sim_strcasecmp (gbuf, "DISABLED") == 0) ||
+             (sim_strcasecmp (gbuf, "DISABLE") == 0))
+        sim_perf_enabled = FALSE;
+    else if (sim_strcasecmp (gbuf, "RESET") == 0)
+        _sim_perf_reset ();
+    else if (sim_strcasecmp (gbuf, "NODUMP") == 0)
+        _sim_perf_close_dump ();
+    else if (sim_strcasecmp (gbuf, "INTERVAL") == 0) {
+        uint32 secs = (uint32)get_uint (vptr ? vptr : "", 10, 86400, &r);
+
+        if ((vptr == NULL) || (r != SCPE_OK) || (secs == 0))
+            return sim_messagef (SCPE_ARG, "Invalid dump interval: %s\n", vptr ? vptr : "");
+        sim_perf_dump_interval = secs;
+        }
+    else if (sim_strcasecmp (gbuf, "FORMAT") == 0) {
+        if (vptr && (sim_strcasecmp (vptr, "CSV") == 0))
+            sim_perf_dump_json = FALSE;
+        else if (vptr && (sim_strcasecmp (vptr, "JSON") == 0))
+            sim_perf_dump_json = TRUE;
+        else
+            return sim_messagef (SCPE_ARG, "Invalid dump format: %s\n", vptr ? vptr : "");
+        }
+    else if (sim_strcasecmp (gbuf, "DUMP") == 0) {
+        t_bool new_file;
+
+        if ((vptr == NULL) || (*vptr == 0))
+            return sim_messagef (SCPE_2FARG, "Missing dump file name\n");
+        _sim_perf_close_dump ();
+        new_file = (sim_fsize_name (vptr) == 0);
+        sim_perf_dump = sim_fopen (vptr, "a");
+        if (sim_perf_dump == NULL)
+            return sim_messagef (SCPE_OPENERR, "Can't open performance dump file %s: %s\n", vptr, strerror (errno));
+        strlcpy (sim_perf_dump_name, vptr, sizeof (sim_perf_dump_name));
+        if (new_file && !sim_perf_dump_json)
+            fprintf (sim_perf_dump, "seconds,device,counter,type,count,total,max\n");
+        if (!sim_perf_enabled)
+            sim_set_perf (1, "ENABLED");
+        if (sim_is_running)
+            _sim_perf_sched ();
+        }
+    else
+        return sim_messagef (SCPE_ARG, "Unknown PERF option: %s\n", gbuf);
     }
-return r;
+return SCPE_OK;
 }
 
-t_stat show_cmd_fi (FILE *ofile, int32 flag, CONST char *cptr)
+static t_bool _sim_perf_show_dev (FILE *st, DEVICE *dptr, t_bool histogram)
 {
-uint32 lvl = 0xFFFFFFFF;
-char gbuf[CBUFSIZE], *cvptr;
-CONST char *svptr;
-DEVICE *dptr;
-UNIT *uptr;
-MTAB *mptr;
-SHTAB *shtb = NULL, *shptr;
+SIM_PERF *ctr;
+t_bool any = FALSE;
 
-GET_SWITCHES (cptr);                                    /* get switches */
-if ((*cptr == 0) || (*cptr == ';') || (*cptr == '#'))   /* must be more */
-    return SCPE_2FARG;
-cptr = get_glyph (svptr = cptr, gbuf, 0);               /* get next glyph */
+for (ctr = sim_perf_list; ctr != NULL; ctr = ctr->next) {
+    if (ctr->dptr != dptr)
+        continue;
+    if (!any)
+        fprintf (st, "%s:\n", sim_dname (dptr));
+    any = TRUE;
+    _sim_perf_show_ctr (st, ctr, histogram);
+    }
+return any;
+}
 
-if ((dptr = find_dev (gbuf))) {                         /* device match? */
-    uptr = dptr->units;                                 /* first unit */
-    shtb = show_dev_tab;                                /* global table */
-    lvl = MTAB_VDV;                                     /* device match */
-    GET_SWITCHES (cptr);                                /* get more switches */
+/* SHOW PERF {dev} */
+
+t_stat sim_show_perf (FILE *st, DEVICE *dnotused, UNIT *unotused, int32 flag, CONST char *cptr)
+{
+char gbuf[CBUFSIZE];
+DEVICE *dptr = NULL, *cdptr;
+int32 i;
+t_bool any = FALSE;
+
+if (cptr && (*cptr != 0)) {
+    cptr = get_glyph (cptr, gbuf, 0);
+    if (*cptr != 0)
+        return SCPE_2MARG;
+    dptr = find_dev (gbuf);
+    if (dptr == NULL)
+        return sim_messagef (SCPE_NXDEV, "Non-existent device: %s\n", gbuf);
     }
+if (sim_perf_enabled)
+    fprintf (st, "Performance counters enabled for %.3f seconds\n", (sim_perf_time () - sim_perf_start_time) / 1000000.0);
+else
+    fprintf (st, "Performance counters disabled\n");
+if (sim_perf_dump)
+    fprintf (st, "Dumping to %s as %s every %u seconds\n", sim_perf_dump_name, sim_perf_dump_json ? "JSON" : "CSV", sim_perf_dump_interval);
+if (dptr != NULL)                                       /* one device, with histograms */
+    any = _sim_perf_show_dev (st, dptr, TRUE);
 else {
-    if ((dptr = find_unit (gbuf, &uptr))) {             /* unit match? */
-        if (uptr == NULL)                               /* invalid unit */
-            return sim_messagef (SCPE_NXUN, "Non-existent unit: %s\n", gbuf);
-        if (uptr->flags & UNIT_DIS)                     /* disabled? */
-            return sim_messagef (SCPE_UDIS, "Unit disabled: %s\n", gbuf);
-        shtb = show_unit_tab;                           /* global table */
-        lvl = MTAB_VUN;                                 /* unit match */
-        GET_SWITCHES (cptr);                            /* get more switches */
-        }
-    else {
-        if ((shptr = find_shtab (show_glob_tab, gbuf))) {/* global? */
-            GET_SWITCHES (cptr);                        /* get more switches */
-            return shptr->action (ofile, NULL, NULL, shptr->arg, cptr);
-            }
-        else {
-            if (sim_dflt_dev->modifiers) {
-                if ((cvptr = strchr (gbuf, '=')))       /* = value? */
-                    *cvptr++ = 0;
-                for (mptr = sim_dflt_dev->modifiers; mptr && (mptr->mask != 0); mptr++) {
-                    if ((((mptr->mask & MTAB_VDV) == MTAB_VDV) &&
-                         (mptr->pstring && (MATCH_CMD (gbuf, mptr->pstring) == 0))) ||
-                        (!(mptr->mask & MTAB_VDV) && (mptr->mstring && (MATCH_CMD (gbuf, mptr->mstring) == 0)))) {
-                        dptr = sim_dflt_dev;
-                        lvl = MTAB_VDV;                 /* device match */
-                        cptr = svptr;
-                        while (sim_isspace(*cptr))
-                            ++cptr;
-                        break;
-                        }
-                    }
-                }
-            if (!dptr) {
-                if ((shptr = find_shtab (show_dev_tab, gbuf)))  /* global match? */
-                    return shptr->action (ofile, sim_dflt_dev, uptr, shptr->arg, cptr);
-                else
-                    return sim_messagef (SCPE_NXDEV, "Non-existent device: %s\n", gbuf);/* no match */
-                }
-            }
-        }
+    for (i = 0; (cdptr = sim_devices[i]) != NULL; i++)
+        any |= _sim_perf_show_dev (st, cdptr, FALSE);
+    for (i = 0; sim_internal_device_count && (cdptr = sim_internal_devices[i]); ++i)
+        any |= _sim_perf_show_dev (st, cdptr, FALSE);
     }
+if (!any)
+    fprintf (st, "No counters%s%s\n", dptr ? " for " : "", dptr ? sim_dname (dptr) : "");
+return SCPE_OK;
+}
 
-if ((*cptr == 0) || (*cptr == ';') || (*cptr == '#')) { /* now eol? */
-    return (lvl == MTAB_VDV)?
-        show_device (ofile, dptr, 0):
-        show_unit (ofile, dptr, uptr, -1);
-    }
-GET_SWITCHES (cptr);                                    /* get more switches */
+/* Guest code profiler
 
-while (*cptr != 0) {                                    /* do all mods */
-    cptr = get_glyph (cptr, gbuf, ',');                 /* get modifier */
-    if ((cvptr = strchr (gbuf, '=')))                   /* = value? */
-        *cvptr++ = 0;
-    for (mptr = dptr->modifiers; mptr && (mptr->mask != 0); mptr++) {
-        if (((mptr->mask & MTAB_XTD)?                   /* right level? */
-            ((mptr->mask & lvl) == lvl): (MTAB_VUN & lvl)) &&
-            ((mptr->disp && mptr->pstring &&            /* named disp? */
-            (MATCH_CMD (gbuf, mptr->pstring) == 0))
-            )) {
-            if (cvptr && !MODMASK(mptr,MTAB_SHP))
-                return sim_messagef (SCPE_ARG, "Invalid Argument: %s=%s\n", gbuf, cvptr);
-            show_one_mod (ofile, dptr, uptr, mptr, cvptr, 1);
-            break;
-            }                                           /* end if */
-        }                                               /* end for */
-    if (!mptr || (mptr->mask == 0)) {                   /* no match? */
-        if (shtb && (shptr = find_shtab (shtb, gbuf))) {/* global match? */
-            t_stat r;
+   The PROFILE command samples the simulated PC every interval
+   instructions from an internal event unit and accumulates the
+   samples in a hash table keyed by address.  The sample interval is
+   varied by up to 1/8 so that samples don't stay in lock step with
+   periodic guest code.  Simulators which can walk the guest's call
+   stack provide a sim_vm_profile_stack routine which returns the
+   return addresses of the active calls, innermost first.  When it is
+   present, each sample's call chain is also recorded so that it can
+   be written in the folded stack format used by flame graph tools.
 
-            r = shptr->action (ofile, dptr, uptr, shptr->arg, cptr);
-            if (r != SCPE_OK)
-                return r;
-            }
-        else {
-            if (!dptr->modifiers)                       /* no modifiers? */
-                return sim_messagef (SCPE_NOPARAM, "%s device has no parameters\n", dptr->name);
-            else
-                return sim_messagef (SCPE_NXPAR, "%s device: Non-existent parameter: %s\n", dptr->name, gbuf);
-            }
-        }                                               /* end if */
-    }                                                   /* end while */
-return SCPE_OK;
-}
+   Samples can be reported by address, by address range or, once a
+   symbol table has been loaded, by symbol.  A symbol table file
+   contains lines of the form "address name" or the "address type
+   name" lines produced by nm, with addresses in the radix of the PC.
+ */
 
-SHTAB *find_shtab (SHTAB *tab, const char *gbuf)
-{
-if (!tab)
-    return NULL;
-for (; tab->name != NULL; tab++) {
-    if (MATCH_CMD (gbuf, tab->name) == 0)
-        return tab;
+#define PROF_DFLT_INTERVAL  10000                       /* default instructions between samples */
+#define PROF_MAX_DEPTH      32                          /* maximum call chain depth recorded */
+#define PROF_DFLT_SHOW      20                          /* default entries reported */
+
+typedef struct {
+    t_addr              addr;
+    t_uint64            count;
+    } PROF_ENTRY;
+
+typedef struct {
+    uint32              hash;
+    uint32              depth;                          /* frames, PC first */
+    t_addr              *frames;
+    t_uint64            count;
+    } PROF_STACK;
+
+typedef struct {
+    t_addr              addr;
+    char                *name;
+    } PROF_SYM;
+
+static t_bool sim_prof_active = FALSE;                  /* sampling */
+static int32 sim_prof_interval = PROF_DFLT_INTERVAL;
+static uint32 sim_prof_seed = 1;                        /* interval dither */
+static t_uint64 sim_prof_samples = 0;
+static PROF_ENTRY *sim_prof_tab = NULL;                 /* samples by address */
+static uint32 sim_prof_size = 0;                        /* table slots (power of 2) */
+static uint32 sim_prof_used = 0;
+static PROF_STACK *sim_prof_stacks = NULL;              /* samples by call chain */
+static uint32 sim_prof_stack_size = 0;
+static uint32 sim_prof_stack_used = 0;
+static PROF_SYM *sim_prof_syms = NULL;                  /* symbol table, in address order */
+static uint32 sim_prof_sym_count = 0;
+
+static uint32 _sim_prof_hash (t_addr addr)
+{
+t_uint64 a = (t_uint64)addr;
+uint32 h = (uint32)(a ^ (a >> 32)) * 2654435761u;
+
+return h ^ (h >> 16);
+}
+
+static t_bool _sim_prof_grow (void)
+{
+PROF_ENTRY *otab = sim_prof_tab;
+uint32 osize = sim_prof_size;
+uint32 i, j, mask;
+
+sim_prof_size = osize ? 2 * osize : 4096;
+sim_prof_tab = (PROF_ENTRY *)calloc (sim_prof_size, sizeof (*sim_prof_tab));
+if (sim_prof_tab == NULL) {
+    sim_prof_tab = otab;
+    sim_prof_size = osize;
+    return FALSE;
     }
-return NULL;
+mask = sim_prof_size - 1;
+for (i = 0; i < osize; i++) {
+    if (otab[i].count == 0)
+        continue;
+    for (j = _sim_prof_hash (otab[i].addr) & mask; sim_prof_tab[j].count; j = (j + 1) & mask)
+        ;
+    sim_prof_tab[j] = otab[i];
+    }
+free (otab);
+return TRUE;
 }
 
-/* Show device and unit */
+static void _sim_prof_record (t_addr addr)
+{
+uint32 i, mask;
 
-static size_t dev_name_len;
-static size_t unit_name_len;
+if ((2 * (sim_prof_used + 1) > sim_prof_size) && !_sim_prof_grow ())
+    return;
+mask = sim_prof_size - 1;
+for (i = _sim_prof_hash (addr) & mask; sim_prof_tab[i].count; i = (i + 1) & mask)
+    if (sim_prof_tab[i].addr == addr)
+        break;
+if (sim_prof_tab[i].count == 0) {
+    sim_prof_tab[i].addr = addr;
+    ++sim_prof_used;
+    }
+++sim_prof_tab[i].count;
+++sim_prof_samples;
+}
 
-const char *_sim_name_prefix (const char *name, const char *prefix, size_t max_name_len)
+static t_bool _sim_prof_stack_grow (void)
 {
-static char nambuf[CBUFSIZE];
-size_t prefix_len = prefix ? strlen (prefix) : 0;
-size_t name_len = name ? strlen (name) : 0;
-size_t string_len = prefix_len + name_len;
+PROF_STACK *otab = sim_prof_stacks;
+uint32 osize = sim_prof_stack_size;
+uint32 i, j, mask;
 
-snprintf (nambuf, sizeof (nambuf), "%s%*s", prefix ? prefix : "",
-                                            ((string_len <= 6) && (max_name_len <= 6)) ? -((int)(8 - prefix_len)) :
-                                                                                        -((int)(max_name_len + 2)),
-                                                                                        name ? name : "");
-return nambuf;
+sim_prof_stack_size = osize ? 2 * osize : 1024;
+sim_prof_stacks = (PROF_STACK *)calloc (sim_prof_stack_size, sizeof (*sim_prof_stacks));
+if (sim_prof_stacks == NULL) {
+    sim_prof_stacks = otab;
+    sim_prof_stack_size = osize;
+    return FALSE;
+    }
+mask = sim_prof_stack_size - 1;
+for (i = 0; i < osize; i++) {
+    if (otab[i].count == 0)
+        continue;
+    for (j = otab[i].hash & mask; sim_prof_stacks[j].count; j = (j + 1) & mask)
+        ;
+    sim_prof_stacks[j] = otab[i];
+    }
+free (otab);
+return TRUE;
 }
 
-const char *_sim_dname_prefix (DEVICE *dptr, const char *prefix)
+static void _sim_prof_record_stack (const t_addr *frames, uint32 depth)
 {
-return _sim_name_prefix (sim_dname (dptr), prefix, dev_name_len);
+uint32 i, d, hash = 0, mask;
+PROF_STACK *s;
+
+for (d = 0; d < depth; d++)
+    hash = (hash * 31) ^ _sim_prof_hash (frames[d]);
+if ((2 * (sim_prof_stack_used + 1) > sim_prof_stack_size) && !_sim_prof_stack_grow ())
+    return;
+mask = sim_prof_stack_size - 1;
+for (i = hash & mask; sim_prof_stacks[i].count; i = (i + 1) & mask) {
+    s = &sim_prof_stacks[i];
+    if ((s->hash == hash) && (s->depth == depth) &&
+        (memcmp (s->frames, frames, depth * sizeof (*frames)) == 0))
+        break;
+    }
+s = &sim_prof_stacks[i];
+if (s->count == 0) {
+    s->frames = (t_addr *)malloc (depth * sizeof (*frames));
+    if (s->frames == NULL)
+        return;
+    memcpy (s->frames, frames, depth * sizeof (*frames));
+    s->hash = hash;
+    s->depth = depth;
+    ++sim_prof_stack_used;
+    }
+++s->count;
 }
 
-const char *_sim_uname_prefix (UNIT *uptr, const char *prefix)
+static t_addr _sim_prof_pc (void)
 {
-return _sim_name_prefix (sim_uname (uptr), prefix, unit_name_len);
+if (sim_vm_pc_value)
+    return (t_addr)(*sim_vm_pc_value)();
+return (t_addr)get_rval (sim_PC, 0);
 }
 
-const char *_sim_dname (DEVICE *dptr)
+static t_stat sim_prof_svc (UNIT *uptr)
 {
-return _sim_dname_prefix (dptr, "");
+int32 dither = sim_prof_interval / 8;
+
+if (!sim_prof_active)
+    return SCPE_OK;
+if (sim_vm_profile_stack) {
+    t_addr frames[PROF_MAX_DEPTH + 1];
+    int32 depth;
+
+    frames[0] = _sim_prof_pc ();
+    depth = (*sim_vm_profile_stack) (&frames[1], PROF_MAX_DEPTH);
+    depth = (depth < 0) ? 0 : ((depth > PROF_MAX_DEPTH) ? PROF_MAX_DEPTH : depth);
+    _sim_prof_record (frames[0]);
+    _sim_prof_record_stack (frames, (uint32)depth + 1);
+    }
+else
+    _sim_prof_record (_sim_prof_pc ());
+sim_prof_seed = sim_prof_seed * 1103515245 + 12345;     /* vary next interval by up to 1/8 */
+if (dither > 0)
+    dither = (int32)((sim_prof_seed >> 16) % (uint32)(2 * dither + 1)) - dither;
+return sim_activate (uptr, sim_prof_interval + dither);
 }
 
-const char *_sim_uname (UNIT *uptr)
+static t_stat sim_prof_reset (DEVICE *dptr);
+
+static const char *sim_int_prof_description (DEVICE *dptr)
 {
-return _sim_uname_prefix (uptr, "");
+return "Guest code profiler";
 }
 
-const char *_sim_dname_space (void)
+static UNIT sim_prof_unit = { UDATA (&sim_prof_svc, UNIT_IDLE, 0) };
+DEVICE sim_prof_dev = {
+    "INT-PROFILE", &sim_prof_unit, NULL, NULL,
+    1, 0, 0, 0, 0, 0,
+    NULL, NULL, &sim_prof_reset, NULL, NULL, NULL,
+    NULL, DEV_NOSAVE, 0,
+    NULL, NULL, NULL, NULL, NULL, NULL,
+    sim_int_prof_description};
+
+static t_stat sim_prof_reset (DEVICE *dptr)
 {
-return _sim_dname_prefix (NULL, "");
+if (sim_prof_active && !sim_is_active (&sim_prof_unit)) /* sampling survives RUN and BOOT queue flushes */
+    return sim_activate (&sim_prof_unit, sim_prof_interval);
+return SCPE_OK;
 }
 
-const char *_sim_uname_space (void)
+static void _sim_prof_reset (void)
 {
-return _sim_uname_prefix (NULL, "");
+uint32 i;
+
+for (i = 0; i < sim_prof_stack_size; i++)
+    free (sim_prof_stacks[i].frames);
+free (sim_prof_stacks);
+free (sim_prof_tab);
+sim_prof_stacks = NULL;
+sim_prof_tab = NULL;
+sim_prof_stack_size = sim_prof_stack_used = 0;
+sim_prof_size = sim_prof_used = 0;
+sim_prof_samples = 0;
 }
 
-void _set_dname_len (DEVICE *dptr)
+static void _sim_prof_free_syms (void)
 {
 uint32 i;
 
-if (dev_name_len < strlen (sim_dname (dptr)))
-    dev_name_len = strlen (sim_dname (dptr));
-for (i = 0; i < dptr->numunits; i++) {
-    UNIT *uptr = &dptr->units[i];
+for (i = 0; i < sim_prof_sym_count; i++)
+    free (sim_prof_syms[i].name);
+free (sim_prof_syms);
+sim_prof_syms = NULL;
+sim_prof_sym_count = 0;
+}
 
-    if (((uptr->flags & UNIT_DIS) == 0) &&
-        (unit_name_len < strlen (sim_uname (uptr))))
-        unit_name_len = strlen (sim_uname (uptr));
+static int _sim_prof_sym_cmp (const void *pa, const void *pb)
+{
+const PROF_SYM *a = (const PROF_SYM *)pa;
+const PROF_SYM *b = (const PROF_SYM *)pb;
+
+return (a->addr < b->addr) ? -1 : ((a->addr > b->addr) ? 1 : 0);
+}
+
+/* Load a symbol table file, replacing any current symbols */
+
+static t_stat _sim_prof_load_syms (const char *filename)
+{
+FILE *f;
+char line[CBUFSIZE], tok[3][CBUFSIZE];
+CONST char *cptr, *tptr;
+uint32 radix = sim_PC ? sim_PC->radix : 16;
+uint32 alloc = 0, ignored = 0;
+PROF_SYM *sym;
+t_addr addr;
+int n;
+
+f = sim_fopen (filename, "r");
+if (f == NULL)
+    return sim_messagef (SCPE_OPENERR, "Can't open symbol file %s: %s\n", filename, strerror (errno));
+_sim_prof_free_syms ();
+while (fgets (line, sizeof (line), f)) {
+    cptr = line;
+    for (n = 0; (n < 3) && *cptr; n++)
+        cptr = get_glyph_nc (cptr, tok[n], 0);
+    if ((n == 0) || (tok[0][0] == '#') || (tok[0][0] == ';'))
+        continue;                                       /* blank or comment line */
+    addr = (t_addr)strtotv (tok[0], &tptr, radix);
+    if ((n < 2) || (tptr == tok[0]) || (*tptr != '\0')) {
+        ++ignored;                                      /* no address (e.g. nm undefined symbol) */
+        continue;
+        }
+    if (sim_prof_sym_count == alloc) {
+        PROF_SYM *nsyms;
+
+        alloc = alloc ? 2 * alloc : 256;
+        nsyms = (PROF_SYM *)realloc (sim_prof_syms, alloc * sizeof (*sim_prof_syms));
+        if (nsyms == NULL)
+            break;
+        sim_prof_syms = nsyms;
+        }
+    sym = &sim_prof_syms[sim_prof_sym_count];
+    sym->addr = addr;
+    sym->name = (char *)malloc (1 + strlen (tok[n - 1]));/* nm lines are: address type name */
+    if (sym->name == NULL)
+        break;
+    strcpy (sym->name, tok[n - 1]);
+    ++sim_prof_sym_count;
     }
+fclose (f);
+qsort (sim_prof_syms, sim_prof_sym_count, sizeof (*sim_prof_syms), _sim_prof_sym_cmp);
+if (ignored)
+    sim_messagef (SCPE_OK, "%u lines without a valid address ignored\n", ignored);
+return sim_messagef (SCPE_OK, "%u symbols loaded from %s\n", sim_prof_sym_count, filename);
 }
 
-t_stat show_device (FILE *st, DEVICE *dptr, int32 flag)
+/* Find the symbol at or below an address */
+
+static const PROF_SYM *_sim_prof_find_sym (t_addr addr)
 {
-uint32 j, udbl, ucnt;
-UNIT *uptr;
-int32 toks = -1;
-t_bool did_set_dname_len = FALSE;
+uint32 lo = 0, hi = sim_prof_sym_count;
 
-if (dev_name_len == 0) {
-    _set_dname_len (dptr);
-    did_set_dname_len = TRUE;
+if ((sim_prof_sym_count == 0) || (addr < sim_prof_syms[0].addr))
+    return NULL;
+while (hi - lo > 1) {
+    uint32 mid = (lo + hi) / 2;
+
+    if (sim_prof_syms[mid].addr <= addr)
+        lo = mid;
+    else
+        hi = mid;
     }
-fprintf (st, "%s", _sim_dname (dptr));                   /* print dev name */
-if ((flag == 2) && dptr->description) {
-    fprintf (st, "%s\n", dptr->description(dptr));
-    fprintf (st, "%s", _sim_dname_space ());
+return &sim_prof_syms[lo];
+}
+
+static void _sim_prof_sprint_addr (char *buf, t_addr addr)
+{
+if (sim_PC)
+    sprint_val (buf, (t_value)addr, sim_PC->radix, sim_PC->width, PV_RZRO);
+else
+    sprint_val (buf, (t_value)addr, 16, 32, PV_RZRO);
+}
+
+/* Describe an address as symbol+offset, or as the address itself */
+
+static void _sim_prof_sprint_loc (char *buf, size_t size, t_addr addr)
+{
+const PROF_SYM *sym = _sim_prof_find_sym (addr);
+char abuf[64];
+
+if (sym == NULL) {
+    _sim_prof_sprint_addr (abuf, addr);
+    strlcpy (buf, abuf, size);
+    return;
     }
-else {
-    if ((sim_switches & SWMASK ('D')) && dptr->description) {
-        fprintf (st, "%s\n", dptr->description(dptr));
-        fprintf (st, "%s", _sim_dname_space ());
-        }
+if (sym->addr == addr) {
+    strlcpy (buf, sym->name, size);
+    return;
     }
-if (qdisable (dptr)) {                                  /* disabled? */
-    fprintf (st, "%s\n", "disabled");
-    goto Cleanup_Return;
+sprint_val (abuf, (t_value)(addr - sym->addr), sim_PC ? sim_PC->radix : 16, 32, PV_LEFT);
+snprintf (buf, size, "%s+%s", sym->name, abuf);
+}
+
+static int _sim_prof_addr_cmp (const void *pa, const void *pb)
+{
+const PROF_ENTRY *a = (const PROF_ENTRY *)pa;
+const PROF_ENTRY *b = (const PROF_ENTRY *)pb;
+
+return (a->addr < b->addr) ? -1 : ((a->addr > b->addr) ? 1 : 0);
+}
+
+static int _sim_prof_count_cmp (const void *pa, const void *pb)
+{
+const PROF_ENTRY *a = (const PROF_ENTRY *)pa;
+const PROF_ENTRY *b = (const PROF_ENTRY *)pb;
+
+if (a->count != b->count)
+    return (a->count > b->count) ? -1 : 1;
+return (a->addr < b->addr) ? -1 : ((a->addr > b->addr) ? 1 : 0);
+}
+
+#define PROF_BY_ADDR    0
+#define PROF_BY_RANGE   1
+#define PROF_BY_SYMBOL  2
+
+/* Aggregate the samples by address, by address range or by symbol and
+   return them sorted by decreasing count */
+
+static PROF_ENTRY *_sim_prof_collect (int mode, t_addr range, uint32 *count)
+{
+PROF_ENTRY *ent, *out;
+uint32 i, n = 0;
+
+*count = 0;
+ent = (PROF_ENTRY *)calloc (sim_prof_used + 1, sizeof (*ent));
+if (ent == NULL)
+    return NULL;
+for (i = 0; i < sim_prof_size; i++) {
+    t_addr key;
+
+    if (sim_prof_tab[i].count == 0)
+        continue;
+    key = sim_prof_tab[i].addr;
+    if (mode == PROF_BY_RANGE)
+        key -= key % range;
+    else if (mode == PROF_BY_SYMBOL) {
+        const PROF_SYM *sym = _sim_prof_find_sym (key);
+
+        key = (sym != NULL) ? (t_addr)(sym - sim_prof_syms) : (t_addr)sim_prof_sym_count;
+        }
+    ent[n].addr = key;
+    ent[n++].count = sim_prof_tab[i].count;
     }
-for (j = ucnt = udbl = 0; j < dptr->numunits; j++) {    /* count units */
-    uptr = dptr->units + j;
-    if (!(uptr->flags & UNIT_DIS))                      /* count enabled units */
-        ucnt++;
+qsort (ent, n, sizeof (*ent), _sim_prof_addr_cmp);      /* group equal keys */
+for (i = 0, out = ent, *count = 0; i < n; i++) {
+    if ((*count > 0) && (out[*count - 1].addr == ent[i].addr))
+        out[*count - 1].count += ent[i].count;
     else
-        if (uptr->flags & UNIT_DISABLE)
-            udbl++;                                     /* count user-disabled */
-    }
-show_all_mods (st, dptr, dptr->units, MTAB_VDV, &toks); /* show dev mods */
-if (dptr->numunits == 0) {
-    if (toks)
-        fprintf (st, "\n");
+        out[(*count)++] = ent[i];
     }
-else {
-    if (ucnt == 0) {
-        fprint_sep (st, &toks, MTAB_VDV);
-        fprintf (st, "all %d units disabled\n", udbl);
+qsort (out, *count, sizeof (*out), _sim_prof_count_cmp);
+return out;
+}
+
+static void _sim_prof_show (FILE *st, int mode, t_addr range, uint32 limit)
+{
+PROF_ENTRY *ent;
+uint32 i, n;
+char buf[CBUFSIZE], abuf[64];
+
+fprintf (st, "Profiling %s, sampling every %d %s\n", sim_prof_active ? "active" : "stopped",
+             sim_prof_interval, sim_vm_interval_units);
+fprintf (st, "%" LL_FMT "u sample%s at %u address%s", sim_prof_samples, (sim_prof_samples == 1) ? "" : "s",
+             sim_prof_used, (sim_prof_used == 1) ? "" : "es");
+if (sim_prof_stack_used)
+    fprintf (st, " in %u call chain%s", sim_prof_stack_used, (sim_prof_stack_used == 1) ? "" : "s");
+fprintf (st, "\n");
+if (sim_prof_sym_count)
+    fprintf (st, "%u symbols loaded\n", sim_prof_sym_count);
+if (sim_prof_samples == 0)
+    return;
+ent = _sim_prof_collect (mode, range, &n);
+if (ent == NULL)
+    return;
+for (i = 0; (i < n) && (i < limit); i++) {
+    double pct = (100.0 * ent[i].count) / sim_prof_samples;
+
+    if (mode == PROF_BY_SYMBOL) {
+        if (ent[i].addr < sim_prof_sym_count)
+            strlcpy (buf, sim_prof_syms[ent[i].addr].name, sizeof (buf));
+        else
+            strlcpy (buf, "(no symbol)", sizeof (buf));
+        }
+    else if (mode == PROF_BY_RANGE) {
+        _sim_prof_sprint_addr (buf, ent[i].addr);
+        _sim_prof_sprint_addr (abuf, ent[i].addr + range - 1);
+        strlcat (buf, "-", sizeof (buf));
+        strlcat (buf, abuf, sizeof (buf));
         }
     else {
-        if ((ucnt > 1) || (udbl > 0)) {
-            fprint_sep (st, &toks, MTAB_VDV);
-            fprintf (st, "%d units\n", ucnt + udbl);
-            }
-        else {
-            if ((flag != 2) || !dptr->description || toks) {
-                if ((ucnt == 1) && (toks < 0) && (flag != 2) &&
-                    (dptr->description) && ((sim_switches & SWMASK ('D')) == 0))
-                    fprintf (st, "%s", dptr->description (dptr));
-                fprintf (st, "\n");
-                }
+        _sim_prof_sprint_addr (buf, ent[i].addr);
+        if (sim_prof_sym_count) {
+            strlcat (buf, "  ", sizeof (buf));
+            _sim_prof_sprint_loc (abuf, sizeof (abuf), ent[i].addr);
+            strlcat (buf, abuf, sizeof (buf));
             }
         }
-    toks = 0;
-    }
-if (flag)                                               /* dev only? */
-    goto Cleanup_Return;
-for (j = 0; j < dptr->numunits; j++) {                  /* loop thru units */
-    uptr = dptr->units + j;
-    if ((uptr->flags & UNIT_DIS) == 0)
-        show_unit (st, dptr, uptr, ucnt + udbl);
+    fprintf (st, "%12" LL_FMT "u %6.2f%%  %s\n", ent[i].count, pct, buf);
     }
-Cleanup_Return:
-if (did_set_dname_len)
-    dev_name_len = unit_name_len = 0;
-return SCPE_OK;
+if (n > limit)
+    fprintf (st, "%u more not shown\n", n - limit);
+free (ent);
 }
 
-void fprint_sep (FILE *st, int32 *tokens, int32 flag)
-{
-fprintf (st, "%s", (*tokens > 0) ? ", " : ((*tokens < 0) ? "" : ((flag == MTAB_VDV) ? _sim_dname_space () : _sim_uname_space ())));
-*tokens += 1;
-if (*tokens == 0)
-    *tokens = 1;
-}
+/* Write the samples in folded stack format: one line per distinct call
+   chain, outermost frame first, frames separated by semicolons and
+   followed by the number of samples */
 
-t_stat show_unit (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag)
+static t_stat _sim_prof_write_folded (const char *filename)
 {
-int32 toks = -1;
+FILE *f = sim_fopen (filename, "w");
+char loc[CBUFSIZE];
+uint32 i, d, lines = 0;
 
-if (flag > 1)
-    fprintf (st, "%s", _sim_uname_prefix (uptr, "  "));
-else
-    if (flag < 0)
-        fprintf (st, "%s", _sim_uname (uptr));
-    else
-        toks = 0;
-if (uptr->flags & UNIT_FIX) {
-    fprint_sep (st, &toks, MTAB_VUN);
-    fprint_capac (st, dptr, uptr);
-    }
-if (uptr->flags & UNIT_ATT) {
-    fprint_sep (st, &toks, MTAB_VUN);
-    fprintf (st, "attached to %s", sim_attach_name (uptr));
-    if (uptr->flags & UNIT_RO)
-        fprintf (st, ", read only");
+if (f == NULL)
+    return sim_messagef (SCPE_OPENERR, "Can't create %s: %s\n", filename, strerror (errno));
+if (sim_prof_stack_used) {
+    for (i = 0; i < sim_prof_stack_size; i++) {
+        PROF_STACK *s = &sim_prof_stacks[i];
+
+        if (s->count == 0)
+            continue;
+        for (d = s->depth; d-- > 0; ) {
+            _sim_prof_sprint_loc (loc, sizeof (loc), s->frames[d]);
+            fprintf (f, "%s%s", loc, d ? ";" : "");
+            }
+        fprintf (f, " %" LL_FMT "u\n", s->count);
+        ++lines;
+        }
     }
-else {
-    if (uptr->flags & UNIT_ATTABLE) {
-        fprint_sep (st, &toks, MTAB_VUN);
-        fprintf (st, "not attached");
+else {                                                  /* no call chains, leaf frames only */
+    for (i = 0; i < sim_prof_size; i++) {
+        if (sim_prof_tab[i].count == 0)
+            continue;
+        _sim_prof_sprint_loc (loc, sizeof (loc), sim_prof_tab[i].addr);
+        fprintf (f, "%s %" LL_FMT "u\n", loc, sim_prof_tab[i].count);
+        ++lines;
         }
     }
-show_all_mods (st, dptr, uptr, MTAB_VUN, &toks);        /* show unit mods */
-if (toks || (flag < 0) || (flag > 1))
-    fprintf (st, "\n");
-return SCPE_OK;
+fclose (f);
+return sim_messagef (SCPE_OK, "%u stack%s written to %s\n", lines, (lines == 1) ? "" : "s", filename);
 }
 
-const char *sprint_capac (DEVICE *dptr, UNIT *uptr)
+/* PROFILE START {interval}
+   PROFILE STOP
+   PROFILE RESET
+   PROFILE SYMBOLS file
+   PROFILE SHOW {RANGE=size|SYMBOLS} {count}
+   PROFILE FOLDED file */
+
+t_stat profile_cmd (int32 flag, CONST char *cptr)
 {
-static char capac_buf[MAX_WIDTH + 12];
-t_offset kval = (uptr->flags & UNIT_BINK)? 1024: 1000;
-t_offset mval;
-double remfrac;
-t_offset psize = (t_offset)uptr->capac;
-const char *scale, *width;
+char gbuf[CBUFSIZE];
+t_stat r;
 
-if (sim_switches & SWMASK ('B'))
-    kval = 1024;
-mval = kval * kval;
-if (dptr->flags & DEV_SECTORS)
-    psize = psize * 512;
-if ((dptr->dwidth / dptr->aincr) > 8)
-    width = "W";
-else
-    width = "B";
-if ((psize < (kval * 10)) &&
-    (0 != (psize % kval))) {
-    remfrac = 0.0;
-    scale = "";
+GET_SWITCHES (cptr);                                    /* get switches */
+cptr = get_glyph (cptr, gbuf, 0);
+if (gbuf[0] == '\0')
+    strcpy (gbuf, "SHOW");
+if (MATCH_CMD (gbuf, "START") == 0) {
+    if (*cptr) {
+        int32 interval;
+
+        cptr = get_glyph (cptr, gbuf, 0);
+        interval = (int32)get_uint (gbuf, 10, INT_MAX, &r);
+        if ((r != SCPE_OK) || (interval == 0) || *cptr)
+            return sim_messagef (SCPE_ARG, "Invalid sample interval: %s\n", gbuf);
+        sim_prof_interval = interval;
+        }
+    if ((sim_PC == NULL) && (sim_vm_pc_value == NULL))
+        return sim_messagef (SCPE_NOFNC, "This simulator has no PC to sample\n");
+    sim_prof_active = TRUE;
+    sim_cancel (&sim_prof_unit);
+    return sim_activate (&sim_prof_unit, sim_prof_interval);
+    }
+if (MATCH_CMD (gbuf, "STOP") == 0) {
+    if (*cptr)
+        return SCPE_2MARG;
+    sim_prof_active = FALSE;
+    sim_cancel (&sim_prof_unit);
+    return SCPE_OK;
     }
-else if ((psize < (mval * 10)) &&
-         (0 != (psize % mval))){
-    scale = "K";
-    remfrac = ((double)(psize % kval))/kval;
-    psize = psize / kval;
+if (MATCH_CMD (gbuf, "RESET") == 0) {
+    if (*cptr)
+        return SCPE_2MARG;
+    _sim_prof_reset ();
+    return SCPE_OK;
     }
-else {
-    scale = "M";
-    remfrac = ((double)(psize % mval))/mval;
-    psize = psize / mval;
+if (MATCH_CMD (gbuf, "SYMBOLS") == 0) {
+    if (*cptr == '\0')
+        return sim_messagef (SCPE_2FARG, "Missing symbol file name\n");
+    cptr = get_glyph_quoted (cptr, gbuf, 0);
+    if (*cptr)
+        return SCPE_2MARG;
+    return _sim_prof_load_syms (gbuf);
     }
-sprint_val (capac_buf, (t_value) psize, 10, T_ADDR_W, PV_LEFT);
-if ((remfrac != 0.0) && (sim_switches & SWMASK ('R'))) {
-    char *plast_char = &capac_buf[strlen (capac_buf) - 1];
-    char save_char = *plast_char;
+if (MATCH_CMD (gbuf, "FOLDED") == 0) {
+    if (*cptr == '\0')
+        return sim_messagef (SCPE_2FARG, "Missing output file name\n");
+    cptr = get_glyph_quoted (cptr, gbuf, 0);
+    if (*cptr)
+        return SCPE_2MARG;
+    return _sim_prof_write_folded (gbuf);
+    }
+if (MATCH_CMD (gbuf, "SHOW") == 0) {
+    int mode = PROF_BY_ADDR;
+    t_addr range = 0;
+    uint32 limit = PROF_DFLT_SHOW;
 
-    sprintf (plast_char, "%0.3f", remfrac);
-    *plast_char = save_char;
+    while (*cptr) {
+        char *vptr;
+
+        cptr = get_glyph (cptr, gbuf, 0);
+        vptr = strchr (gbuf, '=');
+        if (vptr)
+            *vptr++ = '\0';
+        if ((MATCH_CMD (gbuf, "RANGE") == 0) && vptr) {
+            range = (t_addr)get_uint (vptr, sim_PC ? sim_PC->radix : 16, (t_value)-1, &r);
+            if ((r != SCPE_OK) || (range == 0))
+                return sim_messagef (SCPE_ARG, "Invalid address range size: %s\n", vptr);
+            mode = PROF_BY_RANGE;
+            }
+        else if ((MATCH_CMD (gbuf, "SYMBOLS") == 0) && !vptr) {
+            if (sim_prof_sym_count == 0)
+                return sim_messagef (SCPE_ARG, "No symbols loaded\n");
+            mode = PROF_BY_SYMBOL;
+            }
+        else if (!vptr && sim_isdigit (gbuf[0])) {
+            limit = (uint32)get_uint (gbuf, 10, 0xFFFFFFFF, &r);
+            if ((r != SCPE_OK) || (limit == 0))
+                return sim_messagef (SCPE_ARG, "Invalid count: %s\n", gbuf);
+            }
+        else
+            return sim_messagef (SCPE_ARG, "Unknown PROFILE SHOW option: %s\n", gbuf);
+        }
+    _sim_prof_show (stdout, mode, range, limit);
+    if (sim_log && (sim_log != stdout))
+        _sim_prof_show (sim_log, mode, range, limit);
+    return SCPE_OK;
     }
-sprintf (&capac_buf[strlen (capac_buf)], "%s%s", scale, width);
-return capac_buf;
+return sim_messagef (SCPE_ARG, "Unknown PROFILE command: %s\n", gbuf);
 }
 
-void fprint_capac (FILE *st, DEVICE *dptr, UNIT *uptr)
-{
-fprintf (st, "%s", sprint_capac (dptr, uptr));
-}
+/* Per-opcode execution statistics
+
+   A CPU which supports SET CPU OPSTATS describes its instruction set
+   with a SIM_OPSTATS structure: the number of opcode indexes, a
+   routine which names an opcode index and a routine which gives the
+   class of an opcode index.  The instruction loop invokes
+   SIM_OPSTATS_COUNT with each instruction's opcode index before the
+   instruction executes.  While statistics are disabled that costs a
+   single test, and nothing when built with SIM_NO_OPSTATS defined.
+
+   In TIMING mode the host time between successive instructions is
+   charged to the earlier instruction's opcode, so it includes any
+   event processing done between the instructions.  Intervals longer
+   than SIM_OPSTATS_MAX_NS (simulator stops, idle sleeps, host
+   preemption) are discarded rather than charged.
+
+   Opcode indexes which share a name (for example when an index
+   includes operand bits) are combined in the report.  Indexes at or
+   beyond nops mean the CPU's table is too small; they are tallied and
+   make SHOW OPSTATS report an error rather than silently vanish.
+ */
+
+void sim_opstats_count (SIM_OPSTATS *os, uint32 op)
+{
+if (op >= os->nops) {                                   /* table too small for the CPU's index */
+    ++os->out_of_range;
+    return;
+    }
+++os->count[op];
+if (os->timing) {
+    double now = sim_os_hrtime ();
+
+    if (os->last_op < os->nops) {
+        double elapsed = now - os->last_ns;
+
+        if (elapsed <= SIM_OPSTATS_MAX_NS)
+            os->ns[os->last_op] += (t_uint64)elapsed;
+        else
+            ++os->discarded;
+        }
+    os->last_ns = now;
+    os->last_op = op;
+    }
+}
+
+static void _sim_opstats_reset (SIM_OPSTATS *os)
+{
+if (os->count)
+    memset (os->count, 0, os->nops * sizeof (*os->count));
+if (os->ns)
+    memset (os->ns, 0, os->nops * sizeof (*os->ns));
+os->discarded = os->out_of_range = 0;
+os->last_op = os->nops;
+}
+
+/* SET CPU OPSTATS{=COUNT|TIMING|RESET} and SET CPU NOOPSTATS */
+
+t_stat sim_set_opstats (UNIT *uptr, int32 val, CONST char *cptr, void *desc)
+{
+SIM_OPSTATS *os = (SIM_OPSTATS *)desc;
+char gbuf[CBUFSIZE];
+
+if (os == NULL)
+    return SCPE_IERR;
+if (val == 0) {                                         /* NOOPSTATS */
+    if (cptr && *cptr)
+        return SCPE_2MARG;
+    os->enabled = os->timing = FALSE;
+    return SCPE_OK;
+    }
+gbuf[0] = '\0';
+if (cptr && *cptr) {
+    cptr = get_glyph (cptr, gbuf, 0);
+    if (*cptr)
+        return SCPE_2MARG;
+    }
+if (MATCH_CMD (gbuf, "RESET") == 0) {
+    _sim_opstats_reset (os);
+    return SCPE_OK;
+    }
+if ((gbuf[0] != '\0') &&
+    (MATCH_CMD (gbuf, "COUNT") != 0) &&
+    (MATCH_CMD (gbuf, "TIMING") != 0))
+    return sim_messagef (SCPE_ARG, "Unknown OPSTATS mode: %s\n", gbuf);
+if (os->count == NULL) {
+    os->count = (t_uint64 *)calloc (os->nops, sizeof (*os->count));
+    os->ns = (t_uint64 *)calloc (os->nops, sizeof (*os->ns));
+    if ((os->count == NULL) || (os->ns == NULL)) {
+        free (os->count);
+        free (os->ns);
+        os->count = os->ns = NULL;
+        return SCPE_MEM;
+        }
+    _sim_opstats_reset (os);
+    }
+os->last_op = os->nops;                                 /* no interval to charge yet */
+os->timing = (MATCH_CMD (gbuf, "TIMING") == 0);
+os->enabled = TRUE;
+return SCPE_OK;
+}
+
+typedef struct {
+    const char          *name;
+    uint32              op;                             /* first opcode index with this name */
+    t_uint64            count;
+    t_uint64            ns;
+    } OPSTATS_LINE;
+
+static int _sim_opstats_cmp (const void *pa, const void *pb)
+{
+const OPSTATS_LINE *a = (const OPSTATS_LINE *)pa;
+const OPSTATS_LINE *b = (const OPSTATS_LINE *)pb;
+
+if (a->count != b->count)
+    return (a->count > b->count) ? -1 : 1;
+return (a->op < b->op) ? -1 : ((a->op > b->op) ? 1 : 0);
+}
+
+static void _sim_opstats_show_line (FILE *st, const char *name, t_uint64 count, t_uint64 ns, t_uint64 total, t_bool timed)
+{
+fprintf (st, "  %-16s %15" LL_FMT "u %7.3f%%", name, count, total ? (100.0 * count) / total : 0.0);
+if (timed && count)
+    fprintf (st, " %12.3f ms %8.1f ns", ns / 1000000.0, (double)ns / count);
+fprintf (st, "\n");
+}
+
+/* SHOW CPU OPSTATS */
+
+t_stat sim_show_opstats (FILE *st, UNIT *uptr, int32 val, CONST void *desc)
+{
+const SIM_OPSTATS *os = (const SIM_OPSTATS *)desc;
+OPSTATS_LINE *lines;
+t_uint64 total = 0, total_ns = 0, *class_count, *class_ns;
+uint32 op, i, n = 0, c;
+t_bool timed;
+char numeric[32];
+
+if (os == NULL)
+    return SCPE_IERR;
+fprintf (st, "Opcode statistics %s\n", os->enabled ? (os->timing ? "counting and timing" : "counting") : "disabled");
+if (os->count == NULL)
+    return SCPE_OK;
+lines = (OPSTATS_LINE *)calloc (os->nops, sizeof (*lines));
+class_count = (t_uint64 *)calloc (os->nclasses + 1, sizeof (*class_count));
+class_ns = (t_uint64 *)calloc (os->nclasses + 1, sizeof (*class_ns));
+if ((lines == NULL) || (class_count == NULL) || (class_ns == NULL)) {
+    free (lines);
+    free (class_count);
+    free (class_ns);
+    return SCPE_MEM;
+    }
+for (op = 0; op < os->nops; op++) {
+    const char *name;
+
+    if (os->count[op] == 0)
+        continue;
+    total += os->count[op];
+    total_ns += os->ns[op];
+    c = os->op_class ? os->op_class (op) : 0;
+    if (c > os->nclasses)
+        c = os->nclasses;
+    class_count[c] += os->count[op];
+    class_ns[c] += os->ns[op];
+    name = os->op_name ? os->op_name (op) : NULL;
+    for (i = 0; i < n; i++)                             /* combine indexes sharing a name */
+        if (name && lines[i].name && (strcmp (name, lines[i].name) == 0))
+            break;
+    if (i == n) {
+        lines[n].name = name;
+        lines[n++].op = op;
+        }
+    lines[i].count += os->count[op];
+    lines[i].ns += os->ns[op];
+    }
+timed = (total_ns != 0);
+fprintf (st, "%" LL_FMT "u instructions", total);
+if (timed)
+    fprintf (st, ", %.3f ms host time, %" LL_FMT "u long intervals discarded", total_ns / 1000000.0, os->discarded);
+fprintf (st, "\n\n");
+if (os->out_of_range)
+    fprintf (st, "%" LL_FMT "u instructions with opcode indexes beyond %u were not counted\n\n", os->out_of_range, os->nops);
+if (total) {
+    fprintf (st, "  %-16s %15s %8s%s\n", "Class", "Count", "Percent", timed ? "    Host Time  Per Instr" : "");
+    for (c = 0; c <= os->nclasses; c++) {
+        if (class_count[c] == 0)
+            continue;
+        _sim_opstats_show_line (st, (c < os->nclasses) ? os->class_names[c] : "Other",
+                                class_count[c], class_ns[c], total, timed);
+        }
+    qsort (lines, n, sizeof (*lines), _sim_opstats_cmp);
+    fprintf (st, "\n  %-16s %15s %8s%s\n", "Opcode", "Count", "Percent", timed ? "    Host Time  Per Instr" : "");
+    for (i = 0; i < n; i++) {
+        const char *name = lines[i].name;
+
+        if (name == NULL) {
+            sprintf (numeric, "%X", lines[i].op);
+            name = numeric;
+            }
+        _sim_opstats_show_line (st, name, lines[i].count, lines[i].ns, total, timed);
+        }
+    }
+free (lines);
+free (class_count);
+free (class_ns);
+return os->out_of_range ? SCPE_IERR : SCPE_OK;          /* CPU's opcode index exceeds its table */
+}
+
+/* Set environment routine */
+
+t_stat sim_set_environment (int32 flag, CONST char *cptr)
+{
+char varname[CBUFSIZE], prompt[CBUFSIZE], cbuf[CBUFSIZE];
+int i;
+
+if ((!cptr) || (*cptr == 0))                            /* now eol? */
+    return SCPE_2FARG;
+if (sim_switches & SWMASK ('P')) {
+    CONST char *deflt = NULL;
+
+    cptr = get_glyph_quoted (cptr, prompt, 0);          /* get prompt */
+    if (prompt[0] == '\0')
+        return sim_messagef (SCPE_2FARG, "Missing Prompt and Environment Variable Name\n");
+    if ((prompt[0] == '"') || (prompt[0] == '\'')) {
+        if (strlen (prompt) < 3)
+            return sim_messagef (SCPE_ARG, "Invalid Prompt\n");
+        prompt[strlen (prompt) - 1] = '\0';
+        memmove (prompt, prompt + 1, strlen (prompt));
+        }
+    deflt = get_glyph (cptr, varname, '=');             /* get environment variable name */
+    if (varname[0] == '\0')
+        return sim_messagef (SCPE_2FARG, "Missing Environment Variable Name\n");
+    if (deflt == NULL)
+        deflt = "";
+    if (*deflt) {
+        strlcat (prompt, " [", sizeof (prompt));
+        strlcat (prompt, deflt, sizeof (prompt));
+        strlcat (prompt, "] ", sizeof (prompt));
+        }
+    else
+        strlcat (prompt, " ", sizeof (prompt));
+    if (sim_rem_cmd_active_line == -1) {
+        cptr = read_line_p (prompt, cbuf, sizeof(cbuf), stdin);
+        if (cptr == NULL)
+            printf ("\n");
+        if ((cptr == NULL) || (*cptr == 0))
+            cptr = deflt;
+        else
+            cptr = cbuf;
+        }
+    else
+        cptr = deflt;
+    }
+else {
+    cptr = get_glyph (cptr, varname, '=');              /* get environment variable name */
+    strlcpy (cbuf, cptr, sizeof(cbuf));
+    sim_trim_endspc (cbuf);
+    if (sim_switches & SWMASK ('S')) {                  /* Quote String argument? */
+        uint32 str_size;
+
+        cptr = cbuf;
+        get_glyph_quoted (cptr, cbuf, 0);
+        if (SCPE_OK != sim_decode_quoted_string (cbuf, (uint8 *)cbuf, &str_size))
+            return sim_messagef (SCPE_ARG, "Invalid quoted string: %s\n", cbuf);
+        cbuf[str_size] = '\0';
+        }
+    else {
+        if (sim_switches & SWMASK ('A')) {              /* Arithmetic Expression Evaluation argument? */
+            t_svalue val;
+            t_stat stat;
+            const char *eptr = cptr;
+
+            if ((cptr > sim_sub_instr_buf) && ((size_t)(cptr - sim_sub_instr_buf) < sim_sub_instr_size))
+                eptr = &sim_sub_instr[sim_sub_instr_off[cptr - sim_sub_instr_buf]]; /* get un-substituted string */
+            cptr = sim_eval_expression (eptr, &val, FALSE, &stat);
+            if (stat == SCPE_OK) {
+                sprintf (cbuf, "%ld", (long)val);
+                cptr = cbuf;
+                }
+            else
+                return stat;
+            }
+        }
+    }
+setenv(varname, cptr, 1);
+/* remove the newly set name from the collection of alias conflicting external names */
+for (i = 0; i < sim_external_env_count; i++) {
+    if (0 == strcmp (varname, sim_external_env[i].name)) {
+        int j;
+
+        free (sim_external_env[i].name);
+        free (sim_external_env[i].value);
+        for (j = 0; (i + j) < sim_external_env_count; j++)
+            sim_external_env[i + j] = sim_external_env[i + j + 1];
+        --sim_external_env_count;
+        }
+    }
+return SCPE_OK;
+}
+
+/* Set command */
+
+t_stat set_cmd (int32 flag, CONST char *cptr)
+{
+uint32 lvl = 0;
+t_stat r;
+char gbuf[CBUFSIZE], *cvptr;
+CONST char *svptr;
+DEVICE *dptr;
+UNIT *uptr;
+MTAB *mptr;
+CTAB *gcmdp;
+C1TAB *ctbr = NULL, *glbr;
+
+GET_SWITCHES (cptr);                                    /* get switches */
+if (*cptr == 0)                                         /* must be more */
+    return SCPE_2FARG;
+cptr = get_glyph (svptr = cptr, gbuf, 0);               /* get glob/dev/unit */
+
+if ((dptr = find_dev (gbuf))) {                         /* device match? */
+    uptr = dptr->units;                                 /* first unit */
+    ctbr = set_dev_tab;                                 /* global table */
+    lvl = MTAB_VDV;                                     /* device match */
+    GET_SWITCHES (cptr);                                /* get more switches */
+    if (dptr->numunits == 1)                            /* Single unit devices have optional */
+        lvl |= MTAB_VUN;                                /*  unit number */
+    }
+else {
+    if ((dptr = find_unit (gbuf, &uptr))) {             /* unit match? */
+        if (uptr == NULL)                               /* invalid unit */
+            return SCPE_NXUN;
+        ctbr = set_unit_tab;                            /* global table */
+        lvl = MTAB_VUN;                                 /* unit match */
+        GET_SWITCHES (cptr);                            /* get more switches */
+        }
+    else {
+        if ((gcmdp = find_ctab (set_glob_tab, gbuf))) { /* global? */
+            GET_SWITCHES (cptr);                        /* get more switches */
+            return gcmdp->action (gcmdp->arg, cptr);    /* do the rest */
+            }
+        else {
+            if (sim_dflt_dev->modifiers) {
+                if ((cvptr = strchr (gbuf, '=')))       /* = value? */
+                    *cvptr++ = 0;
+                for (mptr = sim_dflt_dev->modifiers; mptr->mask != 0; mptr++) {
+                    if (mptr->mstring && (MATCH_CMD (gbuf, mptr->mstring) == 0)) {
+                        dptr = sim_dflt_dev;
+                        cptr = svptr;
+                        while (sim_isspace(*cptr))
+                            ++cptr;
+                        break;
+                        }
+                    }
+                }
+            if (!dptr)
+                return sim_messagef (SCPE_NXDEV, "Non-existent device: %s\n", gbuf);/* no match */
+            lvl = MTAB_VDV;                             /* device match */
+            uptr = dptr->units;                         /* first unit */
+            }
+        }
+    }
+if ((*cptr == 0) ||                                     /* must be more */
+    (*cptr == ';') ||
+    (*cptr == '#'))
+    return SCPE_2FARG;
+GET_SWITCHES (cptr);                                    /* get more switches */
+
+while (*cptr != 0) {                                    /* do all mods */
+    cptr = get_glyph (svptr = cptr, gbuf, ',');         /* get modifier */
+    if (0 == strcmp (gbuf, ";"))
+        break;
+    if ((cvptr = strchr (gbuf, '=')))                   /* = value? */
+        *cvptr++ = 0;
+    for (mptr = dptr->modifiers; mptr && (mptr->mask != 0); mptr++) {
+        if ((mptr->mstring) &&                          /* match string */
+            (MATCH_CMD (gbuf, mptr->mstring) == 0)) {   /* matches option? */
+            if (mptr->mask & MTAB_XTD) {                /* extended? */
+                if (((lvl & mptr->mask) & ~MTAB_XTD) == 0)
+                    return SCPE_ARG;
+                if ((lvl == MTAB_VUN) && (uptr->flags & UNIT_DIS))
+                    return sim_messagef (SCPE_UDIS, "Unit disabled: %s\n", sim_uname (uptr));
+                if (mptr->valid) {                      /* validation rtn? */
+                    if (cvptr && MODMASK(mptr,MTAB_QUOTE)) {
+                        svptr = get_glyph_quoted (svptr, gbuf, ',');
+                        if ((cvptr = strchr (gbuf, '='))) {
+                            *cvptr++ = 0;
+                            cptr = svptr;
+                            }
+                        }
+                    else {
+                        if (cvptr && MODMASK(mptr,MTAB_NC)) {
+                            get_glyph_nc (svptr, gbuf, ',');
+                            if ((cvptr = strchr (gbuf, '=')))
+                                *cvptr++ = 0;
+                            }
+                        }
+                    r = mptr->valid (uptr, mptr->match, cvptr, mptr->desc);
+                    if (r != SCPE_OK)
+                        return r;
+                    }
+                else
+                    if (!mptr->desc)                    /* value desc? */
+                        break;
+                    else
+                        if (cvptr)                      /* = value? */
+                            return SCPE_ARG;
+                        else
+                            *((int32 *) mptr->desc) = mptr->match;
+                }                                       /* end if xtd */
+            else {                                      /* old style */
+                if (cvptr)                              /* = value? */
+                    return SCPE_ARG;
+                if (uptr->flags & UNIT_DIS)             /* disabled? */
+                    return sim_messagef (SCPE_UDIS, "Unit disabled: %s\n", sim_uname (uptr));
+                if ((mptr->valid) &&                    /* invalid? */
+                    ((r = mptr->valid (uptr, mptr->match, cvptr, mptr->desc)) != SCPE_OK))
+                    return r;
+                uptr->flags = (uptr->flags & ~(mptr->mask)) |
+                    (mptr->match & mptr->mask);         /* set new value */
+                }                                       /* end else xtd */
+            break;                                      /* terminate for */
+            }                                           /* end if match */
+        }                                               /* end for */
+    if (!mptr || (mptr->mask == 0)) {                   /* no match? */
+        if ((glbr = find_c1tab (ctbr, gbuf))) {         /* global match? */
+            r = glbr->action (dptr, uptr, glbr->arg, cvptr);    /* do global */
+            if (r != SCPE_OK)
+                return r;
+            }
+        else
+            if (!dptr->modifiers)                      /* no modifiers? */
+                return sim_messagef (SCPE_NOPARAM, "%s device has no parameters\n", dptr->name);
+            else
+                return sim_messagef (SCPE_NXPAR, "%s device: Non-existent parameter - %s\n", dptr->name, gbuf);
+        }                                               /* end if no mat */
+    }                                                   /* end while */
+return SCPE_OK;                                         /* done all */
+}
+
+/* Match CTAB/CTAB1 name */
+
+CTAB *find_ctab (CTAB *tab, const char *gbuf)
+{
+if (!tab)
+    return NULL;
+for (; tab->name != NULL; tab++) {
+    if (MATCH_CMD (gbuf, tab->name) == 0)
+        return tab;
+    }
+return NULL;
+}
+
+C1TAB *find_c1tab (C1TAB *tab, const char *gbuf)
+{
+if (!tab)
+    return NULL;
+for (; tab->name != NULL; tab++) {
+    if (MATCH_CMD (gbuf, tab->name) == 0)
+        return tab;
+    }
+return NULL;
+}
+
+/* Set device data radix routine */
+
+t_stat set_dev_radix (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+{
+if (cptr)
+    return SCPE_ARG;
+dptr->dradix = flag & 037;
+return SCPE_OK;
+}
+
+/* Set device enabled/disabled routine */
+
+t_stat set_dev_enbdis (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+{
+UNIT *up;
+uint32 i;
+
+if (cptr)
+    return SCPE_ARG;
+if ((dptr->flags & DEV_DISABLE) == 0)                   /* allowed? */
+    return SCPE_NOFNC;
+if (flag) {                                             /* enable? */
+    if ((dptr->flags & DEV_DIS) == 0)                   /* already enb? ok */
+        return SCPE_OK;
+    dptr->flags = dptr->flags & ~DEV_DIS;               /* no, enable */
+    }
+else {
+    if (dptr->flags & DEV_DIS)                          /* already dsb? ok */
+        return SCPE_OK;
+    for (i = 0; i < dptr->numunits; i++) {              /* check units */
+        up = (dptr->units) + i;                         /* att or active? */
+        if ((up->flags & UNIT_ATT) || sim_is_active (up))
+            return sim_messagef (SCPE_NOFNC, "%s has attached or busy units\n", sim_dname (dptr));                          /* can't do it */
+        }
+    dptr->flags = dptr->flags | DEV_DIS;                /* disable */
+    }
+if (dptr->reset)                                        /* reset device */
+    return dptr->reset (dptr);
+else return SCPE_OK;
+}
+
+/* Set unit enabled/disabled routine */
+
+t_stat set_unit_enbdis (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+{
+if (cptr)
+    return SCPE_ARG;
+if (!(uptr->flags & UNIT_DISABLE))                      /* allowed? */
+    return SCPE_NOFNC;
+if (flag)                                               /* enb? enable */
+    uptr->flags = uptr->flags & ~UNIT_DIS;
+else {
+    if ((uptr->flags & UNIT_ATT) ||                     /* dsb */
+        sim_is_active (uptr))                           /* more tests */
+        return sim_messagef (SCPE_NOFNC, "%s is attached or busy\n", sim_uname (uptr));
+    uptr->flags = uptr->flags | UNIT_DIS;               /* disable */
+    }
+return SCPE_OK;
+}
+
+/* Set device/unit debug enabled/disabled routine */
+
+t_stat set_dev_debug (DEVICE *dptr, UNIT *uptr, int32 flags, CONST char *cptr)
+{
+int32 flag = flags & 1;
+t_bool uflag = ((flags & 2) != 0);
+char gbuf[CBUFSIZE];
+DEBTAB *dep;
+t_stat r = SCPE_OK;
+
+if ((dptr->flags & DEV_DEBUG) == 0)
+    return SCPE_NOFNC;
+if (cptr == NULL) {                                     /* no arguments? */
+    if (uflag)
+        uptr->dctrl = flag ? (dptr->debflags ? flag : 0xFFFFFFFF) : 0;/* disable/enable w/o table */
+    else
+        dptr->dctrl = flag ? (dptr->debflags ? flag : 0xFFFFFFFF) : 0;/* disable/enable w/o table */
+    if (flag && dptr->debflags) {                       /* enable with table? */
+        for (dep = dptr->debflags; dep->name != NULL; dep++)
+            if (uflag)
+                uptr->dctrl = uptr->dctrl | dep->mask;      /* set all */
+            else
+                dptr->dctrl = dptr->dctrl | dep->mask;      /* set all */
+        }
+    return SCPE_OK;
+    }
+if (dptr->debflags == NULL)                             /* must have table */
+    return sim_messagef (SCPE_ARG, "The %s device doesn't have DEBUG options.\n", dptr->name);
+while (*cptr) {
+    cptr = get_glyph (cptr, gbuf, ';');                 /* get debug flag */
+    for (dep = dptr->debflags; dep->name != NULL; dep++) {
+        if (strcmp (dep->name, gbuf) == 0) {            /* match? */
+            if (flag)
+                if (uflag)
+                    uptr->dctrl = uptr->dctrl | dep->mask;
+                else
+                    dptr->dctrl = dptr->dctrl | dep->mask;
+            else
+                if (uflag)
+                    uptr->dctrl = uptr->dctrl & ~dep->mask;
+                else
+                    dptr->dctrl = dptr->dctrl & ~dep->mask;
+            break;
+            }
+        }                                               /* end for */
+    if (dep->mask == 0)                                 /* no match? */
+        r = sim_messagef (SCPE_ARG, "Invalid DEBUG option '%s' for %s device\n", gbuf, dptr->name);
+    }                                                   /* end while */
+return r;
+}
+
+/* Set sequential unit position to EOF */
+
+t_stat set_unit_append (DEVICE *dptr, UNIT *uptr, int32 flags, CONST char *cptr)
+{
+if (!(uptr->flags & UNIT_SEQ))
+    return sim_messagef (SCPE_NOFNC, "%s is not a sequential device.\n", sim_uname (uptr));
+if (uptr->flags & UNIT_BUF)
+    return sim_messagef (SCPE_NOFNC, "Can't append to a buffered device %s.\n", sim_uname (uptr));
+if (!(uptr->flags & UNIT_ATT))
+    return SCPE_UNATT;
+
+if (0 == sim_fseek (uptr->fileref, 0, SEEK_END)) {
+    uptr->pos = (t_addr)sim_ftell (uptr->fileref);      /* Position at end of file */
+    return SCPE_OK;
+    }
+
+return sim_messagef (SCPE_IERR, "%s Can't seek to end of file: %s - %s\n", sim_uname (uptr), sim_attach_name (uptr), strerror (errno));
+}
+
+/* Set device asynchronous completion coalescing interval */
+
+t_stat set_dev_coalesce (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+{
+#if defined (SIM_ASYNCH_IO)
+uint32 usecs = 0;
+t_stat r;
+
+if (flag) {
+    if ((cptr == NULL) || (*cptr == 0))
+        return sim_messagef (SCPE_MISVAL, "Expected COALESCE=usecs\n");
+    usecs = (uint32)get_uint (cptr, 10, 1000000, &r);
+    if ((r != SCPE_OK) || (usecs == 0))
+        return sim_messagef (SCPE_ARG, "Invalid coalescing interval: %s\n", cptr);
+    }
+else
+    if (cptr)
+        return SCPE_2MARG;
+return sim_aio_coalesce_set (dptr, usecs);
+#else
+return sim_messagef (SCPE_NOFNC, "Asynchronous I/O is not available in this simulator\n");
+#endif
+}
+
+/* Show command */
+
+t_stat show_cmd (int32 flag, CONST char *cptr)
+{
+t_stat r;
+
+cptr = get_sim_opt (CMD_OPT_SW|CMD_OPT_OF, cptr, &r);
+                                                        /* get sw, ofile */
+if (!cptr)                                              /* error? */
+    return r;
+if (sim_ofile) {                                        /* output file? */
+    r = show_cmd_fi (sim_ofile, flag, cptr);            /* do show */
+    fclose (sim_ofile);
+    }
+else {
+    r = show_cmd_fi (stdout, flag, cptr);               /* no, stdout, log */
+    if ((!sim_oline) && (sim_log && (sim_log != stdout)))
+        show_cmd_fi (sim_log, flag, cptr);
+    if ((!sim_oline) && (sim_deb && (sim_deb != stdout) && (sim_deb != sim_log)))
+        show_cmd_fi (sim_deb, flag, cptr);
+    }
+return r;
+}
+
+t_stat show_cmd_fi (FILE *ofile, int32 flag, CONST char *cptr)
+{
+uint32 lvl = 0xFFFFFFFF;
+char gbuf[CBUFSIZE], *cvptr;
+CONST char *svptr;
+DEVICE *dptr;
+UNIT *uptr;
+MTAB *mptr;
+SHTAB *shtb = NULL, *shptr;
+
+GET_SWITCHES (cptr);                                    /* get switches */
+if ((*cptr == 0) || (*cptr == ';') || (*cptr == '#'))   /* must be more */
+    return SCPE_2FARG;
+cptr = get_glyph (svptr = cptr, gbuf, 0);               /* get next glyph */
+
+if ((dptr = find_dev (gbuf))) {                         /* device match? */
+    uptr = dptr->units;                                 /* first unit */
+    shtb = show_dev_tab;                                /* global table */
+    lvl = MTAB_VDV;                                     /* device match */
+    GET_SWITCHES (cptr);                                /* get more switches */
+    }
+else {
+    if ((dptr = find_unit (gbuf, &uptr))) {             /* unit match? */
+        if (uptr == NULL)                               /* invalid unit */
+            return sim_messagef (SCPE_NXUN, "Non-existent unit: %s\n", gbuf);
+        if (uptr->flags & UNIT_DIS)                     /* disabled? */
+            return sim_messagef (SCPE_UDIS, "Unit disabled: %s\n", gbuf);
+        shtb = show_unit_tab;                           /* global table */
+        lvl = MTAB_VUN;                                 /* unit match */
+        GET_SWITCHES (cptr);                            /* get more switches */
+        }
+    else {
+        if ((shptr = find_shtab (show_glob_tab, gbuf))) {/* global? */
+            GET_SWITCHES (cptr);                        /* get more switches */
+            return shptr->action (ofile, NULL, NULL, shptr->arg, cptr);
+            }
+        else {
+            if (sim_dflt_dev->modifiers) {
+                if ((cvptr = strchr (gbuf, '=')))       /* = value? */
+                    *cvptr++ = 0;
+                for (mptr = sim_dflt_dev->modifiers; mptr && (mptr->mask != 0); mptr++) {
+                    if ((((mptr->mask & MTAB_VDV) == MTAB_VDV) &&
+                         (mptr->pstring && (MATCH_CMD (gbuf, mptr->pstring) == 0))) ||
+                        (!(mptr->mask & MTAB_VDV) && (mptr->mstring && (MATCH_CMD (gbuf, mptr->mstring) == 0)))) {
+                        dptr = sim_dflt_dev;
+                        lvl = MTAB_VDV;                 /* device match */
+                        cptr = svptr;
+                        while (sim_isspace(*cptr))
+                            ++cptr;
+                        break;
+                        }
+                    }
+                }
+            if (!dptr) {
+                if ((shptr = find_shtab (show_dev_tab, gbuf)))  /* global match? */
+                    return shptr->action (ofile, sim_dflt_dev, uptr, shptr->arg, cptr);
+                else
+                    return sim_messagef (SCPE_NXDEV, "Non-existent device: %s\n", gbuf);/* no match */
+                }
+            }
+        }
+    }
+
+if ((*cptr == 0) || (*cptr == ';') || (*cptr == '#')) { /* now eol? */
+    return (lvl == MTAB_VDV)?
+        show_device (ofile, dptr, 0):
+        show_unit (ofile, dptr, uptr, -1);
+    }
+GET_SWITCHES (cptr);                                    /* get more switches */
+
+while (*cptr != 0) {                                    /* do all mods */
+    cptr = get_glyph (cptr, gbuf, ',');                 /* get modifier */
+    if ((cvptr = strchr (gbuf, '=')))                   /* = value? */
+        *cvptr++ = 0;
+    for (mptr = dptr->modifiers; mptr && (mptr->mask != 0); mptr++) {
+        if (((mptr->mask & MTAB_XTD)?                   /* right level? */
+            ((mptr->mask & lvl) == lvl): (MTAB_VUN & lvl)) &&
+            ((mptr->disp && mptr->pstring &&            /* named disp? */
+            (MATCH_CMD (gbuf, mptr->pstring) == 0))
+            )) {
+            t_stat r;
+
+            if (cvptr && !MODMASK(mptr,MTAB_SHP))
+                return sim_messagef (SCPE_ARG, "Invalid Argument: %s=%s\n", gbuf, cvptr);
+            r = show_one_mod (ofile, dptr, uptr, mptr, cvptr, 1);
+            if (r != SCPE_OK)
+                return r;
+            break;
+            }                                           /* end if */
+        }                                               /* end for */
+    if (!mptr || (mptr->mask == 0)) {                   /* no match? */
+        if (shtb && (shptr = find_shtab (shtb, gbuf))) {/* global match? */
+            t_stat r;
+
+            r = shptr->action (ofile, dptr, uptr, shptr->arg, cptr);
+            if (r != SCPE_OK)
+                return r;
+            }
+        else {
+            if (!dptr->modifiers)                       /* no modifiers? */
+                return sim_messagef (SCPE_NOPARAM, "%s device has no parameters\n", dptr->name);
+            else
+                return sim_messagef (SCPE_NXPAR, "%s device: Non-existent parameter: %s\n", dptr->name, gbuf);
+            }
+        }                                               /* end if */
+    }                                                   /* end while */
+return SCPE_OK;
+}
+
+SHTAB *find_shtab (SHTAB *tab, const char *gbuf)
+{
+if (!tab)
+    return NULL;
+for (; tab->name != NULL; tab++) {
+    if (MATCH_CMD (gbuf, tab->name) == 0)
+        return tab;
+    }
+return NULL;
+}
+
+/* Show device and unit */
+
+static size_t dev_name_len;
+static size_t unit_name_len;
+
+const char *_sim_name_prefix (const char *name, const char *prefix, size_t max_name_len)
+{
+static char nambuf[CBUFSIZE];
+size_t prefix_len = prefix ? strlen (prefix) : 0;
+size_t name_len = name ? strlen (name) : 0;
+size_t string_len = prefix_len + name_len;
+
+snprintf (nambuf, sizeof (nambuf), "%s%*s", prefix ? prefix : "",
+                                            ((string_len <= 6) && (max_name_len <= 6)) ? -((int)(8 - prefix_len)) :
+                                                                                        -((int)(max_name_len + 2)),
+                                                                                        name ? name : "");
+return nambuf;
+}
+
+const char *_sim_dname_prefix (DEVICE *dptr, const char *prefix)
+{
+return _sim_name_prefix (sim_dname (dptr), prefix, dev_name_len);
+}
+
+const char *_sim_uname_prefix (UNIT *uptr, const char *prefix)
+{
+return _sim_name_prefix (sim_uname (uptr), prefix, unit_name_len);
+}
+
+const char *_sim_dname (DEVICE *dptr)
+{
+return _sim_dname_prefix (dptr, "");
+}
+
+const char *_sim_uname (UNIT *uptr)
+{
+return _sim_uname_prefix (uptr, "");
+}
+
+const char *_sim_dname_space (void)
+{
+return _sim_dname_prefix (NULL, "");
+}
+
+const char *_sim_uname_space (void)
+{
+return _sim_uname_prefix (NULL, "");
+}
+
+void _set_dname_len (DEVICE *dptr)
+{
+uint32 i;
+
+if (dev_name_len < strlen (sim_dname (dptr)))
+    dev_name_len = strlen (sim_dname (dptr));
+for (i = 0; i < dptr->numunits; i++) {
+    UNIT *uptr = &dptr->units[i];
+
+    if (((uptr->flags & UNIT_DIS) == 0) &&
+        (unit_name_len < strlen (sim_uname (uptr))))
+        unit_name_len = strlen (sim_uname (uptr));
+    }
+}
+
+t_stat show_device (FILE *st, DEVICE *dptr, int32 flag)
+{
+uint32 j, udbl, ucnt;
+UNIT *uptr;
+int32 toks = -1;
+t_bool did_set_dname_len = FALSE;
+
+if (dev_name_len == 0) {
+    _set_dname_len (dptr);
+    did_set_dname_len = TRUE;
+    }
+fprintf (st, "%s", _sim_dname (dptr));                   /* print dev name */
+if ((flag == 2) && dptr->description) {
+    fprintf (st, "%s\n", dptr->description(dptr));
+    fprintf (st, "%s", _sim_dname_space ());
+    }
+else {
+    if ((sim_switches & SWMASK ('D')) && dptr->description) {
+        fprintf (st, "%s\n", dptr->description(dptr));
+        fprintf (st, "%s", _sim_dname_space ());
+        }
+    }
+if (qdisable (dptr)) {                                  /* disabled? */
+    fprintf (st, "%s\n", "disabled");
+    goto Cleanup_Return;
+    }
+for (j = ucnt = udbl = 0; j < dptr->numunits; j++) {    /* count units */
+    uptr = dptr->units + j;
+    if (!(uptr->flags & UNIT_DIS))                      /* count enabled units */
+        ucnt++;
+    else
+        if (uptr->flags & UNIT_DISABLE)
+            udbl++;                                     /* count user-disabled */
+    }
+show_all_mods (st, dptr, dptr->units, MTAB_VDV, &toks); /* show dev mods */
+if (dptr->numunits == 0) {
+    if (toks)
+        fprintf (st, "\n");
+    }
+else {
+    if (ucnt == 0) {
+        fprint_sep (st, &toks, MTAB_VDV);
+        fprintf (st, "all %d units disabled\n", udbl);
+        }
+    else {
+        if ((ucnt > 1) || (udbl > 0)) {
+            fprint_sep (st, &toks, MTAB_VDV);
+            fprintf (st, "%d units\n", ucnt + udbl);
+            }
+        else {
+            if ((flag != 2) || !dptr->description || toks) {
+                if ((ucnt == 1) && (toks < 0) && (flag != 2) &&
+                    (dptr->description) && ((sim_switches & SWMASK ('D')) == 0))
+                    fprintf (st, "%s", dptr->description (dptr));
+                fprintf (st, "\n");
+                }
+            }
+        }
+    toks = 0;
+    }
+if (flag)                                               /* dev only? */
+    goto Cleanup_Return;
+for (j = 0; j < dptr->numunits; j++) {                  /* loop thru units */
+    uptr = dptr->units + j;
+    if ((uptr->flags & UNIT_DIS) == 0)
+        show_unit (st, dptr, uptr, ucnt + udbl);
+    }
+Cleanup_Return:
+if (did_set_dname_len)
+    dev_name_len = unit_name_len = 0;
+return SCPE_OK;
+}
+
+void fprint_sep (FILE *st, int32 *tokens, int32 flag)
+{
+fprintf (st, "%s", (*tokens > 0) ? ", " : ((*tokens < 0) ? "" : ((flag == MTAB_VDV) ? _sim_dname_space () : _sim_uname_space ())));
+*tokens += 1;
+if (*tokens == 0)
+    *tokens = 1;
+}
+
+t_stat show_unit (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag)
+{
+int32 toks = -1;
+
+if (flag > 1)
+    fprintf (st, "%s", _sim_uname_prefix (uptr, "  "));
+else
+    if (flag < 0)
+        fprintf (st, "%s", _sim_uname (uptr));
+    else
+        toks = 0;
+if (uptr->flags & UNIT_FIX) {
+    fprint_sep (st, &toks, MTAB_VUN);
+    fprint_capac (st, dptr, uptr);
+    }
+if (uptr->flags & UNIT_ATT) {
+    fprint_sep (st, &toks, MTAB_VUN);
+    fprintf (st, "attached to %s", sim_attach_name (uptr));
+    if (uptr->flags & UNIT_RO)
+        fprintf (st, ", read only");
+    }
+else {
+    if (uptr->flags & UNIT_ATTABLE) {
+        fprint_sep (st, &toks, MTAB_VUN);
+        fprintf (st, "not attached");
+        }
+    }
+show_all_mods (st, dptr, uptr, MTAB_VUN, &toks);        /* show unit mods */
+if (toks || (flag < 0) || (flag > 1))
+    fprintf (st, "\n");
+return SCPE_OK;
+}
+
+const char *sprint_capac (DEVICE *dptr, UNIT *uptr)
+{
+static char capac_buf[MAX_WIDTH + 12];
+t_offset kval = (uptr->flags & UNIT_BINK)? 1024: 1000;
+t_offset mval;
+double remfrac;
+t_offset psize = (t_offset)uptr->capac;
+const char *scale, *width;
+
+if (sim_switches & SWMASK ('B'))
+    kval = 1024;
+mval = kval * kval;
+if (dptr->flags & DEV_SECTORS)
+    psize = psize * 512;
+if ((dptr->dwidth / dptr->aincr) > 8)
+    width = "W";
+else
+    width = "B";
+if ((psize < (kval * 10)) &&
+    (0 != (psize % kval))) {
+    remfrac = 0.0;
+    scale = "";
+    }
+else if ((psize < (mval * 10)) &&
+         (0 != (psize % mval))){
+    scale = "K";
+    remfrac = ((double)(psize % kval))/kval;
+    psize = psize / kval;
+    }
+else {
+    scale = "M";
+    remfrac = ((double)(psize % mval))/mval;
+    psize = psize / mval;
+    }
+sprint_val (capac_buf, (t_value) psize, 10, T_ADDR_W, PV_LEFT);
+if ((remfrac != 0.0) && (sim_switches & SWMASK ('R'))) {
+    char *plast_char = &capac_buf[strlen (capac_buf) - 1];
+    char save_char = *plast_char;
+
+    sprintf (plast_char, "%0.3f", remfrac);
+    *plast_char = save_char;
+    }
+sprintf (&capac_buf[strlen (capac_buf)], "%s%s", scale, width);
+return capac_buf;
+}
+
+void fprint_capac (FILE *st, DEVICE *dptr, UNIT *uptr)
+{
+fprintf (st, "%s", sprint_capac (dptr, uptr));
+}
 
 const char *sim_get_tool_path (const char *tool)
 {
@@ -7536,10 +9623,13 @@ if (sim_clock_queue == QUEUE_LIST_END)
 else {
     const char *tim = "";
     double inst_per_sec = sim_timer_inst_per_sec ();
+    uint32 i, count;
+    UNIT **units = _sim_eventq_units (&count);
 
     fprintf (st, "%s event queue status, time = %.0f, executing %s %s/sec\n",
              sim_name, sim_time, sim_fmt_numeric (inst_per_sec), sim_vm_interval_units);
-    for (uptr = sim_clock_queue; uptr != QUEUE_LIST_END; uptr = uptr->next) {
+    for (i = 0; i < count; i++) {
+        uptr = units[i];
         if (uptr == &sim_step_unit)
             fprintf (st, "  Step timer");
         else
@@ -7567,7 +9657,9 @@ else {
                                             (*tim) ? " (" : "", tim, (*tim) ? ")" : "",
                                             (uptr->flags & UNIT_IDLE) ? " (Idle capable)" : "");
         }
+    free (units);
     }
+sim_show_queue_type (st, dnotused, unotused, flag, cptr);
 sim_show_clock_queues (st, dnotused, unotused, flag, cptr);
 #if defined (SIM_ASYNCH_IO)
 pthread_mutex_lock (&sim_asynch_lock);
@@ -9184,31 +11276,510 @@ else
 return sim_set_uname (uptr, uname);
 }
 
-const char *sim_set_uname (UNIT *uptr, const char *uname)
-{
-free (uptr->uname);
-return uptr->uname = strcpy ((char *)malloc (1 + strlen (uname)), uname);
+const char *sim_set_uname (UNIT *uptr, const char *uname)
+{
+free (uptr->uname);
+return uptr->uname = strcpy ((char *)malloc (1 + strlen (uname)), uname);
+}
+
+/* Get attach display name */
+
+const char *sim_attach_name (UNIT *uptr)
+{
+DEVICE *dptr = find_dev_from_unit (uptr);
+
+if ((uptr == NULL) || ((uptr->flags & UNIT_ATT) == 0))
+    return "";
+if ((DEV_TYPE (uptr->dptr) != DEV_MUX) &&
+    (DEV_TYPE (uptr->dptr) != DEV_ETHER))
+    return sim_relative_path (uptr->filename);
+else
+    return uptr->filename;
+}
+
+
+/* Save/restore memory support
+
+   Memory units are saved in pages of SRPAGE elements.  Each page is
+   written as part of a run of zero pages, as part of a run of pages
+   unchanged since the previous save (incremental saves only), as a raw
+   page or as a compressed page.
+
+   Simulators which keep a unit's memory in an array holding one element
+   of SZ_D bytes per address increment, in the form returned by the
+   examine routine, can register that array with sim_register_memory.
+   Pages of registered memory are copied directly rather than a word at
+   a time through the examine and deposit routines.
+
+   A copy of each memory unit's contents is kept from the most recent
+   save so that a subsequent incremental save only writes the pages
+   which differ from it.  Pages are compared rather than hashed since a
+   hash collision would silently drop a changed page from the save.
+*/
+
+typedef struct SAVE_MEM {
+    UNIT        *uptr;                                  /* memory unit */
+    void        **mem;                                  /* registered memory array */
+    t_addr      words;                                  /* elements in copy */
+    t_bool      valid;                                  /* copy matches the base save */
+    uint8       *copy;                                  /* contents as of last save */
+    } SAVE_MEM;
+
+static SAVE_MEM *sim_save_mem = NULL;                   /* memory unit table */
+static uint32 sim_save_mem_count = 0;
+static char *sim_save_base = NULL;                      /* last save file (incremental base) */
+static char sim_save_id[32] = "";                      /* id of last save */
+static char sim_save_new_id[32];                        /* id of save in progress */
+static char sim_rest_id[32];                            /* id of last restored save */
+static const char *sim_save_incr = NULL;                /* base of save in progress */
+static int32 sim_rest_depth = 0;                        /* incremental restore nesting */
+
+static SAVE_MEM *_sim_save_mem (UNIT *uptr, t_bool create)
+{
+uint32 i;
+
+for (i = 0; i < sim_save_mem_count; i++)
+    if (sim_save_mem[i].uptr == uptr)
+        return &sim_save_mem[i];
+if (!create)
+    return NULL;
+sim_save_mem = (SAVE_MEM *)realloc (sim_save_mem, (sim_save_mem_count + 1) * sizeof (*sim_save_mem));
+if (sim_save_mem == NULL) {
+    sim_save_mem_count = 0;
+    return NULL;
+    }
+memset (&sim_save_mem[sim_save_mem_count], 0, sizeof (*sim_save_mem));
+sim_save_mem[sim_save_mem_count].uptr = uptr;
+return &sim_save_mem[sim_save_mem_count++];
+}
+
+/* Register a memory unit's backing array
+
+   Inputs:
+        uptr    =       memory unit
+        mem     =       pointer to the simulator's memory array pointer
+   Outputs:
+        status  =       status code
+
+   The array pointer is fetched at each save and restore, so the array
+   may be reallocated when the memory size changes.
+*/
+
+t_stat sim_register_memory (UNIT *uptr, void **mem)
+{
+SAVE_MEM *smp = _sim_save_mem (uptr, TRUE);
+
+if (smp == NULL)
+    return SCPE_MEM;
+smp->mem = mem;
+return SCPE_OK;
+}
+
+static uint8 *_sim_save_mem_array (UNIT *uptr)
+{
+SAVE_MEM *smp = _sim_save_mem (uptr, FALSE);
+
+return ((smp == NULL) || (smp->mem == NULL)) ? NULL : (uint8 *)*smp->mem;
+}
+
+static void _sim_save_invalidate (void)
+{
+uint32 i;
+
+for (i = 0; i < sim_save_mem_count; i++)
+    sim_save_mem[i].valid = FALSE;
+free (sim_save_base);
+sim_save_base = NULL;
+}
+
+/* Determine whether a page is all zero */
+
+static t_bool _sim_save_page_zero (const uint8 *p, size_t bytes)
+{
+t_uint64 v, nz = 0;
+
+for ( ; bytes >= sizeof (v); bytes -= sizeof (v), p += sizeof (v)) {
+    memcpy (&v, p, sizeof (v));
+    nz |= v;
+    }
+for ( ; bytes > 0; bytes--, p++)
+    nz |= *p;
+return (nz == 0);
+}
+
+/* Memory page compression
+
+   A byte oriented LZ77 codec using the LZ4 block layout.  Each sequence
+   is a token byte (literal count in the high nibble, match length - 4
+   in the low nibble), literal count extension bytes, the literals, a
+   2 byte little endian match offset and match length extension bytes.
+   The final sequence holds only literals.
+*/
+
+#define SR_LZ_HASHBITS  12                              /* match table size */
+#define SR_LZ_MINMATCH  4                               /* shortest match */
+#define SR_LZ_LASTLIT   5                               /* trailing bytes always literal */
+#define SR_LZ_MFLIMIT   12                              /* no match starts closer to end */
+
+static uint32 _sim_lz_read32 (const uint8 *p)
+{
+uint32 v;
+
+memcpy (&v, p, sizeof (v));
+return v;
+}
+
+static uint8 *_sim_lz_put_length (uint8 *op, size_t len)
+{
+for ( ; len >= 255; len -= 255)
+    *op++ = 255;
+*op++ = (uint8)len;
+return op;
+}
+
+static t_bool _sim_lz_get_length (const uint8 **ip, const uint8 *iend, size_t *len)
+{
+uint8 b;
+
+if (*len != 15)
+    return TRUE;
+do {
+    if (*ip >= iend)
+        return FALSE;
+    b = *(*ip)++;
+    *len += b;
+    } while (b == 255);
+return TRUE;
+}
+
+static uint8 *_sim_lz_sequence (uint8 *op, const uint8 *oend, const uint8 *lit, size_t litlen, size_t offset, size_t mlen, t_bool last)
+{
+uint8 *token = op;
+
+if ((op >= oend) ||
+    ((size_t)(oend - op) < (1 + litlen + litlen / 255 + mlen / 255 + 4)))
+    return NULL;
+++op;
+*token = (uint8)(((litlen < 15) ? litlen : 15) << 4);
+if (litlen >= 15)
+    op = _sim_lz_put_length (op, litlen - 15);
+memcpy (op, lit, litlen);
+op += litlen;
+if (!last) {
+    *token |= (uint8)((mlen < 15) ? mlen : 15);
+    *op++ = (uint8)(offset & 0xFF);
+    *op++ = (uint8)(offset >> 8);
+    if (mlen >= 15)
+        op = _sim_lz_put_length (op, mlen - 15);
+    }
+return op;
+}
+
+/* Compress slen bytes, returns the compressed length or 0 if the
+   result doesn't fit in dmax bytes */
+
+size_t sim_lz_compress (const uint8 *src, size_t slen, uint8 *dst, size_t dmax)
+{
+uint32 table[1 << SR_LZ_HASHBITS];
+const uint8 *ip = src, *anchor = src;
+const uint8 *end = src + slen;
+const uint8 *oend = dst + dmax;
+uint8 *op = dst;
+
+memset (table, 0, sizeof (table));
+if (slen > SR_LZ_MFLIMIT) {
+    const uint8 *mflimit = end - SR_LZ_MFLIMIT;
+    const uint8 *mlimit = end - SR_LZ_LASTLIT;
+
+    while (ip < mflimit) {
+        uint32 seq = _sim_lz_read32 (ip);
+        uint32 h = (seq * 2654435761U) >> (32 - SR_LZ_HASHBITS);
+        const uint8 *ref = src + table[h];
+        const uint8 *mp;
+
+        table[h] = (uint32)(ip - src);
+        if ((ref >= ip) || ((ip - ref) > 0xFFFF) ||
+            (_sim_lz_read32 (ref) != seq)) {
+            ++ip;
+            continue;
+            }
+        for (mp = ip + SR_LZ_MINMATCH, ref += SR_LZ_MINMATCH;
+             (mp < mlimit) && (*mp == *ref); mp++, ref++)
+            ;
+        op = _sim_lz_sequence (op, oend, anchor, ip - anchor, mp - ref, mp - ip - SR_LZ_MINMATCH, FALSE);
+        if (op == NULL)
+            return 0;
+        ip = anchor = mp;
+        }
+    }
+op = _sim_lz_sequence (op, oend, anchor, end - anchor, 0, 0, TRUE);
+return (op == NULL) ? 0 : (size_t)(op - dst);
+}
+
+/* Decompress exactly dlen bytes */
+
+t_bool sim_lz_decompress (const uint8 *src, size_t slen, uint8 *dst, size_t dlen)
+{
+const uint8 *ip = src, *iend = src + slen;
+uint8 *op = dst, *oend = dst + dlen;
+
+while (ip < iend) {
+    uint8 token = *ip++;
+    size_t len = token >> 4;
+    size_t offset;
+    const uint8 *ref;
+
+    if ((!_sim_lz_get_length (&ip, iend, &len)) ||
+        (len > (size_t)(iend - ip)) ||
+        (len > (size_t)(oend - op)))
+        return FALSE;
+    memcpy (op, ip, len);
+    ip += len;
+    op += len;
+    if (ip == iend)                                     /* final sequence? */
+        break;
+    if ((iend - ip) < 2)
+        return FALSE;
+    offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if ((offset == 0) || (offset > (size_t)(op - dst)))
+        return FALSE;
+    len = token & 15;
+    if (!_sim_lz_get_length (&ip, iend, &len))
+        return FALSE;
+    len += SR_LZ_MINMATCH;
+    if (len > (size_t)(oend - op))
+        return FALSE;
+    for (ref = op - offset; len > 0; len--)             /* matches may overlap */
+        *op++ = *ref++;
+    }
+return (op == oend);
+}
+
+/* Write the contents of a memory unit in [V4.1] page format */
+
+static t_stat _sim_save_memory (FILE *sfile, DEVICE *dptr, UNIT *uptr, t_bool compress, t_bool incremental)
+{
+SAVE_MEM *smp = _sim_save_mem (uptr, TRUE);
+uint8 *mem = _sim_save_mem_array (uptr);
+size_t sz = SZ_D (dptr);
+t_addr words = (uptr->capac + dptr->aincr - 1) / dptr->aincr;
+uint32 pages = (uint32)((words + SRPAGE - 1) / SRPAGE);
+uint8 *pbuf = NULL, *cbuf = NULL;
+int32 run_type = SR_PG_ZERO, run_count = 0, type, count;
+uint32 p, l;
+t_addr k;
+t_value val;
+t_stat r = SCPE_OK;
+
+if (smp == NULL)
+    return SCPE_MEM;
+if (words != smp->words) {                              /* size changed? */
+    free (smp->copy);
+    smp->words = 0;
+    smp->valid = FALSE;
+    if ((smp->copy = (uint8 *)malloc ((size_t)words * sz + 1)) == NULL)
+        return SCPE_MEM;
+    smp->words = words;
+    }
+incremental = incremental && smp->valid;
+smp->valid = FALSE;                                     /* copy in flux */
+pbuf = (uint8 *)malloc (SRPAGE * sz);
+if (compress)
+    cbuf = (uint8 *)malloc (SRPAGE * sz);
+if ((pbuf == NULL) || (compress && (cbuf == NULL))) {
+    free (pbuf);
+    free (cbuf);
+    return SCPE_MEM;
+    }
+for (p = 0, k = 0; p < pages; p++) {                    /* loop thru pages */
+    uint32 n = (uint32)(((words - k) < SRPAGE) ? (words - k) : SRPAGE);
+    size_t bytes = n * sz, clen = 0;
+    uint8 *page = pbuf;
+    uint8 *prev = smp->copy + (size_t)k * sz;
+
+    if (mem != NULL)                                    /* registered array? */
+        page = mem + (size_t)k * sz;
+    else {
+        for (l = 0; l < n; l++) {
+            r = dptr->examine (&val, (k + l) * dptr->aincr, uptr, SIM_SW_REST);
+            if (r != SCPE_OK)
+                goto Done;
+            SZ_STORE (sz, val, pbuf, l);
+            }
+        }
+    k += n;
+    if (incremental && (memcmp (page, prev, bytes) == 0))
+        type = _sim_save_page_zero (page, bytes) ? SR_PG_ZERO : SR_PG_BASE;
+    else {
+        memcpy (prev, page, bytes);                     /* as of this save */
+        if (_sim_save_page_zero (page, bytes))
+            type = SR_PG_ZERO;
+        else {
+            type = SR_PG_RAW;
+            if (compress) {
+                if (!sim_end) {                         /* compress little endian data */
+                    if (page != pbuf)
+                        memcpy (pbuf, page, bytes);
+                    sim_buf_swap_data (pbuf, sz, n);
+                    page = pbuf;
+                    }
+                clen = sim_lz_compress (page, bytes, cbuf, bytes - 1);
+                if (clen != 0)
+                    type = SR_PG_LZ;
+                else {
+                    if (!sim_end)                       /* restore host order */
+                        sim_buf_swap_data (pbuf, sz, n);
+                    }
+                }
+            }
+        }
+    if ((run_count > 0) && (type != run_type)) {        /* end of a run? */
+        sim_fwrite (&run_type, sizeof (run_type), 1, sfile);
+        sim_fwrite (&run_count, sizeof (run_count), 1, sfile);
+        run_count = 0;
+        }
+    if ((type == SR_PG_ZERO) || (type == SR_PG_BASE)) {
+        run_type = type;
+        ++run_count;
+        continue;
+        }
+    count = (type == SR_PG_LZ) ? (int32)clen : (int32)n;
+    sim_fwrite (&type, sizeof (type), 1, sfile);
+    sim_fwrite (&count, sizeof (count), 1, sfile);
+    if (type == SR_PG_LZ)
+        sim_fwrite (cbuf, 1, clen, sfile);
+    else
+        sim_fwrite (page, sz, n, sfile);
+    }
+if (run_count > 0) {                                    /* final run */
+    sim_fwrite (&run_type, sizeof (run_type), 1, sfile);
+    sim_fwrite (&run_count, sizeof (run_count), 1, sfile);
+    }
+smp->valid = TRUE;
+Done:
+free (pbuf);
+free (cbuf);
+return r;
+}
+
+/* Read the contents of a memory unit in [V4.1] page format */
+
+static t_stat _sim_rest_memory (FILE *rfile, DEVICE *dptr, UNIT *uptr, t_addr high, t_bool have_base)
+{
+uint8 *mem = _sim_save_mem_array (uptr);
+size_t sz = SZ_D (dptr);
+t_addr words = (high + dptr->aincr - 1) / dptr->aincr;
+uint8 *pbuf = NULL, *cbuf = NULL;
+int32 type, count;
+t_addr k, n, l;
+t_value val;
+t_stat r = SCPE_OK;
+
+if ((pbuf = (uint8 *)malloc (SRPAGE * sz)) == NULL)
+    return SCPE_MEM;
+for (k = 0; (k < words) && (r == SCPE_OK); k += n) {    /* loop thru mem */
+    if ((sim_fread (&type, sizeof (type), 1, rfile) == 0) ||
+        (sim_fread (&count, sizeof (count), 1, rfile) == 0) ||
+        (count <= 0)) {
+        r = SCPE_IOERR;
+        break;
+        }
+    n = ((words - k) < SRPAGE) ? (words - k) : SRPAGE;  /* page size */
+    switch (type) {
+
+        case SR_PG_BASE:                                /* unchanged from base */
+            if (!have_base)
+                r = SCPE_INCOMP;
+            /* fall through */
+        case SR_PG_ZERO:                                /* zero pages */
+            if ((t_addr)count < ((words - k + SRPAGE - 1) / SRPAGE))
+                n = (t_addr)count * SRPAGE;
+            else
+                n = words - k;
+            if (type == SR_PG_BASE)
+                break;
+            if (mem != NULL)
+                memset (mem + (size_t)k * sz, 0, (size_t)n * sz);
+            else {
+                for (l = 0; (l < n) && (r == SCPE_OK); l++)
+                    r = dptr->deposit (0, (k + l) * dptr->aincr, uptr, SIM_SW_REST);
+                }
+            break;
+
+        case SR_PG_RAW:                                 /* uncompressed page */
+            if (((t_addr)count != n) ||
+                (sim_fread (pbuf, sz, (size_t)n, rfile) != (size_t)n))
+                r = SCPE_IOERR;
+            break;
+
+        case SR_PG_LZ:                                  /* compressed page */
+            if ((cbuf == NULL) &&
+                ((cbuf = (uint8 *)malloc (SRPAGE * sz)) == NULL)) {
+                r = SCPE_MEM;
+                break;
+                }
+            if (((size_t)count >= (size_t)n * sz) ||
+                (sim_fread (cbuf, 1, (size_t)count, rfile) != (size_t)count) ||
+                (!sim_lz_decompress (cbuf, (size_t)count, pbuf, (size_t)n * sz))) {
+                r = SCPE_IOERR;
+                break;
+                }
+            if (!sim_end)
+                sim_buf_swap_data (pbuf, sz, (size_t)n);
+            break;
+
+        default:
+            r = SCPE_IOERR;
+            break;
+            }
+    if ((r != SCPE_OK) || ((type != SR_PG_RAW) && (type != SR_PG_LZ)))
+        continue;
+    if (mem != NULL)                                    /* registered array? */
+        memcpy (mem + (size_t)k * sz, pbuf, (size_t)n * sz);
+    else {
+        for (l = 0; (l < n) && (r == SCPE_OK); l++) {
+            SZ_LOAD (sz, val, pbuf, l);
+            r = dptr->deposit (val, (k + l) * dptr->aincr, uptr, SIM_SW_REST);
+            }
+        }
+    }
+free (pbuf);
+free (cbuf);
+return r;
 }
 
-/* Get attach display name */
+/* Restore the save an incremental save was based on */
 
-const char *sim_attach_name (UNIT *uptr)
+static t_stat _sim_rest_base (const char *bname, const char *bid)
 {
-DEVICE *dptr = find_dev_from_unit (uptr);
+FILE *bfile;
+double saved_time = sim_time;
+uint32 saved_rtime = sim_rtime;
+t_stat r;
 
-if ((uptr == NULL) || ((uptr->flags & UNIT_ATT) == 0))
-    return "";
-if ((DEV_TYPE (uptr->dptr) != DEV_MUX) &&
-    (DEV_TYPE (uptr->dptr) != DEV_ETHER))
-    return sim_relative_path (uptr->filename);
-else
-    return uptr->filename;
+if (sim_rest_depth >= SRMAXBASE)
+    return sim_messagef (SCPE_INCOMP, "Incremental save chain too long at: %s\n", bname);
+if ((bfile = sim_fopen (bname, "rb")) == NULL)
+    return sim_messagef (SCPE_OPENERR, "Can't open incremental save base: %s\n", bname);
+sim_debug (SIM_DBG_RESTORE, &sim_scp_dev, "restoring incremental base %s\n", bname);
+++sim_rest_depth;
+sim_switches = SWMASK ('F') | SWMASK ('D') | SWMASK ('Q');
+r = sim_rest (bfile);
+--sim_rest_depth;
+fclose (bfile);
+if ((r == SCPE_OK) && (strcmp (sim_rest_id, bid) != 0))
+    r = sim_messagef (SCPE_INCOMP, "Incremental save base %s has been overwritten\n", bname);
+_sim_set_time (saved_time);
+sim_rtime = saved_rtime;
+return r;
 }
 
-
 /* Save command
 
-   sa[ve] filename              save state to specified file
+   sa[ve] {-c} {-i} filename    save state to specified file
+                                -c compress memory
+                                -i only write memory changed since last save
 */
 
 t_stat save_cmd (int32 flag, CONST char *cptr)
@@ -9227,21 +11798,34 @@ if ((sfile = sim_fopen (gbuf, "r+b")) == NULL) {    /* try existing file */
     if ((sfile = sim_fopen (gbuf, "wb")) == NULL)   /* create new empty file */
         return SCPE_OPENERR;
     }
+if ((sim_switches & SWMASK ('I')) &&                    /* incremental from a */
+    (sim_save_base != NULL) &&                          /* different prior save? */
+    (strcmp (sim_save_base, gbuf) != 0))
+    sim_save_incr = sim_save_base;
 r = sim_save (sfile);
+sim_save_incr = NULL;
 fclose (sfile);
+if (r == SCPE_OK) {                                     /* new incremental base */
+    free (sim_save_base);
+    sim_save_base = (char *)malloc (1 + strlen (gbuf));
+    if (sim_save_base != NULL)
+        strcpy (sim_save_base, gbuf);
+    strlcpy (sim_save_id, sim_save_new_id, sizeof (sim_save_id));
+    }
+else
+    _sim_save_invalidate ();
 return r;
 }
 
 t_stat sim_save (FILE *sfile)
 {
-void *mbuf;
-int32 l, t;
+int32 t;
 uint32 i, j, device_count;
-t_addr k, high;
+t_addr high;
 t_value val;
 t_stat r;
-t_bool zeroflg;
-size_t sz;
+t_bool compress = ((sim_switches & SWMASK ('C')) != 0);
+static uint32 save_serial = 0;
 DEVICE *dptr;
 UNIT *uptr;
 REG *rptr;
@@ -9263,6 +11847,13 @@ fprintf (sfile, "git commit id: %8.8s\n", __STR(SIM_GIT_COMMIT_ID));
 #else
 fprintf (sfile, "git commit id: unknown\n");
 #endif
+snprintf (sim_save_new_id, sizeof (sim_save_new_id), "%08X%08X%04X",/* [V4.1] save id */
+          (uint32)time (NULL), sim_os_msec (), ++save_serial & 0xFFFF);
+fprintf (sfile, "save id: %s\n", sim_save_new_id);
+if (sim_save_incr != NULL)                              /* [V4.1] incremental base */
+    fprintf (sfile, "base: %s %s\n", sim_save_id, sim_save_incr);
+else
+    fprintf (sfile, "base:\n");
 
 for (device_count = 0; sim_devices[device_count]; device_count++);/* count devices */
 for (i = 0; i < (device_count + sim_internal_device_count); i++) {/* loop thru devices */
@@ -9317,33 +11908,10 @@ for (i = 0; i < (device_count + sim_internal_device_count); i++) {/* loop thru d
              (dptr->examine != NULL) &&
              ((high = uptr->capac) != 0)) {             /* memory-like unit? */
             WRITE_I (high);                             /* [V2.5] write size */
-            sz = SZ_D (dptr);
-            if ((mbuf = calloc (SRBSIZ, sz)) == NULL) {
-                fclose (sfile);
-                return SCPE_MEM;
-                }
-            for (k = 0; k < high; ) {                   /* loop thru mem */
-                zeroflg = TRUE;
-                for (l = 0; (l < SRBSIZ) && (k < high); l++,
-                     k = k + (dptr->aincr)) {           /* check for 0 block */
-                    r = dptr->examine (&val, k, uptr, SIM_SW_REST);
-                    if (r != SCPE_OK) {
-                        free (mbuf);
-                        return r;
-                        }
-                    if (val) zeroflg = FALSE;
-                    SZ_STORE (sz, val, mbuf, l);
-                    }                                   /* end for l */
-                if (zeroflg) {                          /* all zero's? */
-                    l = -l;                             /* invert block count */
-                    WRITE_I (l);                        /* write only count */
-                    }
-                else {
-                    WRITE_I (l);                        /* block count */
-                    sim_fwrite (mbuf, sz, l, sfile);
-                    }
-                }                                       /* end for k */
-            free (mbuf);                                /* dealloc buffer */
+            r = _sim_save_memory (sfile, dptr, uptr,    /* [V4.1] memory pages */
+                                  compress, (sim_save_incr != NULL));
+            if (r != SCPE_OK)
+                return r;
             }                                           /* end if mem */
         else {                                          /* no memory */
             high = 0;                                   /* write 0 */
@@ -9418,7 +11986,10 @@ t_addr k, high, old_capac;
 t_value val, max;
 t_stat r;
 size_t sz;
-t_bool v40, v35, v32;
+t_bool v41, v40, v35, v32;
+double rest_time = sim_time;
+t_bool have_base = FALSE;
+char save_id[sizeof (sim_rest_id)] = "";
 DEVICE *dptr;
 UNIT *uptr;
 REG *rptr;
@@ -9445,8 +12016,10 @@ if (fstat (fileno (rfile), &rstat)) {
     }
 READ_S (buf);                                           /* [V2.5+] read version */
 sim_debug (SIM_DBG_RESTORE, &sim_scp_dev, "version=%s\n", buf);
-v40 = v35 = v32 = FALSE;
-if (strcmp (buf, save_ver40) == 0)                      /* version 4.0? */
+v41 = v40 = v35 = v32 = FALSE;
+if (strcmp (buf, save_ver41) == 0)                      /* version 4.1? */
+    v41 = v40 = v35 = v32 = TRUE;
+else if (strcmp (buf, save_ver40) == 0)                 /* version 4.0? */
     v40 = v35 = v32 = TRUE;
 else if (strcmp (buf, save_ver35) == 0)                 /* version 3.5? */
     v35 = v32 = TRUE;
@@ -9456,7 +12029,7 @@ else if (strcmp (buf, save_ver30) != 0) {               /* version 3.0? */
     sim_printf ("Invalid file version: %s\n", buf);
     return SCPE_INCOMP;
     }
-if ((strcmp (buf, save_ver40) != 0) && (!sim_quiet) && (!suppress_warning)) {
+if ((!v40) && (!sim_quiet) && (!suppress_warning)) {
     sim_printf ("warning - attempting to restore a saved simulator image in %s image format.\n", buf);
     warned = TRUE;
     }
@@ -9481,9 +12054,10 @@ if (v35) {                                              /* [V3.5+] options */
     }
 if (v32) {                                              /* [V3.2+] time as string */
     READ_S (buf);
-    sscanf (buf, "%lf", &sim_time);
+    sscanf (buf, "%lf", &rest_time);
     }
-else READ_I (sim_time);                                 /* sim time */
+else READ_I (rest_time);                                /* sim time */
+_sim_set_time (rest_time);
 READ_I (sim_rtime);                                     /* [V2.6+] sim rel time */
 if (v40) {
     READ_S (buf);                                       /* read git commit id */
@@ -9495,6 +12069,28 @@ if (v40) {
         }
 #endif
     }
+if (v41) {
+    READ_S (buf);                                       /* [V4.1] save id */
+    if (memcmp (buf, "save id: ", 9) != 0) {
+        r = SCPE_IOERR;
+        goto Cleanup_Return;
+        }
+    strlcpy (save_id, buf + 9, sizeof (save_id));
+    READ_S (buf);                                       /* [V4.1] incremental base */
+    if (memcmp (buf, "base:", 5) != 0) {
+        r = SCPE_IOERR;
+        goto Cleanup_Return;
+        }
+    if (buf[5] != '\0') {                               /* incremental save? */
+        char bid[CBUFSIZE];
+        const char *bname = get_glyph_nc (buf + 6, bid, 0);
+
+        r = _sim_rest_base (bname, bid);                /* restore base first */
+        if (r != SCPE_OK)
+            goto Cleanup_Return;
+        have_base = TRUE;
+        }
+    }
 if (!dont_detach_attach)
     detach_all (0, 0);                                  /* Detach everything to start from a consistent state */
 else {
@@ -9631,6 +12227,12 @@ for ( ;; ) {                                            /* device loop */
                     fprint_capac (sim_log, dptr, uptr);
                 sim_printf ("\n");
                 }
+            if (v41) {                                  /* [V4.1] memory pages */
+                r = _sim_rest_memory (rfile, dptr, uptr, high, have_base);
+                if (r != SCPE_OK)
+                    goto Cleanup_Return;
+                continue;
+                }
             sz = SZ_D (dptr);                           /* allocate buffer */
             if ((mbuf = realloc (mbuf, SRBSIZ * sz)) == NULL) {
                 r = SCPE_MEM;
@@ -9757,6 +12359,8 @@ for (j=0, r = SCPE_OK; j<attcnt; j++) {
     attnames[j] = NULL;
     }
 Cleanup_Return:
+if (r == SCPE_OK)
+    strlcpy (sim_rest_id, save_id, sizeof (sim_rest_id));
 free (mbuf);
 for (j=0; j < attcnt; j++)
     free (attnames[j]);
@@ -10009,6 +12613,7 @@ if (signal (SIGTERM, int_handler) == SIG_ERR) {         /* set WRU */
 if (sim_step)                                           /* set step timer */
     sim_sched_step ();
 sim_activate_after (&sim_flush_unit, sim_flush_interval * 1000000);/* Enable periodic buffer flushing */
+_sim_perf_sched ();                                     /* periodic counter dumps */
 stop_cpu = FALSE;
 sim_is_running = TRUE;                                  /* flag running */
 fflush(stdout);                                         /* flush stdout */
@@ -10086,6 +12691,7 @@ signal (SIGHUP, sigterm_received ? SIG_IGN : SIG_DFL);  /* cancel WRU */
 signal (SIGTERM, sigterm_received ? SIG_IGN : SIG_DFL); /* cancel WRU */
 sim_flush_buffered_files (TRUE);
 sim_cancel (&sim_flush_unit);                           /* cancel flush timer */
+_sim_perf_cancel ();                                    /* cancel counter dumps */
 sim_cancel_step ();                                     /* cancel step timer */
 sim_throt_cancel ();                                    /* cancel throttle */
 AIO_UPDATE_QUEUE;
@@ -12747,10 +15353,259 @@ return buf;
    and to see if further events need to be processed, or sim_interval
    reset to count the next one.
 
-   The event queue is maintained in clock order; entry timeouts are
-   RELATIVE to the time in the previous entry.
+   The event queue has two interchangeable implementations, selected
+   with SET QUEUE:
+
+   LIST - the event queue is maintained in clock order; entry timeouts
+          are RELATIVE to the time in the previous entry.  Activation
+          and cancellation walk the list.
+   HEAP - the event queue is a binary min-heap of ABSOLUTE due times
+          (in sim_time units) with an insertion sequence number which
+          preserves the first in first out order of events due at the
+          same time.  Activation and cancellation are O(log n).
+
+   In either case, sim_clock_queue points to the next unit due to fire
+   and sim_clock_queue->time is the interval last loaded into sim_interval
+   so that UPDATE_SIM_TIME and code which examines the head of the queue
+   behave identically.  Units in the heap have their next field set to
+   QUEUE_LIST_END so that they are seen as active.
+
+   Heap due times are stored less sim_eventq_bias.  When sim_time is
+   changed other than by the passage of time (RESTORE, sim_reset_time) or
+   event processing moves the whole LIST queue relative to sim_time, the
+   bias is adjusted so that every pending heap event moves with it.
+*/
+
+#define EVENTQ_LIST     0                               /* delta list */
+#define EVENTQ_HEAP     1                               /* binary heap */
+
+static const char *eventq_types[] = {"LIST", "HEAP"};
+
+typedef struct EVENTQ_ENT {
+    double              due;                            /* absolute due time */
+    t_int64             seq;                            /* insertion order */
+    UNIT                *uptr;                          /* queued unit */
+    } EVENTQ_ENT;
+
+static int32 sim_eventq_type = EVENTQ_LIST;
+static EVENTQ_ENT *sim_eventq_heap = NULL;
+static uint32 sim_eventq_count = 0;
+static uint32 sim_eventq_size = 0;
+static t_int64 sim_eventq_seq = 0;
+static double sim_eventq_bias = 0.0;
+
+#define EVENTQ_DUE(slot) (sim_eventq_heap[slot].due + sim_eventq_bias)
+
+#define EVENTQ_BEFORE(a,b) (((a)->due < (b)->due) || (((a)->due == (b)->due) && ((a)->seq < (b)->seq)))
+
+static void _eventq_sift_up (uint32 slot)
+{
+EVENTQ_ENT ent = sim_eventq_heap[slot];
+
+while (slot > 0) {
+    uint32 parent = (slot - 1) / 2;
+
+    if (!EVENTQ_BEFORE (&ent, &sim_eventq_heap[parent]))
+        break;
+    sim_eventq_heap[slot] = sim_eventq_heap[parent];
+    sim_eventq_heap[slot].uptr->q_slot = slot;
+    slot = parent;
+    }
+sim_eventq_heap[slot] = ent;
+ent.uptr->q_slot = slot;
+}
+
+static void _eventq_sift_down (uint32 slot)
+{
+EVENTQ_ENT ent = sim_eventq_heap[slot];
+
+while (1) {
+    uint32 child = 2 * slot + 1;
+
+    if (child >= sim_eventq_count)
+        break;
+    if ((child + 1 < sim_eventq_count) &&
+        EVENTQ_BEFORE (&sim_eventq_heap[child + 1], &sim_eventq_heap[child]))
+        ++child;
+    if (!EVENTQ_BEFORE (&sim_eventq_heap[child], &ent))
+        break;
+    sim_eventq_heap[slot] = sim_eventq_heap[child];
+    sim_eventq_heap[slot].uptr->q_slot = slot;
+    slot = child;
+    }
+sim_eventq_heap[slot] = ent;
+ent.uptr->q_slot = slot;
+}
+
+static t_bool _eventq_heap_member (UNIT *uptr)
+{
+return ((uptr->q_slot < sim_eventq_count) &&
+        (sim_eventq_heap[uptr->q_slot].uptr == uptr));
+}
+
+static t_stat _eventq_heap_insert (UNIT *uptr, double due, t_int64 seq)
+{
+if (sim_eventq_count == sim_eventq_size) {
+    uint32 size = (sim_eventq_size == 0) ? 64 : 2 * sim_eventq_size;
+    EVENTQ_ENT *heap = (EVENTQ_ENT *)realloc (sim_eventq_heap, size * sizeof (*heap));
+
+    if (heap == NULL)
+        return SCPE_MEM;
+    sim_eventq_heap = heap;
+    sim_eventq_size = size;
+    }
+sim_eventq_heap[sim_eventq_count].due = due;
+sim_eventq_heap[sim_eventq_count].seq = seq;
+sim_eventq_heap[sim_eventq_count].uptr = uptr;
+_eventq_sift_up (sim_eventq_count++);
+uptr->next = QUEUE_LIST_END;
+return SCPE_OK;
+}
+
+static void _eventq_heap_remove (UNIT *uptr)
+{
+uint32 slot = uptr->q_slot;
+
+if (slot != --sim_eventq_count) {
+    sim_eventq_heap[slot] = sim_eventq_heap[sim_eventq_count];
+    sim_eventq_heap[slot].uptr->q_slot = slot;
+    if ((slot > 0) &&
+        EVENTQ_BEFORE (&sim_eventq_heap[slot], &sim_eventq_heap[(slot - 1) / 2]))
+        _eventq_sift_up (slot);
+    else
+        _eventq_sift_down (slot);
+    }
+uptr->next = NULL;
+uptr->q_slot = 0;
+}
+
+/* Reload sim_clock_queue and sim_interval from the top of the heap.
+   sim_time must be current (UPDATE_SIM_TIME) when this is called. */
+
+static void _eventq_heap_sync (void)
+{
+if (sim_eventq_count == 0) {
+    sim_clock_queue = QUEUE_LIST_END;
+    sim_interval = noqueue_time = NOQUEUE_WAIT;
+    }
+else {
+    sim_clock_queue = sim_eventq_heap[0].uptr;
+    sim_clock_queue->time = (int32)(EVENTQ_DUE (0) - sim_time);
+    sim_interval = sim_clock_queue->time;
+    }
+}
+
+static int _eventq_ent_compare (const void *pa, const void *pb)
+{
+const EVENTQ_ENT *a = (const EVENTQ_ENT *)pa;
+const EVENTQ_ENT *b = (const EVENTQ_ENT *)pb;
+
+return EVENTQ_BEFORE (a, b) ? -1 : (EVENTQ_BEFORE (b, a) ? 1 : 0);
+}
+
+/* Return a malloc'd array of the units on the event queue in the order
+   that they will fire */
+
+static UNIT **_sim_eventq_units (uint32 *count)
+{
+UNIT **units;
+UNIT *uptr;
+uint32 i;
+
+*count = (uint32)sim_qcount ();
+units = (UNIT **)calloc (*count + 1, sizeof (*units));
+if (units == NULL) {
+    *count = 0;
+    return NULL;
+    }
+if (sim_eventq_type == EVENTQ_HEAP) {
+    EVENTQ_ENT *ents = (EVENTQ_ENT *)malloc ((*count + 1) * sizeof (*ents));
+
+    if (ents == NULL) {
+        free (units);
+        *count = 0;
+        return NULL;
+        }
+    memcpy (ents, sim_eventq_heap, *count * sizeof (*ents));
+    qsort (ents, *count, sizeof (*ents), _eventq_ent_compare);
+    for (i = 0; i < *count; i++)
+        units[i] = ents[i].uptr;
+    free (ents);
+    }
+else {
+    for (uptr = sim_clock_queue, i = 0; uptr != QUEUE_LIST_END; uptr = uptr->next)
+        units[i++] = uptr;
+    }
+return units;
+}
+
+/* Change the event queue implementation, moving any pending events
+   to the new queue with their remaining times preserved */
+
+static t_stat _sim_eventq_set_type (int32 type)
+{
+UNIT **units;
+int32 *times;
+uint32 i, count;
+t_stat r = SCPE_OK;
+
+if (type == sim_eventq_type)
+    return SCPE_OK;
+UPDATE_SIM_TIME;
+units = _sim_eventq_units (&count);
+times = (int32 *)calloc (count + 1, sizeof (*times));
+if ((units == NULL) || (times == NULL)) {
+    free (units);
+    free (times);
+    return SCPE_MEM;
+    }
+for (i = 0; i < count; i++)
+    times[i] = _sim_activate_queue_time (units[i]) - 1;
+for (i = 0; i < count; i++) {
+    units[i]->next = NULL;
+    units[i]->time = 0;
+    units[i]->q_slot = 0;
+    }
+sim_clock_queue = QUEUE_LIST_END;
+sim_eventq_count = 0;
+sim_eventq_bias = 0.0;
+sim_interval = noqueue_time = NOQUEUE_WAIT;
+sim_eventq_type = type;
+for (i = 0; (i < count) && (r == SCPE_OK); i++)
+    r = _sim_eventq_insert (units[i], times[i]);
+free (units);
+free (times);
+return r;
+}
+
+/* Set/Show event queue implementation */
+
+t_stat sim_set_queue (int32 flag, CONST char *cptr)
+{
+char gbuf[CBUFSIZE];
+int32 type;
+
+if ((cptr == NULL) || (*cptr == 0))
+    return SCPE_2FARG;
+cptr = get_glyph (cptr, gbuf, 0);
+if (*cptr != 0)
+    return SCPE_2MARG;
+for (type = EVENTQ_LIST; type <= EVENTQ_HEAP; type++)
+    if (MATCH_CMD (gbuf, eventq_types[type]) == 0)
+        return _sim_eventq_set_type (type);
+return sim_messagef (SCPE_ARG, "Unknown event queue implementation: %s\n", gbuf);
+}
 
-   sim_process_event - process event
+t_stat sim_show_queue_type (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+{
+fprintf (st, "Event queue implementation: %s, %d entr%s", eventq_types[sim_eventq_type], sim_qcount (), (sim_qcount () == 1) ? "y" : "ies");
+if (sim_eventq_type == EVENTQ_HEAP)
+    fprintf (st, ", heap capacity %u", sim_eventq_size);
+fprintf (st, "\n");
+return SCPE_OK;
+}
+
+/* sim_process_event - process event
 
    Inputs:
         none
@@ -12759,28 +15614,97 @@ return buf;
                         or 0 (SCPE_OK) if no exceptions
 */
 
-t_stat sim_process_event (void)
+static t_stat _sim_dispatch_event (UNIT *uptr)
 {
-UNIT *uptr;
 t_stat reason, bare_reason;
-int32 sim_interval_catchup;
 
-if (stop_cpu) {                                         /* stop CPU? */
-    stop_cpu = 0;
-    return SCPE_STOP;
+if (uptr->usecs_remaining) {
+    sim_debug (SIM_DBG_EVENT, &sim_scp_dev, "Requeueing %s after %.0f usecs\n", sim_uname (uptr), uptr->usecs_remaining);
+    reason = sim_timer_activate_after (uptr, uptr->usecs_remaining);
     }
-AIO_UPDATE_QUEUE;
-UPDATE_SIM_TIME;                                        /* update sim time */
-if (sim_interval > 0) {
-    sim_debug (SIM_DBG_EVENT, &sim_scp_dev, "Interval not yet expired: %d\n", sim_interval);
-    return SCPE_OK;
+else {
+    sim_debug (SIM_DBG_EVENT, &sim_scp_dev, "Processing Event for %s\n", sim_uname (uptr));
+    ++sim_processed_event_count;
+    if (sim_perf_enabled)
+        _sim_perf_event (uptr);
+    if (uptr->action != NULL)
+        reason = uptr->action (uptr);
+    else
+        reason = SCPE_OK;
+    }
+bare_reason = SCPE_BARE_STATUS (reason);
+if ((bare_reason != SCPE_OK)      && /* Provide context for unexpected errors */
+    (bare_reason >= SCPE_BASE)    &&
+    (bare_reason != SCPE_EXPECT)  &&
+    (bare_reason != SCPE_REMOTE)  &&
+    (bare_reason != SCPE_MTRLNT)  &&
+    (bare_reason != SCPE_STOP)    &&
+    (bare_reason != SCPE_STEP)    &&
+    (bare_reason != SCPE_RUNTIME) &&
+    (bare_reason != SCPE_EXIT)) {
+    if (bare_reason == SCPE_UNATT)
+        sim_messagef (reason, "\nUnexpected I/O error while processing event for %s - %s\n", sim_uname (uptr), sim_error_text (reason));
+    else
+        sim_messagef (reason, "\nUnexpected internal error while processing event for %s which returned %d - %s\n", sim_uname (uptr), reason, sim_error_text (reason));
     }
-if (sim_clock_queue == QUEUE_LIST_END) {                /* queue empty? */
-    sim_interval = noqueue_time = NOQUEUE_WAIT;         /* flag queue empty */
-    sim_debug (SIM_DBG_EVENT, &sim_scp_dev, "Queue Empty New Interval = %d\n", sim_interval);
-    return SCPE_OK;
+return reason;
+}
+
+/* Heap event processing.  This follows _sim_process_list_events step by
+   step so that events are dispatched at exactly the same times, including
+   when sim_interval was overrun.  In the list, advancing sim_time to the
+   next event while catching up and then stopping leaves the next event's
+   relative time unchanged, which moves every pending event later by that
+   amount; the heap does the same by adjusting sim_eventq_bias. */
+
+static t_stat _sim_process_heap_events (void)
+{
+UNIT *uptr;
+t_stat reason;
+int32 sim_interval_catchup;
+int32 advance;
+
+if (sim_interval < 0) {
+    sim_interval_catchup = sim_interval;
+    sim_interval = 0;
+    UPDATE_SIM_TIME;                          /* update sim time */
+    sim_debug (SIM_DBG_EVENT_NEG, &sim_scp_dev, "Processing event for %s with sim_interval = %d, event time = %.0f\n",
+        sim_uname (sim_clock_queue), sim_interval_catchup, sim_gtime ());
     }
-sim_processing_event = TRUE;
+else
+    sim_interval_catchup = 0;
+do {
+    uptr = sim_eventq_heap[0].uptr;                     /* get first */
+    _eventq_heap_remove (uptr);                         /* remove first */
+    uptr->time = 0;
+    _eventq_heap_sync ();                               /* next relative to now */
+    reason = _sim_dispatch_event (uptr);
+    advance = 0;
+    if ((sim_interval_catchup < -1) &&
+        (sim_clock_queue != QUEUE_LIST_END)) {
+        advance = sim_clock_queue->time;
+        sim_interval_catchup += advance;
+        sim_time += advance;
+        sim_rtime += advance;
+        }
+    else
+        sim_interval_catchup = 0;
+    } while ((reason == SCPE_OK) &&
+             ((sim_interval + sim_interval_catchup) <= 0) &&
+             (sim_clock_queue != QUEUE_LIST_END) &&
+             (!stop_cpu));
+sim_eventq_bias += advance;                             /* queue stays relative */
+return reason;
+}
+
+/* List event processing */
+
+static t_stat _sim_process_list_events (void)
+{
+UNIT *uptr;
+t_stat reason;
+int32 sim_interval_catchup;
+
 /* If sim_interval is negative, we've missed the opportunity to  */
 /* dispatch one or more events when they were scheduled to fire. */
 /* To accomodate this, we backup time to when the first event    */
@@ -12812,44 +15736,46 @@ do {
         }
     else
         sim_interval = noqueue_time = NOQUEUE_WAIT;
-    if (uptr->usecs_remaining) {
-        sim_debug (SIM_DBG_EVENT, &sim_scp_dev, "Requeueing %s after %.0f usecs\n", sim_uname (uptr), uptr->usecs_remaining);
-        reason = sim_timer_activate_after (uptr, uptr->usecs_remaining);
-        }
-    else {
-        sim_debug (SIM_DBG_EVENT, &sim_scp_dev, "Processing Event for %s\n", sim_uname (uptr));
-        ++sim_processed_event_count;
-        if (uptr->action != NULL)
-            reason = uptr->action (uptr);
-        else
-            reason = SCPE_OK;
-        }
-    if (sim_interval_catchup < -1) {
+    reason = _sim_dispatch_event (uptr);
+    if ((sim_interval_catchup < -1) &&
+        (sim_clock_queue != QUEUE_LIST_END)) {
         sim_interval_catchup += sim_clock_queue->time;
         sim_time += sim_clock_queue->time;
         sim_rtime += sim_clock_queue->time;
         }
     else
         sim_interval_catchup = 0;
-    bare_reason = SCPE_BARE_STATUS (reason);
-    if ((bare_reason != SCPE_OK)      && /* Provide context for unexpected errors */
-        (bare_reason >= SCPE_BASE)    &&
-        (bare_reason != SCPE_EXPECT)  &&
-        (bare_reason != SCPE_REMOTE)  &&
-        (bare_reason != SCPE_MTRLNT)  &&
-        (bare_reason != SCPE_STOP)    &&
-        (bare_reason != SCPE_STEP)    &&
-        (bare_reason != SCPE_RUNTIME) &&
-        (bare_reason != SCPE_EXIT)) {
-        if (bare_reason == SCPE_UNATT)
-            sim_messagef (reason, "\nUnexpected I/O error while processing event for %s - %s\n", sim_uname (uptr), sim_error_text (reason));
-        else
-            sim_messagef (reason, "\nUnexpected internal error while processing event for %s which returned %d - %s\n", sim_uname (uptr), reason, sim_error_text (reason));
-        }
     } while ((reason == SCPE_OK) &&
              ((sim_interval + sim_interval_catchup) <= 0) &&
              (sim_clock_queue != QUEUE_LIST_END) &&
              (!stop_cpu));
+return reason;
+}
+
+t_stat sim_process_event (void)
+{
+t_stat reason;
+
+if (stop_cpu) {                                         /* stop CPU? */
+    stop_cpu = 0;
+    return SCPE_STOP;
+    }
+AIO_UPDATE_QUEUE;
+UPDATE_SIM_TIME;                                        /* update sim time */
+if (sim_interval > 0) {
+    sim_debug (SIM_DBG_EVENT, &sim_scp_dev, "Interval not yet expired: %d\n", sim_interval);
+    return SCPE_OK;
+    }
+if (sim_clock_queue == QUEUE_LIST_END) {                /* queue empty? */
+    sim_interval = noqueue_time = NOQUEUE_WAIT;         /* flag queue empty */
+    sim_debug (SIM_DBG_EVENT, &sim_scp_dev, "Queue Empty New Interval = %d\n", sim_interval);
+    return SCPE_OK;
+    }
+sim_processing_event = TRUE;
+if (sim_eventq_type == EVENTQ_HEAP)
+    reason = _sim_process_heap_events ();
+else
+    reason = _sim_process_list_events ();
 
 if (sim_clock_queue == QUEUE_LIST_END) {                /* queue empty? */
     sim_interval = noqueue_time = NOQUEUE_WAIT;         /* flag queue empty */
@@ -12884,9 +15810,6 @@ return _sim_activate (uptr, event_time);
 
 t_stat _sim_activate (UNIT *uptr, int32 event_time)
 {
-UNIT *cptr, *prvptr;
-int32 accum;
-
 AIO_ACTIVATE (_sim_activate, uptr, event_time);
 if (sim_is_active (uptr))                               /* already active? */
     return SCPE_OK;
@@ -12894,6 +15817,35 @@ UPDATE_SIM_TIME;                                        /* update sim time */
 
 sim_debug (SIM_DBG_ACTIVATE, &sim_scp_dev, "Activating %s delay=%d\n", sim_uname (uptr), event_time);
 
+return _sim_eventq_insert (uptr, event_time);
+}
+
+/* _sim_eventq_insert - insert an inactive unit into the event queue
+
+   sim_time must be current (UPDATE_SIM_TIME) when this is called.
+*/
+
+static t_stat _sim_eventq_insert (UNIT *uptr, int32 event_time)
+{
+UNIT *cptr, *prvptr;
+int32 accum;
+
+if (sim_eventq_type == EVENTQ_HEAP) {
+    double due = sim_time + event_time - sim_eventq_bias;
+    t_int64 seq = ++sim_eventq_seq;
+    t_stat r;
+
+    if (event_time == -1) {                             /* run immediately? */
+        due = sim_time - sim_eventq_bias;               /* ahead of everything */
+        if ((sim_eventq_count > 0) && (sim_eventq_heap[0].due < due))
+            due = sim_eventq_heap[0].due;
+        seq = -seq;
+        }
+    r = _eventq_heap_insert (uptr, due, seq);
+    uptr->time = 0;
+    _eventq_heap_sync ();
+    return r;
+    }
 /* event_time being -1 is a special case which specifically pushes the */
 /* specified unit at the head of the event queue to run immediately */
 if (event_time == -1) {
@@ -13028,6 +15980,10 @@ if ((uptr->cancel) && uptr->cancel (uptr))
     return SCPE_OK;
 if (uptr->dynflags & UNIT_TMR_UNIT)
     sim_timer_cancel (uptr);
+#if defined (SIM_ASYNCH_IO)
+if (uptr->a_next)                                       /* completion possibly held? */
+    sim_aio_coalesce_flush (uptr);
+#endif
 AIO_UPDATE_QUEUE;
 if (sim_clock_queue == QUEUE_LIST_END)
     return SCPE_OK;
@@ -13035,6 +15991,15 @@ if (!sim_is_active (uptr))
     return SCPE_OK;
 UPDATE_SIM_TIME;                                        /* update sim time */
 sim_debug (SIM_DBG_EVENT, &sim_scp_dev, "Canceling Event for %s\n", sim_uname(uptr));
+if (sim_eventq_type == EVENTQ_HEAP) {
+    if (_eventq_heap_member (uptr)) {
+        _eventq_heap_remove (uptr);
+        uptr->time = 0;
+        }
+    uptr->usecs_remaining = 0;
+    _eventq_heap_sync ();
+    return SCPE_OK;
+    }
 nptr = QUEUE_LIST_END;
 
 if (sim_clock_queue == uptr) {
@@ -13095,6 +16060,12 @@ int32 _sim_activate_queue_time (UNIT *uptr)
 UNIT *cptr;
 int32 accum;
 
+if (sim_eventq_type == EVENTQ_HEAP) {
+    if (!_eventq_heap_member (uptr))
+        return 0;
+    accum = (sim_interval > 0) ? sim_interval : 0;
+    return accum + (int32)(sim_eventq_heap[uptr->q_slot].due - sim_eventq_heap[0].due) + 1;
+    }
 accum = 0;
 for (cptr = sim_clock_queue; cptr != QUEUE_LIST_END; cptr = cptr->next) {
     if (cptr == sim_clock_queue) {
@@ -13131,7 +16102,6 @@ return _sim_activate_time (uptr);
 
 double sim_activate_time_usecs (UNIT *uptr)
 {
-UNIT *cptr;
 int32 accum;
 double result;
 
@@ -13139,17 +16109,9 @@ AIO_VALIDATE(uptr);
 result = sim_timer_activate_time_usecs (uptr);
 if (result >= 0)
     return result;
-accum = 0;
-for (cptr = sim_clock_queue; cptr != QUEUE_LIST_END; cptr = cptr->next) {
-    if (cptr == sim_clock_queue) {
-        if (sim_interval > 0)
-            accum = accum + sim_interval;
-        }
-    else
-        accum = accum + cptr->time;
-    if (cptr == uptr)
-        return 1.0 + uptr->usecs_remaining + ((1000000.0 * accum) / sim_timer_inst_per_sec ());
-    }
+accum = _sim_activate_queue_time (uptr);
+if (accum)
+    return 1.0 + uptr->usecs_remaining + ((1000000.0 * (accum - 1)) / sim_timer_inst_per_sec ());
 return 0.0;
 }
 
@@ -13178,10 +16140,21 @@ return sim_rtime;
 void sim_reset_time (void)
 {
 sim_interval = 0;
-sim_time = sim_rtime = 0;
+_sim_set_time (0);
+sim_rtime = 0;
 noqueue_time = 0;
 }
 
+/* Change sim_time other than by the passage of time.  List entries are
+   relative, so pending events remain due the same interval from now;
+   heap entries are moved to match. */
+
+static void _sim_set_time (double new_time)
+{
+sim_eventq_bias += new_time - sim_time;
+sim_time = new_time;
+}
+
 /* sim_qcount - return queue entry count
 
    Inputs: none
@@ -13194,6 +16167,8 @@ int32 sim_qcount (void)
 int32 cnt;
 UNIT *uptr;
 
+if (sim_eventq_type == EVENTQ_HEAP)
+    return (int32)sim_eventq_count;
 cnt = 0;
 for (uptr = sim_clock_queue; uptr != QUEUE_LIST_END; uptr = uptr->next)
     cnt++;
@@ -13257,12 +16232,22 @@ sim_brk_tab = (BRKTAB **) realloc (sim_brk_tab, sim_brk_lnt*sizeof (BRKTAB*));
 if (sim_brk_tab == NULL)
     return SCPE_MEM;
 memset (sim_brk_tab, 0, sim_brk_lnt*sizeof (BRKTAB*));
+memset (sim_brk_filter, 0, sizeof (sim_brk_filter));
 sim_brk_ent = sim_brk_ins = 0;
 sim_brk_clract ();
 sim_brk_npc (0);
 return SCPE_OK;
 }
 
+/* Record a breakpoint address in the address filter */
+
+static void sim_brk_filter_add (t_addr loc)
+{
+uint32 hash = SIM_BRK_FILTER_HASH (loc);
+
+sim_brk_filter[hash >> 5] |= (1u << (hash & 0x1F));
+}
+
 /* Search for a breakpoint in the sorted breakpoint table */
 
 BRKTAB *sim_brk_fnd (t_addr loc)
@@ -13345,6 +16330,7 @@ bp->addr = loc;
 bp->typ = btyp;
 bp->cnt = 0;
 bp->act = NULL;
+sim_brk_filter_add (loc);
 for (i = 0; i < SIM_BKPT_N_SPC; i++)
     bp->time_fired[i] = -1.0;
 return bp;
@@ -13427,8 +16413,10 @@ if (sim_brk_tab[sim_brk_ins] == NULL) {                 /* erased entry */
         sim_brk_tab[i] = sim_brk_tab[i+1];
     }
 sim_brk_summ = 0;                                       /* recalc summary */
+memset (sim_brk_filter, 0, sizeof (sim_brk_filter));    /* and address filter */
 for (i = 0; i < sim_brk_ent; i++) {
     bp = sim_brk_tab[i];
+    sim_brk_filter_add (bp->addr);
     while (bp) {
         sim_brk_summ |= (bp->typ & ~BRK_TYP_TEMP);
         bp = bp->next;
@@ -13573,6 +16561,8 @@ uint32 sim_brk_test (t_addr loc, uint32 btyp)
 BRKTAB *bp;
 uint32 spc = (btyp >> SIM_BKPT_V_SPC) & (SIM_BKPT_N_SPC - 1);
 
+if (!sim_brk_maybe (loc))                               /* no breakpoint here? */
+    return 0;
 if (sim_brk_summ & BRK_TYP_DYN_ALL)
     btyp |= BRK_TYP_DYN_ALL;
 
@@ -13914,6 +16904,7 @@ free (ep->match_pattern);                               /* deallocate the displa
 free (ep->act);                                         /* deallocate action */
 if (ep->switches & EXP_TYP_REGEX)
     pcre_free (ep->regex);                              /* release compiled regex */
+exp->ac_valid = FALSE;                                  /* matcher must be rebuilt */
 exp->size -= 1;                                         /* decrement count */
 for (i=ep-exp->rules; i<exp->size; i++)                 /* shuffle up remaining rules */
     exp->rules[i] = exp->rules[i+1];
@@ -13955,6 +16946,23 @@ free (exp->buf);
 exp->buf = NULL;
 exp->buf_size = 0;
 exp->buf_data = exp->buf_ins = 0;
+free (exp->ac_class);
+exp->ac_class = NULL;
+free (exp->ac_next);
+exp->ac_next = NULL;
+free (exp->ac_rule);
+exp->ac_rule = NULL;
+exp->ac_classes = exp->ac_states = exp->ac_state = 0;
+exp->ac_valid = FALSE;
+free (exp->re_rules);
+exp->re_rules = NULL;
+exp->re_count = 0;
+free (exp->rbuf);
+exp->rbuf = NULL;
+exp->rbuf_size = exp->rbuf_ins = 0;
+free (exp->ovector);
+exp->ovector = NULL;
+exp->ovector_size = 0;
 return SCPE_OK;
 }
 
@@ -14066,897 +17074,1905 @@ if ((act != NULL) && (*act != 0)) {                     /* new action? */
     strcpy (newp, act);                                 /* copy action */
     ep->act = newp;                                     /* set pointer */
     }
-/* Make sure that the production buffer is large enough to detect a match for all rules including a NUL termination byte */
+exp->ac_valid = FALSE;                                  /* matcher must be rebuilt */
+/* Make sure that the production buffers are large enough to detect a match for all rules */
 for (i=0; i<exp->size; i++) {
-    uint32 compare_size = (exp->rules[i].switches & EXP_TYP_REGEX) ? MAX(10 * strlen(ep->match_pattern), 1024) : exp->rules[i].size;
+    uint32 compare_size = (exp->rules[i].switches & EXP_TYP_REGEX) ? MAX(10 * strlen(exp->rules[i].match_pattern), 1024) : exp->rules[i].size;
     if (compare_size >= exp->buf_size) {
-        exp->buf = (uint8 *)realloc (exp->buf, compare_size + 2); /* Extra byte to null terminate regex compares */
+        uint8 *buf = (uint8 *)calloc (compare_size + 2, 1);
+        uint32 j;
+
+        if (buf == NULL)
+            return SCPE_MEM;
+        for (j=0; j<exp->buf_data; j++)                 /* preserve unmatched data in arrival order */
+            buf[j] = exp->buf[(exp->buf_ins + exp->buf_size - exp->buf_data + j) % exp->buf_size];
+        free (exp->buf);
+        exp->buf = buf;
+        exp->buf_ins = exp->buf_data;
         exp->buf_size = compare_size + 1;
         }
+    if ((exp->rules[i].switches & EXP_TYP_REGEX) && (compare_size > exp->rbuf_size)) {
+        char *rbuf = (char *)realloc (exp->rbuf, compare_size);
+
+        if (rbuf == NULL)
+            return SCPE_MEM;
+        exp->rbuf = rbuf;
+        exp->rbuf_size = compare_size;
+        }
+    }
+return SCPE_OK;
+}
+
+/* Show an expect rule */
+
+t_stat sim_exp_show_tab (FILE *st, const EXPECT *exp, const EXPTAB *ep)
+{
+const char *dev_name = tmxr_expect_line_name (exp);
+uint32 default_haltafter = get_default_env_parameter (dev_name, "SIM_EXPECT_HALTAFTER", 0);
+
+if (!ep)
+    return SCPE_OK;
+fprintf (st, "    EXPECT");
+if (ep->switches & EXP_TYP_PERSIST)
+    fprintf (st, " -p");
+if (ep->switches & EXP_TYP_CLEARALL)
+    fprintf (st, " -c");
+if (ep->switches & EXP_TYP_REGEX)
+    fprintf (st, " -r");
+if (ep->switches & EXP_TYP_REGEX_I)
+    fprintf (st, " -i");
+if (ep->after != default_haltafter)
+    fprintf (st, " HALTAFTER=%d", (int)ep->after);
+fprintf (st, " %s", ep->match_pattern);
+if (ep->cnt > 0)
+    fprintf (st, " [%d]", ep->cnt);
+if (ep->act)
+    fprintf (st, " %s", ep->act);
+fprintf (st, "\n");
+return SCPE_OK;
+}
+
+t_stat sim_exp_show (FILE *st, CONST EXPECT *exp, const char *match)
+{
+CONST EXPTAB *ep = (CONST EXPTAB *)sim_exp_fnd (exp, match, 0);
+const char *dev_name = tmxr_expect_line_name (exp);
+uint32 default_haltafter = get_default_env_parameter (dev_name, "SIM_EXPECT_HALTAFTER", 0);
+
+if (exp->buf_size) {
+    char *bstr = sim_encode_quoted_string (exp->buf, exp->buf_ins);
+
+    fprintf (st, "  Match Buffer Size: %d\n", exp->buf_size);
+    fprintf (st, "  Buffer Insert Offset: %d\n", exp->buf_ins);
+    fprintf (st, "  Buffer Contents: %s\n", bstr);
+    if (default_haltafter)
+        fprintf (st, "  Default HaltAfter: %u %s\n", (unsigned)default_haltafter, sim_vm_interval_units);
+    free (bstr);
+    }
+if (exp->dptr && (exp->dbit & exp->dptr->dctrl))
+    fprintf (st, "  Expect Debugging via: SET %s DEBUG%s%s\n", sim_dname(exp->dptr), exp->dptr->debflags ? "=" : "", exp->dptr->debflags ? _get_dbg_verb (exp->dbit, exp->dptr, NULL) : "");
+fprintf (st, "  Match Rules:\n");
+if (!*match)
+    return sim_exp_showall (st, exp);
+if (!ep) {
+    fprintf (st, "  No Rules match '%s'\n", match);
+    return SCPE_ARG;
+    }
+do {
+    sim_exp_show_tab (st, exp, ep);
+    ep = (CONST EXPTAB *)sim_exp_fnd (exp, match, 1 + (ep - exp->rules));
+    } while (ep);
+return SCPE_OK;
+}
+
+/* Show all expect rules */
+
+t_stat sim_exp_showall (FILE *st, const EXPECT *exp)
+{
+int32 i;
+
+for (i=0; i < exp->size; i++)
+    sim_exp_show_tab (st, exp, &exp->rules[i]);
+return SCPE_OK;
+}
+
+/* Build the matcher for the current expect rules.
+
+   Literal match strings are compiled into a single Aho-Corasick automaton
+   whose transition table is fully resolved, so each output byte costs one
+   table lookup regardless of the number or size of the literal rules.  The
+   table has a column for each distinct byte value used by the literal rules
+   plus one shared by all other byte values (which always lead back to the
+   initial state), so a state costs a few hundred bytes rather than 1KB for
+   typical rule sets.  Each
+   automaton state records the lowest numbered rule whose match string ends
+   there, which preserves the rule order precedence of the original
+   rule-by-rule comparison.  Regular expression rules are collected so that
+   they can be evaluated incrementally as data arrives. */
+
+static t_stat _sim_exp_compile (EXPECT *exp)
+{
+uint32 total = 1, states = 1, classes = 1;
+uint32 head = 0, tail = 0;
+uint32 *fail, *queue;
+uint32 s, c, j, start;
+int32 i;
+int ovector_size = 0;
+
+free (exp->ac_next);
+free (exp->ac_rule);
+free (exp->re_rules);
+exp->re_count = 0;
+exp->ac_classes = exp->ac_states = exp->ac_state = 0;
+if (exp->ac_class == NULL)
+    exp->ac_class = (uint16 *)malloc (256 * sizeof (*exp->ac_class));
+if (exp->ac_class)
+    memset (exp->ac_class, 0, 256 * sizeof (*exp->ac_class));
+for (i=0; i<exp->size; i++)
+    if (!(exp->rules[i].switches & EXP_TYP_REGEX)) {
+        total += exp->rules[i].size;
+        for (j=0; (exp->ac_class != NULL) && (j<exp->rules[i].size); j++)
+            exp->ac_class[exp->rules[i].match[j]] = 1;  /* byte value used by a literal */
+        }
+for (c=0; (exp->ac_class != NULL) && (c<256); c++)      /* number the used byte values */
+    if (exp->ac_class[c])
+        exp->ac_class[c] = (uint16)classes++;
+exp->ac_next = (uint32 *)calloc (total * classes, sizeof (*exp->ac_next));
+exp->ac_rule = (int32 *)malloc (total * sizeof (*exp->ac_rule));
+exp->re_rules = (int32 *)malloc (exp->size * sizeof (*exp->re_rules));
+fail = (uint32 *)calloc (total, sizeof (*fail));
+queue = (uint32 *)malloc (total * sizeof (*queue));
+if ((!exp->ac_class) || (!exp->ac_next) || (!exp->ac_rule) || (!exp->re_rules) || (!fail) || (!queue)) {
+    free (exp->ac_class);
+    exp->ac_class = NULL;
+    free (exp->ac_next);
+    exp->ac_next = NULL;
+    free (exp->ac_rule);
+    exp->ac_rule = NULL;
+    free (exp->re_rules);
+    exp->re_rules = NULL;
+    free (fail);
+    free (queue);
+    return SCPE_MEM;
+    }
+exp->ac_rule[0] = -1;
+for (i=0; i<exp->size; i++) {                           /* build the trie in rule order */
+    EXPTAB *ep = &exp->rules[i];
+
+    if (ep->switches & EXP_TYP_REGEX) {
+        exp->re_rules[exp->re_count++] = i;
+        ovector_size = MAX(ovector_size, 3 * (ep->re_nsub + 1));
+        continue;
+        }
+    for (s=j=0; j<ep->size; j++) {
+        uint32 *next = &exp->ac_next[s * classes + exp->ac_class[ep->match[j]]];
+
+        if (*next == 0) {                               /* new state? */
+            exp->ac_rule[states] = -1;
+            *next = states++;
+            }
+        s = *next;
+        }
+    if (exp->ac_rule[s] < 0)                            /* earlier identical rule wins */
+        exp->ac_rule[s] = i;
+    }
+for (c=0; c<classes; c++)                               /* depth 1 states fail to the root */
+    if (exp->ac_next[c])
+        queue[tail++] = exp->ac_next[c];
+while (head < tail) {                                   /* breadth first over remaining states */
+    int32 frule;
+
+    s = queue[head++];
+    frule = exp->ac_rule[fail[s]];                      /* matches ending at the failure state also end here */
+    if ((frule >= 0) && ((exp->ac_rule[s] < 0) || (frule < exp->ac_rule[s])))
+        exp->ac_rule[s] = frule;
+    for (c=0; c<classes; c++) {
+        uint32 *next = &exp->ac_next[s * classes + c];
+
+        if (*next) {
+            fail[*next] = exp->ac_next[fail[s] * classes + c];
+            queue[tail++] = *next;
+            }
+        else
+            *next = exp->ac_next[fail[s] * classes + c];
+        }
+    }
+free (fail);
+free (queue);
+if (states < total) {                                   /* release unused states */
+    uint32 *next = (uint32 *)realloc (exp->ac_next, states * classes * sizeof (*next));
+    int32 *rule = (int32 *)realloc (exp->ac_rule, states * sizeof (*rule));
+
+    if (next)                                           /* otherwise keep the larger table */
+        exp->ac_next = next;
+    if (rule)
+        exp->ac_rule = rule;
+    }
+exp->ac_classes = classes;
+exp->ac_states = states;
+if (ovector_size > exp->ovector_size) {
+    int *ovector = (int *)realloc (exp->ovector, ovector_size * sizeof (*ovector));
+
+    if (ovector == NULL)
+        return SCPE_MEM;
+    exp->ovector = ovector;
+    exp->ovector_size = ovector_size;
+    }
+/* Resynchronize the automaton with the data which hasn't matched yet */
+start = exp->buf_ins + exp->buf_size - exp->buf_data;
+for (j=0; j<exp->buf_data; j++)
+    exp->ac_state = exp->ac_next[exp->ac_state * classes + exp->ac_class[exp->buf[(start + j) % exp->buf_size]]];
+exp->ac_valid = TRUE;
+sim_debug (exp->dbit, exp->dptr, "Expect matcher built: %d automaton states, %d input classes for %d literal rules, %d RegEx rules\n",
+                                 (int)states, (int)classes, (int)(exp->size - exp->re_count), (int)exp->re_count);
+return SCPE_OK;
+}
+
+/* Test for expect match
+
+   Literal rules advance the automaton by one transition per byte.  Regular
+   expression rules are matched against a NUL free copy of the output data
+   using partial matching, and each rule remembers the earliest offset where
+   a match could still begin, so that subsequent checks only examine data
+   which could still take part in a match. */
+
+t_stat sim_exp_check (EXPECT *exp, uint8 data)
+{
+int32 i, j;
+int32 match;
+int rc = 0;
+EXPTAB *ep = NULL;
+static size_t sim_exp_match_sub_count = 0;
+
+if ((!exp) || (!exp->rules))                            /* Anything to check? */
+    return SCPE_OK;
+if ((!exp->ac_valid) && (SCPE_OK != _sim_exp_compile (exp)))
+    return SCPE_MEM;
+
+exp->buf[exp->buf_ins++] = data;                        /* Save new data */
+if (exp->buf_ins == exp->buf_size)                      /* At end of match buffer? */
+    exp->buf_ins = 0;                                   /* wrap around to beginning */
+if (exp->buf_data < exp->buf_size)
+    ++exp->buf_data;                                    /* Record amount of data in buffer */
+
+exp->ac_state = exp->ac_next[exp->ac_state * exp->ac_classes + exp->ac_class[data]];
+match = exp->ac_rule[exp->ac_state];                    /* lowest numbered literal rule which matched */
+
+if (exp->re_count) {
+    if (data != '\0') {                                 /* Nul characters aren't presented to RegEx rules */
+        if (exp->rbuf_ins == exp->rbuf_size) {          /* RegEx buffer full? */
+            uint32 slide = exp->rbuf_size / 2;
+
+            /* Shuffle the buffer contents down by half the buffer size
+               so that the regular expressions continue to have a single
+               contiguous buffer to match against */
+            memmove (exp->rbuf, &exp->rbuf[slide], exp->rbuf_size - slide);
+            exp->rbuf_ins -= slide;
+            for (j=0; j<exp->re_count; j++) {
+                ep = &exp->rules[exp->re_rules[j]];
+                ep->re_start = (ep->re_start > slide) ? ep->re_start - slide : 0;
+                }
+            sim_debug (exp->dbit, exp->dptr, "Buffer Full - sliding the last %d bytes to start of buffer new insert at: %d\n", (int)(exp->rbuf_size - slide), (int)exp->rbuf_ins);
+            }
+        exp->rbuf[exp->rbuf_ins++] = (char)data;
+        }
+    for (j=0; j<exp->re_count; j++) {
+        i = exp->re_rules[j];
+        if ((match >= 0) && (i > match))                /* Lower numbered literal rule already matched? */
+            break;
+        ep = &exp->rules[i];
+        if (sim_deb && exp->dptr && (exp->dptr->dctrl & exp->dbit)) {
+            char *estr = sim_encode_quoted_string ((uint8 *)&exp->rbuf[ep->re_start], exp->rbuf_ins - ep->re_start);
+            sim_debug (exp->dbit, exp->dptr, "Checking String[%d:%d]: %s\n", (int)ep->re_start, (int)(exp->rbuf_ins - ep->re_start), estr);
+            sim_debug (exp->dbit, exp->dptr, "Against RegEx Match Rule: %s\n", ep->match_pattern);
+            free (estr);
+            }
+        if (!ep->re_nopartial) {
+            rc = pcre_exec (ep->regex, NULL, exp->rbuf, exp->rbuf_ins, ep->re_start, PCRE_NOTBOL|PCRE_PARTIAL_SOFT, exp->ovector, exp->ovector_size);
+            if ((rc == PCRE_ERROR_BADOPTION) || (rc == PCRE_ERROR_BADPARTIAL)) {
+                sim_debug (exp->dbit, exp->dptr, "Partial matching unavailable for RegEx Match Rule: %s\n", ep->match_pattern);
+                ep->re_nopartial = TRUE;                /* Scan all buffered data from now on */
+                }
+            }
+        if (ep->re_nopartial)
+            rc = pcre_exec (ep->regex, NULL, exp->rbuf, exp->rbuf_ins, 0, PCRE_NOTBOL, exp->ovector, exp->ovector_size);
+        if (rc >= 0) {
+            match = i;
+            break;
+            }
+        if (rc == PCRE_ERROR_PARTIAL)                   /* Match could complete with more data? */
+            ep->re_start = (uint32)exp->ovector[0];
+        else
+            ep->re_start = exp->rbuf_ins;               /* Nothing so far can begin a match */
+        }
+    }
+if (match >= 0) {                                       /* Found? */
+    ep = &exp->rules[match];
+    if (ep->switches & EXP_TYP_REGEX) {
+        char *buf = (char *)malloc (1 + exp->rbuf_ins); /* largest buf needed is current expect data + NUL */
+
+        for (j=0; j < rc; j++) {
+            char env_name[32];
+            int end_offs = exp->ovector[2 * j + 1], start_offs = exp->ovector[2 * j];
+
+            sprintf (env_name, "_EXPECT_MATCH_GROUP_%d", (int)j);
+            memcpy (buf, &exp->rbuf[start_offs], end_offs - start_offs);
+            buf[end_offs - start_offs] = '\0';
+            setenv (env_name, buf, 1);          /* Make the match and substrings available as environment variables */
+            sim_debug (exp->dbit, exp->dptr, "%s=%s\n", env_name, buf);
+            }
+        for (; (size_t)j<sim_exp_match_sub_count; j++) {
+            char env_name[32];
+
+            sprintf (env_name, "_EXPECT_MATCH_GROUP_%d", (int)j);
+            unsetenv (env_name);                /* Remove previous extra environment variables */
+            }
+        sim_exp_match_sub_count = ep->re_nsub;
+        free (buf);
+        }
+    sim_debug (exp->dbit, exp->dptr, "Matched expect pattern: %s\n", ep->match_pattern);
+    setenv ("_EXPECT_MATCH_PATTERN", ep->match_pattern, 1);   /* Make the match detail available as an environment variable */
+    if (ep->cnt > 0) {
+        ep->cnt -= 1;
+        sim_debug (exp->dbit, exp->dptr, "Waiting for %d more match%s before stopping\n",
+                                         ep->cnt, (ep->cnt == 1) ? "" : "es");
+        }
+    else {
+        uint32 after = ep->after;
+        int32 switches = ep->switches;
+
+        if (ep->act && *ep->act) {
+            sim_debug (exp->dbit, exp->dptr, "Initiating actions: %s\n", ep->act);
+            }
+        else {
+            sim_debug (exp->dbit, exp->dptr, "No actions specified, stopping...\n");
+            }
+        sim_brk_setact (ep->act);                       /* set up actions */
+        if (ep->switches & EXP_TYP_CLEARALL)            /* Clear-all expect rule? */
+            sim_exp_clrall (exp);                       /* delete all rules */
+        else {
+            if (!(ep->switches & EXP_TYP_PERSIST))      /* One shot expect rule? */
+                sim_exp_clr_tab (exp, ep);              /* delete it */
+            }
+        sim_activate (&sim_expect_unit,                 /* schedule simulation stop when indicated */
+                      (switches & EXP_TYP_TIME) ?
+                            (int32)((sim_timer_inst_per_sec ()*after)/1000000.0) :
+                            after);
+        }
+    /* Matched data is no longer available for future matching */
+    exp->buf_data = exp->buf_ins = 0;
+    exp->rbuf_ins = 0;
+    exp->ac_state = 0;
+    for (i=0; i<exp->size; i++)
+        exp->rules[i].re_start = 0;
+    }
+return SCPE_OK;
+}
+
+/* Queue input data for sending */
+
+t_stat sim_send_input (SEND *snd, uint8 *data, size_t size, uint32 after, uint32 delay)
+{
+if (snd->extoff != 0) {
+    if (snd->insoff-snd->extoff > 0)
+        memmove(snd->buffer, snd->buffer+snd->extoff, snd->insoff-snd->extoff);
+    snd->insoff -= snd->extoff;
+    snd->extoff -= snd->extoff;
+    }
+if (snd->insoff+size > snd->bufsize) {
+    snd->bufsize = snd->insoff+size;
+    snd->buffer = (uint8 *)realloc(snd->buffer, snd->bufsize);
+    }
+memcpy(snd->buffer+snd->insoff, data, size);
+snd->insoff += size;
+snd->delay = (sim_switches & SWMASK ('T')) ? (uint32)((sim_timer_inst_per_sec()*delay)/1000000.0) : delay;
+snd->after = (sim_switches & SWMASK ('T')) ? (uint32)((sim_timer_inst_per_sec()*after)/1000000.0) : after;
+if (sim_switches & SWMASK ('T'))
+    sim_debug (snd->dbit, snd->dptr, "%d bytes queued for input. Delay %d usecs = %d insts, After %d usecs = %d insts\n",
+                                     (int)size, (int)delay, (int)snd->delay, (int)after, (int)snd->after);
+else
+    sim_debug (snd->dbit, snd->dptr, "%d bytes queued for input. Delay=%d, After=%d\n",
+                                     (int)size, (int)delay, (int)after);
+snd->next_time = sim_gtime() + snd->after;
+return SCPE_OK;
+}
+
+/* Cancel Queued input data */
+t_stat sim_send_clear (SEND *snd)
+{
+snd->insoff = 0;
+snd->extoff = 0;
+return SCPE_OK;
+}
+
+/* Display console Queued input data status */
+
+t_stat sim_show_send_input (FILE *st, const SEND *snd)
+{
+const char *dev_name = tmxr_send_line_name (snd);
+uint32 delay = get_default_env_parameter (dev_name, "SIM_SEND_DELAY", SEND_DEFAULT_DELAY);
+uint32 after = get_default_env_parameter (dev_name, "SIM_SEND_AFTER", delay);
+
+fprintf (st, "%s\n", tmxr_send_line_name (snd));
+if (snd->extoff < snd->insoff) {
+    fprintf (st, "  %d bytes of pending input Data:\n    ", snd->insoff-snd->extoff);
+    fprint_buffer_string (st, snd->buffer+snd->extoff, snd->insoff-snd->extoff);
+    fprintf (st, "\n");
+    }
+else
+    fprintf (st, "  No Pending Input Data\n");
+if ((snd->next_time - sim_gtime()) > 0) {
+    if (((snd->next_time - sim_gtime()) > (sim_timer_inst_per_sec()/1000000.0)) && ((sim_timer_inst_per_sec()/1000000.0) > 0.0))
+        fprintf (st, "  Minimum of %d %s (%d microseconds) before sending first character\n", (int)(snd->next_time - sim_gtime()), sim_vm_interval_units,
+                                                        (int)((snd->next_time - sim_gtime())/(sim_timer_inst_per_sec()/1000000.0)));
+    else
+        fprintf (st, "  Minimum of %d %s before sending first character\n", (int)(snd->next_time - sim_gtime()), sim_vm_interval_units);
     }
+if ((snd->delay > (sim_timer_inst_per_sec()/1000000.0)) && ((sim_timer_inst_per_sec()/1000000.0) > 0.0))
+    fprintf (st, "  Minimum of %d %s (%d microseconds) between characters\n", (int)snd->delay, sim_vm_interval_units, (int)(snd->delay/(sim_timer_inst_per_sec()/1000000.0)));
+else
+    fprintf (st, "  Minimum of %d %s between characters\n", (int)snd->delay, sim_vm_interval_units);
+if (after)
+    fprintf (st, "  Default delay before first character input is %u %s\n", after, sim_vm_interval_units);
+if (delay)
+    fprintf (st, "  Default delay between character input is %u %s\n", after, sim_vm_interval_units);
+if (snd->dptr && (snd->dbit & snd->dptr->dctrl))
+    fprintf (st, "  Send Debugging via: SET %s DEBUG%s%s\n", sim_dname(snd->dptr), snd->dptr->debflags ? "=" : "", snd->dptr->debflags ? _get_dbg_verb (snd->dbit, snd->dptr, NULL) : "");
 return SCPE_OK;
 }
 
-/* Show an expect rule */
+/* Poll for Queued input data */
 
-t_stat sim_exp_show_tab (FILE *st, const EXPECT *exp, const EXPTAB *ep)
+t_bool sim_send_poll_data (SEND *snd, t_stat *stat)
 {
-const char *dev_name = tmxr_expect_line_name (exp);
-uint32 default_haltafter = get_default_env_parameter (dev_name, "SIM_EXPECT_HALTAFTER", 0);
+if (snd && (snd->extoff < snd->insoff)) {               /* pending input characters available? */
+    if (sim_gtime() < snd->next_time) {                 /* too soon? */
+        *stat = SCPE_OK;
+        sim_debug (snd->dbit, snd->dptr, "Too soon to inject next byte\n");
+        }
+    else {
+        char dstr[8] = "";
 
-if (!ep)
-    return SCPE_OK;
-fprintf (st, "    EXPECT");
-if (ep->switches & EXP_TYP_PERSIST)
-    fprintf (st, " -p");
-if (ep->switches & EXP_TYP_CLEARALL)
-    fprintf (st, " -c");
-if (ep->switches & EXP_TYP_REGEX)
-    fprintf (st, " -r");
-if (ep->switches & EXP_TYP_REGEX_I)
-    fprintf (st, " -i");
-if (ep->after != default_haltafter)
-    fprintf (st, " HALTAFTER=%d", (int)ep->after);
-fprintf (st, " %s", ep->match_pattern);
-if (ep->cnt > 0)
-    fprintf (st, " [%d]", ep->cnt);
-if (ep->act)
-    fprintf (st, " %s", ep->act);
-fprintf (st, "\n");
-return SCPE_OK;
+        *stat = snd->buffer[snd->extoff++] | SCPE_KFLAG;/* get one */
+        snd->next_time = sim_gtime() + snd->delay;
+        if (sim_isgraph(*stat & 0xFF) || ((*stat & 0xFF) == ' '))
+            sprintf (dstr, " '%c'", *stat & 0xFF);
+        sim_debug (snd->dbit, snd->dptr, "Byte value: 0x%02X%s injected\n", *stat & 0xFF, dstr);
+        }
+    return TRUE;
+    }
+return FALSE;
 }
 
-t_stat sim_exp_show (FILE *st, CONST EXPECT *exp, const char *match)
+
+/* Message Text */
+
+const char *sim_error_text (t_stat stat)
 {
-CONST EXPTAB *ep = (CONST EXPTAB *)sim_exp_fnd (exp, match, 0);
-const char *dev_name = tmxr_expect_line_name (exp);
-uint32 default_haltafter = get_default_env_parameter (dev_name, "SIM_EXPECT_HALTAFTER", 0);
+static char msgbuf[64];
 
-if (exp->buf_size) {
-    char *bstr = sim_encode_quoted_string (exp->buf, exp->buf_ins);
+stat &= ~(SCPE_KFLAG|SCPE_BREAK|SCPE_NOMESSAGE);        /* remove any flags */
+if (stat == SCPE_OK)
+    return "No Error";
+if ((stat >= SCPE_BASE) && (stat <= SCPE_MAX_ERR))
+    return scp_errors[stat-SCPE_BASE].message;
+sprintf(msgbuf, "Error %d", stat);
+return msgbuf;
+}
 
-    fprintf (st, "  Match Buffer Size: %d\n", exp->buf_size);
-    fprintf (st, "  Buffer Insert Offset: %d\n", exp->buf_ins);
-    fprintf (st, "  Buffer Contents: %s\n", bstr);
-    if (default_haltafter)
-        fprintf (st, "  Default HaltAfter: %u %s\n", (unsigned)default_haltafter, sim_vm_interval_units);
-    free (bstr);
+t_stat sim_string_to_stat (const char *cptr, t_stat *stat)
+{
+char gbuf[CBUFSIZE];
+int32 cond;
+
+*stat = SCPE_ARG;
+cptr = get_glyph (cptr, gbuf, 0);
+if (0 == memcmp("SCPE_", gbuf, 5))
+    memmove (gbuf, gbuf+5, 1 + strlen (gbuf+5));/* skip leading SCPE_ */
+for (cond=0; cond <= (SCPE_MAX_ERR-SCPE_BASE); cond++)
+    if (0 == strcmp(scp_errors[cond].code, gbuf)) {
+        cond += SCPE_BASE;
+        break;
+        }
+if (0 == strcmp(gbuf, "OK"))
+    cond = SCPE_OK;
+if (cond == (1+SCPE_MAX_ERR-SCPE_BASE)) {       /* not found? */
+    if (0 == (cond = strtol(gbuf, NULL, 0)))  /* try explicit number */
+        return SCPE_ARG;
     }
-if (exp->dptr && (exp->dbit & exp->dptr->dctrl))
-    fprintf (st, "  Expect Debugging via: SET %s DEBUG%s%s\n", sim_dname(exp->dptr), exp->dptr->debflags ? "=" : "", exp->dptr->debflags ? _get_dbg_verb (exp->dbit, exp->dptr, NULL) : "");
-fprintf (st, "  Match Rules:\n");
-if (!*match)
-    return sim_exp_showall (st, exp);
-if (!ep) {
-    fprintf (st, "  No Rules match '%s'\n", match);
+*stat = cond;
+if (cond > SCPE_MAX_ERR)
     return SCPE_ARG;
-    }
-do {
-    sim_exp_show_tab (st, exp, ep);
-    ep = (CONST EXPTAB *)sim_exp_fnd (exp, match, 1 + (ep - exp->rules));
-    } while (ep);
 return SCPE_OK;
 }
 
-/* Show all expect rules */
-
-t_stat sim_exp_showall (FILE *st, const EXPECT *exp)
+/* Abort and sanely close output files */
+/* This routine should ONLY be called from SCP modules */
+void _sim_scp_abort (const char *msg, const char *file, int linenum)
 {
-int32 i;
-
-for (i=0; i < exp->size; i++)
-    sim_exp_show_tab (st, exp, &exp->rules[i]);
-return SCPE_OK;
+sim_printf ("%s - aborting from %s:%d\n", msg, file, linenum);
+sim_flush_buffered_files (TRUE);
+if (sim_deb)
+    sim_set_deboff (0, NULL);
+abort ();
 }
 
-/* Test for expect match */
+/* Debug printout routines, from Dave Hittner */
 
-t_stat sim_exp_check (EXPECT *exp, uint8 data)
+const char *debug_bstates = "01_^";
+AIO_TLS char debug_line_prefix[256];
+int32 debug_unterm  = 0;
+char *debug_line_buf_last = NULL;
+size_t debug_line_buf_last_endprefix_offset = 0;
+AIO_TLS char debug_line_last_prefix[256];
+char *debug_line_buf = NULL;
+size_t debug_line_bufsize = 0;
+size_t debug_line_offset = 0;
+size_t debug_line_count = 0;
+
+static void _debug_fwrite_all (const char *buf, size_t len, FILE *f)
 {
-int32 i;
-EXPTAB *ep = NULL;
-int regex_checks = 0;
-char *tstr = NULL;
+size_t len_written;
 
-if ((!exp) || (!exp->rules))                            /* Anything to check? */
-    return SCPE_OK;
+while (len > 0) {
+    errno = 0;
+    len_written = fwrite (buf, 1, len, f);
+    len -= len_written;
+    buf += len_written;
+    if (errno == EAGAIN)    /* Non blocking file descriptor buffer full? */
+        sim_os_ms_sleep(10);/* wait a bit to retry */
+    }
+}
 
-exp->buf[exp->buf_ins++] = data;                        /* Save new data */
-exp->buf[exp->buf_ins] = '\0';                          /* Nul terminate for RegEx match */
-if (exp->buf_data < exp->buf_size)
-    ++exp->buf_data;                                    /* Record amount of data in buffer */
+static void _debug_fwrite (const char *buf, size_t len)
+{
+size_t move_size;
 
-for (i=0; i < exp->size; i++) {
-    ep = &exp->rules[i];
-    if (ep->switches & EXP_TYP_REGEX) {
-        int *ovector = NULL;
-        int rc;
-        char *cbuf = (char *)exp->buf;
-        static size_t sim_exp_match_sub_count = 0;
+if ((sim_deb_buffer == NULL) || (!sim_is_running)) {
+    _debug_fwrite_all (buf, len, sim_deb);  /* output now. */
+    return;
+    }
+if ((sim_deb == stdout) && (!sim_is_running))
+    _debug_fwrite_all (buf, len, stdout);   /* output now. */
+while (len > 0) {
+    if (sim_debug_buffer_offset + len <= sim_deb_buffer_size)
+        move_size = len;
+    else
+        move_size = sim_deb_buffer_size - sim_debug_buffer_offset;
+    memcpy (sim_deb_buffer + sim_debug_buffer_offset, buf, move_size);
+    sim_debug_buffer_offset += move_size;
+    if (sim_debug_buffer_offset == sim_deb_buffer_size) {
+        sim_debug_buffer_offset = 0;
+        sim_debug_buffer_inuse = sim_deb_buffer_size;
+        }
+    if (sim_debug_buffer_inuse < sim_deb_buffer_size)
+        sim_debug_buffer_inuse += move_size;
+    len -= move_size;
+    }
+}
 
-        if (tstr)
-            cbuf = tstr;
-        else {
-            if (strlen ((char *)exp->buf) != exp->buf_ins) { /* Nul characters in buffer? */
-                size_t off;
-
-                tstr = (char *)malloc (exp->buf_ins + 1);
-                tstr[0] = '\0';
-                for (off=0; off < exp->buf_ins; off += 1 + strlen ((char *)&exp->buf[off]))
-                    strcpy (&tstr[strlen (tstr)], (char *)&exp->buf[off]);
-                cbuf = tstr;
-                }
-            }
-        ++regex_checks;
-        ovector = (int *)malloc (3 * (ep->re_nsub + 1) * sizeof (*ovector));
-        if (sim_deb && exp->dptr && (exp->dptr->dctrl & exp->dbit)) {
-            char *estr = sim_encode_quoted_string (exp->buf, exp->buf_ins);
-            sim_debug (exp->dbit, exp->dptr, "Checking String: %s\n", estr);
-            sim_debug (exp->dbit, exp->dptr, "Against RegEx Match Rule: %s\n", ep->match_pattern);
-            free (estr);
-            }
-        rc = pcre_exec (ep->regex, NULL, cbuf, exp->buf_ins, 0, PCRE_NOTBOL, ovector, 3 * (ep->re_nsub + 1));
-        if (rc >= 0) {
-            size_t j;
-            char *buf = (char *)malloc (1 + exp->buf_ins);  /* largest buf needed is current expect data + NUL */
-
-            for (j=0; j < (size_t)rc; j++) {
-                char env_name[32];
-                int end_offs = ovector[2 * j + 1], start_offs = ovector[2 * j];
-
-                sprintf (env_name, "_EXPECT_MATCH_GROUP_%d", (int)j);
-                memcpy (buf, &cbuf[start_offs], end_offs - start_offs);
-                buf[end_offs - start_offs] = '\0';
-                setenv (env_name, buf, 1);      /* Make the match and substrings available as environment variables */
-                sim_debug (exp->dbit, exp->dptr, "%s=%s\n", env_name, buf);
-                }
-            for (; j<sim_exp_match_sub_count; j++) {
-                char env_name[32];
+/*
+ * Optionally filter debug output to summarize duplicate debug lines
+ */
+static void _sim_debug_write_flush (const char *buf, size_t len, t_bool flush)
+{
+char *eol;
 
-                sprintf (env_name, "_EXPECT_MATCH_GROUP_%d", (int)j);
-                unsetenv (env_name);            /* Remove previous extra environment variables */
-                }
-            sim_exp_match_sub_count = ep->re_nsub;
-            free (ovector);
-            ovector = NULL;
-            free (buf);
-            break;
-            }
-        free (ovector);
-        }
-    else {
-        if (exp->buf_data < ep->size)                           /* Too little data to match yet? */
-            continue;                                           /* Yes, Try next one. */
-        if (exp->buf_ins < ep->size) {                          /* Match might straddle end of buffer */
-            /*
-             * First compare the newly deposited data at the beginning
-             * of buffer with the end of the match string
-             */
-            if (exp->buf_ins) {
-                if (sim_deb && exp->dptr && (exp->dptr->dctrl & exp->dbit)) {
-                    char *estr = sim_encode_quoted_string (exp->buf, exp->buf_ins);
-                    char *mstr = sim_encode_quoted_string (&ep->match[ep->size-exp->buf_ins], exp->buf_ins);
-
-                    sim_debug (exp->dbit, exp->dptr, "Checking String[0:%d]: %s\n", exp->buf_ins, estr);
-                    sim_debug (exp->dbit, exp->dptr, "Against Match Data: %s\n", mstr);
-                    free (estr);
-                    free (mstr);
-                    }
-                if (memcmp (exp->buf, &ep->match[ep->size-exp->buf_ins], exp->buf_ins)) /* Tail Match? */
-                    continue;                                   /* Nope, Try next one. */
-                }
-            if (sim_deb && exp->dptr && (exp->dptr->dctrl & exp->dbit)) {
-                char *estr = sim_encode_quoted_string (&exp->buf[exp->buf_size-(ep->size-exp->buf_ins)], ep->size-exp->buf_ins);
-                char *mstr = sim_encode_quoted_string (ep->match, ep->size-exp->buf_ins);
-
-                sim_debug (exp->dbit, exp->dptr, "Checking String[%d:%d]: %s\n", exp->buf_size-(ep->size-exp->buf_ins), ep->size-exp->buf_ins, estr);
-                sim_debug (exp->dbit, exp->dptr, "Against Match Data: %s\n", mstr);
-                free (estr);
-                free (mstr);
-                }
-            if (memcmp (&exp->buf[exp->buf_size-(ep->size-exp->buf_ins)], ep->match, ep->size-exp->buf_ins)) /* Front Match? */
-                continue;                                       /* Nope, Try next one. */
-            break;
-            }
-        else {
-            if (sim_deb && exp->dptr && (exp->dptr->dctrl & exp->dbit)) {
-                char *estr = sim_encode_quoted_string (&exp->buf[exp->buf_ins-ep->size], ep->size);
-                char *mstr = sim_encode_quoted_string (ep->match, ep->size);
-
-                sim_debug (exp->dbit, exp->dptr, "Checking String[%d:%d]: %s\n", exp->buf_ins-ep->size, ep->size, estr);
-                sim_debug (exp->dbit, exp->dptr, "Against Match Data: %s\n", mstr);
-                free (estr);
-                free (mstr);
-                }
-            if (memcmp (&exp->buf[exp->buf_ins-ep->size], ep->match, ep->size)) /* Whole string match? */
-                continue;                                       /* Nope, Try next one. */
-            break;
-            }
-        }
+AIO_LOCK;
+if (sim_deb_switches & SWMASK ('F')) {              /* filtering disabled? */
+    if (len > 0)
+        _debug_fwrite (buf, len);                   /* output now. */
+    AIO_UNLOCK;
+    return;                                         /* done */
     }
-if (exp->buf_ins == exp->buf_size) {                    /* At end of match buffer? */
-    if (regex_checks) {
-        /* When processing regular expressions, let the match buffer fill
-           up and then shuffle the buffer contents down by half the buffer size
-           so that the regular expression has a single contiguous buffer to
-           match against instead of the wrapping buffer paradigm which is
-           used when no regular expression rules are in effect */
-        memmove (exp->buf, &exp->buf[exp->buf_size/2], exp->buf_size-(exp->buf_size/2));
-        exp->buf_ins -= exp->buf_size/2;
-        exp->buf_data = exp->buf_ins;
-        sim_debug (exp->dbit, exp->dptr, "Buffer Full - sliding the last %d bytes to start of buffer new insert at: %d\n", (exp->buf_size/2), exp->buf_ins);
-        }
-    else {
-        exp->buf_ins = 0;                               /* wrap around to beginning */
-        sim_debug (exp->dbit, exp->dptr, "Buffer wrapping\n");
-        }
+if (debug_line_offset + len + 1 > debug_line_bufsize) {
+    debug_line_bufsize += MAX(1024, debug_line_offset + len + 1);
+    debug_line_buf = (char *)realloc (debug_line_buf, debug_line_bufsize);
+    debug_line_buf_last = (char *)realloc (debug_line_buf_last, debug_line_bufsize);
     }
-if (i != exp->size) {                                   /* Found? */
-    sim_debug (exp->dbit, exp->dptr, "Matched expect pattern: %s\n", ep->match_pattern);
-    setenv ("_EXPECT_MATCH_PATTERN", ep->match_pattern, 1);   /* Make the match detail available as an environment variable */
-    if (ep->cnt > 0) {
-        ep->cnt -= 1;
-        sim_debug (exp->dbit, exp->dptr, "Waiting for %d more match%s before stopping\n",
-                                         ep->cnt, (ep->cnt == 1) ? "" : "es");
-        }
-    else {
-        uint32 after = ep->after;
-        int32 switches = ep->switches;
+memcpy (&debug_line_buf[debug_line_offset], buf, len);
+debug_line_buf[debug_line_offset + len] = '\0';
+debug_line_offset += len;
+while ((eol = strchr (debug_line_buf, '\n')) || flush) {
+    char *endprefix = strstr (debug_line_buf, ")> ");
+    size_t linesize = (eol - debug_line_buf) + 1;
+
+    if ((0 != memcmp ("DBG(", debug_line_buf, 4)) || (endprefix == NULL)) {
+        if (debug_line_count > 0)
+            _debug_fwrite (debug_line_buf_last, strlen (debug_line_buf_last));
+        if (debug_line_count > 1) {
+            char countstr[40];
 
-        if (ep->act && *ep->act) {
-            sim_debug (exp->dbit, exp->dptr, "Initiating actions: %s\n", ep->act);
+            sprintf (countstr, "same as above (%d time%s)\r\n", (int)(debug_line_count - 1), ((debug_line_count - 1) != 1) ? "s" : "");
+            _debug_fwrite (debug_line_last_prefix, strlen (debug_line_last_prefix));
+            _debug_fwrite (countstr, strlen (countstr));
             }
-        else {
-            sim_debug (exp->dbit, exp->dptr, "No actions specified, stopping...\n");
+        if (flush) {
+            linesize = debug_line_offset;
+            flush = FALSE;              /* already flushed */
+            }
+        if (linesize)
+            _debug_fwrite  (debug_line_buf, linesize);
+        debug_line_count = 0;
+        }
+    else {
+        linesize = debug_line_offset;
+        if (debug_line_count == 0) {
+            debug_line_buf_last_endprefix_offset = endprefix - debug_line_buf;
+            memcpy (debug_line_buf_last, debug_line_buf, linesize);
+            debug_line_buf_last[linesize] = '\0';
+            debug_line_count = 1;
             }
-        sim_brk_setact (ep->act);                       /* set up actions */
-        if (ep->switches & EXP_TYP_CLEARALL)            /* Clear-all expect rule? */
-            sim_exp_clrall (exp);                       /* delete all rules */
         else {
-            if (!(ep->switches & EXP_TYP_PERSIST))      /* One shot expect rule? */
-                sim_exp_clr_tab (exp, ep);              /* delete it */
+            if (0 == memcmp (&debug_line_buf[endprefix - debug_line_buf],
+                             &debug_line_buf_last[debug_line_buf_last_endprefix_offset],
+                             (eol - endprefix)+ 1)) {
+                ++debug_line_count;
+                memcpy (debug_line_last_prefix, debug_line_buf, (endprefix - debug_line_buf) + 3);
+                debug_line_last_prefix[(endprefix - debug_line_buf) + 3] = '\0';
+                }
+            else {
+                _debug_fwrite (debug_line_buf_last, strlen (debug_line_buf_last));
+                if (debug_line_count > 1) {
+                    char countstr[40];
+
+                    sprintf (countstr, "same as above (%d time%s)\r\n", (int)(debug_line_count - 1), ((debug_line_count - 1) != 1) ? "s" : "");
+                    _debug_fwrite (debug_line_last_prefix, strlen (debug_line_last_prefix));
+                    _debug_fwrite (countstr, strlen (countstr));
+                    }
+                debug_line_buf_last_endprefix_offset = endprefix - debug_line_buf;
+                memcpy (debug_line_buf_last, debug_line_buf, linesize);
+                debug_line_buf_last[linesize] = '\0';
+                debug_line_count = 1;
+                }
             }
-        sim_activate (&sim_expect_unit,                 /* schedule simulation stop when indicated */
-                      (switches & EXP_TYP_TIME) ?
-                            (int32)((sim_timer_inst_per_sec ()*after)/1000000.0) :
-                            after);
         }
-    /* Matched data is no longer available for future matching */
-    exp->buf_data = exp->buf_ins = 0;
+    debug_line_offset -= linesize;
+    if ((debug_line_offset > 0) && (!flush))
+        memmove (debug_line_buf, eol + 1, debug_line_offset);
+    debug_line_buf[debug_line_offset] = '\0';
     }
-free (tstr);
-return SCPE_OK;
+AIO_UNLOCK;
 }
 
-/* Queue input data for sending */
+static void _sim_debug_write (const char *buf, size_t len)
+{
+_sim_debug_write_flush (buf, len, FALSE);
+}
 
-t_stat sim_send_input (SEND *snd, uint8 *data, size_t size, uint32 after, uint32 delay)
+static t_stat _sim_debug_flush (void)
 {
-if (snd->extoff != 0) {
-    if (snd->insoff-snd->extoff > 0)
-        memmove(snd->buffer, snd->buffer+snd->extoff, snd->insoff-snd->extoff);
-    snd->insoff -= snd->extoff;
-    snd->extoff -= snd->extoff;
+int32 saved_quiet = sim_quiet;
+int32 saved_sim_switches = sim_switches;
+int32 saved_deb_switches = sim_deb_switches;
+struct timespec saved_deb_basetime;
+
+if (sim_deb == NULL)                                    /* no debug? */
+    return SCPE_OK;
+
+AIO_LOCK;
+saved_deb_basetime = *sim_rtcn_get_debug_basetime ();
+
+_sim_debug_write_flush ("", 0, TRUE);
+
+if (sim_deb == sim_log) {                               /* debug is log */
+    fflush (sim_deb);                                   /* fflush is the best we can do */
+    AIO_UNLOCK;
+    return SCPE_OK;
     }
-if (snd->insoff+size > snd->bufsize) {
-    snd->bufsize = snd->insoff+size;
-    snd->buffer = (uint8 *)realloc(snd->buffer, snd->bufsize);
+
+if ((saved_deb_switches & SWMASK ('B')) != 0) {
+    char saved_debug_filename[CBUFSIZE];
+
+    snprintf (saved_debug_filename, sizeof (saved_debug_filename), "%u \"%s\"",
+                           (uint32)(sim_deb_buffer_size / (1024 * 1024)), sim_logfile_name (sim_deb, sim_deb_ref));
+    sim_quiet = 1;
+    sim_set_deboff (0, NULL);
+    sim_switches = saved_deb_switches;
+    sim_set_debon (0, saved_debug_filename);
+    sim_rtcn_set_debug_basetime (&saved_deb_basetime);
+    sim_switches = saved_sim_switches;
+    sim_quiet = saved_quiet;
     }
-memcpy(snd->buffer+snd->insoff, data, size);
-snd->insoff += size;
-snd->delay = (sim_switches & SWMASK ('T')) ? (uint32)((sim_timer_inst_per_sec()*delay)/1000000.0) : delay;
-snd->after = (sim_switches & SWMASK ('T')) ? (uint32)((sim_timer_inst_per_sec()*after)/1000000.0) : after;
-if (sim_switches & SWMASK ('T'))
-    sim_debug (snd->dbit, snd->dptr, "%d bytes queued for input. Delay %d usecs = %d insts, After %d usecs = %d insts\n",
-                                     (int)size, (int)delay, (int)snd->delay, (int)after, (int)snd->after);
-else
-    sim_debug (snd->dbit, snd->dptr, "%d bytes queued for input. Delay=%d, After=%d\n",
-                                     (int)size, (int)delay, (int)after);
-snd->next_time = sim_gtime() + snd->after;
+AIO_UNLOCK;
 return SCPE_OK;
 }
 
-/* Cancel Queued input data */
-t_stat sim_send_clear (SEND *snd)
+
+/* Finds debug phrase matching bitmask from from device DEBTAB table */
+
+static const char *_get_dbg_verb (uint32 dbits, DEVICE* dptr, UNIT *uptr)
 {
-snd->insoff = 0;
-snd->extoff = 0;
-return SCPE_OK;
+static const char *debtab_none    = "DEBTAB_ISNULL";
+static const char *debtab_nomatch = "DEBTAB_NOMATCH";
+const char *some_match = NULL;
+int32 offset = 0;
+
+if (dptr->debflags == NULL)
+    return debtab_none;
+
+dbits &= (dptr->dctrl | (uptr ? uptr->dctrl : 0));/* Look for just the bits that matched */
+
+/* Find matching words for bitmask */
+
+while (dptr->debflags[offset].name && (offset < 32)) {
+    if (dptr->debflags[offset].mask == dbits)   /* All Bits Match */
+        return dptr->debflags[offset].name;
+    if (dptr->debflags[offset].mask & dbits)
+        some_match = dptr->debflags[offset].name;
+    offset++;
+    }
+return some_match ? some_match : debtab_nomatch;
 }
 
-/* Display console Queued input data status */
+/* Prints standard debug prefix unless previous call unterminated */
 
-t_stat sim_show_send_input (FILE *st, const SEND *snd)
+static const char *sim_debug_prefix (uint32 dbits, DEVICE* dptr, UNIT* uptr)
 {
-const char *dev_name = tmxr_send_line_name (snd);
-uint32 delay = get_default_env_parameter (dev_name, "SIM_SEND_DELAY", SEND_DEFAULT_DELAY);
-uint32 after = get_default_env_parameter (dev_name, "SIM_SEND_AFTER", delay);
+const char* debug_type = _get_dbg_verb (dbits, dptr, uptr);
+char tim_t[32] = "";
+char tim_a[32] = "";
+char pc_s[MAX_WIDTH + 33] = "";
+struct timespec time_now;
 
-fprintf (st, "%s\n", tmxr_send_line_name (snd));
-if (snd->extoff < snd->insoff) {
-    fprintf (st, "  %d bytes of pending input Data:\n    ", snd->insoff-snd->extoff);
-    fprint_buffer_string (st, snd->buffer+snd->extoff, snd->insoff-snd->extoff);
-    fprintf (st, "\n");
+if (sim_deb_switches & (SWMASK ('T') | SWMASK ('R') | SWMASK ('A'))) {
+    sim_rtcn_debug_time(&time_now);
+    if (sim_deb_switches & SWMASK ('R'))
+        sim_timespec_diff (&time_now, &time_now, sim_rtcn_get_debug_basetime ());
+    if (sim_deb_switches & SWMASK ('T')) {
+        time_t tnow = (time_t)time_now.tv_sec;
+        struct tm *now = localtime(&tnow);
+
+        sprintf(tim_t, "%02d:%02d:%02d.%03d ", now->tm_hour, now->tm_min, now->tm_sec, (int)(time_now.tv_nsec/1000000));
+        }
+    if (sim_deb_switches & SWMASK ('A')) {
+        sprintf(tim_t, "%" LL_FMT "d.%03d ", (LL_TYPE)(time_now.tv_sec), (int)(time_now.tv_nsec/1000000));
+        }
     }
-else
-    fprintf (st, "  No Pending Input Data\n");
-if ((snd->next_time - sim_gtime()) > 0) {
-    if (((snd->next_time - sim_gtime()) > (sim_timer_inst_per_sec()/1000000.0)) && ((sim_timer_inst_per_sec()/1000000.0) > 0.0))
-        fprintf (st, "  Minimum of %d %s (%d microseconds) before sending first character\n", (int)(snd->next_time - sim_gtime()), sim_vm_interval_units,
-                                                        (int)((snd->next_time - sim_gtime())/(sim_timer_inst_per_sec()/1000000.0)));
+if (sim_deb_switches & SWMASK ('P')) {
+    t_value val;
+
+    /* Some simulators expose the PC as a register, some don't expose it or expose a register
+       which is not a variable which is updated during instruction execution (i.e. only upon
+       exit of sim_instr()).  For the -P debug option to be effective, such a simulator should
+       provide a routine which returns the value of the current PC and set the sim_vm_pc_value
+       routine pointer to that routine.
+     */
+    if (sim_vm_pc_value)
+        val = (*sim_vm_pc_value)();
     else
-        fprintf (st, "  Minimum of %d %s before sending first character\n", (int)(snd->next_time - sim_gtime()), sim_vm_interval_units);
+        val = get_rval (sim_PC, 0);
+    sprintf(pc_s, "-%s:", sim_PC->name);
+    sprint_val (&pc_s[strlen(pc_s)], val, sim_PC->radix, sim_PC->width, sim_PC->flags & REG_FMT);
     }
-if ((snd->delay > (sim_timer_inst_per_sec()/1000000.0)) && ((sim_timer_inst_per_sec()/1000000.0) > 0.0))
-    fprintf (st, "  Minimum of %d %s (%d microseconds) between characters\n", (int)snd->delay, sim_vm_interval_units, (int)(snd->delay/(sim_timer_inst_per_sec()/1000000.0)));
-else
-    fprintf (st, "  Minimum of %d %s between characters\n", (int)snd->delay, sim_vm_interval_units);
-if (after)
-    fprintf (st, "  Default delay before first character input is %u %s\n", after, sim_vm_interval_units);
-if (delay)
-    fprintf (st, "  Default delay between character input is %u %s\n", after, sim_vm_interval_units);
-if (snd->dptr && (snd->dbit & snd->dptr->dctrl))
-    fprintf (st, "  Send Debugging via: SET %s DEBUG%s%s\n", sim_dname(snd->dptr), snd->dptr->debflags ? "=" : "", snd->dptr->debflags ? _get_dbg_verb (snd->dbit, snd->dptr, NULL) : "");
-return SCPE_OK;
+snprintf(debug_line_prefix, sizeof (debug_line_prefix), "DBG(%s%s%.0f%s)%s> %s %s: ", tim_t, tim_a, sim_gtime(), pc_s, AIO_MAIN_THREAD ? "" : "+", dptr->name, debug_type);
+return debug_line_prefix;
 }
 
-/* Poll for Queued input data */
-
-t_bool sim_send_poll_data (SEND *snd, t_stat *stat)
+void fprint_fields (FILE *stream, t_value before, t_value after, BITFIELD* bitdefs)
 {
-if (snd && (snd->extoff < snd->insoff)) {               /* pending input characters available? */
-    if (sim_gtime() < snd->next_time) {                 /* too soon? */
-        *stat = SCPE_OK;
-        sim_debug (snd->dbit, snd->dptr, "Too soon to inject next byte\n");
+int32 i, fields, offset;
+uint32 value, beforevalue, mask;
+
+for (fields=offset=0; bitdefs[fields].name; ++fields) {
+    if (bitdefs[fields].offset == 0xffffffff)       /* fixup uninitialized offsets */
+        bitdefs[fields].offset = offset;
+    else
+        offset = bitdefs[fields].offset;
+    offset += bitdefs[fields].width;
+    }
+for (i = fields-1; i >= 0; i--) {                   /* print xlation, transition */
+    if (bitdefs[i].name[0] == '\0')
+        continue;
+    if ((bitdefs[i].width == 1) && (bitdefs[i].valuenames == NULL)) {
+        int off = ((after >> bitdefs[i].offset) & 1) + (((before ^ after) >> bitdefs[i].offset) & 1) * 2;
+        fprintf(stream, "%s%c ", bitdefs[i].name, debug_bstates[off]);
         }
     else {
-        char dstr[8] = "";
+        const char *delta = "";
 
-        *stat = snd->buffer[snd->extoff++] | SCPE_KFLAG;/* get one */
-        snd->next_time = sim_gtime() + snd->delay;
-        if (sim_isgraph(*stat & 0xFF) || ((*stat & 0xFF) == ' '))
-            sprintf (dstr, " '%c'", *stat & 0xFF);
-        sim_debug (snd->dbit, snd->dptr, "Byte value: 0x%02X%s injected\n", *stat & 0xFF, dstr);
+        mask = 0xFFFFFFFF >> (32-bitdefs[i].width);
+        value = (uint32)((after >> bitdefs[i].offset) & mask);
+        beforevalue = (uint32)((before >> bitdefs[i].offset) & mask);
+        if (value < beforevalue)
+            delta = "_";
+        if (value > beforevalue)
+            delta = "^";
+        if (bitdefs[i].valuenames)
+            fprintf(stream, "%s=%s%s ", bitdefs[i].name, delta, bitdefs[i].valuenames[value]);
+        else
+            if (bitdefs[i].format) {
+                fprintf(stream, "%s=%s", bitdefs[i].name, delta);
+                fprintf(stream, bitdefs[i].format, value);
+                fprintf(stream, " ");
+                }
+            else
+                fprintf(stream, "%s=%s0x%X ", bitdefs[i].name, delta, value);
         }
-    return TRUE;
     }
-return FALSE;
 }
 
+/* Prints state of a register: bit translation + state (0,1,_,^)
+   indicating the state and transition of the bit and bitfields. States:
+   0=steady(0->0), 1=steady(1->1), _=falling(1->0), ^=rising(0->1) */
 
-/* Message Text */
-
-const char *sim_error_text (t_stat stat)
+void sim_debug_bits_hdr(uint32 dbits, DEVICE* dptr, const char *header,
+    BITFIELD* bitdefs, uint32 before, uint32 after, int terminate)
 {
-static char msgbuf[64];
+if (sim_deb && dptr && (dptr->dctrl & dbits)) {
+    TMLN *saved_oline = sim_oline;
 
-stat &= ~(SCPE_KFLAG|SCPE_BREAK|SCPE_NOMESSAGE);        /* remove any flags */
-if (stat == SCPE_OK)
-    return "No Error";
-if ((stat >= SCPE_BASE) && (stat <= SCPE_MAX_ERR))
-    return scp_errors[stat-SCPE_BASE].message;
-sprintf(msgbuf, "Error %d", stat);
-return msgbuf;
+    sim_oline = NULL;                                                   /* avoid potential debug to active socket */
+    if (!debug_unterm)
+        fprintf(sim_deb, "%s", sim_debug_prefix(dbits, dptr, NULL));    /* print prefix if required */
+    if (header)
+        fprintf(sim_deb, "%s: ", header);
+    fprint_fields (sim_deb, (t_value)before, (t_value)after, bitdefs);  /* print xlation, transition */
+    if (terminate)
+        fprintf(sim_deb, "\r\n");
+    debug_unterm = terminate ? 0 : 1;                                   /* set unterm for next */
+    sim_oline = saved_oline;                                            /* restore original socket */
+    }
 }
 
-t_stat sim_string_to_stat (const char *cptr, t_stat *stat)
+void sim_debug_bits(uint32 dbits, DEVICE* dptr, BITFIELD* bitdefs,
+    uint32 before, uint32 after, int terminate)
 {
-char gbuf[CBUFSIZE];
-int32 cond;
+sim_debug_bits_hdr(dbits, dptr, NULL, bitdefs, before, after, terminate);
+}
 
-*stat = SCPE_ARG;
-cptr = get_glyph (cptr, gbuf, 0);
-if (0 == memcmp("SCPE_", gbuf, 5))
-    memmove (gbuf, gbuf+5, 1 + strlen (gbuf+5));/* skip leading SCPE_ */
-for (cond=0; cond <= (SCPE_MAX_ERR-SCPE_BASE); cond++)
-    if (0 == strcmp(scp_errors[cond].code, gbuf)) {
-        cond += SCPE_BASE;
-        break;
+/* Print message to stdout, sim_log (if enabled) and sim_deb (if enabled) */
+void sim_printf (const char* fmt, ...)
+{
+char stackbuf[STACKBUFSIZE];
+int32 bufsize = sizeof(stackbuf);
+char *buf = stackbuf;
+int32 len;
+va_list arglist;
+
+while (1) {                                         /* format passed string, args */
+    va_start (arglist, fmt);
+#if defined(NO_vsnprintf)
+    len = vsprintf (buf, fmt, arglist);
+#else                                               /* !defined(NO_vsnprintf) */
+    len = vsnprintf (buf, bufsize-1, fmt, arglist);
+#endif                                              /* NO_vsnprintf */
+    va_end (arglist);
+
+/* If the formatted result didn't fit into the buffer, then grow the buffer and try again */
+
+    if ((len < 0) || (len >= bufsize-1)) {
+        if (buf != stackbuf)
+            free (buf);
+        bufsize = bufsize * 2;
+        if (bufsize < len + 2)
+            bufsize = len + 2;
+        buf = (char *) malloc (bufsize);
+        if (buf == NULL)                            /* out of memory */
+            return;
+        buf[bufsize-1] = '\0';
+        continue;
         }
-if (0 == strcmp(gbuf, "OK"))
-    cond = SCPE_OK;
-if (cond == (1+SCPE_MAX_ERR-SCPE_BASE)) {       /* not found? */
-    if (0 == (cond = strtol(gbuf, NULL, 0)))  /* try explicit number */
-        return SCPE_ARG;
+    break;
     }
-*stat = cond;
-if (cond > SCPE_MAX_ERR)
-    return SCPE_ARG;
-return SCPE_OK;
+
+if (sim_is_running) {
+    char *c, *remnant = buf;
+
+    while ((c = strchr (remnant, '\n'))) {
+        if ((c != buf) && (*(c - 1) != '\r'))
+            fprintf (stdout, "%.*s\r\n", (int)(c-remnant), remnant);
+        else
+            fprintf (stdout, "%.*s\n", (int)(c-remnant), remnant);
+        remnant = c + 1;
+        }
+    fprintf (stdout, "%s", remnant);
+    }
+else
+    fprintf (stdout, "%s", buf);
+if ((!sim_oline) && (sim_log && (sim_log != stdout)))
+    fprintf (sim_log, "%s", buf);
+if (sim_deb && (sim_deb != stdout) && (sim_deb != sim_log))
+    _sim_debug_write (buf, strlen (buf));
+
+if (buf != stackbuf)
+    free (buf);
 }
 
-/* Abort and sanely close output files */
-/* This routine should ONLY be called from SCP modules */
-void _sim_scp_abort (const char *msg, const char *file, int linenum)
+void sim_perror (const char *msg)
 {
-sim_printf ("%s - aborting from %s:%d\n", msg, file, linenum);
-sim_flush_buffered_files (TRUE);
-if (sim_deb)
-    sim_set_deboff (0, NULL);
-abort ();
+int saved_errno = errno;
+
+perror (msg);
+sim_printf ("%s: %s\n", msg, strerror (saved_errno));
 }
 
-/* Debug printout routines, from Dave Hittner */
+/* Print command result message to stdout, sim_log (if enabled) and sim_deb (if enabled) */
+t_stat sim_messagef (t_stat stat, const char* fmt, ...)
+{
+char stackbuf[STACKBUFSIZE];
+int32 bufsize = sizeof(stackbuf);
+char *buf = stackbuf;
+int32 len;
+va_list arglist;
+t_bool inhibit_message = (!sim_show_message || (stat & SCPE_NOMESSAGE));
+char msg_prefix[32] = "";
+size_t prefix_len;
+t_bool newline_prefix = (*fmt == '\n');
 
-const char *debug_bstates = "01_^";
-AIO_TLS char debug_line_prefix[256];
-int32 debug_unterm  = 0;
-char *debug_line_buf_last = NULL;
-size_t debug_line_buf_last_endprefix_offset = 0;
-AIO_TLS char debug_line_last_prefix[256];
-char *debug_line_buf = NULL;
-size_t debug_line_bufsize = 0;
-size_t debug_line_offset = 0;
-size_t debug_line_count = 0;
+if ((stat == SCPE_OK) && (sim_quiet || (sim_switches & SWMASK ('Q'))))
+    return stat;
+if (newline_prefix)
+    ++fmt;
+sprintf (msg_prefix, "%s%%SIM-%s: ", newline_prefix ? (sim_is_running ? "\r\n" : "\n") : "", (stat == SCPE_OK) ? "INFO" : "ERROR");
+prefix_len = strlen (msg_prefix);
+while (1) {                                         /* format passed string, args */
+    va_start (arglist, fmt);
+    strlcpy (buf, msg_prefix, bufsize);
+#if defined(NO_vsnprintf)
+    len = prefix_len + vsprintf (buf + prefix_len, fmt, arglist);
+#else                                               /* !defined(NO_vsnprintf) */
+    len = prefix_len + vsnprintf (buf + prefix_len, bufsize - (1 + prefix_len), fmt, arglist);
+#endif                                              /* NO_vsnprintf */
+    va_end (arglist);
 
-static void _debug_fwrite_all (const char *buf, size_t len, FILE *f)
-{
-size_t len_written;
+/* If the formatted result didn't fit into the buffer, then grow the buffer and try again */
 
-while (len > 0) {
-    errno = 0;
-    len_written = fwrite (buf, 1, len, f);
-    len -= len_written;
-    buf += len_written;
-    if (errno == EAGAIN)    /* Non blocking file descriptor buffer full? */
-        sim_os_ms_sleep(10);/* wait a bit to retry */
+    if ((len < 0) || (len >= bufsize-1)) {
+        if (buf != stackbuf)
+            free (buf);
+        bufsize = bufsize * 2;
+        if (bufsize < len + 2)
+            bufsize = len + 2;
+        buf = (char *) malloc (bufsize);
+        if (buf == NULL)                            /* out of memory */
+            return SCPE_MEM;
+        buf[bufsize-1] = '\0';
+        continue;
+        }
+    break;
     }
-}
 
-static void _debug_fwrite (const char *buf, size_t len)
-{
-size_t move_size;
+if (sim_do_ocptr[sim_do_depth]) {
+    if (!sim_do_echo && !inhibit_message && !sim_cmd_echoed) {
+        sim_printf("%s> %s\n", do_position(), sim_do_ocptr[sim_do_depth]);
+        sim_cmd_echoed = TRUE;
+        }
+    else {
+        if (sim_deb && !sim_cmd_echoed) {   /* Always put context in debug output */
+            TMLN *saved_oline = sim_oline;
 
-if ((sim_deb_buffer == NULL) || (!sim_is_running)) {
-    _debug_fwrite_all (buf, len, sim_deb);  /* output now. */
-    return;
+            sim_oline = NULL;               /* avoid potential debug to active socket */
+            fprintf (sim_deb, "%s> %s\n", do_position(), sim_do_ocptr[sim_do_depth]);
+            sim_oline = saved_oline;        /* restore original socket */
+            }
+        }
     }
-if ((sim_deb == stdout) && (!sim_is_running))
-    _debug_fwrite_all (buf, len, stdout);   /* output now. */
-while (len > 0) {
-    if (sim_debug_buffer_offset + len <= sim_deb_buffer_size)
-        move_size = len;
-    else
-        move_size = sim_deb_buffer_size - sim_debug_buffer_offset;
-    memcpy (sim_deb_buffer + sim_debug_buffer_offset, buf, move_size);
-    sim_debug_buffer_offset += move_size;
-    if (sim_debug_buffer_offset == sim_deb_buffer_size) {
-        sim_debug_buffer_offset = 0;
-        sim_debug_buffer_inuse = sim_deb_buffer_size;
+if (sim_is_running && !inhibit_message) {
+    char *c, *remnant = buf;
+
+    while ((c = strchr(remnant, '\n'))) {
+        if ((c != buf) && (*(c - 1) != '\r'))
+            fprintf (stdout, "%.*s\r\n", (int)(c-remnant), remnant);
+        else
+            fprintf (stdout, "%.*s\n", (int)(c-remnant), remnant);
+        remnant = c + 1;
         }
-    if (sim_debug_buffer_inuse < sim_deb_buffer_size)
-        sim_debug_buffer_inuse += move_size;
-    len -= move_size;
+    fprintf (stdout, "%s", remnant);
+    }
+else {
+    if (!inhibit_message)
+        fprintf (stdout, "%s", buf);
     }
+if ((!sim_oline) && (sim_log && (sim_log != stdout) && !inhibit_message))
+    fprintf (sim_log, "%s", buf);
+/* Always display messages in debug output */
+if (sim_deb && (((sim_deb != stdout) && (sim_deb != sim_log)) || inhibit_message)) {
+    TMLN *saved_oline = sim_oline;
+
+    sim_oline = NULL;                           /* avoid potential debug to active socket */
+    fprintf (sim_deb, "%s", buf);
+    sim_oline = saved_oline;                    /* restore original socket */
+    }
+
+if (buf != stackbuf)
+    free (buf);
+return stat | ((stat != SCPE_OK) ? SCPE_NOMESSAGE : 0);
 }
 
-/*
- * Optionally filter debug output to summarize duplicate debug lines
- */
-static void _sim_debug_write_flush (const char *buf, size_t len, t_bool flush)
-{
-char *eol;
+/* Binary (deferred format) debug trace
+
+   When debug output is enabled with the -Z switch, sim_debug() calls don't
+   format anything.  Each call appends a compact binary record to the debug
+   file containing the simulated time, the device, the debug bits, an index
+   for the format string and the raw argument values.  The DEBUGDECODE
+   command later renders such a file as regular debug text.
+
+   Format strings and devices are described in the trace the first time
+   they are referenced and are referred to by index afterwards, so a trace
+   file can be decoded by any simulator running on a host with the same
+   byte order.  Text written directly to the debug file (messages, banners,
+   sim_debug_bits output, etc.) sits between binary records and is passed
+   through unchanged by the decoder.
+*/
 
-AIO_LOCK;
-if (sim_deb_switches & SWMASK ('F')) {              /* filtering disabled? */
-    if (len > 0)
-        _debug_fwrite (buf, len);                   /* output now. */
-    AIO_UNLOCK;
-    return;                                         /* done */
-    }
-if (debug_line_offset + len + 1 > debug_line_bufsize) {
-    debug_line_bufsize += MAX(1024, debug_line_offset + len + 1);
-    debug_line_buf = (char *)realloc (debug_line_buf, debug_line_bufsize);
-    debug_line_buf_last = (char *)realloc (debug_line_buf_last, debug_line_bufsize);
-    }
-memcpy (&debug_line_buf[debug_line_offset], buf, len);
-debug_line_buf[debug_line_offset + len] = '\0';
-debug_line_offset += len;
-while ((eol = strchr (debug_line_buf, '\n')) || flush) {
-    char *endprefix = strstr (debug_line_buf, ")> ");
-    size_t linesize = (eol - debug_line_buf) + 1;
+#define DBT_SYNC0       0xFF                            /* record sync bytes */
+#define DBT_SYNC1       0xA5
+#define DBT_HDR         1                               /* trace header */
+#define DBT_FMT         2                               /* format string definition */
+#define DBT_DEV         3                               /* device definition */
+#define DBT_EVENT       4                               /* debug event */
+#define DBT_VERSION     1
+#define DBT_ORDER       0x01020304                      /* byte order check */
 
-    if ((0 != memcmp ("DBG(", debug_line_buf, 4)) || (endprefix == NULL)) {
-        if (debug_line_count > 0)
-            _debug_fwrite (debug_line_buf_last, strlen (debug_line_buf_last));
-        if (debug_line_count > 1) {
-            char countstr[40];
+#define DBT_F_THREAD    1                               /* event from other than the main thread */
+#define DBT_F_PC        2                               /* event contains a PC value */
+#define DBT_F_TIME      4                               /* event contains a time of day */
 
-            sprintf (countstr, "same as above (%d time%s)\r\n", (int)(debug_line_count - 1), ((debug_line_count - 1) != 1) ? "s" : "");
-            _debug_fwrite (debug_line_last_prefix, strlen (debug_line_last_prefix));
-            _debug_fwrite (countstr, strlen (countstr));
-            }
-        if (flush) {
-            linesize = debug_line_offset;
-            flush = FALSE;              /* already flushed */
-            }
-        if (linesize)
-            _debug_fwrite  (debug_line_buf, linesize);
-        debug_line_count = 0;
+typedef struct {
+    uint8               sync[2];                        /* DBT_SYNC0, DBT_SYNC1 */
+    uint8               type;                           /* record type */
+    uint8               flags;                          /* event flags */
+    uint32              length;                         /* record length including header */
+    } DBT_REC;
+
+typedef struct {
+    uint32              order;                          /* DBT_ORDER */
+    uint32              version;                        /* DBT_VERSION */
+    uint32              switches;                       /* debug switches */
+    uint32              pc_radix;                       /* PC display radix */
+    uint32              pc_width;                       /* PC display width */
+    uint32              pc_format;                      /* PC display format */
+    char                pc_name[32];                    /* PC register name */
+    char                sim_name[64];                   /* simulator name */
+    } DBT_HEADER;
+
+typedef struct {
+    uint32              fmt;                            /* format string index */
+    uint32              dev;                            /* device index */
+    uint32              dbits;                          /* debug bits of the call */
+    uint32              dctrl;                          /* enabled device and unit debug bits */
+    double              time;                           /* simulated time */
+    } DBT_EVENT_HDR;
+
+typedef struct {
+    char                *fmt;                           /* copy of the format string */
+    uint32              hash;                           /* hash of the format text */
+    char                *sig;                           /* argument kinds consumed by format */
+    uint32              index;                          /* index in trace */
+    } DBT_FMTENT;
+
+static DBT_FMTENT *dbt_fmts = NULL;                     /* format string hash table */
+static uint32 dbt_fmt_size = 0;
+static uint32 dbt_fmt_count = 0;
+static DEVICE **dbt_devs = NULL;                        /* devices described in trace */
+static uint32 dbt_dev_count = 0;
+static uint8 *dbt_buf = NULL;                           /* record assembly buffer */
+static size_t dbt_bufsize = 0;
+static size_t dbt_len = 0;
+
+/* Parse the printf conversion specification which starts at fmt (just
+   after the %).  The kinds of the arguments which the conversion consumes
+   are returned in kinds (a * width or precision is an 'i' argument which
+   precedes the converted value):
+
+        i       int                     l       long
+        q       64 bit integer          z       size_t or ptrdiff_t
+        d       double                  D       long double
+        p       pointer                 s       string
+        n       %n pointer or wide string (never formatted)
+
+   The return value is the address of the conversion character. */
+
+static const char *_dbt_parse_spec (const char *fmt, char *kinds)
+{
+char length = 'i';
+
+while (*fmt && strchr ("-+ #0'", *fmt))                 /* flags */
+    ++fmt;
+if (*fmt == '*') {                                      /* width */
+    *kinds++ = 'i';
+    ++fmt;
+    }
+else
+    while (sim_isdigit (*fmt))
+        ++fmt;
+if (*fmt == '.') {                                      /* precision */
+    ++fmt;
+    if (*fmt == '*') {
+        *kinds++ = 'i';
+        ++fmt;
         }
-    else {
-        linesize = debug_line_offset;
-        if (debug_line_count == 0) {
-            debug_line_buf_last_endprefix_offset = endprefix - debug_line_buf;
-            memcpy (debug_line_buf_last, debug_line_buf, linesize);
-            debug_line_buf_last[linesize] = '\0';
-            debug_line_count = 1;
-            }
-        else {
-            if (0 == memcmp (&debug_line_buf[endprefix - debug_line_buf],
-                             &debug_line_buf_last[debug_line_buf_last_endprefix_offset],
-                             (eol - endprefix)+ 1)) {
-                ++debug_line_count;
-                memcpy (debug_line_last_prefix, debug_line_buf, (endprefix - debug_line_buf) + 3);
-                debug_line_last_prefix[(endprefix - debug_line_buf) + 3] = '\0';
+    else
+        while (sim_isdigit (*fmt))
+            ++fmt;
+    }
+while (*fmt && strchr ("hlLqjztI", *fmt)) {             /* length modifiers */
+    switch (*fmt) {
+        case 'l':
+            length = (length == 'l') ? 'q' : 'l';
+            break;
+        case 'L': case 'q': case 'j':
+            length = 'q';
+            break;
+        case 'z': case 't':
+            length = 'z';
+            break;
+        case 'I':                                       /* Microsoft I, I32 and I64 */
+            if ((fmt[1] == '6') && (fmt[2] == '4')) {
+                length = 'q';
+                fmt += 2;
                 }
             else {
-                _debug_fwrite (debug_line_buf_last, strlen (debug_line_buf_last));
-                if (debug_line_count > 1) {
-                    char countstr[40];
-
-                    sprintf (countstr, "same as above (%d time%s)\r\n", (int)(debug_line_count - 1), ((debug_line_count - 1) != 1) ? "s" : "");
-                    _debug_fwrite (debug_line_last_prefix, strlen (debug_line_last_prefix));
-                    _debug_fwrite (countstr, strlen (countstr));
-                    }
-                debug_line_buf_last_endprefix_offset = endprefix - debug_line_buf;
-                memcpy (debug_line_buf_last, debug_line_buf, linesize);
-                debug_line_buf_last[linesize] = '\0';
-                debug_line_count = 1;
+                if ((fmt[1] == '3') && (fmt[2] == '2'))
+                    fmt += 2;
+                else
+                    length = 'z';
                 }
-            }
+            break;
         }
-    debug_line_offset -= linesize;
-    if ((debug_line_offset > 0) && (!flush))
-        memmove (debug_line_buf, eol + 1, debug_line_offset);
-    debug_line_buf[debug_line_offset] = '\0';
+    ++fmt;
     }
-AIO_UNLOCK;
+switch (*fmt) {
+    case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+        *kinds++ = length;
+        break;
+    case 'c':
+        *kinds++ = 'i';
+        break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        *kinds++ = ((length == 'q') && (fmt[-1] == 'L')) ? 'D' : 'd';
+        break;
+    case 's':
+        *kinds++ = (length == 'l') ? 'n' : 's';         /* wide strings aren't recorded */
+        break;
+    case 'p':
+        *kinds++ = 'p';
+        break;
+    case 'n':
+        *kinds++ = 'n';
+        break;
+    default:                                            /* %% or unknown */
+        break;
+    }
+*kinds = '\0';
+return fmt;
 }
 
-static void _sim_debug_write (const char *buf, size_t len)
-{
-_sim_debug_write_flush (buf, len, FALSE);
-}
+/* Determine the argument kinds consumed by a complete format string */
 
-static t_stat _sim_debug_flush (void)
+static char *_dbt_signature (const char *fmt)
 {
-int32 saved_quiet = sim_quiet;
-int32 saved_sim_switches = sim_switches;
-int32 saved_deb_switches = sim_deb_switches;
-struct timespec saved_deb_basetime;
-
-if (sim_deb == NULL)                                    /* no debug? */
-    return SCPE_OK;
-
-AIO_LOCK;
-saved_deb_basetime = *sim_rtcn_get_debug_basetime ();
-
-_sim_debug_write_flush ("", 0, TRUE);
+char *sig = (char *)malloc (1 + strlen (fmt) * 3 / 2);  /* at most 3 kinds per 2 format characters */
+char *kp = sig;
 
-if (sim_deb == sim_log) {                               /* debug is log */
-    fflush (sim_deb);                                   /* fflush is the best we can do */
-    AIO_UNLOCK;
-    return SCPE_OK;
+if (sig == NULL)
+    return NULL;
+for (; *fmt; ++fmt) {
+    if (*fmt != '%')
+        continue;
+    fmt = _dbt_parse_spec (fmt + 1, kp);
+    kp += strlen (kp);
+    if (*fmt == '\0')
+        break;
     }
+*kp = '\0';
+return sig;
+}
 
-if ((saved_deb_switches & SWMASK ('B')) != 0) {
-    char saved_debug_filename[CBUFSIZE];
+static t_bool _dbt_put (const void *data, size_t len)
+{
+if (dbt_len + len > dbt_bufsize) {
+    size_t newsize = MAX(2 * dbt_bufsize, dbt_len + len + 1024);
+    uint8 *newbuf = (uint8 *)realloc (dbt_buf, newsize);
 
-    snprintf (saved_debug_filename, sizeof (saved_debug_filename), "%u \"%s\"",
-                           (uint32)(sim_deb_buffer_size / (1024 * 1024)), sim_logfile_name (sim_deb, sim_deb_ref));
-    sim_quiet = 1;
-    sim_set_deboff (0, NULL);
-    sim_switches = saved_deb_switches;
-    sim_set_debon (0, saved_debug_filename);
-    sim_rtcn_set_debug_basetime (&saved_deb_basetime);
-    sim_switches = saved_sim_switches;
-    sim_quiet = saved_quiet;
+    if (newbuf == NULL)
+        return FALSE;
+    dbt_buf = newbuf;
+    dbt_bufsize = newsize;
     }
-AIO_UNLOCK;
-return SCPE_OK;
+memcpy (dbt_buf + dbt_len, data, len);
+dbt_len += len;
+return TRUE;
 }
 
+static void _dbt_begin (uint8 type, uint8 flags)
+{
+DBT_REC rec;
 
-/* Finds debug phrase matching bitmask from from device DEBTAB table */
+rec.sync[0] = DBT_SYNC0;
+rec.sync[1] = DBT_SYNC1;
+rec.type = type;
+rec.flags = flags;
+rec.length = 0;
+dbt_len = 0;
+_dbt_put (&rec, sizeof (rec));
+}
 
-static const char *_get_dbg_verb (uint32 dbits, DEVICE* dptr, UNIT *uptr)
+static void _dbt_end (void)
 {
-static const char *debtab_none    = "DEBTAB_ISNULL";
-static const char *debtab_nomatch = "DEBTAB_NOMATCH";
-const char *some_match = NULL;
-int32 offset = 0;
+uint32 length = (uint32)dbt_len;
 
-if (dptr->debflags == NULL)
-    return debtab_none;
+memcpy (dbt_buf + offsetof (DBT_REC, length), &length, sizeof (length));
+_debug_fwrite_all ((const char *)dbt_buf, dbt_len, sim_deb);
+}
 
-dbits &= (dptr->dctrl | (uptr ? uptr->dctrl : 0));/* Look for just the bits that matched */
+/* Start a new binary trace in the current debug file */
 
-/* Find matching words for bitmask */
+void sim_debug_binary_start (void)
+{
+DBT_HEADER hdr;
+uint32 i;
 
-while (dptr->debflags[offset].name && (offset < 32)) {
-    if (dptr->debflags[offset].mask == dbits)   /* All Bits Match */
-        return dptr->debflags[offset].name;
-    if (dptr->debflags[offset].mask & dbits)
-        some_match = dptr->debflags[offset].name;
-    offset++;
-    }
-return some_match ? some_match : debtab_nomatch;
+AIO_LOCK;
+for (i = 0; i < dbt_fmt_size; i++) {
+    free (dbt_fmts[i].fmt);
+    free (dbt_fmts[i].sig);
+    }
+free (dbt_fmts);
+dbt_fmts = NULL;
+dbt_fmt_size = dbt_fmt_count = 0;
+free (dbt_devs);
+dbt_devs = NULL;
+dbt_dev_count = 0;
+memset (&hdr, 0, sizeof (hdr));
+hdr.order = DBT_ORDER;
+hdr.version = DBT_VERSION;
+hdr.switches = (uint32)sim_deb_switches;
+if (sim_PC) {
+    hdr.pc_radix = sim_PC->radix;
+    hdr.pc_width = sim_PC->width;
+    hdr.pc_format = sim_PC->flags & REG_FMT;
+    strlcpy (hdr.pc_name, sim_PC->name, sizeof (hdr.pc_name));
+    }
+strlcpy (hdr.sim_name, sim_name, sizeof (hdr.sim_name));
+_dbt_begin (DBT_HDR, 0);
+_dbt_put (&hdr, sizeof (hdr));
+_dbt_end ();
+AIO_UNLOCK;
 }
 
-/* Prints standard debug prefix unless previous call unterminated */
+/* Find (or describe in the trace) a format string
 
-static const char *sim_debug_prefix (uint32 dbits, DEVICE* dptr, UNIT* uptr)
+   Formats are identified by their text rather than their address since
+   some callers (sim_scsi's debug wrapper for instance) compose formats in
+   heap buffers which can be reused for different text */
+
+static DBT_FMTENT *_dbt_format (const char *fmt)
 {
-const char* debug_type = _get_dbg_verb (dbits, dptr, uptr);
-char tim_t[32] = "";
-char tim_a[32] = "";
-char pc_s[MAX_WIDTH + 33] = "";
-struct timespec time_now;
+uint32 h, i, hash = 2166136261u;                        /* FNV-1a */
+const char *cp;
 
-if (sim_deb_switches & (SWMASK ('T') | SWMASK ('R') | SWMASK ('A'))) {
-    sim_rtcn_debug_time(&time_now);
-    if (sim_deb_switches & SWMASK ('R'))
-        sim_timespec_diff (&time_now, &time_now, sim_rtcn_get_debug_basetime ());
-    if (sim_deb_switches & SWMASK ('T')) {
-        time_t tnow = (time_t)time_now.tv_sec;
-        struct tm *now = localtime(&tnow);
+if (2 * (dbt_fmt_count + 1) > dbt_fmt_size) {           /* keep table at most half full */
+    uint32 newsize = dbt_fmt_size ? 2 * dbt_fmt_size : 256;
+    DBT_FMTENT *newtab = (DBT_FMTENT *)calloc (newsize, sizeof (*newtab));
 
-        sprintf(tim_t, "%02d:%02d:%02d.%03d ", now->tm_hour, now->tm_min, now->tm_sec, (int)(time_now.tv_nsec/1000000));
-        }
-    if (sim_deb_switches & SWMASK ('A')) {
-        sprintf(tim_t, "%" LL_FMT "d.%03d ", (LL_TYPE)(time_now.tv_sec), (int)(time_now.tv_nsec/1000000));
-        }
+    if (newtab == NULL)
+        return NULL;
+    for (i = 0; i < dbt_fmt_size; i++) {
+        if (dbt_fmts[i].fmt == NULL)
+            continue;
+        for (h = dbt_fmts[i].hash & (newsize - 1);
+             newtab[h].fmt;
+             h = (h + 1) & (newsize - 1))
+            ;
+        newtab[h] = dbt_fmts[i];
+        }
+    free (dbt_fmts);
+    dbt_fmts = newtab;
+    dbt_fmt_size = newsize;
+    }
+for (cp = fmt; *cp; cp++)
+    hash = (hash ^ (uint8)*cp) * 16777619u;
+for (h = hash & (dbt_fmt_size - 1);
+     dbt_fmts[h].fmt;
+     h = (h + 1) & (dbt_fmt_size - 1))
+    if ((dbt_fmts[h].hash == hash) && (strcmp (dbt_fmts[h].fmt, fmt) == 0))
+        return &dbt_fmts[h];
+dbt_fmts[h].sig = _dbt_signature (fmt);
+dbt_fmts[h].fmt = (char *)malloc (1 + strlen (fmt));
+if ((dbt_fmts[h].sig == NULL) || (dbt_fmts[h].fmt == NULL)) {
+    free (dbt_fmts[h].sig);
+    free (dbt_fmts[h].fmt);
+    dbt_fmts[h].sig = dbt_fmts[h].fmt = NULL;
+    return NULL;
     }
-if (sim_deb_switches & SWMASK ('P')) {
-    t_value val;
-
-    /* Some simulators expose the PC as a register, some don't expose it or expose a register
-       which is not a variable which is updated during instruction execution (i.e. only upon
-       exit of sim_instr()).  For the -P debug option to be effective, such a simulator should
-       provide a routine which returns the value of the current PC and set the sim_vm_pc_value
-       routine pointer to that routine.
-     */
-    if (sim_vm_pc_value)
-        val = (*sim_vm_pc_value)();
-    else
-        val = get_rval (sim_PC, 0);
-    sprintf(pc_s, "-%s:", sim_PC->name);
-    sprint_val (&pc_s[strlen(pc_s)], val, sim_PC->radix, sim_PC->width, sim_PC->flags & REG_FMT);
+strcpy (dbt_fmts[h].fmt, fmt);
+dbt_fmts[h].hash = hash;
+dbt_fmts[h].index = dbt_fmt_count++;
+_dbt_begin (DBT_FMT, 0);
+_dbt_put (&dbt_fmts[h].index, sizeof (dbt_fmts[h].index));
+_dbt_put (fmt, strlen (fmt) + 1);
+_dbt_end ();
+return &dbt_fmts[h];
+}
+
+/* Find (or describe in the trace) a device */
+
+static uint32 _dbt_device (DEVICE *dptr)
+{
+static uint32 last = 0;
+uint32 i, count;
+DEVICE **newdevs;
+
+if ((last < dbt_dev_count) && (dbt_devs[last] == dptr))
+    return last;
+for (i = 0; i < dbt_dev_count; i++)
+    if (dbt_devs[i] == dptr)
+        return last = i;
+newdevs = (DEVICE **)realloc (dbt_devs, (dbt_dev_count + 1) * sizeof (*dbt_devs));
+if (newdevs == NULL)
+    return (uint32)-1;
+dbt_devs = newdevs;
+dbt_devs[dbt_dev_count] = dptr;
+for (count = 0; dptr->debflags && dptr->debflags[count].name && (count < 32); count++)
+    ;
+_dbt_begin (DBT_DEV, 0);
+_dbt_put (&dbt_dev_count, sizeof (dbt_dev_count));
+_dbt_put (dptr->name, strlen (dptr->name) + 1);
+if (dptr->debflags == NULL)
+    count = (uint32)-1;                                 /* no debug table */
+_dbt_put (&count, sizeof (count));
+for (i = 0; (count != (uint32)-1) && (i < count); i++) {
+    _dbt_put (&dptr->debflags[i].mask, sizeof (dptr->debflags[i].mask));
+    _dbt_put (dptr->debflags[i].name, strlen (dptr->debflags[i].name) + 1);
     }
-snprintf(debug_line_prefix, sizeof (debug_line_prefix), "DBG(%s%s%.0f%s)%s> %s %s: ", tim_t, tim_a, sim_gtime(), pc_s, AIO_MAIN_THREAD ? "" : "+", dptr->name, debug_type);
-return debug_line_prefix;
+_dbt_end ();
+return last = dbt_dev_count++;
 }
 
-void fprint_fields (FILE *stream, t_value before, t_value after, BITFIELD* bitdefs)
+/* Record a debug event */
+
+static void _sim_debug_binary (uint32 dbits, DEVICE* dptr, UNIT *uptr, const char* fmt, va_list arglist)
 {
-int32 i, fields, offset;
-uint32 value, beforevalue, mask;
+DBT_FMTENT *fe;
+DBT_EVENT_HDR ev;
+uint8 flags = AIO_MAIN_THREAD ? 0 : DBT_F_THREAD;
+const char *kp;
 
-for (fields=offset=0; bitdefs[fields].name; ++fields) {
-    if (bitdefs[fields].offset == 0xffffffff)       /* fixup uninitialized offsets */
-        bitdefs[fields].offset = offset;
-    else
-        offset = bitdefs[fields].offset;
-    offset += bitdefs[fields].width;
+AIO_LOCK;
+fe = _dbt_format (fmt);
+ev.dev = _dbt_device (dptr);
+if ((fe == NULL) || (ev.dev == (uint32)-1)) {
+    AIO_UNLOCK;
+    return;
     }
-for (i = fields-1; i >= 0; i--) {                   /* print xlation, transition */
-    if (bitdefs[i].name[0] == '\0')
-        continue;
-    if ((bitdefs[i].width == 1) && (bitdefs[i].valuenames == NULL)) {
-        int off = ((after >> bitdefs[i].offset) & 1) + (((before ^ after) >> bitdefs[i].offset) & 1) * 2;
-        fprintf(stream, "%s%c ", bitdefs[i].name, debug_bstates[off]);
-        }
-    else {
-        const char *delta = "";
+ev.fmt = fe->index;
+ev.dbits = dbits;
+ev.dctrl = dptr->dctrl | (uptr ? uptr->dctrl : 0);
+ev.time = sim_gtime ();
+if (sim_deb_switches & SWMASK ('P'))
+    flags |= DBT_F_PC;
+if (sim_deb_switches & (SWMASK ('T') | SWMASK ('R') | SWMASK ('A')))
+    flags |= DBT_F_TIME;
+_dbt_begin (DBT_EVENT, flags);
+_dbt_put (&ev, sizeof (ev));
+if (flags & DBT_F_PC) {
+    t_uint64 pc = (t_uint64)(sim_vm_pc_value ? (*sim_vm_pc_value)() : get_rval (sim_PC, 0));
+
+    _dbt_put (&pc, sizeof (pc));
+    }
+if (flags & DBT_F_TIME) {
+    struct timespec time_now;
+    t_int64 sec;
+    uint32 nsec;
+
+    sim_rtcn_debug_time (&time_now);
+    if (sim_deb_switches & SWMASK ('R'))
+        sim_timespec_diff (&time_now, &time_now, sim_rtcn_get_debug_basetime ());
+    sec = (t_int64)time_now.tv_sec;
+    nsec = (uint32)time_now.tv_nsec;
+    _dbt_put (&sec, sizeof (sec));
+    _dbt_put (&nsec, sizeof (nsec));
+    }
+for (kp = fe->sig; *kp; ++kp) {
+    switch (*kp) {
+        case 'i': {
+            int32 val = (int32)va_arg (arglist, int);
 
-        mask = 0xFFFFFFFF >> (32-bitdefs[i].width);
-        value = (uint32)((after >> bitdefs[i].offset) & mask);
-        beforevalue = (uint32)((before >> bitdefs[i].offset) & mask);
-        if (value < beforevalue)
-            delta = "_";
-        if (value > beforevalue)
-            delta = "^";
-        if (bitdefs[i].valuenames)
-            fprintf(stream, "%s=%s%s ", bitdefs[i].name, delta, bitdefs[i].valuenames[value]);
-        else
-            if (bitdefs[i].format) {
-                fprintf(stream, "%s=%s", bitdefs[i].name, delta);
-                fprintf(stream, bitdefs[i].format, value);
-                fprintf(stream, " ");
-                }
-            else
-                fprintf(stream, "%s=%s0x%X ", bitdefs[i].name, delta, value);
+            _dbt_put (&val, sizeof (val));
+            }
+            break;
+        case 'l': {
+            t_int64 val = (t_int64)va_arg (arglist, long);
+
+            _dbt_put (&val, sizeof (val));
+            }
+            break;
+        case 'q': {
+            t_int64 val = (t_int64)va_arg (arglist, t_int64);
+
+            _dbt_put (&val, sizeof (val));
+            }
+            break;
+        case 'z': {
+            t_uint64 val = (t_uint64)va_arg (arglist, size_t);
+
+            _dbt_put (&val, sizeof (val));
+            }
+            break;
+        case 'd': {
+            double val = va_arg (arglist, double);
+
+            _dbt_put (&val, sizeof (val));
+            }
+            break;
+        case 'D': {
+            double val = (double)va_arg (arglist, long double);
+
+            _dbt_put (&val, sizeof (val));
+            }
+            break;
+        case 'p': case 'n': {
+            t_uint64 val = (t_uint64)(size_t)va_arg (arglist, void *);
+
+            _dbt_put (&val, sizeof (val));
+            }
+            break;
+        case 's': {
+            const char *str = va_arg (arglist, const char *);
+            uint32 len = str ? (uint32)strlen (str) : (uint32)-1;
+
+            _dbt_put (&len, sizeof (len));
+            if (str)
+                _dbt_put (str, len);
+            }
+            break;
         }
     }
+_dbt_end ();
+AIO_UNLOCK;
 }
 
-/* Prints state of a register: bit translation + state (0,1,_,^)
-   indicating the state and transition of the bit and bitfields. States:
-   0=steady(0->0), 1=steady(1->1), _=falling(1->0), ^=rising(0->1) */
+/* Binary trace decoding state */
 
-void sim_debug_bits_hdr(uint32 dbits, DEVICE* dptr, const char *header,
-    BITFIELD* bitdefs, uint32 before, uint32 after, int terminate)
+typedef struct {
+    char                *text;                          /* format string */
+    } DBT_DFMT;
+
+typedef struct {
+    char                *name;                          /* device name */
+    int32               count;                          /* debug flag count (-1 for none) */
+    uint32              *masks;                         /* debug flag masks */
+    char                **names;                        /* debug flag names */
+    } DBT_DDEV;
+
+typedef struct {
+    DBT_HEADER          hdr;
+    t_bool              have_hdr;
+    DBT_DFMT            *fmts;
+    uint32              fmt_count;
+    DBT_DDEV            *devs;
+    uint32              dev_count;
+    char                *text;                          /* formatted event text */
+    size_t              text_size;
+    t_bool              unterm;                         /* last event text lacked a newline */
+    } DBT_DECODE;
+
+static const char *_dbt_decode_verb (const DBT_DDEV *dev, uint32 dbits)
 {
-if (sim_deb && dptr && (dptr->dctrl & dbits)) {
-    TMLN *saved_oline = sim_oline;
+const char *some_match = NULL;
+int32 i;
 
-    sim_oline = NULL;                                                   /* avoid potential debug to active socket */
-    if (!debug_unterm)
-        fprintf(sim_deb, "%s", sim_debug_prefix(dbits, dptr, NULL));    /* print prefix if required */
-    if (header)
-        fprintf(sim_deb, "%s: ", header);
-    fprint_fields (sim_deb, (t_value)before, (t_value)after, bitdefs);  /* print xlation, transition */
-    if (terminate)
-        fprintf(sim_deb, "\r\n");
-    debug_unterm = terminate ? 0 : 1;                                   /* set unterm for next */
-    sim_oline = saved_oline;                                            /* restore original socket */
+if (dev->count < 0)
+    return "DEBTAB_ISNULL";
+for (i = 0; i < dev->count; i++) {
+    if (dev->masks[i] == dbits)
+        return dev->names[i];
+    if (dev->masks[i] & dbits)
+        some_match = dev->names[i];
     }
+return some_match ? some_match : "DEBTAB_NOMATCH";
 }
 
-void sim_debug_bits(uint32 dbits, DEVICE* dptr, BITFIELD* bitdefs,
-    uint32 before, uint32 after, int terminate)
+/* Append one conversion (specification spec, with length speclen) to the
+   event text.  Any * width or precision has already been resolved.
+   Returns the number of argument bytes consumed or 0 if the argument
+   data is incomplete */
+
+static size_t _dbt_decode_conv (DBT_DECODE *dc, size_t *len, const char *spec, char kind, const uint8 *arg, size_t arglen)
 {
-sim_debug_bits_hdr(dbits, dptr, NULL, bitdefs, before, after, terminate);
+size_t used = 8;
+char *str = NULL;
+int n;
+
+if ((kind == 'i') || (kind == 's'))
+    used = 4;
+if (kind == '\0')                                       /* no argument (%% or unknown) */
+    used = 0;
+if (arglen < used)
+    return 0;
+if (kind == 's') {
+    uint32 slen;
+
+    memcpy (&slen, arg, sizeof (slen));
+    if (slen != (uint32)-1) {
+        if (arglen < used + slen)
+            return 0;
+        str = (char *)malloc (slen + 1);
+        if (str == NULL)
+            return 0;
+        memcpy (str, arg + used, slen);
+        str[slen] = '\0';
+        used += slen;
+        }
+    }
+if (kind == 'n')                                        /* %n is never formatted */
+    return used;
+while (1) {
+    char *buf = dc->text + *len;
+    size_t room = dc->text_size - *len;
+    int32 i32;
+    t_int64 i64;
+    double d;
+
+    switch (kind) {
+        case 'i':
+            memcpy (&i32, arg, sizeof (i32));
+            n = snprintf (buf, room, spec, (int)i32);
+            break;
+        case 'l':
+            memcpy (&i64, arg, sizeof (i64));
+            n = snprintf (buf, room, spec, (long)i64);
+            break;
+        case 'q':
+            memcpy (&i64, arg, sizeof (i64));
+            n = snprintf (buf, room, spec, i64);
+            break;
+        case 'z':
+            memcpy (&i64, arg, sizeof (i64));
+            n = snprintf (buf, room, spec, (size_t)i64);
+            break;
+        case 'd':
+            memcpy (&d, arg, sizeof (d));
+            n = snprintf (buf, room, spec, d);
+            break;
+        case 'D':
+            memcpy (&d, arg, sizeof (d));
+            n = snprintf (buf, room, spec, (long double)d);
+            break;
+        case 'p':
+            memcpy (&i64, arg, sizeof (i64));
+            n = snprintf (buf, room, spec, (void *)(size_t)i64);
+            break;
+        case 's':
+            n = snprintf (buf, room, spec, str ? str : "(null)");
+            break;
+        default:                                        /* no argument */
+            n = snprintf (buf, room, "%s", (spec[strlen (spec) - 1] == '%') ? "%" : spec);
+            break;
+        }
+    if ((n >= 0) && ((size_t)n < room))
+        break;
+    dc->text_size = MAX(2 * dc->text_size, *len + ((n >= 0) ? n : 0) + 1024);
+    dc->text = (char *)realloc (dc->text, dc->text_size);
+    if (dc->text == NULL) {
+        free (str);
+        return 0;
+        }
+    }
+*len += n;
+free (str);
+return used;
 }
 
-/* Print message to stdout, sim_log (if enabled) and sim_deb (if enabled) */
-void sim_printf (const char* fmt, ...)
-{
-char stackbuf[STACKBUFSIZE];
-int32 bufsize = sizeof(stackbuf);
-char *buf = stackbuf;
-int32 len;
-va_list arglist;
+/* Render the text of an event from its format and argument data */
 
-while (1) {                                         /* format passed string, args */
-    va_start (arglist, fmt);
-#if defined(NO_vsnprintf)
-    len = vsprintf (buf, fmt, arglist);
-#else                                               /* !defined(NO_vsnprintf) */
-    len = vsnprintf (buf, bufsize-1, fmt, arglist);
-#endif                                              /* NO_vsnprintf */
-    va_end (arglist);
+static t_bool _dbt_decode_text (DBT_DECODE *dc, const char *fmt, const uint8 *arg, size_t arglen)
+{
+size_t len = 0;
 
-/* If the formatted result didn't fit into the buffer, then grow the buffer and try again */
+if (dc->text == NULL) {
+    dc->text_size = 1024;
+    dc->text = (char *)malloc (dc->text_size);
+    if (dc->text == NULL)
+        return FALSE;
+    }
+dc->text[0] = '\0';
+while (*fmt) {
+    const char *pct = strchr (fmt, '%');
+    const char *end;
+    char kinds[4], *kp = kinds;
+    char spec[64];
+    size_t speclen, used;
+    int32 star;
 
-    if ((len < 0) || (len >= bufsize-1)) {
-        if (buf != stackbuf)
-            free (buf);
-        bufsize = bufsize * 2;
-        if (bufsize < len + 2)
-            bufsize = len + 2;
-        buf = (char *) malloc (bufsize);
-        if (buf == NULL)                            /* out of memory */
-            return;
-        buf[bufsize-1] = '\0';
-        continue;
+    if (pct == NULL)
+        pct = fmt + strlen (fmt);
+    if (pct != fmt) {                                   /* literal text */
+        if (len + (pct - fmt) + 1 > dc->text_size) {
+            dc->text_size = MAX(2 * dc->text_size, len + (pct - fmt) + 1024);
+            dc->text = (char *)realloc (dc->text, dc->text_size);
+            if (dc->text == NULL)
+                return FALSE;
+            }
+        memcpy (dc->text + len, fmt, pct - fmt);
+        len += pct - fmt;
+        dc->text[len] = '\0';
         }
-    break;
+    if (*pct == '\0')
+        break;
+    end = _dbt_parse_spec (pct + 1, kinds);
+    if (*end == '\0')                                   /* truncated specification */
+        break;
+    for (speclen = 0; pct <= end; ++pct) {              /* copy specification resolving * values */
+        if ((*pct == '*') && (*kp == 'i') && (arglen >= sizeof (star))) {
+            char num[16];
+
+            memcpy (&star, arg, sizeof (star));
+            arg += sizeof (star);
+            arglen -= sizeof (star);
+            ++kp;
+            if ((star < 0) && (speclen > 0) && (spec[speclen - 1] == '.')) {
+                --speclen;                              /* negative precision is ignored */
+                continue;
+                }
+            sprintf (num, "%d", (int)star);
+            if (speclen + strlen (num) < sizeof (spec) - 1) {
+                memcpy (spec + speclen, num, strlen (num));
+                speclen += strlen (num);
+                }
+            continue;
+            }
+        if (speclen < sizeof (spec) - 1)
+            spec[speclen++] = *pct;
+        }
+    spec[speclen] = '\0';
+    fmt = end + 1;
+    used = _dbt_decode_conv (dc, &len, spec, *kp, arg, arglen);
+    if ((used == 0) && (*kp != '\0') && (*kp != 'n'))
+        return FALSE;                                   /* argument data incomplete */
+    arg += used;
+    arglen -= used;
     }
+return TRUE;
+}
 
-if (sim_is_running) {
-    char *c, *remnant = buf;
+static void _dbt_decode_event (DBT_DECODE *dc, uint8 flags, const uint8 *data, size_t len, FILE *st)
+{
+DBT_EVENT_HDR ev;
+const DBT_DDEV *dev;
+char tim_t[40] = "";
+char pc_s[MAX_WIDTH + 40] = "";
+char prefix[256];
+size_t i, j, tlen;
 
-    while ((c = strchr (remnant, '\n'))) {
-        if ((c != buf) && (*(c - 1) != '\r'))
-            fprintf (stdout, "%.*s\r\n", (int)(c-remnant), remnant);
-        else
-            fprintf (stdout, "%.*s\n", (int)(c-remnant), remnant);
-        remnant = c + 1;
+if (len < sizeof (ev))
+    return;
+memcpy (&ev, data, sizeof (ev));
+data += sizeof (ev);
+len -= sizeof (ev);
+if ((ev.fmt >= dc->fmt_count) || (ev.dev >= dc->dev_count) || (dc->fmts[ev.fmt].text == NULL))
+    return;
+dev = &dc->devs[ev.dev];
+if ((flags & DBT_F_PC) && (len >= sizeof (t_uint64))) {
+    t_uint64 pc;
+
+    memcpy (&pc, data, sizeof (pc));
+    data += sizeof (pc);
+    len -= sizeof (pc);
+    sprintf (pc_s, "-%s:", dc->hdr.pc_name);
+    sprint_val (&pc_s[strlen (pc_s)], (t_value)pc, dc->hdr.pc_radix ? dc->hdr.pc_radix : 8, dc->hdr.pc_width, dc->hdr.pc_format);
+    }
+if ((flags & DBT_F_TIME) && (len >= sizeof (t_int64) + sizeof (uint32))) {
+    t_int64 sec;
+    uint32 nsec;
+
+    memcpy (&sec, data, sizeof (sec));
+    memcpy (&nsec, data + sizeof (sec), sizeof (nsec));
+    data += sizeof (sec) + sizeof (nsec);
+    len -= sizeof (sec) + sizeof (nsec);
+    if (dc->hdr.switches & SWMASK ('A'))
+        sprintf (tim_t, "%" LL_FMT "d.%03d ", (LL_TYPE)sec, (int)(nsec / 1000000));
+    else {
+        time_t tnow = (time_t)sec;
+        struct tm *now = localtime (&tnow);
+
+        if (now)
+            sprintf (tim_t, "%02d:%02d:%02d.%03d ", now->tm_hour, now->tm_min, now->tm_sec, (int)(nsec / 1000000));
         }
-    fprintf (stdout, "%s", remnant);
     }
-else
-    fprintf (stdout, "%s", buf);
-if ((!sim_oline) && (sim_log && (sim_log != stdout)))
-    fprintf (sim_log, "%s", buf);
-if (sim_deb && (sim_deb != stdout) && (sim_deb != sim_log))
-    _sim_debug_write (buf, strlen (buf));
-
-if (buf != stackbuf)
-    free (buf);
+if (!_dbt_decode_text (dc, dc->fmts[ev.fmt].text, data, len))
+    return;
+snprintf (prefix, sizeof (prefix), "DBG(%s%.0f%s)%s> %s %s: ", tim_t, ev.time, pc_s,
+          (flags & DBT_F_THREAD) ? "+" : "", dev->name, _dbt_decode_verb (dev, ev.dbits & ev.dctrl));
+/* Output the formatted data expanding newlines the same way _sim_vdebug does */
+tlen = strlen (dc->text);
+for (i = j = 0; i < tlen; ++i) {
+    if ('\n' == dc->text[i]) {
+        if ((i != j) || (i == 0)) {
+            if (!dc->unterm)
+                fputs (prefix, st);
+            fprintf (st, "%.*s\r\n", (int)(i - j), &dc->text[j]);
+            }
+        dc->unterm = FALSE;
+        j = i + 1;
+        }
+    }
+if (i > j) {
+    if (!dc->unterm)
+        fputs (prefix, st);
+    fprintf (st, "%.*s", (int)(i - j), &dc->text[j]);
+    }
+if (tlen)
+    dc->unterm = (dc->text[tlen - 1] != '\n');
 }
 
-void sim_perror (const char *msg)
+static void _dbt_decode_record (DBT_DECODE *dc, const DBT_REC *rec, const uint8 *data, size_t len, FILE *st)
 {
-int saved_errno = errno;
+uint32 index;
 
-perror (msg);
-sim_printf ("%s: %s\n", msg, strerror (saved_errno));
+switch (rec->type) {
+    case DBT_HDR:
+        if (len >= sizeof (dc->hdr)) {
+            memcpy (&dc->hdr, data, sizeof (dc->hdr));
+            dc->have_hdr = TRUE;
+            }
+        break;
+    case DBT_FMT:
+        if (len < sizeof (index) + 1)
+            break;
+        memcpy (&index, data, sizeof (index));
+        if (index >= dc->fmt_count) {
+            dc->fmts = (DBT_DFMT *)realloc (dc->fmts, (index + 1) * sizeof (*dc->fmts));
+            memset (&dc->fmts[dc->fmt_count], 0, (index + 1 - dc->fmt_count) * sizeof (*dc->fmts));
+            dc->fmt_count = index + 1;
+            }
+        free (dc->fmts[index].text);
+        dc->fmts[index].text = (char *)calloc (len - sizeof (index) + 1, 1);
+        memcpy (dc->fmts[index].text, data + sizeof (index), len - sizeof (index));
+        break;
+    case DBT_DEV: {
+        DBT_DDEV *dev;
+        const uint8 *end = data + len;
+        int32 i;
+
+        if (len < sizeof (index) + 1)
+            break;
+        memcpy (&index, data, sizeof (index));
+        data += sizeof (index);
+        if (index >= dc->dev_count) {
+            dc->devs = (DBT_DDEV *)realloc (dc->devs, (index + 1) * sizeof (*dc->devs));
+            memset (&dc->devs[dc->dev_count], 0, (index + 1 - dc->dev_count) * sizeof (*dc->devs));
+            dc->dev_count = index + 1;
+            }
+        dev = &dc->devs[index];
+        dev->name = (char *)calloc (end - data + 1, 1);
+        memcpy (dev->name, data, end - data);
+        data += strlen (dev->name) + 1;
+        dev->count = -1;
+        if (data + sizeof (dev->count) > end)
+            break;
+        memcpy (&dev->count, data, sizeof (dev->count));
+        data += sizeof (dev->count);
+        if (dev->count < 0)
+            break;
+        dev->masks = (uint32 *)calloc (dev->count + 1, sizeof (*dev->masks));
+        dev->names = (char **)calloc (dev->count + 1, sizeof (*dev->names));
+        for (i = 0; (i < dev->count) && (data + sizeof (uint32) < end); i++) {
+            memcpy (&dev->masks[i], data, sizeof (uint32));
+            data += sizeof (uint32);
+            dev->names[i] = (char *)calloc (end - data + 1, 1);
+            memcpy (dev->names[i], data, end - data);
+            data += strlen (dev->names[i]) + 1;
+            }
+        dev->count = i;
+        }
+        break;
+    case DBT_EVENT:
+        if (dc->have_hdr)
+            _dbt_decode_event (dc, rec->flags, data, len, st);
+        break;
+    default:                                            /* ignore unknown record types */
+        break;
+    }
 }
 
-/* Print command result message to stdout, sim_log (if enabled) and sim_deb (if enabled) */
-t_stat sim_messagef (t_stat stat, const char* fmt, ...)
-{
-char stackbuf[STACKBUFSIZE];
-int32 bufsize = sizeof(stackbuf);
-char *buf = stackbuf;
-int32 len;
-va_list arglist;
-t_bool inhibit_message = (!sim_show_message || (stat & SCPE_NOMESSAGE));
-char msg_prefix[32] = "";
-size_t prefix_len;
-t_bool newline_prefix = (*fmt == '\n');
+/* Render a binary debug trace as debug text
 
-if ((stat == SCPE_OK) && (sim_quiet || (sim_switches & SWMASK ('Q'))))
-    return stat;
-if (newline_prefix)
-    ++fmt;
-sprintf (msg_prefix, "%s%%SIM-%s: ", newline_prefix ? (sim_is_running ? "\r\n" : "\n") : "", (stat == SCPE_OK) ? "INFO" : "ERROR");
-prefix_len = strlen (msg_prefix);
-while (1) {                                         /* format passed string, args */
-    va_start (arglist, fmt);
-    strlcpy (buf, msg_prefix, bufsize);
-#if defined(NO_vsnprintf)
-    len = prefix_len + vsprintf (buf + prefix_len, fmt, arglist);
-#else                                               /* !defined(NO_vsnprintf) */
-    len = prefix_len + vsnprintf (buf + prefix_len, bufsize - (1 + prefix_len), fmt, arglist);
-#endif                                              /* NO_vsnprintf */
-    va_end (arglist);
+   DEBUGDECODE binary-trace-file {output-file} */
 
-/* If the formatted result didn't fit into the buffer, then grow the buffer and try again */
+t_stat debug_decode_cmd (int32 flag, CONST char *cptr)
+{
+char gbuf[CBUFSIZE];
+FILE *f, *st = stdout;
+DBT_DECODE dc;
+uint8 *data = NULL;
+size_t data_size = 0;
+uint32 records = 0;
+t_stat r = SCPE_OK;
+uint32 i;
+int c;
 
-    if ((len < 0) || (len >= bufsize-1)) {
-        if (buf != stackbuf)
-            free (buf);
-        bufsize = bufsize * 2;
-        if (bufsize < len + 2)
-            bufsize = len + 2;
-        buf = (char *) malloc (bufsize);
-        if (buf == NULL)                            /* out of memory */
-            return SCPE_MEM;
-        buf[bufsize-1] = '\0';
-        continue;
+GET_SWITCHES (cptr);                                    /* get switches */
+if ((!cptr) || (*cptr == '\0'))
+    return SCPE_2FARG;
+cptr = get_glyph_quoted (cptr, gbuf, 0);                /* get trace file name */
+f = sim_fopen (gbuf, "rb");
+if (f == NULL)
+    return sim_messagef (SCPE_OPENERR, "Can't open binary trace file '%s': %s\n", gbuf, strerror (errno));
+if (*cptr) {
+    cptr = get_glyph_quoted (cptr, gbuf, 0);            /* get output file name */
+    if (*cptr) {
+        fclose (f);
+        return SCPE_2MARG;
+        }
+    st = sim_fopen (gbuf, (sim_switches & SWMASK ('A')) ? "ab" : "wb");
+    if (st == NULL) {
+        fclose (f);
+        return sim_messagef (SCPE_OPENERR, "Can't open output file '%s': %s\n", gbuf, strerror (errno));
         }
-    break;
     }
+memset (&dc, 0, sizeof (dc));
+while ((c = fgetc (f)) != EOF) {
+    DBT_REC rec;
 
-if (sim_do_ocptr[sim_do_depth]) {
-    if (!sim_do_echo && !inhibit_message && !sim_cmd_echoed) {
-        sim_printf("%s> %s\n", do_position(), sim_do_ocptr[sim_do_depth]);
-        sim_cmd_echoed = TRUE;
+    if (c != DBT_SYNC0) {                               /* text written directly to the debug file */
+        fputc (c, st);
+        continue;
         }
-    else {
-        if (sim_deb && !sim_cmd_echoed) {   /* Always put context in debug output */
-            TMLN *saved_oline = sim_oline;
-
-            sim_oline = NULL;               /* avoid potential debug to active socket */
-            fprintf (sim_deb, "%s> %s\n", do_position(), sim_do_ocptr[sim_do_depth]);
-            sim_oline = saved_oline;        /* restore original socket */
+    c = fgetc (f);
+    if (c != DBT_SYNC1) {
+        fputc (DBT_SYNC0, st);
+        if (c == EOF)
+            break;
+        ungetc (c, f);
+        continue;
+        }
+    rec.sync[0] = DBT_SYNC0;
+    rec.sync[1] = DBT_SYNC1;
+    if ((fread (&rec.type, 1, sizeof (rec) - 2, f) != sizeof (rec) - 2) ||
+        (rec.length < sizeof (rec))) {
+        r = sim_messagef (SCPE_FMT, "Truncated or invalid binary trace record\n");
+        break;
+        }
+    if (rec.length - sizeof (rec) > data_size) {
+        data_size = rec.length - sizeof (rec);
+        data = (uint8 *)realloc (data, data_size);
+        if (data == NULL) {
+            r = SCPE_MEM;
+            break;
             }
         }
-    }
-if (sim_is_running && !inhibit_message) {
-    char *c, *remnant = buf;
-
-    while ((c = strchr(remnant, '\n'))) {
-        if ((c != buf) && (*(c - 1) != '\r'))
-            fprintf (stdout, "%.*s\r\n", (int)(c-remnant), remnant);
-        else
-            fprintf (stdout, "%.*s\n", (int)(c-remnant), remnant);
-        remnant = c + 1;
+    if (fread (data, 1, rec.length - sizeof (rec), f) != rec.length - sizeof (rec)) {
+        r = sim_messagef (SCPE_FMT, "Truncated binary trace record\n");
+        break;
         }
-    fprintf (stdout, "%s", remnant);
-    }
-else {
-    if (!inhibit_message)
-        fprintf (stdout, "%s", buf);
-    }
-if ((!sim_oline) && (sim_log && (sim_log != stdout) && !inhibit_message))
-    fprintf (sim_log, "%s", buf);
-/* Always display messages in debug output */
-if (sim_deb && (((sim_deb != stdout) && (sim_deb != sim_log)) || inhibit_message)) {
-    TMLN *saved_oline = sim_oline;
+    if ((rec.type == DBT_HDR) && (rec.length - sizeof (rec) >= sizeof (uint32))) {
+        uint32 order;
 
-    sim_oline = NULL;                           /* avoid potential debug to active socket */
-    fprintf (sim_deb, "%s", buf);
-    sim_oline = saved_oline;                    /* restore original socket */
+        memcpy (&order, data, sizeof (order));
+        if (order != DBT_ORDER) {
+            r = sim_messagef (SCPE_FMT, "Binary trace was recorded on a host with a different byte order\n");
+            break;
+            }
+        }
+    _dbt_decode_record (&dc, &rec, data, rec.length - sizeof (rec), st);
+    if (rec.type == DBT_EVENT)
+        ++records;
     }
-
-if (buf != stackbuf)
-    free (buf);
-return stat | ((stat != SCPE_OK) ? SCPE_NOMESSAGE : 0);
+if (dc.unterm)
+    fputs ("\r\n", st);
+fclose (f);
+if (st != stdout)
+    fclose (st);
+for (i = 0; i < dc.fmt_count; i++)
+    free (dc.fmts[i].text);
+free (dc.fmts);
+for (i = 0; i < dc.dev_count; i++) {
+    int32 j;
+
+    for (j = 0; j < dc.devs[i].count; j++)
+        free (dc.devs[i].names[j]);
+    free (dc.devs[i].names);
+    free (dc.devs[i].masks);
+    free (dc.devs[i].name);
+    }
+free (dc.devs);
+free (dc.text);
+free (data);
+if ((r == SCPE_OK) && (st != stdout))
+    sim_messagef (SCPE_OK, "%u debug events decoded\n", (unsigned)records);
+return r;
 }
 
 /* Inline debugging - will print debug message if debug file is
@@ -14970,13 +18986,19 @@ return stat | ((stat != SCPE_OK) ? SCPE_NOMESSAGE : 0);
 void _sim_vdebug (uint32 dbits, DEVICE* dptr, UNIT *uptr, const char* fmt, va_list arglist)
 {
 if (sim_deb && dptr && ((dptr->dctrl | (uptr ? uptr->dctrl : 0)) & dbits)) {
-    TMLN *saved_oline = sim_oline;
+    TMLN *saved_oline;
     char stackbuf[STACKBUFSIZE];
     int32 bufsize = sizeof(stackbuf);
     char *buf = stackbuf;
     int32 i, j, len;
-    const char* debug_prefix = sim_debug_prefix(dbits, dptr, uptr);   /* prefix to print if required */
+    const char* debug_prefix;
 
+    if (sim_deb_switches & SWMASK ('Z')) {              /* binary trace? */
+        _sim_debug_binary (dbits, dptr, uptr, fmt, arglist);/* record it for later formatting */
+        return;
+        }
+    debug_prefix = sim_debug_prefix(dbits, dptr, uptr); /* prefix to print if required */
+    saved_oline = sim_oline;
     sim_oline = NULL;                                   /* avoid potential debug to active socket */
     buf[bufsize-1] = '\0';
 
@@ -17491,7 +21513,7 @@ sim_printf ("Unit %s fired at %.0f\n", sim_uname (uptr), sim_gtime ());
 return SCPE_OK;
 }
 
-static t_stat test_scp_event_sequencing (void)
+static t_stat _test_scp_event_sequencing (void)
 {
 DEVICE *dptr = &sim_scp_dev;
 uint32 i;
@@ -17586,6 +21608,989 @@ sim_set_deb_switches (start_deb_switches);
 return r;
 }
 
+static uint32 bench_fired;
+static double bench_last_time;
+
+static t_stat sim_scp_bench_svc (UNIT *uptr)
+{
+double now = sim_gtime ();
+
+if (now < bench_last_time)
+    return sim_messagef (SCPE_IERR, "Event fired at %.0f after an event at %.0f\n", now, bench_last_time);
+bench_last_time = now;
+++bench_fired;
+return SCPE_OK;
+}
+
+/* Schedule, cancel and dispatch events for a large number of units to
+   verify ordering and measure the cost of event queue maintenance */
+
+static t_stat test_scp_event_queue_benchmark (uint32 numunits)
+{
+UNIT *units = (UNIT *)calloc (numunits, sizeof (*units));
+uint32 i, pass, seed = 1;
+uint32 activations = 0, cancellations = 0, expected = 0;
+uint32 start_dctrl = sim_scp_dev.dctrl;
+uint32 start_msec;
+t_stat r = SCPE_OK;
+
+if (units == NULL)
+    return SCPE_MEM;
+sim_scp_dev.dctrl = 0;
+while (sim_clock_queue != QUEUE_LIST_END)
+    sim_cancel (sim_clock_queue);
+sim_reset_time ();
+bench_fired = 0;
+bench_last_time = 0;
+start_msec = sim_os_msec ();
+for (pass = 0; (pass < 4) && (r == SCPE_OK); pass++) {
+    for (i = 0; i < numunits; i++) {
+        seed = seed * 1103515245 + 12345;
+        units[i].action = &sim_scp_bench_svc;
+        sim_activate (&units[i], (int32)((seed >> 8) % 100000));
+        ++activations;
+        }
+    for (i = 0; i < numunits; i += 3) {
+        sim_cancel (&units[(i * 7919) % numunits]);
+        ++cancellations;
+        }
+    for (i = 0; i < numunits; i++)
+        if (sim_is_active (&units[i]))
+            ++expected;
+    while ((sim_clock_queue != QUEUE_LIST_END) && (r == SCPE_OK)) {
+        sim_interval = 0;
+        r = sim_process_event ();
+        }
+    }
+sim_printf ("%s event queue: %u activations, %u cancellations, %u events dispatched in %u msec\n",
+            eventq_types[sim_eventq_type], activations, cancellations, bench_fired, sim_os_msec () - start_msec);
+if ((r == SCPE_OK) && (bench_fired != expected))
+    r = sim_messagef (SCPE_IERR, "%u events dispatched - expected %u\n", bench_fired, expected);
+while (sim_clock_queue != QUEUE_LIST_END)
+    sim_cancel (sim_clock_queue);
+free (units);
+sim_scp_dev.dctrl = start_dctrl;
+return r;
+}
+
+/* Drive a pseudo-random schedule of activations, cancellations, sim_interval
+   overruns and changes of sim_time (as RESTORE makes), recording when each
+   event fires, so that the event queue implementations can be compared */
+
+#define SCHED_UNITS     16
+#define SCHED_STEPS     400000
+#define SCHED_LOG       (1 << 17)
+
+typedef struct SCHED_FIRE {
+    uint32              unit;
+    double              time;
+    } SCHED_FIRE;
+
+static UNIT *sched_units;
+static SCHED_FIRE *sched_log;
+static uint32 sched_fired;
+static uint32 sched_seed;
+
+static uint32 _sched_rand (uint32 *seed)
+{
+*seed = *seed * 1103515245 + 12345;
+return *seed >> 8;
+}
+
+static t_stat sim_scp_sched_svc (UNIT *uptr)
+{
+uint32 rnd = _sched_rand (&sched_seed);
+UNIT *optr = &sched_units[(rnd >> 4) % SCHED_UNITS];
+
+if (sched_fired < SCHED_LOG) {
+    sched_log[sched_fired].unit = (uint32)(uptr - sched_units);
+    sched_log[sched_fired].time = sim_gtime ();
+    }
+++sched_fired;
+switch (rnd % 16) {
+    case 0:                                             /* go idle */
+        break;
+    case 1:                                             /* same time */
+        sim_activate (uptr, 0);
+        break;
+    case 2:                                             /* cancel another */
+        sim_cancel (optr);
+        sim_activate (uptr, (rnd >> 8) % 50);
+        break;
+    case 3:                                             /* wake another */
+        if (!sim_is_active (optr))
+            sim_activate (optr, (int32)((rnd >> 8) % 3) - 1);
+        sim_activate (uptr, (rnd >> 8) % 300);
+        break;
+    default:
+        sim_activate (uptr, (rnd >> 8) % 200);
+        break;
+    }
+return SCPE_OK;
+}
+
+static t_stat _test_scp_event_schedule (int32 type, SCHED_FIRE *log, uint32 *fired, double *end_time)
+{
+uint32 i, step, seed = 1;
+t_stat r;
+
+r = _sim_eventq_set_type (type);
+while (sim_clock_queue != QUEUE_LIST_END)
+    sim_cancel (sim_clock_queue);
+sim_reset_time ();
+sched_log = log;
+sched_fired = 0;
+sched_seed = 12345;
+for (i = 0; (i < SCHED_UNITS) && (r == SCPE_OK); i++) {
+    sched_units[i].action = &sim_scp_sched_svc;
+    r = sim_activate (&sched_units[i], 3 * i);
+    }
+for (step = 0; (step < SCHED_STEPS) && (r == SCPE_OK); step++) {
+    uint32 rnd = _sched_rand (&seed);
+
+    if (sim_interval <= 0)
+        r = sim_process_event ();
+    if ((rnd % 16) == 0)                                /* long instruction */
+        sim_interval -= 1 + (int32)((rnd >> 4) % 40);
+    else
+        sim_interval -= 1;
+    if ((rnd % 97) == 0) {                              /* wake an idle unit */
+        UNIT *uptr = &sched_units[(rnd >> 4) % SCHED_UNITS];
+
+        if (!sim_is_active (uptr))
+            r = sim_activate (uptr, (rnd >> 8) % 100);
+        }
+    if (step == SCHED_STEPS / 2)                        /* restore a later save */
+        _sim_set_time (sim_time + 1000000.0);
+    if (step == (3 * SCHED_STEPS) / 4)                  /* restore an earlier save */
+        _sim_set_time (floor (sim_time / 3));
+    }
+*fired = sched_fired;
+*end_time = sim_gtime ();
+while (sim_clock_queue != QUEUE_LIST_END)
+    sim_cancel (sim_clock_queue);
+return r;
+}
+
+/* Verify that the HEAP event queue dispatches every event at exactly the
+   time that the LIST event queue does */
+
+static t_stat test_scp_event_queue_compare (void)
+{
+SCHED_FIRE *log[2];
+uint32 fired[2], i;
+double end_time[2];
+uint32 start_dctrl = sim_scp_dev.dctrl;
+int32 start_type = sim_eventq_type;
+t_stat r = SCPE_OK;
+
+sched_units = (UNIT *)calloc (SCHED_UNITS, sizeof (*sched_units));
+log[0] = (SCHED_FIRE *)calloc (SCHED_LOG, sizeof (SCHED_FIRE));
+log[1] = (SCHED_FIRE *)calloc (SCHED_LOG, sizeof (SCHED_FIRE));
+if ((sched_units == NULL) || (log[0] == NULL) || (log[1] == NULL))
+    r = SCPE_MEM;
+sim_scp_dev.dctrl = 0;
+if (r == SCPE_OK)
+    r = _test_scp_event_schedule (EVENTQ_LIST, log[0], &fired[0], &end_time[0]);
+if (r == SCPE_OK)
+    r = _test_scp_event_schedule (EVENTQ_HEAP, log[1], &fired[1], &end_time[1]);
+sim_scp_dev.dctrl = start_dctrl;
+if (r == SCPE_OK) {
+    for (i = 0; (i < fired[0]) && (i < fired[1]) && (i < SCHED_LOG); i++)
+        if ((log[0][i].unit != log[1][i].unit) || (log[0][i].time != log[1][i].time)) {
+            r = sim_messagef (SCPE_IERR, "Event %u: LIST fired unit %u at %.0f, HEAP fired unit %u at %.0f\n",
+                              i, log[0][i].unit, log[0][i].time, log[1][i].unit, log[1][i].time);
+            break;
+            }
+    if ((r == SCPE_OK) && ((fired[0] != fired[1]) || (end_time[0] != end_time[1])))
+        r = sim_messagef (SCPE_IERR, "LIST fired %u events ending at %.0f, HEAP fired %u events ending at %.0f\n",
+                          fired[0], end_time[0], fired[1], end_time[1]);
+    if (r == SCPE_OK)
+        sim_printf ("LIST and HEAP event queues fired %u events at identical times\n", fired[0]);
+    }
+_sim_eventq_set_type (start_type);
+free (sched_units);
+sched_units = NULL;
+free (log[0]);
+free (log[1]);
+return r;
+}
+
+/* Run the event sequencing tests and benchmark against each of the
+   event queue implementations */
+
+static t_stat test_scp_event_sequencing (void)
+{
+int32 start_type = sim_eventq_type;
+int32 type;
+t_stat r = SCPE_OK;
+
+for (type = EVENTQ_LIST; (type <= EVENTQ_HEAP) && (r == SCPE_OK); type++) {
+    r = _sim_eventq_set_type (type);
+    if (r != SCPE_OK)
+        break;
+    sim_printf ("Testing event sequencing with %s event queue\n", eventq_types[type]);
+    r = _test_scp_event_sequencing ();
+    if (r == SCPE_OK)
+        r = test_scp_event_queue_benchmark (4096);
+    }
+_sim_eventq_set_type (start_type);
+if (r == SCPE_OK)
+    r = test_scp_event_queue_compare ();
+return r;
+}
+
+/* Expect matcher: overlapping literal rules, RegEx rules and matches which
+   span buffer slides and matcher rebuilds */
+
+static const char *_test_scp_expect_feed (EXPECT *exp, const char *data, size_t size)
+{
+static char matched[CBUFSIZE];
+size_t i;
+
+matched[0] = '\0';
+for (i = 0; i < size; i++) {
+    const char *pattern;
+
+    unsetenv ("_EXPECT_MATCH_PATTERN");
+    sim_exp_check (exp, (uint8)data[i]);
+    pattern = getenv ("_EXPECT_MATCH_PATTERN");
+    if (pattern)
+        snprintf (matched + strlen (matched), sizeof (matched) - strlen (matched), "%s@%d ", pattern, (int)i);
+    }
+return matched;
+}
+
+static t_stat test_scp_expect (void)
+{
+EXPECT exp;
+char *filler = (char *)calloc (2048, 1);
+const char *matched;
+t_stat r = SCPE_OK;
+static struct {
+    const char *rules[4];
+    int32 regex;                                        /* mask of RegEx rules */
+    const char *data;
+    const char *expected;
+    } tests[] = {
+        {{"\"XYZ\"", "\"YZ\""},           0, "aXYZ",     "\"XYZ\"@3 "},  /* same end, lower rule wins */
+        {{"\"YZ\"", "\"XYZ\""},           0, "aXYZ",     "\"YZ\"@3 "},
+        {{"\"ABCD\"", "\"BC\""},          0, "ABCDBCD",  "\"BC\"@2 \"BC\"@5 "},
+        {{"\"ABAB\""},                   0, "AABABAB",  "\"ABAB\"@4 "}, /* via failure link, then restarts */
+        {{"\"Go\"", "\"[0-9]+ OK\""},     2, "x12 OKGo", "\"[0-9]+ OK\"@5 \"Go\"@7 "},
+        {{"\"OK\"", "\"[0-9]+ OK\""},     2, "x12 OK",   "\"OK\"@5 "},
+        {{"\"[0-9]+ OK\"", "\"OK\""},     1, "x12 OK",   "\"[0-9]+ OK\"@5 "},
+        {{"\"\\r\\n$ \""},                0, "\r\n$\r\n$ ", "\"\\r\\n$ \"@6 "},
+    };
+int t, i;
+
+sim_printf ("Testing expect matching\n");
+if (filler == NULL)
+    return SCPE_MEM;
+memset (filler, 'x', 2047);
+for (t = 0; (r == SCPE_OK) && (t < (int)(sizeof (tests) / sizeof (tests[0]))); t++) {
+    if ((tests[t].regex != 0) && !sim_pcre_regex_available)
+        continue;
+    sim_exp_init (&exp);
+    exp.dptr = &sim_scp_dev;
+    for (i = 0; (r == SCPE_OK) && (i < 4) && (tests[t].rules[i] != NULL); i++)
+        r = sim_exp_set (&exp, tests[t].rules[i], 1000, 0,
+                         (tests[t].regex & (1 << i)) ? EXP_TYP_REGEX : 0, NULL);
+    if (r == SCPE_OK) {
+        matched = _test_scp_expect_feed (&exp, tests[t].data, strlen (tests[t].data));
+        if (strcmp (matched, tests[t].expected) != 0)
+            r = sim_messagef (SCPE_IERR, "Expect test %d matched: %s, expected: %s\n", t, matched, tests[t].expected);
+        }
+    sim_exp_clrall (&exp);
+    }
+if (r == SCPE_OK) {                                     /* literal split by a matcher rebuild */
+    sim_exp_init (&exp);
+    exp.dptr = &sim_scp_dev;
+    r = sim_exp_set (&exp, "\"Password:\"", 1000, 0, 0, NULL);
+    if (r == SCPE_OK) {
+        _test_scp_expect_feed (&exp, filler, 100);
+        _test_scp_expect_feed (&exp, "login: HEL", 10);
+        r = sim_exp_set (&exp, "\"HELLO\"", 1000, 0, 0, NULL);
+        }
+    if (r == SCPE_OK) {
+        matched = _test_scp_expect_feed (&exp, "LO", 2);
+        if (strcmp (matched, "\"HELLO\"@1 ") != 0)
+            r = sim_messagef (SCPE_IERR, "Expect match across a rule change: %s\n", matched);
+        }
+    sim_exp_clrall (&exp);
+    }
+if ((r == SCPE_OK) && sim_pcre_regex_available) {       /* RegEx partial match across a buffer slide */
+    sim_exp_init (&exp);
+    exp.dptr = &sim_scp_dev;
+    r = sim_exp_set (&exp, "\"[0-9]+ OK\"", 1000, 0, EXP_TYP_REGEX, NULL);
+    if (r == SCPE_OK) {
+        size_t pre = exp.rbuf_size - 3;
+
+        matched = _test_scp_expect_feed (&exp, filler, pre);
+        if (matched[0] == '\0') {
+            filler[0] = '1';
+            filler[1] = '2';
+            filler[2] = '3';
+            filler[3] = '4';
+            strcpy (&filler[4], " OK");
+            matched = _test_scp_expect_feed (&exp, filler, 7);
+            }
+        if (strcmp (matched, "\"[0-9]+ OK\"@6 ") != 0)
+            r = sim_messagef (SCPE_IERR, "Expect RegEx match across a buffer slide: %s\n", matched);
+        else if (strcmp (getenv ("_EXPECT_MATCH_GROUP_0") ? getenv ("_EXPECT_MATCH_GROUP_0") : "", "1234 OK") != 0)
+            r = sim_messagef (SCPE_IERR, "Expect RegEx match group: %s\n", getenv ("_EXPECT_MATCH_GROUP_0"));
+        }
+    sim_exp_clrall (&exp);
+    }
+unsetenv ("_EXPECT_MATCH_PATTERN");
+free (filler);
+return r;
+}
+
+static t_stat test_scp_save_compression (void)
+{
+static const size_t sizes[] = {0, 1, 12, 13, 100, 4096, 32768};
+uint8 *src = (uint8 *)malloc (32768);
+uint8 *cmp = (uint8 *)malloc (2 * 32768);
+uint8 *out = (uint8 *)malloc (32768);
+uint32 pattern, s, i, seed = 1;
+t_stat r = SCPE_OK;
+
+if ((src == NULL) || (cmp == NULL) || (out == NULL)) {
+    free (src);
+    free (cmp);
+    free (out);
+    return SCPE_MEM;
+    }
+sim_printf ("Testing SAVE/RESTORE memory page compression\n");
+for (pattern = 0; (pattern < 4) && (r == SCPE_OK); pattern++) {
+    for (i = 0; i < 32768; i++) {
+        seed = seed * 1103515245 + 12345;
+        switch (pattern) {
+            case 0:                                     /* constant */
+                src[i] = 0x55;
+                break;
+            case 1:                                     /* repeating words */
+                src[i] = (uint8)((i % 6) * 17);
+                break;
+            case 2:                                     /* sparse random */
+                src[i] = ((seed >> 16) & 7) ? 0 : (uint8)(seed >> 24);
+                break;
+            default:                                    /* random */
+                src[i] = (uint8)(seed >> 24);
+                break;
+            }
+        }
+    for (s = 0; (s < sizeof (sizes) / sizeof (sizes[0])) && (r == SCPE_OK); s++) {
+        size_t clen = sim_lz_compress (src, sizes[s], cmp, 2 * 32768);
+
+        memset (out, 0xFF, 32768);
+        if ((clen == 0) ||
+            (!sim_lz_decompress (cmp, clen, out, sizes[s])) ||
+            (memcmp (src, out, sizes[s]) != 0)) {
+            sim_printf ("Compression round trip failed: pattern %u, %u bytes\n", pattern, (uint32)sizes[s]);
+            r = SCPE_IERR;
+            break;
+            }
+        if ((clen > 1) &&
+            (sim_lz_decompress (cmp, clen - 1, out, sizes[s]))) {
+            sim_printf ("Truncated compressed data not detected: pattern %u, %u bytes\n", pattern, (uint32)sizes[s]);
+            r = SCPE_IERR;
+            break;
+            }
+        if ((sizes[s] == 32768) && (pattern < 3) &&
+            (sim_lz_compress (src, sizes[s], cmp, sizes[s] - 1) == 0)) {
+            sim_printf ("Compressible data not compressed: pattern %u\n", pattern);
+            r = SCPE_IERR;
+            break;
+            }
+        }
+    }
+if (r == SCPE_OK) {
+    memset (out, 0, 32768);
+    out[32767] = 1;
+    if ((!_sim_save_page_zero (out, 32767)) || _sim_save_page_zero (out, 32768)) {
+        sim_printf ("Page zero detection failed\n");
+        r = SCPE_IERR;
+        }
+    }
+free (src);
+free (cmp);
+free (out);
+return r;
+}
+
+/* Incremental SAVE and RESTORE round trip of the first device's memory */
+
+static t_stat test_scp_save_incremental (void)
+{
+static const char *files[] = {"SaveTest-Base.sav", "SaveTest-Incr.sav"};
+static const t_value values[3][2] = {{012, 021},        /* changed after base */
+                                     {034, 034},        /* unchanged */
+                                     {056, 056}};       /* changed and restored */
+DEVICE *dptr = sim_devices[0];
+UNIT *uptr = dptr->units;
+t_addr addr[3];
+t_value orig[3], val;
+int32 saved_quiet = sim_quiet;
+int32 saved_switches = sim_switches;
+char cmd[CBUFSIZE];
+int i;
+t_stat r = SCPE_OK;
+
+if ((uptr == NULL) || (dptr->examine == NULL) || (dptr->deposit == NULL) ||
+    ((uptr->flags & (UNIT_FIX + UNIT_ATTABLE)) != UNIT_FIX) ||
+    (uptr->capac < (t_addr)(3 * SRPAGE * dptr->aincr)))
+    return SCPE_OK;                                     /* no memory to test */
+sim_printf ("Testing incremental SAVE/RESTORE\n");
+for (i = 0; i < 3; i++) {                               /* one word in each of 3 pages */
+    addr[i] = (t_addr)((i * SRPAGE + i) * dptr->aincr);
+    if (r == SCPE_OK)
+        r = dptr->examine (&orig[i], addr[i], uptr, 0);
+    if (r == SCPE_OK)
+        r = dptr->deposit (values[i][0], addr[i], uptr, 0);
+    }
+sim_quiet = 1;
+if (r == SCPE_OK) {
+    sim_switches = 0;
+    r = save_cmd (0, files[0]);
+    }
+for (i = 0; (i < 3) && (r == SCPE_OK); i++) {
+    if (i == 2)                                         /* changed then changed back */
+        r = dptr->deposit (~values[i][0] & 077, addr[i], uptr, 0);
+    if (r == SCPE_OK)
+        r = dptr->deposit (values[i][1], addr[i], uptr, 0);
+    }
+if (r == SCPE_OK) {
+    sprintf (cmd, "-I %s", files[1]);
+    r = save_cmd (0, cmd);
+    }
+for (i = 0; (i < 3) && (r == SCPE_OK); i++)             /* clobber */
+    r = dptr->deposit (077, addr[i], uptr, 0);
+if (r == SCPE_OK)
+    r = restore_cmd (0, files[1]);
+sim_quiet = saved_quiet;
+sim_switches = saved_switches;
+if (r != SCPE_OK)
+    r = sim_messagef (SCPE_IERR, "Incremental SAVE/RESTORE failed: %s\n", sim_error_text (r));
+for (i = 0; (i < 3) && (r == SCPE_OK); i++) {
+    r = dptr->examine (&val, addr[i], uptr, 0);
+    if ((r == SCPE_OK) && (val != values[i][1]))
+        r = sim_messagef (SCPE_IERR, "Restored memory at %X is %X, expected %X\n", (uint32)addr[i], (uint32)val, (uint32)values[i][1]);
+    }
+for (i = 0; i < 3; i++)
+    dptr->deposit (orig[i], addr[i], uptr, 0);
+for (i = 0; i < 2; i++)
+    (void)remove (files[i]);
+return r;
+}
+
+static void _test_debug_binary_events (void)
+{
+char buf[16] = "buffer";
+char fmt[32];
+
+sim_debug (1, &sim_scp_dev, "%d %5u %-4x|%08X %o %hd %hhu\n", -42, 17u, 0xABu, 0xDEADBEEFu, 0777u, (short)-3, (unsigned char)200);
+sim_debug (1, &sim_scp_dev, "%s|%10s|%-3s|%.2s|%c%c %%\n", "str", "right", "l", "truncated", 'o', 'k');
+sim_debug (1, &sim_scp_dev, "%*d|%-*d|%.*f|%*.*s|\n", 6, 12, 4, 3, 2, 3.14159, 8, 3, "abcdef");
+sim_debug (1, &sim_scp_dev, "%ld %lu %" LL_FMT "d %" LL_FMT "x\n", -123456789L, 123456789UL, (LL_TYPE)-1234567890, (LL_TYPE)0x12345678);
+sim_debug (1, &sim_scp_dev, "%g %e %.3f %p\n", 1.5, 12345.678, -0.0005, (void *)buf);
+sim_debug (1, &sim_scp_dev, "unterminated ");
+sim_debug (1, &sim_scp_dev, "continued %s\n", buf);
+sim_debug (1, &sim_scp_dev, "line1\nline2 %u\n", 2u);
+strcpy (fmt, "reused %d\n");                           /* different formats at one address */
+sim_debug (1, &sim_scp_dev, fmt, 7);
+strcpy (fmt, "reused %s|%x\n");
+sim_debug (1, &sim_scp_dev, fmt, "again", 0xBEEFu);
+}
+
+/* Record the same debug events as text and as a binary trace and verify
+   that decoding the binary trace produces identical text */
+
+static t_stat test_scp_debug_binary (void)
+{
+static const char *files[] = {"DebugTestFile.txt", "DebugTestFile.bin", "DebugTestFile.dec"};
+FILE *saved_deb = sim_deb;
+int32 saved_deb_switches = sim_deb_switches;
+uint32 saved_dctrl = sim_scp_dev.dctrl;
+int32 saved_quiet = sim_quiet;
+char *data[2] = {NULL, NULL};
+uint32 size[2] = {0, 0};
+char cmd[CBUFSIZE];
+t_stat r = SCPE_OK;
+int i;
+
+sim_printf ("Testing binary debug trace recording and decoding\n");
+sim_scp_dev.dctrl = 1;
+for (i = 0; (i < 2) && (r == SCPE_OK); i++) {
+    sim_deb = sim_fopen (files[i], "wb");
+    if (sim_deb == NULL) {
+        r = sim_messagef (SCPE_OPENERR, "Can't create %s\n", files[i]);
+        break;
+        }
+    sim_deb_switches = SWMASK ('F') | (i ? SWMASK ('Z') : 0);
+    debug_unterm = 0;
+    if (i)
+        sim_debug_binary_start ();
+    _test_debug_binary_events ();
+    fclose (sim_deb);
+    }
+sim_deb = saved_deb;
+sim_deb_switches = saved_deb_switches;
+sim_scp_dev.dctrl = saved_dctrl;
+debug_unterm = 0;
+if (r == SCPE_OK) {
+    sprintf (cmd, "%s %s", files[1], files[2]);
+    sim_quiet = 1;
+    r = debug_decode_cmd (0, cmd);
+    sim_quiet = saved_quiet;
+    }
+for (i = 0; (i < 2) && (r == SCPE_OK); i++) {
+    FILE *f = sim_fopen (files[i ? 2 : 0], "rb");
+
+    size[i] = sim_fsize_name (files[i ? 2 : 0]);
+    data[i] = (char *)calloc (size[i] + 1, 1);
+    if ((f == NULL) || (data[i] == NULL) || (fread (data[i], 1, size[i], f) != size[i]))
+        r = sim_messagef (SCPE_IERR, "Can't read %s\n", files[i ? 2 : 0]);
+    if (f)
+        fclose (f);
+    }
+if ((r == SCPE_OK) && ((size[0] != size[1]) || (memcmp (data[0], data[1], size[0]) != 0)))
+    r = sim_messagef (SCPE_IERR, "Decoded binary trace differs from text trace:\n%s\nvs:\n%s\n", data[0], data[1]);
+free (data[0]);
+free (data[1]);
+for (i = 0; i < 3; i++)
+    (void)remove (files[i]);
+return r;
+}
+
+/* Performance counter registry, accumulation and dump file test */
+
+static t_stat test_scp_perf (void)
+{
+static UNIT perf_test_unit = { UDATA (NULL, 0, 0) };
+static DEVICE perf_test_dev = {
+    "PERFTEST", &perf_test_unit, NULL, NULL,
+    1, 0, 0, 0, 0, 0,
+    NULL, NULL, NULL, NULL, NULL, NULL,
+    NULL, DEV_NOSAVE, 0};
+const char *file = "PerfTestFile.csv";
+t_bool saved_enabled = sim_perf_enabled;
+t_bool saved_json = sim_perf_dump_json;
+FILE *saved_dump = sim_perf_dump;
+char saved_dump_name[CBUFSIZE];
+uint32 saved_interval = sim_perf_dump_interval;
+double saved_start_time = sim_perf_start_time;
+SIM_PERF *saved_ctrs = NULL;
+uint32 saved_count = 0;
+SIM_PERF *ev, *by, *lat, *ctr;
+char *data = NULL;
+uint32 size, i;
+FILE *f;
+t_stat r = SCPE_OK;
+
+sim_printf ("Testing performance counters\n");
+/* Set aside the user's counter values and dump file */
+strlcpy (saved_dump_name, sim_perf_dump_name, sizeof (saved_dump_name));
+for (ctr = sim_perf_list; ctr != NULL; ctr = ctr->next)
+    ++saved_count;
+if (saved_count > 0) {
+    saved_ctrs = (SIM_PERF *)malloc (saved_count * sizeof (*saved_ctrs));
+    if (saved_ctrs == NULL)
+        return SCPE_MEM;
+    for (i = 0, ctr = sim_perf_list; i < saved_count; i++, ctr = ctr->next)
+        saved_ctrs[i] = *ctr;
+    }
+_sim_perf_cancel ();
+sim_perf_dump = NULL;
+(void)remove (file);
+sim_set_perf (1, "ENABLED,RESET");
+ev = sim_perf_counter (&perf_test_dev, "EVENTS", SIM_PERF_EVENTS, "Test events");
+by = sim_perf_counter (&perf_test_dev, "BYTES", SIM_PERF_BYTES, "Test transfers");
+lat = sim_perf_counter (&perf_test_dev, "LATENCY", SIM_PERF_LATENCY, "Test latencies");
+if ((ev == NULL) || (by == NULL) || (lat == NULL) ||
+    (ev != sim_perf_counter (&perf_test_dev, "EVENTS", SIM_PERF_EVENTS, "Test events")) ||
+    (ev == by))
+    r = sim_messagef (SCPE_IERR, "Counter registration failed\n");
+SIM_PERF_ADD (ev, 3);
+SIM_PERF_ADD (ev, 2);
+SIM_PERF_ADD (by, 100);
+SIM_PERF_ADD (by, 300);
+SIM_PERF_ADD (lat, 0);                                  /* < 1 usec */
+SIM_PERF_ADD (lat, 1);                                  /* 1 usec */
+SIM_PERF_ADD (lat, 5);                                  /* 4 to 7 usecs */
+sim_set_perf (1, "DISABLED");
+SIM_PERF_ADD (ev, 1);                                   /* not counted */
+if ((r == SCPE_OK) && (ev->count != 5))
+    r = sim_messagef (SCPE_IERR, "Events counted: %" LL_FMT "u, expected 5\n", ev->count);
+if ((r == SCPE_OK) && ((by->count != 2) || (by->total != 400) || (by->max != 300)))
+    r = sim_messagef (SCPE_IERR, "Bytes counted: %" LL_FMT "u/%" LL_FMT "u/%" LL_FMT "u, expected 2/400/300\n", by->count, by->total, by->max);
+if ((r == SCPE_OK) && ((lat->count != 3) || (lat->hist[0] != 1) || (lat->hist[1] != 1) || (lat->hist[3] != 1)))
+    r = sim_messagef (SCPE_IERR, "Latency histogram is wrong\n");
+if (r == SCPE_OK)
+    r = sim_set_perf (1, "FORMAT=CSV,DUMP=PerfTestFile.csv");
+sim_set_perf (0, NULL);                                 /* close with a final snapshot */
+if (r == SCPE_OK) {
+    size = (uint32)sim_fsize_name (file);
+    data = (char *)calloc (size + 1, 1);
+    f = sim_fopen (file, "rb");
+    if ((f == NULL) || (data == NULL) || (fread (data, 1, size, f) != size))
+        r = sim_messagef (SCPE_IERR, "Can't read %s\n", file);
+    if (f)
+        fclose (f);
+    }
+if ((r == SCPE_OK) &&
+    ((strncmp (data, "seconds,device,counter,type,count,total,max", 43) != 0) ||
+     (strstr (data, ",PERFTEST,BYTES,bytes,2,400,300") == NULL) ||
+     (strstr (data, ",PERFTEST,EVENTS,events,5,0,0") == NULL)))
+    r = sim_messagef (SCPE_IERR, "Unexpected dump file contents:\n%s\n", data);
+free (data);
+(void)remove (file);
+_sim_perf_release (&perf_test_dev);                     /* keep PERFTEST out of later SHOW PERF */
+sim_set_perf (1, "RESET");
+/* Counters registered before the test are still at the head of the list */
+for (i = 0, ctr = sim_perf_list; (i < saved_count) && (ctr != NULL); i++, ctr = ctr->next) {
+    ctr->count = saved_ctrs[i].count;
+    ctr->total = saved_ctrs[i].total;
+    ctr->max = saved_ctrs[i].max;
+    memcpy (ctr->hist, saved_ctrs[i].hist, sizeof (ctr->hist));
+    }
+free (saved_ctrs);
+sim_perf_start_time = saved_start_time;
+sim_perf_dump_json = saved_json;
+sim_perf_dump_interval = saved_interval;
+strlcpy (sim_perf_dump_name, saved_dump_name, sizeof (sim_perf_dump_name));
+sim_perf_dump = saved_dump;
+if (sim_is_running)
+    _sim_perf_sched ();
+sim_perf_enabled = saved_enabled;
+return r;
+}
+
+/* Profiler sample accumulation, symbol attribution and folded stack test */
+
+static t_stat test_scp_profile (void)
+{
+static const t_addr pcs[] = {0x1000, 0x1004, 0x1004, 0x2010, 0x1008, 0x1004};
+static const t_addr stack[] = {0x1004, 0x2020};
+const char *symfile = "ProfileTestFile.sym";
+const char *foldfile = "ProfileTestFile.folded";
+PROF_ENTRY *ent;
+uint32 i, n;
+char line[CBUFSIZE];
+int32 saved_quiet = sim_quiet;
+FILE *f;
+t_stat r = SCPE_OK;
+
+sim_printf ("Testing guest code profiler\n");
+_sim_prof_reset ();
+for (i = 0; i < sizeof (pcs) / sizeof (pcs[0]); i++)
+    _sim_prof_record (pcs[i]);
+for (i = 0; i < 20000; i++)                             /* force the table to grow */
+    _sim_prof_record ((t_addr)(0x100000 + 4 * i));
+_sim_prof_record_stack (stack, 2);
+_sim_prof_record_stack (stack, 2);
+ent = _sim_prof_collect (PROF_BY_ADDR, 0, &n);
+if ((ent == NULL) || (n != 20004) || (ent[0].addr != 0x1004) || (ent[0].count != 3) || (sim_prof_samples != 20006))
+    r = sim_messagef (SCPE_IERR, "Address profile is wrong\n");
+free (ent);
+ent = _sim_prof_collect (PROF_BY_RANGE, 0x1000, &n);
+if ((r == SCPE_OK) && ((ent == NULL) || (ent[0].addr != 0x100000) || (ent[0].count != 1024)))
+    r = sim_messagef (SCPE_IERR, "Address range profile is wrong\n");
+free (ent);
+f = sim_fopen (symfile, "w");
+if (f == NULL)
+    r = sim_messagef (SCPE_OPENERR, "Can't create %s\n", symfile);
+else {
+    fprintf (f, "# test symbols\n%s main\n%s T helper\n U undefined\n",
+                (sim_PC && (sim_PC->radix == 8)) ? "10000" : "1000",
+                (sim_PC && (sim_PC->radix == 8)) ? "20000" : "2000");
+    fclose (f);
+    }
+sim_quiet = 1;
+if (r == SCPE_OK)
+    r = _sim_prof_load_syms (symfile);
+sim_quiet = saved_quiet;
+if ((r == SCPE_OK) && (sim_prof_sym_count != 2))
+    r = sim_messagef (SCPE_IERR, "%u symbols loaded, expected 2\n", sim_prof_sym_count);
+if (r == SCPE_OK) {
+    ent = _sim_prof_collect (PROF_BY_SYMBOL, 0, &n);
+    if ((ent == NULL) || (n != 2) ||
+        (ent[0].addr != 1) || (ent[0].count != 20001) ||   /* everything above helper is in helper */
+        (ent[1].addr != 0) || (ent[1].count != 5))
+        r = sim_messagef (SCPE_IERR, "Symbol profile is wrong\n");
+    free (ent);
+    }
+sim_quiet = 1;
+if (r == SCPE_OK)
+    r = _sim_prof_write_folded (foldfile);
+sim_quiet = saved_quiet;
+if (r == SCPE_OK) {
+    f = sim_fopen (foldfile, "r");
+    if ((f == NULL) || (fgets (line, sizeof (line), f) == NULL) ||
+        (strncmp (line, "helper+", 7) != 0) || (strstr (line, ";main+") == NULL) || (strstr (line, " 2") == NULL))
+        r = sim_messagef (SCPE_IERR, "Unexpected folded stack output: %s\n", line);
+    if (f)
+        fclose (f);
+    }
+_sim_prof_reset ();
+_sim_prof_free_syms ();
+(void)remove (symfile);
+(void)remove (foldfile);
+return r;
+}
+
+static const char *test_opstats_name (uint32 op)
+{
+static const char *names[] = {"ONE", "TWO", "ONE", NULL};
+
+return names[op];
+}
+
+static uint32 test_opstats_class (uint32 op)
+{
+return op & 1;
+}
+
+static t_stat test_scp_opstats (void)
+{
+static const char * const classes[] = {"Even", "Odd"};
+static const uint32 ops[] = {0, 1, 2, 2, 3, 0, 7};
+SIM_OPSTATS os = {4, &test_opstats_name, &test_opstats_class, classes, 2};
+char line[CBUFSIZE];
+int32 saved_quiet = sim_quiet;
+t_bool seen_one = FALSE, seen_numeric = FALSE, seen_range = FALSE;
+t_stat show;
+uint32 i;
+FILE *f;
+t_stat r = SCPE_OK;
+
+sim_printf ("Testing per-opcode statistics\n");
+SIM_OPSTATS_COUNT (&os, 0);                             /* disabled: not counted */
+sim_quiet = 1;
+if (sim_set_opstats (NULL, 1, "BOGUS", &os) == SCPE_OK)
+    r = sim_messagef (SCPE_IERR, "Invalid OPSTATS mode accepted\n");
+sim_quiet = saved_quiet;
+if ((r == SCPE_OK) && (sim_set_opstats (NULL, 1, "TIMING", &os) != SCPE_OK))
+    r = sim_messagef (SCPE_IERR, "SET OPSTATS=TIMING failed\n");
+if (r == SCPE_OK) {
+    for (i = 0; i < sizeof (ops) / sizeof (ops[0]); i++)
+        SIM_OPSTATS_COUNT (&os, ops[i]);                /* out of range op ignored */
+    if ((os.count[0] != 2) || (os.count[1] != 1) || (os.count[2] != 2) || (os.count[3] != 1) ||
+        (os.out_of_range != 1))
+        r = sim_messagef (SCPE_IERR, "Opcode counts are wrong\n");
+    }
+if (r == SCPE_OK) {
+    f = tmpfile ();
+    if (f == NULL)
+        r = sim_messagef (SCPE_OPENERR, "Can't create temporary file\n");
+    else {
+        show = sim_show_opstats (f, NULL, 0, &os);
+        rewind (f);
+        while (fgets (line, sizeof (line), f)) {
+            if (strncmp (line, "  ONE ", 6) == 0)
+                seen_one = (strstr (line, " 4 ") != NULL);
+            if (strncmp (line, "  3 ", 4) == 0)
+                seen_numeric = TRUE;
+            if (strncmp (line, "1 instructions with opcode indexes beyond 4", 43) == 0)
+                seen_range = TRUE;
+            }
+        fclose (f);
+        if (!seen_one || !seen_numeric || !seen_range || (show != SCPE_IERR))
+            r = sim_messagef (SCPE_IERR, "Opcode statistics report is wrong\n");
+        }
+    }
+if ((r == SCPE_OK) &&
+    ((sim_set_opstats (NULL, 0, NULL, &os) != SCPE_OK) ||
+     (sim_set_opstats (NULL, 1, "RESET", &os) != SCPE_OK)))
+    r = sim_messagef (SCPE_IERR, "SET NOOPSTATS or OPSTATS=RESET failed\n");
+if (r == SCPE_OK) {
+    SIM_OPSTATS_COUNT (&os, 1);
+    if (os.enabled || (os.count[0] != 0) || (os.count[1] != 0) || (os.out_of_range != 0))
+        r = sim_messagef (SCPE_IERR, "Opcode statistics not reset or still enabled\n");
+    }
+free (os.count);
+free (os.ns);
+return r;
+}
+
+#if defined (SIM_ASYNCH_IO)
+/* I/O worker pool test: several units each with many outstanding
+   requests must have their requests performed and completed in the
+   order they were submitted */
+
+#define AIO_TEST_UNITS      4
+#define AIO_TEST_REQUESTS   50
+
+typedef struct {
+    SIM_AIO_REQ         hdr;
+    uint32              seq;
+    } AIO_TEST_REQ;
+
+static SIM_AIO_UNITQ *_aio_test_q[AIO_TEST_UNITS];
+static uint32 _aio_test_performed[AIO_TEST_UNITS];
+static uint32 _aio_test_completed[AIO_TEST_UNITS];
+static uint32 _aio_test_errors;
+
+static void _aio_test_perform (UNIT *uptr, SIM_AIO_REQ *hdr)
+{
+AIO_TEST_REQ *req = (AIO_TEST_REQ *)hdr;
+int u = (int)(uptr - sim_scp_dev.units);
+
+if (req->seq != _aio_test_performed[u] + 1)
+    ++_aio_test_errors;
+_aio_test_performed[u] = req->seq;
+if ((req->seq % 8) == 0)
+    sim_os_ms_sleep (1);
+}
+
+static void _aio_test_completion (UNIT *uptr)
+{
+int u = (int)(uptr - sim_scp_dev.units);
+AIO_TEST_REQ *req;
+
+while ((req = (AIO_TEST_REQ *)sim_aio_complete (_aio_test_q[u]))) {
+    if (req->seq != _aio_test_completed[u] + 1)
+        ++_aio_test_errors;
+    _aio_test_completed[u] = req->seq;
+    free (req);
+    }
+}
+
+static t_stat test_scp_aio_pool (void)
+{
+uint32 u, s, done = 0;
+uint32 start = sim_os_msec ();
+t_stat r = SCPE_OK;
+
+if (!sim_asynch_enabled)
+    return SCPE_OK;
+sim_printf ("Testing asynchronous I/O worker pool\n");
+_aio_test_errors = 0;
+for (u = 0; u < AIO_TEST_UNITS; u++) {
+    UNIT *uptr = &sim_scp_dev.units[u];
+
+    uptr->action = sim_scp_svc;
+    uptr->a_check_completion = _aio_test_completion;
+    _aio_test_performed[u] = _aio_test_completed[u] = 0;
+    _aio_test_q[u] = sim_aio_unitq_create (uptr, _aio_test_perform);
+    if (_aio_test_q[u] == NULL)
+        return SCPE_MEM;
+    }
+for (s = 1; s <= AIO_TEST_REQUESTS; s++)
+    for (u = 0; u < AIO_TEST_UNITS; u++) {
+        AIO_TEST_REQ *req = (AIO_TEST_REQ *)calloc (1, sizeof (*req));
+
+        if (req == NULL)
+            return SCPE_MEM;
+        req->seq = s;
+        sim_aio_submit (_aio_test_q[u], &req->hdr, 0);
+        }
+while ((done < AIO_TEST_UNITS) && ((sim_os_msec () - start) < 10000)) {
+    sim_aio_update_queue ();
+    for (u = done = 0; u < AIO_TEST_UNITS; u++)
+        if (_aio_test_completed[u] == AIO_TEST_REQUESTS)
+            ++done;
+    if (done < AIO_TEST_UNITS)
+        sim_os_ms_sleep (1);
+    }
+for (u = 0; u < AIO_TEST_UNITS; u++) {
+    UNIT *uptr = &sim_scp_dev.units[u];
+
+    if (sim_aio_busy (_aio_test_q[u]) ||
+        (_aio_test_completed[u] != AIO_TEST_REQUESTS))
+        r = sim_messagef (SCPE_IERR, "%s: %u of %d requests completed\n", sim_uname (uptr), _aio_test_completed[u], AIO_TEST_REQUESTS);
+    sim_aio_unitq_free (_aio_test_q[u]);
+    _aio_test_q[u] = NULL;
+    uptr->a_check_completion = NULL;
+    sim_cancel (uptr);
+    }
+if (_aio_test_errors)
+    r = sim_messagef (SCPE_IERR, "%u requests performed or completed out of order\n", _aio_test_errors);
+return r;
+}
+
+/* Asynchronous completion delivery test: completions are delivered in
+   the order they happened, and a coalescing device has completions
+   which arrive within its interval held and merged */
+
+static int _aio_delivery_order[8];
+static int _aio_delivery_count;
+static int _aio_delivery_units[8];
+static int _aio_delivery_activations;
+
+static void _aio_delivery_completion (UNIT *uptr)
+{
+if (_aio_delivery_count < 8)
+    _aio_delivery_order[_aio_delivery_count] = (int)(uptr - sim_scp_dev.units);
+++_aio_delivery_count;
+}
+
+static void *_aio_delivery_thread (void *arg)
+{
+int i;
+
+for (i = 0; i < _aio_delivery_activations; i++)
+    sim_activate (&sim_scp_dev.units[_aio_delivery_units[i]], 10);
+return NULL;
+}
+
+/* Have another thread complete I/O on the listed units, then deliver */
+
+static int _aio_delivery_run (int count, const int *units)
+{
+pthread_t thread;
+
+memcpy (_aio_delivery_units, units, count * sizeof (*units));
+_aio_delivery_activations = count;
+_aio_delivery_count = 0;
+pthread_create (&thread, NULL, _aio_delivery_thread, NULL);
+pthread_join (thread, NULL);
+return sim_aio_update_queue ();
+}
+
+static t_stat test_scp_aio_delivery (void)
+{
+static const int arrival[] = {2, 0, 3, 1};
+static const int first[] = {0};
+static const int burst[] = {1, 0, 1, 1};
+uint32 u;
+int i;
+t_stat r = SCPE_OK;
+
+if (!sim_asynch_enabled)
+    return SCPE_OK;
+sim_printf ("Testing asynchronous completion delivery\n");
+for (u = 0; u < sim_scp_dev.numunits; u++) {
+    sim_scp_dev.units[u].action = sim_scp_svc;
+    sim_scp_dev.units[u].a_check_completion = _aio_delivery_completion;
+    }
+if ((_aio_delivery_run (4, arrival) != 4) || (_aio_delivery_count != 4))
+    r = sim_messagef (SCPE_IERR, "%d of 4 completions delivered\n", _aio_delivery_count);
+for (i = 0; (r == SCPE_OK) && (i < 4); i++)
+    if (_aio_delivery_order[i] != arrival[i])
+        r = sim_messagef (SCPE_IERR, "Completion %d delivered for unit %d rather than unit %d\n", i, _aio_delivery_order[i], arrival[i]);
+if (r == SCPE_OK)
+    r = sim_aio_coalesce_set (&sim_scp_dev, 1000000);
+if ((r == SCPE_OK) && (_aio_delivery_run (1, first) != 1))
+    r = sim_messagef (SCPE_IERR, "First coalesced completion wasn't delivered\n");
+if ((r == SCPE_OK) && (_aio_delivery_run (4, burst) != 0))
+    r = sim_messagef (SCPE_IERR, "Completions within the coalescing interval weren't held\n");
+if ((r == SCPE_OK) && !sim_is_active (&sim_scp_dev.units[1]))
+    r = sim_messagef (SCPE_IERR, "Held completion isn't pending\n");
+if ((r == SCPE_OK) && (sim_aio_coalesce_flush (NULL) != 2))
+    r = sim_messagef (SCPE_IERR, "Held completions weren't merged\n");
+if ((r == SCPE_OK) && ((_aio_delivery_order[0] != 1) || (_aio_delivery_order[1] != 0)))
+    r = sim_messagef (SCPE_IERR, "Held completions delivered out of order\n");
+sim_aio_coalesce_set (&sim_scp_dev, 0);
+for (u = 0; u < sim_scp_dev.numunits; u++) {
+    sim_scp_dev.units[u].a_check_completion = NULL;
+    sim_cancel (&sim_scp_dev.units[u]);
+    }
+return r;
+}
+#endif
+
 /*
  * Compiled in unit tests for the various device oriented library
  * modules: sim_card, sim_disk, sim_tape, sim_ether, sim_tmxr, etc.
@@ -17632,6 +22637,26 @@ if ((strcmp (gbuf, "ALL") == 0) || (strcmp (gbuf, "SCP") == 0)) {
         return sim_messagef (SCPE_IERR, "SCP argument parsing test failed\n");
     if (test_scp_event_sequencing () != SCPE_OK)
         return sim_messagef (SCPE_IERR, "SCP event sequencing test failed\n");
+    if (test_scp_expect () != SCPE_OK)
+        return sim_messagef (SCPE_IERR, "SCP expect matching test failed\n");
+    if (test_scp_save_compression () != SCPE_OK)
+        return sim_messagef (SCPE_IERR, "SCP save compression test failed\n");
+    if (test_scp_save_incremental () != SCPE_OK)
+        return sim_messagef (SCPE_IERR, "SCP incremental save test failed\n");
+    if (test_scp_perf () != SCPE_OK)
+        return sim_messagef (SCPE_IERR, "SCP performance counter test failed\n");
+    if (test_scp_profile () != SCPE_OK)
+        return sim_messagef (SCPE_IERR, "SCP profiler test failed\n");
+    if (test_scp_opstats () != SCPE_OK)
+        return sim_messagef (SCPE_IERR, "SCP opcode statistics test failed\n");
+    if (test_scp_debug_binary () != SCPE_OK)
+        return sim_messagef (SCPE_IERR, "SCP binary debug trace test failed\n");
+#if defined (SIM_ASYNCH_IO)
+    if (test_scp_aio_pool () != SCPE_OK)
+        return sim_messagef (SCPE_IERR, "SCP asynchronous I/O worker pool test failed\n");
+    if (test_scp_aio_delivery () != SCPE_OK)
+        return sim_messagef (SCPE_IERR, "SCP asynchronous completion delivery test failed\n");
+#endif
     }
 for (i = 0; (dptr = sim_devices[i]) != NULL; i++) {
     t_stat tstat = SCPE_OK;
@@ -120,6 +120,8 @@ t_stat runlimit_cmd (int32 flag, CONST char *ptr);
 t_stat tar_cmd (int32 flag, CONST char *ptr);
 t_stat curl_cmd (int32 flag, CONST char *ptr);
 t_stat test_lib_cmd (int32 flag, CONST char *ptr);
+t_stat debug_decode_cmd (int32 flag, CONST char *ptr);
+t_stat profile_cmd (int32 flag, CONST char *ptr);
 
 /* Allow compiler to help validate printf style format arguments */
 #if !defined __GNUC__
@@ -215,6 +217,9 @@ DEVICE *find_dev (const char *ptr);
 DEVICE *find_unit (const char *ptr, UNIT **uptr);
 DEVICE *find_dev_from_unit (UNIT *uptr);
 t_stat sim_register_internal_device (DEVICE *dptr);
+t_stat sim_register_memory (UNIT *uptr, void **mem);
+size_t sim_lz_compress (const uint8 *src, size_t slen, uint8 *dst, size_t dmax);
+t_bool sim_lz_decompress (const uint8 *src, size_t slen, uint8 *dst, size_t dlen);
 void sim_sub_args (char *in_str, size_t in_str_size, char *do_arg[]);
 REG *find_reg (CONST char *ptr, CONST char **optr, DEVICE *dptr);
 CTAB *find_ctab (CTAB *tab, const char *gbuf);
@@ -224,6 +229,19 @@ t_stat get_aval (t_addr addr, DEVICE *dptr, UNIT *uptr);
 t_value get_rval (REG *rptr, uint32 idx);
 BRKTAB *sim_brk_fnd (t_addr loc);
 uint32 sim_brk_test (t_addr bloc, uint32 btyp);
+
+/* Breakpoint address filter
+
+   sim_brk_filter has a bit set for the hash of every address which has a
+   breakpoint of any type.  sim_brk_maybe (loc) is a single bit test that
+   simulators can use ahead of sim_brk_test in instruction fetch and data
+   access paths.  A zero result guarantees that no breakpoint exists at loc.
+*/
+#define SIM_BRK_FILTER_BITS     16
+#define SIM_BRK_FILTER_HASH(loc) \
+    ((uint32)((loc) ^ ((loc) >> SIM_BRK_FILTER_BITS)) & ((1u << SIM_BRK_FILTER_BITS) - 1))
+#define sim_brk_maybe(loc) \
+    ((sim_brk_filter[SIM_BRK_FILTER_HASH (loc) >> 5] >> (SIM_BRK_FILTER_HASH (loc) & 0x1F)) & 1)
 void sim_brk_clrspc (uint32 spc, uint32 btyp);
 void sim_brk_npc (uint32 cnt);
 void sim_brk_setact (const char *action);
@@ -279,6 +297,7 @@ void _sim_debug_device (uint32 dbits, DEVICE* dptr, const char* fmt, ...) GCC_FM
 #define sim_debug_unit(dbits, uptr, ...) do { if ((sim_deb != NULL) && ((uptr) != NULL) && (uptr->dptr != NULL) && (((uptr)->dctrl | (uptr)->dptr->dctrl) & (dbits))) _sim_debug_unit (dbits, uptr, __VA_ARGS__);} while (0)
 #endif
 void sim_flush_buffered_files (t_bool debug_flush);
+void sim_debug_binary_start (void);
 
 /* Only for use in SCP code and libraries - NOT in simulator code */
 #define SIM_SCP_ABORT(msg) _sim_scp_abort (msg, __FILE__, __LINE__)
@@ -338,6 +357,7 @@ extern volatile t_bool stop_cpu;
 extern uint32 sim_brk_types;                            /* breakpoint info */
 extern uint32 sim_brk_dflt;
 extern uint32 sim_brk_summ;
+extern uint32 sim_brk_filter[];
 extern uint32 sim_brk_match_type;
 extern t_addr sim_brk_match_addr;
 extern BRKTYPTAB *sim_brk_type_desc;                    /* type descriptions */
@@ -351,6 +371,67 @@ int sim_aio_update_queue (void);
 void sim_aio_activate (ACTIVATE_API caller, UNIT *uptr, int32 event_time);
 void sim_aio_check_event (void);
 void sim_aio_set_interrupt_latency (int32 instpersec);
+int sim_aio_coalesce_flush (UNIT *uptr);
+t_stat sim_aio_coalesce_set (DEVICE *dptr, uint32 usecs);
+/* Asynchronous I/O worker pool.  Device specific requests begin with
+   a SIM_AIO_REQ header */
+typedef struct SIM_AIO_REQ SIM_AIO_REQ;
+typedef struct SIM_AIO_UNITQ SIM_AIO_UNITQ;
+struct SIM_AIO_REQ {
+    SIM_AIO_REQ         *next;
+    double              queued;                 /* host time of submission */
+    };
+typedef void (*SIM_AIO_PERFORM)(UNIT *uptr, SIM_AIO_REQ *req);
+extern uint32 sim_aio_pool_max_workers;
+SIM_AIO_UNITQ *sim_aio_unitq_create (UNIT *uptr, SIM_AIO_PERFORM perform);
+void sim_aio_unitq_free (SIM_AIO_UNITQ *q);
+void sim_aio_submit (SIM_AIO_UNITQ *q, SIM_AIO_REQ *req, int32 latency);
+void sim_aio_start (SIM_AIO_UNITQ *q, SIM_AIO_REQ *req, int32 latency);
+void sim_aio_done (SIM_AIO_UNITQ *q, SIM_AIO_REQ *req);
+SIM_AIO_REQ *sim_aio_complete (SIM_AIO_UNITQ *q);
+t_bool sim_aio_busy (SIM_AIO_UNITQ *q);
+void sim_aio_wait (SIM_AIO_UNITQ *q);
+void sim_aio_pool_set_workers (uint32 workers);
+void sim_aio_pool_cleanup (void);
+#endif
+/* Performance counters */
+typedef struct SIM_PERF SIM_PERF;
+#define SIM_PERF_EVENTS     0                   /* number of occurrences */
+#define SIM_PERF_BYTES      1                   /* transfers and bytes transferred */
+#define SIM_PERF_LATENCY    2                   /* latency (usecs) samples and histogram */
+#define SIM_PERF_DEPTH      3                   /* queue depth samples */
+extern volatile t_bool sim_perf_enabled;
+SIM_PERF *sim_perf_counter (DEVICE *dptr, const char *name, uint32 type, const char *desc);
+void sim_perf_add (SIM_PERF *ctr, t_uint64 value);
+void sim_perf_latency (SIM_PERF *ctr, double start);
+double sim_perf_time (void);
+#define SIM_PERF_ADD(ctr, value) do { if (sim_perf_enabled) sim_perf_add ((ctr), (value)); } while (0)
+#define SIM_PERF_START() (sim_perf_enabled ? sim_perf_time () : 0.0)
+
+/* Per-opcode execution statistics */
+typedef struct SIM_OPSTATS {
+    uint32              nops;                   /* number of opcode indexes */
+    const char          *(*op_name) (uint32 op);/* name of an opcode index (NULL if unassigned) */
+    uint32              (*op_class) (uint32 op);/* class of an opcode index */
+    const char * const  *class_names;           /* names of the classes */
+    uint32              nclasses;               /* number of classes */
+    volatile t_bool     enabled;                /* counting */
+    t_bool              timing;                 /* measuring host time */
+    t_uint64            *count;                 /* executions by opcode index */
+    t_uint64            *ns;                    /* host nanoseconds by opcode index */
+    t_uint64            discarded;              /* timing intervals discarded */
+    t_uint64            out_of_range;           /* opcode indexes beyond nops */
+    double              last_ns;                /* host time of previous instruction */
+    uint32              last_op;                /* previous opcode index */
+    } SIM_OPSTATS;
+#define SIM_OPSTATS_MAX_NS  100000.0            /* longest interval charged to an instruction */
+void sim_opstats_count (SIM_OPSTATS *os, uint32 op);
+t_stat sim_set_opstats (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
+t_stat sim_show_opstats (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
+#if defined (SIM_NO_OPSTATS)
+#define SIM_OPSTATS_COUNT(os, op)
+#else
+#define SIM_OPSTATS_COUNT(os, op) do { if ((os)->enabled) sim_opstats_count ((os), (op)); } while (0)
 #endif
 
 /* VM interface */
@@ -389,6 +470,7 @@ extern t_addr (*sim_vm_parse_addr) (DEVICE *dptr, CONST char *cptr, CONST char *
 extern t_bool (*sim_vm_fprint_stopped) (FILE *st, t_stat reason);
 extern t_value (*sim_vm_pc_value) (void);
 extern t_bool (*sim_vm_is_subroutine_call) (t_addr **ret_addrs);
+extern int32 (*sim_vm_profile_stack) (t_addr *frames, int32 max);
 extern void (*sim_vm_reg_update) (REG *rptr, uint32 idx, t_value prev_val, t_value new_val);
 extern const char **sim_clock_precalibrate_commands;
 extern uint32 sim_vm_initial_ips;                       /* base estimate of simulated instructions per second */
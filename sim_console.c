@@ -2347,7 +2347,7 @@ sim_deb_switches = switches &
                     SWMASK ('T') | SWMASK ('A') |
                     SWMASK ('F') | SWMASK ('N') |
                     SWMASK ('B') | SWMASK ('E') |
-                    SWMASK ('D') );                 /* save debug switches */
+                    SWMASK ('D') | SWMASK ('Z') );  /* save debug switches */
 return old_deb_switches;
 }
 
@@ -2371,7 +2371,14 @@ if (sim_switches & SWMASK ('B')) {
 cptr = get_glyph_quoted (cptr, gbuf, 0);                /* get file name */
 if (*cptr != 0)                                         /* now eol? */
     return SCPE_2MARG;
-r = sim_open_logfile (gbuf, FALSE, &sim_deb, &sim_deb_ref);
+if (sim_switches & SWMASK ('Z')) {                      /* binary trace? */
+    if (sim_switches & SWMASK ('B'))
+        return sim_messagef (SCPE_ARG, "Binary debug traces can't be written to a memory buffer\n");
+    if ((strcmp (gbuf, "LOG") == 0) || (strcmp (gbuf, "DEBUG") == 0) ||
+        (strcmp (gbuf, "STDOUT") == 0) || (strcmp (gbuf, "STDERR") == 0))
+        return sim_messagef (SCPE_ARG, "Binary debug traces must be written to a file\n");
+    }
+r = sim_open_logfile (gbuf, (sim_switches & SWMASK ('Z')) != 0, &sim_deb, &sim_deb_ref);
 
 if (r != SCPE_OK)
     return r;
@@ -2407,6 +2414,8 @@ if (sim_deb_switches & SWMASK ('E'))
 if (sim_deb_switches & SWMASK ('B'))
     sim_messagef (SCPE_OK, "   Debug messages will be written to a %u MB circular memory buffer\n",
                                 (unsigned int)buffer_size);
+if (sim_deb_switches & SWMASK ('Z'))
+    sim_messagef (SCPE_OK, "   Debug messages will be recorded in binary form for decoding with DEBUGDECODE\n");
 time(&now);
 if (!sim_quiet) {
     fprintf (sim_deb, "Debug output to \"%s\" at %s", sim_logfile_name (sim_deb, sim_deb_ref), ctime(&now));
@@ -2421,6 +2430,8 @@ if (sim_deb_switches & SWMASK ('B')) {
     sim_debug_buffer_offset = sim_debug_buffer_inuse = 0;
     memset (sim_deb_buffer, 0, sim_deb_buffer_size);
     }
+if (sim_deb_switches & SWMASK ('Z'))
+    sim_debug_binary_start ();
 
 return SCPE_OK;
 }
@@ -2486,6 +2497,8 @@ if (sim_deb) {
         fprintf (st, "   Debug messages are not being filtered to summarize duplicate lines\n");
     if (sim_deb_switches & SWMASK ('E'))
         fprintf (st, "   Debug messages containing blob data in EBCDIC will display in readable form\n");
+    if (sim_deb_switches & SWMASK ('Z'))
+        fprintf (st, "   Debug messages are recorded in binary form for decoding with DEBUGDECODE\n");
     for (i = 0; (dptr = sim_devices[i]) != NULL; i++) {
         t_bool unit_debug = FALSE;
         uint32 unit;
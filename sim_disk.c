@@ -42,6 +42,8 @@ Public routines:
    sim_disk_wrsect           write disk sectors
    sim_disk_wrsect_a         write disk sectors asynchronously
    sim_disk_unload           unload or detach a disk as needed
+   sim_disk_erase            discard the contents of a disk
+   sim_disk_trim             discard the contents of a range of sectors
    sim_disk_reset            reset unit
    sim_disk_wrp              TRUE if write protected
    sim_disk_isavailable      TRUE if available for I/O
@@ -54,6 +56,11 @@ Public routines:
    sim_disk_show_autosize    MTAB display autosize
    sim_disk_set_autozap      MTAB set autozap
    sim_disk_show_autozap     MTAB display autozap
+   sim_disk_set_snapshot     MTAB set snapshot overlay
+   sim_disk_show_snapshot    MTAB display snapshot overlay
+   sim_disk_set_cache        MTAB set sector cache
+   sim_disk_show_cache       MTAB display sector cache
+   sim_disk_flush            write back cached data and flush container
    sim_disk_set_async        enable asynchronous operation
    sim_disk_clr_async        disable asynchronous operation
    sim_disk_data_trace       debug support
@@ -82,6 +89,13 @@ Internal routines:
    sim_vhd_disk_rdsect       platform independent read virtual disk sectors
    sim_vhd_disk_wrsect       platform independent write virtual disk sectors
 
+   sim_sparse_disk_open      open SIMH sparse container
+   sim_sparse_disk_create    create SIMH sparse container
+   sim_sparse_disk_close     close SIMH sparse container
+   sim_sparse_disk_rdsect    read SIMH sparse container sectors
+   sim_sparse_disk_wrsect    write SIMH sparse container sectors
+   sim_sparse_disk_trim      release SIMH sparse container sectors
+
    sim_disk_find_type        locate DRVTYP of named disk type
 
 */
@@ -99,12 +113,14 @@ Internal routines:
 #define DKUF_F_STD       1                              /* SIMH format */
 #define DKUF_F_RAW       2                              /* Raw Physical Disk Access */
 #define DKUF_F_VHD       3                              /* VHD format */
+#define DKUF_F_SPARSE    4                              /* SIMH Sparse format (recorded in the disk_context) */
 
 #define DKUF_E_AUTO      0                              /* Auto detect encoding */
 #define DKUF_E_DLD9      1                              /* KLH10 packed 36bit little endian word */
 #define DKUF_E_DBD9      2                              /* KLH10 packed 36bit big endian word */
 
-#define DK_GET_FMT(u)   (((u)->flags >> DKUF_V_FMT) & DKUF_M_FMT)
+#define DK_GET_UFMT(u)  (((u)->flags >> DKUF_V_FMT) & DKUF_M_FMT)
+#define DK_GET_FMT(u)   ((((u)->disk_ctx != NULL) && ((struct disk_context *)(u)->disk_ctx)->sparse) ? DKUF_F_SPARSE : DK_GET_UFMT (u))
 #define DK_GET_ENC(u)   (((u)->flags >> DKUF_V_ENC) & DKUF_M_ENC)
 
 #if defined SIM_ASYNCH_IO
@@ -194,6 +210,7 @@ struct disk_context {
     uint32              is_cdrom;           /* Host system CDROM Device */
     uint32              media_removed;      /* Media not available flag */
     uint32              auto_format;        /* Format determined dynamically */
+    t_bool              sparse;             /* SIMH format held in a SIMH Sparse container */
     uint32              read_count;         /* Number of read operations performed */
     uint32              write_count;        /* Number of write operations performed */
     uint32              data_ileave;        /* Data sectors interleaved in container */
@@ -202,6 +219,17 @@ struct disk_context {
     t_addr              initial_capac;      /* Unit Capacity before any autosize */
     struct simh_disk_footer
                         *footer;
+    struct disk_overlay *overlay;           /* Copy-on-write snapshot overlay (if any) */
+    struct disk_cache   *cache;             /* Sector cache (if any) */
+    uint32              cache_size;         /* Sector cache size (sectors, 0 = none) */
+    uint32              cache_mode;         /* Sector cache policy (DK_CACHE_WRTHRU/WRBACK) */
+    uint8               *map;               /* Memory mapped container data (if any) */
+    t_offset            map_size;           /* Bytes of container data mapped */
+    t_bool              map_writable;       /* Mapping allows writes */
+    SIM_PERF            *perf_read;         /* bytes read performance counter */
+    SIM_PERF            *perf_write;        /* bytes written performance counter */
+    SIM_PERF            *perf_rlat;         /* read latency performance counter */
+    SIM_PERF            *perf_wlat;         /* write latency performance counter */
 #if defined _WIN32
     HANDLE              disk_handle;        /* OS specific Raw device handle */
 #endif
@@ -209,51 +237,167 @@ struct disk_context {
     int                 asynch_io;          /* Asynchronous Interrupt scheduling enabled */
     int                 asynch_io_latency;  /* instructions to delay pending interrupt */
     pthread_mutex_t     lock;
-    pthread_t           io_thread;          /* I/O Thread Id */
-    pthread_mutex_t     io_lock;
-    pthread_cond_t      io_cond;
-    pthread_cond_t      io_done;
-    pthread_cond_t      startup_cond;
-    int                 io_dop;
+    SIM_AIO_UNITQ       *aioq;              /* I/O worker pool request queue */
+    struct disk_aio_req *aio_free;          /* unused request structures */
+    t_bool              ring_active;        /* transfers use io_uring */
+    t_bool              ring_direct;        /* ring_fd opened with O_DIRECT */
+    t_bool              ring_last;          /* most recent asynch request used the ring */
+    int                 ring_fd;            /* container descriptor for ring transfers */
+    t_bool              ring_busy;          /* a ring transfer is in flight */
+    struct disk_aio_req *ring_head;         /* requests waiting for the ring */
+    struct disk_aio_req *ring_tail;
+#endif
+    };
+
+#define disk_ctx up8                        /* Field in Unit structure which points to the disk_context */
+
+/* Copy-on-write snapshot overlay
+
+   A snapshot overlay redirects every write to a disk unit into a sparse
+   delta file, leaving the underlying container (of whatever format)
+   unchanged.  The delta file contains a header, a bitmap with one bit
+   per sector indicating which sectors are present in the delta file
+   and then the sector data itself, each sector stored at its natural
+   offset from the start of the data area.  Sectors which have never
+   been written therefore consume no space on hosts which support
+   sparse files.  The bitmap is held in memory and the affected bitmap
+   bytes are written through whenever sectors are first written.
+
+   Sector data in the delta file is stored in the byte order of the
+   underlying container.
+ */
+
+struct simh_disk_overlay_header {
+    uint8       Signature[8];           /* must be 'simhsnap' */
+    uint32      Version;                /* Initially 1 */
+#define OVERLAY_VERSION 1
+    uint32      SectorSize;
+    uint32      SectorCount;            /* Sectors described by the bitmap */
+    uint32      BitmapOffset;           /* File offset of the sector bitmap */
+    uint32      DataOffset[2];          /* File offset of sector 0 data */
+    uint32      BaseSize[2];            /* Container size of the base disk */
+    uint8       CreationTime[28];       /* Result of ctime() */
+    uint8       BaseName[256];          /* Base container when created */
+    uint8       Reserved[184];          /* Currently unused */
+    uint32      Checksum;               /* CRC32 of the prior 508 bytes */
+    };
+
+struct disk_overlay {
+    FILE                *file;              /* Delta file */
+    char                *filename;          /* Delta file name */
+    uint8               *bitmap;            /* Sectors present in the delta file */
+    size_t              bitmap_size;        /* Bytes in bitmap (rounded to 512) */
+    t_lba               sectors;            /* Sectors covered by the bitmap */
+    t_lba               changed;            /* Sectors present in the delta file */
+    t_offset            bitmap_offset;      /* File offset of the bitmap */
+    t_offset            data_offset;        /* File offset of sector 0 */
+    t_bool              base_ro;            /* Underlying container opened read only */
+    };
+
+#define OVL_PRESENT(ovl, lba) (((lba) < (ovl)->sectors) && ((ovl)->bitmap[(lba) >> 3] & (1 << ((lba) & 7))))
+
+/* Memory mapped containers
+
+   SIMH containers attached with -P have the existing part of their data
+   portion (the simulated disk's capacity, which excludes any metadata
+   footer) mapped into the simulator's address space.  Transfers which lie
+   entirely within the mapping are satisfied by memcpy, anything else
+   (sectors beyond the end of a short container and every transfer when
+   the mapping couldn't be established) uses file I/O.  The container is
+   never extended to be mapped, and only regular files on local file
+   systems are mapped since an access to a page which has vanished from
+   the file (truncated by a file server or another client) raises SIGBUS.
+ */
+
+#define DK_MAP_COVERS(ctx, lba, sects) (((ctx)->map != NULL) && \
+                                        (((((t_offset)(lba)) + (sects)) * (ctx)->sector_size) <= (ctx)->map_size))
+#define DK_MAP_ADDR(ctx, lba) ((ctx)->map + (size_t)(((t_offset)(lba)) * (ctx)->sector_size))
+
+/* Sector cache
+
+   An optional per unit LRU cache of recently transferred sectors.  The
+   cache holds sector data in the byte order seen by the callers of
+   sim_disk_rdsect and sim_disk_wrsect, so hits are satisfied with a
+   single memcpy.  In write-through mode every write is passed on to the
+   container immediately.  In write-back mode written sectors are held
+   dirty in the cache until they are evicted, the unit is flushed
+   (sim_disk_flush, which also happens whenever the simulator stops)
+   or the unit is detached.
+
+   Like a snapshot overlay, the cache is configured on an attached unit
+   and its size (in sectors) and policy last until the unit is detached.
+ */
+
+#define DK_CACHE_NIL        0xFFFFFFFF
+#define DK_CACHE_DEFAULT    256                 /* default cache size (sectors) */
+#define DK_CACHE_MAX        (1024*1024)         /* maximum cache size (sectors) */
+#define DK_CACHE_WRTHRU     0                   /* write-through policy */
+#define DK_CACHE_WRBACK     1                   /* write-back policy */
+
+struct disk_cache_entry {
+    t_lba               lba;
+    uint32              hnext;              /* hash chain */
+    uint32              prev;               /* LRU list towards most recently used */
+    uint32              next;               /* LRU list towards least recently used */
+    t_bool              valid;
+    t_bool              dirty;
+    };
+
+struct disk_cache {
+    uint32              entries;
+    uint32              hash_mask;
+    uint32              *hash;              /* hash chain heads */
+    struct disk_cache_entry
+                        *entry;
+    uint8               *data;              /* entries * sector_size bytes */
+    uint32              mru;                /* most recently used entry */
+    uint32              lru;                /* least recently used entry */
+    t_bool              write_back;         /* write-back policy */
+    uint32              dirty;              /* dirty entries */
+    t_uint64            reads;              /* sectors read */
+    t_uint64            read_hits;          /* sectors read from the cache */
+    t_uint64            writes;             /* sectors written */
+    t_uint64            write_backs;        /* dirty sectors written to the container */
+    };
+
+#define DK_CACHE_DATA(ctx, idx) ((ctx)->cache->data + ((size_t)(idx)) * (ctx)->sector_size)
+
+static t_stat _sim_disk_cache_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects);
+static t_stat _sim_disk_cache_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects);
+static t_stat _sim_disk_cache_create (UNIT *uptr);
+static t_stat _sim_disk_cache_flush (UNIT *uptr);
+static t_stat _sim_disk_cache_free (UNIT *uptr);
+static void _sim_disk_cache_invalidate (struct disk_cache *cache);
+
+#if defined SIM_ASYNCH_IO
+/* An asynchronous request, performed by an I/O worker pool thread */
+
+struct disk_aio_req {
+    SIM_AIO_REQ         hdr;                /* pool linkage */
+    int                 dop;                /* operation */
+    t_lba               lba;
     uint8               *buf;
     t_seccnt            *rsects;
     t_seccnt            sects;
-    t_lba               lba;
     DISK_PCALLBACK      callback;
     t_stat              io_status;
-#endif
+    UNIT                *uptr;
+    uint8               *bounce;            /* aligned buffer for O_DIRECT ring transfers */
+    size_t              bounce_size;
+    struct disk_aio_req *ring_next;         /* ring wait list linkage */
     };
 
-#define disk_ctx up8                        /* Field in Unit structure which points to the disk_context */
+static t_bool _disk_ring_eligible (struct disk_aio_req *req);
+static void _disk_ring_submit (struct disk_aio_req *req);
 
-#if defined SIM_ASYNCH_IO
 #define AIO_CALLSETUP                                               \
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;   \
                                                                     \
 if ((!callback) || !ctx->asynch_io)
 
 #define AIO_CALL(op, _lba, _buf, _rsects, _sects,  _callback)   \
-    if (ctx->asynch_io) {                                       \
-        struct disk_context *ctx =                              \
-                      (struct disk_context *)uptr->disk_ctx;    \
-                                                                \
-        pthread_mutex_lock (&ctx->io_lock);                     \
-                                                                \
-        sim_debug_unit (ctx->dbit, uptr,                        \
-      "sim_disk AIO_CALL(op=%d, unit=%d, lba=0x%X, sects=%d)\n",\
-                op, (int)(uptr - ctx->dptr->units), _lba, _sects);\
-                                                                \
-        if (ctx->callback)      /* horrible mistake, stop */    \
-            SIM_SCP_ABORT ("AIO_CALL error");                   \
-        ctx->io_dop = op;                                       \
-        ctx->lba = _lba;                                        \
-        ctx->buf = _buf;                                        \
-        ctx->sects = _sects;                                    \
-        ctx->rsects = _rsects;                                  \
-        ctx->callback = _callback;                              \
-        pthread_cond_signal (&ctx->io_cond);                    \
-        pthread_mutex_unlock (&ctx->io_lock);                   \
-        }                                                       \
+    if (ctx->asynch_io)                                         \
+        _disk_aio_submit (uptr, op, _lba, _buf, _rsects, _sects, _callback);\
     else                                                        \
         if (_callback)                                          \
             (_callback) (uptr, r);
@@ -264,73 +408,103 @@ if ((!callback) || !ctx->asynch_io)
 #define DOP_WSEC  2             /* sim_disk_wrsect_a */
 #define DOP_IAVL  3             /* sim_disk_isavailable_a */
 
-static void *
-_disk_io(void *arg)
+/* Queue a request for the I/O worker pool.  Requests for a unit are
+   performed in the order they are submitted, so a controller may have
+   any number of them outstanding. */
+
+static void _disk_aio_submit (UNIT *uptr, int dop, t_lba lba, uint8 *buf, t_seccnt *rsects, t_seccnt sects, DISK_PCALLBACK callback)
 {
-UNIT* volatile uptr = (UNIT*)arg;
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_aio_req *req = ctx->aio_free;
 
-/* Boost Priority for this I/O thread vs the CPU instruction execution
-   thread which in general won't be readily yielding the processor when
-   this thread needs to run */
-sim_os_set_thread_priority (PRIORITY_ABOVE_NORMAL);
-
-sim_debug_unit (ctx->dbit, uptr, "_disk_io(unit=%d) starting\n", (int)(uptr - ctx->dptr->units));
+sim_debug_unit (ctx->dbit, uptr, "sim_disk AIO_CALL(op=%d, unit=%d, lba=0x%X, sects=%d)\n",
+                dop, (int)(uptr - ctx->dptr->units), lba, sects);
 
-pthread_mutex_lock (&ctx->io_lock);
-pthread_cond_signal (&ctx->startup_cond);   /* Signal we're ready to go */
-while (ctx->asynch_io) {
-    pthread_cond_wait (&ctx->io_cond, &ctx->io_lock);
-    if (ctx->io_dop == DOP_DONE)
-        break;
-    pthread_mutex_unlock (&ctx->io_lock);
-    switch (ctx->io_dop) {
-        case DOP_RSEC:
-            ctx->io_status = sim_disk_rdsect (uptr, ctx->lba, ctx->buf, ctx->rsects, ctx->sects);
-            break;
-        case DOP_WSEC:
-            ctx->io_status = sim_disk_wrsect (uptr, ctx->lba, ctx->buf, ctx->rsects, ctx->sects);
-            break;
-        case DOP_IAVL:
-            ctx->io_status = sim_disk_isavailable (uptr);
-            break;
+if (req)
+    ctx->aio_free = (struct disk_aio_req *)req->hdr.next;
+else {
+    req = (struct disk_aio_req *)malloc (sizeof (*req));
+    if (req) {
+        req->bounce = NULL;
+        req->bounce_size = 0;
         }
-    pthread_mutex_lock (&ctx->io_lock);
-    ctx->io_dop = DOP_DONE;
-    pthread_cond_signal (&ctx->io_done);
-    sim_activate (uptr, ctx->asynch_io_latency);
     }
-pthread_mutex_unlock (&ctx->io_lock);
+if (req == NULL) {
+    if (callback)
+        callback (uptr, SCPE_MEM);
+    return;
+    }
+req->dop = dop;
+req->lba = lba;
+req->buf = buf;
+req->rsects = rsects;
+req->sects = sects;
+req->callback = callback;
+req->io_status = SCPE_OK;
+req->uptr = uptr;
+if (_disk_ring_eligible (req)) {
+    if (!ctx->ring_last) {                      /* switching from the worker pool? */
+        sim_aio_wait (ctx->aioq);               /* keep the unit's requests in order */
+        ctx->ring_last = TRUE;
+        }
+    if (dop == DOP_RSEC)
+        ctx->read_count++;                      /* record read operation */
+    else
+        ctx->write_count++;                     /* record write operation */
+    sim_aio_start (ctx->aioq, &req->hdr, ctx->asynch_io_latency);
+    _disk_ring_submit (req);
+    return;
+    }
+if (ctx->ring_last) {                           /* switching from the ring? */
+    sim_aio_wait (ctx->aioq);
+    ctx->ring_last = FALSE;
+    }
+sim_aio_submit (ctx->aioq, &req->hdr, ctx->asynch_io_latency);
+}
 
-sim_debug_unit (ctx->dbit, uptr, "_disk_io(unit=%d) exiting\n", (int)(uptr - ctx->dptr->units));
+/* Perform a request.  Called in the context of an I/O worker thread */
 
-return NULL;
+static void _disk_aio_perform (UNIT *uptr, SIM_AIO_REQ *hdr)
+{
+struct disk_aio_req *req = (struct disk_aio_req *)hdr;
+
+switch (req->dop) {
+    case DOP_RSEC:
+        req->io_status = sim_disk_rdsect (uptr, req->lba, req->buf, req->rsects, req->sects);
+        break;
+    case DOP_WSEC:
+        req->io_status = sim_disk_wrsect (uptr, req->lba, req->buf, req->rsects, req->sects);
+        break;
+    case DOP_IAVL:
+        req->io_status = sim_disk_isavailable (uptr);
+        break;
+    }
 }
 
 /* This routine is called in the context of the main simulator thread before
-   processing events for any unit. It is only called when an asynchronous
+   processing events for any unit. It is only called when an I/O worker
    thread has called sim_activate() to activate a unit.  The job of this
    routine is to put the unit in proper condition to digest what may have
-   occurred in the asynchronous thread.
+   occurred in the worker threads.
 
-   Since disk processing only handles a single I/O at a time to a
-   particular disk device (due to using stdio for the SimH Disk format
-   and stdio doesn't have an atomic seek+(read|write) operation),
-   we have the opportunity to possibly detect improper attempts to
-   issue multiple concurrent I/O requests. */
+   All requests which have been performed since the unit was activated
+   are completed, in the order they were submitted. */
 static void _disk_completion_dispatch (UNIT *uptr)
 {
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
-DISK_PCALLBACK callback = ctx->callback;
-
-sim_debug_unit (ctx->dbit, uptr, "_disk_completion_dispatch(unit=%d, dop=%d, callback=%p)\n", (int)(uptr - ctx->dptr->units), ctx->io_dop, (void *)(ctx->callback));
+struct disk_aio_req *req;
 
-if (ctx->io_dop != DOP_DONE)
-    SIM_SCP_ABORT ("_disk_completion_dispatch()"); /* horribly wrong, stop */
+if ((ctx == NULL) || (ctx->aioq == NULL))
+    return;
+while ((req = (struct disk_aio_req *)sim_aio_complete (ctx->aioq))) {
+    DISK_PCALLBACK callback = req->callback;
+    t_stat status = req->io_status;
 
-if (ctx->callback && ctx->io_dop == DOP_DONE) {
-    ctx->callback = NULL;
-    callback (uptr, ctx->io_status);
+    sim_debug_unit (ctx->dbit, uptr, "_disk_completion_dispatch(unit=%d, dop=%d, callback=%p)\n", (int)(uptr - ctx->dptr->units), req->dop, (void *)callback);
+    req->hdr.next = (SIM_AIO_REQ *)ctx->aio_free;
+    ctx->aio_free = req;
+    if (callback)
+        callback (uptr, status);
     }
 }
 
@@ -338,9 +512,11 @@ static t_bool _disk_is_active (UNIT *uptr)
 {
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 
-if (ctx) {
-    sim_debug_unit (ctx->dbit, uptr, "_disk_is_active(unit=%d, dop=%d)\n", (int)(uptr - ctx->dptr->units), ctx->io_dop);
-    return (ctx->io_dop != DOP_DONE);
+if (ctx && ctx->aioq) {
+    t_bool busy = sim_aio_busy (ctx->aioq);
+
+    sim_debug_unit (ctx->dbit, uptr, "_disk_is_active(unit=%d, busy=%d)\n", (int)(uptr - ctx->dptr->units), busy);
+    return busy;
     }
 return FALSE;
 }
@@ -350,16 +526,34 @@ static t_bool _disk_cancel (UNIT *uptr)
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 
 if (ctx) {
-    sim_debug_unit (ctx->dbit, uptr, "_disk_cancel(unit=%d, dop=%d)\n", (int)(uptr - ctx->dptr->units), ctx->io_dop);
-    if (ctx->asynch_io) {
-        pthread_mutex_lock (&ctx->io_lock);
-        while (ctx->io_dop != DOP_DONE)
-            pthread_cond_wait (&ctx->io_done, &ctx->io_lock);
-        pthread_mutex_unlock (&ctx->io_lock);
-        }
+    sim_debug_unit (ctx->dbit, uptr, "_disk_cancel(unit=%d)\n", (int)(uptr - ctx->dptr->units));
+    if (ctx->aioq)
+        sim_aio_wait (ctx->aioq);
     }
 return FALSE;
 }
+
+/* Release the request queue and any request structures */
+
+static void _disk_aio_free (struct disk_context *ctx)
+{
+struct disk_aio_req *req;
+
+if (ctx->aioq == NULL)
+    return;
+sim_aio_wait (ctx->aioq);
+while ((req = (struct disk_aio_req *)sim_aio_complete (ctx->aioq))) {
+    req->hdr.next = (SIM_AIO_REQ *)ctx->aio_free;
+    ctx->aio_free = req;
+    }
+sim_aio_unitq_free (ctx->aioq);
+ctx->aioq = NULL;
+while ((req = ctx->aio_free)) {
+    ctx->aio_free = (struct disk_aio_req *)req->hdr.next;
+    free (req->bounce);
+    free (req);
+    }
+}
 #else
 #define AIO_CALLSETUP
 #define AIO_CALL(op, _lba, _buf, _rsects, _sects,  _callback)   \
@@ -382,6 +576,18 @@ static const char *sim_vhd_disk_parent_path (FILE *f);
 static t_stat sim_vhd_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects);
 static t_stat sim_vhd_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects);
 static t_stat sim_vhd_disk_clearerr (UNIT *uptr);
+static FILE *sim_sparse_disk_open (const char *filename, const char *mode);
+static FILE *sim_sparse_disk_create (const char *filename, t_offset desiredsize, DRVTYP *drvtyp, t_bool compress);
+static int sim_sparse_disk_close (FILE *f);
+static void sim_sparse_disk_flush (FILE *f);
+static t_offset sim_sparse_disk_size (FILE *f);
+static uint32 sim_sparse_disk_cluster_size (FILE *f);
+static t_bool sim_sparse_disk_compressed (FILE *f);
+static void sim_sparse_disk_get_footer (FILE *f, struct simh_disk_footer *footer);
+static t_stat sim_sparse_disk_set_footer (FILE *f, const struct simh_disk_footer *footer, t_offset size);
+static t_stat sim_sparse_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects);
+static t_stat sim_sparse_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects);
+static t_stat sim_sparse_disk_trim (UNIT *uptr, t_lba lba, t_seccnt sects);
 static t_stat sim_vhd_disk_set_dtype (FILE *f, const char *dtype, uint32 SectorSize, uint32 xfer_encode_size, uint32 media_id, const char *device_name, uint32 data_width, DRVTYP *drvtyp);
 static const char *sim_vhd_disk_get_dtype (FILE *f, uint32 *SectorSize, uint32 *xfer_encode_size, char sim_name[64], time_t *creation_time, uint32 *media_id, char device_name[16], uint32 *data_width);
 static DRVTYP *sim_disk_find_type (UNIT *uptr, const char *dtype);
@@ -399,6 +605,16 @@ static t_stat sim_os_disk_read (UNIT *uptr, t_offset addr, uint8 *buf, uint32 *b
 static t_stat sim_os_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects);
 static t_stat sim_os_disk_write (UNIT *uptr, t_offset addr, uint8 *buf, uint32 *byteswritten, uint32 bytes);
 static t_stat sim_os_disk_info_raw (FILE *f, uint32 *sector_size, uint32 *removable, uint32 *is_cdrom);
+static t_stat sim_os_disk_implemented_map (void);
+static uint8 *sim_os_disk_map (UNIT *uptr, t_offset size, t_bool writable);
+static void sim_os_disk_unmap (uint8 *map, t_offset size);
+static t_stat sim_os_disk_sync_map (uint8 *map, t_offset size);
+#if defined (SIM_ASYNCH_IO)
+static t_bool _sim_disk_ring_open (UNIT *uptr);
+static void _sim_disk_ring_close (UNIT *uptr);
+static t_stat _sim_disk_ring_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects);
+static t_stat _sim_disk_ring_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects);
+#endif
 static char *HostPathToVhdPath (const char *szHostPath, char *szVhdPath, size_t VhdPathSize);
 static char *VhdPathToHostPath (const char *szVhdPath, char *szHostPath, size_t HostPathSize);
 static t_offset get_filesystem_size (UNIT *uptr, t_bool *isreadonly);
@@ -416,6 +632,7 @@ static struct sim_disk_fmt fmts[] = {
     { "SIMH",        0, DKUF_F_STD,      0,                 NULL},
     { "RAW",         0, DKUF_F_RAW,      0,                 sim_os_disk_implemented_raw},
     { "VHD",         0, DKUF_F_VHD,      0,                 sim_vhd_disk_implemented},
+    { "SPARSE",      0, DKUF_F_SPARSE,   0,                 NULL},
     { NULL,          0, 0,               0,                 NULL}
     };
 
@@ -433,6 +650,8 @@ for (f = 0; fmts[f].name; f++) {
     if (fmts[f].name && (MATCH_CMD (cptr, fmts[f].name) == 0)) {
         if ((fmts[f].impl_fnc) && (fmts[f].impl_fnc() != SCPE_OK))
             return SCPE_NOFNC;
+        if (fmts[f].fmtval > DKUF_M_FMT)                /* not representable in the unit flags? */
+            return sim_messagef (SCPE_ARG, "%s containers are selected with ATTACH -F %s\n", fmts[f].name, fmts[f].name);
         uptr->flags = (uptr->flags & ~DKUF_FMT) |
             (fmts[f].fmtval << DKUF_V_FMT) | fmts[f].uflags;
         if (fmts[f].fmtval == DKUF_F_AUTO)
@@ -564,6 +783,7 @@ switch (DK_GET_FMT (uptr)) {                            /* case on format */
         is_available = TRUE;
         break;
     case DKUF_F_VHD:                                    /* VHD format */
+    case DKUF_F_SPARSE:                                 /* SIMH Sparse format */
         is_available = TRUE;
         break;
     case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
@@ -793,25 +1013,15 @@ sim_printf ("%s", msg);
 return SCPE_NOFNC;
 #else
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
-pthread_attr_t attr;
 
 sim_debug_unit (ctx->dbit, uptr, "sim_disk_set_async(unit=%d)\n", (int)(uptr - ctx->dptr->units));
 
 ctx->asynch_io = sim_asynch_enabled;
 ctx->asynch_io_latency = latency;
-if (ctx->asynch_io) {
-    pthread_mutex_init (&ctx->io_lock, NULL);
-    pthread_cond_init (&ctx->io_cond, NULL);
-    pthread_cond_init (&ctx->io_done, NULL);
-    pthread_cond_init (&ctx->startup_cond, NULL);
-    pthread_attr_init(&attr);
-    pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
-    pthread_mutex_lock (&ctx->io_lock);
-    pthread_create (&ctx->io_thread, &attr, _disk_io, (void *)uptr);
-    pthread_attr_destroy(&attr);
-    pthread_cond_wait (&ctx->startup_cond, &ctx->io_lock); /* Wait for thread to stabilize */
-    pthread_mutex_unlock (&ctx->io_lock);
-    pthread_cond_destroy (&ctx->startup_cond);
+if (ctx->asynch_io && (ctx->aioq == NULL)) {
+    ctx->aioq = sim_aio_unitq_create (uptr, _disk_aio_perform);
+    if (ctx->aioq == NULL)
+        ctx->asynch_io = 0;
     }
 uptr->a_check_completion = _disk_completion_dispatch;
 uptr->a_is_active = _disk_is_active;
@@ -835,14 +1045,8 @@ if (!ctx) return SCPE_UNATT;
 sim_debug_unit (ctx->dbit, uptr, "sim_disk_clr_async(unit=%d)\n", (int)(uptr - ctx->dptr->units));
 
 if (ctx->asynch_io) {
-    pthread_mutex_lock (&ctx->io_lock);
     ctx->asynch_io = 0;
-    pthread_cond_signal (&ctx->io_cond);
-    pthread_mutex_unlock (&ctx->io_lock);
-    pthread_join (ctx->io_thread, NULL);
-    pthread_mutex_destroy (&ctx->io_lock);
-    pthread_cond_destroy (&ctx->io_cond);
-    pthread_cond_destroy (&ctx->io_done);
+    sim_aio_wait (ctx->aioq);                   /* let outstanding requests finish */
     }
 return SCPE_OK;
 #endif
@@ -859,6 +1063,10 @@ struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 
 sim_debug_unit (ctx->dbit, uptr, "_sim_disk_rdsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr - ctx->dptr->units), lba, sects);
 
+#if defined (SIM_ASYNCH_IO)
+if (ctx->ring_active)                                   /* container data belongs to the ring descriptor */
+    return _sim_disk_ring_rdsect (uptr, lba, buf, sectsread, sects);
+#endif
 da = ((t_offset)lba) * ctx->sector_size;
 tbc = sects * ctx->sector_size;
 if (sectsread)
@@ -893,7 +1101,109 @@ while (tbc) {
 return SCPE_OK;
 }
 
-t_stat sim_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+/* Read sectors from the container in its native byte order */
+
+static t_stat _sim_disk_fmt_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if (DK_MAP_COVERS (ctx, lba, sects)) {                  /* memory mapped? */
+    memcpy (buf, DK_MAP_ADDR (ctx, lba), ((size_t)sects) * ctx->sector_size);
+    if (sectsread)
+        *sectsread = sects;
+    return SCPE_OK;
+    }
+switch (DK_GET_FMT (uptr)) {                            /* case on format */
+    case DKUF_F_STD:                                    /* SIMH format */
+        return _sim_disk_rdsect (uptr, lba, buf, sectsread, sects);
+    case DKUF_F_VHD:                                    /* VHD format */
+        return sim_vhd_disk_rdsect (uptr, lba, buf, sectsread, sects);
+    case DKUF_F_SPARSE:                                 /* SIMH Sparse format */
+        return sim_sparse_disk_rdsect (uptr, lba, buf, sectsread, sects);
+    case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+        if ((0 == (ctx->sector_size & (ctx->storage_sector_size - 1))) ||   /* Sector Aligned & whole sector transfers */
+            ((0 == ((lba*ctx->sector_size) & (ctx->storage_sector_size - 1))) &&
+             (0 == ((sects*ctx->sector_size) & (ctx->storage_sector_size - 1)))))
+            return sim_os_disk_rdsect (uptr, lba, buf, sectsread, sects);
+        else { /* Unaligned and/or partial sector transfers */
+            size_t tbufsize = sects * ctx->sector_size + 2 * ctx->storage_sector_size;
+            uint8 *tbuf = (uint8*) malloc (tbufsize);
+            t_offset ssaddr = (lba * (t_offset)ctx->sector_size) & ~(t_offset)(ctx->storage_sector_size -1);
+            uint32 soffset = (uint32)((lba * (t_offset)ctx->sector_size) - ssaddr);
+            uint32 bytesread = 0;
+            t_seccnt sread;
+            t_stat r;
+
+            if (sectsread)
+                *sectsread = 0;
+            if (tbuf == NULL)
+                return SCPE_MEM;
+            r = sim_os_disk_read (uptr, ssaddr, tbuf, &bytesread, tbufsize & ~(ctx->storage_sector_size - 1));
+            sread = (bytesread > soffset) ? (bytesread - soffset) / ctx->sector_size : 0;
+            if (sread > sects)
+                sread = sects;
+            memcpy (buf, tbuf + soffset, sread * ctx->sector_size);
+            if (sectsread)
+                *sectsread = sread;
+            free (tbuf);
+            return r;
+            }
+    default:
+        return SCPE_NOFNC;
+    }
+}
+
+/* Read sectors through a snapshot overlay in container byte order */
+
+static t_stat _sim_disk_ovl_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_overlay *ovl = ctx->overlay;
+t_seccnt done = 0;
+t_stat r = SCPE_OK;
+
+while (done < sects) {
+    t_lba sect = lba + done;
+    t_bool present = (OVL_PRESENT (ovl, sect) != 0);
+    uint8 *sbuf = buf + (size_t)done * ctx->sector_size;
+    t_seccnt run, sread = 0;
+
+    for (run = 1; (done + run < sects) && ((OVL_PRESENT (ovl, sect + run) != 0) == present); run++)
+        ;
+    if (present) {
+        size_t bytes = (size_t)run * ctx->sector_size;
+        size_t i;
+
+        clearerr (ovl->file);
+        if (sim_fseeko (ovl->file, ovl->data_offset + ((t_offset)sect) * ctx->sector_size, SEEK_SET)) {
+            r = SCPE_IOERR;
+            break;
+            }
+        i = fread (sbuf, 1, bytes, ovl->file);
+        if (i < bytes)                                  /* fill */
+            memset (sbuf + i, 0, bytes - i);
+        if (ferror (ovl->file)) {
+            r = SCPE_IOERR;
+            break;
+            }
+        }
+    else {
+        r = _sim_disk_fmt_rdsect (uptr, sect, sbuf, &sread, run);
+        if (sread < run)                                /* beyond the end of the base */
+            memset (sbuf + (size_t)sread * ctx->sector_size, 0, (size_t)(run - sread) * ctx->sector_size);
+        if (r != SCPE_OK) {
+            done += sread;
+            break;
+            }
+        }
+    done += run;
+    }
+if (sectsread)
+    *sectsread = done;
+return r;
+}
+
+static t_stat _sim_disk_uncached_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
 {
 t_stat r;
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
@@ -902,9 +1212,6 @@ t_seccnt sread = 0;
 uint8 *tbuf = NULL;
 uint8 *rbuf;
 
-sim_debug_unit (ctx->dbit, uptr, "sim_disk_rdsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr - ctx->dptr->units), lba, sects);
-
-ctx->read_count++;                                      /* record read operation */
 if ((sects == 1) &&                                     /* Single sector reads */
     (lba >= (uptr->capac*ctx->capac_factor)/(ctx->sector_size/((ctx->dptr->flags & DEV_SECTORS) ? ctx->sector_size : 1)))) {/* beyond the end of the disk */
     memset (buf, '\0', ctx->sector_size);               /* are bad block management efforts - zero buffer */
@@ -916,7 +1223,9 @@ if ((sects == 1) &&                                     /* Single sector reads *
 if ((0 == (ctx->sector_size & (ctx->storage_sector_size - 1))) ||   /* Sector Aligned & whole sector transfers */
     ((0 == ((lba*ctx->sector_size) & (ctx->storage_sector_size - 1))) &&
      (0 == ((sects*ctx->sector_size) & (ctx->storage_sector_size - 1)))) ||
-    (f == DKUF_F_STD) || (f == DKUF_F_VHD)) {                       /* or SIMH or VHD formats */
+    (f == DKUF_F_STD) || (f == DKUF_F_VHD) ||                       /* or SIMH or VHD formats */
+    (f == DKUF_F_SPARSE) ||                                         /* or SIMH Sparse format */
+    (ctx->overlay != NULL) || (ctx->map != NULL)) {                 /* or snapshot overlay or memory mapped */
         if (ctx->xfer_encode_size > DK_ENC_LONGLONG) {
             tbuf = (uint8*) malloc (ctx->sector_size * sects);
             if (tbuf == NULL)
@@ -925,19 +1234,13 @@ if ((0 == (ctx->sector_size & (ctx->storage_sector_size - 1))) ||   /* Sector Al
             }
         else
             rbuf = buf;
-    switch (f) {                                        /* case on format */
-        case DKUF_F_STD:                                /* SIMH format */
-            r = _sim_disk_rdsect (uptr, lba, rbuf, &sread, sects);
-            break;
-        case DKUF_F_VHD:                                /* VHD format */
-            r = sim_vhd_disk_rdsect (uptr, lba, rbuf, &sread, sects);
-            break;
-        case DKUF_F_RAW:                                /* Raw Physical Disk Access */
-            r = sim_os_disk_rdsect (uptr, lba, rbuf, &sread, sects);
-            break;
-        default:
-            free (tbuf);
-            return SCPE_NOFNC;
+    if (ctx->overlay != NULL)
+        r = _sim_disk_ovl_rdsect (uptr, lba, rbuf, &sread, sects);
+    else
+        r = _sim_disk_fmt_rdsect (uptr, lba, rbuf, &sread, sects);
+    if (r == SCPE_NOFNC) {
+        free (tbuf);
+        return r;
         }
     if (sectsread)
         *sectsread = sread;
@@ -1000,6 +1303,29 @@ else { /* Unaligned and/or partial sector transfers in RAW mode */
     }
 }
 
+t_stat sim_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+double start = SIM_PERF_START ();
+t_seccnt sread = 0;
+t_stat r;
+
+sim_debug_unit (ctx->dbit, uptr, "sim_disk_rdsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr - ctx->dptr->units), lba, sects);
+
+ctx->read_count++;                                      /* record read operation */
+if (sectsread == NULL)                                  /* count transferred sectors for the counters */
+    sectsread = &sread;
+if (ctx->cache != NULL)                                 /* sector cache? */
+    r = _sim_disk_cache_rdsect (uptr, lba, buf, sectsread, sects);
+else
+    r = _sim_disk_uncached_rdsect (uptr, lba, buf, sectsread, sects);
+if (start != 0.0) {                                     /* performance counters enabled? */
+    sim_perf_add (ctx->perf_read, ((t_uint64)*sectsread) * ctx->sector_size);
+    sim_perf_latency (ctx->perf_rlat, start);
+    }
+return r;
+}
+
 t_stat sim_disk_rdsect_a (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects, DISK_PCALLBACK callback)
 {
 t_stat r = SCPE_OK;
@@ -1020,6 +1346,10 @@ struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 
 sim_debug_unit (ctx->dbit, uptr, "_sim_disk_wrsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr - ctx->dptr->units), lba, sects);
 
+#if defined (SIM_ASYNCH_IO)
+if (ctx->ring_active)                                   /* container data belongs to the ring descriptor */
+    return _sim_disk_ring_wrsect (uptr, lba, buf, sectswritten, sects);
+#endif
 da = ((t_offset)lba) * ctx->sector_size;
 tbc = sects * ctx->sector_size;
 if (sectswritten)
@@ -1036,53 +1366,36 @@ if (err)
 return SCPE_OK;
 }
 
-t_stat sim_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+/* Write host byte order sectors to the container */
+
+static t_stat _sim_disk_fmt_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
 {
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 uint32 f = DK_GET_FMT (uptr);
-t_stat r;
+t_stat r = SCPE_OK;
 uint8 *tbuf = NULL;
 t_seccnt written = 0;
 
-sim_debug_unit (ctx->dbit, uptr, "sim_disk_wrsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr - ctx->dptr->units), lba, sects);
-
-if (sectswritten)
-    *sectswritten = 0;
-ctx->write_count++;                                     /* record write operation */
-if (uptr->dynflags & UNIT_DISK_CHK) {
-    DEVICE *dptr = find_dev_from_unit (uptr);
-    uint32 capac_factor = ((dptr->dwidth / dptr->aincr) >= 32) ? 8 : ((dptr->dwidth / dptr->aincr) == 16) ? 2 : 1; /* capacity units (quadword: 8, word: 2, byte: 1) */
-    t_lba total_sectors = (t_lba)((uptr->capac*capac_factor)/(ctx->sector_size/((dptr->flags & DEV_SECTORS) ? 512 : 1)));
-    t_lba sect;
-
-    for (sect = 0; sect < sects; sect++) {
-        t_lba offset;
-        t_bool sect_error = FALSE;
-
-        for (offset = 0; offset < ctx->sector_size; offset += sizeof(uint32)) {
-            if (*((uint32 *)&buf[sect*ctx->sector_size + offset]) != (uint32)(lba + sect)) {
-                sect_error = TRUE;
-                break;
-                }
-            }
-        if (sect_error) {
-            uint32 save_dctrl = dptr->dctrl;
-            FILE *save_sim_deb = sim_deb;
+if (ctx->map_writable && DK_MAP_COVERS (ctx, lba, sects)) {/* memory mapped? */
+    size_t bytes = ((size_t)sects) * ctx->sector_size;
+    t_offset end_write = (((t_offset)lba) + sects) * ctx->sector_size;
 
-            sim_printf ("\n%s: Write Address Verification Error on lbn %d(0x%X) of %d(0x%X).\n", sim_uname (uptr), (int)(lba+sect), (int)(lba+sect), (int)total_sectors, (int)total_sectors);
-            dptr->dctrl = 0xFFFFFFFF;
-            sim_deb = save_sim_deb ? save_sim_deb : stdout;
-            sim_disk_data_trace (uptr, buf+sect*ctx->sector_size, lba+sect, ctx->sector_size,    "Found", TRUE, 1);
-            dptr->dctrl = save_dctrl;
-            sim_deb = save_sim_deb;
-            }
-        }
+    if (!sim_end && (ctx->xfer_encode_size != sizeof (char)))
+        sim_buf_copy_swapped (DK_MAP_ADDR (ctx, lba), buf, ctx->xfer_encode_size, bytes / ctx->xfer_encode_size);
+    else
+        memcpy (DK_MAP_ADDR (ctx, lba), buf, bytes);
+    if (sectswritten)
+        *sectswritten = sects;
+    if (ctx->highwater < end_write)
+        ctx->highwater = end_write;
+    return SCPE_OK;
     }
 switch (f) {                                            /* case on format */
     case DKUF_F_STD:                                    /* SIMH format */
         r = _sim_disk_wrsect (uptr, lba, buf, &written, sects);
         break;
     case DKUF_F_VHD:                                    /* VHD format */
+    case DKUF_F_SPARSE:                                 /* SIMH Sparse format */
         if (!sim_end && (ctx->xfer_encode_size != sizeof (char))) {
             tbuf = (uint8*) malloc (sects * ctx->sector_size);
             if (NULL == tbuf)
@@ -1090,7 +1403,10 @@ switch (f) {                                            /* case on format */
             sim_buf_copy_swapped (tbuf, buf, ctx->xfer_encode_size, (sects * ctx->sector_size) / ctx->xfer_encode_size);
             buf = tbuf;
             }
-        r = sim_vhd_disk_wrsect  (uptr, lba, buf, &written, sects);
+        if (f == DKUF_F_VHD)
+            r = sim_vhd_disk_wrsect  (uptr, lba, buf, &written, sects);
+        else
+            r = sim_sparse_disk_wrsect (uptr, lba, buf, &written, sects);
         break;
     case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
         break;                                          /* handle below */
@@ -1147,78 +1463,560 @@ if (written > 0) {
 return r;
 }
 
-t_stat sim_disk_wrsect_a (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects, DISK_PCALLBACK callback)
+/* Write the bitmap bytes covering sectors first through last */
+
+static t_stat _sim_disk_ovl_wrbitmap (struct disk_overlay *ovl, t_lba first, t_lba last)
 {
-t_stat r = SCPE_OK;
-AIO_CALLSETUP
-    r =  sim_disk_wrsect (uptr, lba, buf, sectswritten, sects);
-AIO_CALL(DOP_WSEC, lba, buf, sectswritten, sects, callback);
-return r;
+size_t start = (size_t)(first >> 3);
+size_t bytes = (size_t)(last >> 3) - start + 1;
+
+if (sim_fseeko (ovl->file, ovl->bitmap_offset + start, SEEK_SET) ||
+    (fwrite (ovl->bitmap + start, 1, bytes, ovl->file) != bytes))
+    return SCPE_IOERR;
+return SCPE_OK;
 }
 
-t_stat sim_disk_unload (UNIT *uptr)
+/* Write host byte order sectors to a snapshot overlay */
+
+static t_stat _sim_disk_ovl_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
 {
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_overlay *ovl = ctx->overlay;
+size_t bytes = (size_t)sects * ctx->sector_size;
+uint8 *tbuf = NULL;
+t_bool changed = FALSE;
+t_lba sect;
+size_t i;
 
-switch (DK_GET_FMT (uptr)) {                            /* case on format */
-    case DKUF_F_STD:                                    /* Simh */
-    case DKUF_F_VHD:                                    /* VHD format */
-        ctx->media_removed = 1;
-        return sim_disk_detach (uptr);
-    case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
-        ctx->media_removed = 1;
-        sim_os_disk_unload_raw (uptr->fileref);         /* remove/eject disk */
-        return sim_disk_detach (uptr);
-        break;
-    default:
-        return SCPE_NOFNC;
+if (sectswritten)
+    *sectswritten = 0;
+if ((lba >= ovl->sectors) || (sects > ovl->sectors - lba))
+    return SCPE_IOERR;
+if (!sim_end && (ctx->xfer_encode_size != sizeof (char))) {
+    tbuf = (uint8*) malloc (bytes);
+    if (NULL == tbuf)
+        return SCPE_MEM;
+    sim_buf_copy_swapped (tbuf, buf, ctx->xfer_encode_size, bytes / ctx->xfer_encode_size);
+    buf = tbuf;
+    }
+i = 0;
+if (0 == sim_fseeko (ovl->file, ovl->data_offset + ((t_offset)lba) * ctx->sector_size, SEEK_SET))
+    i = fwrite (buf, 1, bytes, ovl->file);
+free (tbuf);
+if (i < bytes)
+    return SCPE_IOERR;
+for (sect = lba; sect < lba + sects; sect++) {
+    if (!OVL_PRESENT (ovl, sect)) {
+        ovl->bitmap[sect >> 3] |= (1 << (sect & 7));
+        ++ovl->changed;
+        changed = TRUE;
+        }
     }
+if (changed && (_sim_disk_ovl_wrbitmap (ovl, lba, lba + sects - 1) != SCPE_OK))
+    return SCPE_IOERR;
+if (sectswritten)
+    *sectswritten = sects;
+return SCPE_OK;
 }
 
-t_stat sim_disk_erase (UNIT *uptr)
+static t_stat _sim_disk_uncached_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
 {
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
-uint8 *buf;
-t_lba lba;
 
-if (uptr->flags & UNIT_ATT)
-    return SCPE_UNATT;
+if (ctx->overlay != NULL)                               /* snapshot overlay active? */
+    return _sim_disk_ovl_wrsect (uptr, lba, buf, sectswritten, sects);
+return _sim_disk_fmt_wrsect (uptr, lba, buf, sectswritten, sects);
+}
 
-buf = (uint8 *)calloc (1, ctx->storage_sector_size);
-if (buf == NULL)
-    return SCPE_MEM;
-for (lba = 0; lba < ctx->container_size / ctx->sector_size; lba++)
-    sim_disk_wrsect (uptr, lba, buf, NULL, 1);          /* write sector */
-free (buf);
-return SCPE_OK;
+/* Sector cache support */
+
+static uint32 _sim_disk_cache_find (struct disk_cache *cache, t_lba lba)
+{
+uint32 idx;
+
+for (idx = cache->hash[lba & cache->hash_mask]; idx != DK_CACHE_NIL; idx = cache->entry[idx].hnext)
+    if (cache->entry[idx].lba == lba)
+        return idx;
+return DK_CACHE_NIL;
 }
 
-/*
-   This routine is called when the simulator stops and any time
-   the asynch mode is changed (enabled or disabled)
-*/
-static void _sim_disk_io_flush (UNIT *uptr)
+/* Make an entry the most recently used one */
+
+static void _sim_disk_cache_touch (struct disk_cache *cache, uint32 idx)
 {
-uint32 f = DK_GET_FMT (uptr);
+struct disk_cache_entry *e = &cache->entry[idx];
 
-#if defined (SIM_ASYNCH_IO)
+if (cache->mru == idx)
+    return;
+cache->entry[e->prev].next = e->next;                   /* unlink */
+if (e->next != DK_CACHE_NIL)
+    cache->entry[e->next].prev = e->prev;
+else
+    cache->lru = e->prev;
+e->prev = DK_CACHE_NIL;                                 /* insert at the head */
+e->next = cache->mru;
+cache->entry[cache->mru].prev = idx;
+cache->mru = idx;
+}
+
+static void _sim_disk_cache_unhash (struct disk_cache *cache, uint32 idx)
+{
+uint32 *link = &cache->hash[cache->entry[idx].lba & cache->hash_mask];
+
+while (*link != idx)
+    link = &cache->entry[*link].hnext;
+*link = cache->entry[idx].hnext;
+cache->entry[idx].valid = FALSE;
+}
+
+/* Claim the least recently used entry for lba, writing it back if dirty */
+
+static t_stat _sim_disk_cache_alloc (UNIT *uptr, t_lba lba, uint32 *pidx)
+{
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache *cache = ctx->cache;
+uint32 idx = cache->lru;
+struct disk_cache_entry *e = &cache->entry[idx];
 
-sim_disk_clr_async (uptr);
-if (sim_asynch_enabled)
-    sim_disk_set_async (uptr, ctx->asynch_io_latency);
-#endif
-switch (f) {                                            /* case on format */
+if (e->valid) {
+    if (e->dirty) {
+        t_seccnt written = 0;
+        t_stat r = _sim_disk_uncached_wrsect (uptr, e->lba, DK_CACHE_DATA (ctx, idx), &written, 1);
+
+        if (r != SCPE_OK)
+            return r;
+        if (written != 1)
+            return SCPE_IOERR;
+        e->dirty = FALSE;
+        --cache->dirty;
+        ++cache->write_backs;
+        }
+    _sim_disk_cache_unhash (cache, idx);
+    }
+e->lba = lba;
+e->valid = TRUE;
+e->dirty = FALSE;
+e->hnext = cache->hash[lba & cache->hash_mask];
+cache->hash[lba & cache->hash_mask] = idx;
+_sim_disk_cache_touch (cache, idx);
+*pidx = idx;
+return SCPE_OK;
+}
+
+static t_stat _sim_disk_cache_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache *cache = ctx->cache;
+t_seccnt i, sread = 0;
+uint32 idx;
+t_stat r;
+
+cache->reads += sects;
+for (i = 0; i < sects; i++)
+    if (_sim_disk_cache_find (cache, lba + i) == DK_CACHE_NIL)
+        break;
+if (i == sects) {                                       /* all sectors present? */
+    for (i = 0; i < sects; i++) {
+        idx = _sim_disk_cache_find (cache, lba + i);
+        memcpy (buf + ((size_t)i) * ctx->sector_size, DK_CACHE_DATA (ctx, idx), ctx->sector_size);
+        _sim_disk_cache_touch (cache, idx);
+        }
+    cache->read_hits += sects;
+    if (sectsread)
+        *sectsread = sects;
+    return SCPE_OK;
+    }
+r = _sim_disk_uncached_rdsect (uptr, lba, buf, &sread, sects);
+for (i = 0; i < sread; i++) {
+    uint8 *sbuf = buf + ((size_t)i) * ctx->sector_size;
+
+    idx = _sim_disk_cache_find (cache, lba + i);
+    if (idx != DK_CACHE_NIL) {
+        if (cache->entry[idx].dirty)                    /* cached data is newer */
+            memcpy (sbuf, DK_CACHE_DATA (ctx, idx), ctx->sector_size);
+        else
+            memcpy (DK_CACHE_DATA (ctx, idx), sbuf, ctx->sector_size);
+        _sim_disk_cache_touch (cache, idx);             /* read from the container, so not a hit */
+        }
+    else {
+        if ((sects > cache->entries / 2) ||             /* large transfers would flush the cache */
+            (_sim_disk_cache_alloc (uptr, lba + i, &idx) != SCPE_OK))
+            continue;
+        memcpy (DK_CACHE_DATA (ctx, idx), sbuf, ctx->sector_size);
+        }
+    }
+if (sectsread)
+    *sectsread = sread;
+return r;
+}
+
+static t_stat _sim_disk_cache_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache *cache = ctx->cache;
+t_seccnt i, written = 0;
+uint32 idx;
+t_stat r;
+
+cache->writes += sects;
+if ((!cache->write_back) ||
+    (sects > cache->entries / 2)) {                     /* write through */
+    r = _sim_disk_uncached_wrsect (uptr, lba, buf, &written, sects);
+    for (i = 0; i < written; i++) {
+        idx = _sim_disk_cache_find (cache, lba + i);
+        if (idx == DK_CACHE_NIL) {
+            if ((sects > cache->entries / 2) ||
+                (_sim_disk_cache_alloc (uptr, lba + i, &idx) != SCPE_OK))
+                continue;
+            }
+        else {
+            if (cache->entry[idx].dirty) {
+                cache->entry[idx].dirty = FALSE;
+                --cache->dirty;
+                }
+            _sim_disk_cache_touch (cache, idx);
+            }
+        memcpy (DK_CACHE_DATA (ctx, idx), buf + ((size_t)i) * ctx->sector_size, ctx->sector_size);
+        }
+    if (sectswritten)
+        *sectswritten = written;
+    return r;
+    }
+if (sectswritten)
+    *sectswritten = 0;
+for (i = 0; i < sects; i++) {                           /* write back */
+    idx = _sim_disk_cache_find (cache, lba + i);
+    if (idx == DK_CACHE_NIL) {
+        r = _sim_disk_cache_alloc (uptr, lba + i, &idx);
+        if (r != SCPE_OK)
+            return r;
+        }
+    else
+        _sim_disk_cache_touch (cache, idx);
+    memcpy (DK_CACHE_DATA (ctx, idx), buf + ((size_t)i) * ctx->sector_size, ctx->sector_size);
+    if (!cache->entry[idx].dirty) {
+        cache->entry[idx].dirty = TRUE;
+        ++cache->dirty;
+        }
+    if (sectswritten)
+        *sectswritten = i + 1;
+    }
+return SCPE_OK;
+}
+
+/* Write every dirty sector to the container, in lba order */
+
+struct disk_cache_dirty {
+    t_lba               lba;
+    uint32              idx;
+    };
+
+static int _sim_disk_cache_dirty_compare (const void *pa, const void *pb)
+{
+const struct disk_cache_dirty *a = (const struct disk_cache_dirty *)pa;
+const struct disk_cache_dirty *b = (const struct disk_cache_dirty *)pb;
+
+return (a->lba < b->lba) ? -1 : ((a->lba > b->lba) ? 1 : 0);
+}
+
+static t_stat _sim_disk_cache_flush (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache *cache = ctx->cache;
+struct disk_cache_dirty *list;
+t_seccnt max_run = 128;
+uint8 *buf;
+uint32 i, j, n = 0;
+t_stat r = SCPE_OK;
+
+if ((cache == NULL) || (cache->dirty == 0))
+    return SCPE_OK;
+list = (struct disk_cache_dirty *)malloc (cache->dirty * sizeof (*list));
+buf = (uint8 *)malloc (max_run * ctx->sector_size);
+if ((list == NULL) || (buf == NULL)) {
+    free (list);
+    free (buf);
+    return SCPE_MEM;
+    }
+for (i = 0; i < cache->entries; i++) {
+    if (cache->entry[i].valid && cache->entry[i].dirty) {
+        list[n].lba = cache->entry[i].lba;
+        list[n].idx = i;
+        ++n;
+        }
+    }
+qsort (list, n, sizeof (*list), _sim_disk_cache_dirty_compare);
+for (i = 0; i < n; i += j) {
+    t_seccnt written = 0;
+
+    for (j = 1; (i + j < n) && (j < max_run) && (list[i + j].lba == list[i].lba + j); j++)
+        ;
+    for (written = 0; written < j; written++)
+        memcpy (buf + ((size_t)written) * ctx->sector_size, DK_CACHE_DATA (ctx, list[i + written].idx), ctx->sector_size);
+    r = _sim_disk_uncached_wrsect (uptr, list[i].lba, buf, &written, j);
+    if ((r == SCPE_OK) && (written != j))
+        r = SCPE_IOERR;
+    if (r != SCPE_OK)
+        break;
+    for (written = 0; written < j; written++)
+        cache->entry[list[i + written].idx].dirty = FALSE;
+    cache->dirty -= j;
+    cache->write_backs += j;
+    }
+free (list);
+free (buf);
+return r;
+}
+
+/* Forget all cached data (dirty data is lost) */
+
+static void _sim_disk_cache_invalidate (struct disk_cache *cache)
+{
+uint32 i;
+
+if (cache == NULL)
+    return;
+for (i = 0; i <= cache->hash_mask; i++)
+    cache->hash[i] = DK_CACHE_NIL;
+for (i = 0; i < cache->entries; i++) {
+    cache->entry[i].valid = FALSE;
+    cache->entry[i].dirty = FALSE;
+    cache->entry[i].prev = (i == 0) ? DK_CACHE_NIL : i - 1;
+    cache->entry[i].next = (i == cache->entries - 1) ? DK_CACHE_NIL : i + 1;
+    }
+cache->mru = 0;
+cache->lru = cache->entries - 1;
+cache->dirty = 0;
+}
+
+static t_stat _sim_disk_cache_free (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache *cache = ctx->cache;
+t_stat r;
+
+if (cache == NULL)
+    return SCPE_OK;
+r = _sim_disk_cache_flush (uptr);
+ctx->cache = NULL;
+free (cache->hash);
+free (cache->entry);
+free (cache->data);
+free (cache);
+return r;
+}
+
+static t_stat _sim_disk_cache_create (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache *cache;
+uint32 hash_size = 1;
+t_stat r;
+
+r = _sim_disk_cache_free (uptr);
+if ((r != SCPE_OK) || (ctx->cache_size == 0))
+    return r;
+while (hash_size < 2 * ctx->cache_size)
+    hash_size <<= 1;
+cache = (struct disk_cache *)calloc (1, sizeof (*cache));
+if (cache == NULL)
+    return SCPE_MEM;
+cache->entries = ctx->cache_size;
+cache->hash_mask = hash_size - 1;
+cache->write_back = (ctx->cache_mode == DK_CACHE_WRBACK);
+cache->hash = (uint32 *)malloc (hash_size * sizeof (*cache->hash));
+cache->entry = (struct disk_cache_entry *)calloc (cache->entries, sizeof (*cache->entry));
+cache->data = (uint8 *)malloc (((size_t)cache->entries) * ctx->sector_size);
+if ((cache->hash == NULL) || (cache->entry == NULL) || (cache->data == NULL)) {
+    free (cache->hash);
+    free (cache->entry);
+    free (cache->data);
+    free (cache);
+    return sim_messagef (SCPE_MEM, "%s: Can't allocate a %u sector cache\n", sim_uname (uptr), ctx->cache_size);
+    }
+_sim_disk_cache_invalidate (cache);
+ctx->cache = cache;
+return SCPE_OK;
+}
+
+t_stat sim_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+double start = SIM_PERF_START ();
+t_seccnt swritten = 0;
+t_stat r;
+
+sim_debug_unit (ctx->dbit, uptr, "sim_disk_wrsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr - ctx->dptr->units), lba, sects);
+
+if (sectswritten == NULL)                               /* count transferred sectors for the counters */
+    sectswritten = &swritten;
+*sectswritten = 0;
+ctx->write_count++;                                     /* record write operation */
+if (uptr->dynflags & UNIT_DISK_CHK) {
+    DEVICE *dptr = find_dev_from_unit (uptr);
+    uint32 capac_factor = ((dptr->dwidth / dptr->aincr) >= 32) ? 8 : ((dptr->dwidth / dptr->aincr) == 16) ? 2 : 1; /* capacity units (quadword: 8, word: 2, byte: 1) */
+    t_lba total_sectors = (t_lba)((uptr->capac*capac_factor)/(ctx->sector_size/((dptr->flags & DEV_SECTORS) ? 512 : 1)));
+    t_lba sect;
+
+    for (sect = 0; sect < sects; sect++) {
+        t_lba offset;
+        t_bool sect_error = FALSE;
+
+        for (offset = 0; offset < ctx->sector_size; offset += sizeof(uint32)) {
+            if (*((uint32 *)&buf[sect*ctx->sector_size + offset]) != (uint32)(lba + sect)) {
+                sect_error = TRUE;
+                break;
+                }
+            }
+        if (sect_error) {
+            uint32 save_dctrl = dptr->dctrl;
+            FILE *save_sim_deb = sim_deb;
+
+            sim_printf ("\n%s: Write Address Verification Error on lbn %d(0x%X) of %d(0x%X).\n", sim_uname (uptr), (int)(lba+sect), (int)(lba+sect), (int)total_sectors, (int)total_sectors);
+            dptr->dctrl = 0xFFFFFFFF;
+            sim_deb = save_sim_deb ? save_sim_deb : stdout;
+            sim_disk_data_trace (uptr, buf+sect*ctx->sector_size, lba+sect, ctx->sector_size,    "Found", TRUE, 1);
+            dptr->dctrl = save_dctrl;
+            sim_deb = save_sim_deb;
+            }
+        }
+    }
+if (ctx->cache != NULL)                                 /* sector cache? */
+    r = _sim_disk_cache_wrsect (uptr, lba, buf, sectswritten, sects);
+else
+    r = _sim_disk_uncached_wrsect (uptr, lba, buf, sectswritten, sects);
+if (start != 0.0) {                                     /* performance counters enabled? */
+    sim_perf_add (ctx->perf_write, ((t_uint64)*sectswritten) * ctx->sector_size);
+    sim_perf_latency (ctx->perf_wlat, start);
+    }
+return r;
+}
+
+t_stat sim_disk_wrsect_a (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects, DISK_PCALLBACK callback)
+{
+t_stat r = SCPE_OK;
+AIO_CALLSETUP
+    r =  sim_disk_wrsect (uptr, lba, buf, sectswritten, sects);
+AIO_CALL(DOP_WSEC, lba, buf, sectswritten, sects, callback);
+return r;
+}
+
+t_stat sim_disk_unload (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+switch (DK_GET_FMT (uptr)) {                            /* case on format */
+    case DKUF_F_STD:                                    /* Simh */
+    case DKUF_F_VHD:                                    /* VHD format */
+    case DKUF_F_SPARSE:                                 /* SIMH Sparse format */
+        ctx->media_removed = 1;
+        return sim_disk_detach (uptr);
+    case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+        ctx->media_removed = 1;
+        sim_os_disk_unload_raw (uptr->fileref);         /* remove/eject disk */
+        return sim_disk_detach (uptr);
+        break;
+    default:
+        return SCPE_NOFNC;
+    }
+}
+
+t_stat sim_disk_erase (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if (!(uptr->flags & UNIT_ATT))
+    return SCPE_UNATT;
+return sim_disk_trim (uptr, 0, (t_seccnt)(ctx->container_size / ctx->sector_size));
+}
+
+/* Discard the contents of a range of sectors so they subsequently read as
+   zeros.  SIMH Sparse containers release the space the range occupied,
+   other formats (and snapshot overlays) have the range written with zeros.
+ */
+
+t_stat sim_disk_trim (UNIT *uptr, t_lba lba, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_seccnt chunk;
+uint8 *buf;
+t_stat r = SCPE_OK;
+
+if (!(uptr->flags & UNIT_ATT))
+    return SCPE_UNATT;
+if (uptr->flags & UNIT_RO)
+    return SCPE_RO;
+sim_debug_unit (ctx->dbit, uptr, "sim_disk_trim(unit=%d, lba=0x%X, sects=%u)\n", (int)(uptr - ctx->dptr->units), lba, sects);
+if ((DK_GET_FMT (uptr) == DKUF_F_SPARSE) && (ctx->overlay == NULL)) {
+    if (ctx->cache != NULL) {                           /* cached sectors may be in the range */
+        r = _sim_disk_cache_flush (uptr);
+        _sim_disk_cache_invalidate (ctx->cache);
+        }
+    if (r == SCPE_OK)
+        r = sim_sparse_disk_trim (uptr, lba, sects);
+    return r;
+    }
+chunk = (ctx->sector_size < 1024*1024) ? (t_seccnt)((1024*1024) / ctx->sector_size) : 1;
+buf = (uint8 *)calloc (chunk, ctx->sector_size);
+if (buf == NULL)
+    return SCPE_MEM;
+while ((r == SCPE_OK) && (sects > 0)) {
+    t_seccnt n = (sects < chunk) ? sects : chunk;
+
+    r = sim_disk_wrsect (uptr, lba, buf, NULL, n);
+    lba += n;
+    sects -= n;
+    }
+free (buf);
+return r;
+}
+
+/* Write any cached data to the container and flush the host buffers */
+
+t_stat sim_disk_flush (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_stat r;
+
+if (!(uptr->flags & UNIT_ATT) || (ctx == NULL))
+    return SCPE_UNATT;
+r = _sim_disk_cache_flush (uptr);                       /* write back dirty sectors */
+if (ctx->map_writable &&                                /* memory mapped? */
+    (sim_os_disk_sync_map (ctx->map, ctx->map_size) != SCPE_OK))
+    r = SCPE_IOERR;
+switch (DK_GET_FMT (uptr)) {                            /* case on format */
     case DKUF_F_STD:                                    /* Simh */
         fflush (uptr->fileref);
         break;
     case DKUF_F_VHD:                                    /* Virtual Disk */
         sim_vhd_disk_flush (uptr->fileref);
         break;
+    case DKUF_F_SPARSE:                                 /* SIMH Sparse format */
+        sim_sparse_disk_flush (uptr->fileref);
+        break;
     case DKUF_F_RAW:                                    /* Physical */
         sim_os_disk_flush_raw (uptr->fileref);
         break;
         }
+if (ctx->overlay != NULL)                               /* snapshot overlay? */
+    fflush (ctx->overlay->file);
+return r;
+}
+
+/*
+   This routine is called when the simulator stops and any time
+   the asynch mode is changed (enabled or disabled)
+*/
+static void _sim_disk_io_flush (UNIT *uptr)
+{
+#if defined (SIM_ASYNCH_IO)
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+sim_disk_clr_async (uptr);
+if (sim_asynch_enabled)
+    sim_disk_set_async (uptr, ctx->asynch_io_latency);
+#endif
+sim_disk_flush (uptr);
 }
 
 static t_stat _err_return (UNIT *uptr, t_stat stat)
@@ -2886,6 +3684,12 @@ switch (DK_GET_FMT (uptr)) {                            /* case on format */
         free (f);
         f = NULL;
         break;
+    case DKUF_F_SPARSE:                                 /* SIMH Sparse format */
+        sim_sparse_disk_get_footer (uptr->fileref, f);
+        container_size = sim_sparse_disk_size (uptr->fileref);
+        if (f->Checksum == NtoHl (eth_crc32 (0, f, sizeof (*f) - sizeof (f->Checksum))))
+            container_size += sizeof (*f);              /* Adjust since it is removed below */
+        break;
     case DKUF_F_VHD:                                    /* VHD format */
         if (1) {
             time_t creation_time;
@@ -3058,7 +3862,10 @@ strlcpy ((char*)f->DeviceName, dptr->name, sizeof (f->DeviceName));
 f->MediaID = (uptr->drvtyp != NULL) ? NtoHl (uptr->drvtyp->MediaId) : 0;
 f->DataWidth = NtoHl (uptr->dptr->dwidth);
 f->Geometry = NtoHl (sim_disk_drvtype_geometry (sim_disk_find_type (uptr, (char *)f->DriveType), (uint32)total_sectors));
-highwater = sim_fsize_name_ex (uptr->filename);
+if (DK_GET_FMT (uptr) == DKUF_F_SPARSE)                 /* container size isn't the data extent */
+    highwater = ctx->highwater;
+else
+    highwater = sim_fsize_name_ex (uptr->filename);
 /* Align Initial Highwater to a sector boundary */
 highwater = ((highwater + ctx->sector_size - 1) / ctx->sector_size) * ctx->sector_size;
 f->Highwater[0] = NtoHl ((uint32)(highwater >> 32));
@@ -3086,6 +3893,9 @@ else {
             break;
         case DKUF_F_VHD:                                    /* VHD format */
             break;
+        case DKUF_F_SPARSE:                                 /* SIMH Sparse format */
+            sim_sparse_disk_set_footer (uptr->fileref, f, total_sectors * ctx->sector_size);
+            break;
         case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
             sim_os_disk_write (uptr, total_sectors * ctx->sector_size, (uint8 *)f, NULL, sizeof (*f));
             sim_os_disk_close_raw (uptr->fileref);
@@ -3145,6 +3955,9 @@ switch (DK_GET_FMT (uptr)) {
         break;
     case DKUF_F_VHD:                                    /* VHD format */
         break;
+    case DKUF_F_SPARSE:                                 /* SIMH Sparse format */
+        sim_sparse_disk_set_footer (uptr->fileref, f, total_sectors * ctx->sector_size);
+        break;
     case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
         sim_os_disk_write (uptr, total_sectors * ctx->sector_size, (uint8 *)f, NULL, sizeof (*f));
         sim_os_disk_close_raw (uptr->fileref);
@@ -3157,10 +3970,430 @@ switch (DK_GET_FMT (uptr)) {
 return SCPE_OK;
 }
 
-t_stat sim_disk_attach (UNIT *uptr, const char *cptr, size_t sector_size, size_t xfer_encode_size, t_bool dontchangecapac,
-                        uint32 dbit, const char *dtype, uint32 pdp11tracksize, int completion_delay)
+/* Snapshot overlay management */
+
+static void _sim_disk_ovl_free (struct disk_overlay *ovl)
 {
-return sim_disk_attach_ex (uptr, cptr, sector_size, xfer_encode_size, dontchangecapac, dbit, dtype, pdp11tracksize, completion_delay, NULL);
+if (ovl == NULL)
+    return;
+if (ovl->file != NULL)
+    fclose (ovl->file);
+free (ovl->filename);
+free (ovl->bitmap);
+free (ovl);
+}
+
+/* Memory mapped container management */
+
+static void _sim_disk_map (UNIT *uptr, t_offset size)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_bool writable = ((uptr->flags & UNIT_RO) == 0);
+t_offset container_size;
+
+if (sim_os_disk_implemented_map () != SCPE_OK) {
+    sim_messagef (SCPE_OK, "%s: Memory mapped access is not supported on this host, using file I/O\n", sim_uname (uptr));
+    return;
+    }
+if (DK_GET_FMT (uptr) != DKUF_F_STD) {
+    sim_messagef (SCPE_OK, "%s: Memory mapped access is only available for SIMH containers\n", sim_uname (uptr));
+    return;
+    }
+fflush (uptr->fileref);
+container_size = sim_fsize_ex (uptr->fileref);
+if ((ctx->footer != NULL) && (container_size >= (t_offset)sizeof (*ctx->footer)))
+    container_size -= sizeof (*ctx->footer);            /* metadata isn't disk data */
+if (size > container_size)                              /* map what exists, file I/O beyond */
+    size = container_size;
+ctx->map = sim_os_disk_map (uptr, size, writable);
+if (ctx->map == NULL) {
+    sim_messagef (SCPE_OK, "%s: Can't memory map '%s' (a non empty regular file on a local file system is required), using file I/O\n", sim_uname (uptr), uptr->filename);
+    return;
+    }
+ctx->map_size = size;
+ctx->map_writable = writable;
+sim_debug_unit (ctx->dbit, uptr, "_sim_disk_map(%s, size=%" LL_FMT "u, %s)\n", uptr->filename, (t_uint64)size, writable ? "read/write" : "read only");
+}
+
+static void _sim_disk_unmap (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if (ctx->map == NULL)
+    return;
+if (ctx->map_writable)
+    sim_os_disk_sync_map (ctx->map, ctx->map_size);
+sim_os_disk_unmap (ctx->map, ctx->map_size);
+ctx->map = NULL;
+ctx->map_size = 0;
+ctx->map_writable = FALSE;
+}
+
+static t_stat _sim_disk_ovl_open (UNIT *uptr, const char *filename)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct simh_disk_overlay_header *h = NULL;
+struct disk_overlay *ovl = NULL;
+t_offset capac_size = ((t_offset)uptr->capac)*ctx->capac_factor*((ctx->dptr->flags & DEV_SECTORS) ? 512 : 1);
+t_offset base_size = ctx->container_size;
+t_lba sect;
+t_stat r = SCPE_OK;
+
+if (ctx->overlay != NULL)
+    return sim_messagef (SCPE_ALATT, "%s: Snapshot overlay already active: %s\n", sim_uname (uptr), ctx->overlay->filename);
+if (capac_size < base_size)
+    capac_size = base_size;
+h = (struct simh_disk_overlay_header *)calloc (1, sizeof (*h));
+ovl = (struct disk_overlay *)calloc (1, sizeof (*ovl));
+if ((h == NULL) || (ovl == NULL)) {
+    free (h);
+    free (ovl);
+    return SCPE_MEM;
+    }
+ovl->sectors = (t_lba)((capac_size + ctx->sector_size - 1) / ctx->sector_size);
+ovl->bitmap_size = ((((size_t)ovl->sectors) + 7) / 8 + 511) & ~((size_t)511);
+ovl->bitmap_offset = sizeof (*h);
+ovl->data_offset = (ovl->bitmap_offset + ovl->bitmap_size + 4095) & ~((t_offset)4095);
+ovl->filename = strdup (filename);
+ovl->bitmap = (uint8 *)calloc (1, ovl->bitmap_size);
+if ((ovl->filename == NULL) || (ovl->bitmap == NULL)) {
+    free (h);
+    _sim_disk_ovl_free (ovl);
+    return SCPE_MEM;
+    }
+ovl->file = sim_fopen (filename, "rb+");
+if (ovl->file != NULL) {                                /* existing overlay? */
+    if ((fread (h, 1, sizeof (*h), ovl->file) != sizeof (*h)) ||
+        (memcmp (h->Signature, "simhsnap", sizeof (h->Signature)) != 0) ||
+        (NtoHl (h->Version) != OVERLAY_VERSION) ||
+        (h->Checksum != NtoHl (eth_crc32 (0, h, sizeof (*h) - sizeof (h->Checksum)))))
+        r = sim_messagef (SCPE_OPENERR, "%s: '%s' is not a snapshot overlay file\n", sim_uname (uptr), filename);
+    else {
+        if ((NtoHl (h->SectorSize) != ctx->sector_size) ||
+            (NtoHl (h->SectorCount) != ovl->sectors) ||
+            (((((t_offset)NtoHl (h->BaseSize[0])) << 32) | ((t_offset)NtoHl (h->BaseSize[1]))) != base_size))
+            r = sim_messagef (SCPE_INCOMPDSK, "%s: Snapshot overlay '%s' was created for a different disk: %s\n", sim_uname (uptr), filename, h->BaseName);
+        else {
+            ovl->bitmap_offset = NtoHl (h->BitmapOffset);
+            ovl->data_offset = (((t_offset)NtoHl (h->DataOffset[0])) << 32) | ((t_offset)NtoHl (h->DataOffset[1]));
+            if (sim_fseeko (ovl->file, ovl->bitmap_offset, SEEK_SET) ||
+                (fread (ovl->bitmap, 1, ovl->bitmap_size, ovl->file) != ovl->bitmap_size))
+                r = sim_messagef (SCPE_IOERR, "%s: Error reading snapshot overlay bitmap: %s\n", sim_uname (uptr), filename);
+            for (sect = 0; sect < ovl->sectors; sect++)
+                if (OVL_PRESENT (ovl, sect))
+                    ++ovl->changed;
+            }
+        }
+    }
+else {                                                  /* create a new overlay */
+    time_t now = time (NULL);
+
+    ovl->file = sim_fopen (filename, "wb+");
+    if (ovl->file == NULL)
+        r = sim_messagef (SCPE_OPENERR, "%s: Can't create snapshot overlay '%s': %s\n", sim_uname (uptr), filename, strerror (errno));
+    else {
+        memcpy (h->Signature, "simhsnap", sizeof (h->Signature));
+        h->Version = NtoHl (OVERLAY_VERSION);
+        h->SectorSize = NtoHl (ctx->sector_size);
+        h->SectorCount = NtoHl (ovl->sectors);
+        h->BitmapOffset = NtoHl ((uint32)ovl->bitmap_offset);
+        h->DataOffset[0] = NtoHl ((uint32)(ovl->data_offset >> 32));
+        h->DataOffset[1] = NtoHl ((uint32)(ovl->data_offset & 0xFFFFFFFF));
+        h->BaseSize[0] = NtoHl ((uint32)(base_size >> 32));
+        h->BaseSize[1] = NtoHl ((uint32)(base_size & 0xFFFFFFFF));
+        strlcpy ((char*)h->CreationTime, ctime (&now), sizeof (h->CreationTime));
+        strlcpy ((char*)h->BaseName, uptr->filename, sizeof (h->BaseName));
+        h->Checksum = NtoHl (eth_crc32 (0, h, sizeof (*h) - sizeof (h->Checksum)));
+        if ((fwrite (h, 1, sizeof (*h), ovl->file) != sizeof (*h)) ||
+            (fwrite (ovl->bitmap, 1, ovl->bitmap_size, ovl->file) != ovl->bitmap_size)) {
+            r = sim_messagef (SCPE_IOERR, "%s: Error writing snapshot overlay: %s\n", sim_uname (uptr), filename);
+            fclose (ovl->file);
+            ovl->file = NULL;
+            (void)remove (filename);
+            }
+        }
+    }
+free (h);
+if (r != SCPE_OK) {
+    _sim_disk_ovl_free (ovl);
+    return r;
+    }
+ovl->base_ro = ((uptr->flags & UNIT_RO) != 0);
+uptr->flags &= ~UNIT_RO;                                /* writes now go to the overlay */
+ctx->overlay = ovl;
+sim_debug_unit (ctx->dbit, uptr, "_sim_disk_ovl_open(%s, sectors=%u, changed=%u)\n", filename, (uint32)ovl->sectors, (uint32)ovl->changed);
+return SCPE_OK;
+}
+
+static t_stat _sim_disk_ovl_close (UNIT *uptr, t_bool remove_file)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_overlay *ovl = ctx->overlay;
+t_stat r = SCPE_OK;
+
+if (ovl == NULL)
+    return SCPE_OK;
+if (fclose (ovl->file) == EOF)
+    r = SCPE_IOERR;
+ovl->file = NULL;
+if (remove_file)
+    (void)remove (ovl->filename);
+if (ovl->base_ro)
+    uptr->flags |= UNIT_RO;
+ctx->overlay = NULL;
+_sim_disk_ovl_free (ovl);
+return r;
+}
+
+/* Forget every sector held in the overlay */
+
+static t_stat _sim_disk_ovl_reset (struct disk_overlay *ovl)
+{
+memset (ovl->bitmap, 0, ovl->bitmap_size);
+ovl->changed = 0;
+if ((sim_fseeko (ovl->file, ovl->bitmap_offset, SEEK_SET) != 0) ||
+    (fwrite (ovl->bitmap, 1, ovl->bitmap_size, ovl->file) != ovl->bitmap_size))
+    return SCPE_IOERR;
+fflush (ovl->file);
+sim_set_fsize (ovl->file, (t_addr)ovl->data_offset);   /* release the sector data */
+return SCPE_OK;
+}
+
+/* Reopen the underlying container with a different access mode */
+
+static t_stat _sim_disk_reopen (UNIT *uptr, const char *mode)
+{
+FILE *(*open_function)(const char *filename, const char *mode);
+int (*close_function)(FILE *f);
+
+switch (DK_GET_FMT (uptr)) {                            /* case on format */
+    case DKUF_F_STD:                                    /* SIMH format */
+        open_function = sim_fopen;
+        close_function = fclose;
+        break;
+    case DKUF_F_VHD:                                    /* VHD format */
+        open_function = sim_vhd_disk_open;
+        close_function = sim_vhd_disk_close;
+        break;
+    case DKUF_F_SPARSE:                                 /* SIMH Sparse format */
+        open_function = sim_sparse_disk_open;
+        close_function = sim_sparse_disk_close;
+        break;
+    case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+        open_function = sim_os_disk_open_raw;
+        close_function = sim_os_disk_close_raw;
+        break;
+    default:
+        return SCPE_NOFNC;
+    }
+close_function (uptr->fileref);
+uptr->fileref = open_function (uptr->filename, mode);
+if (uptr->fileref == NULL) {
+    uptr->fileref = open_function (uptr->filename, "rb");
+    return (uptr->fileref == NULL) ? SCPE_IOERR : SCPE_OPENERR;
+    }
+return SCPE_OK;
+}
+
+/* Write the overlay contents into the underlying container */
+
+static t_stat _sim_disk_ovl_merge (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_overlay *ovl = ctx->overlay;
+t_seccnt max_run = (t_seccnt)((1024*1024)/ctx->sector_size);
+t_lba merged = 0;
+t_lba sect;
+uint8 *buf;
+t_stat r = SCPE_OK;
+
+if (ovl->changed == 0)
+    return SCPE_OK;
+if (max_run == 0)
+    max_run = 1;
+buf = (uint8 *)malloc ((size_t)max_run * ctx->sector_size);
+if (buf == NULL)
+    return SCPE_MEM;
+if (ovl->base_ro && (_sim_disk_reopen (uptr, "rb+") != SCPE_OK)) {
+    free (buf);
+    return sim_messagef (SCPE_RO, "%s: Can't open '%s' for writing to merge snapshot\n", sim_uname (uptr), uptr->filename);
+    }
+for (sect = 0; (sect < ovl->sectors) && (r == SCPE_OK); ) {
+    t_seccnt run, written = 0;
+    size_t bytes;
+
+    if (ovl->bitmap[sect >> 3] == 0) {                  /* skip unchanged 8 sector groups */
+        sect = (sect | 7) + 1;
+        continue;
+        }
+    if (!OVL_PRESENT (ovl, sect)) {
+        ++sect;
+        continue;
+        }
+    for (run = 1; (run < max_run) && OVL_PRESENT (ovl, sect + run); run++)
+        ;
+    bytes = (size_t)run * ctx->sector_size;
+    if (sim_fseeko (ovl->file, ovl->data_offset + ((t_offset)sect) * ctx->sector_size, SEEK_SET) ||
+        (fread (buf, 1, bytes, ovl->file) != bytes)) {
+        r = SCPE_IOERR;
+        break;
+        }
+    if (!sim_end && (ctx->xfer_encode_size != sizeof (char)))
+        sim_buf_swap_data (buf, ctx->xfer_encode_size, bytes / ctx->xfer_encode_size);
+    r = _sim_disk_fmt_wrsect (uptr, sect, buf, &written, run);
+    if ((r == SCPE_OK) && (written != run))
+        r = SCPE_IOERR;
+    merged += run;
+    sect += run;
+    }
+free (buf);
+if (r == SCPE_OK) {
+    update_disk_footer (uptr);                          /* record new highwater */
+    r = _sim_disk_ovl_reset (ovl);
+    sim_messagef (SCPE_OK, "%s: Merged %u sectors from snapshot into %s\n", sim_uname (uptr), (uint32)merged, uptr->filename);
+    }
+if (ovl->base_ro)
+    _sim_disk_reopen (uptr, "rb");
+return r;
+}
+
+/* Set disk snapshot overlay
+
+   val = 0      SNAPSHOT{=file}   start an overlay
+   val = 1      NOSNAPSHOT        stop using the overlay
+   val = 2      DISCARD           drop all changes held in the overlay
+   val = 3      MERGE             write the changes into the container
+*/
+
+t_stat sim_disk_set_snapshot (UNIT *uptr, int32 val, CONST char *cptr, void *desc)
+{
+struct disk_context *ctx;
+char gbuf[CBUFSIZE];
+
+if (uptr == NULL)
+    return SCPE_IERR;
+if (!(uptr->flags & UNIT_ATT))
+    return sim_messagef (SCPE_UNATT, "%s: Unit not attached\n", sim_uname (uptr));
+ctx = (struct disk_context *)uptr->disk_ctx;
+if ((val != 0) && (ctx->overlay == NULL))
+    return sim_messagef (SCPE_ARG, "%s: No snapshot overlay active\n", sim_uname (uptr));
+if ((val != 0) && (cptr != NULL))
+    return sim_messagef (SCPE_ARG, "%s: Unexpected snapshot argument: %s\n", sim_uname (uptr), cptr);
+if (uptr->io_flush)
+    uptr->io_flush (uptr);                              /* flush buffered data */
+switch (val) {
+    case 0:
+        if ((cptr == NULL) || (*cptr == '\0'))
+            snprintf (gbuf, sizeof (gbuf), "%s.snap", uptr->filename);
+        else
+            strlcpy (gbuf, cptr, sizeof (gbuf));
+        return _sim_disk_ovl_open (uptr, gbuf);
+    case 1:
+        _sim_disk_cache_invalidate (ctx->cache);        /* cached sectors may come from the overlay */
+        return _sim_disk_ovl_close (uptr, (ctx->overlay->changed == 0));
+    case 2:
+        _sim_disk_cache_invalidate (ctx->cache);
+        return _sim_disk_ovl_reset (ctx->overlay);
+    case 3:
+        return _sim_disk_ovl_merge (uptr);
+    default:
+        return SCPE_IERR;
+    }
+}
+
+/* Show disk snapshot overlay */
+
+t_stat sim_disk_show_snapshot (FILE *st, UNIT *uptr, int32 val, CONST void *desc)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if (!(uptr->flags & UNIT_ATT) || (ctx == NULL) || (ctx->overlay == NULL))
+    fprintf (st, "no snapshot\n");
+else
+    fprintf (st, "snapshot=%s, %u sectors changed\n", ctx->overlay->filename, (uint32)ctx->overlay->changed);
+return SCPE_OK;
+}
+
+/* Set disk sector cache
+
+   val = 0      CACHE{=sectors}   enable the cache (default 256 sectors)
+   val = 1      NOCACHE           disable the cache
+   val = 2      WRITETHROUGH      write-through policy
+   val = 3      WRITEBACK         write-back policy
+*/
+
+t_stat sim_disk_set_cache (UNIT *uptr, int32 val, CONST char *cptr, void *desc)
+{
+struct disk_context *ctx;
+uint32 size, old_size, old_mode;
+t_stat r;
+
+if (uptr == NULL)
+    return SCPE_IERR;
+if (!(uptr->flags & UNIT_ATT))
+    return sim_messagef (SCPE_UNATT, "%s: Unit not attached\n", sim_uname (uptr));
+ctx = (struct disk_context *)uptr->disk_ctx;
+old_size = ctx->cache_size;
+old_mode = ctx->cache_mode;
+if ((val != 0) && (cptr != NULL))
+    return sim_messagef (SCPE_ARG, "%s: Unexpected cache argument: %s\n", sim_uname (uptr), cptr);
+switch (val) {
+    case 0:
+        if ((cptr == NULL) || (*cptr == '\0'))
+            size = DK_CACHE_DEFAULT;
+        else {
+            size = (uint32)get_uint (cptr, 10, DK_CACHE_MAX, &r);
+            if ((r != SCPE_OK) || (size == 0))
+                return sim_messagef (SCPE_ARG, "%s: Invalid cache size: %s\n", sim_uname (uptr), cptr);
+            }
+        ctx->cache_size = size;
+        break;
+    case 1:
+        ctx->cache_size = 0;
+        break;
+    case 2:
+        ctx->cache_mode = DK_CACHE_WRTHRU;
+        break;
+    case 3:
+        ctx->cache_mode = DK_CACHE_WRBACK;
+        break;
+    default:
+        return SCPE_IERR;
+    }
+r = _sim_disk_cache_create (uptr);                      /* rebuild with the new settings */
+if (r != SCPE_OK) {
+    ctx->cache_size = old_size;                         /* the old cache is gone, */
+    ctx->cache_mode = old_mode;                         /*   so try to restore it */
+    if (_sim_disk_cache_create (uptr) != SCPE_OK)
+        ctx->cache_size = 0;
+    }
+return r;
+}
+
+/* Show disk sector cache */
+
+t_stat sim_disk_show_cache (FILE *st, UNIT *uptr, int32 val, CONST void *desc)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache *cache = ((uptr->flags & UNIT_ATT) && (ctx != NULL)) ? ctx->cache : NULL;
+
+if (cache == NULL) {
+    fprintf (st, "no cache\n");
+    return SCPE_OK;
+    }
+fprintf (st, "cache=%u sectors, %s", ctx->cache_size, (ctx->cache_mode == DK_CACHE_WRBACK) ? "write-back" : "write-through");
+if (cache != NULL) {
+    fprintf (st, "\n    %" LL_FMT "u sectors read, %.1f%% hit rate", cache->reads, (cache->reads == 0) ? 0.0 : (100.0 * cache->read_hits) / cache->reads);
+    fprintf (st, "\n    %" LL_FMT "u sectors written, %" LL_FMT "u written back, %u dirty", cache->writes, cache->write_backs, cache->dirty);
+    }
+fprintf (st, "\n");
+return SCPE_OK;
+}
+
+t_stat sim_disk_attach (UNIT *uptr, const char *cptr, size_t sector_size, size_t xfer_encode_size, t_bool dontchangecapac,
+                        uint32 dbit, const char *dtype, uint32 pdp11tracksize, int completion_delay)
+{
+return sim_disk_attach_ex (uptr, cptr, sector_size, xfer_encode_size, dontchangecapac, dbit, dtype, pdp11tracksize, completion_delay, NULL);
 }
 
 t_stat sim_disk_attach_ex (UNIT *uptr, const char *cptr, size_t sector_size, size_t xfer_encode_size, t_bool dontchangecapac,
@@ -3187,6 +4420,12 @@ DRVTYP *size_settable_drive_type = NULL;
 t_offset container_size, filesystem_size, current_unit_size;
 size_t tmp_size = 1;
 DRVTYP *drvtypes = NULL;
+t_bool map_container = ((sim_switches & SWMASK ('P')) != 0);
+#if defined (SIM_ASYNCH_IO)
+t_bool ring_container = ((sim_switches & SWMASK ('A')) != 0);
+#endif
+t_bool compress_container = ((sim_switches & SWMASK ('Z')) != 0);
+t_bool sparse_container = FALSE;
 
 if (uptr->flags & UNIT_DIS)                             /* disabled? */
     return SCPE_UDIS;
@@ -3226,6 +4465,11 @@ if (sim_switches & SWMASK ('F')) {                      /* format spec? */
     cptr = get_glyph (cptr, gbuf, 0);                   /* get spec */
     if (*cptr == 0)                                     /* must be more */
         return SCPE_2FARG;
+    if ((MATCH_CMD (gbuf, "SPARSE") == 0) &&            /* SIMH Sparse container? */
+        (MATCH_CMD (gbuf, "SIMH") != 0)) {
+        sparse_container = TRUE;                        /* SIMH format in a sparse container */
+        strlcpy (gbuf, "SIMH", sizeof (gbuf));
+        }
     if ((sim_disk_set_fmt (uptr, 0, gbuf, NULL) != SCPE_OK) ||
         (DK_GET_FMT (uptr) == DKUF_F_AUTO))
         return sim_messagef (SCPE_ARG, "Invalid Override Disk Format: %s\n", gbuf);
@@ -3249,9 +4493,32 @@ if (sim_switches & SWMASK ('D')) {                      /* create difference dis
         }
     return sim_messagef (SCPE_ARG, "Unable to create differencing VHD: %s - %s\n", gbuf, strerror (errno));
     }
+if (sim_switches & SWMASK ('S')) {                      /* snapshot overlay? */
+    char gbuf[CBUFSIZE];
+    int32 saved_sim_quiet = sim_quiet;
+    t_stat r;
+
+    sim_switches = sim_switches & ~(SWMASK ('S'));
+    cptr = get_glyph_nc (cptr, gbuf, 0);                /* get overlay spec */
+    if (*cptr == 0)                                     /* must be more */
+        return SCPE_2FARG;
+    sim_switches |= SWMASK ('E');                       /* base container must exist */
+    if (uptr->flags & UNIT_ROABLE)                      /* and is read only where allowed */
+        sim_switches |= SWMASK ('R');
+    sim_quiet = TRUE;
+    r = sim_disk_attach_ex2 (uptr, cptr, sector_size, xfer_encode_size, dontchangecapac, dbit, dtype, pdp11tracksize, completion_delay, drivetypes, reserved_sectors);
+    sim_quiet = saved_sim_quiet;
+    if (r != SCPE_OK)
+        return r;
+    r = _sim_disk_ovl_open (uptr, gbuf);
+    if (r != SCPE_OK)
+        sim_disk_detach (uptr);
+    return r;
+    }
 if (sim_switches & SWMASK ('C')) {                      /* create new disk container & copy contents? */
     char gbuf[CBUFSIZE];
-    const char *dest_fmt = ((DK_GET_FMT (uptr) == DKUF_F_AUTO) || (DK_GET_FMT (uptr) == DKUF_F_VHD)) ? "VHD" : "SIMH";
+    const char *dest_fmt = ((DK_GET_FMT (uptr) == DKUF_F_AUTO) || (DK_GET_FMT (uptr) == DKUF_F_VHD)) ? "VHD" :
+                           sparse_container ? "SPARSE" : "SIMH";
     FILE *dest;
     int saved_sim_switches = sim_switches;
     int32 saved_sim_quiet = sim_quiet;
@@ -3269,6 +4536,8 @@ if (sim_switches & SWMASK ('C')) {                      /* create new disk conta
     if (*cptr == 0)                                     /* must be more */
         return sim_messagef (SCPE_2FARG, "Missing Copy container source specification\n");
     sim_switches |= SWMASK ('R') | SWMASK ('E');
+    sim_switches &= ~SWMASK ('P');              /* destination writes use the source's context, */
+                                                /* so no mapping on the source */
     sim_quiet = TRUE;
     sim_disk_set_fmt (uptr, 0, "AUTO", NULL);   /* autodetect the source container format */
     uptr->flags &= ~DKUF_NOAUTOSIZE;            /* autosize the source container */
@@ -3292,8 +4561,12 @@ if (sim_switches & SWMASK ('C')) {                      /* create new disk conta
     target_capac = uptr->capac;
     if (strcmp ("VHD", dest_fmt) == 0)
         dest = sim_vhd_disk_create (gbuf, ((t_offset)uptr->capac)*capac_factor*((dptr->flags & DEV_SECTORS) ? 512 : 1), uptr->drvtyp);
-    else
-        dest = sim_fopen (gbuf, "wb+");
+    else {
+        if (strcmp ("SPARSE", dest_fmt) == 0)
+            dest = sim_sparse_disk_create (gbuf, ((t_offset)uptr->capac)*capac_factor*((dptr->flags & DEV_SECTORS) ? 512 : 1), uptr->drvtyp, compress_container);
+        else
+            dest = sim_fopen (gbuf, "wb+");
+        }
     if (!dest) {
         sim_disk_detach (uptr);
         return sim_messagef (r, "%s: Cannot create %s disk container '%s'\n", sim_uname (uptr), dest_fmt, gbuf);
@@ -3309,8 +4582,12 @@ if (sim_switches & SWMASK ('C')) {                      /* create new disk conta
         if (!copy_buf) {
             if (strcmp ("VHD", dest_fmt) == 0)
                 sim_vhd_disk_close (dest);
-            else
-                fclose (dest);
+            else {
+                if (strcmp ("SPARSE", dest_fmt) == 0)
+                    sim_sparse_disk_close (dest);
+                else
+                    fclose (dest);
+                }
             (void)remove (gbuf);
             sim_disk_detach (uptr);
             return SCPE_MEM;
@@ -3360,8 +4637,12 @@ if (sim_switches & SWMASK ('C')) {                      /* create new disk conta
             if (!verify_buf) {
                 if (strcmp ("VHD", dest_fmt) == 0)
                     sim_vhd_disk_close (dest);
-                else
-                    fclose (dest);
+                else {
+                    if (strcmp ("SPARSE", dest_fmt) == 0)
+                        sim_sparse_disk_close (dest);
+                    else
+                        fclose (dest);
+                    }
                 (void)remove (gbuf);
                 free (copy_buf);
                 sim_disk_detach (uptr);
@@ -3420,15 +4701,19 @@ if (sim_switches & SWMASK ('C')) {                      /* create new disk conta
             sim_vhd_disk_set_dtype (dest, (char *)uptr->drvtyp->name, sector_size, xfer_encode_size, uptr->drvtyp->MediaId, uptr->dptr->name, uptr->dptr->dwidth, uptr->drvtyp);
             sim_vhd_disk_close (dest);
             }
-        else
-            fclose (dest);
+        else {
+            if (strcmp ("SPARSE", dest_fmt) == 0)
+                sim_sparse_disk_close (dest);
+            else
+                fclose (dest);
+            }
         sim_disk_detach (uptr);
         if (r == SCPE_OK) {
             created = TRUE;
             copied = TRUE;
             strlcpy (tbuf, gbuf, sizeof(tbuf)-1);
             cptr = tbuf;
-            sim_disk_set_fmt (uptr, 0, dest_fmt, NULL);
+            sim_disk_set_fmt (uptr, 0, sparse_container ? "SIMH" : dest_fmt, NULL);
             sim_switches = saved_sim_switches;
             }
         else
@@ -3463,6 +4748,14 @@ if (sim_disk_check_attached_container (cptr, &auptr))
 switch (DK_GET_FMT (uptr)) {                            /* case on format */
     case DKUF_F_AUTO:                                   /* SIMH format */
         auto_format = TRUE;
+        if (NULL != (uptr->fileref = sim_sparse_disk_open (cptr, "rb"))) { /* Try SIMH Sparse */
+            sim_disk_set_fmt (uptr, 0, "SIMH", NULL);   /* set file format to SIMH */
+            sim_sparse_disk_close (uptr->fileref);      /* close sparse file*/
+            uptr->fileref = NULL;
+            sparse_container = TRUE;                    /* in a SIMH Sparse container */
+            open_function = sim_sparse_disk_open;
+            break;
+            }
         if (NULL != (uptr->fileref = sim_vhd_disk_open (cptr, "rb"))) { /* Try VHD */
             sim_disk_set_fmt (uptr, 0, "VHD", NULL);    /* set file format to VHD */
             sim_vhd_disk_close (uptr->fileref);         /* close vhd file*/
@@ -3486,6 +4779,10 @@ switch (DK_GET_FMT (uptr)) {                            /* case on format */
         open_function = sim_fopen;
         break;
     case DKUF_F_STD:                                    /* SIMH format */
+        if (sparse_container) {                         /* SIMH Sparse requested? */
+            open_function = sim_sparse_disk_open;
+            break;
+            }
         if (NULL != (uptr->fileref = sim_vhd_disk_open (cptr, "rb"))) { /* Try VHD first */
             sim_disk_set_fmt (uptr, 0, "VHD", NULL);    /* set file format to VHD */
             sim_vhd_disk_close (uptr->fileref);         /* close vhd file*/
@@ -3520,6 +4817,7 @@ uptr->filename = (char *) calloc (CBUFSIZE, sizeof (char));/* alloc name buf */
 uptr->disk_ctx = ctx = (struct disk_context *)calloc(1, sizeof(struct disk_context));
 if ((uptr->filename == NULL) || (uptr->disk_ctx == NULL))
     return _err_return (uptr, SCPE_MEM);
+ctx->sparse = sparse_container;                         /* record SIMH Sparse container */
 strlcpy (uptr->filename, cptr, CBUFSIZE);               /* save name */
 ctx->sector_size = (uint32)sector_size;                 /* save sector_size */
 ctx->capac_factor = ((dptr->dwidth / dptr->aincr) >= 32) ? 8 : ((dptr->dwidth / dptr->aincr) == 16) ? 2 : 1; /* save capacity units (quadword: 8, word: 2, byte: 1) */
@@ -3528,6 +4826,10 @@ ctx->media_id = (uptr->drvtyp != NULL) ?
                     uptr->drvtyp->MediaId : 0;          /* save initial device type media id */
 ctx->dptr = dptr;                                       /* save DEVICE pointer */
 ctx->dbit = dbit;                                       /* save debug bit */
+ctx->perf_read = sim_perf_counter (dptr, "READ", SIM_PERF_BYTES, "Bytes read from disk containers");
+ctx->perf_write = sim_perf_counter (dptr, "WRITE", SIM_PERF_BYTES, "Bytes written to disk containers");
+ctx->perf_rlat = sim_perf_counter (dptr, "READ LATENCY", SIM_PERF_LATENCY, "Disk read service time");
+ctx->perf_wlat = sim_perf_counter (dptr, "WRITE LATENCY", SIM_PERF_LATENCY, "Disk write service time");
 ctx->media_removed = 0;                                 /* default present */
 ctx->initial_drvtyp = uptr->drvtyp;                     /* save original drive type */
 ctx->initial_capac = uptr->capac;                       /* save original capacity */
@@ -3566,7 +4868,9 @@ else {                                                  /* normal */
                 (errno != ENOENT))                      /* or must not re-create? */
                 return sim_messagef (_err_return (uptr, SCPE_OPENERR), "%s: Cannot open '%s' - %s\n",
                                      sim_uname (uptr), cptr, strerror (errno));
-            if (create_function)
+            if (sparse_container)
+                uptr->fileref = sim_sparse_disk_create (cptr, ((t_offset)uptr->capac)*ctx->capac_factor*((dptr->flags & DEV_SECTORS) ? 512 : 1), uptr->drvtyp, compress_container);/* create new sparse file */
+            else if (create_function)
                 uptr->fileref = create_function (cptr, ((t_offset)uptr->capac)*ctx->capac_factor*((dptr->flags & DEV_SECTORS) ? 512 : 1), uptr->drvtyp);/* create new file */
             else
                 uptr->fileref = open_function (cptr, "wb+");/* open new file */
@@ -4041,6 +5345,13 @@ if (dtype && ((uptr->drvtyp == NULL) ? TRUE : ((uptr->drvtyp->flags & DRVFL_DETA
 sim_disk_set_async (uptr, completion_delay);
 #endif
 uptr->io_flush = _sim_disk_io_flush;
+if (map_container)                                      /* memory mapped access? */
+    _sim_disk_map (uptr, current_unit_size);
+#if defined (SIM_ASYNCH_IO)
+if (ring_container &&                                   /* io_uring transfers? */
+    !_sim_disk_ring_open (uptr))
+    sim_messagef (SCPE_OK, "%s: io_uring transfers unavailable\n", sim_uname (uptr));
+#endif
 
 if (uptr->flags & UNIT_BUFABLE) {                       /* buffer in memory? */
     t_seccnt sectsread;
@@ -4102,6 +5413,9 @@ switch (DK_GET_FMT (uptr)) {                            /* case on format */
     case DKUF_F_RAW:                                    /* Physical */
         close_function = sim_os_disk_close_raw;
         break;
+    case DKUF_F_SPARSE:                                 /* SIMH Sparse format */
+        close_function = sim_sparse_disk_close;
+        break;
     default:
         return SCPE_IERR;
         }
@@ -4128,6 +5442,9 @@ uptr->filebuf = NULL;
 free (uptr->filebuf2);
 uptr->filebuf2 = NULL;
 
+_sim_disk_cache_free (uptr);                            /* write back and release any sector cache */
+_sim_disk_ovl_close (uptr, FALSE);                      /* close any snapshot overlay */
+_sim_disk_unmap (uptr);                                 /* release any container mapping */
 update_disk_footer (uptr);                              /* Update meta data if highwater has changed */
 fileref = uptr->fileref;                                /* update local copy used after unit cleanup */
 
@@ -4137,6 +5454,10 @@ if (uptr->io_flush)
     uptr->io_flush (uptr);                              /* flush buffered data */
 
 sim_disk_clr_async (uptr);
+#if defined (SIM_ASYNCH_IO)
+_sim_disk_ring_close (uptr);
+_disk_aio_free (ctx);
+#endif
 
 uptr->flags &= ~(UNIT_ATT | UNIT_RO);
 uptr->dynflags &= ~(UNIT_NO_FIO | UNIT_DISK_CHK);
@@ -4208,7 +5529,9 @@ fprintf (st, "Disk container files can be one of several different types:\n\n");
     fprintf (st, "           Virtual Hard Disk (VHD) Image Format Specification\".  The\n");
     fprintf (st, "           VHD implementation includes support for 1) Fixed (Preallocated)\n");
     fprintf (st, "           disks, 2) Dynamically Expanding disks, and 3) Differencing disks.\n");
-    fprintf (st, "    RAW    platform specific access to physical disk or CDROM drives\n\n");
+    fprintf (st, "    RAW    platform specific access to physical disk or CDROM drives\n");
+    fprintf (st, "    SPARSE SIMH sparse container which only stores the clusters of the\n");
+    fprintf (st, "           disk which contain non zero data, optionally compressed.\n\n");
 //    }
 //else {
 //    fprintf (st, "   SIMH     A disk is an unstructured binary file of 64bit integers\n"
@@ -4233,6 +5556,12 @@ fprintf (st, "which describes the drive size and the simh device type in use whe
 fprintf (st, "was created.  This metadata is therefore available whenever that VHD is\n");
 fprintf (st, "attached to an emulated disk device in the future so the device type and\n");
 fprintf (st, "size can be automatically be configured.\n\n");
+fprintf (st, "SIMH Sparse containers (-F SPARSE) are never larger than the data actually\n");
+fprintf (st, "written.  Clusters which only contain zeros, or which the simulated operating\n");
+fprintf (st, "system has discarded (RX02 media formatting and MSCP ERASE), don't occupy\n");
+fprintf (st, "space in the container.  The cluster size is selected from the drive size\n");
+fprintf (st, "when the container is created.  Sparse containers are recognized when the\n");
+fprintf (st, "unit's format is AUTO; a unit set to the SIMH format needs -F SPARSE.\n\n");
 
 if (dptr->numunits > 1) {
     uint32 i, attachable_count = 0, out_count = 0, skip_count;
@@ -4294,6 +5623,22 @@ fprintf (st, "    -M          Merge a Differencing VHD into its parent VHD disk\
 fprintf (st, "    -O          Override consistency checks when attaching differencing disks\n");
 fprintf (st, "                which have unexpected parent disk GUID or timestamps\n");
 fprintf (st, "    -U          Fix inconsistencies which are overridden by the -O switch\n");
+fprintf (st, "    -S          Attach with a copy-on-write snapshot overlay.  The disk\n");
+fprintf (st, "                container is opened read only and all writes are kept in\n");
+fprintf (st, "                the named overlay file (created if it doesn't exist).  The\n");
+fprintf (st, "                overlay changes can later be discarded or merged into the\n");
+fprintf (st, "                container with SET unit DISCARD or SET unit MERGE.\n");
+fprintf (st, "    -P          Access a SIMH format container through a memory mapping\n");
+fprintf (st, "                rather than file I/O.  Only regular files on local file\n");
+fprintf (st, "                systems are mapped and only as far as they currently\n");
+fprintf (st, "                extend.  Anything else (and a container which is too large\n");
+fprintf (st, "                for the host's address space) uses file I/O.\n");
+fprintf (st, "    -A          Perform the asynchronous transfers of a SIMH format\n");
+fprintf (st, "                container with the host's io_uring interface (Linux), using\n");
+fprintf (st, "                O_DIRECT when the sector size allows.  Where io_uring isn't\n");
+fprintf (st, "                available the I/O worker pool is used.\n");
+fprintf (st, "    -Z          When creating a SIMH Sparse container, compress the data of\n");
+fprintf (st, "                each cluster.\n");
 if (strstr (sim_name, "-10") == NULL) {
     fprintf (st, "    -Y          Answer Yes to prompt to overwrite last track (on disk create)\n");
     fprintf (st, "    -N          Answer No to prompt to overwrite last track (on disk create)\n");
@@ -5052,6 +6397,25 @@ _set_errno_from_status (GetLastError ());
 return SCPE_IOERR;
 }
 
+static t_stat sim_os_disk_implemented_map (void)
+{
+return SCPE_NOFNC;
+}
+
+static uint8 *sim_os_disk_map (UNIT *uptr, t_offset size, t_bool writable)
+{
+return NULL;
+}
+
+static void sim_os_disk_unmap (uint8 *map, t_offset size)
+{
+}
+
+static t_stat sim_os_disk_sync_map (uint8 *map, t_offset size)
+{
+return SCPE_NOFNC;
+}
+
 #elif defined (__linux) || defined (__linux__) || defined (__APPLE__)|| defined (__sun) || defined (__sun__) || defined (__hpux) || defined (_AIX)
 
 #include <sys/types.h>
@@ -5064,6 +6428,13 @@ return SCPE_IOERR;
 #if defined(HAVE_LINUX_CDROM)
 #include <linux/cdrom.h>
 #endif
+#include <sys/mman.h>
+#if defined (__linux) || defined (__linux__)
+#include <sys/vfs.h>
+#elif defined (__APPLE__)
+#include <sys/param.h>
+#include <sys/mount.h>
+#endif
 
 static t_stat sim_os_disk_implemented_raw (void)
 {
@@ -5274,14 +6645,83 @@ if (is_cdrom) {
 return SCPE_OK;
 }
 
-#else
-/*============================================================================*/
-/*                        Non-implemented versions                            */
-/*============================================================================*/
-
-static t_stat sim_os_disk_implemented_raw (void)
+static t_stat sim_os_disk_implemented_map (void)
 {
-return SCPE_NOFNC;
+return SCPE_OK;
+}
+
+/* Only files whose pages can't vanish behind our back (a network file
+   server or another client truncating the file) are mapped */
+
+static t_bool sim_os_disk_local_file (int fd)
+{
+#if defined (__linux) || defined (__linux__)
+struct statfs fs;
+
+if (fstatfs (fd, &fs) != 0)
+    return FALSE;
+switch ((uint32)fs.f_type) {
+    case 0x6969:                                        /* NFS */
+    case 0x517B:                                        /* SMB */
+    case 0xFF534D42:                                    /* CIFS */
+    case 0xFE534D42:                                    /* SMB2 */
+    case 0x65735546:                                    /* FUSE */
+    case 0x01021997:                                    /* 9P */
+    case 0x73757245:                                    /* CODA */
+    case 0x5346414F:                                    /* AFS */
+    case 0x00C36400:                                    /* CEPH */
+        return FALSE;
+    default:
+        return TRUE;
+    }
+#elif defined (__APPLE__)
+struct statfs fs;
+
+return (fstatfs (fd, &fs) == 0) && ((fs.f_flags & MNT_LOCAL) != 0);
+#else
+return FALSE;                                           /* can't tell */
+#endif
+}
+
+static uint8 *sim_os_disk_map (UNIT *uptr, t_offset size, t_bool writable)
+{
+int fd = fileno (uptr->fileref);
+struct stat statb;
+void *map;
+
+if ((size == 0) ||
+    (size != (t_offset)((size_t)size)) ||               /* too large for the address space? */
+    (fstat (fd, &statb) != 0) ||
+    (!S_ISREG (statb.st_mode)) ||
+    ((t_offset)statb.st_size < size) ||                 /* never extend the file */
+    (!sim_os_disk_local_file (fd)))
+    return NULL;
+map = mmap (NULL, (size_t)size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+if (map == MAP_FAILED)
+    return NULL;
+return (uint8 *)map;
+}
+
+static void sim_os_disk_unmap (uint8 *map, t_offset size)
+{
+munmap ((void *)map, (size_t)size);
+}
+
+static t_stat sim_os_disk_sync_map (uint8 *map, t_offset size)
+{
+if (msync ((void *)map, (size_t)size, MS_SYNC) != 0)
+    return SCPE_IOERR;
+return SCPE_OK;
+}
+
+#else
+/*============================================================================*/
+/*                        Non-implemented versions                            */
+/*============================================================================*/
+
+static t_stat sim_os_disk_implemented_raw (void)
+{
+return SCPE_NOFNC;
 }
 
 static FILE *sim_os_disk_open_raw (const char *rawdevicename, const char *openmode)
@@ -5343,8 +6783,522 @@ static t_stat sim_os_disk_info_raw (FILE *f, uint32 *sector_size, uint32 *remova
 return SCPE_NOFNC;
 }
 
+static t_stat sim_os_disk_implemented_map (void)
+{
+return SCPE_NOFNC;
+}
+
+static uint8 *sim_os_disk_map (UNIT *uptr, t_offset size, t_bool writable)
+{
+return NULL;
+}
+
+static void sim_os_disk_unmap (uint8 *map, t_offset size)
+{
+}
+
+static t_stat sim_os_disk_sync_map (uint8 *map, t_offset size)
+{
+return SCPE_NOFNC;
+}
+
 #endif
 
+/* Linux io_uring asynchronous transfers
+
+   SIMH format containers attached with -A perform their asynchronous
+   sector transfers with the host's io_uring facility rather than with
+   the I/O worker pool.  One ring is shared by every such unit, and a
+   single completion thread reaps finished transfers and delivers them
+   to the unit's request queue (sim_aio_done), so they reach the
+   simulator through sim_asynch_queue just as worker pool completions
+   do.  As with the worker pool, each unit has at most one transfer in
+   flight and any others wait their turn in order.
+
+   While a unit uses the ring all of its container data transfers,
+   synchronous ones included, go through the ring's descriptor rather
+   than stdio, so stdio never holds stale buffered data.  When the
+   container's sector size allows it the descriptor is opened with
+   O_DIRECT and transfers are staged through page aligned buffers.
+ */
+
+#if defined (SIM_ASYNCH_IO)
+#if defined (HAVE_LINUX_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define DK_RING_ENTRIES 64                  /* submission queue entries (and unit limit) */
+#define DK_RING_ALIGN   4096                /* O_DIRECT buffer alignment */
+
+struct disk_ring_xfer {
+    struct disk_aio_req *req;
+    struct iovec        iov;
+    };
+
+static struct {
+    int                 fd;                 /* ring descriptor */
+    uint32              users;              /* units using the ring */
+    unsigned            *sq_tail;
+    unsigned            *sq_mask;
+    unsigned            *sq_array;
+    unsigned            *cq_head;
+    unsigned            *cq_tail;
+    unsigned            *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void                *sq_ptr;
+    void                *cq_ptr;
+    size_t              sq_size;
+    size_t              cq_size;
+    size_t              sqes_size;
+    pthread_t           reaper;             /* completion thread */
+    struct disk_ring_xfer xfer[DK_RING_ENTRIES];/* one transfer per unit in flight */
+    } dk_ring = { -1 };
+static pthread_mutex_t dk_ring_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int _dk_ring_enter (unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+return (int)syscall (__NR_io_uring_enter, dk_ring.fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+/* Queue one operation.  Called with dk_ring_lock held */
+
+static void _dk_ring_post (uint8 opcode, int fd, t_offset offset, struct iovec *iov, uint32 user_data)
+{
+unsigned tail = *dk_ring.sq_tail;
+unsigned idx = tail & *dk_ring.sq_mask;
+struct io_uring_sqe *sqe = &dk_ring.sqes[idx];
+
+memset (sqe, 0, sizeof (*sqe));
+sqe->opcode = opcode;
+sqe->fd = fd;
+sqe->off = (__u64)offset;
+sqe->addr = (__u64)(size_t)iov;
+sqe->len = iov ? 1 : 0;
+sqe->user_data = user_data;
+dk_ring.sq_array[idx] = idx;
+__atomic_store_n (dk_ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+while ((_dk_ring_enter (1, 0, 0) < 0) &&
+       ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY)))
+    ;
+}
+
+/* Start a unit's transfer.  Called with dk_ring_lock held */
+
+static void _dk_ring_issue (struct disk_aio_req *req)
+{
+struct disk_context *ctx = (struct disk_context *)req->uptr->disk_ctx;
+size_t bytes = ((size_t)req->sects) * ctx->sector_size;
+struct disk_ring_xfer *xfer;
+uint32 i;
+
+for (i = 0; dk_ring.xfer[i].req != NULL; i++)           /* find an idle slot */
+    ;                                                   /* (users <= DK_RING_ENTRIES) */
+xfer = &dk_ring.xfer[i];
+xfer->req = req;
+xfer->iov.iov_base = ctx->ring_direct ? req->bounce : req->buf;
+xfer->iov.iov_len = bytes;
+ctx->ring_busy = TRUE;
+_dk_ring_post ((req->dop == DOP_WSEC) ? IORING_OP_WRITEV : IORING_OP_READV,
+               ctx->ring_fd, ((t_offset)req->lba) * ctx->sector_size, &xfer->iov, i + 1);
+}
+
+/* A transfer has finished.  Called in the completion thread with
+   dk_ring_lock held */
+
+static void _dk_ring_complete (struct disk_ring_xfer *xfer, int res)
+{
+struct disk_aio_req *req = xfer->req;
+UNIT *uptr = req->uptr;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+size_t bytes = ((size_t)req->sects) * ctx->sector_size;
+struct disk_aio_req *next;
+
+xfer->req = NULL;
+if (req->dop == DOP_RSEC) {
+    if (res >= 0) {                                     /* beyond EOF reads as zeros */
+        if (ctx->ring_direct)
+            memcpy (req->buf, req->bounce, (size_t)res);
+        memset (req->buf + res, 0, bytes - (size_t)res);
+        if (req->rsects)
+            *req->rsects = req->sects;
+        req->io_status = SCPE_OK;
+        }
+    else {
+        if (req->rsects)
+            *req->rsects = 0;
+        req->io_status = SCPE_IOERR;
+        }
+    }
+else {
+    t_seccnt written = (res > 0) ? (t_seccnt)(((size_t)res + ctx->sector_size - 1) / ctx->sector_size) : 0;
+
+    if (req->rsects)
+        *req->rsects = written;
+    req->io_status = ((res >= 0) && ((size_t)res == bytes)) ? SCPE_OK : SCPE_IOERR;
+    if (written > 0) {
+        t_offset end_write = (((t_offset)req->lba) + written) * ctx->sector_size;
+
+        if (ctx->highwater < end_write)
+            ctx->highwater = end_write;
+        }
+    }
+sim_debug_unit (ctx->dbit, uptr, "_dk_ring_complete(unit=%d, dop=%d, lba=0x%X, sects=%d, res=%d)\n", (int)(uptr - ctx->dptr->units), req->dop, req->lba, req->sects, res);
+ctx->ring_busy = FALSE;
+if ((next = ctx->ring_head) != NULL) {                  /* start the unit's next transfer */
+    ctx->ring_head = next->ring_next;
+    if (ctx->ring_head == NULL)
+        ctx->ring_tail = NULL;
+    _dk_ring_issue (next);
+    }
+sim_aio_done (ctx->aioq, &req->hdr);
+}
+
+static void *
+_dk_ring_reaper (void *arg)
+{
+t_bool stop = FALSE;
+
+/* Boost Priority for this I/O thread vs the CPU instruction execution
+   thread which in general won't be readily yielding the processor when
+   this thread needs to run */
+sim_os_set_thread_priority (PRIORITY_ABOVE_NORMAL);
+
+while (!stop) {
+    unsigned head, tail;
+
+    if ((_dk_ring_enter (0, 1, IORING_ENTER_GETEVENTS) < 0) &&
+        (errno != EINTR))
+        break;
+    pthread_mutex_lock (&dk_ring_lock);
+    head = *dk_ring.cq_head;
+    while (head != (tail = __atomic_load_n (dk_ring.cq_tail, __ATOMIC_ACQUIRE))) {
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &dk_ring.cqes[head & *dk_ring.cq_mask];
+            uint32 slot = (uint32)cqe->user_data;
+            int res = cqe->res;
+
+            __atomic_store_n (dk_ring.cq_head, ++head, __ATOMIC_RELEASE);
+            if (slot == 0) {                            /* shutdown request */
+                stop = TRUE;
+                continue;
+                }
+            _dk_ring_complete (&dk_ring.xfer[slot - 1], res);
+            }
+        }
+    pthread_mutex_unlock (&dk_ring_lock);
+    }
+return NULL;
+}
+
+/* Create the shared ring and its completion thread.  Called with
+   dk_ring_lock held */
+
+static t_bool _dk_ring_create (void)
+{
+struct io_uring_params p;
+pthread_attr_t attr;
+t_bool single_mmap;
+
+memset (&p, 0, sizeof (p));
+dk_ring.fd = (int)syscall (__NR_io_uring_setup, DK_RING_ENTRIES, &p);
+if (dk_ring.fd < 0)
+    return FALSE;
+single_mmap = ((p.features & IORING_FEAT_SINGLE_MMAP) != 0);
+dk_ring.sq_size = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+dk_ring.cq_size = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+if (single_mmap)
+    dk_ring.sq_size = dk_ring.cq_size = (dk_ring.sq_size > dk_ring.cq_size) ? dk_ring.sq_size : dk_ring.cq_size;
+dk_ring.sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+dk_ring.sq_ptr = mmap (NULL, dk_ring.sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, dk_ring.fd, IORING_OFF_SQ_RING);
+dk_ring.cq_ptr = single_mmap ? dk_ring.sq_ptr :
+                 mmap (NULL, dk_ring.cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, dk_ring.fd, IORING_OFF_CQ_RING);
+dk_ring.sqes = (struct io_uring_sqe *)mmap (NULL, dk_ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, dk_ring.fd, IORING_OFF_SQES);
+if ((dk_ring.sq_ptr == MAP_FAILED) || (dk_ring.cq_ptr == MAP_FAILED) || ((void *)dk_ring.sqes == MAP_FAILED)) {
+    if (dk_ring.sq_ptr != MAP_FAILED)
+        munmap (dk_ring.sq_ptr, dk_ring.sq_size);
+    if ((!single_mmap) && (dk_ring.cq_ptr != MAP_FAILED))
+        munmap (dk_ring.cq_ptr, dk_ring.cq_size);
+    if ((void *)dk_ring.sqes != MAP_FAILED)
+        munmap (dk_ring.sqes, dk_ring.sqes_size);
+    close (dk_ring.fd);
+    dk_ring.fd = -1;
+    return FALSE;
+    }
+dk_ring.sq_tail = (unsigned *)((char *)dk_ring.sq_ptr + p.sq_off.tail);
+dk_ring.sq_mask = (unsigned *)((char *)dk_ring.sq_ptr + p.sq_off.ring_mask);
+dk_ring.sq_array = (unsigned *)((char *)dk_ring.sq_ptr + p.sq_off.array);
+dk_ring.cq_head = (unsigned *)((char *)dk_ring.cq_ptr + p.cq_off.head);
+dk_ring.cq_tail = (unsigned *)((char *)dk_ring.cq_ptr + p.cq_off.tail);
+dk_ring.cq_mask = (unsigned *)((char *)dk_ring.cq_ptr + p.cq_off.ring_mask);
+dk_ring.cqes = (struct io_uring_cqe *)((char *)dk_ring.cq_ptr + p.cq_off.cqes);
+memset (dk_ring.xfer, 0, sizeof (dk_ring.xfer));
+pthread_attr_init (&attr);
+pthread_attr_setscope (&attr, PTHREAD_SCOPE_SYSTEM);
+pthread_create (&dk_ring.reaper, &attr, _dk_ring_reaper, NULL);
+pthread_attr_destroy (&attr);
+return TRUE;
+}
+
+/* Stop the completion thread and release the ring */
+
+static void _dk_ring_destroy (void)
+{
+pthread_mutex_lock (&dk_ring_lock);
+_dk_ring_post (IORING_OP_NOP, -1, 0, NULL, 0);       /* wake the completion thread to exit */
+pthread_mutex_unlock (&dk_ring_lock);
+pthread_join (dk_ring.reaper, NULL);
+munmap (dk_ring.sqes, dk_ring.sqes_size);
+if (dk_ring.cq_ptr != dk_ring.sq_ptr)
+    munmap (dk_ring.cq_ptr, dk_ring.cq_size);
+munmap (dk_ring.sq_ptr, dk_ring.sq_size);
+close (dk_ring.fd);
+dk_ring.fd = -1;
+}
+
+/* Start using the ring for a unit's transfers.  Only SIMH format
+   containers whose data needs no byte swapping or packing qualify */
+
+static t_bool _sim_disk_ring_open (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+char path[64];
+int flags = (uptr->flags & UNIT_RO) ? O_RDONLY : O_RDWR;
+int fd;
+t_bool ok;
+
+if ((DK_GET_FMT (uptr) != DKUF_F_STD) ||
+    (!ctx->asynch_io) || (ctx->aioq == NULL) ||
+    (ctx->map != NULL) ||
+    ((!sim_end) && (ctx->xfer_encode_size != sizeof (char))) ||
+    (ctx->xfer_encode_size > DK_ENC_LONGLONG))
+    return FALSE;
+fflush (uptr->fileref);
+snprintf (path, sizeof (path), "/proc/self/fd/%d", fileno (uptr->fileref));
+fd = -1;
+if ((ctx->sector_size % 512) == 0) {                    /* try bypassing the host's cache */
+    fd = open (path, flags | O_DIRECT);
+    if (fd >= 0) {
+        void *probe = NULL;
+
+        if ((posix_memalign (&probe, DK_RING_ALIGN, DK_RING_ALIGN) != 0) ||
+            (pread (fd, probe, 512, 0) < 0)) {          /* file system refuses direct I/O */
+            close (fd);
+            fd = -1;
+            }
+        free (probe);
+        }
+    }
+ctx->ring_direct = (fd >= 0);
+if (fd < 0)
+    fd = open (path, flags);
+if (fd < 0)
+    return FALSE;
+pthread_mutex_lock (&dk_ring_lock);
+ok = (dk_ring.users < DK_RING_ENTRIES) &&
+     ((dk_ring.fd >= 0) || _dk_ring_create ());
+if (ok)
+    ++dk_ring.users;
+pthread_mutex_unlock (&dk_ring_lock);
+if (!ok) {
+    close (fd);
+    return FALSE;
+    }
+ctx->ring_fd = fd;
+ctx->ring_busy = FALSE;
+ctx->ring_last = FALSE;
+ctx->ring_head = ctx->ring_tail = NULL;
+ctx->ring_active = TRUE;
+sim_debug_unit (ctx->dbit, uptr, "_sim_disk_ring_open(unit=%d, direct=%d)\n", (int)(uptr - ctx->dptr->units), ctx->ring_direct);
+return TRUE;
+}
+
+static void _sim_disk_ring_close (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_bool last;
+
+if ((ctx == NULL) || !ctx->ring_active)
+    return;
+if (ctx->aioq)
+    sim_aio_wait (ctx->aioq);                           /* let transfers in flight finish */
+ctx->ring_active = FALSE;
+close (ctx->ring_fd);
+ctx->ring_fd = -1;
+fflush (uptr->fileref);                                 /* discard anything stdio has buffered */
+pthread_mutex_lock (&dk_ring_lock);
+last = (--dk_ring.users == 0);
+pthread_mutex_unlock (&dk_ring_lock);
+if (last)
+    _dk_ring_destroy ();
+}
+
+/* Get an aligned staging buffer for an O_DIRECT transfer */
+
+static uint8 *_dk_ring_bounce (struct disk_aio_req *req, size_t bytes)
+{
+void *p;
+
+if (req->bounce_size >= bytes)
+    return req->bounce;
+if (posix_memalign (&p, DK_RING_ALIGN, (bytes + DK_RING_ALIGN - 1) & ~((size_t)DK_RING_ALIGN - 1)) != 0)
+    return NULL;
+free (req->bounce);
+req->bounce = (uint8 *)p;
+req->bounce_size = (bytes + DK_RING_ALIGN - 1) & ~((size_t)DK_RING_ALIGN - 1);
+return req->bounce;
+}
+
+/* Synchronous transfers of a unit using the ring.  These have the same
+   results as the stdio based ones they replace */
+
+static t_stat _sim_disk_ring_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+size_t bytes = ((size_t)sects) * ctx->sector_size;
+off_t da = ((off_t)lba) * ctx->sector_size;
+uint8 *rbuf = buf;
+struct disk_aio_req tmp;
+size_t done = 0;
+t_stat r = SCPE_OK;
+
+if (sectsread)
+    *sectsread = 0;
+memset (&tmp, 0, sizeof (tmp));
+if (ctx->ring_direct && ((rbuf = _dk_ring_bounce (&tmp, bytes)) == NULL))
+    return SCPE_MEM;
+while (done < bytes) {
+    ssize_t i = pread (ctx->ring_fd, rbuf + done, bytes - done, da + done);
+
+    if ((i < 0) && (errno == EINTR))
+        continue;
+    if (i < 0)
+        r = SCPE_IOERR;
+    if (i <= 0)                                         /* error or at EOF */
+        break;
+    done += i;
+    }
+if (rbuf != buf)
+    memcpy (buf, rbuf, done);
+free (tmp.bounce);
+if (r != SCPE_OK) {
+    if (sectsread)
+        *sectsread = (t_seccnt)(done / ctx->sector_size);
+    return r;
+    }
+memset (buf + done, 0, bytes - done);                   /* beyond EOF reads as zeros */
+if (sectsread)
+    *sectsread = sects;
+return SCPE_OK;
+}
+
+static t_stat _sim_disk_ring_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+size_t bytes = ((size_t)sects) * ctx->sector_size;
+off_t da = ((off_t)lba) * ctx->sector_size;
+uint8 *wbuf = buf;
+struct disk_aio_req tmp;
+size_t done = 0;
+t_stat r = SCPE_OK;
+
+memset (&tmp, 0, sizeof (tmp));
+if (ctx->ring_direct) {
+    if ((wbuf = _dk_ring_bounce (&tmp, bytes)) == NULL)
+        return SCPE_MEM;
+    memcpy (wbuf, buf, bytes);
+    }
+while (done < bytes) {
+    ssize_t i = pwrite (ctx->ring_fd, wbuf + done, bytes - done, da + done);
+
+    if ((i < 0) && (errno == EINTR))
+        continue;
+    if (i <= 0) {
+        r = SCPE_IOERR;
+        break;
+        }
+    done += i;
+    }
+free (tmp.bounce);
+if (sectswritten)
+    *sectswritten = (t_seccnt)((done + ctx->sector_size - 1) / ctx->sector_size);
+return r;
+}
+
+/* Determine whether an asynchronous request can be handed to the ring,
+   readying its staging buffer if it can */
+
+static t_bool _disk_ring_eligible (struct disk_aio_req *req)
+{
+UNIT *uptr = req->uptr;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if ((!ctx->ring_active) ||
+    ((req->dop != DOP_RSEC) && (req->dop != DOP_WSEC)) ||
+    (ctx->cache != NULL) || (ctx->overlay != NULL) || (ctx->map != NULL) ||
+    (uptr->dynflags & UNIT_DISK_CHK))
+    return FALSE;
+return ((!ctx->ring_direct) ||
+        (_dk_ring_bounce (req, ((size_t)req->sects) * ctx->sector_size) != NULL));
+}
+
+static void _disk_ring_submit (struct disk_aio_req *req)
+{
+struct disk_context *ctx = (struct disk_context *)req->uptr->disk_ctx;
+
+if (ctx->ring_direct && (req->dop == DOP_WSEC))
+    memcpy (req->bounce, req->buf, ((size_t)req->sects) * ctx->sector_size);
+req->ring_next = NULL;
+pthread_mutex_lock (&dk_ring_lock);
+if (ctx->ring_busy) {                                   /* wait behind the unit's transfer in flight */
+    if (ctx->ring_tail)
+        ctx->ring_tail->ring_next = req;
+    else
+        ctx->ring_head = req;
+    ctx->ring_tail = req;
+    }
+else
+    _dk_ring_issue (req);
+pthread_mutex_unlock (&dk_ring_lock);
+}
+
+#else /* !defined (HAVE_LINUX_IO_URING) */
+
+static t_bool _sim_disk_ring_open (UNIT *uptr)
+{
+return FALSE;
+}
+
+static void _sim_disk_ring_close (UNIT *uptr)
+{
+}
+
+static t_stat _sim_disk_ring_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+return SCPE_NOFNC;
+}
+
+static t_stat _sim_disk_ring_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+return SCPE_NOFNC;
+}
+
+static t_bool _disk_ring_eligible (struct disk_aio_req *req)
+{
+return FALSE;
+}
+
+static void _disk_ring_submit (struct disk_aio_req *req)
+{
+}
+#endif /* HAVE_LINUX_IO_URING */
+#endif /* SIM_ASYNCH_IO */
+
 /* OS Independent Disk Virtual Disk (VHD) I/O support */
 
 #if (defined (VMS) && !(defined (__ALPHA) || defined (__ia64)))
@@ -7253,52 +9207,858 @@ Fatal_IO_Error:
     else {
         uint64 BlockOffset = VHD_Internal_SectorSize * ((uint64)(NtoHl(hVHD->BAT[BlockNumber]) + BitMapSectors)) + (Offset % DynamicBlockSize);
 
-        if (WriteFilePosition(hVHD->File,
-                              buf,
-                              BytesInWrite,
-                              &BytesThisWrite,
-                              BlockOffset))
-            r = SCPE_IOERR;
-        }
-IO_Done:
-    BytesToWrite -= BytesThisWrite;
-    buf = (uint8 *)(((char *)buf) + BytesThisWrite);
-    Offset += BytesThisWrite;
-    TotalBytesWritten += BytesThisWrite;
-    }
-if (BytesWritten)
-    *BytesWritten = TotalBytesWritten;
+        if (WriteFilePosition(hVHD->File,
+                              buf,
+                              BytesInWrite,
+                              &BytesThisWrite,
+                              BlockOffset))
+            r = SCPE_IOERR;
+        }
+IO_Done:
+    BytesToWrite -= BytesThisWrite;
+    buf = (uint8 *)(((char *)buf) + BytesThisWrite);
+    Offset += BytesThisWrite;
+    TotalBytesWritten += BytesThisWrite;
+    }
+if (BytesWritten)
+    *BytesWritten = TotalBytesWritten;
+return r;
+}
+
+static t_stat
+WriteVirtualDiskSectors(VHDHANDLE hVHD,
+                        uint8 *buf,
+                        t_seccnt sects,
+                        t_seccnt *sectswritten,
+                        uint32 SectorSize,
+                        t_lba lba)
+{
+uint32 BytesWritten;
+t_stat r = WriteVirtualDisk(hVHD,
+                            buf,
+                            sects * SectorSize,
+                            &BytesWritten,
+                            SectorSize * (uint64)lba);
+
+if (sectswritten)
+    *sectswritten = BytesWritten / SectorSize;
+return r;
+}
+
+static t_stat sim_vhd_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+VHDHANDLE hVHD = (VHDHANDLE)uptr->fileref;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+return WriteVirtualDiskSectors(hVHD, buf, sects, sectswritten, ctx->sector_size, lba);
+}
+#endif
+
+/* SIMH Sparse container support
+
+   A sparse container only holds the clusters of the simulated disk which
+   contain non zero data.  The container layout is:
+
+       offset 0      struct simh_sparse_header
+       offset 512    struct simh_disk_footer (drive type metadata)
+       offset 1024   level 1 table
+       ...           level 2 tables and cluster data, allocated as needed
+
+   The level 1 table contains L1Entries container offsets of level 2
+   tables.  Each level 2 table contains 2^L2Bits entries which describe one
+   cluster of 2^ClusterBits bytes each.  A zero table offset or entry means
+   that the corresponding data reads as zeros.  Otherwise the low 48 bits
+   of an entry are the container offset of the cluster data.  When
+   SPARSE_L2_COMPRESSED is set the cluster is stored in a compressed slot
+   which starts with the slot size and the compressed data length.  All
+   values in the container are stored big endian.
+
+   The level 1 table and all referenced level 2 tables are kept in memory
+   while the container is attached, so locating a cluster never needs an
+   additional container read.  Container space released by discards, zero
+   filled clusters and recompression is reused for later allocations.  When
+   a writable container is closed, the list of released extents is written
+   after the last allocated slot and recorded in the header (FreeOffset,
+   FreeCount).  It is read back when the container is next opened and the
+   header entry is cleared straight away, since the space it occupies is
+   about to be reused; a container which isn't closed cleanly just loses
+   track of the released space.  Copying the container (ATTACH -C) compacts
+   it.
+ */
+
+struct simh_sparse_header {
+    uint8       Signature[8];           /* must be 'simhspar' */
+    uint32      Version;                /* SPARSE_VERSION */
+    uint32      Flags;                  /* SPARSE_FL_* */
+    uint32      ClusterBits;            /* log2 of the cluster size in bytes */
+    uint32      L2Bits;                 /* log2 of the entries in a level 2 table */
+    uint32      L1Entries;              /* entries in the level 1 table */
+    uint32      Size[2];                /* capacity in bytes */
+    uint32      L1Offset[2];            /* container offset of the level 1 table */
+    uint32      FreeOffset[2];          /* container offset of the released extent list */
+    uint32      FreeCount;              /* entries in the released extent list */
+    uint8       Reserved[452];          /* Currently unused */
+    uint32      Checksum;               /* CRC32 of the prior 508 bytes */
+    };
+
+#define SPARSE_VERSION          1
+#define SPARSE_FL_COMPRESS      0x00000001      /* compress clusters as they are written */
+#define SPARSE_L2_COMPRESSED    (((t_uint64)1) << 63)
+#define SPARSE_L2_OFFSET        ((((t_uint64)1) << 48) - 1)
+#define SPARSE_SLOT_HDR         8               /* slot size + compressed length */
+#define SPARSE_FREE_ENTRY       16              /* released extent offset + size */
+#define SPARSE_ALIGN            512             /* container allocation granularity */
+#define SPARSE_L1_OFFSET        (sizeof (struct simh_sparse_header) + sizeof (struct simh_disk_footer))
+#define SPARSE_L2_BITS          12              /* 4096 entries per level 2 table */
+#define SPARSE_MIN_CLUSTER_BITS 12              /* 4KB */
+#define SPARSE_MAX_CLUSTER_BITS 20              /* 1MB */
+#define SPARSE_NO_CLUSTER       ((t_uint64)-1)
+#define SPARSE_ROUND(n)         ((((t_uint64)(n)) + SPARSE_ALIGN - 1) & ~((t_uint64)(SPARSE_ALIGN - 1)))
+
+struct sparse_extent {
+    t_uint64    offset;
+    uint32      size;
+    };
+
+struct sparse_disk {
+    FILE        *file;
+    t_bool      readonly;
+    uint32      flags;                  /* SPARSE_FL_* */
+    uint32      cluster_bits;
+    uint32      cluster_size;
+    uint32      l2_bits;
+    uint32      l1_entries;
+    t_uint64    size;                   /* capacity in bytes */
+    t_uint64    l1_offset;
+    t_uint64    *l1;                    /* level 1 table */
+    t_uint64    **l2;                   /* level 2 tables (NULL until referenced) */
+    t_uint64    end;                    /* container allocation point */
+    uint8       *cbuf;                  /* cluster buffer */
+    uint8       *zbuf;                  /* compressed slot buffer */
+    t_uint64    cbuf_cluster;           /* compressed cluster currently in cbuf */
+    struct sparse_extent *free;         /* released container space */
+    uint32      free_count;
+    uint32      free_max;
+    t_uint64    free_list_offset;       /* saved released extent list (0 while open) */
+    uint32      free_list_count;
+    struct simh_disk_footer footer;     /* container order */
+    };
+
+static t_uint64 _sparse_get64 (const uint8 *p)
+{
+return (((t_uint64)p[0]) << 56) | (((t_uint64)p[1]) << 48) | (((t_uint64)p[2]) << 40) | (((t_uint64)p[3]) << 32) |
+       (((t_uint64)p[4]) << 24) | (((t_uint64)p[5]) << 16) | (((t_uint64)p[6]) << 8)  | ((t_uint64)p[7]);
+}
+
+static void _sparse_put64 (uint8 *p, t_uint64 val)
+{
+int i;
+
+for (i = 7; i >= 0; i--, val >>= 8)
+    p[i] = (uint8)(val & 0xFF);
+}
+
+static t_stat _sparse_read (struct sparse_disk *sd, t_uint64 offset, void *buf, size_t len)
+{
+if ((sim_fseeko (sd->file, (t_offset)offset, SEEK_SET) != 0) ||
+    (sim_fread (buf, 1, len, sd->file) != len))
+    return SCPE_IOERR;
+return SCPE_OK;
+}
+
+static t_stat _sparse_write (struct sparse_disk *sd, t_uint64 offset, const void *buf, size_t len)
+{
+if ((sim_fseeko (sd->file, (t_offset)offset, SEEK_SET) != 0) ||
+    (sim_fwrite (buf, 1, len, sd->file) != len))
+    return SCPE_IOERR;
+return SCPE_OK;
+}
+
+static t_stat _sparse_write_header (struct sparse_disk *sd)
+{
+struct simh_sparse_header h;
+
+memset (&h, 0, sizeof (h));
+memcpy (h.Signature, "simhspar", sizeof (h.Signature));
+h.Version = NtoHl (SPARSE_VERSION);
+h.Flags = NtoHl (sd->flags);
+h.ClusterBits = NtoHl (sd->cluster_bits);
+h.L2Bits = NtoHl (sd->l2_bits);
+h.L1Entries = NtoHl (sd->l1_entries);
+h.Size[0] = NtoHl ((uint32)(sd->size >> 32));
+h.Size[1] = NtoHl ((uint32)(sd->size & 0xFFFFFFFF));
+h.L1Offset[0] = NtoHl ((uint32)(sd->l1_offset >> 32));
+h.L1Offset[1] = NtoHl ((uint32)(sd->l1_offset & 0xFFFFFFFF));
+h.FreeOffset[0] = NtoHl ((uint32)(sd->free_list_offset >> 32));
+h.FreeOffset[1] = NtoHl ((uint32)(sd->free_list_offset & 0xFFFFFFFF));
+h.FreeCount = NtoHl (sd->free_list_count);
+h.Checksum = NtoHl (eth_crc32 (0, &h, sizeof (h) - sizeof (h.Checksum)));
+return _sparse_write (sd, 0, &h, sizeof (h));
+}
+
+/* Container space management */
+
+static t_uint64 _sparse_alloc (struct sparse_disk *sd, uint32 size, uint32 *slot_size)
+{
+t_uint64 offset;
+uint32 i, best = sd->free_count;
+
+for (i = 0; i < sd->free_count; i++)                    /* best fit released extent */
+    if ((sd->free[i].size >= size) &&
+        ((best == sd->free_count) || (sd->free[i].size < sd->free[best].size)))
+        best = i;
+if (best < sd->free_count) {
+    offset = sd->free[best].offset;
+    if (slot_size)
+        *slot_size = sd->free[best].size;
+    sd->free[best] = sd->free[--sd->free_count];
+    return offset;
+    }
+offset = sd->end;
+sd->end += SPARSE_ROUND (size);
+if (slot_size)
+    *slot_size = (uint32)SPARSE_ROUND (size);
+return offset;
+}
+
+static void _sparse_release (struct sparse_disk *sd, t_uint64 offset, uint32 size)
+{
+if (sd->free_count == sd->free_max) {
+    uint32 new_max = sd->free_max ? 2 * sd->free_max : 64;
+    struct sparse_extent *new_free = (struct sparse_extent *)realloc (sd->free, new_max * sizeof (*new_free));
+
+    if (new_free == NULL)                               /* space is lost until compacted */
+        return;
+    sd->free = new_free;
+    sd->free_max = new_max;
+    }
+sd->free[sd->free_count].offset = offset;
+sd->free[sd->free_count].size = size;
+++sd->free_count;
+}
+
+/* Load the released extent list saved when the container was last closed.
+   The list occupies the container space from its offset onwards, which
+   becomes the allocation point. */
+
+static t_stat _sparse_load_free (struct sparse_disk *sd)
+{
+size_t bytes = ((size_t)sd->free_list_count) * SPARSE_FREE_ENTRY;
+uint8 *raw;
+uint32 i;
+
+if ((sd->free_list_count == 0) ||
+    (sd->free_list_offset < SPARSE_L1_OFFSET) ||
+    (sd->free_list_offset + bytes > sd->end))           /* nothing (sensible) saved? */
+    return SCPE_OK;
+raw = (uint8 *)malloc (bytes);
+if (raw == NULL)
+    return SCPE_MEM;
+if (_sparse_read (sd, sd->free_list_offset, raw, bytes) != SCPE_OK) {
+    free (raw);
+    return SCPE_IOERR;
+    }
+for (i = 0; i < sd->free_list_count; i++) {
+    t_uint64 offset = _sparse_get64 (raw + i * SPARSE_FREE_ENTRY);
+    t_uint64 size = _sparse_get64 (raw + i * SPARSE_FREE_ENTRY + sizeof (t_uint64));
+
+    if ((offset >= SPARSE_L1_OFFSET) && (size != 0) && (size <= 0xFFFFFFFF) &&
+        (offset + size <= sd->free_list_offset))
+        _sparse_release (sd, offset, (uint32)size);
+    }
+free (raw);
+sd->end = sd->free_list_offset;
+return SCPE_OK;
+}
+
+/* Save the released extent list after the last allocated slot */
+
+static t_stat _sparse_save_free (struct sparse_disk *sd)
+{
+size_t bytes = ((size_t)sd->free_count) * SPARSE_FREE_ENTRY;
+uint8 *raw;
+uint32 i;
+t_stat r;
+
+sd->free_list_offset = 0;
+sd->free_list_count = 0;
+if (sd->free_count == 0)
+    return SCPE_OK;
+raw = (uint8 *)malloc (bytes);
+if (raw == NULL)
+    return SCPE_MEM;
+for (i = 0; i < sd->free_count; i++) {
+    _sparse_put64 (raw + i * SPARSE_FREE_ENTRY, sd->free[i].offset);
+    _sparse_put64 (raw + i * SPARSE_FREE_ENTRY + sizeof (t_uint64), sd->free[i].size);
+    }
+r = _sparse_write (sd, sd->end, raw, bytes);
+free (raw);
+if (r != SCPE_OK)
+    return r;
+sd->free_list_offset = sd->end;
+sd->free_list_count = sd->free_count;
+return _sparse_write_header (sd);
+}
+
+/* Size of the container space used by the cluster an entry describes */
+
+static uint32 _sparse_slot_size (struct sparse_disk *sd, t_uint64 entry)
+{
+uint8 hdr[SPARSE_SLOT_HDR];
+
+if ((entry & SPARSE_L2_COMPRESSED) == 0)
+    return sd->cluster_size;
+if (_sparse_read (sd, entry & SPARSE_L2_OFFSET, hdr, sizeof (hdr)) != SCPE_OK)
+    return 0;
+return (uint32)(_sparse_get64 (hdr) >> 32);
+}
+
+/* Level 2 table access */
+
+static t_uint64 *_sparse_l2 (struct sparse_disk *sd, uint32 l1i, t_bool create)
+{
+size_t bytes = ((size_t)1 << sd->l2_bits) * sizeof (t_uint64);
+uint8 *raw;
+t_uint64 *table;
+size_t i;
+
+if (l1i >= sd->l1_entries)
+    return NULL;
+if (sd->l2[l1i] != NULL)
+    return sd->l2[l1i];
+if ((sd->l1[l1i] == 0) && !create)
+    return NULL;
+table = (t_uint64 *)calloc (1, bytes);
+raw = (uint8 *)calloc (1, bytes);
+if ((table == NULL) || (raw == NULL)) {
+    free (table);
+    free (raw);
+    return NULL;
+    }
+if (sd->l1[l1i] == 0) {                                 /* allocate a new table */
+    uint8 ent[sizeof (t_uint64)];
+    t_uint64 offset = sd->end;
+
+    sd->end += SPARSE_ROUND (bytes);
+    _sparse_put64 (ent, offset);
+    if ((_sparse_write (sd, offset, raw, bytes) != SCPE_OK) ||
+        (_sparse_write (sd, sd->l1_offset + l1i * sizeof (t_uint64), ent, sizeof (ent)) != SCPE_OK)) {
+        free (table);
+        free (raw);
+        return NULL;
+        }
+    sd->l1[l1i] = offset;
+    }
+else {
+    if (_sparse_read (sd, sd->l1[l1i], raw, bytes) != SCPE_OK) {
+        free (table);
+        free (raw);
+        return NULL;
+        }
+    for (i = 0; i < ((size_t)1 << sd->l2_bits); i++)
+        table[i] = _sparse_get64 (raw + i * sizeof (t_uint64));
+    }
+free (raw);
+sd->l2[l1i] = table;
+return table;
+}
+
+static t_uint64 _sparse_entry (struct sparse_disk *sd, t_uint64 cluster)
+{
+t_uint64 *table = _sparse_l2 (sd, (uint32)(cluster >> sd->l2_bits), FALSE);
+
+if (table == NULL)
+    return 0;
+return table[cluster & ((1 << sd->l2_bits) - 1)];
+}
+
+static t_stat _sparse_set_entry (struct sparse_disk *sd, t_uint64 cluster, t_uint64 entry)
+{
+uint32 l1i = (uint32)(cluster >> sd->l2_bits);
+uint32 l2i = (uint32)(cluster & ((1 << sd->l2_bits) - 1));
+t_uint64 *table = _sparse_l2 (sd, l1i, (entry != 0));
+uint8 ent[sizeof (t_uint64)];
+
+if (table == NULL)
+    return (entry == 0) ? SCPE_OK : SCPE_IOERR;
+table[l2i] = entry;
+_sparse_put64 (ent, entry);
+return _sparse_write (sd, sd->l1[l1i] + l2i * sizeof (t_uint64), ent, sizeof (ent));
+}
+
+/* Extend the capacity (and the level 1 table when needed) */
+
+static t_stat _sparse_grow (struct sparse_disk *sd, t_uint64 size)
+{
+t_uint64 clusters = (size + sd->cluster_size - 1) >> sd->cluster_bits;
+t_uint64 l1_needed = (clusters + ((t_uint64)1 << sd->l2_bits) - 1) >> sd->l2_bits;
+
+if (size <= sd->size)
+    return SCPE_OK;
+if (l1_needed > sd->l1_entries) {
+    uint32 new_entries = sd->l1_entries;
+    t_uint64 *new_l1;
+    t_uint64 **new_l2;
+    uint8 *raw;
+    t_uint64 offset;
+    uint32 i;
+
+    while (new_entries < l1_needed)
+        new_entries *= 2;
+    new_l1 = (t_uint64 *)calloc (new_entries, sizeof (*new_l1));
+    new_l2 = (t_uint64 **)calloc (new_entries, sizeof (*new_l2));
+    raw = (uint8 *)calloc (new_entries, sizeof (t_uint64));
+    if ((new_l1 == NULL) || (new_l2 == NULL) || (raw == NULL)) {
+        free (new_l1);
+        free (new_l2);
+        free (raw);
+        return SCPE_MEM;
+        }
+    for (i = 0; i < sd->l1_entries; i++) {
+        new_l1[i] = sd->l1[i];
+        new_l2[i] = sd->l2[i];
+        _sparse_put64 (raw + i * sizeof (t_uint64), new_l1[i]);
+        }
+    offset = sd->end;                                   /* relocated table */
+    sd->end += SPARSE_ROUND (new_entries * sizeof (t_uint64));
+    if (_sparse_write (sd, offset, raw, new_entries * sizeof (t_uint64)) != SCPE_OK) {
+        free (new_l1);
+        free (new_l2);
+        free (raw);
+        return SCPE_IOERR;
+        }
+    free (raw);
+    _sparse_release (sd, sd->l1_offset, (uint32)SPARSE_ROUND (sd->l1_entries * sizeof (t_uint64)));
+    free (sd->l1);
+    free (sd->l2);
+    sd->l1 = new_l1;
+    sd->l2 = new_l2;
+    sd->l1_entries = new_entries;
+    sd->l1_offset = offset;
+    }
+sd->size = size;
+return _sparse_write_header (sd);
+}
+
+/* Load a cluster's data into cbuf */
+
+static t_stat _sparse_load (struct sparse_disk *sd, t_uint64 cluster, t_uint64 entry)
+{
+if (sd->cbuf_cluster == cluster)
+    return SCPE_OK;
+sd->cbuf_cluster = SPARSE_NO_CLUSTER;
+if (entry == 0)
+    memset (sd->cbuf, 0, sd->cluster_size);
+else {
+    if (entry & SPARSE_L2_COMPRESSED) {
+        uint32 clen;
+
+        if (_sparse_read (sd, entry & SPARSE_L2_OFFSET, sd->zbuf, SPARSE_SLOT_HDR) != SCPE_OK)
+            return SCPE_IOERR;
+        clen = (uint32)(_sparse_get64 (sd->zbuf) & 0xFFFFFFFF);
+        if ((clen >= sd->cluster_size) ||
+            (_sparse_read (sd, (entry & SPARSE_L2_OFFSET) + SPARSE_SLOT_HDR, sd->zbuf, clen) != SCPE_OK) ||
+            (!sim_lz_decompress (sd->zbuf, clen, sd->cbuf, sd->cluster_size)))
+            return SCPE_IOERR;
+        }
+    else {
+        if (_sparse_read (sd, entry, sd->cbuf, sd->cluster_size) != SCPE_OK)
+            return SCPE_IOERR;
+        }
+    }
+sd->cbuf_cluster = cluster;
+return SCPE_OK;
+}
+
+static t_bool _sparse_is_zero (const uint8 *buf, size_t len)
+{
+size_t i;
+
+for (i = 0; i < len; i++)
+    if (buf[i] != 0)
+        return FALSE;
+return TRUE;
+}
+
+/* Store the cluster data in cbuf */
+
+static t_stat _sparse_store (struct sparse_disk *sd, t_uint64 cluster, t_uint64 entry)
+{
+uint32 old_slot = (entry == 0) ? 0 : _sparse_slot_size (sd, entry);
+t_uint64 offset;
+size_t clen = 0;
+uint32 slot;
+t_stat r;
+
+sd->cbuf_cluster = SPARSE_NO_CLUSTER;
+if (_sparse_is_zero (sd->cbuf, sd->cluster_size)) {     /* discard zero clusters */
+    if (entry == 0)
+        return SCPE_OK;
+    r = _sparse_set_entry (sd, cluster, 0);
+    if (r == SCPE_OK)
+        _sparse_release (sd, entry & SPARSE_L2_OFFSET, old_slot);
+    return r;
+    }
+if (sd->flags & SPARSE_FL_COMPRESS)
+    clen = sim_lz_compress (sd->cbuf, sd->cluster_size, sd->zbuf + SPARSE_SLOT_HDR, sd->cluster_size - SPARSE_SLOT_HDR - SPARSE_ALIGN);
+if (clen == 0) {                                        /* store uncompressed */
+    if ((entry != 0) && ((entry & SPARSE_L2_COMPRESSED) == 0))
+        return _sparse_write (sd, entry, sd->cbuf, sd->cluster_size);
+    offset = _sparse_alloc (sd, sd->cluster_size, &slot);
+    if (slot != sd->cluster_size)                       /* keep any unused part of a released slot */
+        _sparse_release (sd, offset + sd->cluster_size, slot - sd->cluster_size);
+    r = _sparse_write (sd, offset, sd->cbuf, sd->cluster_size);
+    if (r == SCPE_OK)
+        r = _sparse_set_entry (sd, cluster, offset);
+    }
+else {                                                  /* store compressed */
+    uint32 need = (uint32)SPARSE_ROUND (SPARSE_SLOT_HDR + clen);
+
+    if ((entry & SPARSE_L2_COMPRESSED) && (old_slot >= need)) {
+        offset = entry & SPARSE_L2_OFFSET;              /* rewrite in place */
+        slot = old_slot;
+        old_slot = 0;
+        }
+    else
+        offset = _sparse_alloc (sd, need, &slot);
+    _sparse_put64 (sd->zbuf, (((t_uint64)slot) << 32) | (t_uint64)clen);
+    r = _sparse_write (sd, offset, sd->zbuf, SPARSE_SLOT_HDR + clen);
+    if ((r == SCPE_OK) && (offset != (entry & SPARSE_L2_OFFSET)))
+        r = _sparse_set_entry (sd, cluster, offset | SPARSE_L2_COMPRESSED);
+    if (r == SCPE_OK)
+        sd->cbuf_cluster = cluster;                     /* cbuf still holds the data */
+    }
+if ((r == SCPE_OK) && (old_slot != 0))
+    _sparse_release (sd, entry & SPARSE_L2_OFFSET, old_slot);
+return r;
+}
+
+/* Byte range data transfers */
+
+static t_stat _sparse_rdbytes (struct sparse_disk *sd, t_uint64 addr, uint8 *buf, size_t len)
+{
+while (len > 0) {
+    t_uint64 cluster = addr >> sd->cluster_bits;
+    uint32 coffset = (uint32)(addr & (sd->cluster_size - 1));
+    size_t n = sd->cluster_size - coffset;
+    t_uint64 entry = (addr >= sd->size) ? 0 : _sparse_entry (sd, cluster);
+
+    if (n > len)
+        n = len;
+    if (entry == 0)
+        memset (buf, 0, n);
+    else {
+        if (entry & SPARSE_L2_COMPRESSED) {
+            if (_sparse_load (sd, cluster, entry) != SCPE_OK)
+                return SCPE_IOERR;
+            memcpy (buf, sd->cbuf + coffset, n);
+            }
+        else {
+            if (_sparse_read (sd, entry + coffset, buf, n) != SCPE_OK)
+                return SCPE_IOERR;
+            }
+        }
+    addr += n;
+    buf += n;
+    len -= n;
+    }
+return SCPE_OK;
+}
+
+static t_stat _sparse_wrbytes (struct sparse_disk *sd, t_uint64 addr, const uint8 *buf, size_t len)
+{
+t_stat r;
+
+if (sd->readonly)
+    return SCPE_RO;
+r = _sparse_grow (sd, addr + len);
+while ((r == SCPE_OK) && (len > 0)) {
+    t_uint64 cluster = addr >> sd->cluster_bits;
+    uint32 coffset = (uint32)(addr & (sd->cluster_size - 1));
+    size_t n = sd->cluster_size - coffset;
+    t_uint64 entry = _sparse_entry (sd, cluster);
+
+    if (n > len)
+        n = len;
+    if ((entry != 0) && ((entry & SPARSE_L2_COMPRESSED) == 0) &&
+        ((n != sd->cluster_size) || !_sparse_is_zero (buf, n)))
+        r = _sparse_write (sd, entry + coffset, buf, n);/* update in place */
+    else {
+        if ((entry != 0) || !_sparse_is_zero (buf, n)) {
+            if (n == sd->cluster_size)                  /* whole cluster replaced */
+                sd->cbuf_cluster = SPARSE_NO_CLUSTER;
+            else
+                r = _sparse_load (sd, cluster, entry);
+            if (r == SCPE_OK) {
+                memcpy (sd->cbuf + coffset, buf, n);
+                r = _sparse_store (sd, cluster, entry);
+                }
+            }
+        }
+    addr += n;
+    buf += n;
+    len -= n;
+    }
+return r;
+}
+
+/* Sparse container API */
+
+static FILE *sim_sparse_disk_open (const char *filename, const char *mode)
+{
+struct sparse_disk *sd = (struct sparse_disk *)calloc (1, sizeof (*sd));
+struct simh_sparse_header h;
+uint8 *raw = NULL;
+uint32 i;
+
+if (sd == NULL)
+    return NULL;
+sd->file = sim_fopen (filename, mode);
+if (sd->file == NULL) {
+    free (sd);
+    return NULL;
+    }
+sd->readonly = (strchr (mode, '+') == NULL) && (strchr (mode, 'w') == NULL);
+if ((_sparse_read (sd, 0, &h, sizeof (h)) != SCPE_OK)                                 ||
+    (memcmp (h.Signature, "simhspar", sizeof (h.Signature)) != 0)                     ||
+    (h.Checksum != NtoHl (eth_crc32 (0, &h, sizeof (h) - sizeof (h.Checksum))))       ||
+    (NtoHl (h.Version) != SPARSE_VERSION)                                             ||
+    (NtoHl (h.ClusterBits) < SPARSE_MIN_CLUSTER_BITS)                                 ||
+    (NtoHl (h.ClusterBits) > SPARSE_MAX_CLUSTER_BITS)                                 ||
+    (NtoHl (h.L2Bits) < 6) || (NtoHl (h.L2Bits) > 16)                                 ||
+    (NtoHl (h.L1Entries) == 0) || (NtoHl (h.L1Entries) > (1u << 24))                  ||
+    (_sparse_read (sd, sizeof (h), &sd->footer, sizeof (sd->footer)) != SCPE_OK)) {
+    fclose (sd->file);
+    free (sd);
+    errno = EINVAL;
+    return NULL;
+    }
+sd->flags = NtoHl (h.Flags);
+sd->cluster_bits = NtoHl (h.ClusterBits);
+sd->cluster_size = 1 << sd->cluster_bits;
+sd->l2_bits = NtoHl (h.L2Bits);
+sd->l1_entries = NtoHl (h.L1Entries);
+sd->size = (((t_uint64)NtoHl (h.Size[0])) << 32) | ((t_uint64)NtoHl (h.Size[1]));
+sd->l1_offset = (((t_uint64)NtoHl (h.L1Offset[0])) << 32) | ((t_uint64)NtoHl (h.L1Offset[1]));
+sd->free_list_offset = (((t_uint64)NtoHl (h.FreeOffset[0])) << 32) | ((t_uint64)NtoHl (h.FreeOffset[1]));
+sd->free_list_count = NtoHl (h.FreeCount);
+sd->end = SPARSE_ROUND (sim_fsize_ex (sd->file));
+sd->cbuf_cluster = SPARSE_NO_CLUSTER;
+sd->l1 = (t_uint64 *)calloc (sd->l1_entries, sizeof (*sd->l1));
+sd->l2 = (t_uint64 **)calloc (sd->l1_entries, sizeof (*sd->l2));
+sd->cbuf = (uint8 *)malloc (sd->cluster_size);
+sd->zbuf = (uint8 *)malloc (sd->cluster_size);
+raw = (uint8 *)malloc (sd->l1_entries * sizeof (t_uint64));
+if ((sd->l1 == NULL) || (sd->l2 == NULL) || (sd->cbuf == NULL) || (sd->zbuf == NULL) || (raw == NULL) ||
+    (_sparse_read (sd, sd->l1_offset, raw, sd->l1_entries * sizeof (t_uint64)) != SCPE_OK)) {
+    free (raw);
+    sim_sparse_disk_close ((FILE *)sd);
+    errno = EINVAL;
+    return NULL;
+    }
+for (i = 0; i < sd->l1_entries; i++)
+    sd->l1[i] = _sparse_get64 (raw + i * sizeof (t_uint64));
+free (raw);
+if (!sd->readonly) {                                    /* reuse the space released earlier */
+    if (_sparse_load_free (sd) == SCPE_MEM) {
+        sim_sparse_disk_close ((FILE *)sd);
+        errno = ENOMEM;
+        return NULL;
+        }
+    if (sd->free_list_count != 0) {                     /* the saved list is about to be overwritten */
+        sd->free_list_offset = 0;
+        sd->free_list_count = 0;
+        (void)_sparse_write_header (sd);
+        }
+    }
+return (FILE *)sd;
+}
+
+static FILE *sim_sparse_disk_create (const char *filename, t_offset desiredsize, DRVTYP *drvtyp, t_bool compress)
+{
+struct sparse_disk sd;
+t_uint64 clusters;
+uint8 *raw;
+t_stat r;
+
+memset (&sd, 0, sizeof (sd));
+sd.file = sim_fopen (filename, "wb+");
+if (sd.file == NULL)
+    return NULL;
+/* Larger drives get larger clusters to keep the tables compact */
+sd.cluster_bits = (desiredsize <= ((t_offset)64 << 20)) ? SPARSE_MIN_CLUSTER_BITS :
+                  (desiredsize <= ((t_offset)1 << 30)) ? 14 : 16;
+sd.cluster_size = 1 << sd.cluster_bits;
+sd.l2_bits = SPARSE_L2_BITS;
+sd.flags = compress ? SPARSE_FL_COMPRESS : 0;
+sd.size = (t_uint64)desiredsize;
+clusters = (sd.size + sd.cluster_size - 1) >> sd.cluster_bits;
+sd.l1_entries = (uint32)((clusters + ((t_uint64)1 << sd.l2_bits) - 1) >> sd.l2_bits);
+if (sd.l1_entries == 0)
+    sd.l1_entries = 1;
+sd.l1_offset = SPARSE_L1_OFFSET;
+raw = (uint8 *)calloc (1, (size_t)SPARSE_ROUND (sd.l1_entries * sizeof (t_uint64)) + sizeof (struct simh_disk_footer));
+if (raw == NULL) {
+    fclose (sd.file);
+    (void)remove (filename);
+    return NULL;
+    }
+r = _sparse_write_header (&sd);                         /* header */
+if (r == SCPE_OK)                                       /* empty metadata and level 1 table */
+    r = _sparse_write (&sd, sizeof (struct simh_sparse_header), raw, (size_t)SPARSE_ROUND (sd.l1_entries * sizeof (t_uint64)) + sizeof (struct simh_disk_footer));
+free (raw);
+fclose (sd.file);
+if (r != SCPE_OK) {
+    (void)remove (filename);
+    return NULL;
+    }
+return sim_sparse_disk_open (filename, "rb+");
+}
+
+static int sim_sparse_disk_close (FILE *f)
+{
+struct sparse_disk *sd = (struct sparse_disk *)f;
+int stat;
+uint32 i;
+
+if (sd == NULL)
+    return -1;
+stat = 0;
+if (!sd->readonly && (sd->l1 != NULL) &&                /* fully opened for writing? */
+    (_sparse_save_free (sd) != SCPE_OK))
+    stat = EOF;
+if (fclose (sd->file) == EOF)
+    stat = EOF;
+if (sd->l2 != NULL)
+    for (i = 0; i < sd->l1_entries; i++)
+        free (sd->l2[i]);
+free (sd->l2);
+free (sd->l1);
+free (sd->cbuf);
+free (sd->zbuf);
+free (sd->free);
+free (sd);
+return stat;
+}
+
+static void sim_sparse_disk_flush (FILE *f)
+{
+struct sparse_disk *sd = (struct sparse_disk *)f;
+
+fflush (sd->file);
+}
+
+static t_offset sim_sparse_disk_size (FILE *f)
+{
+struct sparse_disk *sd = (struct sparse_disk *)f;
+
+return (t_offset)sd->size;
+}
+
+static uint32 sim_sparse_disk_cluster_size (FILE *f)
+{
+struct sparse_disk *sd = (struct sparse_disk *)f;
+
+return sd->cluster_size;
+}
+
+static t_bool sim_sparse_disk_compressed (FILE *f)
+{
+struct sparse_disk *sd = (struct sparse_disk *)f;
+
+return ((sd->flags & SPARSE_FL_COMPRESS) != 0);
+}
+
+static void sim_sparse_disk_get_footer (FILE *f, struct simh_disk_footer *footer)
+{
+struct sparse_disk *sd = (struct sparse_disk *)f;
+
+*footer = sd->footer;
+}
+
+static t_stat sim_sparse_disk_set_footer (FILE *f, const struct simh_disk_footer *footer, t_offset size)
+{
+struct sparse_disk *sd = (struct sparse_disk *)f;
+t_stat r;
+
+if (sd->readonly)
+    return SCPE_RO;
+sd->footer = *footer;
+r = _sparse_write (sd, sizeof (struct simh_sparse_header), &sd->footer, sizeof (sd->footer));
+if (r == SCPE_OK)
+    r = _sparse_grow (sd, (t_uint64)size);
 return r;
 }
 
-static t_stat
-WriteVirtualDiskSectors(VHDHANDLE hVHD,
-                        uint8 *buf,
-                        t_seccnt sects,
-                        t_seccnt *sectswritten,
-                        uint32 SectorSize,
-                        t_lba lba)
+static t_stat sim_sparse_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
 {
-uint32 BytesWritten;
-t_stat r = WriteVirtualDisk(hVHD,
-                            buf,
-                            sects * SectorSize,
-                            &BytesWritten,
-                            SectorSize * (uint64)lba);
+struct sparse_disk *sd = (struct sparse_disk *)uptr->fileref;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_stat r;
+
+r = _sparse_rdbytes (sd, ((t_uint64)lba) * ctx->sector_size, buf, ((size_t)sects) * ctx->sector_size);
+if (sectsread)
+    *sectsread = (r == SCPE_OK) ? sects : 0;
+return r;
+}
+
+static t_stat sim_sparse_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+struct sparse_disk *sd = (struct sparse_disk *)uptr->fileref;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_stat r;
 
+r = _sparse_wrbytes (sd, ((t_uint64)lba) * ctx->sector_size, buf, ((size_t)sects) * ctx->sector_size);
 if (sectswritten)
-    *sectswritten = BytesWritten / SectorSize;
+    *sectswritten = (r == SCPE_OK) ? sects : 0;
 return r;
 }
 
-static t_stat sim_vhd_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+/* Discard a range of sectors: whole clusters release their container
+   space, partially covered clusters have the range zeroed */
+
+static t_stat sim_sparse_disk_trim (UNIT *uptr, t_lba lba, t_seccnt sects)
 {
-VHDHANDLE hVHD = (VHDHANDLE)uptr->fileref;
+struct sparse_disk *sd = (struct sparse_disk *)uptr->fileref;
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_uint64 addr = ((t_uint64)lba) * ctx->sector_size;
+t_uint64 end = addr + ((t_uint64)sects) * ctx->sector_size;
+t_stat r = SCPE_OK;
 
-return WriteVirtualDiskSectors(hVHD, buf, sects, sectswritten, ctx->sector_size, lba);
+if (sd->readonly)
+    return SCPE_RO;
+if (end > sd->size)
+    end = sd->size;
+while ((r == SCPE_OK) && (addr < end)) {
+    t_uint64 cluster = addr >> sd->cluster_bits;
+    uint32 coffset = (uint32)(addr & (sd->cluster_size - 1));
+    t_uint64 n = sd->cluster_size - coffset;
+    t_uint64 entry = _sparse_entry (sd, cluster);
+
+    if (n > end - addr)
+        n = end - addr;
+    if (entry != 0) {
+        if (n == sd->cluster_size) {                    /* whole cluster */
+            uint32 slot = _sparse_slot_size (sd, entry);
+
+            if (sd->cbuf_cluster == cluster)
+                sd->cbuf_cluster = SPARSE_NO_CLUSTER;
+            r = _sparse_set_entry (sd, cluster, 0);
+            if (r == SCPE_OK)
+                _sparse_release (sd, entry & SPARSE_L2_OFFSET, slot);
+            }
+        else {
+            r = _sparse_load (sd, cluster, entry);
+            if (r == SCPE_OK) {
+                memset (sd->cbuf + coffset, 0, (size_t)n);
+                r = _sparse_store (sd, cluster, entry);
+                }
+            }
+        }
+    addr += n;
+    }
+return r;
 }
-#endif
 
 /* Used when sorting a drive type list: */
 /* - Disks come first ordered by drive size */
@@ -7407,6 +10167,28 @@ for (i = 0; NULL != (dptr = sim_devices[i]); i++) {
             &sim_disk_set_autozap,  NULL, NULL, "Disable disk metadata removal on detach"  },
         { MTAB_XTD|MTAB_VUN,        0,  "AUTOZAP", NULL,
             NULL, &sim_disk_show_autozap, NULL, "Display disk autozap on detach setting" }};
+    static MTAB snaps[] = {
+        { MTAB_XTD|MTAB_VUN|MTAB_VALO, 0, NULL, "SNAPSHOT{=overlay-file}",
+            &sim_disk_set_snapshot,  NULL, NULL, "Start keeping disk changes in a snapshot overlay" },
+        { MTAB_XTD|MTAB_VUN,        1,  NULL, "NOSNAPSHOT",
+            &sim_disk_set_snapshot,  NULL, NULL, "Stop using the snapshot overlay" },
+        { MTAB_XTD|MTAB_VUN,        2,  NULL, "DISCARD",
+            &sim_disk_set_snapshot,  NULL, NULL, "Discard the changes held in the snapshot overlay" },
+        { MTAB_XTD|MTAB_VUN,        3,  NULL, "MERGE",
+            &sim_disk_set_snapshot,  NULL, NULL, "Merge the snapshot overlay changes into the disk" },
+        { MTAB_XTD|MTAB_VUN|MTAB_NMO, 0, "SNAPSHOT", NULL,
+            NULL, &sim_disk_show_snapshot, NULL, "Display disk snapshot overlay status" }};
+    static MTAB cachem[] = {
+        { MTAB_XTD|MTAB_VUN|MTAB_VALO, 0, NULL, "CACHE{=sectors}",
+            &sim_disk_set_cache,     NULL, NULL, "Enable the host sector cache" },
+        { MTAB_XTD|MTAB_VUN,        1,  NULL, "NOCACHE",
+            &sim_disk_set_cache,     NULL, NULL, "Disable the host sector cache" },
+        { MTAB_XTD|MTAB_VUN,        2,  NULL, "WRITETHROUGH",
+            &sim_disk_set_cache,     NULL, NULL, "Write sectors through the cache immediately" },
+        { MTAB_XTD|MTAB_VUN,        3,  NULL, "WRITEBACK",
+            &sim_disk_set_cache,     NULL, NULL, "Hold written sectors in the cache until flushed" },
+        { MTAB_XTD|MTAB_VUN|MTAB_NMO, 0, "CACHE", NULL,
+            NULL, &sim_disk_show_cache, NULL, "Display host sector cache settings and statistics" }};
     MTAB *mtab = dptr->modifiers;
     MTAB *nmtab = NULL;
     t_stat (*validator)(UNIT *up, int32 v, CONST char *cp, void *dp) = NULL;
@@ -7419,9 +10201,21 @@ for (i = 0; NULL != (dptr = sim_devices[i]); i++) {
     uint32 aliases = 0;
     int32 show_type_entry = -1;
 
-    if (((DEV_TYPE (dptr) != DEV_DISK) && (DEV_TYPE (dptr) != DEV_SCSI)) ||
-        (dptr->type_ctx == NULL))
+    if ((DEV_TYPE (dptr) != DEV_DISK) && (DEV_TYPE (dptr) != DEV_SCSI))
         continue;
+    if (dptr->type_ctx == NULL) {           /* No drive types, just add snapshot modifiers */
+        for (j = 0; (mtab != NULL) && (mtab[j].mask != 0); j++)
+            ;
+        nmtab = (MTAB *)calloc (1 + j + (sizeof (snaps)/sizeof (snaps[0])) + (sizeof (cachem)/sizeof (cachem[0])), sizeof (MTAB));
+        for (l = 0; l < j; l++)
+            nmtab[l] = mtab[l];
+        for (k = 0; k < (sizeof (snaps)/sizeof (snaps[0])); k++)
+            nmtab[l++] = snaps[k];
+        for (k = 0; k < (sizeof (cachem)/sizeof (cachem[0])); k++)
+            nmtab[l++] = cachem[k];
+        dptr->modifiers = nmtab;
+        continue;
+        }
     sim_debug (SIM_DBG_INIT, &sim_scp_dev, "Device: %s\n", dptr->name);
     drive = (DRVTYP *)dptr->type_ctx;
     /* First prepare/fill-in the drive type list */
@@ -7479,7 +10273,7 @@ for (i = 0; NULL != (dptr = sim_devices[i]); i++) {
         }
     sim_debug (SIM_DBG_INIT, &sim_scp_dev, "%d Smart Autosizers, %d Modifiers, %d Setters, %d Dumb Autosizers\n",
                                            smart_autosizers, modifiers, setters, dumb_autosizers);
-    nmtab = (MTAB *)calloc (2 + ((smart_autosizers == 0) * (sizeof (autos)/sizeof (autos[0]))) + (1 + (sizeof (autos)/sizeof (autos[0]))) * (drives + aliases + (modifiers - (setters + dumb_autosizers))), sizeof (MTAB));
+    nmtab = (MTAB *)calloc (2 + ((smart_autosizers == 0) * (sizeof (autos)/sizeof (autos[0]))) + (sizeof (snaps)/sizeof (snaps[0])) + (sizeof (cachem)/sizeof (cachem[0])) + (1 + (sizeof (autos)/sizeof (autos[0]))) * (drives + aliases + (modifiers - (setters + dumb_autosizers))), sizeof (MTAB));
     l = 0;
     for (j = 0; mtab[j].mask != 0; j++) {
         if ((((mtab[j].pstring != NULL) &&
@@ -7577,6 +10371,14 @@ for (i = 0; NULL != (dptr = sim_devices[i]); i++) {
             deb_MTAB (&nmtab[l-1]);
             }
         }
+    for (k = 0; k < (sizeof (snaps)/sizeof (snaps[0])); k++) {
+        deb_MTAB (&snaps[k]);
+        nmtab[l++] = snaps[k];
+        }
+    for (k = 0; k < (sizeof (cachem)/sizeof (cachem[0])); k++) {
+        deb_MTAB (&cachem[k]);
+        nmtab[l++] = cachem[k];
+        }
     if (show_type_entry == -1) {
         nmtab[l].mask = MTAB_XTD|MTAB_VUN;
         nmtab[l].match = k;
@@ -7795,19 +10597,29 @@ if (info->flag == 0) {  /* DISKINFO */
     uptr->disk_ctx = &disk_ctx;
     disk_ctx.capac_factor = 1;
     disk_ctx.dptr = uptr->dptr = dptr;
-    sim_disk_set_fmt (uptr, 0, "VHD", NULL);
-    container = sim_vhd_disk_open (FullPath, "rb");
-    if (container == NULL) {
-        sim_disk_set_fmt (uptr, 0, "SIMH", NULL);
-        container = sim_fopen (FullPath, "rb");
-        close_function = fclose;
-        size_function = sim_fsize_ex;
+    sim_disk_set_fmt (uptr, 0, "SIMH", NULL);
+    container = sim_sparse_disk_open (FullPath, "rb");
+    disk_ctx.sparse = (container != NULL);
+    if (container != NULL) {
+        close_function = sim_sparse_disk_close;
+        size_function = sim_sparse_disk_size;
         parent_path_function = NULL;
         }
     else {
-        close_function = sim_vhd_disk_close;
-        size_function = sim_vhd_disk_size;
-        parent_path_function = sim_vhd_disk_parent_path;
+        sim_disk_set_fmt (uptr, 0, "VHD", NULL);
+        container = sim_vhd_disk_open (FullPath, "rb");
+        if (container == NULL) {
+            sim_disk_set_fmt (uptr, 0, "SIMH", NULL);
+            container = sim_fopen (FullPath, "rb");
+            close_function = fclose;
+            size_function = sim_fsize_ex;
+            parent_path_function = NULL;
+            }
+        else {
+            close_function = sim_vhd_disk_close;
+            size_function = sim_vhd_disk_size;
+            parent_path_function = sim_vhd_disk_parent_path;
+            }
         }
     if (container != NULL) {
         while (container != NULL) {
@@ -7863,6 +10675,9 @@ if (info->flag == 0) {  /* DISKINFO */
                 ctx->sector_size = 512;
                 ctx->xfer_encode_size = 1;
                 }
+            if (DK_GET_FMT (uptr) == DKUF_F_SPARSE)
+                sim_printf ("%sSparse Cluster Size: %u bytes%s\n", indent, sim_sparse_disk_cluster_size (container),
+                                                                   sim_sparse_disk_compressed (container) ? ", compressed" : "");
             sim_set_uname (uptr, "FILE");
             get_filesystem_size (uptr, NULL);
             free (uptr->filename);
@@ -8534,18 +11349,523 @@ sim_free_filelist (&tarfiles);
 return SCPE_OK;
 }
 
+static void _sim_disk_snapshot_pattern (UNIT *uptr, uint8 *buf, t_lba lba, t_seccnt sects, uint16 bias)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+uint16 *data = (uint16 *)buf;
+size_t words_per_sector = ctx->sector_size / sizeof (*data);
+size_t i;
+
+for (i = 0; i < sects * words_per_sector; i++)
+    data[i] = (uint16)(bias + lba + i / words_per_sector);
+}
+
+static t_stat _sim_disk_snapshot_check (UNIT *uptr, uint8 *buf, uint8 *chk, t_lba lba, t_seccnt sects, uint16 bias)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_seccnt sectsread;
+t_stat r;
+
+r = sim_disk_rdsect (uptr, lba, buf, &sectsread, sects);
+if ((r != SCPE_OK) || (sectsread != sects))
+    return sim_messagef (SCPE_IERR, "%s: Error reading %u sectors at lba %u\n", sim_uname (uptr), sects, lba);
+_sim_disk_snapshot_pattern (uptr, chk, lba, sects, bias);
+if (memcmp (buf, chk, sects * ctx->sector_size) != 0)
+    return sim_messagef (SCPE_IERR, "%s: Unexpected snapshot data in sectors %u thru %u\n", sim_uname (uptr), lba, lba + sects - 1);
+return SCPE_OK;
+}
+
+/* Common state of the container feature tests, which all exercise unit 0
+   with 512 byte sectors and re-attach their container read only (where the
+   unit allows it) to verify what was written */
+
+typedef struct {
+    UNIT                *uptr;
+    uint8               *buf;
+    uint8               *chk;
+    int32               saved_switches;
+    int32               rdonly;
+    } DISK_TEST_FIXTURE;
+
+static t_stat _sim_disk_test_setup (DEVICE *dptr, DISK_TEST_FIXTURE *fx, size_t bytes, const char *title)
+{
+fx->uptr = &dptr->units[0];
+fx->buf = (uint8 *)malloc (bytes);
+fx->chk = (uint8 *)malloc (bytes);
+fx->saved_switches = sim_switches;
+fx->rdonly = (fx->uptr->flags & UNIT_ROABLE) ? SWMASK ('R') : 0;
+if ((fx->buf == NULL) || (fx->chk == NULL)) {
+    free (fx->buf);
+    free (fx->chk);
+    return SCPE_MEM;
+    }
+sim_printf ("\n*** %s tests\n", title);
+return SCPE_OK;
+}
+
+static t_stat _sim_disk_test_attach (DISK_TEST_FIXTURE *fx, int32 switches, const char *spec)
+{
+sim_switches = switches;
+return sim_disk_attach_ex (fx->uptr, spec, 512, sizeof (uint16), TRUE, 0, NULL, 0, 0, NULL);
+}
+
+static t_stat _sim_disk_test_reattach (DISK_TEST_FIXTURE *fx, const char *container)
+{
+return _sim_disk_test_attach (fx, fx->rdonly, container);
+}
+
+static t_stat _sim_disk_test_done (DISK_TEST_FIXTURE *fx, t_stat r)
+{
+sim_disk_set_fmt (fx->uptr, 0, "AUTO", NULL);
+sim_switches = fx->saved_switches;
+free (fx->buf);
+free (fx->chk);
+return r;
+}
+
+static t_stat sim_disk_snapshot_test (DEVICE *dptr)
+{
+const char *fmt[] = {"SIMH", "VHD", NULL};
+DISK_TEST_FIXTURE fx;
+UNIT *uptr;
+uint8 *buf, *chk;
+char base[64], spec[2*64];
+int f;
+t_stat r;
+
+r = _sim_disk_test_setup (dptr, &fx, 16 * 512, "Disk Snapshot Overlay");
+if (r != SCPE_OK)
+    return r;
+uptr = fx.uptr;
+buf = fx.buf;
+chk = fx.chk;
+for (f = 0; (fmt[f] != NULL) && (r == SCPE_OK); f++) {
+    snprintf (base, sizeof (base), "Test-Snapshot.%s", fmt[f]);
+    snprintf (spec, sizeof (spec), "Test-Snapshot.snap %s", base);
+    (void)remove (base);
+    (void)remove ("Test-Snapshot.snap");
+    sim_printf ("Testing %s snapshot of a %s container\n", sim_uname (uptr), fmt[f]);
+    sim_disk_set_fmt (uptr, 0, fmt[f], NULL);
+    r = _sim_disk_test_attach (&fx, 0, base);
+    if (r != SCPE_OK)
+        break;
+    _sim_disk_snapshot_pattern (uptr, buf, 0, 16, 0);
+    r = sim_disk_wrsect (uptr, 0, buf, NULL, 16);
+    sim_disk_detach (uptr);
+    /* Changes go to the overlay and leave the base untouched */
+    if (r == SCPE_OK)
+        r = _sim_disk_test_attach (&fx, SWMASK ('S'), spec);
+    if (r == SCPE_OK) {
+        if (sim_disk_wrp (uptr))
+            r = sim_messagef (SCPE_IERR, "%s: Snapshot unit is write protected\n", sim_uname (uptr));
+        _sim_disk_snapshot_pattern (uptr, buf, 4, 4, 0x1000);
+        if (r == SCPE_OK)
+            r = sim_disk_wrsect (uptr, 4, buf, NULL, 4);
+        if (r == SCPE_OK)
+            r = _sim_disk_snapshot_check (uptr, buf, chk, 0, 4, 0);
+        if (r == SCPE_OK)
+            r = _sim_disk_snapshot_check (uptr, buf, chk, 4, 4, 0x1000);
+        if (r == SCPE_OK)
+            r = _sim_disk_snapshot_check (uptr, buf, chk, 8, 8, 0);
+        sim_disk_detach (uptr);
+        }
+    if (r == SCPE_OK)
+        r = _sim_disk_test_reattach (&fx, base);
+    if (r == SCPE_OK) {
+        r = _sim_disk_snapshot_check (uptr, buf, chk, 0, 16, 0);
+        sim_disk_detach (uptr);
+        }
+    /* An existing overlay is resumed, then discarded and merged */
+    if (r == SCPE_OK)
+        r = _sim_disk_test_attach (&fx, SWMASK ('S'), spec);
+    if (r == SCPE_OK) {
+        r = _sim_disk_snapshot_check (uptr, buf, chk, 4, 4, 0x1000);
+        if (r == SCPE_OK)
+            r = sim_disk_set_snapshot (uptr, 2, NULL, NULL);
+        if (r == SCPE_OK)
+            r = _sim_disk_snapshot_check (uptr, buf, chk, 0, 16, 0);
+        _sim_disk_snapshot_pattern (uptr, buf, 2, 12, 0x2000);
+        if (r == SCPE_OK)
+            r = sim_disk_wrsect (uptr, 2, buf, NULL, 12);
+        if (r == SCPE_OK)
+            r = sim_disk_set_snapshot (uptr, 3, NULL, NULL);
+        if ((r == SCPE_OK) &&
+            (((struct disk_context *)uptr->disk_ctx)->overlay->changed != 0))
+            r = sim_messagef (SCPE_IERR, "%s: Snapshot not empty after merge\n", sim_uname (uptr));
+        if (r == SCPE_OK)
+            r = _sim_disk_snapshot_check (uptr, buf, chk, 2, 12, 0x2000);
+        sim_disk_detach (uptr);
+        }
+    if (r == SCPE_OK)
+        r = _sim_disk_test_reattach (&fx, base);
+    if (r == SCPE_OK) {
+        r = _sim_disk_snapshot_check (uptr, buf, chk, 0, 2, 0);
+        if (r == SCPE_OK)
+            r = _sim_disk_snapshot_check (uptr, buf, chk, 2, 12, 0x2000);
+        if (r == SCPE_OK)
+            r = _sim_disk_snapshot_check (uptr, buf, chk, 14, 2, 0);
+        sim_disk_detach (uptr);
+        }
+    (void)remove (base);
+    (void)remove ("Test-Snapshot.snap");
+    }
+return _sim_disk_test_done (&fx, r);
+}
+
+static t_stat sim_disk_cache_test (DEVICE *dptr)
+{
+DISK_TEST_FIXTURE fx;
+UNIT *uptr;
+uint8 *buf, *chk;
+const char *base = "Test-Cache.SIMH";
+struct disk_cache *cache;
+int mode;
+t_stat r;
+
+r = _sim_disk_test_setup (dptr, &fx, 16 * 512, "Disk Sector Cache");
+if (r != SCPE_OK)
+    return r;
+uptr = fx.uptr;
+buf = fx.buf;
+chk = fx.chk;
+for (mode = 0; (mode < 2) && (r == SCPE_OK); mode++) {
+    sim_printf ("Testing %s %s sector cache\n", sim_uname (uptr), mode ? "write-back" : "write-through");
+    (void)remove (base);
+    sim_disk_set_fmt (uptr, 0, "SIMH", NULL);
+    if (SCPE_BARE_STATUS (sim_disk_set_cache (uptr, 0, "8", NULL)) != SCPE_UNATT)
+        r = sim_messagef (SCPE_IERR, "%s: Cache allowed on an unattached unit\n", sim_uname (uptr));
+    if (r == SCPE_OK)
+        r = _sim_disk_test_attach (&fx, 0, base);
+    if (r != SCPE_OK)
+        break;
+    r = sim_disk_set_cache (uptr, 0, "8", NULL);
+    if (r == SCPE_OK)
+        r = sim_disk_set_cache (uptr, mode ? 3 : 2, NULL, NULL);
+    if (r != SCPE_OK) {
+        sim_disk_detach (uptr);
+        break;
+        }
+    cache = ((struct disk_context *)uptr->disk_ctx)->cache;
+    _sim_disk_snapshot_pattern (uptr, buf, 0, 16, 0);
+    r = sim_disk_wrsect (uptr, 0, buf, NULL, 2);        /* small writes are cached */
+    if (r == SCPE_OK)
+        r = sim_disk_wrsect (uptr, 2, buf + 2 * 512, NULL, 14);/* large writes bypass the cache */
+    if ((r == SCPE_OK) && (cache->dirty != (mode ? 2u : 0u)))
+        r = sim_messagef (SCPE_IERR, "%s: Unexpected %u dirty cache sectors\n", sim_uname (uptr), cache->dirty);
+    if (r == SCPE_OK)                                   /* partly cached, so no hits */
+        r = _sim_disk_snapshot_check (uptr, buf, chk, 0, 16, 0);
+    if ((r == SCPE_OK) && (cache->read_hits != 0))
+        r = sim_messagef (SCPE_IERR, "%s: Partial read counted %u cache hits\n", sim_uname (uptr), (uint32)cache->read_hits);
+    if (r == SCPE_OK)                                   /* satisfied from the cache */
+        r = _sim_disk_snapshot_check (uptr, buf, chk, 0, 2, 0);
+    if ((r == SCPE_OK) && (cache->read_hits != 2))
+        r = sim_messagef (SCPE_IERR, "%s: Cached read counted %u cache hits\n", sim_uname (uptr), (uint32)cache->read_hits);
+    _sim_disk_snapshot_pattern (uptr, buf, 0, 4, 0x3000);
+    if (r == SCPE_OK) {
+        int i;
+
+        for (i = 0; (i < 4) && (r == SCPE_OK); i++) {
+            r = sim_disk_wrsect (uptr, i, buf + i * 512, NULL, 1);
+            if (r == SCPE_OK)
+                r = sim_disk_wrsect (uptr, 8 + i, buf + i * 512, NULL, 1);
+            }
+        }
+    if (r == SCPE_OK)
+        r = _sim_disk_snapshot_check (uptr, buf, chk, 0, 4, 0x3000);
+    if ((r == SCPE_OK) && (cache->read_hits == 0))
+        r = sim_messagef (SCPE_IERR, "%s: No cache hits recorded\n", sim_uname (uptr));
+    if (r == SCPE_OK)
+        r = sim_disk_flush (uptr);
+    if ((r == SCPE_OK) && (cache->dirty != 0))
+        r = sim_messagef (SCPE_IERR, "%s: Cache still dirty after flush\n", sim_uname (uptr));
+    sim_disk_detach (uptr);
+    if (r == SCPE_OK)
+        r = _sim_disk_test_reattach (&fx, base);
+    if (r == SCPE_OK) {
+        r = _sim_disk_snapshot_check (uptr, buf, chk, 0, 4, 0x3000);
+        if (r == SCPE_OK)
+            r = _sim_disk_snapshot_check (uptr, buf, chk, 4, 4, 0);
+        if (r == SCPE_OK)
+            r = _sim_disk_snapshot_check (uptr, buf, chk, 8, 4, 0x3000 - 8);
+        sim_disk_detach (uptr);
+        }
+    (void)remove (base);
+    }
+return _sim_disk_test_done (&fx, r);
+}
+
+static t_stat sim_disk_map_test (DEVICE *dptr)
+{
+DISK_TEST_FIXTURE fx;
+UNIT *uptr;
+uint8 *buf, *chk;
+const char *base = "Test-Map.SIMH";
+struct disk_context *ctx;
+t_stat r;
+
+r = _sim_disk_test_setup (dptr, &fx, 16 * 512, "Memory Mapped Container");
+if (r != SCPE_OK)
+    return r;
+uptr = fx.uptr;
+buf = fx.buf;
+chk = fx.chk;
+(void)remove (base);
+sim_disk_set_fmt (uptr, 0, "SIMH", NULL);
+r = _sim_disk_test_attach (&fx, 0, base);
+if (r == SCPE_OK) {
+    FILE *f;
+
+    _sim_disk_snapshot_pattern (uptr, buf, 0, 8, 0);
+    r = sim_disk_wrsect (uptr, 0, buf, NULL, 8);
+    sim_disk_detach (uptr);
+    f = sim_fopen (base, "rb+");                        /* a container shorter than the disk */
+    if ((r == SCPE_OK) && ((f == NULL) || (sim_set_fsize (f, (t_addr)(8 * 512)) != 0)))
+        r = sim_messagef (SCPE_IERR, "%s: Can't shorten %s\n", sim_uname (uptr), base);
+    if (f != NULL)
+        fclose (f);
+    }
+if (r == SCPE_OK)
+    r = _sim_disk_test_attach (&fx, SWMASK ('P'), base);
+if (r == SCPE_OK) {
+    ctx = (struct disk_context *)uptr->disk_ctx;
+    if (ctx->map == NULL)
+        sim_printf ("%s: Container not mapped, skipping\n", sim_uname (uptr));
+    else {
+        sim_printf ("Testing %s mapped %s container\n", sim_uname (uptr), "SIMH");
+        if (ctx->map_size != 8 * 512)                   /* only what exists is mapped, unextended */
+            r = sim_messagef (SCPE_IERR, "%s: Unexpected mapping size %" LL_FMT "u\n", sim_uname (uptr), (t_uint64)ctx->map_size);
+        _sim_disk_snapshot_pattern (uptr, buf, 0, 16, 0x4000);
+        if (r == SCPE_OK)                               /* within the mapping */
+            r = sim_disk_wrsect (uptr, 0, buf, NULL, 4);
+        if (r == SCPE_OK)                               /* across its end, extending the file */
+            r = sim_disk_wrsect (uptr, 4, buf + 4 * 512, NULL, 12);
+        if (r == SCPE_OK)
+            r = _sim_disk_snapshot_check (uptr, buf, chk, 0, 16, 0x4000);
+        if (r == SCPE_OK)
+            r = sim_disk_flush (uptr);
+        }
+    sim_disk_detach (uptr);
+    if (r == SCPE_OK)                                   /* verify through file I/O */
+        r = _sim_disk_test_reattach (&fx, base);
+    if (r == SCPE_OK) {
+        r = _sim_disk_snapshot_check (uptr, buf, chk, 0, 16, 0x4000);
+        sim_disk_detach (uptr);
+        }
+    }
+(void)remove (base);
+return _sim_disk_test_done (&fx, r);
+}
+
+#if defined (SIM_ASYNCH_IO)
+/* io_uring transfers */
+
+#define RING_TEST_XFERS 16                              /* transfers of 16 sectors each */
+
+static uint32 _ring_test_callbacks;
+static t_stat _ring_test_status;
+
+static void _sim_disk_ring_test_callback (UNIT *uptr, t_stat r)
+{
+++_ring_test_callbacks;
+if (r != SCPE_OK)
+    _ring_test_status = r;
+}
+
+/* Collect asynchronous completions the way the simulator's event loop would */
+
+static t_stat _sim_disk_ring_test_wait (UNIT *uptr, uint32 callbacks)
+{
+uint32 start = sim_os_msec ();
+
+while ((_ring_test_callbacks < callbacks) && ((sim_os_msec () - start) < 10000)) {
+    sim_aio_update_queue ();
+    if (_ring_test_callbacks < callbacks)
+        sim_os_ms_sleep (1);
+    }
+sim_cancel (uptr);
+if (_ring_test_callbacks < callbacks)
+    return sim_messagef (SCPE_IERR, "%s: %u of %u transfers completed\n", sim_uname (uptr), _ring_test_callbacks, callbacks);
+return _ring_test_status;
+}
+
+static t_stat sim_disk_ring_test (DEVICE *dptr)
+{
+DISK_TEST_FIXTURE fx;
+UNIT *uptr;
+uint8 *buf, *chk;
+t_seccnt sects[RING_TEST_XFERS];
+const char *base = "Test-Ring.SIMH";
+struct disk_context *ctx;
+uint32 i;
+t_stat r;
+
+r = _sim_disk_test_setup (dptr, &fx, RING_TEST_XFERS * 16 * 512, "io_uring Container");
+if (r != SCPE_OK)
+    return r;
+uptr = fx.uptr;
+buf = fx.buf;
+chk = fx.chk;
+(void)remove (base);
+sim_disk_set_fmt (uptr, 0, "SIMH", NULL);
+r = _sim_disk_test_attach (&fx, SWMASK ('A'), base);
+if (r == SCPE_OK) {
+    ctx = (struct disk_context *)uptr->disk_ctx;
+    if (!ctx->ring_active)
+        sim_printf ("%s: io_uring not in use, skipping\n", sim_uname (uptr));
+    else {
+        sim_printf ("Testing %s %s container using io_uring%s\n", sim_uname (uptr), "SIMH", ctx->ring_direct ? " and O_DIRECT" : "");
+        _ring_test_callbacks = 0;
+        _ring_test_status = SCPE_OK;
+        for (i = 0; i < RING_TEST_XFERS; i++) {         /* many writes outstanding at once */
+            _sim_disk_snapshot_pattern (uptr, buf + i * 16 * 512, 100 + i * 16, 16, 0x6000);
+            sim_disk_wrsect_a (uptr, 100 + i * 16, buf + i * 16 * 512, &sects[i], 16, _sim_disk_ring_test_callback);
+            }
+        r = _sim_disk_ring_test_wait (uptr, RING_TEST_XFERS);
+        memset (buf, 0, RING_TEST_XFERS * 16 * 512);
+        for (i = 0; (r == SCPE_OK) && (i < RING_TEST_XFERS); i++)/* and reads */
+            sim_disk_rdsect_a (uptr, 100 + i * 16, buf + i * 16 * 512, &sects[i], 16, _sim_disk_ring_test_callback);
+        if (r == SCPE_OK)
+            r = _sim_disk_ring_test_wait (uptr, 2 * RING_TEST_XFERS);
+        _sim_disk_snapshot_pattern (uptr, chk, 100, RING_TEST_XFERS * 16, 0x6000);
+        if ((r == SCPE_OK) && (memcmp (buf, chk, RING_TEST_XFERS * 16 * 512) != 0))
+            r = sim_messagef (SCPE_IERR, "%s: Unexpected data read with io_uring\n", sim_uname (uptr));
+        if (r == SCPE_OK)                               /* synchronous transfers share the descriptor */
+            r = _sim_disk_snapshot_check (uptr, buf, chk, 100, 16, 0x6000);
+        }
+    sim_disk_detach (uptr);
+    if (r == SCPE_OK)                                   /* verify through file I/O */
+        r = _sim_disk_test_reattach (&fx, base);
+    if (r == SCPE_OK) {
+        r = _sim_disk_snapshot_check (uptr, buf, chk, 100, RING_TEST_XFERS * 16, 0x6000);
+        sim_disk_detach (uptr);
+        }
+    }
+(void)remove (base);
+return _sim_disk_test_done (&fx, r);
+}
+#endif
+
+/* Sectors 0 thru 63 contain the test pattern, except sector 3 which is zero */
+
+static t_stat _sim_disk_sparse_check (UNIT *uptr, uint8 *buf, uint8 *chk)
+{
+t_stat r;
+
+r = _sim_disk_snapshot_check (uptr, buf, chk, 0, 3, 0x5000);
+if (r == SCPE_OK)
+    r = _sim_disk_snapshot_check (uptr, buf, chk, 4, 60, 0x5000);
+if (r == SCPE_OK)
+    r = sim_disk_rdsect (uptr, 3, buf, NULL, 1);
+if ((r == SCPE_OK) && (!_sparse_is_zero (buf, 512)))
+    r = sim_messagef (SCPE_IERR, "%s: Zeroed sector has unexpected data\n", sim_uname (uptr));
+return r;
+}
+
+static t_stat sim_disk_sparse_test (DEVICE *dptr)
+{
+DISK_TEST_FIXTURE fx;
+UNIT *uptr;
+uint8 *buf, *chk;
+const char *base = "Test-Sparse.SPARSE";
+char spec[64];
+t_lba far_lba;
+int mode;
+t_stat r;
+
+r = _sim_disk_test_setup (dptr, &fx, 64 * 512, "SIMH Sparse container");
+if (r != SCPE_OK)
+    return r;
+uptr = fx.uptr;
+buf = fx.buf;
+chk = fx.chk;
+snprintf (spec, sizeof (spec), "SPARSE %s", base);
+for (mode = 0; (mode < 2) && (r == SCPE_OK); mode++) {
+    sim_printf ("Testing %s %sSIMH Sparse container\n", sim_uname (uptr), mode ? "compressed " : "");
+    (void)remove (base);
+    r = _sim_disk_test_attach (&fx, SWMASK ('F') | (mode ? SWMASK ('Z') : 0), spec);
+    if (r != SCPE_OK)
+        break;
+    far_lba = (t_lba)(((struct disk_context *)uptr->disk_ctx)->container_size / 512) - 64;
+    _sim_disk_snapshot_pattern (uptr, buf, 0, 64, 0x5000);
+    r = sim_disk_wrsect (uptr, 0, buf, NULL, 64);
+    if (r == SCPE_OK)
+        r = sim_disk_wrsect (uptr, far_lba, buf, NULL, 64);
+    memset (buf, 0, 512);                               /* zeros within allocated clusters */
+    if (r == SCPE_OK)
+        r = sim_disk_wrsect (uptr, 3, buf, NULL, 1);
+    if (r == SCPE_OK)
+        r = _sim_disk_sparse_check (uptr, buf, chk);
+    if (r == SCPE_OK)                                   /* never written reads as zeros */
+        r = sim_disk_rdsect (uptr, 1000, chk, NULL, 64);
+    if ((r == SCPE_OK) && (!_sparse_is_zero (chk, 64 * 512)))
+        r = sim_messagef (SCPE_IERR, "%s: Unwritten sectors don't read as zero\n", sim_uname (uptr));
+    if (r == SCPE_OK)                                   /* discard a whole range */
+        r = sim_disk_trim (uptr, far_lba, 64);
+    if (r == SCPE_OK)
+        r = sim_disk_rdsect (uptr, far_lba, chk, NULL, 64);
+    if ((r == SCPE_OK) && (!_sparse_is_zero (chk, 64 * 512)))
+        r = sim_messagef (SCPE_IERR, "%s: Trimmed sectors don't read as zero\n", sim_uname (uptr));
+    sim_disk_detach (uptr);
+    if ((r == SCPE_OK) && (sim_fsize_name_ex (base) > 1024 * 1024))
+        r = sim_messagef (SCPE_IERR, "%s: Sparse container is unexpectedly large\n", sim_uname (uptr));
+    sim_disk_set_fmt (uptr, 0, "AUTO", NULL);           /* reopen with format detection */
+    if (r == SCPE_OK)
+        r = _sim_disk_test_reattach (&fx, base);
+    if (r == SCPE_OK) {
+        if (DK_GET_FMT (uptr) != DKUF_F_SPARSE)
+            r = sim_messagef (SCPE_IERR, "%s: SIMH Sparse container not detected\n", sim_uname (uptr));
+        if (r == SCPE_OK)
+            r = _sim_disk_sparse_check (uptr, buf, chk);
+        sim_disk_detach (uptr);
+        }
+    if (r == SCPE_OK) {                                 /* space released by the trim is reused later */
+        t_offset size = sim_fsize_name_ex (base);
+
+        r = _sim_disk_test_attach (&fx, 0, base);
+        if (r == SCPE_OK) {
+            _sim_disk_snapshot_pattern (uptr, buf, 0, 64, 0x5000);
+            r = sim_disk_wrsect (uptr, far_lba, buf, NULL, 64);
+            sim_disk_detach (uptr);
+            }
+        if ((r == SCPE_OK) && (sim_fsize_name_ex (base) > size))
+            r = sim_messagef (SCPE_IERR, "%s: Released container space wasn't reused after re-attach\n", sim_uname (uptr));
+        }
+    if ((r == SCPE_OK) && fx.rdonly) {                  /* SIMH format units don't look for sparse containers */
+        sim_disk_set_fmt (uptr, 0, "SIMH", NULL);
+        r = _sim_disk_test_reattach (&fx, base);
+        if (r == SCPE_OK) {
+            if (DK_GET_FMT (uptr) == DKUF_F_SPARSE)
+                r = sim_messagef (SCPE_IERR, "%s: SIMH format unit opened a SIMH Sparse container\n", sim_uname (uptr));
+            sim_disk_detach (uptr);
+            }
+        sim_disk_set_fmt (uptr, 0, "AUTO", NULL);
+        }
+    (void)remove (base);
+    }
+return _sim_disk_test_done (&fx, r);
+}
+
 t_stat sim_disk_test (DEVICE *dptr, const char *cptr)
 {
-const char *fmt[] = {"RAW", "VHD", "VHD", "SIMH", NULL};
+const char *fmt[] = {"RAW", "VHD", "VHD", "SIMH", "SPARSE", NULL};
 uint32 sect_size[] = {576, 4096, 1024, 512, 256, 128, 64, 0};
 uint32 xfr_size[] = {1, 2, 4, 8, 0};
 int x, s, f;
 UNIT *uptr = &dptr->units[0];
 char filename[256];
+char spec[264];
+t_bool sparse;
 t_stat r;
 int32 saved_switches = sim_switches & ~SWMASK('T');
 SIM_TEST_INIT;
 
+SIM_TEST (sim_disk_snapshot_test (dptr));
+SIM_TEST (sim_disk_cache_test (dptr));
+SIM_TEST (sim_disk_map_test (dptr));
+#if defined (SIM_ASYNCH_IO)
+SIM_TEST (sim_disk_ring_test (dptr));
+#endif
+SIM_TEST (sim_disk_sparse_test (dptr));
 if (sim_switches & SWMASK ('M')) { /* Do meta first? */
     sim_switches = saved_switches &= ~SWMASK ('M');
     SIM_TEST (sim_disk_meta_attach_test (dptr, cptr));
@@ -8567,7 +11887,8 @@ for (x = 0; xfr_size[x] != 0; x++) {
             else
                 sim_switches = saved_switches;
             (void)remove (filename);        /* Remove any prior remnants */
-            r = sim_disk_set_fmt (uptr, 0, fmt[f], NULL);
+            sparse = (strcmp (fmt[f], "SPARSE") == 0); /* SIMH Sparse is only selectable at ATTACH */
+            r = sim_disk_set_fmt (uptr, 0, sparse ? "SIMH" : fmt[f], NULL);
             if (r != SCPE_OK)
                 break;
             sim_printf ("Testing %s (%s) using %s\n", sim_uname (uptr), sprint_capac (dptr, uptr), filename);
@@ -8578,7 +11899,10 @@ for (x = 0; xfr_size[x] != 0; x++) {
                 sim_disk_detach (uptr);
                 sim_disk_set_fmt (uptr, 0, fmt[f], NULL);
                 }
-            r = sim_disk_attach_ex (uptr, filename, sect_size[s], xfr_size[x], TRUE, 0, NULL, 0, 0, NULL);
+            snprintf (spec, sizeof (spec), "%s%s", sparse ? "SPARSE " : "", filename);
+            if (sparse)
+                sim_switches |= SWMASK ('F');
+            r = sim_disk_attach_ex (uptr, spec, sect_size[s], xfr_size[x], TRUE, 0, NULL, 0, 0, NULL);
             if ((r != SCPE_OK) &&
                 (SCPE_BARE_STATUS (r) != SCPE_INCOMPDSK))
                 break;
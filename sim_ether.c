@@ -2018,6 +2018,24 @@ _eth_callback((u_char *)opaque, &header, buf);
 #endif
 
 #if defined (USE_READER_THREAD)
+/* Maximum number of frames the reader thread will accept from a single
+   select() wakeup before posting a poll to the simulator thread.  Bursts
+   of traffic are then handed to the read queue together rather than
+   costing a select() and a wakeup per frame. */
+#define ETH_RX_BATCH 16
+
+#if defined (__linux__) && defined (_GNU_SOURCE)
+#define USE_RECVMMSG 1
+#endif
+
+static void
+_eth_reader_batch(ETH_DEV* dev, int count)
+{
+++dev->read_batches;
+if ((uint32)count > dev->read_batch_high)
+  dev->read_batch_high = (uint32)count;
+}
+
 static void *
 _eth_reader(void *arg)
 {
@@ -2026,6 +2044,11 @@ int status = 0;
 int sel_ret = 0;
 int do_select = 0;
 SOCKET select_fd = 0;
+#if defined (USE_RECVMMSG)
+struct mmsghdr rx_msgs[ETH_RX_BATCH];
+struct iovec rx_iov[ETH_RX_BATCH];
+u_char *rx_bufs = NULL;
+#endif
 #if defined (_WIN32)
 HANDLE hWait = (dev->eth_api == ETH_API_PCAP) ? pcap_getevent ((pcap_t*)dev->handle) : NULL;
 #endif
@@ -2048,6 +2071,25 @@ switch (dev->eth_api) {
     break;
   }
 
+#if defined (USE_RECVMMSG)
+/* UDP datagrams are collected with recvmmsg() into a set of buffers
+   which live for the life of the reader thread */
+if (dev->eth_api == ETH_API_UDP) {
+  rx_bufs = (u_char *)malloc (ETH_RX_BATCH * ETH_MAX_JUMBO_FRAME);
+  if (rx_bufs) {
+    int i;
+
+    memset (rx_msgs, 0, sizeof (rx_msgs));
+    for (i = 0; i < ETH_RX_BATCH; i++) {
+      rx_iov[i].iov_base = rx_bufs + i * ETH_MAX_JUMBO_FRAME;
+      rx_iov[i].iov_len = ETH_MAX_JUMBO_FRAME;
+      rx_msgs[i].msg_hdr.msg_iov = &rx_iov[i];
+      rx_msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+    }
+  }
+#endif
+
 sim_debug(dev->dbit, dev->dptr, "Reader Thread Starting\n");
 
 /* Boost Priority for this I/O thread vs the CPU instruction execution
@@ -2102,20 +2144,27 @@ while (dev->handle) {
         if (1) {
           struct pcap_pkthdr header;
           int len;
+          int count;
           u_char buf[ETH_MAX_JUMBO_FRAME];
 
+          /* The tap device is non-blocking, so drain the frames which
+             have arrived rather than returning to select() for each */
           memset(&header, 0, sizeof(header));
-          len = read(dev->fd_handle, buf, sizeof(buf));
-          if (len > 0) {
-            status = 1;
+          status = 0;
+          for (count = 0; count < ETH_RX_BATCH; count++) {
+            len = read(dev->fd_handle, buf, sizeof(buf));
+            if (len <= 0) {
+              if ((len < 0) && (count == 0) &&
+                  (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+                status = -1;
+              break;
+              }
             header.caplen = header.len = len;
             _eth_callback((u_char *)dev, &header, buf);
             }
-          else {
-            if (len < 0)
-              status = -1;
-            else
-              status = 0;
+          if (count > 0) {
+            status = count;
+            _eth_reader_batch (dev, count);
             }
           }
         break;
@@ -2150,6 +2199,35 @@ while (dev->handle) {
         break;
 #endif /* HAVE_SLIRP_NETWORK */
       case ETH_API_UDP:
+#if defined (USE_RECVMMSG)
+        if (rx_bufs) {
+          struct pcap_pkthdr header;
+          int i, count, frames = 0;
+
+          memset(&header, 0, sizeof(header));
+          count = recvmmsg (select_fd, rx_msgs, ETH_RX_BATCH, MSG_DONTWAIT, NULL);
+          if (count > 0) {
+            for (i = 0; i < count; i++) {
+              if (rx_msgs[i].msg_len == 0)        /* empty datagram carries no frame */
+                continue;
+              header.caplen = header.len = rx_msgs[i].msg_len;
+              _eth_callback((u_char *)dev, &header, (u_char *)rx_iov[i].iov_base);
+              ++frames;
+              }
+            status = frames;
+            if (frames > 0)
+              _eth_reader_batch (dev, frames);
+            }
+          else {
+            if ((count < 0) &&
+                (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+              status = -1;
+            else
+              status = 0;
+            }
+          break;
+          }
+#endif
         if (1) {
           struct pcap_pkthdr header;
           int len;
@@ -2201,6 +2279,9 @@ while (dev->handle) {
     }
   }
 
+#if defined (USE_RECVMMSG)
+free (rx_bufs);
+#endif
 sim_debug(dev->dbit, dev->dptr, "Reader Thread Exiting\n");
 return NULL;
 }
@@ -2675,6 +2756,9 @@ strcpy(dev->name, savname);
 /* save debugging information */
 dev->dptr = dptr;
 dev->dbit = dbit;
+dev->perf_tx = sim_perf_counter (dptr, "TX", SIM_PERF_BYTES, "Bytes in packets sent");
+dev->perf_rx = sim_perf_counter (dptr, "RX", SIM_PERF_BYTES, "Bytes in packets received");
+dev->perf_rxq = sim_perf_counter (dptr, "READ QUEUE", SIM_PERF_DEPTH, "Received packets awaiting the simulator");
 
 #if defined (USE_READER_THREAD)
 if (1) {
@@ -3203,6 +3287,7 @@ if ((packet->len >= ETH_MIN_PACKET) && (packet->len <= ETH_MAX_PACKET)) {
       break;
     }
   ++dev->packets_sent;              /* basic bookkeeping */
+  SIM_PERF_ADD (dev->perf_tx, packet->len);
   /* On error, correct loopback bookkeeping */
   if ((status != 0) && loopback_self_frame) {
 #ifdef USE_READER_THREAD
@@ -3909,6 +3994,8 @@ if (bpf_used ? to_me : (to_me && !from_me)) {
     pthread_mutex_lock (&dev->lock);
     ethq_insert_data(&dev->read_queue, ETH_ITM_NORMAL, data, 0, len, crc_len, crc_data, 0);
     ++dev->packets_received;
+    SIM_PERF_ADD (dev->perf_rx, len);
+    SIM_PERF_ADD (dev->perf_rxq, dev->read_queue.count);
     pthread_mutex_unlock (&dev->lock);
     free(moved_data);
     }
@@ -3936,6 +4023,7 @@ if (bpf_used ? to_me : (to_me && !from_me)) {
   eth_packet_trace (dev, dev->read_packet->msg, dev->read_packet->len, "reading");
 
   ++dev->packets_received;
+  SIM_PERF_ADD (dev->perf_rx, dev->read_packet->len);
 
   /* call optional read callback function */
   if (dev->read_callback)
@@ -4377,6 +4465,10 @@ if (dev->throttle_count)
 fprintf(st, "  Read Queue: Count:       %d\n", dev->read_queue.count);
 fprintf(st, "  Read Queue: High:        %d\n", dev->read_queue.high);
 fprintf(st, "  Read Queue: Loss:        %d\n", dev->read_queue.loss);
+if (dev->read_batches) {
+  fprintf(st, "  Read Batches:            %d\n", dev->read_batches);
+  fprintf(st, "  Read Batch: High:        %d\n", dev->read_batch_high);
+  }
 fprintf(st, "  Peak Write Queue Size:   %d\n", dev->write_queue_peak);
 #endif
 if (dev->error_needs_reset)
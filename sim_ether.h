@@ -285,6 +285,8 @@ struct eth_device {
   uint32        loopback_packets_processed;             /* Total Loopback Packets Processed */
   uint32        transmit_packet_errors;                 /* Total Send Packet Errors */
   uint32        receive_packet_errors;                  /* Total Read Packet Errors */
+  uint32        read_batches;                           /* Batched reader wakeups which delivered frames */
+  uint32        read_batch_high;                        /* Most frames collected in a single reader wakeup */
   int32         error_waiting_threads;                  /* Count of threads currently waiting after an error */
   ETH_BOOL      error_needs_reset;                      /* Flag indicating to force reset */
 #define ETH_ERROR_REOPEN_THRESHOLD 10                   /* Attempt ReOpen after 20 send/receive errors */
@@ -292,6 +294,9 @@ struct eth_device {
   uint32        error_reopen_count;                     /* Count of ReOpen Attempts */
   DEVICE*       dptr;                                   /* device ethernet is attached to */
   uint32        dbit;                                   /* debugging bit */
+  SIM_PERF*     perf_tx;                                /* bytes sent performance counter */
+  SIM_PERF*     perf_rx;                                /* bytes received performance counter */
+  SIM_PERF*     perf_rxq;                               /* read queue depth performance counter */
   int           reflections;                            /* packet reflections on interface */
   int           need_crc;                               /* device needs CRC (Cyclic Redundancy Check) */
   /* Throttling control parameters: */
@@ -67,6 +67,12 @@ typedef void pcre_extra;
 #ifndef PCRE_CASELESS
 #define PCRE_CASELESS           0x00000001  /* C1       */
 #endif
+#ifndef PCRE_PARTIAL_SOFT
+#define PCRE_PARTIAL_SOFT       0x00008000  /*    E D J */
+#define PCRE_ERROR_BADOPTION        (-3)
+#define PCRE_ERROR_PARTIAL          (-12)
+#define PCRE_ERROR_BADPARTIAL       (-13)
+#endif
 /* Pointers to useful PCRE functions */
 extern pcre *(*pcre_compile) (const char *, int, const char **, int *, const unsigned char *);
 extern const char *(*pcre_version) (void);
@@ -225,6 +231,7 @@ extern int32 sim_asynch_inst_latency;
       } while (0)
 #define AIO_CLEANUP                                               \
     do {                                                          \
+      sim_aio_pool_cleanup();                                     \
       pthread_mutex_destroy(&sim_asynch_lock);                    \
       pthread_cond_destroy(&sim_asynch_wake);                     \
       pthread_mutex_destroy(&sim_timer_lock);                     \
@@ -373,6 +380,8 @@ struct EXPTAB {
 #define EXP_TYP_TIME            (SWMASK ('T'))      /* halt delay is in microseconds instead of instructions */
     pcre                *regex;                         /* compiled regular expression */
     int                 re_nsub;                        /* regular expression sub expression count */
+    uint32              re_start;                       /* regex buffer offset where a match could still begin */
+    t_bool              re_nopartial;                   /* partial matching unsupported for this expression */
     char                *act;                           /* action string */
     };
 
@@ -387,6 +396,20 @@ struct EXPECT {
     uint32              buf_ins;                        /* buffer insertion point for the next output data */
     uint32              buf_size;                       /* buffer size */
     uint32              buf_data;                       /* count of data in buffer */
+    uint16              *ac_class;                      /* automaton input class of each byte value */
+    uint32              ac_classes;                     /* count of input classes */
+    uint32              *ac_next;                       /* literal rule automaton transitions (ac_classes per state) */
+    int32               *ac_rule;                       /* lowest literal rule matched in each state or -1 */
+    uint32              ac_states;                      /* count of automaton states */
+    uint32              ac_state;                       /* current automaton state */
+    t_bool              ac_valid;                       /* automaton and regex list reflect current rules */
+    int32               *re_rules;                      /* indexes of regular expression rules */
+    int32               re_count;                       /* count of regular expression rules */
+    char                *rbuf;                          /* NUL free output data for regular expression rules */
+    uint32              rbuf_ins;                       /* regex buffer insertion point */
+    uint32              rbuf_size;                      /* regex buffer size */
+    int                 *ovector;                       /* regex match offsets */
+    int                 ovector_size;                   /* regex match offsets vector size */
     };
 
 /* Send Context */
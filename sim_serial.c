@@ -1379,6 +1379,18 @@ free (port);
 }
 
 
+/* Return the file descriptor of an open serial port.
+
+   This allows callers to wait for serial input with the host's own
+   descriptor based facilities (select, poll, epoll).
+*/
+
+int sim_serial_fd (SERHANDLE port)
+{
+return port->port;
+}
+
+
 #elif defined (VMS)
 
 /* VMS implementation */
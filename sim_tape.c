@@ -139,6 +139,10 @@ static const uint32 bpi [] = {                          /* tape density table, i
 #define BPI_COUNT       (sizeof (bpi) / sizeof (bpi [0]))   /* count of density table entries */
 
 static t_stat sim_tape_ioerr (UNIT *uptr);
+static int sim_tape_seek (UNIT *uptr, t_addr pos);
+static t_stat sim_tape_wc_flush (UNIT *uptr);
+static t_stat sim_tape_wc_sync (UNIT *uptr);
+static void sim_tape_ra_invalidate (UNIT *uptr);
 static t_stat sim_tape_wrdata (UNIT *uptr, uint32 dat);
 static t_stat sim_tape_aws_wrdata (UNIT *uptr, uint8 *buf, t_mtrlnt bc);
 static uint32 sim_tape_tpc_map (UNIT *uptr, t_addr *map, uint32 mapsize);
@@ -148,6 +152,11 @@ static void sim_tape_data_trace (UNIT *uptr, const uint8 *data, size_t len, cons
 static t_stat tape_erase_fwd (UNIT *uptr, t_mtrlnt gap_size);
 static t_stat tape_erase_rev (UNIT *uptr, t_mtrlnt gap_size);
 
+typedef struct {
+    t_addr              pos;                /* container offset of the object */
+    t_mtrlnt            bc;                 /* record length as read (tape mark: 0) */
+    } TAPE_INDEX;
+
 struct tape_context {
     DEVICE              *dptr;              /* Device for unit (access to debug flags) */
     uint32              dbit;               /* debugging bit for trace */
@@ -156,16 +165,43 @@ struct tape_context {
     uint32              chunk_buf_size;
     uint32              chunk_data_size;
     uint32              chunk_offset;
+    SIM_PERF            *perf_read;         /* bytes read performance counter */
+    SIM_PERF            *perf_write;        /* bytes written performance counter */
+    SIM_PERF            *perf_rlat;         /* read latency performance counter */
+    SIM_PERF            *perf_wlat;         /* write latency performance counter */
+    uint8               *ra_buf;            /* read-ahead buffer */
+    t_addr              ra_pos;             /* container offset of ra_buf[0] */
+    uint32              ra_len;             /* valid bytes in ra_buf */
+    uint8               *ra_data;           /* data of record just spaced over from ra_buf */
+    uint8               *wc_buf;            /* write coalescing buffer */
+    t_addr              wc_pos;             /* container offset of wc_buf[0] */
+    uint32              wc_len;             /* pending bytes in wc_buf */
+    TAPE_INDEX          *idx;               /* record/tape mark index */
+    uint32              idx_count;          /* objects in the index */
+    uint32              idx_size;           /* allocated index entries */
+    t_addr              idx_end;            /* container offset just past the last indexed object */
+    uint32              *idx_tmk;           /* index numbers of the tape marks (ascending) */
+    uint32              idx_tmk_count;      /* tape marks in the index */
+    uint32              idx_tmk_size;       /* allocated tape mark entries */
 #if defined SIM_ASYNCH_IO
     t_bool              asynch_io;          /* Asynchronous Interrupt scheduling enabled */
     int                 asynch_io_latency;  /* instructions to delay pending interrupt */
     pthread_mutex_t     lock;
-    pthread_t           io_thread;          /* I/O Thread Id */
-    pthread_mutex_t     io_lock;
-    pthread_cond_t      io_cond;
-    pthread_cond_t      io_done;
-    pthread_cond_t      startup_cond;
-    int                 io_top;
+    SIM_AIO_UNITQ       *aioq;              /* I/O worker pool request queue */
+    struct tape_aio_req *aio_free;          /* unused request structures */
+#endif
+    };
+#define tape_ctx up8                        /* Field in Unit structure which points to the tape_context */
+
+#define TAPE_RA_SIZE    (256*1024)          /* read-ahead window size */
+#define TAPE_WC_SIZE    (256*1024)          /* write coalescing buffer size */
+
+#if defined SIM_ASYNCH_IO
+/* An asynchronous request, performed by an I/O worker pool thread */
+
+struct tape_aio_req {
+    SIM_AIO_REQ         hdr;                /* pool linkage */
+    int                 top;                /* operation */
     uint8               *buf;
     uint32              *bc;
     uint32              *fc;
@@ -176,11 +212,8 @@ struct tape_context {
     uint32              *objupdate;
     TAPE_PCALLBACK      callback;
     t_stat              io_status;
-#endif
     };
-#define tape_ctx up8                        /* Field in Unit structure which points to the tape_context */
 
-#if defined SIM_ASYNCH_IO
 #define AIO_CALLSETUP                                                   \
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;       \
                                                                         \
@@ -189,30 +222,8 @@ if (ctx == NULL)                                                        \
 if ((callback == NULL) || !(ctx->asynch_io))
 
 #define AIO_CALL(op, _buf, _bc, _fc, _max, _vbc, _gaplen, _bpi, _obj, _callback)\
-    if (ctx->asynch_io) {                                               \
-        struct tape_context *ctx =                                      \
-                      (struct tape_context *)uptr->tape_ctx;            \
-                                                                        \
-        pthread_mutex_lock (&ctx->io_lock);                             \
-                                                                        \
-        sim_debug_unit (ctx->dbit, uptr,                                \
-      "sim_tape AIO_CALL(op=%d, unit=%d)\n", op, (int)(uptr-ctx->dptr->units));\
-                                                                        \
-        if (ctx->callback)      /* horrible mistake, stop */            \
-            SIM_SCP_ABORT ("AIO_CALL error");                           \
-        ctx->io_top = op;                                               \
-        ctx->buf = _buf;                                                \
-        ctx->bc = _bc;                                                  \
-        ctx->fc = _fc;                                                  \
-        ctx->max = _max;                                                \
-        ctx->vbc = _vbc;                                                \
-        ctx->gaplen = _gaplen;                                          \
-        ctx->bpi = _bpi;                                                \
-        ctx->objupdate = _obj;                                          \
-        ctx->callback = _callback;                                      \
-        pthread_cond_signal (&ctx->io_cond);                            \
-        pthread_mutex_unlock (&ctx->io_lock);                           \
-        }                                                               \
+    if (ctx->asynch_io)                                                 \
+        _tape_aio_submit (uptr, op, _buf, _bc, _fc, _max, _vbc, _gaplen, _bpi, _obj, _callback);\
     else                                                                \
         if (_callback)                                                  \
             (_callback) (uptr, r);
@@ -235,122 +246,125 @@ if ((callback == NULL) || !(ctx->asynch_io))
 #define TOP_RWND 16             /* sim_tape_rewind_a */
 #define TOP_POSN 17             /* sim_tape_position_a */
 
-static void *
-_tape_io(void *arg)
+/* Queue a request for the I/O worker pool.  Requests for a unit are
+   performed in the order they are submitted. */
+
+static void _tape_aio_submit (UNIT *uptr, int top, uint8 *buf, uint32 *bc, uint32 *fc, uint32 max, uint32 vbc,
+                              uint32 gaplen, uint32 bpi, uint32 *objupdate, TAPE_PCALLBACK callback)
 {
-UNIT* volatile uptr = (UNIT*)arg;
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_aio_req *req = ctx->aio_free;
 
-    /* Boost Priority for this I/O thread vs the CPU instruction execution
-       thread which in general won't be readily yielding the processor when
-       this thread needs to run */
-    sim_os_set_thread_priority (PRIORITY_ABOVE_NORMAL);
+sim_debug_unit (ctx->dbit, uptr, "sim_tape AIO_CALL(op=%d, unit=%d)\n", top, (int)(uptr-ctx->dptr->units));
 
-    sim_debug_unit (ctx->dbit, uptr, "_tape_io(unit=%d) starting\n", (int)(uptr-ctx->dptr->units));
-
-    pthread_mutex_lock (&ctx->io_lock);
-    pthread_cond_signal (&ctx->startup_cond);   /* Signal we're ready to go */
-    while (1) {
-        pthread_cond_wait (&ctx->io_cond, &ctx->io_lock);
-        if (ctx->io_top == TOP_DONE)
-            break;
-        pthread_mutex_unlock (&ctx->io_lock);
-        switch (ctx->io_top) {
-            case TOP_RDRF:
-                ctx->io_status = sim_tape_rdrecf (uptr, ctx->buf, ctx->bc, ctx->max);
-                break;
-            case TOP_RDRR:
-                ctx->io_status = sim_tape_rdrecr (uptr, ctx->buf, ctx->bc, ctx->max);
-                break;
-            case TOP_WREC:
-                ctx->io_status = sim_tape_wrrecf (uptr, ctx->buf, ctx->vbc);
-                break;
-            case TOP_WTMK:
-                ctx->io_status = sim_tape_wrtmk (uptr);
-                break;
-            case TOP_WEOM:
-                ctx->io_status = sim_tape_wreom (uptr);
-                break;
-            case TOP_WEMR:
-                ctx->io_status = sim_tape_wreomrw (uptr);
-                break;
-            case TOP_WGAP:
-                ctx->io_status = sim_tape_wrgap (uptr, ctx->gaplen);
-                break;
-            case TOP_SPRF:
-                ctx->io_status = sim_tape_sprecf (uptr, ctx->bc);
-                break;
-            case TOP_SRSF:
-                ctx->io_status = sim_tape_sprecsf (uptr, ctx->vbc, ctx->bc);
-                break;
-            case TOP_SPRR:
-                ctx->io_status = sim_tape_sprecr (uptr, ctx->bc);
-                break;
-            case TOP_SRSR:
-                ctx->io_status = sim_tape_sprecsr (uptr, ctx->vbc, ctx->bc);
-                break;
-            case TOP_SPFF:
-                ctx->io_status = sim_tape_spfilef (uptr, ctx->vbc, ctx->bc);
-                break;
-            case TOP_SFRF:
-                ctx->io_status = sim_tape_spfilebyrecf (uptr, ctx->vbc, ctx->bc, ctx->fc, ctx->max);
-                break;
-            case TOP_SPFR:
-                ctx->io_status = sim_tape_spfiler (uptr, ctx->vbc, ctx->bc);
-                break;
-            case TOP_SFRR:
-                ctx->io_status = sim_tape_spfilebyrecr (uptr, ctx->vbc, ctx->bc, ctx->fc);
-                break;
-            case TOP_RWND:
-                ctx->io_status = sim_tape_rewind (uptr);
-                break;
-            case TOP_POSN:
-                ctx->io_status = sim_tape_position (uptr, ctx->vbc, ctx->gaplen, ctx->bc, ctx->bpi, ctx->fc, ctx->objupdate);
-                break;
-            }
-        pthread_mutex_lock (&ctx->io_lock);
-        ctx->io_top = TOP_DONE;
-        pthread_cond_signal (&ctx->io_done);
-        sim_activate (uptr, ctx->asynch_io_latency);
+if (req)
+    ctx->aio_free = (struct tape_aio_req *)req->hdr.next;
+else
+    req = (struct tape_aio_req *)malloc (sizeof (*req));
+if (req == NULL) {
+    if (callback)
+        callback (uptr, SCPE_MEM);
+    return;
     }
-    pthread_mutex_unlock (&ctx->io_lock);
+req->top = top;
+req->buf = buf;
+req->bc = bc;
+req->fc = fc;
+req->max = max;
+req->vbc = vbc;
+req->gaplen = gaplen;
+req->bpi = bpi;
+req->objupdate = objupdate;
+req->callback = callback;
+req->io_status = MTSE_OK;
+sim_aio_submit (ctx->aioq, &req->hdr, ctx->asynch_io_latency);
+}
 
-    sim_debug_unit (ctx->dbit, uptr, "_tape_io(unit=%d) exiting\n", (int)(uptr-ctx->dptr->units));
+/* Perform a request.  Called in the context of an I/O worker thread */
 
-    return NULL;
+static void _tape_aio_perform (UNIT *uptr, SIM_AIO_REQ *hdr)
+{
+struct tape_aio_req *req = (struct tape_aio_req *)hdr;
+
+switch (req->top) {
+    case TOP_RDRF:
+        req->io_status = sim_tape_rdrecf (uptr, req->buf, req->bc, req->max);
+        break;
+    case TOP_RDRR:
+        req->io_status = sim_tape_rdrecr (uptr, req->buf, req->bc, req->max);
+        break;
+    case TOP_WREC:
+        req->io_status = sim_tape_wrrecf (uptr, req->buf, req->vbc);
+        break;
+    case TOP_WTMK:
+        req->io_status = sim_tape_wrtmk (uptr);
+        break;
+    case TOP_WEOM:
+        req->io_status = sim_tape_wreom (uptr);
+        break;
+    case TOP_WEMR:
+        req->io_status = sim_tape_wreomrw (uptr);
+        break;
+    case TOP_WGAP:
+        req->io_status = sim_tape_wrgap (uptr, req->gaplen);
+        break;
+    case TOP_SPRF:
+        req->io_status = sim_tape_sprecf (uptr, req->bc);
+        break;
+    case TOP_SRSF:
+        req->io_status = sim_tape_sprecsf (uptr, req->vbc, req->bc);
+        break;
+    case TOP_SPRR:
+        req->io_status = sim_tape_sprecr (uptr, req->bc);
+        break;
+    case TOP_SRSR:
+        req->io_status = sim_tape_sprecsr (uptr, req->vbc, req->bc);
+        break;
+    case TOP_SPFF:
+        req->io_status = sim_tape_spfilef (uptr, req->vbc, req->bc);
+        break;
+    case TOP_SFRF:
+        req->io_status = sim_tape_spfilebyrecf (uptr, req->vbc, req->bc, req->fc, req->max);
+        break;
+    case TOP_SPFR:
+        req->io_status = sim_tape_spfiler (uptr, req->vbc, req->bc);
+        break;
+    case TOP_SFRR:
+        req->io_status = sim_tape_spfilebyrecr (uptr, req->vbc, req->bc, req->fc);
+        break;
+    case TOP_RWND:
+        req->io_status = sim_tape_rewind (uptr);
+        break;
+    case TOP_POSN:
+        req->io_status = sim_tape_position (uptr, req->vbc, req->gaplen, req->bc, req->bpi, req->fc, req->objupdate);
+        break;
+    }
 }
 
 /* This routine is called in the context of the main simulator thread before
-   processing events for any unit. It is only called when an asynchronous
+   processing events for any unit. It is only called when an I/O worker
    thread has called sim_activate() to activate a unit.  The job of this
    routine is to put the unit in proper condition to digest what may have
-   occurred in the asynchronous thread.
+   occurred in the worker threads.
 
-   Since tape processing only handles a single I/O at a time to a
-   particular tape device, we have the opportunity to possibly detect
-   improper attempts to issue multiple concurrent I/O requests. */
+   All requests which have been performed since the unit was activated
+   are completed, in the order they were submitted. */
 static void _tape_completion_dispatch (UNIT *uptr)
 {
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
-TAPE_PCALLBACK callback = ctx->callback;
-
-sim_debug_unit (ctx->dbit, uptr, "_tape_completion_dispatch(unit=%d, top=%d, callback=%p)\n", (int)(uptr-ctx->dptr->units), ctx->io_top, ctx->callback);
-
-if (ctx->io_top != TOP_DONE)
-    SIM_SCP_ABORT ("_tape_completion_dispatch()"); /* horribly wrong, stop */
+struct tape_aio_req *req;
 
-if (ctx->asynch_io)
-    pthread_mutex_lock (&ctx->io_lock);
-
-if (ctx->callback) {
-    ctx->callback = NULL;
-    if (ctx->asynch_io)
-        pthread_mutex_unlock (&ctx->io_lock);
-    callback (uptr, ctx->io_status);
-    }
-else {
-    if (ctx->asynch_io)
-        pthread_mutex_unlock (&ctx->io_lock);
+if ((ctx == NULL) || (ctx->aioq == NULL))
+    return;
+while ((req = (struct tape_aio_req *)sim_aio_complete (ctx->aioq))) {
+    TAPE_PCALLBACK callback = req->callback;
+    t_stat status = req->io_status;
+
+    sim_debug_unit (ctx->dbit, uptr, "_tape_completion_dispatch(unit=%d, top=%d, callback=%p)\n", (int)(uptr-ctx->dptr->units), req->top, callback);
+    req->hdr.next = (SIM_AIO_REQ *)ctx->aio_free;
+    ctx->aio_free = req;
+    if (callback)
+        callback (uptr, status);
     }
 }
 
@@ -358,9 +372,11 @@ static t_bool _tape_is_active (UNIT *uptr)
 {
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 
-if (ctx) {
-    sim_debug_unit (ctx->dbit, uptr, "_tape_is_active(unit=%d, top=%d)\n", (int)(uptr-ctx->dptr->units), ctx->io_top);
-    return (ctx->io_top != TOP_DONE);
+if (ctx && ctx->aioq) {
+    t_bool busy = sim_aio_busy (ctx->aioq);
+
+    sim_debug_unit (ctx->dbit, uptr, "_tape_is_active(unit=%d, busy=%d)\n", (int)(uptr-ctx->dptr->units), busy);
+    return busy;
     }
 return FALSE;
 }
@@ -370,16 +386,33 @@ static t_bool _tape_cancel (UNIT *uptr)
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 
 if (ctx) {
-    sim_debug_unit (ctx->dbit, uptr, "_tape_cancel(unit=%d, top=%d)\n", (int)(uptr-ctx->dptr->units), ctx->io_top);
-    if (ctx->asynch_io) {
-        pthread_mutex_lock (&ctx->io_lock);
-        while (ctx->io_top != TOP_DONE)
-            pthread_cond_wait (&ctx->io_done, &ctx->io_lock);
-        pthread_mutex_unlock (&ctx->io_lock);
-        }
+    sim_debug_unit (ctx->dbit, uptr, "_tape_cancel(unit=%d)\n", (int)(uptr-ctx->dptr->units));
+    if (ctx->aioq)
+        sim_aio_wait (ctx->aioq);
     }
 return FALSE;
 }
+
+/* Release the request queue and any request structures */
+
+static void _tape_aio_free (struct tape_context *ctx)
+{
+struct tape_aio_req *req;
+
+if (ctx->aioq == NULL)
+    return;
+sim_aio_wait (ctx->aioq);
+while ((req = (struct tape_aio_req *)sim_aio_complete (ctx->aioq))) {
+    req->hdr.next = (SIM_AIO_REQ *)ctx->aio_free;
+    ctx->aio_free = req;
+    }
+sim_aio_unitq_free (ctx->aioq);
+ctx->aioq = NULL;
+while ((req = ctx->aio_free)) {
+    ctx->aio_free = (struct tape_aio_req *)req->hdr.next;
+    free (req);
+    }
+}
 #else
 #define AIO_CALLSETUP                                                       \
     if (uptr->tape_ctx == NULL)                                             \
@@ -557,23 +590,13 @@ t_stat sim_tape_set_async (UNIT *uptr, int latency)
 return sim_messagef (SCPE_NOFNC, "Tape: can't operate asynchronously\r\n");
 #else
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
-pthread_attr_t attr;
 
 ctx->asynch_io = sim_asynch_enabled;
 ctx->asynch_io_latency = latency;
-if (ctx->asynch_io) {
-    pthread_mutex_init (&ctx->io_lock, NULL);
-    pthread_cond_init (&ctx->io_cond, NULL);
-    pthread_cond_init (&ctx->io_done, NULL);
-    pthread_cond_init (&ctx->startup_cond, NULL);
-    pthread_attr_init(&attr);
-    pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
-    pthread_mutex_lock (&ctx->io_lock);
-    pthread_create (&ctx->io_thread, &attr, _tape_io, (void *)uptr);
-    pthread_attr_destroy(&attr);
-    pthread_cond_wait (&ctx->startup_cond, &ctx->io_lock); /* Wait for thread to stabilize */
-    pthread_mutex_unlock (&ctx->io_lock);
-    pthread_cond_destroy (&ctx->startup_cond);
+if (ctx->asynch_io && (ctx->aioq == NULL)) {
+    ctx->aioq = sim_aio_unitq_create (uptr, _tape_aio_perform);
+    if (ctx->aioq == NULL)
+        ctx->asynch_io = FALSE;
     }
 uptr->a_check_completion = _tape_completion_dispatch;
 uptr->a_is_active = _tape_is_active;
@@ -595,14 +618,8 @@ struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 if (!ctx) return SCPE_UNATT;
 
 if (ctx->asynch_io) {
-    pthread_mutex_lock (&ctx->io_lock);
     ctx->asynch_io = FALSE;
-    pthread_cond_signal (&ctx->io_cond);
-    pthread_mutex_unlock (&ctx->io_lock);
-    pthread_join (ctx->io_thread, NULL);
-    pthread_mutex_destroy (&ctx->io_lock);
-    pthread_cond_destroy (&ctx->io_cond);
-    pthread_cond_destroy (&ctx->io_done);
+    sim_aio_wait (ctx->aioq);                   /* let outstanding requests finish */
     }
 return SCPE_OK;
 #endif
@@ -627,8 +644,11 @@ sim_tape_clr_async (uptr);
 if (sim_asynch_enabled)
     sim_tape_set_async (uptr, ctx->asynch_io_latency);
 #endif
-if (MT_GET_FMT (uptr) < MTUF_F_ANSI)
+if (MT_GET_FMT (uptr) < MTUF_F_ANSI) {
+    if (sim_tape_wc_flush (uptr))                       /* write any coalesced records */
+        (void)sim_tape_ioerr (uptr);
     fflush (uptr->fileref);
+    }
 }
 
 static const char *_sim_tape_format_name (UNIT *uptr)
@@ -942,6 +962,10 @@ if (sim_switches & SWMASK ('D'))
 uptr->tape_ctx = ctx = (struct tape_context *)calloc(1, sizeof(struct tape_context));
 ctx->dptr = dptr;                                       /* save DEVICE pointer */
 ctx->dbit = dbit;                                       /* save debug bit */
+ctx->perf_read = sim_perf_counter (dptr, "READ", SIM_PERF_BYTES, "Bytes read from tape records");
+ctx->perf_write = sim_perf_counter (dptr, "WRITE", SIM_PERF_BYTES, "Bytes written to tape records");
+ctx->perf_rlat = sim_perf_counter (dptr, "READ LATENCY", SIM_PERF_LATENCY, "Tape record read service time");
+ctx->perf_wlat = sim_perf_counter (dptr, "WRITE LATENCY", SIM_PERF_LATENCY, "Tape record write service time");
 ctx->auto_format = auto_format;                         /* save that we auto selected format */
 
 switch (MT_GET_FMT (uptr)) {                            /* case on format */
@@ -997,6 +1021,7 @@ t_stat sim_tape_detach (UNIT *uptr)
 struct tape_context *ctx;
 uint32 f;
 t_bool auto_format = FALSE;
+t_stat r = SCPE_OK;
 
 if (uptr == NULL)
     return SCPE_IERR;
@@ -1007,12 +1032,18 @@ if (!(uptr->flags & UNIT_ATT))
 ctx = (struct tape_context *)uptr->tape_ctx;
 f = MT_GET_FMT (uptr);
 
+if (sim_tape_wc_sync (uptr) != MTSE_OK)                 /* coalesced records lost? */
+    r = SCPE_IOERR;                                     /*   detach anyway, but say so */
 if (uptr->io_flush)
     uptr->io_flush (uptr);                              /* flush buffered data */
 if (ctx)
     auto_format = ctx->auto_format;
 
 sim_tape_clr_async (uptr);
+#if defined (SIM_ASYNCH_IO)
+if (ctx)
+    _tape_aio_free (ctx);
+#endif
 
 MT_CLR_INMRK (uptr);                                    /* Not within a TAR tapemark */
 if (MT_GET_FMT (uptr) >= MTUF_F_ANSI) {
@@ -1037,6 +1068,10 @@ uptr->pos = 0;
 MT_CLR_PNU (uptr);
 MT_CLR_INMRK (uptr);                                    /* Not within a TAR tapemark */
 free (ctx->chunk_buf);
+free (ctx->ra_buf);
+free (ctx->wc_buf);
+free (ctx->idx);
+free (ctx->idx_tmk);
 free (uptr->tape_ctx);
 uptr->tape_ctx = NULL;
 uptr->io_flush = NULL;
@@ -1053,7 +1088,7 @@ if (uptr->fileref) {                        /* Only close open file */
 uptr->dynflags &= ~UNIT_NO_FIO;
 if (auto_format)    /* format was determined or specified at attach time? */
     sim_tape_set_fmt (uptr, 0, "SIMH", NULL);   /* restore default format */
-return SCPE_OK;
+return r;
 }
 
 t_stat sim_tape_attach_help(FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, const char *cptr)
@@ -1136,20 +1171,495 @@ if (sim_deb && ((uptr->dctrl | ctx->dptr->dctrl) & reason))
     sim_data_trace(ctx->dptr, uptr, (detail ? data : NULL), "", len, txt, reason);
 }
 
+/* Streaming read-ahead and write coalescing (internal routines).
+
+   Forward reads and spacing of SIMH, E11, TPC and AWS tape images are served
+   from a per-unit read-ahead window which holds a large, contiguous piece of
+   the container file.  Record metadata and data are parsed directly from the
+   window, so reading or spacing over a record which lies within the window
+   needs no file system calls at all.  Anything the fast path does not handle
+   (erase gaps, EOM markers, inconsistent record lengths, records larger than
+   the window, ...) falls back to the element-at-a-time logic in
+   sim_tape_rdlntf, which is the authority on all error cases.
+
+   The window is keyed by container offset, so reverse motion and positioning
+   leave it usable (a backspace and re-read is served from memory), while any
+   write to the container invalidates it.
+
+   Consecutive sim_tape_wrrecf calls on SIMH and E11 images are coalesced into
+   a write buffer which is written with a single sim_fwrite when a record that
+   is not contiguous with the buffered data is written, the buffer fills, the
+   container is repositioned by any other operation (see sim_tape_seek), or
+   the unit is flushed or detached.  Every operation which returns a status
+   (reads, spacing, tape marks, rewind, positioning and detach) first writes
+   out any coalesced records, so a failure to write them is reported by that
+   operation rather than by some later, unrelated one.
+*/
+
+static void sim_tape_ra_invalidate (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+
+if (ctx == NULL)
+    return;
+ctx->ra_len = 0;
+ctx->ra_data = NULL;
+}
+
+static t_stat sim_tape_wc_flush (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+size_t xfer;
+uint32 len;
+
+if ((ctx == NULL) || (ctx->wc_len == 0))
+    return MTSE_OK;
+xfer = 0;
+errno = 0;
+if (sim_fseek (uptr->fileref, ctx->wc_pos, SEEK_SET) == 0)
+    xfer = sim_fwrite (ctx->wc_buf, 1, ctx->wc_len, uptr->fileref);
+sim_debug_unit (MTSE_DBG_STR, uptr, "wc_flush: %u bytes at pos: %" T_ADDR_FMT "u\n", ctx->wc_len, ctx->wc_pos);
+len = ctx->wc_len;
+ctx->wc_len = 0;
+if (xfer != len) {                                      /* short write? */
+    if (errno == 0)                                     /* with no reason given? */
+        errno = EIO;
+    return MTSE_IOERR;
+    }
+return MTSE_OK;
+}
+
+/* Write out coalesced records, reporting any failure as an I/O error */
+
+static t_stat sim_tape_wc_sync (UNIT *uptr)
+{
+if ((MT_GET_FMT (uptr) < MTUF_F_ANSI) && sim_tape_wc_flush (uptr))
+    return sim_tape_ioerr (uptr);
+return MTSE_OK;
+}
+
+/* Make sure that the len bytes at container offset pos are present in the
+   read-ahead window, refilling the window from pos if necessary.  Returns
+   FALSE if they can't be (EOF, I/O error, larger than the window, or there
+   are coalesced writes which haven't been written out yet). */
+
+static t_bool sim_tape_ra_fill (UNIT *uptr, t_addr pos, uint32 len)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+
+if ((pos >= ctx->ra_pos) &&
+    ((pos + len) <= (ctx->ra_pos + ctx->ra_len)))
+    return TRUE;
+if ((len > TAPE_RA_SIZE) ||
+    (ctx->wc_len != 0))                                 /* pending writes are the slow path's job */
+    return FALSE;
+if (ctx->ra_buf == NULL) {
+    ctx->ra_buf = (uint8 *)malloc (TAPE_RA_SIZE);
+    if (ctx->ra_buf == NULL)
+        return FALSE;
+    }
+ctx->ra_len = 0;
+ctx->ra_pos = pos;
+if (sim_fseek (uptr->fileref, pos, SEEK_SET)) {
+    clearerr (uptr->fileref);
+    return FALSE;
+    }
+ctx->ra_len = (uint32)sim_fread (ctx->ra_buf, 1, TAPE_RA_SIZE, uptr->fileref);
+if (ferror (uptr->fileref)) {                           /* let the slow path report it */
+    clearerr (uptr->fileref);
+    ctx->ra_len = 0;
+    }
+sim_debug_unit (MTSE_DBG_STR, uptr, "ra_fill: %u bytes at pos: %" T_ADDR_FMT "u\n", ctx->ra_len, pos);
+return (len <= ctx->ra_len);
+}
+
+/* Read record length forward from the read-ahead window.
+
+   Returns TRUE, with the status, record length and updated position exactly
+   as sim_tape_rdlntf would have produced them, when the object at the current
+   position is a tape mark or a well formed data record which lies entirely in
+   the window.  For data records, ctx->ra_data then points at the record data.
+   Returns FALSE, with the position unchanged, otherwise.
+*/
+
+static t_bool sim_tape_ra_lntf (UNIT *uptr, t_mtrlnt *bc, t_stat *status)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+uint32   f = MT_GET_FMT (uptr);
+t_addr   pos = uptr->pos;
+uint8    *p;
+t_mtrlnt lnt, rev_lnt;
+uint32   sbc, dlen;
+t_tpclnt tpcbc;
+t_awshdr hdr, nxthdr;
+
+ctx->ra_data = NULL;
+if ((uptr->tape_eom > 0) &&
+    (pos >= uptr->tape_eom))
+    return FALSE;
+switch (f) {
+
+    case MTUF_F_STD:
+    case MTUF_F_E11:
+        if (!sim_tape_ra_fill (uptr, pos, sizeof (t_mtrlnt)))
+            return FALSE;
+        memcpy (&lnt, ctx->ra_buf + (size_t)(pos - ctx->ra_pos), sizeof (lnt));
+        if (lnt == MTR_TMK) {
+            *bc = 0;
+            *status = MTSE_TMK;
+            uptr->pos = pos + sizeof (t_mtrlnt);
+            break;
+            }
+        if ((lnt == MTR_EOM) || (lnt == MTR_GAP) || (lnt == MTR_FHGAP))
+            return FALSE;
+        sbc = MTR_L (lnt);
+        dlen = (f == MTUF_F_STD) ? ((sbc + 1) & ~1) : sbc;
+        if ((dlen > TAPE_RA_SIZE) ||
+            !sim_tape_ra_fill (uptr, pos, dlen + 2 * sizeof (t_mtrlnt)))
+            return FALSE;
+        p = ctx->ra_buf + (size_t)(pos - ctx->ra_pos);
+        memcpy (&rev_lnt, p + sizeof (t_mtrlnt) + dlen, sizeof (rev_lnt));
+        if (rev_lnt != lnt)
+            return FALSE;
+        ctx->ra_data = p + sizeof (t_mtrlnt);
+        *bc = lnt;
+        *status = MTSE_OK;
+        uptr->pos = pos + dlen + 2 * sizeof (t_mtrlnt);
+        break;
+
+    case MTUF_F_TPC:
+        if (!sim_tape_ra_fill (uptr, pos, sizeof (t_tpclnt)))
+            return FALSE;
+        memcpy (&tpcbc, ctx->ra_buf + (size_t)(pos - ctx->ra_pos), sizeof (tpcbc));
+        if (tpcbc == TPC_EOM)
+            return FALSE;
+        if (tpcbc == TPC_TMK) {
+            *bc = 0;
+            *status = MTSE_TMK;
+            uptr->pos = pos + sizeof (t_tpclnt);
+            break;
+            }
+        if (!sim_tape_ra_fill (uptr, pos, tpcbc + sizeof (t_tpclnt)))
+            return FALSE;
+        ctx->ra_data = ctx->ra_buf + (size_t)(pos - ctx->ra_pos) + sizeof (t_tpclnt);
+        *bc = (t_mtrlnt)tpcbc;
+        *status = MTSE_OK;
+        uptr->pos = pos + sizeof (t_tpclnt) + ((tpcbc + 1) & ~1);
+        break;
+
+    case MTUF_F_AWS:
+        if (!sim_tape_ra_fill (uptr, pos, sizeof (t_awshdr)))
+            return FALSE;
+        memcpy (&hdr, ctx->ra_buf + (size_t)(pos - ctx->ra_pos), sizeof (hdr));
+        if ((hdr.rectyp != AWS_REC) && (hdr.rectyp != AWS_TMK))
+            return FALSE;
+        if (!sim_tape_ra_fill (uptr, pos, hdr.nxtlen + 2 * sizeof (t_awshdr)))
+            return FALSE;                               /* following header must be present */
+        p = ctx->ra_buf + (size_t)(pos - ctx->ra_pos);
+        memcpy (&nxthdr, p + sizeof (t_awshdr) + hdr.nxtlen, sizeof (nxthdr));
+        if ((nxthdr.prelen != hdr.nxtlen) ||
+            ((nxthdr.rectyp != AWS_REC) && (nxthdr.rectyp != AWS_TMK)))
+            return FALSE;
+        ctx->ra_data = p + sizeof (t_awshdr);
+        *bc = (t_mtrlnt)hdr.nxtlen;
+        *status = (hdr.rectyp == AWS_TMK) ? MTSE_TMK : MTSE_OK;
+        uptr->pos = pos + sizeof (t_awshdr) + hdr.nxtlen;
+        break;
+
+    default:
+        return FALSE;
+        }
+MT_CLR_PNU (uptr);
+return TRUE;
+}
+
+/* Write a SIMH or E11 format data record through the write coalescing buffer */
+
+static int sim_tape_wc_write (UNIT *uptr, t_mtrlnt bc, const uint8 *buf, t_mtrlnt sbc)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+uint32 len = sbc + 2 * sizeof (t_mtrlnt);
+uint8 *p;
+
+if ((ctx->wc_len > 0) &&                                /* pending data which can't be extended? */
+    (((ctx->wc_pos + ctx->wc_len) != uptr->pos) ||
+     ((ctx->wc_len + len) > TAPE_WC_SIZE))) {
+    if (sim_tape_wc_flush (uptr))
+        return -1;
+    }
+if ((ctx->wc_buf == NULL) && (len <= TAPE_WC_SIZE))
+    ctx->wc_buf = (uint8 *)malloc (TAPE_WC_SIZE);
+if ((ctx->wc_buf == NULL) || (len > TAPE_WC_SIZE)) {    /* write directly */
+    if (sim_tape_seek (uptr, uptr->pos))
+        return -1;
+    (void)sim_fwrite (&bc, sizeof (t_mtrlnt), 1, uptr->fileref);
+    (void)sim_fwrite ((void *)buf, sizeof (uint8), sbc, uptr->fileref);
+    (void)sim_fwrite (&bc, sizeof (t_mtrlnt), 1, uptr->fileref);
+    return ferror (uptr->fileref) ? -1 : 0;
+    }
+if (ctx->wc_len == 0)
+    ctx->wc_pos = uptr->pos;
+p = ctx->wc_buf + ctx->wc_len;
+memcpy (p, &bc, sizeof (t_mtrlnt));
+memcpy (p + sizeof (t_mtrlnt), buf, sbc);
+memcpy (p + sizeof (t_mtrlnt) + sbc, &bc, sizeof (t_mtrlnt));
+ctx->wc_len += len;
+return 0;
+}
+
 static int sim_tape_seek (UNIT *uptr, t_addr pos)
 {
-if (MT_GET_FMT (uptr) < MTUF_F_ANSI)
+if (MT_GET_FMT (uptr) < MTUF_F_ANSI) {
+    if (sim_tape_wc_flush (uptr))                       /* coalesced writes go out first */
+        return -1;
     return sim_fseek (uptr->fileref, pos, SEEK_SET);
+    }
 return 0;
 }
 
 static t_offset sim_tape_size (UNIT *uptr)
 {
-if (MT_GET_FMT (uptr) < MTUF_F_ANSI)
+if (MT_GET_FMT (uptr) < MTUF_F_ANSI) {
+    (void)sim_tape_wc_flush (uptr);
     return sim_fsize_ex (uptr->fileref); /* True on-disk tape images: file size  */
+    }
 return uptr->tape_eom;                   /* Virtual tape images: record/TM count */
 }
 
+/* Record/tape mark index (internal routines).
+
+   Each SIMH, E11, TPC or AWS tape image has an in-memory index of the objects
+   (data records and tape marks) found in the contiguous, gap free region which
+   starts at BOT.  The index is built lazily: every forward read or space which
+   starts at the end of the indexed region and encounters a well formed object
+   extends it.  Since the attach time validation pass reads the entire image,
+   the index normally covers the whole tape as soon as it is attached.
+
+   Writes keep the index current: anything at or beyond the write position is
+   discarded and the newly written record or tape mark is appended.  Erase gaps,
+   EOM markers and malformed records simply end the indexed region; motion
+   beyond it uses the element-at-a-time logic, which is the authority on all
+   error cases.
+
+   sim_tape_sprecsf and sim_tape_sprecsr (and therefore the space file and
+   sim_tape_position routines layered on them) use the index to jump directly
+   to the target object, locating the next/previous tape mark by binary search,
+   so positioning to file N of a large multi-file image no longer touches the
+   container at all.
+*/
+
+static t_addr sim_tape_idx_objsize (UNIT *uptr, t_stat st, t_mtrlnt bc)
+{
+t_mtrlnt sbc = MTR_L (bc);
+
+switch (MT_GET_FMT (uptr)) {
+    case MTUF_F_STD:
+        return (st == MTSE_TMK) ? sizeof (t_mtrlnt) : ((sbc + 1) & ~1) + 2 * sizeof (t_mtrlnt);
+    case MTUF_F_E11:
+        return (st == MTSE_TMK) ? sizeof (t_mtrlnt) : sbc + 2 * sizeof (t_mtrlnt);
+    case MTUF_F_TPC:
+        return (st == MTSE_TMK) ? sizeof (t_tpclnt) : ((bc + 1) & ~1) + sizeof (t_tpclnt);
+    case MTUF_F_AWS:
+        if ((st == MTSE_TMK) != (bc == 0))      /* reads differently in reverse */
+            return 0;
+        return bc + sizeof (t_awshdr);
+    default:
+        return 0;                               /* format not indexed */
+        }
+}
+
+/* Return the number of index entries whose position is <= pos */
+
+static uint32 sim_tape_idx_upper (struct tape_context *ctx, t_addr pos)
+{
+uint32 lo = 0, hi = ctx->idx_count;
+
+while (lo < hi) {
+    uint32 mid = lo + (hi - lo) / 2;
+
+    if (ctx->idx[mid].pos <= pos)
+        lo = mid + 1;
+    else
+        hi = mid;
+    }
+return lo;
+}
+
+/* Return the number of indexed tape marks whose index number is < obj */
+
+static uint32 sim_tape_idx_tmk_lower (struct tape_context *ctx, uint32 obj)
+{
+uint32 lo = 0, hi = ctx->idx_tmk_count;
+
+while (lo < hi) {
+    uint32 mid = lo + (hi - lo) / 2;
+
+    if (ctx->idx_tmk[mid] < obj)
+        lo = mid + 1;
+    else
+        hi = mid;
+    }
+return lo;
+}
+
+/* Locate the object which starts at pos (idx_count if pos is the end of the
+   indexed region).  Returns FALSE if pos is not an object boundary. */
+
+static t_bool sim_tape_idx_find (struct tape_context *ctx, t_addr pos, uint32 *obj)
+{
+uint32 n;
+
+if (ctx->idx_count == 0)
+    return FALSE;
+if (pos == ctx->idx_end) {
+    *obj = ctx->idx_count;
+    return TRUE;
+    }
+n = sim_tape_idx_upper (ctx, pos);
+if ((n == 0) || (ctx->idx[n - 1].pos != pos))
+    return FALSE;
+*obj = n - 1;
+return TRUE;
+}
+
+/* Discard every indexed object which occupies any part of the container at or
+   beyond pos (i.e. which a write at pos will damage). */
+
+static void sim_tape_idx_truncate (UNIT *uptr, t_addr pos)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+uint32 n;
+
+if ((ctx == NULL) || (pos >= ctx->idx_end))
+    return;
+n = sim_tape_idx_upper (ctx, pos);
+if (n > 0)                                      /* object containing pos goes too */
+    --n;
+ctx->idx_count = n;
+ctx->idx_end = (n > 0) ? ctx->idx[n].pos : 0;
+ctx->idx_tmk_count = sim_tape_idx_tmk_lower (ctx, n);
+sim_debug_unit (MTSE_DBG_POS, uptr, "idx_truncate: %u objects, end: %" T_ADDR_FMT "u\n", n, ctx->idx_end);
+}
+
+/* Record the object from pos to end, if it extends the indexed region */
+
+static void sim_tape_idx_add (UNIT *uptr, t_addr pos, t_stat st, t_mtrlnt bc, t_addr end)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+t_addr size;
+
+if ((ctx == NULL) ||
+    (pos != ctx->idx_end) ||
+    ((st != MTSE_OK) && (st != MTSE_TMK)))
+    return;
+size = sim_tape_idx_objsize (uptr, st, bc);
+if ((size == 0) || (end != pos + size))         /* not indexed or gap skipped? */
+    return;
+if (ctx->idx_count == ctx->idx_size) {
+    uint32 new_size = ctx->idx_size ? 2 * ctx->idx_size : 1024;
+    TAPE_INDEX *idx = (TAPE_INDEX *)realloc (ctx->idx, new_size * sizeof (*idx));
+
+    if (idx == NULL)
+        return;
+    ctx->idx = idx;
+    ctx->idx_size = new_size;
+    }
+if (st == MTSE_TMK) {
+    if (ctx->idx_tmk_count == ctx->idx_tmk_size) {
+        uint32 new_size = ctx->idx_tmk_size ? 2 * ctx->idx_tmk_size : 64;
+        uint32 *tmk = (uint32 *)realloc (ctx->idx_tmk, new_size * sizeof (*tmk));
+
+        if (tmk == NULL)
+            return;
+        ctx->idx_tmk = tmk;
+        ctx->idx_tmk_size = new_size;
+        }
+    ctx->idx_tmk[ctx->idx_tmk_count++] = ctx->idx_count;
+    }
+ctx->idx[ctx->idx_count].pos = pos;
+ctx->idx[ctx->idx_count].bc = bc;
+++ctx->idx_count;
+ctx->idx_end = end;
+}
+
+/* Space up to count records forward using the index.
+
+   Returns TRUE if the current position is within the indexed region.  *skipped
+   and *st are then exactly what sim_tape_sprecsf would have produced, except
+   that when the indexed region ends before count records or a tape mark are
+   seen, *st is MTSE_OK with *skipped < count and the caller must continue
+   from the (updated) position with the unindexed logic.
+*/
+
+static t_bool sim_tape_idx_spacef (UNIT *uptr, uint32 count, uint32 *skipped, t_stat *st)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+uint32 obj, tmk, avail, target;
+
+if (((uptr->tape_eom > 0) && (ctx->idx_end > uptr->tape_eom)) ||
+    !sim_tape_idx_find (ctx, uptr->pos, &obj) ||
+    (obj == ctx->idx_count))
+    return FALSE;
+tmk = sim_tape_idx_tmk_lower (ctx, obj);        /* next tape mark at or after obj */
+tmk = (tmk < ctx->idx_tmk_count) ? ctx->idx_tmk[tmk] : ctx->idx_count;
+avail = tmk - obj;                              /* records before it */
+if (count <= avail) {
+    *skipped = count;
+    *st = MTSE_OK;
+    target = obj + count;
+    }
+else {
+    *skipped = avail;
+    if (tmk < ctx->idx_count) {                 /* stopped by the tape mark */
+        *st = MTSE_TMK;
+        target = tmk + 1;
+        }
+    else {                                      /* ran off the indexed region */
+        *st = MTSE_OK;
+        target = ctx->idx_count;
+        }
+    }
+uptr->pos = (target < ctx->idx_count) ? ctx->idx[target].pos : ctx->idx_end;
+MT_CLR_PNU (uptr);
+sim_debug_unit (MTSE_DBG_POS, uptr, "idx_spacef: from object %u, skipped %u, st: %d, pos: %" T_ADDR_FMT "u\n", obj, *skipped, *st, uptr->pos);
+return TRUE;
+}
+
+/* Space up to count records reverse using the index (see sim_tape_idx_spacef) */
+
+static t_bool sim_tape_idx_spacer (UNIT *uptr, uint32 count, uint32 *skipped, t_stat *st)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+uint32 obj, tmk, first, target;
+
+if (MT_TST_PNU (uptr) ||                        /* sim_tape_sprecr handles this case */
+    ((uptr->tape_eom > 0) && (uptr->pos >= uptr->tape_eom)) ||
+    !sim_tape_idx_find (ctx, uptr->pos, &obj) ||
+    (obj == 0))
+    return FALSE;
+tmk = sim_tape_idx_tmk_lower (ctx, obj);        /* tape marks before obj */
+first = (tmk > 0) ? ctx->idx_tmk[tmk - 1] + 1 : 0;/* first record after the previous tape mark */
+if (count <= obj - first) {
+    *skipped = count;
+    *st = MTSE_OK;
+    target = obj - count;
+    }
+else {
+    *skipped = obj - first;
+    if (tmk > 0) {                              /* stopped by the tape mark */
+        *st = MTSE_TMK;
+        target = first - 1;
+        }
+    else {                                      /* reached BOT */
+        *st = MTSE_OK;
+        target = 0;
+        }
+    }
+uptr->pos = ctx->idx[target].pos;
+sim_debug_unit (MTSE_DBG_POS, uptr, "idx_spacer: from object %u, skipped %u, st: %d, pos: %" T_ADDR_FMT "u\n", obj, *skipped, *st, uptr->pos);
+return TRUE;
+}
+
 /* Read record length forward (internal routine).
 
    Inputs:
@@ -1564,13 +2074,22 @@ return status;
 static t_stat sim_tape_rdrlfwd (UNIT *uptr, t_mtrlnt *bc)
 {
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+t_addr opos;
 t_stat status;
 
 *bc = 0;
 if (ctx == NULL)                                        /* if not properly attached? */
     return sim_messagef (SCPE_IERR, "Bad Attach\n");    /*   that's a problem */
 
-status = sim_tape_rdlntf (uptr, bc);                    /* read the record length */
+status = sim_tape_wc_sync (uptr);                       /* write out coalesced records */
+if (status != MTSE_OK) {
+    MT_SET_PNU (uptr);
+    return status;
+    }
+opos = uptr->pos;
+if (!sim_tape_ra_lntf (uptr, bc, &status))             /* not served from the read-ahead window? */
+    status = sim_tape_rdlntf (uptr, bc);                /*   read the record length */
+sim_tape_idx_add (uptr, opos, status, *bc, uptr->pos);  /* extend the index */
 
 sim_debug_unit (MTSE_DBG_STR, uptr, "rd_lntf: st: %d, lnt: %d, pos: %" T_ADDR_FMT "u\n", status, *bc, uptr->pos);
 
@@ -1903,6 +2422,11 @@ t_stat status;
 if (ctx == NULL)                                        /* if not properly attached? */
     return sim_messagef (SCPE_IERR, "Bad Attach\n");    /*   that's a problem */
 
+status = sim_tape_wc_sync (uptr);                       /* write out coalesced records */
+if (status != MTSE_OK) {
+    MT_SET_PNU (uptr);
+    return status;
+    }
 status = sim_tape_rdlntr (uptr, bc);                    /* read the record length */
 
 sim_debug_unit (MTSE_DBG_STR, uptr, "rd_lntr: st: %d, lnt: %d, pos: %" T_ADDR_FMT "u\n", status, *bc, uptr->pos);
@@ -1931,7 +2455,7 @@ return status;
    data record error    updated
 */
 
-t_stat sim_tape_rdrecf (UNIT *uptr, uint8 *buf, t_mtrlnt *bc, t_mtrlnt max)
+static t_stat _sim_tape_rdrecf (UNIT *uptr, uint8 *buf, t_mtrlnt *bc, t_mtrlnt max)
 {
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 uint32 f = MT_GET_FMT (uptr);
@@ -1969,14 +2493,14 @@ if (rbc > max) {                                        /* rec out of range? */
         ctx->chunk_data_size = ctx->chunk_offset = 0;
         uptr->pos = opos;
         /* Fill the chunk buffer */
-        st = sim_tape_rdrecf (uptr, ctx->chunk_buf, &ctx->chunk_data_size, ctx->chunk_buf_size);
+        st = _sim_tape_rdrecf (uptr, ctx->chunk_buf, &ctx->chunk_data_size, ctx->chunk_buf_size);
         if (st != MTSE_OK) {
             MT_SET_PNU (uptr);
             uptr->pos = opos;
             return st;
             }
         /* return the first chunk */
-        return sim_tape_rdrecf (uptr, buf, bc, max);
+        return _sim_tape_rdrecf (uptr, buf, bc, max);
         }
     else {
         MT_SET_PNU (uptr);
@@ -1984,7 +2508,11 @@ if (rbc > max) {                                        /* rec out of range? */
         return MTSE_INVRL;
         }
     }
-if (f < MTUF_F_ANSI) {
+if ((f < MTUF_F_ANSI) && (ctx->ra_data != NULL)) {      /* record is in the read-ahead window? */
+    memcpy (buf, ctx->ra_data, rbc);
+    i = rbc;
+    }
+else if (f < MTUF_F_ANSI) {
     i = (t_mtrlnt) sim_fread (buf, sizeof (uint8), rbc, uptr->fileref); /* read record */
     if (ferror (uptr->fileref)) {                           /* error? */
         MT_SET_PNU (uptr);
@@ -2006,6 +2534,19 @@ sim_tape_data_trace(uptr, buf, rbc, "Record Read", (uptr->dctrl | ctx->dptr->dct
 return (MTR_F (tbc)? MTSE_RECE: MTSE_OK);
 }
 
+t_stat sim_tape_rdrecf (UNIT *uptr, uint8 *buf, t_mtrlnt *bc, t_mtrlnt max)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+double start = SIM_PERF_START ();
+t_stat st = _sim_tape_rdrecf (uptr, buf, bc, max);
+
+if ((start != 0.0) && (ctx != NULL)) {                  /* performance counters enabled? */
+    sim_perf_add (ctx->perf_read, *bc);
+    sim_perf_latency (ctx->perf_rlat, start);
+    }
+return st;
+}
+
 t_stat sim_tape_rdrecf_a (UNIT *uptr, uint8 *buf, t_mtrlnt *bc, t_mtrlnt max, TAPE_PCALLBACK callback)
 {
 t_stat r = SCPE_OK;
@@ -2038,7 +2579,7 @@ return r;
    data record error    updated
 */
 
-t_stat sim_tape_rdrecr (UNIT *uptr, uint8 *buf, t_mtrlnt *bc, t_mtrlnt max)
+static t_stat _sim_tape_rdrecr (UNIT *uptr, uint8 *buf, t_mtrlnt *bc, t_mtrlnt max)
 {
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 uint32 f = MT_GET_FMT (uptr);
@@ -2078,6 +2619,19 @@ sim_tape_data_trace(uptr, buf, rbc, "Record Read Reverse", (uptr->dctrl | ctx->d
 return (MTR_F (tbc)? MTSE_RECE: MTSE_OK);
 }
 
+t_stat sim_tape_rdrecr (UNIT *uptr, uint8 *buf, t_mtrlnt *bc, t_mtrlnt max)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+double start = SIM_PERF_START ();
+t_stat st = _sim_tape_rdrecr (uptr, buf, bc, max);
+
+if ((start != 0.0) && (ctx != NULL)) {                  /* performance counters enabled? */
+    sim_perf_add (ctx->perf_read, *bc);
+    sim_perf_latency (ctx->perf_rlat, start);
+    }
+return st;
+}
+
 t_stat sim_tape_rdrecr_a (UNIT *uptr, uint8 *buf, t_mtrlnt *bc, t_mtrlnt max, TAPE_PCALLBACK callback)
 {
 t_stat r = SCPE_OK;
@@ -2104,11 +2658,12 @@ return r;
    data record          updated
 */
 
-t_stat sim_tape_wrrecf (UNIT *uptr, uint8 *buf, t_mtrlnt bc)
+static t_stat _sim_tape_wrrecf (UNIT *uptr, uint8 *buf, t_mtrlnt bc)
 {
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 uint32 f = MT_GET_FMT (uptr);
 t_mtrlnt sbc;
+t_addr opos;
 t_stat status = MTSE_OK;
 
 if (ctx == NULL)                                        /* if not properly attached? */
@@ -2124,18 +2679,16 @@ if (sim_tape_wrp (uptr))                                /* write prot? */
     return MTSE_WRP;
 if (sbc == 0)                                           /* nothing to do? */
     return MTSE_OK;
-if (sim_tape_seek (uptr, uptr->pos))                    /* set pos */
-    return MTSE_IOERR;
+sim_tape_ra_invalidate (uptr);                          /* read-ahead data is now stale */
+sim_tape_idx_truncate (uptr, uptr->pos);                /* as is any index beyond here */
+opos = uptr->pos;
 switch (f) {                                            /* case on format */
 
     case MTUF_F_STD:                                    /* standard */
         sbc = MTR_L ((bc + 1) & ~1);                    /* pad odd length */
         /* fall through into the E11 handler */
     case MTUF_F_E11:                                    /* E11 */
-        (void)sim_fwrite (&bc, sizeof (t_mtrlnt), 1, uptr->fileref);
-        (void)sim_fwrite (buf, sizeof (uint8), sbc, uptr->fileref);
-        (void)sim_fwrite (&bc, sizeof (t_mtrlnt), 1, uptr->fileref);
-        if (ferror (uptr->fileref)) {                   /* error? */
+        if (sim_tape_wc_write (uptr, bc, buf, sbc)) {   /* coalesce; error? */
             MT_SET_PNU (uptr);
             return sim_tape_ioerr (uptr);
             }
@@ -2143,6 +2696,8 @@ switch (f) {                                            /* case on format */
         break;
 
     case MTUF_F_P7B:                                    /* Pierce 7B */
+        if (sim_tape_seek (uptr, uptr->pos))            /* set pos */
+            return MTSE_IOERR;
         buf[0] = buf[0] | P7B_SOR;                      /* mark start of rec */
         (void)sim_fwrite (buf, sizeof (uint8), sbc, uptr->fileref);
         (void)sim_fwrite (buf, sizeof (uint8), 1, uptr->fileref); /* delimit rec */
@@ -2158,12 +2713,27 @@ switch (f) {                                            /* case on format */
             return status;
         break;
         }
+if (f != MTUF_F_AWS)                                    /* (AWS indexed by sim_tape_aws_wrdata) */
+    sim_tape_idx_add (uptr, opos, MTSE_OK, bc, uptr->pos);
 if (uptr->pos > uptr->tape_eom)
     uptr->tape_eom = uptr->pos;         /* update EOM as needed */
 sim_tape_data_trace(uptr, buf, sbc, "Record Written", (uptr->dctrl | ctx->dptr->dctrl) & MTSE_DBG_DAT, MTSE_DBG_STR);
 return MTSE_OK;
 }
 
+t_stat sim_tape_wrrecf (UNIT *uptr, uint8 *buf, t_mtrlnt bc)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+double start = SIM_PERF_START ();
+t_stat st = _sim_tape_wrrecf (uptr, buf, bc);
+
+if ((start != 0.0) && (ctx != NULL)) {                  /* performance counters enabled? */
+    sim_perf_add (ctx->perf_write, (st == MTSE_OK) ? bc : 0);
+    sim_perf_latency (ctx->perf_wlat, start);
+    }
+return st;
+}
+
 t_stat sim_tape_wrrecf_a (UNIT *uptr, uint8 *buf, t_mtrlnt bc, TAPE_PCALLBACK callback)
 {
 t_stat r = SCPE_OK;
@@ -2180,7 +2750,10 @@ static t_stat sim_tape_aws_wrdata (UNIT *uptr, uint8 *buf, t_mtrlnt bc)
 t_awshdr awshdr;
 size_t   rdcnt;
 t_bool   replacing_record;
+t_addr   opos = uptr->pos;
 
+sim_tape_ra_invalidate (uptr);              /* read-ahead data is now stale */
+sim_tape_idx_truncate (uptr, uptr->pos);    /* as is any index beyond here */
 memset (&awshdr, 0, sizeof (t_awshdr));
 if (sim_tape_seek (uptr, uptr->pos))        /* set pos */
     return MTSE_IOERR;
@@ -2212,6 +2785,7 @@ if ((!replacing_record) || (bc == 0)) {
     if (!replacing_record)
         sim_set_fsize (uptr->fileref, uptr->pos + sizeof (awshdr));
     }
+sim_tape_idx_add (uptr, opos, bc ? MTSE_OK : MTSE_TMK, bc, uptr->pos);
 if (uptr->pos > uptr->tape_eom)
     uptr->tape_eom = uptr->pos;                     /* Update EOM if we're there */
 return MTSE_OK;
@@ -2230,13 +2804,20 @@ if (ctx == NULL)                                        /* if not properly attac
     return sim_messagef (SCPE_IERR, "Bad Attach\n");    /*   that's a problem */
 if (sim_tape_wrp (uptr))                                /* write prot? */
     return MTSE_WRP;
-(void)sim_tape_seek (uptr, uptr->pos);                  /* set pos */
+sim_tape_ra_invalidate (uptr);                          /* read-ahead data is now stale */
+sim_tape_idx_truncate (uptr, uptr->pos);                /* as is any index beyond here */
+if (sim_tape_seek (uptr, uptr->pos)) {                  /* set pos; coalesced writes failed? */
+    MT_SET_PNU (uptr);
+    return sim_tape_ioerr (uptr);
+    }
 (void)sim_fwrite (&dat, sizeof (t_mtrlnt), 1, uptr->fileref);
 if (ferror (uptr->fileref)) {                           /* error? */
     MT_SET_PNU (uptr);
     return sim_tape_ioerr (uptr);
     }
 sim_debug_unit (MTSE_DBG_STR, uptr, "wr_lnt: lnt: %d, pos: %" T_ADDR_FMT "u\n", dat, uptr->pos);
+if (dat == MTR_TMK)
+    sim_tape_idx_add (uptr, uptr->pos, MTSE_TMK, 0, uptr->pos + sizeof (t_mtrlnt));
 uptr->pos = uptr->pos + sizeof (t_mtrlnt);              /* move tape */
 if (uptr->pos > uptr->tape_eom)
     uptr->tape_eom = uptr->pos;                         /* update EOM */
@@ -2285,6 +2866,8 @@ if (sim_tape_wrp (uptr))                                /* write prot? */
 if (MT_GET_FMT (uptr) == MTUF_F_P7B)                    /* cant do P7B */
     return MTSE_FMT;
 if (MT_GET_FMT (uptr) == MTUF_F_AWS) {
+    sim_tape_ra_invalidate (uptr);                      /* read-ahead data is now stale */
+    sim_tape_idx_truncate (uptr, uptr->pos);            /* as is any index beyond here */
     sim_set_fsize (uptr->fileref, uptr->pos);
     result = MTSE_OK;
     }
@@ -2450,7 +3033,9 @@ else if (sim_tape_wrp (uptr))                           /* otherwise if the unit
 else if (gap_size == 0 || format != MTUF_F_STD)         /* otherwise if zero length or gaps aren't supported */
     return MTSE_OK;                                     /*   then take no action */
 
-file_size = sim_fsize (uptr->fileref);                  /* get the file size */
+sim_tape_ra_invalidate (uptr);                          /* read-ahead data is about to become stale */
+sim_tape_idx_truncate (uptr, uptr->pos);                /* as is any index beyond here */
+file_size = (uint32)sim_tape_size (uptr);               /* get the file size */
 
 if (sim_tape_seek (uptr, uptr->pos)) {                  /* position the tape; if it fails */
     MT_SET_PNU (uptr);                                  /*   then set position not updated */
@@ -2650,6 +3235,7 @@ else if (sim_tape_wrp (uptr))                           /* otherwise if the unit
 else if ((gap_size == 0) || (format != MTUF_F_STD))     /* otherwise if the gap length is zero or unsupported */
     return MTSE_OK;                                     /*   then take no action */
 
+sim_tape_ra_invalidate (uptr);                          /* read-ahead data is about to become stale */
 gap_pos = uptr->pos;                                    /* save the starting position */
 
 if (gap_size == meta_size) {                            /* if the request is for a single metadatum */
@@ -2671,6 +3257,7 @@ if (gap_size == meta_size) {                            /* if the request is for
             return sim_tape_ioerr (uptr);                   /*     then quit with I/O error status */
 
         else {                                              /*   otherwise */
+            sim_tape_idx_truncate (uptr, uptr->pos);        /*     (the index ends here) */
             metadatum = MTR_GAP;                            /*     replace it with an erase gap marker */
 
             xfer = sim_fwrite (&metadatum, meta_size,   /* write the gap marker */
@@ -2885,13 +3472,25 @@ t_stat sim_tape_sprecsf (UNIT *uptr, uint32 count, uint32 *skipped)
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 t_stat st;
 t_mtrlnt tbc;
+uint32 n;
 
 *skipped = 0;
 if (ctx == NULL)                                        /* if not properly attached? */
     return sim_messagef (SCPE_IERR, "Bad Attach\n");    /*   that's a problem */
 sim_debug_unit (ctx->dbit, uptr, "sim_tape_sprecsf(unit=%d, count=%d)\n", (int)(uptr-ctx->dptr->units), count);
 
+st = sim_tape_wc_sync (uptr);                            /* the index may need no file I/O, */
+if (st != MTSE_OK) {                                    /*   so report any write failure now */
+    MT_SET_PNU (uptr);
+    return st;
+    }
 while (*skipped < count) {                              /* loop */
+    if (sim_tape_idx_spacef (uptr, count - *skipped, &n, &st)) {/* indexed? */
+        *skipped = *skipped + n;                        /* jump directly */
+        if (st != MTSE_OK)
+            return st;
+        continue;
+        }
     st = sim_tape_sprecf (uptr, &tbc);                  /* spc rec */
     if (st != MTSE_OK)
         return st;
@@ -2982,13 +3581,25 @@ t_stat sim_tape_sprecsr (UNIT *uptr, uint32 count, uint32 *skipped)
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 t_stat st;
 t_mtrlnt tbc;
+uint32 n;
 
 *skipped = 0;
 if (ctx == NULL)                                        /* if not properly attached? */
     return sim_messagef (SCPE_IERR, "Bad Attach\n");    /*   that's a problem */
 sim_debug_unit (ctx->dbit, uptr, "sim_tape_sprecsr(unit=%d, count=%d)\n", (int)(uptr-ctx->dptr->units), count);
 
+st = sim_tape_wc_sync (uptr);                            /* the index may need no file I/O, */
+if (st != MTSE_OK) {                                    /*   so report any write failure now */
+    MT_SET_PNU (uptr);
+    return st;
+    }
 while (*skipped < count) {                              /* loop */
+    if (sim_tape_idx_spacer (uptr, count - *skipped, &n, &st)) {/* indexed? */
+        *skipped = *skipped + n;                        /* jump directly */
+        if (st != MTSE_OK)
+            return st;
+        continue;
+        }
     st = sim_tape_sprecr (uptr, &tbc);                  /* spc rec rev */
     if (st != MTSE_OK)
         return st;
@@ -3233,11 +3844,11 @@ if (uptr->flags & UNIT_ATT) {
     sim_debug_unit (ctx->dbit, uptr, "sim_tape_rewind(unit=%d)\n", (int)(uptr-ctx->dptr->units));
     }
 uptr->pos = 0;
-if (uptr->flags & UNIT_ATT) {
-    (void)sim_tape_seek (uptr, uptr->pos);
-    }
 MT_CLR_PNU (uptr);
 MT_CLR_INMRK (uptr);                                    /* Not within a TAR tapemark */
+if ((uptr->flags & UNIT_ATT) &&
+    sim_tape_seek (uptr, uptr->pos))                    /* coalesced writes failed? */
+    return sim_tape_ioerr (uptr);
 return MTSE_OK;
 }
 
@@ -4266,6 +4877,282 @@ sprintf (name, "%s.aws.tape", filename);
 return SCPE_OK;
 }
 
+/* Exercise the read-ahead window and the write coalescing buffer */
+
+#define BUFTEST_RECS    200
+#define BUFTEST_BIG     300000          /* larger than either buffer */
+
+static t_mtrlnt sim_tape_test_buffering_size (int rec)
+{
+if (rec == BUFTEST_RECS / 2)
+    return BUFTEST_BIG;
+return (t_mtrlnt)(((rec * 997) % 9000) + 1);
+}
+
+static t_stat sim_tape_test_buffering_read (UNIT *uptr, int first, int last, uint8 *buf, const char *format)
+{
+int rec;
+t_mtrlnt bc, i;
+t_stat st;
+
+for (rec = first; rec < last; rec++) {
+    if ((rec % 50) == 49) {                     /* tape mark position? */
+        st = sim_tape_rdrecf (uptr, buf, &bc, BUFTEST_BIG);
+        if (st != MTSE_TMK)
+            return sim_messagef (SCPE_IERR, "%s: expected tape mark at record %d, status %d\n", format, rec, st);
+        continue;
+        }
+    st = sim_tape_rdrecf (uptr, buf, &bc, BUFTEST_BIG);
+    if ((st != MTSE_OK) || (bc != sim_tape_test_buffering_size (rec)))
+        return sim_messagef (SCPE_IERR, "%s: record %d read status %d, length %d\n", format, rec, st, (int)bc);
+    for (i = 0; i < bc; i++)
+        if (buf[i] != (uint8)(rec + i))
+            return sim_messagef (SCPE_IERR, "%s: record %d data mismatch at byte %d\n", format, rec, (int)i);
+    }
+return SCPE_OK;
+}
+
+static t_stat sim_tape_test_buffering (UNIT *uptr)
+{
+static const char *formats[] = {"SIMH", "E11", NULL};
+const char **fmt;
+char args[CBUFSIZE];
+uint8 *buf = (uint8 *)malloc (BUFTEST_BIG + 1);
+t_mtrlnt bc, i;
+uint32 skipped;
+int rec;
+int32 saved_switches = sim_switches;
+t_stat st = SCPE_OK;
+
+for (fmt = formats; (*fmt != NULL) && (st == SCPE_OK); fmt++) {
+    sim_printf ("Testing %s tape read-ahead and write coalescing\n", *fmt);
+    sprintf (args, "%s TapeTestBuffering.%s", *fmt, *fmt);
+    (void)remove (args + strlen (*fmt) + 1);
+    sim_switches = SWMASK ('F') | SWMASK ('N') | SWMASK ('Q');
+    st = sim_tape_attach_ex (uptr, args, 0, 0);
+    sim_switches = 0;
+    if (st != SCPE_OK)
+        break;
+    for (rec = 0; rec < BUFTEST_RECS; rec++) {
+        if ((rec % 50) == 49)
+            st = sim_tape_wrtmk (uptr);
+        else {
+            bc = sim_tape_test_buffering_size (rec);
+            for (i = 0; i < bc; i++)
+                buf[i] = (uint8)(rec + i);
+            st = sim_tape_wrrecf (uptr, buf, bc);
+            }
+        if (st != MTSE_OK)
+            break;
+        }
+    if (st == MTSE_OK)
+        st = sim_tape_wreom (uptr);
+    sim_tape_rewind (uptr);                     /* read back everything */
+    if (st == MTSE_OK)
+        st = sim_tape_test_buffering_read (uptr, 0, BUFTEST_RECS, buf, *fmt);
+    if ((st == SCPE_OK) &&                      /* then the EOM */
+        (sim_tape_rdrecf (uptr, buf, &bc, BUFTEST_BIG) != MTSE_EOM))
+        st = sim_messagef (SCPE_IERR, "%s: EOM not seen\n", *fmt);
+    if (st == SCPE_OK) {                        /* backspace and reread from the window */
+        sim_tape_rewind (uptr);
+        st = sim_tape_test_buffering_read (uptr, 0, 30, buf, *fmt);
+        if ((st == SCPE_OK) &&
+            ((sim_tape_sprecsr (uptr, 3, &skipped) != MTSE_OK) || (skipped != 3)))
+            st = sim_messagef (SCPE_IERR, "%s: backspace failed\n", *fmt);
+        if (st == SCPE_OK)
+            st = sim_tape_test_buffering_read (uptr, 27, 30, buf, *fmt);
+        if ((st == SCPE_OK) &&
+            ((sim_tape_rdrecr (uptr, buf, &bc, BUFTEST_BIG) != MTSE_OK) ||
+             (bc != sim_tape_test_buffering_size (29)) || (buf[0] != 29)))
+            st = sim_messagef (SCPE_IERR, "%s: read reverse failed\n", *fmt);
+        }
+    if (st == SCPE_OK) {                        /* overwrite in the middle of the tape */
+        sim_tape_rewind (uptr);
+        st = sim_tape_test_buffering_read (uptr, 0, 10, buf, *fmt);
+        for (i = 0; i < 77; i++)
+            buf[i] = (uint8)(10 + i);
+        if ((st == SCPE_OK) &&
+            ((sim_tape_wrrecf (uptr, buf, 77) != MTSE_OK) ||
+             (sim_tape_wreom (uptr) != MTSE_OK)))
+            st = sim_messagef (SCPE_IERR, "%s: overwrite failed\n", *fmt);
+        sim_tape_rewind (uptr);
+        if (st == SCPE_OK)
+            st = sim_tape_test_buffering_read (uptr, 0, 10, buf, *fmt);
+        if ((st == SCPE_OK) &&
+            ((sim_tape_rdrecf (uptr, buf, &bc, BUFTEST_BIG) != MTSE_OK) || (bc != 77) ||
+             (buf[76] != (uint8)(10 + 76)) ||
+             (sim_tape_rdrecf (uptr, buf, &bc, BUFTEST_BIG) != MTSE_EOM)))
+            st = sim_messagef (SCPE_IERR, "%s: overwritten record read back failed\n", *fmt);
+        }
+    if (st == SCPE_OK) {                        /* a failing coalesced write is reported by the rewind */
+        FILE *rw = uptr->fileref;
+        FILE *ro = fopen (uptr->filename, "rb");
+
+        sim_tape_rewind (uptr);
+        if ((ro == NULL) ||
+            (sim_tape_wrrecf (uptr, buf, 77) != MTSE_OK))
+            st = sim_messagef (SCPE_IERR, "%s: write error setup failed\n", *fmt);
+        else {
+            uptr->fileref = ro;                 /* make the buffered write fail */
+            if (sim_tape_rewind (uptr) != MTSE_IOERR)
+                st = sim_messagef (SCPE_IERR, "%s: write error not reported by rewind\n", *fmt);
+            uptr->fileref = rw;
+            }
+        if (ro != NULL)
+            fclose (ro);
+        }
+    sim_tape_detach (uptr);
+    (void)remove (args + strlen (*fmt) + 1);
+    }
+free (buf);
+sim_switches = saved_switches;
+return st;
+}
+
+/* Exercise indexed positioning */
+
+#define IDXTEST_FILES   30
+
+static uint32 sim_tape_test_index_recs (int file)
+{
+return (file % 7) + 1;
+}
+
+static t_stat sim_tape_test_index_expect (const char *format, const char *what, t_stat st, t_stat exp_st, uint32 n, uint32 exp_n)
+{
+if ((st != exp_st) || (n != exp_n))
+    return sim_messagef (SCPE_IERR, "%s: %s returned status %d, count %u - expected %d, %u\n", format, what, st, n, exp_st, exp_n);
+return SCPE_OK;
+}
+
+static t_stat sim_tape_test_index_read (const char *format, UNIT *uptr, uint8 *buf, int file, int rec)
+{
+t_mtrlnt bc;
+t_stat st = sim_tape_rdrecf (uptr, buf, &bc, 1024);
+
+if ((st != MTSE_OK) || (bc != (t_mtrlnt)(100 + 3 * file + rec)) || (buf[0] != file) || (buf[1] != rec))
+    return sim_messagef (SCPE_IERR, "%s: expected file %d record %d, got status %d, length %d, data %d/%d\n", format, file, rec, st, (int)bc, buf[0], buf[1]);
+return SCPE_OK;
+}
+
+static t_stat sim_tape_test_index (UNIT *uptr)
+{
+static const char *formats[] = {"SIMH", "E11", "AWS", NULL};
+const char **fmt;
+char args[CBUFSIZE];
+uint8 buf[1024];
+struct tape_context *ctx;
+uint32 skipped, recsskipped, objsskipped, rec;
+int file;
+int32 saved_switches = sim_switches;
+t_stat r, st = SCPE_OK;
+
+for (fmt = formats; (*fmt != NULL) && (st == SCPE_OK); fmt++) {
+    sim_printf ("Testing %s tape indexed positioning\n", *fmt);
+    sprintf (args, "%s TapeTestIndex.%s", *fmt, *fmt);
+    (void)remove (args + strlen (*fmt) + 1);
+    sim_switches = SWMASK ('F') | SWMASK ('N') | SWMASK ('Q');
+    st = sim_tape_attach_ex (uptr, args, 0, 0);
+    sim_switches = 0;
+    if (st != SCPE_OK)
+        break;
+    for (file = 0; (file < IDXTEST_FILES) && (st == MTSE_OK); file++) {
+        for (rec = 0; (rec < sim_tape_test_index_recs (file)) && (st == MTSE_OK); rec++) {
+            memset (buf, 0, sizeof (buf));
+            buf[0] = (uint8)file;
+            buf[1] = (uint8)rec;
+            st = sim_tape_wrrecf (uptr, buf, 100 + 3 * file + rec);
+            }
+        if (st == MTSE_OK)
+            st = sim_tape_wrtmk (uptr);
+        }
+    if (st == MTSE_OK)
+        st = sim_tape_wrtmk (uptr);
+    if (st == MTSE_OK)
+        st = sim_tape_wreom (uptr);
+    sim_tape_detach (uptr);
+    if (st != MTSE_OK)
+        break;
+    sim_switches = SWMASK ('F') | SWMASK ('Q');         /* reattach, the index is built by validation */
+    st = sim_tape_attach_ex (uptr, args, 0, 0);
+    sim_switches = 0;
+    if (st != SCPE_OK)
+        break;
+    ctx = (struct tape_context *)uptr->tape_ctx;
+    if (ctx->idx_tmk_count < IDXTEST_FILES + 1)
+        st = sim_messagef (SCPE_IERR, "%s: index has %u tape marks after attach\n", *fmt, ctx->idx_tmk_count);
+    if (st == SCPE_OK) {                                /* forward to file 17 */
+        r = sim_tape_spfilef (uptr, 17, &skipped);
+        st = sim_tape_test_index_expect (*fmt, "spfilef", r, MTSE_OK, skipped, 17);
+        }
+    if (st == SCPE_OK)
+        st = sim_tape_test_index_read (*fmt, uptr, buf, 17, 0);
+    if (st == SCPE_OK) {                                /* rest of file 17 */
+        r = sim_tape_sprecsf (uptr, 1000, &skipped);
+        st = sim_tape_test_index_expect (*fmt, "sprecsf", r, MTSE_TMK, skipped, sim_tape_test_index_recs (17) - 1);
+        }
+    if (st == SCPE_OK) {                                /* back over 5 tape marks */
+        r = sim_tape_spfiler (uptr, 5, &skipped);
+        st = sim_tape_test_index_expect (*fmt, "spfiler", r, MTSE_OK, skipped, 5);
+        }
+    if (st == SCPE_OK) {                                /* back over file 13 */
+        r = sim_tape_sprecsr (uptr, 1000, &skipped);
+        st = sim_tape_test_index_expect (*fmt, "sprecsr", r, MTSE_TMK, skipped, sim_tape_test_index_recs (13));
+        }
+    if (st == SCPE_OK) {
+        r = sim_tape_sprecsf (uptr, 1, &skipped);
+        st = sim_tape_test_index_expect (*fmt, "sprecsf", r, MTSE_TMK, skipped, 0);
+        }
+    if (st == SCPE_OK)
+        st = sim_tape_test_index_read (*fmt, uptr, buf, 13, 0);
+    if (st == SCPE_OK) {
+        r = sim_tape_sprecsr (uptr, 1000, &skipped);
+        st = sim_tape_test_index_expect (*fmt, "sprecsr", r, MTSE_TMK, skipped, 1);
+        }
+    if (st == SCPE_OK) {                                /* rewind and position to file 20 record 2 */
+        r = sim_tape_position (uptr, MTPOS_M_REW, 2, &recsskipped, 20, &skipped, &objsskipped);
+        st = sim_tape_test_index_expect (*fmt, "position", r, MTSE_OK, skipped * 1000 + recsskipped, 20 * 1000 + 2);
+        }
+    if (st == SCPE_OK)
+        st = sim_tape_test_index_read (*fmt, uptr, buf, 20, 2);
+    if (st == SCPE_OK) {
+        r = sim_tape_sprecsr (uptr, 100000, &skipped);
+        st = sim_tape_test_index_expect (*fmt, "sprecsr", r, MTSE_TMK, skipped, 3);
+        }
+    if (st == SCPE_OK) {                                /* rewrite file 10 and end the tape there */
+        sim_tape_rewind (uptr);
+        r = sim_tape_spfilef (uptr, 10, &skipped);
+        st = sim_tape_test_index_expect (*fmt, "spfilef", r, MTSE_OK, skipped, 10);
+        }
+    if (st == SCPE_OK) {
+        memset (buf, 0, sizeof (buf));
+        buf[0] = 10;
+        if ((sim_tape_wrrecf (uptr, buf, 130) != MTSE_OK) ||
+            (sim_tape_wrtmk (uptr) != MTSE_OK) ||
+            (sim_tape_wreom (uptr) != MTSE_OK))
+            st = sim_messagef (SCPE_IERR, "%s: rewrite failed\n", *fmt);
+        }
+    if (st == SCPE_OK) {
+        r = sim_tape_sprecsr (uptr, 1000, &skipped);
+        st = sim_tape_test_index_expect (*fmt, "sprecsr after write", r, MTSE_TMK, skipped, 1);/* PNU counts as one */
+        }
+    if (st == SCPE_OK) {
+        r = sim_tape_sprecsr (uptr, 1000, &skipped);
+        st = sim_tape_test_index_expect (*fmt, "sprecsr after write", r, MTSE_TMK, skipped, 1);
+        }
+    if (st == SCPE_OK) {
+        sim_tape_rewind (uptr);
+        r = sim_tape_spfilef (uptr, 100, &skipped);
+        st = sim_tape_test_index_expect (*fmt, "spfilef after write", r, MTSE_EOM, skipped,
+                                         (strcmp (*fmt, "AWS") == 0) ? 12 : 11);/* AWS ends with a tape mark header */
+        }
+    sim_tape_detach (uptr);
+    (void)remove (args + strlen (*fmt) + 1);
+    }
+sim_switches = saved_switches;
+return st;
+}
+
 static t_stat sim_tape_test_density_string (void)
 {
 char buf[128];
@@ -4398,6 +5285,10 @@ SIM_TEST(sim_tape_test_density_string ());
 
 SIM_TEST(sim_tape_test_classify_file_contents (dptr->units));
 
+SIM_TEST(sim_tape_test_buffering (dptr->units));
+
+SIM_TEST(sim_tape_test_index (dptr->units));
+
 SIM_TEST(sim_tape_test_remove_tape_files (dptr->units, "TapeTestFile1"));
 
 SIM_TEST(sim_tape_test_create_tape_files (dptr->units, "TapeTestFile1", 2, 5, 4096));
@@ -181,6 +181,14 @@ static double sim_throt_inst_start;
 static uint32 sim_throt_sleep_time = 0;
 static int32 sim_throt_wait = 0;
 static uint32 sim_throt_delay = 3;
+static t_bool sim_throt_precise = FALSE;            /* high resolution paced throttling */
+static double sim_throt_hr_last_ns;                 /* host time (ns) at the prior pacing slice */
+static double sim_throt_hr_last_inst;               /* instruction count at the prior pacing slice */
+static double sim_throt_hr_integral;                /* PI controller accumulated error (ns) */
+static double sim_throt_hr_sleep_ns;                /* most recent controller sleep (ns) */
+static double sim_throt_hr_window_ns;               /* achieved rate measurement start (ns) */
+static double sim_throt_hr_window_inst;             /* achieved rate measurement start inst */
+static double sim_throt_achieved_cps;               /* measured rate while throttling */
 #define CLK_TPS 100
 #define CLK_INIT (sim_precalibrate_ips/CLK_TPS)
 static int32 sim_int_clk_tps;
@@ -1504,6 +1512,10 @@ REG sim_throttle_reg[] = {
     { DBRDATAD (THROT_START_TIME,sim_throt_inst_start,       "Time when actual throttling started") },
     { DRDATAD (THROT_DELAY,      sim_throt_delay,        32, "Seconds before throttling starts"), PV_RSPC},
     { DRDATAD (THROT_DRIFT_PCT,  sim_throt_drift_pct,    32, "Percent of throttle drift before correction"), PV_RSPC},
+    { FLDATAD (THROT_PRECISE,    sim_throt_precise,       0, "High resolution paced throttling"), REG_RO},
+    { DBRDATAD (THROT_ACHIEVED_CPS, sim_throt_achieved_cps,  "Measured cycles per second while throttling") },
+    { DBRDATAD (THROT_PI_INTEGRAL, sim_throt_hr_integral,    "Precise throttle accumulated error (ns)") },
+    { DBRDATAD (THROT_PI_SLEEP,  sim_throt_hr_sleep_ns,      "Precise throttle most recent sleep (ns)") },
     { NULL }
     };
 
@@ -1828,6 +1840,12 @@ if (_rtcn_tick_catchup_check (rtc, -1)) {               /* Check for slow clock
     sim_interval -= sin_cyc;
     return FALSE;
     }
+#if defined (SIM_ASYNCH_IO)
+if (sim_aio_coalesce_flush (NULL)) {                    /* held I/O completions delivered? */
+    sim_interval -= sin_cyc;                            /* then there's work to do */
+    return FALSE;
+    }
+#endif
 if ((!sim_idle_enab)                             ||     /* idling disabled */
     ((sim_clock_queue == QUEUE_LIST_END) &&             /* or clock queue empty? */
      (!sim_asynch_timer))||                             /*     and not asynch? */
@@ -1967,6 +1985,150 @@ return SCPE_OK;
 
 /* Throttling package */
 
+/* Precise throttling support
+
+   The precise throttle modes pace execution in short slices (about
+   SIM_THROT_PRECISE_US of simulated time each) rather than sleeping for
+   whole host clock ticks.  Elapsed time is measured with a monotonic
+   nanosecond clock, and sleeps shorter than a millisecond are realized
+   by an OS sleep for the bulk of the interval followed by a busy-wait
+   for the final SIM_THROT_PRECISE_SPIN_NS, since OS sleeps routinely
+   overshoot by tens of microseconds.  On Windows, whose Sleep() only
+   takes whole milliseconds, the OS sleep is a wait on a high resolution
+   waitable timer (a plain waitable timer on systems which predate them).
+   VMS sleeps in whole milliseconds and spins for the remainder.
+*/
+
+/* Host monotonic time in nanoseconds, for measuring short intervals */
+
+double sim_os_hrtime (void)
+{
+#if defined(_WIN32)
+static LARGE_INTEGER freq;
+LARGE_INTEGER now;
+
+if (freq.QuadPart == 0)
+    QueryPerformanceFrequency (&freq);
+QueryPerformanceCounter (&now);
+return ((double)now.QuadPart * 1000000000.0) / (double)freq.QuadPart;
+#else
+struct timespec now;
+
+#if defined(CLOCK_MONOTONIC) && !defined(NEED_CLOCK_GETTIME)
+clock_gettime (CLOCK_MONOTONIC, &now);
+#else
+clock_gettime (CLOCK_REALTIME, &now);
+#endif
+return ((double)now.tv_sec * 1000000000.0) + (double)now.tv_nsec;
+#endif
+}
+
+#if defined(_WIN32)
+static HANDLE sim_throt_hr_timer = NULL;        /* timer for sub-millisecond sleeps */
+static t_bool sim_throt_hr_timer_failed = FALSE;
+
+static t_bool _sim_throt_timer_sleep (double ns)
+{
+LARGE_INTEGER due;
+
+if ((sim_throt_hr_timer == NULL) && !sim_throt_hr_timer_failed) {
+#if defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+    sim_throt_hr_timer = CreateWaitableTimerExW (NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+    if (sim_throt_hr_timer == NULL)             /* high resolution timers unsupported? */
+        sim_throt_hr_timer = CreateWaitableTimer (NULL, TRUE, NULL);
+    sim_throt_hr_timer_failed = (sim_throt_hr_timer == NULL);
+    }
+if (sim_throt_hr_timer == NULL)
+    return FALSE;
+due.QuadPart = -(LONGLONG)(ns / 100.0);         /* relative time in 100ns units */
+if (!SetWaitableTimer (sim_throt_hr_timer, &due, 0, NULL, NULL, FALSE))
+    return FALSE;
+WaitForSingleObject (sim_throt_hr_timer, INFINITE);
+return TRUE;
+}
+#endif
+
+static void _sim_throt_hrsleep (double until_ns)
+{
+double remaining_ns = until_ns - sim_os_hrtime ();
+#if !defined(_WIN32) && !defined(VMS)
+struct timespec treq;
+#endif
+
+if (remaining_ns > SIM_THROT_PRECISE_SPIN_NS) {
+    remaining_ns -= SIM_THROT_PRECISE_SPIN_NS;
+#if defined(_WIN32)
+    if ((!_sim_throt_timer_sleep (remaining_ns)) &&
+        (remaining_ns >= 1000000.0))            /* only whole milliseconds */
+        sim_os_ms_sleep ((unsigned int)(remaining_ns / 1000000.0));
+#elif defined(VMS)
+    if (remaining_ns >= 1000000.0)              /* only whole milliseconds */
+        sim_os_ms_sleep ((unsigned int)(remaining_ns / 1000000.0));
+#else
+    treq.tv_sec = (time_t)(remaining_ns / 1000000000.0);
+    treq.tv_nsec = (long)(remaining_ns - ((double)treq.tv_sec * 1000000000.0));
+    (void) nanosleep (&treq, NULL);
+#endif
+    }
+while (sim_os_hrtime () < until_ns)
+    ;                                           /* busy-wait the remainder */
+}
+
+/* Restart the precise throttle's measurement references.  Time spent
+   outside of instruction execution (at the sim> prompt) must not be
+   seen by the controller as a stall to be made up. */
+
+static void _sim_throt_precise_reset (void)
+{
+sim_throt_hr_last_ns = sim_throt_hr_window_ns = sim_os_hrtime ();
+sim_throt_hr_last_inst = sim_throt_hr_window_inst = sim_gtime ();
+sim_throt_hr_integral = 0.0;
+}
+
+/* Precise throttle pacing
+
+   Runs once per pacing slice.  The controller input is the difference
+   between the host time the slice's instructions should have taken at
+   the desired rate and the host time that actually elapsed since the
+   prior slice (which includes the prior slice's sleep).  A positive
+   error means the simulator is running faster than desired.  The sleep
+   for this slice is a PI function of that error.  The integral term is
+   clamped to four slices worth of time (a steady state sleep of nearly
+   a whole slice needs an integral of two) so that after a host stall
+   the simulator never runs unthrottled for more than a couple of slices
+   to catch up, which would otherwise show up as bursts of execution.
+*/
+
+static void _sim_throt_precise_pace (void)
+{
+double now_ns = sim_os_hrtime ();
+double inst = sim_gtime ();
+double slice_ns = ((double)sim_throt_wait * 1000000000.0) / sim_throt_cps;
+double err_ns;
+
+err_ns = (((inst - sim_throt_hr_last_inst) * 1000000000.0) / sim_throt_cps) - (now_ns - sim_throt_hr_last_ns);
+sim_throt_hr_integral += err_ns;
+if (sim_throt_hr_integral > (4.0 * slice_ns))
+    sim_throt_hr_integral = 4.0 * slice_ns;
+if (sim_throt_hr_integral < -(4.0 * slice_ns))
+    sim_throt_hr_integral = -(4.0 * slice_ns);
+sim_throt_hr_sleep_ns = (SIM_THROT_PRECISE_KP * err_ns) + (SIM_THROT_PRECISE_KI * sim_throt_hr_integral);
+if (sim_throt_hr_sleep_ns < 0.0)
+    sim_throt_hr_sleep_ns = 0.0;
+sim_throt_hr_last_ns = now_ns;
+sim_throt_hr_last_inst = inst;
+if (now_ns - sim_throt_hr_window_ns >= 1000000000.0) {
+    sim_throt_achieved_cps = ((inst - sim_throt_hr_window_inst) * 1000000000.0) / (now_ns - sim_throt_hr_window_ns);
+    sim_debug (DBG_THR, &sim_timer_dev, "sim_throt_svc(PRECISE) achieved cps = %f, d_cps = %f, integral = %.0f ns, sleep = %.0f ns\n",
+                                        sim_throt_achieved_cps, sim_throt_cps, sim_throt_hr_integral, sim_throt_hr_sleep_ns);
+    sim_throt_hr_window_ns = now_ns;
+    sim_throt_hr_window_inst = inst;
+    }
+if (sim_throt_hr_sleep_ns > 0.0)
+    _sim_throt_hrsleep (now_ns + sim_throt_hr_sleep_ns);
+}
+
 t_stat sim_set_throt (int32 arg, CONST char *cptr)
 {
 CONST char *tptr;
@@ -1974,11 +2136,13 @@ char c;
 uint32 saved_throt_type = sim_throt_type;
 int factor = 1;
 t_value val, val2 = 0;
+t_bool precise = FALSE;
 
 if (arg == 0) {
     if ((cptr != NULL) && (*cptr != 0))
         return sim_messagef (SCPE_ARG, "Unexpected NOTHROTTLE argument: %s\n", cptr);
     sim_throt_type = SIM_THROT_NONE;
+    sim_throt_precise = FALSE;
     sim_throt_cancel ();
     return SCPE_OK;
     }
@@ -1988,6 +2152,10 @@ if (sim_idle_rate_ms == 0)
     return sim_messagef (SCPE_NOFNC, "Throttling is not available, Minimum OS sleep time is %dms\n", sim_os_sleep_min_ms);
 if (*cptr == '\0')
     return sim_messagef (SCPE_ARG, "Missing throttle mode specification\n");
+if (sim_strncasecmp (cptr, "PRECISE=", 8) == 0) {
+    precise = TRUE;
+    cptr += 8;
+    }
 val = strtotv (cptr, &tptr, 10);
 if (cptr == tptr)
     return sim_messagef (SCPE_ARG, "Invalid throttle specification: %s\n", cptr);
@@ -2023,7 +2191,7 @@ else {
         if ((c == '%') && (val > 0) && (val < 100))
             sim_throt_type = SIM_THROT_PCT;
         else {
-            if ((c == '/') && (val2 != 0))
+            if ((c == '/') && (val2 != 0) && (!precise))
                 sim_throt_type = SIM_THROT_SPC;
             else
                 return sim_messagef (SCPE_ARG, "Invalid throttle specification: %s\n", cptr);
@@ -2044,6 +2212,8 @@ if (sim_idle_enab) {
     sim_printf ("Idling disabled\n");
     sim_clr_idle (NULL, 0, NULL, NULL);
     }
+sim_throt_precise = precise;
+sim_throt_achieved_cps = 0.0;
 sim_throt_val = (uint32) val;
 if (sim_throt_type != SIM_THROT_SPC)
     sim_throt_cps = sim_precalibrate_ips;       /* Set initial value while correct one is determined */
@@ -2101,20 +2271,21 @@ else {
 
     case SIM_THROT_MCYC:
         fprintf (st, "Throttle:                      %d mega %s per second\n", sim_throt_val, sim_vm_interval_units);
-        if (sim_throt_wait)
+        if (sim_throt_wait && !sim_throt_precise)
             fprintf (st, "Throttling by sleeping for:    %d ms every %d %s\n", sim_throt_sleep_time, sim_throt_wait, sim_vm_interval_units);
         break;
 
     case SIM_THROT_KCYC:
         fprintf (st, "Throttle:                      %d kilo %s per second\n", sim_throt_val, sim_vm_interval_units);
-        if (sim_throt_wait)
+        if (sim_throt_wait && !sim_throt_precise)
             fprintf (st, "Throttling by sleeping for:    %d ms every %d %s\n", sim_throt_sleep_time, sim_throt_wait, sim_vm_interval_units);
         break;
 
     case SIM_THROT_PCT:
         if (sim_throt_wait) {
             fprintf (st, "Throttle:                      %d%% of %s %s per second\n", sim_throt_val, sim_fmt_numeric (sim_throt_peak_cps), sim_vm_interval_units);
-            fprintf (st, "Throttling by sleeping for:    %d ms every %d %s\n", sim_throt_sleep_time, sim_throt_wait, sim_vm_interval_units);
+            if (!sim_throt_precise)
+                fprintf (st, "Throttling by sleeping for:    %d ms every %d %s\n", sim_throt_sleep_time, sim_throt_wait, sim_vm_interval_units);
             }
         else
             fprintf (st, "Throttle:                      %d%%\n", sim_throt_val);
@@ -2135,8 +2306,16 @@ else {
         break;
         }
     if (sim_throt_type != SIM_THROT_NONE) {
+        if (sim_throt_precise && (sim_throt_state == SIM_THROT_STATE_THROTTLE))
+            fprintf (st, "Throttling by pacing every:    %d %s (%.0f us sleep)\n", sim_throt_wait, sim_vm_interval_units, sim_throt_hr_sleep_ns / 1000.0);
         if (sim_throt_state != SIM_THROT_STATE_THROTTLE)
             fprintf (st, "Throttle State:                %s - wait: %d\n", (sim_throt_state == SIM_THROT_STATE_INIT) ? "Waiting for Init" : "Timing", sim_throt_wait);
+        else {
+            if ((sim_throt_achieved_cps > 0.0) && (sim_throt_cps > 0.0)) {
+                fprintf (st, "Achieved Rate:                 %s %s per second", sim_fmt_numeric (sim_throt_achieved_cps), sim_vm_interval_units);
+                fprintf (st, " (%.2f%% of target %s)\n", (100.0 * sim_throt_achieved_cps) / sim_throt_cps, sim_fmt_numeric (sim_throt_cps));
+                }
+            }
         }
     }
 return SCPE_OK;
@@ -2149,6 +2328,8 @@ if (sim_throt_type != SIM_THROT_NONE) {
         /* Reset recalibration reference times */
         sim_throt_ms_start = sim_os_msec ();
         sim_throt_inst_start = sim_gtime ();
+        if (sim_throt_precise)
+            _sim_throt_precise_reset ();
         /* Start with prior calibrated delay */
         sim_activate (&sim_throttle_unit, sim_throt_wait);
         }
@@ -2282,15 +2463,22 @@ switch (sim_throt_state) {
                     return SCPE_OK;
                     }
                 }
-            while (1) {
-                sim_throt_wait = (int32)                /* cycles between sleeps */
-                    ((a_cps * d_cps * ((double) sim_throt_sleep_time)) /
-                     (1000.0 * (a_cps - d_cps)));
-                if (sim_throt_wait >= SIM_THROT_WMIN)   /* long enough? */
-                    break;
-                sim_throt_sleep_time += sim_os_sleep_inc_ms;
-                sim_debug (DBG_THR, &sim_timer_dev, "sim_throt_svc() Wait too small, increasing sleep time to %d ms.  Values a_cps = %f, d_cps = %f, wait = %d\n",
-                                                    sim_throt_sleep_time, a_cps, d_cps, sim_throt_wait);
+            if (sim_throt_precise) {                /* pace in short slices */
+                sim_throt_wait = (int32)((d_cps * SIM_THROT_PRECISE_US) / 1000000.0);
+                if (sim_throt_wait < SIM_THROT_WMIN)
+                    sim_throt_wait = SIM_THROT_WMIN;
+                }
+            else {
+                while (1) {
+                    sim_throt_wait = (int32)                /* cycles between sleeps */
+                        ((a_cps * d_cps * ((double) sim_throt_sleep_time)) /
+                         (1000.0 * (a_cps - d_cps)));
+                    if (sim_throt_wait >= SIM_THROT_WMIN)   /* long enough? */
+                        break;
+                    sim_throt_sleep_time += sim_os_sleep_inc_ms;
+                    sim_debug (DBG_THR, &sim_timer_dev, "sim_throt_svc() Wait too small, increasing sleep time to %d ms.  Values a_cps = %f, d_cps = %f, wait = %d\n",
+                                                        sim_throt_sleep_time, a_cps, d_cps, sim_throt_wait);
+                    }
                 }
             sim_throt_ms_start = sim_throt_ms_stop;
             sim_throt_inst_start = sim_gtime();
@@ -2298,6 +2486,8 @@ switch (sim_throt_state) {
             sim_debug (DBG_THR, &sim_timer_dev, "sim_throt_svc() Throttle values a_cps = %f, d_cps = %f, wait = %d, sleep = %d ms\n",
                                                 a_cps, d_cps, sim_throt_wait, sim_throt_sleep_time);
             sim_throt_cps = d_cps;                  /* save the desired rate */
+            if (sim_throt_precise)
+                _sim_throt_precise_reset ();
             /* Run through all timers and adjust the calibration for each */
             /* one that is running to reflect the throttle specified rate */
             for (tmr=0; tmr<=SIM_NTIMERS; tmr++) {
@@ -2317,12 +2507,17 @@ switch (sim_throt_state) {
         break;
 
     case SIM_THROT_STATE_THROTTLE:                      /* throttling */
+        if (sim_throt_precise) {                        /* PI paced? */
+            _sim_throt_precise_pace ();
+            break;
+            }
         sim_idle_ms_sleep (sim_throt_sleep_time);
         delta_ms = sim_os_msec () - sim_throt_ms_start;
         if (delta_ms >= 10000) {                        /* recompute every 10 sec */
             double delta_insts = sim_gtime() - sim_throt_inst_start;
 
             a_cps = (delta_insts * 1000.0) / (double) delta_ms;
+            sim_throt_achieved_cps = a_cps;
             if (sim_throt_type != SIM_THROT_SPC) {      /* when not dynamic throttling */
                 if (sim_throt_type == SIM_THROT_MCYC)   /* calc desired cps */
                     d_cps = (double) sim_throt_val * 1000000.0;
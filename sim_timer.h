@@ -96,6 +96,10 @@ int clock_gettime(int clock_id, struct timespec *tp);
 #define SIM_THROT_STATE_INIT      0                 /* Starting */
 #define SIM_THROT_STATE_TIME      1                 /* Checking Time */
 #define SIM_THROT_STATE_THROTTLE  2                 /* Throttling  */
+#define SIM_THROT_PRECISE_US      1000              /* precise throttle pacing slice (usecs) */
+#define SIM_THROT_PRECISE_SPIN_NS 200000.0          /* precise sleep busy-wait tail (nsecs) */
+#define SIM_THROT_PRECISE_KP      0.5               /* precise throttle proportional gain */
+#define SIM_THROT_PRECISE_KI      0.5               /* precise throttle integral gain */
 
 #define TIMER_DBG_IDLE  0x001                       /* Debug Flag for Idle Debugging */
 #define TIMER_DBG_QUEUE 0x002                       /* Debug Flag for Asynch Queue Debugging */
@@ -130,6 +134,7 @@ t_stat sim_show_idle (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
 void sim_throt_sched (void);
 void sim_throt_cancel (void);
 uint32 sim_os_msec (void);
+double sim_os_hrtime (void);
 void sim_os_sleep (unsigned int sec);
 uint32 sim_os_ms_sleep (unsigned int msec);
 uint32 sim_os_ms_sleep_init (void);
@@ -488,6 +488,19 @@ static int  tmxr_framer_write (TMLN *line, const char *buf, int32 length);
 
 static void tmxr_add_to_open_list (TMXR* mux);
 
+/* Event driven I/O is available where the host provides epoll */
+
+#if defined (SIM_ASYNCH_IO) && defined (__linux__)
+#define TMXR_EPOLL_IO 1
+static volatile t_bool tmxr_poll_running = FALSE;       /* I/O thread watching lines */
+static void _tmxr_poll_changed (void);
+static void _tmxr_poll_sync (void);
+static t_bool _tmxr_poll_test_ready (t_bool *ready);
+static void _tmxr_poll_set_ready (t_bool *ready);
+#else
+#define _tmxr_poll_changed()
+#endif
+
 /* Initialize the line state.
 
    Reset the line state to represent an idle line.  Note that we do not clear
@@ -508,6 +521,7 @@ lp->rxbpr = lp->rxbpi = lp->rxcnt = lp->rxpcnt = 0;     /* init receive indexes
 if (!lp->txbfd || lp->notelnet)                         /* if not buffered telnet */
     lp->txbpr = lp->txbpi = lp->txcnt = lp->txpcnt = 0; /*   init transmit indexes */
 lp->txdrp = lp->txstall = 0;
+_tmxr_poll_changed ();                                  /* descriptors may have changed */
 tmxr_set_get_modem_bits (lp, 0, 0, NULL);
 if (lp->mp && (!lp->mp->buffered) && (!lp->txbfd)) {
     lp->txbfd = 0;
@@ -728,8 +742,46 @@ if (lp->serport)                                        /* serial port connectio
 else {
     if (lp->framer)
         return tmxr_framer_read (lp,  &(lp->rxb[i]), length);
-    else                                                    /* Telnet connection */
+    else {                                                  /* Telnet connection */
+#if defined (TMXR_EPOLL_IO)
+        if (tmxr_poll_running) {                            /* I/O thread watching? */
+            int32 nbytes;
+
+            if (!_tmxr_poll_test_ready (&lp->rx_ready))     /* nothing arrived? */
+                return 0;
+            nbytes = sim_read_sock (lp->sock, &(lp->rxb[i]), length);
+            if (nbytes == length)                           /* may be more waiting */
+                _tmxr_poll_set_ready (&lp->rx_ready);
+            return nbytes;
+            }
+#endif
         return sim_read_sock (lp->sock, &(lp->rxb[i]), length);
+        }
+    }
+}
+
+
+/* Count line data in the multiplexer's performance counters.
+
+   The counters are created on first use since the multiplexer's device
+   pointer may not be known until the first line is attached.
+*/
+
+static void tmxr_perf_count (TMLN *lp, t_bool transmit, int32 nbytes)
+{
+TMXR *mp = lp->mp;
+
+if ((mp == NULL) || (mp->dptr == NULL) || (nbytes <= 0))
+    return;
+if (transmit) {
+    if (mp->perf_tx == NULL)
+        mp->perf_tx = sim_perf_counter (mp->dptr, "TX", SIM_PERF_BYTES, "Bytes transmitted on multiplexer lines");
+    sim_perf_add (mp->perf_tx, (t_uint64)nbytes);
+    }
+else {
+    if (mp->perf_rx == NULL)
+        mp->perf_rx = sim_perf_counter (mp->dptr, "RX", SIM_PERF_BYTES, "Bytes received on multiplexer lines");
+    sim_perf_add (mp->perf_rx, (t_uint64)nbytes);
     }
 }
 
@@ -1080,6 +1132,7 @@ int32 ringing = -1;
 char *address;
 char msg[512];
 uint32 poll_time = sim_os_msec ();
+t_bool conn_ready = FALSE;
 
 memset (msg, 0, sizeof (msg));
 if (mp->last_poll_time == 0) {                          /* first poll initializations */
@@ -1110,7 +1163,12 @@ if (mp->last_poll_time == 0) {                          /* first poll initializa
         }
     }
 
-if (sim_is_running &&
+#if defined (TMXR_EPOLL_IO)
+_tmxr_poll_sync ();                                     /* bring the I/O thread up to date */
+if (tmxr_poll_running)                                  /* I/O thread watching? */
+    conn_ready = _tmxr_poll_test_ready (&mp->conn_ready);
+#endif
+if (sim_is_running && !conn_ready &&
     ((poll_time - mp->last_poll_time) < mp->poll_interval*1000))
     return -1;                                          /* too soon to try */
 
@@ -1295,6 +1353,7 @@ for (i = 0; i < mp->lines; i++) {                       /* check each line in se
                             lp->conn = TRUE;                    /* record connection */
                             lp->sock = lp->connecting;          /* it now looks normal */
                             lp->connecting = 0;
+                            _tmxr_poll_changed ();              /* now watch for input */
                             lp->ipad = (char *)realloc (lp->ipad, 1+strlen (lp->destination));
                             strcpy (lp->ipad, lp->destination);
                             lp->cnms = sim_os_msec ();
@@ -1402,6 +1461,7 @@ for (i = 0; i < mp->lines; i++) {                       /* check each line in se
         tmxr_debug_connect_line (lp, msg);
         lp->connecting = sim_connect_sock_ex (lp->datagram ? lp->port : NULL, lp->destination, "localhost", NULL, (lp->datagram ? SIM_SOCK_OPT_DATAGRAM : 0)  |
                                                                                                                   (lp->mp->packet ? SIM_SOCK_OPT_NODELAY : 0));
+        _tmxr_poll_changed ();
         }
 
     }
@@ -1937,6 +1997,7 @@ if (lp->mp && lp->modem_control) {                  /* This API ONLY works on mo
                 tmxr_debug_connect_line (lp, msg);
                 lp->connecting = sim_connect_sock_ex (lp->datagram ? lp->port : NULL, lp->destination, "localhost", NULL, (lp->datagram ? SIM_SOCK_OPT_DATAGRAM : 0) |
                                                                                                                           (lp->packet ? SIM_SOCK_OPT_NODELAY : 0));
+                _tmxr_poll_changed ();
                 }
             }
         }
@@ -2189,6 +2250,9 @@ int32 i, nbytes, j;
 TMLN *lp;
 
 tmxr_debug_trace (mp, "tmxr_poll_rx()");
+#if defined (TMXR_EPOLL_IO)
+_tmxr_poll_sync ();                                     /* bring the I/O thread up to date */
+#endif
 for (i = 0; i < mp->lines; i++) {                       /* loop thru lines */
     lp = mp->ldsc + i;                                  /* get line desc */
     if (!(lp->sock || lp->serport || lp->loopback || lp->framer) ||
@@ -2220,6 +2284,8 @@ for (i = 0; i < mp->lines; i++) {                       /* loop thru lines */
         j = lp->rxbpi;                                  /* start of data */
         lp->rxbpi = lp->rxbpi + nbytes;                 /* adv pointers */
         lp->rxcnt = lp->rxcnt + nbytes;
+        if (sim_perf_enabled)
+            tmxr_perf_count (lp, FALSE, nbytes);
 
 /* Examine new data, remove TELNET cruft before making input available */
 
@@ -2631,6 +2697,8 @@ if (nbytes) {                                           /* >0? write */
         if (lp->txbpr >= lp->txbsz)                     /* wrap? */
             lp->txbpr = 0;
         lp->txcnt = lp->txcnt + sbytes;                 /* update counts */
+        if (sim_perf_enabled)
+            tmxr_perf_count (lp, TRUE, sbytes);
         nbytes = nbytes - sbytes;
         if ((nbytes == 0) && (lp->datagram))            /* if Empty buffer on datagram line */
             lp->txbpi = lp->txbpr = 0;                  /* Start next packet at beginning of buffer */
@@ -2649,6 +2717,8 @@ if (nbytes) {                                           /* >0? write */
             if (lp->txbpr >= lp->txbsz)                 /* wrap? */
                 lp->txbpr = 0;
             lp->txcnt = lp->txcnt + sbytes;             /* update counts */
+            if (sim_perf_enabled)
+                tmxr_perf_count (lp, TRUE, sbytes);
             nbytes = nbytes - sbytes;
             }
         }
@@ -3745,6 +3815,301 @@ return SCPE_OK;
 static TMXR **tmxr_open_devices = NULL;
 static int tmxr_open_device_count = 0;
 
+#if defined (TMXR_EPOLL_IO)
+/* Event driven multiplexer I/O
+
+   A single I/O thread uses epoll to watch the listening, connecting and
+   connected sockets and the serial ports of every open multiplexer.  When
+   one becomes ready, the unit which polls for that activity is activated
+   immediately via the asynchronous event queue rather than waiting for its
+   next poll.  Receive readiness is also recorded in the line so that
+   tmxr_read can skip sockets which have nothing to deliver.
+
+   Descriptors are registered edge triggered.  The simulator thread owns
+   the line and multiplexer descriptors, so whenever it opens one it notes
+   that the set of descriptors to watch has changed, via _tmxr_poll_changed.
+   The next tmxr_poll_conn or tmxr_poll_rx records the new set, once however
+   many lines changed (attaching a large multiplexer initializes every
+   line), and the thread rebuilds its epoll set from that record.  Closed
+   descriptors drop out of the set by themselves.  The thread only runs
+   while multiplexers are open and asynchronous I/O is enabled; the poll
+   routines start and stop it as that changes.  The readiness flags the
+   thread sets (rx_ready and conn_ready) and the change count are only
+   accessed under tmxr_poll_lock.
+*/
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define TMXR_POLL_EVENTS    64                          /* events per epoll_wait */
+
+typedef struct {
+    TMXR                *mp;                            /* multiplexer */
+    TMLN                *lp;                            /* line (NULL for the mux listener) */
+    t_bool              conn;                           /* connection rather than data activity */
+    int                 fd;                             /* descriptor */
+    uint32              events;                         /* epoll events of interest */
+    } TMXR_POLL_REF;
+
+static pthread_t tmxr_poll_thread;
+static pthread_mutex_t tmxr_poll_lock = PTHREAD_MUTEX_INITIALIZER;
+static int tmxr_poll_wake_fd = -1;                      /* eventfd to wake the I/O thread */
+static uint32 tmxr_poll_changes = 0;                    /* descriptor change count */
+static uint32 tmxr_poll_records = 0;                    /* descriptor sets recorded */
+static t_bool tmxr_poll_dirty = FALSE;                  /* descriptors changed since recorded */
+static t_bool tmxr_poll_failed = FALSE;                 /* I/O thread couldn't be started */
+static TMXR_POLL_REF *tmxr_poll_fds = NULL;             /* descriptors to watch */
+static int tmxr_poll_fd_count = 0;
+
+static void _tmxr_poll_wake (void)
+{
+t_uint64 one = 1;
+
+if (write (tmxr_poll_wake_fd, &one, sizeof (one)) != sizeof (one))
+    sim_printf ("Tmxr: I/O thread wakeup failed: %s\n", strerror (errno));
+}
+
+static TMXR_POLL_REF *_tmxr_poll_watch (TMXR_POLL_REF *ref, int fd, uint32 events, TMXR *mp, TMLN *lp, t_bool conn)
+{
+ref->mp = mp;
+ref->lp = lp;
+ref->conn = conn;
+ref->fd = fd;
+ref->events = events;
+return ref + 1;
+}
+
+/* Note that the set of open descriptors has changed */
+
+static void _tmxr_poll_changed (void)
+{
+tmxr_poll_dirty = TRUE;
+}
+
+/* Record the currently open descriptors and have the I/O thread watch them */
+
+static void _tmxr_poll_record (void)
+{
+int i, j, count = 0;
+TMXR_POLL_REF *ref;
+
+tmxr_poll_dirty = FALSE;
+++tmxr_poll_records;
+pthread_mutex_lock (&tmxr_poll_lock);
+for (i = 0; i < tmxr_open_device_count; ++i)
+    count += 1 + 4 * tmxr_open_devices[i]->lines;
+ref = (TMXR_POLL_REF *)realloc (tmxr_poll_fds, (1 + count) * sizeof (*ref));
+if (ref != NULL)                                        /* on failure the prior set stays */
+    tmxr_poll_fds = ref;
+for (i = 0; i < tmxr_open_device_count; ++i) {
+    TMXR *mp = tmxr_open_devices[i];
+
+    if (ref && mp->master)
+        ref = _tmxr_poll_watch (ref, (int)mp->master, EPOLLIN, mp, NULL, TRUE);
+    for (j = 0; j < mp->lines; ++j) {
+        TMLN *lp = mp->ldsc + j;
+
+        lp->rx_ready = TRUE;                            /* anything already waiting is read */
+        if ((ref == NULL) || lp->loopback || lp->framer)/* not descriptor based */
+            continue;
+        if (lp->master)
+            ref = _tmxr_poll_watch (ref, (int)lp->master, EPOLLIN, mp, lp, TRUE);
+        if (lp->connecting)
+            ref = _tmxr_poll_watch (ref, (int)lp->connecting, EPOLLOUT, mp, lp, TRUE);
+        if (lp->sock)
+            ref = _tmxr_poll_watch (ref, (int)lp->sock, EPOLLIN | EPOLLRDHUP, mp, lp, FALSE);
+        if (lp->serport)
+            ref = _tmxr_poll_watch (ref, sim_serial_fd (lp->serport), EPOLLIN, mp, lp, FALSE);
+        }
+    }
+if (ref != NULL)
+    tmxr_poll_fd_count = (int)(ref - tmxr_poll_fds);
+++tmxr_poll_changes;
+pthread_mutex_unlock (&tmxr_poll_lock);
+_tmxr_poll_wake ();
+}
+
+/* Readiness flags shared with the I/O thread */
+
+static t_bool _tmxr_poll_test_ready (t_bool *ready)
+{
+t_bool was_ready;
+
+pthread_mutex_lock (&tmxr_poll_lock);
+was_ready = *ready;
+*ready = FALSE;
+pthread_mutex_unlock (&tmxr_poll_lock);
+return was_ready;
+}
+
+static void _tmxr_poll_set_ready (t_bool *ready)
+{
+pthread_mutex_lock (&tmxr_poll_lock);
+*ready = TRUE;
+pthread_mutex_unlock (&tmxr_poll_lock);
+}
+
+/* Build a new epoll set from the recorded descriptors */
+
+static int _tmxr_poll_build (TMXR_POLL_REF **refs)
+{
+int epfd = epoll_create1 (EPOLL_CLOEXEC);
+struct epoll_event ev;
+TMXR_POLL_REF *ref;
+int i, count;
+
+if (epfd < 0)
+    return -1;
+memset (&ev, 0, sizeof (ev));
+ev.events = EPOLLIN | EPOLLET;
+ev.data.ptr = NULL;
+(void)epoll_ctl (epfd, EPOLL_CTL_ADD, tmxr_poll_wake_fd, &ev);
+pthread_mutex_lock (&tmxr_poll_lock);
+count = tmxr_poll_fd_count;
+ref = (TMXR_POLL_REF *)realloc (*refs, (1 + count) * sizeof (**refs));
+if (ref != NULL) {
+    *refs = ref;
+    memcpy (ref, tmxr_poll_fds, count * sizeof (*ref));
+    }
+pthread_mutex_unlock (&tmxr_poll_lock);
+if (ref == NULL) {
+    close (epfd);
+    return -1;
+    }
+for (i = 0; i < count; ++i) {
+    ev.events = ref[i].events | EPOLLET;
+    ev.data.ptr = &ref[i];
+    (void)epoll_ctl (epfd, EPOLL_CTL_ADD, ref[i].fd, &ev);  /* already closed descriptors are ignored */
+    }
+return epfd;
+}
+
+static void *_tmxr_poll_io (void *arg)
+{
+struct epoll_event events[TMXR_POLL_EVENTS];
+TMXR_POLL_REF *refs = NULL;
+int epfd = -1;
+uint32 changes;
+t_bool running;
+
+/* Boost Priority for this I/O thread vs the CPU instruction execution
+   thread which, in general, won't be readily yielding the processor
+   when this thread needs to run */
+sim_os_set_thread_priority (PRIORITY_ABOVE_NORMAL);
+
+pthread_mutex_lock (&tmxr_poll_lock);
+changes = tmxr_poll_changes - 1;                        /* force the initial build */
+running = tmxr_poll_running;
+pthread_mutex_unlock (&tmxr_poll_lock);
+while (running) {
+    int i, n;
+    t_bool rebuild;
+
+    pthread_mutex_lock (&tmxr_poll_lock);
+    rebuild = (changes != tmxr_poll_changes);
+    changes = tmxr_poll_changes;
+    pthread_mutex_unlock (&tmxr_poll_lock);
+    if (rebuild) {
+        if (epfd >= 0)
+            close (epfd);
+        epfd = _tmxr_poll_build (&refs);
+        if (epfd < 0)
+            break;
+        }
+    n = epoll_wait (epfd, events, TMXR_POLL_EVENTS, 1000);
+    for (i = 0; i < n; ++i) {
+        TMXR_POLL_REF *ref = (TMXR_POLL_REF *)events[i].data.ptr;
+        UNIT *uptr = NULL;
+
+        if (ref == NULL) {                              /* wakeup request */
+            t_uint64 val;
+
+            if ((read (tmxr_poll_wake_fd, &val, sizeof (val)) != sizeof (val)) &&
+                (errno != EAGAIN))                      /* already drained? */
+                sim_printf ("Tmxr: I/O thread wakeup read failed: %s\n", strerror (errno));
+            continue;
+            }
+        pthread_mutex_lock (&tmxr_poll_lock);
+        if (changes == tmxr_poll_changes) {             /* lines still as recorded? */
+            if (ref->conn) {
+                ref->mp->conn_ready = TRUE;
+                uptr = ref->mp->uptr;
+                }
+            else {
+                ref->lp->rx_ready = TRUE;
+                uptr = ref->lp->uptr ? ref->lp->uptr : ref->mp->uptr;
+                }
+            }
+        pthread_mutex_unlock (&tmxr_poll_lock);
+        if ((uptr != NULL) && sim_asynch_enabled &&
+            !(uptr->dynflags & UNIT_TMR_UNIT))
+            sim_activate_abs (uptr, 0);                 /* queued to the simulator thread */
+        }
+    pthread_mutex_lock (&tmxr_poll_lock);
+    running = tmxr_poll_running;
+    pthread_mutex_unlock (&tmxr_poll_lock);
+    }
+if (epfd >= 0)
+    close (epfd);
+free (refs);
+return NULL;
+}
+
+static void _tmxr_poll_start (void)
+{
+pthread_attr_t attr;
+
+tmxr_poll_wake_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+if (tmxr_poll_wake_fd < 0)
+    return;                                             /* fall back to plain polling */
+tmxr_poll_running = TRUE;
+pthread_attr_init (&attr);
+pthread_attr_setscope (&attr, PTHREAD_SCOPE_SYSTEM);
+if (pthread_create (&tmxr_poll_thread, &attr, _tmxr_poll_io, NULL)) {
+    tmxr_poll_running = FALSE;
+    close (tmxr_poll_wake_fd);
+    tmxr_poll_wake_fd = -1;
+    }
+pthread_attr_destroy (&attr);
+}
+
+static void _tmxr_poll_stop (void)
+{
+if (!tmxr_poll_running)
+    return;
+pthread_mutex_lock (&tmxr_poll_lock);
+tmxr_poll_running = FALSE;
+pthread_mutex_unlock (&tmxr_poll_lock);
+_tmxr_poll_wake ();
+pthread_join (tmxr_poll_thread, NULL);
+close (tmxr_poll_wake_fd);
+tmxr_poll_wake_fd = -1;
+free (tmxr_poll_fds);
+tmxr_poll_fds = NULL;
+tmxr_poll_fd_count = 0;
+}
+
+/* Run the I/O thread only while multiplexers are open and asynchronous I/O
+   is enabled, and give it any descriptor changes since the last call */
+
+static void _tmxr_poll_sync (void)
+{
+t_bool want = sim_asynch_enabled && (tmxr_open_device_count > 0) && !tmxr_poll_failed;
+
+if (want != tmxr_poll_running) {
+    if (want) {
+        _tmxr_poll_start ();
+        tmxr_poll_failed = !tmxr_poll_running;          /* don't retry every poll */
+        }
+    else
+        _tmxr_poll_stop ();
+    tmxr_poll_dirty = TRUE;
+    }
+if (tmxr_poll_dirty && tmxr_poll_running)
+    _tmxr_poll_record ();
+}
+#endif /* TMXR_EPOLL_IO */
+
 static void tmxr_add_to_open_list (TMXR* mux)
 {
 int i;
@@ -3756,8 +4121,14 @@ for (i=0; i<tmxr_open_device_count; ++i)
         break;
         }
 if (!found) {
+#if defined (TMXR_EPOLL_IO)
+    pthread_mutex_lock (&tmxr_poll_lock);
+#endif
     tmxr_open_devices = (TMXR **)realloc(tmxr_open_devices, (tmxr_open_device_count+1)*sizeof(*tmxr_open_devices));
     tmxr_open_devices[tmxr_open_device_count++] = mux;
+#if defined (TMXR_EPOLL_IO)
+    pthread_mutex_unlock (&tmxr_poll_lock);
+#endif
     for (i=0; i<mux->lines; i++) {
         if (mux->ldsc[i].send == NULL)
             mux->ldsc[i].send = (SEND *)calloc (1, sizeof (SEND));
@@ -3766,12 +4137,16 @@ if (!found) {
         mux->ldsc[i].send->after = mux->ldsc[i].send->delay = 0;
         }
     }
+_tmxr_poll_changed ();
 }
 
 static void _tmxr_remove_from_open_list (TMXR* mux)
 {
 int i, j;
 
+#if defined (TMXR_EPOLL_IO)
+pthread_mutex_lock (&tmxr_poll_lock);
+#endif
 for (i=0; i<tmxr_open_device_count; ++i)
     if (tmxr_open_devices[i] == mux) {
         for (j=i+1; j<tmxr_open_device_count; ++j)
@@ -3779,6 +4154,13 @@ for (i=0; i<tmxr_open_device_count; ++i)
         --tmxr_open_device_count;
         break;
         }
+#if defined (TMXR_EPOLL_IO)
+pthread_mutex_unlock (&tmxr_poll_lock);
+if (tmxr_open_device_count == 0)
+    _tmxr_poll_stop ();
+else
+    _tmxr_poll_changed ();
+#endif
 }
 
 static t_stat _tmxr_locate_line_send_expect (const char *cptr, TMLN **lp, SEND **snd, EXPECT **exp)
@@ -5592,6 +5974,55 @@ tmxr->lines = saved_lines;
 return SCPE_OK;
 }
 
+#if defined (TMXR_EPOLL_IO)
+/* Resetting every line records the descriptors once, on the next poll,
+   and the I/O thread only runs while asynchronous I/O is enabled */
+
+static t_stat sim_tmxr_test_poll (DEVICE *dptr)
+{
+char cmd[CBUFSIZE];
+TMXR *tmxr;
+int line;
+uint32 records;
+t_bool saved_asynch_enabled = sim_asynch_enabled;
+t_stat r;
+
+sprintf (cmd, "%s -u localhost:65500;notelnet", dptr->name);
+sim_asynch_enabled = FALSE;
+r = attach_cmd (0, cmd);
+if (r != SCPE_OK) {
+    sim_asynch_enabled = saved_asynch_enabled;
+    return r;
+    }
+tmxr = (TMXR *)dptr->units->tmxr;
+tmxr_poll_conn (tmxr);
+if (tmxr_poll_running)
+    r = sim_messagef (SCPE_IERR, "I/O thread started with asynchronous I/O disabled\n");
+sim_asynch_enabled = TRUE;
+tmxr_poll_conn (tmxr);
+if ((r == SCPE_OK) && !tmxr_poll_running && !tmxr_poll_failed)
+    r = sim_messagef (SCPE_IERR, "I/O thread not started with asynchronous I/O enabled\n");
+if ((r == SCPE_OK) && tmxr_poll_running) {
+    records = tmxr_poll_records;
+    for (line = 0; line < tmxr->lines; line++)
+        tmxr_reset_ln (&tmxr->ldsc[line]);
+    if (tmxr_poll_records != records)
+        r = sim_messagef (SCPE_IERR, "Descriptors recorded while resetting lines\n");
+    tmxr_poll_rx (tmxr);
+    tmxr_poll_conn (tmxr);
+    if ((r == SCPE_OK) && (tmxr_poll_records != records + 1))
+        r = sim_messagef (SCPE_IERR, "Descriptors recorded %u times after resetting %d lines\n", tmxr_poll_records - records, tmxr->lines);
+    }
+sim_asynch_enabled = FALSE;
+tmxr_poll_conn (tmxr);
+if ((r == SCPE_OK) && tmxr_poll_running)
+    r = sim_messagef (SCPE_IERR, "I/O thread still running with asynchronous I/O disabled\n");
+detach_cmd (0, dptr->name);
+sim_asynch_enabled = saved_asynch_enabled;
+return r;
+}
+#endif
+
 
 t_stat tmxr_sock_test (DEVICE *dptr, const char *cptr)
 {
@@ -5654,6 +6085,9 @@ if (tmxr->lines > 1) {
     SIM_TEST(detach_cmd (0, dptr->name));
     SIM_TEST(sim_tmxr_test_lnorder (tmxr));
     }
+#if defined (TMXR_EPOLL_IO)
+SIM_TEST(sim_tmxr_test_poll (dptr));
+#endif
 return stat;
 }
 
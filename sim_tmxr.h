@@ -161,6 +161,7 @@ struct tmln {
     int32               txstall;                        /* xmt stall count */
     int32               txbsz;                          /* xmt buffer size */
     int32               txbfd;                          /* xmt buffered flag */
+    t_bool              rx_ready;                       /* rcv data signalled by I/O thread */
     t_bool              modem_control;                  /* line supports modem control behaviors */
     t_bool              port_speed_control;             /* line programmatically sets port speed */
     int32               modembits;                      /* modem bits which are currently set */
@@ -227,6 +228,7 @@ struct tmxr {
     int32               sessions;                       /* count of tcp connections received */
     uint32              poll_interval;                  /* frequency of connection polls (seconds) */
     uint32              last_poll_time;                 /* time of last connection poll */
+    t_bool              conn_ready;                     /* connection activity signalled by I/O thread */
     uint32              ring_start_time;                /* time ring signal was raised */
     char                *ring_ipad;                     /* incoming connection address awaiting DTR */
     SOCKET              ring_sock;                      /* incoming connection socket awaiting DTR */
@@ -236,6 +238,8 @@ struct tmxr {
     t_bool              port_speed_control;             /* multiplexer programmatically sets port speed */
     t_bool              packet;                         /* Lines are packet oriented */
     t_bool              datagram;                       /* Lines use datagram packet transport */
+    SIM_PERF            *perf_rx;                       /* bytes received performance counter */
+    SIM_PERF            *perf_tx;                       /* bytes transmitted performance counter */
     };
 
 int32 tmxr_poll_conn (TMXR *mp);